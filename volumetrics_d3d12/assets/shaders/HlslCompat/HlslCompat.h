@@ -13,6 +13,8 @@ typedef uint2 XMUINT2;
 typedef uint3 XMUINT3;
 typedef uint4 XMUINT4;
 
+typedef int3 XMINT3;
+
 typedef uint64_t UINT64;
 
 #define FLOAT_MAX 3.402823466e+38F
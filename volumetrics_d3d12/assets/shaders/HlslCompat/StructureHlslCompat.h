@@ -56,13 +56,30 @@ struct PassConstantBuffer
 	UINT Padding;
 };
 
-// Per-object data per frame
-struct ObjectConstantBuffer
+// Per-instance data per frame
+// Tightly packed into a structured buffer indexed by instance ID
+struct InstanceGPUData
 {
-	XMMATRIX WorldMat;
+	// The first three rows of the transposed world matrix (the last row is always 0,0,0,1)
+	// World-space position = dot(WorldMat[i], float4(position, 1))
+	XMFLOAT4 WorldMat[3];
 	UINT MaterialID;
 };
 
+// Root constants per draw call
+struct InstanceDrawConstants
+{
+	// Index into the instance index list of the first instance in this draw
+	UINT BaseInstance;
+};
+
+
+// Root constants for each shadow map pass
+struct ShadowPassConstants
+{
+	UINT CascadeIndex;
+};
+
 
 // Properties used for full-screen quad raster passes
 struct FullscreenQuadProperties
@@ -73,6 +90,8 @@ struct FullscreenQuadProperties
 
 
 // Lighting structures
+#define MAX_SHADOW_CASCADES 4
+
 struct LightingConstantBuffer
 {
 	// Global directional light (the sun)
@@ -83,7 +102,11 @@ struct LightingConstantBuffer
 		XMFLOAT3 Color;
 		UINT UseESM;
 
-		XMMATRIX ViewProjection;
+		// One shadow map array slice per cascade
+		XMMATRIX CascadeViewProjection[MAX_SHADOW_CASCADES];
+		// The furthest view-space depth covered by each cascade
+		XMFLOAT4 CascadeSplits;
+		UINT CascadeCount;
 	} DirectionalLight;
 
 	// From "Stupid Spherical Harmonics (SH) Tricks"
@@ -91,6 +114,18 @@ struct LightingConstantBuffer
 	UINT UseSHIrradiance;
 
 	UINT PointLightCount;
+
+	// Clustered light culling
+	// Point lights are binned into a view-space grid of clusters, with tiles across the screen and slices in depth
+	// Cluster slices are aligned with the froxel slices of the volumetrics volume, whose depth mapping is repeated here:
+	// Cluster slice = FroxelDepthToZSlice(view depth, ...) * ClusterDepthScale, with the last slice covering everything beyond
+	float ClusterDepthScale;
+	float ClusterNearDepth;
+	float ClusterFarDepth;
+	UINT ClusterFroxelSliceCount;
+	UINT ClusterDepthDistribution;
+	float ClusterHybridLinearDepth;
+	XMUINT3 ClusterGridDimensions;
 };
 
 struct PointLightGPUData
@@ -118,6 +153,21 @@ struct MaterialGPUData
 #define VOLUME_FLAGS_DISABLE_POINT_LIGHTS	(1 << 2)
 
 
+// Limit on VolumetricsConstantBuffer::VolumeResolution.z, the size of the slice table
+#define VOLUME_MAX_SLICES	128
+
+// Values that are constant across a slice of the froxel grid, so that the shaders do not re-derive them per froxel
+struct FroxelSliceGPUData
+{
+	float Depth;			// View depth of slice i, where density is sampled
+	float CentreDepth;		// View depth of slice i + 0.5, where light is scattered without jitter
+	float FrontDepth;		// View depth of slice i - 0.5, the nearest that a jittered sample of the slice reaches
+	float IntegrationStep;	// Distance marched by volume integration to CentreDepth, from the previous slice's centre or the front of the volume
+
+	XMFLOAT2 RayScale;			// View-space xy per unit of NDC xy at Depth
+	XMFLOAT2 CentreRayScale;	// View-space xy per unit of NDC xy at CentreDepth
+};
+
 struct VolumetricsConstantBuffer
 {
 	// Volume properties
@@ -131,6 +181,23 @@ struct VolumetricsConstantBuffer
 	float HistoryWeight;
 
 	UINT Flags;
+
+	// Slice distribution in depth (VOLUME_DEPTH_DISTRIBUTION_*, see VolumetricsHlslCompat.h)
+	UINT DepthDistribution;
+	float HybridLinearDepth;
+
+	// Depth slice count of the previous light scattering volume, which differs from VolumeResolution.z for a frame after a resize
+	UINT HistorySliceCount;
+
+	// Light scattering thread groups past the active bricks clear their brick
+	UINT ActiveBrickCount;
+
+	// View-space xy of a froxel per unit of NDC xy, at a view depth of 1
+	XMFLOAT2 ViewRayScale;
+	XMFLOAT2 Padding;
+
+	// The first VolumeResolution.z entries are filled each frame by FroxelSliceTable::Build
+	FroxelSliceGPUData Slices[VOLUME_MAX_SLICES];
 };
 
 // Collection of parameters required to calculate light scattering
@@ -159,6 +226,93 @@ struct GlobalFogConstantBuffer
 };
 
 
+#define FOG_VOLUME_SHAPE_BOX		0
+#define FOG_VOLUME_SHAPE_ELLIPSOID	1
+#define FOG_VOLUME_SHAPE_SPHERE		2	// An ellipsoid with equal radii, which can be culled exactly
+#define FOG_VOLUME_SHAPE_BAKED		3	// A box filled from its region of the fog density atlas, see FogVoxelizer
+#define FOG_VOLUME_SHAPE_SPARSE		4	// A box filled from its bricks of the sparse fog atlas, see SparseFogVolume
+#define FOG_VOLUME_SHAPE_COUNT		5
+#define FOG_VOLUME_SHAPE_ANALYTIC_COUNT	3	// The shapes before FOG_VOLUME_SHAPE_BAKED, which need no atlas region
+
+// Tightly packed into a structured buffer, indexed by the per-tile fog volume lists
+struct FogVolumeGPUData
+{
+	// The first three rows of the transposed world-to-local matrix (the last row is always 0,0,0,1)
+	// Maps the volume onto the unit cube [-1, 1] for boxes and baked volumes, or the unit sphere otherwise
+	XMFLOAT4 WorldToLocal[3];
+
+	XMFLOAT3 Albedo;
+	float Extinction;
+
+	XMFLOAT3 Emission;
+	float Anisotropy;
+
+	UINT Shape;		// FOG_VOLUME_SHAPE_*
+	float Falloff;	// Fraction of the volume, from its surface inwards, over which the density fades in. Baked volumes have it baked in
+
+	// Baked volumes: maps the unit cube, from [0, 1], onto the volume's region of the fog density atlas
+	// Sparse volumes: the first entry of the volume in the indirection table, and the dimensions of its grid in voxels
+	XMFLOAT3 AtlasOffset;
+	XMFLOAT3 AtlasScale;
+};
+
+
+// Sparse baked fog, see SparseFogVolume and SparseBrickAtlas
+#define SPARSE_FOG_BRICK_SIZE		8	// Voxels along each axis of a brick
+#define SPARSE_FOG_BRICK_APRON		1	// Voxels around each brick in the atlas, copied from its neighbours so that filtering stays within the brick
+#define SPARSE_FOG_BRICK_SLOT_SIZE	(SPARSE_FOG_BRICK_SIZE + 2 * SPARSE_FOG_BRICK_APRON)
+
+// Each entry of the indirection table has this bit set for a brick in the atlas, with its slot in bits 0-29 (10 bits per axis),
+// or clear for a brick of uniform value, with the value as UNORM8 in bits 0-7
+#define SPARSE_FOG_INDIRECTION_BRICK	0x80000000u
+#define SPARSE_FOG_INDIRECTION_SLOT_BITS	10
+
+
+// World-space fog clipmap
+#define FOG_CLIPMAP_CASCADE_COUNT	4
+#define FOG_CLIPMAP_UPDATE_GROUP_SIZE	4	// Threads along each axis of a fog_clipmap_update_cs group
+
+struct FogClipmapCascadeGPUData
+{
+	XMINT3 Origin;		// The voxel at the minimum corner of the cascade, in voxels of this cascade from the world origin
+	float VoxelSize;
+};
+
+struct FogClipmapConstantBuffer
+{
+	FogClipmapCascadeGPUData Cascades[FOG_CLIPMAP_CASCADE_COUNT];
+
+	UINT Resolution;	// Voxels along each axis of every cascade
+	UINT Enabled;		// When 0, density estimation evaluates the global fog directly
+	XMFLOAT2 Padding;
+};
+
+// Root constants for re-baking a box of voxels of one cascade, which does not wrap around the edges of its texture
+struct FogClipmapUpdateConstants
+{
+	XMINT3 VoxelMin;
+	float VoxelSize;
+
+	XMUINT3 TexelMin;	// The texel that VoxelMin is stored in
+	UINT Padding0;
+
+	XMUINT3 Size;
+	UINT Padding1;
+};
+
+// Root constants of density estimation for modulating the global fog with the baked noise texture, see FogNoiseBaker
+struct FogNoiseConstants
+{
+	XMFLOAT3 WindVelocity;	// The texture is scrolled by WindVelocity * TotalTime, in metres
+	float Frequency;		// Tiles of the texture per metre
+
+	float Strength;			// Fraction of the extinction that the noise can remove
+	float WorleyWeight;		// Blend from the gradient channel (0) to the Worley channel (1)
+	UINT Enabled;
+	float Padding;
+};
+
+
 // Post-processing
 
 struct TonemappingParametersConstantBuffer
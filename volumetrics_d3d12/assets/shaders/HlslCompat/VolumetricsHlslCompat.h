@@ -0,0 +1,218 @@
+#ifndef VOLUMETRICSHLSLCOMPAT_H
+#define VOLUMETRICSHLSLCOMPAT_H
+
+#ifdef HLSL
+#include "HlslCompat.h"
+#else
+#include <cmath>
+using namespace DirectX;
+#endif
+
+
+// How the froxel slices are spread in view-space depth, between the near plane and the max volume distance
+#define VOLUME_DEPTH_DISTRIBUTION_LINEAR		0	// Slices of equal thickness
+#define VOLUME_DEPTH_DISTRIBUTION_EXPONENTIAL	1	// Slice thickness grows exponentially with depth
+#define VOLUME_DEPTH_DISTRIBUTION_HYBRID		2	// Close to linear up to HybridLinearDepth, then exponential
+#define VOLUME_DEPTH_DISTRIBUTION_COUNT			3
+
+
+// Memory modes, passed to the volumetrics shaders as defines
+
+// Storage of VBufferB (emission and anisotropy)
+#define VOLUME_VBUFFERB_STORAGE_FULL		0	// RGBA16F
+#define VOLUME_VBUFFERB_STORAGE_PACKED		1	// R32_UINT, see PackEmissionAnisotropy
+#define VOLUME_VBUFFERB_STORAGE_ANALYTIC	2	// Not stored, taken from the global fog constants, so local fog volumes have no emission or anisotropy
+#define VOLUME_VBUFFERB_STORAGE_COUNT		3
+
+// Storage of the integrated volume
+#define VOLUME_INTEGRATED_STORAGE_RGBA16F			0	// Scattering and transmittance in one RGBA16F volume
+#define VOLUME_INTEGRATED_STORAGE_R11G11B10_R16		1	// R11G11B10F scattering, R16_UNORM transmittance
+#define VOLUME_INTEGRATED_STORAGE_R11G11B10_R8		2	// R11G11B10F scattering, R8_UNORM transmittance
+#define VOLUME_INTEGRATED_STORAGE_COUNT				3
+
+
+// Volume integration, picked at runtime by VolumetricRendering
+#define VOLUME_INTEGRATION_SERIAL	0	// volume_integration_cs: each thread marches one column of froxels front to back
+#define VOLUME_INTEGRATION_SCAN		1	// volume_integration_scan_cs: the threads of a column integrate it together with a parallel scan
+#define VOLUME_INTEGRATION_COUNT	2
+
+// Parallel scan layout
+// Thread groups cover VOLUME_SCAN_GROUP_SIZE_XY^2 columns with VOLUME_SCAN_THREADS_PER_COLUMN threads each,
+// and each thread integrates a chunk of up to VOLUME_SCAN_MAX_CHUNK_SLICES consecutive slices, which limits the volume depth
+#define VOLUME_SCAN_GROUP_SIZE_XY		2
+#define VOLUME_SCAN_THREADS_PER_COLUMN	32
+#define VOLUME_SCAN_MAX_CHUNK_SLICES	4
+#define VOLUME_SCAN_MAX_SLICES			(VOLUME_SCAN_THREADS_PER_COLUMN * VOLUME_SCAN_MAX_CHUNK_SLICES)
+
+
+// Packed VBufferB layout (32 bits):
+//		[0, 21)		Emission RGB, as 7-bit mantissas sharing one exponent
+//		[21, 26)	Shared exponent
+//		[26, 32)	Anisotropy, in 31 steps either side of 0
+// Each emission channel is within max(largest channel / 127, 2^-23) of its original value, up to VBUFFERB_PACKED_MAX_EMISSION
+// Anisotropy is within 1/62 of its original value, and 0 is exact
+#define VBUFFERB_PACKED_MANTISSA_BITS		7
+#define VBUFFERB_PACKED_MANTISSA_MAX		127
+#define VBUFFERB_PACKED_EXPONENT_BIAS		15
+#define VBUFFERB_PACKED_EXPONENT_MAX		31
+#define VBUFFERB_PACKED_ANISOTROPY_STEPS	31
+#define VBUFFERB_PACKED_MAX_EMISSION		65024.0f	// 127/128 * 2^(EXPONENT_MAX - EXPONENT_BIAS)
+
+
+// Froxel bricks
+// Density estimation and light scattering run one thread group per brick of VOLUME_BRICK_SIZE^3 froxels,
+// and are dispatched indirectly over a list of the bricks that may contain fog (see FroxelOccupancy)
+// Listed bricks have their coordinates packed into VOLUME_BRICK_COORD_BITS each, as x | y << 10 | z << 20
+#define VOLUME_BRICK_SIZE			8
+#define VOLUME_BRICK_COORD_BITS		10
+#define VOLUME_BRICK_COORD_MASK		0x3ff
+
+
+// The slice mapping is shared by the shaders and the CPU (for the light clusters and the volumetrics reference)
+// In C++ it lives in the Volumetrics namespace, alongside stand-ins for the HLSL intrinsics it uses
+#ifndef HLSL
+namespace Volumetrics
+{
+	inline float saturate(float x) { return min(max(x, 0.0f), 1.0f); }
+	inline float log2(float x) { return log2f(x); }
+	inline float exp2(float x) { return exp2f(x); }
+	inline float floor(float x) { return floorf(x); }
+	inline float round(float x) { return nearbyintf(x); }	// HLSL rounds halfway cases to even
+	inline float lerp(float a, float b, float t) { return a + (b - a) * t; }
+#endif
+
+
+// The exponential and hybrid distributions both place slices at
+//		depth = fogMinZ - c + c * (1 + (fogMaxZ - fogMinZ) / c)^sliceNormalized
+// Slices are spaced close to linearly while (depth - fogMinZ) is small compared to c, and exponentially beyond it
+// c = 1 gives the exponential distribution, and the hybrid distribution exposes c as HybridLinearDepth
+inline float GetDepthDistributionScale(UINT distribution, float hybridLinearDepth)
+{
+	return distribution == VOLUME_DEPTH_DISTRIBUTION_EXPONENTIAL ? 1.0f : max(hybridLinearDepth, 0.001f);
+}
+
+// Maps [0, 1] across the volume to view-space depth
+// Values outside [0, 1] extrapolate beyond the volume
+inline float NormalizedSliceToFroxelDepth(float sliceNormalized, float fogMinZ, float fogMaxZ, UINT distribution, float hybridLinearDepth)
+{
+	if (distribution == VOLUME_DEPTH_DISTRIBUTION_LINEAR)
+		return fogMinZ + sliceNormalized * (fogMaxZ - fogMinZ);
+
+	const float c = GetDepthDistributionScale(distribution, hybridLinearDepth);
+	return fogMinZ - c + c * exp2(sliceNormalized * log2(1.0f + (fogMaxZ - fogMinZ) / c));
+}
+
+// Inverse of NormalizedSliceToFroxelDepth
+// Depths in front of fogMinZ map to 0 for the non-linear distributions
+inline float FroxelDepthToNormalizedSlice(float depth, float fogMinZ, float fogMaxZ, UINT distribution, float hybridLinearDepth)
+{
+	if (distribution == VOLUME_DEPTH_DISTRIBUTION_LINEAR)
+		return (depth - fogMinZ) / (fogMaxZ - fogMinZ);
+
+	const float c = GetDepthDistributionScale(distribution, hybridLinearDepth);
+	return log2(1.0f + max(depth - fogMinZ, 0.0f) / c) / log2(1.0f + (fogMaxZ - fogMinZ) / c);
+}
+
+
+// Froxel helper functions
+
+// View-space depth of a (fractional) slice, where slice volumeDepth - 1 is at fogMaxZ
+inline float ZSliceToFroxelDepth(float slice, float fogMinZ, float fogMaxZ, UINT volumeDepth, UINT distribution, float hybridLinearDepth)
+{
+	const float sliceNormalized = slice / (float) (volumeDepth - 1);
+	return NormalizedSliceToFroxelDepth(sliceNormalized, fogMinZ, fogMaxZ, distribution, hybridLinearDepth);
+}
+
+// Fractional slice at a view-space depth, not clamped to the volume
+inline float FroxelDepthToZSlice(float depth, float fogMinZ, float fogMaxZ, UINT volumeDepth, UINT distribution, float hybridLinearDepth)
+{
+	return FroxelDepthToNormalizedSlice(depth, fogMinZ, fogMaxZ, distribution, hybridLinearDepth) * (float) (volumeDepth - 1);
+}
+
+// Calculates the W texture coordinate for the volume texture from a given scene depth
+inline float FroxelDepthToVolumeW(float depth, float fogMinZ, float fogMaxZ, UINT distribution, float hybridLinearDepth)
+{
+	return saturate(FroxelDepthToNormalizedSlice(depth, fogMinZ, fogMaxZ, distribution, hybridLinearDepth));
+}
+
+// Depth of a sample offset by sliceOffset slices from the start of a slice, interpolated from the slice table
+// (see FroxelSliceTable) between the start and the half slice on the side of the offset
+// The table only reaches half a slice either side, so larger offsets are clamped to it rather than extrapolated
+inline float InterpolateJitteredSliceDepth(float depth, float frontDepth, float centreDepth, float sliceOffset)
+{
+	return sliceOffset < 0.0f ?
+		lerp(depth, frontDepth, saturate(-2.0f * sliceOffset)) :
+		lerp(depth, centreDepth, saturate(2.0f * sliceOffset));
+}
+
+
+// VBufferB packing
+
+inline UINT PackEmissionAnisotropy(float r, float g, float b, float anisotropy)
+{
+	r = min(max(r, 0.0f), VBUFFERB_PACKED_MAX_EMISSION);
+	g = min(max(g, 0.0f), VBUFFERB_PACKED_MAX_EMISSION);
+	b = min(max(b, 0.0f), VBUFFERB_PACKED_MAX_EMISSION);
+	const float maxChannel = max(max(r, g), b);
+
+	// Smallest exponent that fits the largest channel in the mantissa
+	// log2 can land either side of an exact power of two, so rounding up to the full mantissa range moves up an exponent
+	// round rather than floor(x + 0.5), which rounds up values just below a half as the addition rounds
+	float exponent = max(floor(log2(max(maxChannel, 1e-30f))) + 1.0f + VBUFFERB_PACKED_EXPONENT_BIAS, 0.0f);
+	float scale = exp2(exponent - VBUFFERB_PACKED_EXPONENT_BIAS - VBUFFERB_PACKED_MANTISSA_BITS);
+	if (round(maxChannel / scale) > VBUFFERB_PACKED_MANTISSA_MAX)
+	{
+		exponent += 1.0f;
+		scale *= 2.0f;
+	}
+
+	const UINT mantissaR = (UINT) round(r / scale);
+	const UINT mantissaG = (UINT) round(g / scale);
+	const UINT mantissaB = (UINT) round(b / scale);
+
+	const float clampedAnisotropy = min(max(anisotropy, -1.0f), 1.0f);
+	const UINT anisotropyBits = (UINT) (round(clampedAnisotropy * VBUFFERB_PACKED_ANISOTROPY_STEPS) + VBUFFERB_PACKED_ANISOTROPY_STEPS);
+
+	return mantissaR |
+		(mantissaG << VBUFFERB_PACKED_MANTISSA_BITS) |
+		(mantissaB << (2 * VBUFFERB_PACKED_MANTISSA_BITS)) |
+		((UINT) exponent << (3 * VBUFFERB_PACKED_MANTISSA_BITS)) |
+		(anisotropyBits << 26);
+}
+
+// channel is 0, 1 or 2 for R, G or B
+inline float UnpackEmission(UINT packed, UINT channel)
+{
+	const UINT mantissa = (packed >> (channel * VBUFFERB_PACKED_MANTISSA_BITS)) & VBUFFERB_PACKED_MANTISSA_MAX;
+	const UINT exponent = (packed >> (3 * VBUFFERB_PACKED_MANTISSA_BITS)) & VBUFFERB_PACKED_EXPONENT_MAX;
+	return (float) mantissa * exp2((float) exponent - VBUFFERB_PACKED_EXPONENT_BIAS - VBUFFERB_PACKED_MANTISSA_BITS);
+}
+
+inline float UnpackAnisotropy(UINT packed)
+{
+	return ((float) (packed >> 26) - VBUFFERB_PACKED_ANISOTROPY_STEPS) / VBUFFERB_PACKED_ANISOTROPY_STEPS;
+}
+
+
+// Brick packing
+
+inline UINT PackBrick(UINT x, UINT y, UINT z)
+{
+	return x | (y << VOLUME_BRICK_COORD_BITS) | (z << (2 * VOLUME_BRICK_COORD_BITS));
+}
+
+inline XMUINT3 UnpackBrick(UINT packed)
+{
+	XMUINT3 brick;
+	brick.x = packed & VOLUME_BRICK_COORD_MASK;
+	brick.y = (packed >> VOLUME_BRICK_COORD_BITS) & VOLUME_BRICK_COORD_MASK;
+	brick.z = (packed >> (2 * VOLUME_BRICK_COORD_BITS)) & VOLUME_BRICK_COORD_MASK;
+	return brick;
+}
+
+
+#ifndef HLSL
+}
+#endif
+
+#endif // VOLUMETRICSHLSLCOMPAT_H
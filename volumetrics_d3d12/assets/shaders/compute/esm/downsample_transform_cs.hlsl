@@ -8,8 +8,9 @@
 
 ConstantBuffer<ExponentialShadowMapCB> g_ParamsCB : register(b0);
 
-Texture2D g_InShadowMap : register(t0);
-RWTexture2D<float> g_OutExponentialShadowMap : register(u0);
+// One slice per shadow cascade
+Texture2DArray g_InShadowMap : register(t0);
+RWTexture2DArray<float> g_OutExponentialShadowMap : register(u0);
 
 SamplerState g_PointSampler : register(s0);
 
@@ -22,13 +23,15 @@ void main(uint3 DTid : SV_DispatchThreadId)
 
 	float2 uv = (DTid.xy) / (float2) (g_ParamsCB.OutDimensions - 1);
 
+	const float3 uvw = float3(uv, DTid.z);
+
 	float4 accum = float4(0.0f, 0.0f, 0.0f, 0.0f);
-	accum += exp(g_InShadowMap.GatherRed(g_PointSampler, uv, int2(0, 0)) * ESM_EXPONENT);
-	accum += exp(g_InShadowMap.GatherRed(g_PointSampler, uv, int2(2, 0)) * ESM_EXPONENT);
-	accum += exp(g_InShadowMap.GatherRed(g_PointSampler, uv, int2(0, 2)) * ESM_EXPONENT);
-	accum += exp(g_InShadowMap.GatherRed(g_PointSampler, uv, int2(2, 2)) * ESM_EXPONENT);
+	accum += exp(g_InShadowMap.GatherRed(g_PointSampler, uvw, int2(0, 0)) * ESM_EXPONENT);
+	accum += exp(g_InShadowMap.GatherRed(g_PointSampler, uvw, int2(2, 0)) * ESM_EXPONENT);
+	accum += exp(g_InShadowMap.GatherRed(g_PointSampler, uvw, int2(0, 2)) * ESM_EXPONENT);
+	accum += exp(g_InShadowMap.GatherRed(g_PointSampler, uvw, int2(2, 2)) * ESM_EXPONENT);
 
-	g_OutExponentialShadowMap[DTid.xy] = dot(accum, 1.0f / 16.0f);
+	g_OutExponentialShadowMap[DTid] = dot(accum, 1.0f / 16.0f);
 }
 
 #endif
\ No newline at end of file
@@ -8,8 +8,9 @@
 
 ConstantBuffer<BoxFilterParamsCB> g_ParamsCB : register(b0);
 
-Texture2D<float4> g_InTexture : register(t0);
-RWTexture2D<float4> g_OutTexture : register(u0);
+// Each array slice is filtered independently, with one slice per dispatch z
+Texture2DArray<float4> g_InTexture : register(t0);
+RWTexture2DArray<float4> g_OutTexture : register(u0);
 
 
 [numthreads(16, 16, 1)]
@@ -27,11 +28,11 @@ void HorizontalPass(uint3 DTid : SV_DispatchThreadID)
 	{
 		if (i >= 0 && i < g_ParamsCB.ResourceDimensions.x)
 		{
-			accum += (double4) (g_InTexture[uint2(i, DTid.y)]);
+			accum += (double4) (g_InTexture[uint3(i, DTid.y, DTid.z)]);
 			weightSum += 1.0;
 		}
 	}
-	g_OutTexture[DTid.xy] = (float4) (accum / weightSum);
+	g_OutTexture[DTid] = (float4) (accum / weightSum);
 }
 
 [numthreads(16, 16, 1)]
@@ -49,11 +50,11 @@ void VerticalPass(uint3 DTid : SV_DispatchThreadID)
 	{
 		if (i >= 0 && i < g_ParamsCB.ResourceDimensions.y)
 		{
-			accum += (double4) (g_InTexture[uint2(DTid.x, i)]);
+			accum += (double4) (g_InTexture[uint3(DTid.x, i, DTid.z)]);
 			weightSum += 1.0;
 		}
 	}
-	g_OutTexture[DTid.xy] = (float4) (accum / weightSum);
+	g_OutTexture[DTid] = (float4) (accum / weightSum);
 }
 
 #endif
\ No newline at end of file
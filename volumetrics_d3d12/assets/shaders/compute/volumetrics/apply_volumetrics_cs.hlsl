@@ -12,7 +12,12 @@ ConstantBuffer<PassConstantBuffer> g_PassCB : register(b0);
 ConstantBuffer<VolumetricsConstantBuffer> g_VolumeCB : register(b1);
 
 
+#if VOLUME_INTEGRATED_STORAGE == VOLUME_INTEGRATED_STORAGE_RGBA16F
 Texture3D<float4> g_IntegratedVolume : register(t0);
+#else
+Texture3D<float3> g_IntegratedScattering : register(t0);
+Texture3D<float> g_IntegratedTransmittance : register(t2);
+#endif
 
 Texture2D<float> g_DepthBuffer : register(t1);
 
@@ -41,11 +46,17 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	float4 p_vs = mul(p_ndc, g_PassCB.InvProj);
 	p_vs /= p_vs.w;
 
-	float volumeZ = FroxelDepthToVolumeW(p_vs.z, g_PassCB.NearPlane, g_VolumeCB.MaxVolumeDistance);
+	float volumeZ = FroxelDepthToVolumeW(p_vs.z, g_PassCB.NearPlane, g_VolumeCB.MaxVolumeDistance, g_VolumeCB.DepthDistribution, g_VolumeCB.HybridLinearDepth);
 
 	const float3 positionInVolume = float3(uv, volumeZ);
 
+#if VOLUME_INTEGRATED_STORAGE == VOLUME_INTEGRATED_STORAGE_RGBA16F
 	float4 scatteringAndTransmittance = g_IntegratedVolume.SampleLevel(g_IntegratedVolumeSampler, positionInVolume, 0);
+#else
+	float4 scatteringAndTransmittance = float4(
+		g_IntegratedScattering.SampleLevel(g_IntegratedVolumeSampler, positionInVolume, 0),
+		g_IntegratedTransmittance.SampleLevel(g_IntegratedVolumeSampler, positionInVolume, 0));
+#endif
 	g_Output[DTid.xy] = float4(pixelWithoutFog * scatteringAndTransmittance.www + scatteringAndTransmittance.xyz, 1.0f);
 }
 
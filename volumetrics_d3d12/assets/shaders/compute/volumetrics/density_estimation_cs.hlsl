@@ -22,51 +22,215 @@ RWTexture3D<float4> g_VBufferA : register(u0);
  * RGB - Emissive
  * A   - Phase (g)
 */
+#if VOLUME_VBUFFERB_STORAGE == VOLUME_VBUFFERB_STORAGE_FULL
 RWTexture3D<float4> g_VBufferB : register(u1);
+#elif VOLUME_VBUFFERB_STORAGE == VOLUME_VBUFFERB_STORAGE_PACKED
+// Format: R32_UINT, see PackEmissionAnisotropy
+RWTexture3D<uint> g_VBufferB : register(u1);
+#endif
+
+// Local fog volumes, binned on the CPU into tiles that match the thread groups
+StructuredBuffer<FogVolumeGPUData> g_FogVolumes : register(t0);
+StructuredBuffer<uint2> g_FogVolumeTiles : register(t1);		// (first index, volume count) for each tile
+StructuredBuffer<uint> g_FogVolumeIndices : register(t2);
+
+// Bricks that may contain fog, packed with PackBrick, with one thread group dispatched for each
+StructuredBuffer<uint> g_ActiveBricks : register(t3);
+
+// World-space clipmap of the global fog, see FogClipmapPlanner
+// RGB - Scattering, A - Extinction, stored toroidally and sampled with wrap addressing
+ConstantBuffer<FogClipmapConstantBuffer> g_FogClipmapCB : register(b3);
+Texture3D<float4> g_FogClipmap[FOG_CLIPMAP_CASCADE_COUNT] : register(t4);
+SamplerState g_FogClipmapSampler : register(s0);
+
+// Tileable noise baked by FogNoiseBaker, scrolled with the wind to break up the global fog
+// R - Gradient noise, G - Inverted Worley noise
+ConstantBuffer<FogNoiseConstants> g_FogNoise : register(b4);
+Texture3D<float2> g_FogNoiseTexture : register(t8);
+SamplerState g_FogNoiseSampler : register(s1);
+
+// Densities of the baked fog volumes, packed by FogDensityAtlas, and sampled with clamp addressing
+Texture3D<float> g_FogDensityAtlas : register(t9);
+SamplerState g_FogDensityAtlasSampler : register(s2);
+
+// Bricks of the sparse baked fog volumes, packed by SparseBrickAtlas, and sampled with the density atlas sampler
+// The indirection table has an entry for each brick of each volume, encoded as SPARSE_FOG_INDIRECTION_*
+Texture3D<uint> g_SparseFogIndirection : register(t10);
+Texture3D<float> g_SparseFogBricks : register(t11);
 
 
 float3 ComputeWorldSpacePositionFromFroxelIndex(uint3 froxel)
 {
-	const float depth = ZSliceToFroxelDepth(froxel.z, g_PassCB.NearPlane, g_VolumeCB.MaxVolumeDistance, g_VolumeCB.VolumeResolution.z);
-
-	// Need to get the depth in NDC
-	const float depthNDC = g_PassCB.ViewDepthToNDC.x - g_PassCB.ViewDepthToNDC.y / depth;
+	// Density is sampled at the start of the slice, from the slice table
+	const FroxelSliceGPUData slice = g_VolumeCB.Slices[froxel.z];
 
 	// we want to calculate at the center of each froxel
 	const float2 sliceUV = (froxel.xy + float2(0.5f, 0.5f)) / (float2) (g_VolumeCB.VolumeResolution.xy);
 	float2 sliceNDC = (2.0f * sliceUV - 1.0f) * float2(1.0f, -1.0f);
 
-	float4 p_vs = mul(float4(sliceNDC, depthNDC, 1.0f), g_PassCB.InvProj);
-	p_vs /= p_vs.w;
-	return mul(p_vs, g_PassCB.InvView).xyz;
+	const float3 p_vs = float3(sliceNDC * slice.RayScale, slice.Depth);
+	return mul(float4(p_vs, 1.0f), g_PassCB.InvView).xyz;
+}
+
+// Scattering and extinction of the global fog, from the finest cascade of the clipmap that covers p_ws
+// Returns false outside every cascade
+bool SampleFogClipmap(float3 p_ws, out float4 scatteringAndExtinction)
+{
+	scatteringAndExtinction = float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	[unroll]
+	for (uint cascade = 0; cascade < FOG_CLIPMAP_CASCADE_COUNT; cascade++)
+	{
+		const FogClipmapCascadeGPUData clipmapCascade = g_FogClipmapCB.Cascades[cascade];
+
+		// Filtering reads the voxels within half a voxel of the point, which must all be inside the cascade
+		const float3 voxel = p_ws / clipmapCascade.VoxelSize;
+		const float3 local = voxel - (float3) clipmapCascade.Origin;
+		if (all(local >= 0.5f) && all(local <= g_FogClipmapCB.Resolution - 0.5f))
+		{
+			scatteringAndExtinction = g_FogClipmap[cascade].SampleLevel(g_FogClipmapSampler, voxel / g_FogClipmapCB.Resolution, 0);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Factor in [1 - Strength, 1] to scale the global fog by at a world-space position
+// It never adds fog, so the bricks that FroxelOccupancy finds empty stay empty
+float SampleFogNoise(float3 p_ws)
+{
+	const float3 uvw = (p_ws - g_FogNoise.WindVelocity * g_PassCB.TotalTime) * g_FogNoise.Frequency;
+	const float2 noise = g_FogNoiseTexture.SampleLevel(g_FogNoiseSampler, uvw, 0);
+
+	const float density = lerp(noise.r, noise.g, g_FogNoise.WorleyWeight);
+	return 1.0f - g_FogNoise.Strength * (1.0f - density);
 }
 
+// Density of a sparse volume at uvw in [0, 1] across its grid
+// The slot of each brick holds the voxels around it, so filtering within the slot matches filtering the dense grid
+float SampleSparseFog(float3 indirectionOrigin, float3 dimensions, float3 uvw)
+{
+	const float3 voxel = uvw * dimensions;
+	const uint3 lastBrick = ((uint3) dimensions + SPARSE_FOG_BRICK_SIZE - 1) / SPARSE_FOG_BRICK_SIZE - 1;
+	const uint3 brick = min((uint3) max(voxel, 0.0f) / SPARSE_FOG_BRICK_SIZE, lastBrick);
+
+	const uint indirection = g_SparseFogIndirection.Load(int4((uint3) indirectionOrigin + brick, 0));
+	if ((indirection & SPARSE_FOG_INDIRECTION_BRICK) == 0)
+		return (indirection & 0xFF) / 255.0f;
+
+	const uint slotMask = (1u << SPARSE_FOG_INDIRECTION_SLOT_BITS) - 1;
+	const uint3 slot = uint3(indirection, indirection >> SPARSE_FOG_INDIRECTION_SLOT_BITS, indirection >> (2 * SPARSE_FOG_INDIRECTION_SLOT_BITS)) & slotMask;
+	const float3 texel = slot * SPARSE_FOG_BRICK_SLOT_SIZE + SPARSE_FOG_BRICK_APRON + (voxel - brick * SPARSE_FOG_BRICK_SIZE);
 
-[numthreads(8, 8, 8)]
-void main(uint3 DTid : SV_DispatchThreadID)
+	uint3 textureDimensions;
+	g_SparseFogBricks.GetDimensions(textureDimensions.x, textureDimensions.y, textureDimensions.z);
+	return g_SparseFogBricks.SampleLevel(g_FogDensityAtlasSampler, texel / textureDimensions, 0);
+}
+
+// Density of a fog volume at a world-space position, in [0, 1]
+float EvaluateFogVolumeDensity(FogVolumeGPUData volume, float3 p_ws)
 {
-	float extinction = g_GlobalFogCB.Extinction;
+	const float4 p = float4(p_ws, 1.0f);
+	const float3 p_ls = float3(dot(volume.WorldToLocal[0], p), dot(volume.WorldToLocal[1], p), dot(volume.WorldToLocal[2], p));
+
+	// Baked and sparse volumes already fade in from their surface
+	// Outside the box the atlas holds other volumes, or the border around this one
+	if (volume.Shape == FOG_VOLUME_SHAPE_BAKED)
+	{
+		if (any(abs(p_ls) >= 1.0f))
+			return 0.0f;
+
+		const float3 uvw = volume.AtlasOffset + (p_ls * 0.5f + 0.5f) * volume.AtlasScale;
+		return g_FogDensityAtlas.SampleLevel(g_FogDensityAtlasSampler, uvw, 0);
+	}
+	if (volume.Shape == FOG_VOLUME_SHAPE_SPARSE)
+	{
+		if (any(abs(p_ls) >= 1.0f))
+			return 0.0f;
+
+		return SampleSparseFog(volume.AtlasOffset, volume.AtlasScale, p_ls * 0.5f + 0.5f);
+	}
+
+	// Distance from the centre, where the surface is at 1
+	const float d = volume.Shape == FOG_VOLUME_SHAPE_BOX ? max(max(abs(p_ls.x), abs(p_ls.y)), abs(p_ls.z)) : length(p_ls);
+
+	// 1 - smoothstep(1 - Falloff, 1, d), without dividing by zero for a hard edge
+	const float t = saturate((1.0f - d) / max(volume.Falloff, 1e-4f));
+	return t * t * (3.0f - 2.0f * t);
+}
+
+
+[numthreads(VOLUME_BRICK_SIZE, VOLUME_BRICK_SIZE, VOLUME_BRICK_SIZE)]
+void main(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
+{
+	// Froxels of inactive bricks are never read, so they are left as they are
+	const uint3 brick = UnpackBrick(g_ActiveBricks[Gid.x]);
+	const uint3 DTid = brick * VOLUME_BRICK_SIZE + GTid;
 
 	float3 emission = g_GlobalFogCB.Emission;
 	float anisotropy = g_GlobalFogCB.Anisotropy;
 
-	// Calculate fall-offs as a function of world space position
-
 	// Get world-space pos
 	const float3 p_ws = ComputeWorldSpacePositionFromFroxelIndex(DTid);
 
-	const float r = g_GlobalFogCB.Radius;
-	const float s = g_GlobalFogCB.RadiusSmoothing;
-
-	// Confine fog to a cuboid
-	extinction *= smoothstep(-r - s, -r, p_ws.x) * (1.0f - smoothstep(r, r + s, p_ws.x));
-	extinction *= smoothstep(-r - s, -r, p_ws.z) * (1.0f - smoothstep(r, r + s, p_ws.z));
+	// The global fog is read from the clipmap where it covers the froxel, and evaluated directly elsewhere
+	float extinction;
+	float3 scattering;
+
+	float4 clipmapMedia;
+	if (g_FogClipmapCB.Enabled && SampleFogClipmap(p_ws, clipmapMedia))
+	{
+		scattering = clipmapMedia.rgb;
+		extinction = clipmapMedia.a;
+	}
+	else
+	{
+		extinction = EvaluateGlobalFogExtinction(g_GlobalFogCB, p_ws);
+		scattering = g_GlobalFogCB.Albedo * extinction;
+	}
+
+	// The noise scrolls every frame, so it is applied here rather than baked into the clipmap
+	if (g_FogNoise.Enabled && extinction > 0.0f)
+	{
+		const float noise = SampleFogNoise(p_ws);
+		extinction *= noise;
+		scattering *= noise;
+	}
+
+	// Add the local fog volumes that overlap this thread group's tile
+	// Each tile is one brick, so every thread walks the same list
+	const uint3 tileGrid = g_VolumeCB.VolumeResolution / VOLUME_BRICK_SIZE;
+	const uint2 tileVolumes = g_FogVolumeTiles[(brick.z * tileGrid.y + brick.y) * tileGrid.x + brick.x];
+
+	// The phase is averaged over the media, weighted by their extinction
+	float weightedAnisotropy = anisotropy * extinction;
+
+	for (uint i = 0; i < tileVolumes.y; i++)
+	{
+		const FogVolumeGPUData volume = g_FogVolumes[g_FogVolumeIndices[tileVolumes.x + i]];
+
+		const float density = EvaluateFogVolumeDensity(volume, p_ws);
+		const float volumeExtinction = volume.Extinction * density;
+
+		extinction += volumeExtinction;
+		scattering += volume.Albedo * volumeExtinction;
+		emission += volume.Emission * density;
+		weightedAnisotropy += volume.Anisotropy * volumeExtinction;
+	}
+
+	if (extinction > 0.0f)
+	{
+		anisotropy = weightedAnisotropy / extinction;
+	}
 
-	extinction *= smoothstep(0.0f, 1.0f, p_ws.y) * (1.0f - smoothstep(g_GlobalFogCB.MaxHeight, g_GlobalFogCB.MaxHeight + g_GlobalFogCB.HeightSmoothing, p_ws.y));
-	
-	float3 scattering = g_GlobalFogCB.Albedo * extinction;
 	g_VBufferA[DTid] = float4(scattering, extinction);
+
+#if VOLUME_VBUFFERB_STORAGE == VOLUME_VBUFFERB_STORAGE_FULL
 	g_VBufferB[DTid] = float4(emission, anisotropy);
+#elif VOLUME_VBUFFERB_STORAGE == VOLUME_VBUFFERB_STORAGE_PACKED
+	g_VBufferB[DTid] = PackEmissionAnisotropy(emission.r, emission.g, emission.b, anisotropy);
+#endif
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef FOGCLIPMAPUPDATECS_HLSL
+#define FOGCLIPMAPUPDATECS_HLSL
+
+#define HLSL
+#include "../../HlslCompat/StructureHlslCompat.h"
+
+#include "volumetrics.hlsli"
+
+
+// Bakes the global fog into a box of voxels of one clipmap cascade, as planned by FogClipmapPlanner
+
+
+ConstantBuffer<GlobalFogConstantBuffer> g_GlobalFogCB : register(b0);
+ConstantBuffer<FogClipmapUpdateConstants> g_UpdateCB : register(b1);
+
+/*
+ * Format: RGBA16F
+ * RGB - Scattering
+ * A   - Extinction
+*/
+RWTexture3D<float4> g_FogClipmapCascade : register(u0);
+
+
+[numthreads(FOG_CLIPMAP_UPDATE_GROUP_SIZE, FOG_CLIPMAP_UPDATE_GROUP_SIZE, FOG_CLIPMAP_UPDATE_GROUP_SIZE)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	if (any(DTid >= g_UpdateCB.Size))
+		return;
+
+	// Voxels are baked at their centres
+	const int3 voxel = g_UpdateCB.VoxelMin + (int3) DTid;
+	const float3 p_ws = ((float3) voxel + 0.5f) * g_UpdateCB.VoxelSize;
+
+	const float extinction = EvaluateGlobalFogExtinction(g_GlobalFogCB, p_ws);
+
+	// The box does not wrap around the edges of the texture, so its texels are contiguous
+	g_FogClipmapCascade[g_UpdateCB.TexelMin + DTid] = float4(g_GlobalFogCB.Albedo * extinction, extinction);
+}
+
+#endif
@@ -9,6 +9,8 @@
 
 #include "../../include/lighting_helper.hlsli"
 #include "../../include/random.hlsli"
+#include "../../include/shadows.hlsli"
+#include "../../include/clustered_lighting.hlsli"
 
 
 ConstantBuffer<PassConstantBuffer> g_PassCB : register(b0);
@@ -16,6 +18,9 @@ ConstantBuffer<LightingConstantBuffer> g_LightCB : register(b1);
 
 ConstantBuffer<VolumetricsConstantBuffer> g_VolumeCB : register(b2);
 ConstantBuffer<LightScatteringConstantBuffer> g_LightScatteringCB : register(b3);
+#if VOLUME_VBUFFERB_STORAGE == VOLUME_VBUFFERB_STORAGE_ANALYTIC
+ConstantBuffer<GlobalFogConstantBuffer> g_GlobalFogCB : register(b4);	// Source of the emission and anisotropy, which ignores local fog volumes
+#endif
 
 /*
  * Format: RGBA16F
@@ -28,12 +33,19 @@ Texture3D<float4> g_VBufferA : register(t0);
  * RGB - Emissive
  * A   - Phase (g)
 */
+#if VOLUME_VBUFFERB_STORAGE == VOLUME_VBUFFERB_STORAGE_FULL
 Texture3D<float4> g_VBufferB : register(t1);
+#elif VOLUME_VBUFFERB_STORAGE == VOLUME_VBUFFERB_STORAGE_PACKED
+// Format: R32_UINT, see PackEmissionAnisotropy
+Texture3D<uint> g_VBufferB : register(t1);
+#endif
 
 
 // Scene Lighting resources
 StructuredBuffer<PointLightGPUData> g_PointLights : register(t2);
-Texture2D<float> g_SunSM : register(t3);
+StructuredBuffer<uint2> g_ClusterLightGrid : register(t5);		// (first index, light count) for each cluster
+StructuredBuffer<uint> g_ClusterLightIndices : register(t6);
+Texture2DArray<float> g_SunSM : register(t3);	// One slice per cascade
 
 Texture2D<float> g_SceneDepth : register(t4);
 
@@ -49,21 +61,46 @@ Texture2D<float> g_PrevSceneDepth : register(t1, space1);
 
 SamplerState g_HistoryVolumeSampler : register(s0, space1);
 
+// The active bricks, followed by the bricks that were last written to this light scattering volume while active,
+// and need clearing so that they are empty if sampled as history. Packed with PackBrick
+StructuredBuffer<uint> g_Bricks : register(t7);
+
 
 float3 ComputeWorldSpacePositionFromFroxelIndex(uint3 froxel, float3 cellOffset)
 {
-	const float depth = ZSliceToFroxelDepth(froxel.z + cellOffset.z, g_PassCB.NearPlane, g_VolumeCB.MaxVolumeDistance, g_VolumeCB.VolumeResolution.z);
+	const FroxelSliceGPUData slice = g_VolumeCB.Slices[froxel.z];
 
-	// Need to get the depth in NDC
-	const float depthNDC = g_PassCB.ViewDepthToNDC.x - g_PassCB.ViewDepthToNDC.y / depth;
+	// Jitter keeps samples within half a slice of the slice's start, even with a multiplier above 1
+	const float depth = InterpolateJitteredSliceDepth(slice.Depth, slice.FrontDepth, slice.CentreDepth, cellOffset.z);
 
 	// we want to calculate at the center of each froxel
 	const float2 sliceUV = (froxel.xy + cellOffset.xy) / (float2) (g_VolumeCB.VolumeResolution.xy);
 	float2 sliceNDC = (2.0f * sliceUV - 1.0f) * float2(1.0f, -1.0f);
 
-	float4 p_vs = mul(float4(sliceNDC, depthNDC, 1.0f), g_PassCB.InvProj);
-	p_vs /= p_vs.w;
-	return mul(p_vs, g_PassCB.InvView).xyz;
+	const float3 p_vs = float3(sliceNDC * g_VolumeCB.ViewRayScale * depth, depth);
+	return mul(float4(p_vs, 1.0f), g_PassCB.InvView).xyz;
+}
+
+// The position of a froxel's centre, which is read directly from the slice table
+float3 ComputeWorldSpacePositionFromFroxelCentre(uint3 froxel)
+{
+	const FroxelSliceGPUData slice = g_VolumeCB.Slices[froxel.z];
+
+	const float2 sliceUV = (froxel.xy + float2(0.5f, 0.5f)) / (float2) (g_VolumeCB.VolumeResolution.xy);
+	float2 sliceNDC = (2.0f * sliceUV - 1.0f) * float2(1.0f, -1.0f);
+
+	const float3 p_vs = float3(sliceNDC * slice.CentreRayScale, slice.CentreDepth);
+	return mul(float4(p_vs, 1.0f), g_PassCB.InvView).xyz;
+}
+
+// The light cluster containing the jittered sample point of a froxel
+// Clusters cover whole blocks of froxels, but jitter can move the sample into a neighbouring block
+// The sample's depth is clamped to half a slice, as in InterpolateJitteredSliceDepth
+uint GetFroxelLightCluster(uint3 froxel, float3 cellOffset)
+{
+	const float2 sliceUV = (froxel.xy + cellOffset.xy) / (float2) (g_VolumeCB.VolumeResolution.xy);
+
+	return GetLightClusterIndex(sliceUV, froxel.z + clamp(cellOffset.z, -0.5f, 0.5f), g_LightCB.ClusterGridDimensions, g_LightCB.ClusterDepthScale);
 }
 
 float3 ComputeHistoryVolumeUVW(float3 p_ws)
@@ -72,41 +109,58 @@ float3 ComputeHistoryVolumeUVW(float3 p_ws)
 	float4 ndc = mul(p_vs, g_PassCB.PrevProj);
 	ndc /= ndc.w;
 
-	float3 volumeUVW = float3(ndc.xy * float2(0.5f, -0.5f) + 0.5f,
-							  FroxelDepthToVolumeW(p_vs.z, g_PassCB.NearPlane, g_VolumeCB.MaxVolumeDistance));
+	// Texel s of the history stores the froxel centred on slice s + 0.5, so the slice index must be taken
+	// in the history's own slice count for its texture coordinate to line up after a resize
+	const float historySlice = FroxelDepthToZSlice(p_vs.z, g_PassCB.NearPlane, g_VolumeCB.MaxVolumeDistance, g_VolumeCB.HistorySliceCount, g_VolumeCB.DepthDistribution, g_VolumeCB.HybridLinearDepth);
+
+	float3 volumeUVW = float3(ndc.xy * float2(0.5f, -0.5f) + 0.5f, historySlice / (float)g_VolumeCB.HistorySliceCount);
 	return volumeUVW;
 }
 
 
 // Shadowing
-float GetVisibility(float3 worldPos)
+uint GetShadowCascade(float3 worldPos)
 {
-	float4 shadowPos = mul(float4(worldPos, 1.0f), g_LightCB.DirectionalLight.ViewProjection);
-	shadowPos /= shadowPos.w;
+	const float viewDepth = mul(float4(worldPos, 1.0f), g_PassCB.View).z;
+	return SelectShadowCascade(viewDepth, g_LightCB.DirectionalLight.CascadeSplits, g_LightCB.DirectionalLight.CascadeCount);
+}
 
-	float2 shadowMapUV = shadowPos.xy * 0.5f + 0.5f;
-	shadowMapUV.y = 1.0f - shadowMapUV.y;
+float GetVisibility(float3 worldPos)
+{
+	const uint cascade = GetShadowCascade(worldPos);
+	if (cascade >= g_LightCB.DirectionalLight.CascadeCount)
+		return 1.0f;
 
-	return g_SunSM.SampleCmpLevelZero(g_SMSampler, shadowMapUV, shadowPos.z);
+	const float3 shadowCoords = GetShadowCascadeCoords(worldPos, g_LightCB.DirectionalLight.CascadeViewProjection[cascade]);
+	return g_SunSM.SampleCmpLevelZero(g_SMSampler, float3(shadowCoords.xy, cascade), shadowCoords.z);
 }
 
 float GetVisibility_ESM(float3 worldPos)
 {
-	float4 shadowPos = mul(float4(worldPos, 1.0f), g_LightCB.DirectionalLight.ViewProjection);
-	shadowPos /= shadowPos.w;
+	const uint cascade = GetShadowCascade(worldPos);
+	if (cascade >= g_LightCB.DirectionalLight.CascadeCount)
+		return 1.0f;
 
-	float2 shadowMapUV = shadowPos.xy * 0.5f + 0.5f;
-	shadowMapUV.y = 1.0f - shadowMapUV.y;
+	const float3 shadowCoords = GetShadowCascadeCoords(worldPos, g_LightCB.DirectionalLight.CascadeViewProjection[cascade]);
 
-	const float receiver = exp(shadowPos.z * ESM_EXPONENT);
-	const float occluder = g_SunSM.SampleLevel(g_ESMSampler, shadowMapUV, 0);
+	const float receiver = exp(shadowCoords.z * ESM_EXPONENT);
+	const float occluder = g_SunSM.SampleLevel(g_ESMSampler, float3(shadowCoords.xy, cascade), 0);
 	return 1.0f - saturate(receiver / occluder);
 }
 
 
-[numthreads(8, 8, 8)]
-void main(uint3 DTid : SV_DispatchThreadID)
+[numthreads(VOLUME_BRICK_SIZE, VOLUME_BRICK_SIZE, VOLUME_BRICK_SIZE)]
+void main(uint3 GTid : SV_GroupThreadID, uint3 Gid : SV_GroupID)
 {
+	const uint3 DTid = UnpackBrick(g_Bricks[Gid.x]) * VOLUME_BRICK_SIZE + GTid;
+
+	// Bricks without fog have no scattering or extinction
+	if (Gid.x >= g_VolumeCB.ActiveBrickCount)
+	{
+		g_LightScatteringVolume[DTid] = float4(0.0f, 0.0f, 0.0f, 0.0f);
+		return;
+	}
+
 	// Check cell occlusion
 	bool cellWasOccluded = false;
 	{
@@ -141,7 +195,14 @@ void main(uint3 DTid : SV_DispatchThreadID)
 
 	// Load values from volume buffer
 	const float4 vba = g_VBufferA[DTid];
+#if VOLUME_VBUFFERB_STORAGE == VOLUME_VBUFFERB_STORAGE_FULL
 	const float4 vbb = g_VBufferB[DTid];
+#elif VOLUME_VBUFFERB_STORAGE == VOLUME_VBUFFERB_STORAGE_PACKED
+	const uint packedVBB = g_VBufferB[DTid];
+	const float4 vbb = float4(UnpackEmission(packedVBB, 0), UnpackEmission(packedVBB, 1), UnpackEmission(packedVBB, 2), UnpackAnisotropy(packedVBB));
+#else
+	const float4 vbb = float4(g_GlobalFogCB.Emission, g_GlobalFogCB.Anisotropy);
+#endif
 
 	const float3 scattering = vba.rgb;
 	float extinction = vba.a;
@@ -168,7 +229,7 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	if (g_VolumeCB.UseTemporalReprojection)
 	{
 		historyAlpha = g_VolumeCB.HistoryWeight;
-		historyUV = ComputeHistoryVolumeUVW(ComputeWorldSpacePositionFromFroxelIndex(DTid, float3(0.5f, 0.5f, 0.5f)));
+		historyUV = ComputeHistoryVolumeUVW(ComputeWorldSpacePositionFromFroxelCentre(DTid));
 
 		if (any(historyUV < 0.0f) || any(historyUV > 1.0f) || cellWasOccluded)
 		{
@@ -199,12 +260,13 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	}
 
 
-	// Iterate through point lights to evaluate in-scattering
+	// Iterate through the point lights in this froxel's cluster to evaluate in-scattering
 	if (!(g_VolumeCB.Flags & VOLUME_FLAGS_DISABLE_POINT_LIGHTS))
 	{
-		for (uint i = 0; i < g_LightCB.PointLightCount; i++)
+		const uint2 clusterLights = g_ClusterLightGrid[GetFroxelLightCluster(DTid, cellOffset)];
+		for (uint i = 0; i < clusterLights.y; i++)
 		{
-			PointLightGPUData light = g_PointLights[i];
+			PointLightGPUData light = g_PointLights[g_ClusterLightIndices[clusterLights.x + i]];
 
 			const float3 l = normalize(light.Position.xyz - p_ws);
 			const float3 el = light.Color * light.Intensity;
@@ -11,38 +11,55 @@ ConstantBuffer<PassConstantBuffer> g_PassCB : register(b0);
 ConstantBuffer<VolumetricsConstantBuffer> g_VolumeCB : register(b1);
 
 Texture3D<float4> g_LightScatteringVolume : register(t0);
-
-RWTexture3D<float4> g_IntegratedVolume: register(u0);
+// One bit per brick, set for the bricks that may contain fog, see FroxelOccupancy::GetMask
+StructuredBuffer<uint> g_BrickOccupancy : register(t1);
+
+#if VOLUME_INTEGRATED_STORAGE == VOLUME_INTEGRATED_STORAGE_RGBA16F
+RWTexture3D<float4> g_IntegratedVolume : register(u0);
+#else
+RWTexture3D<float3> g_IntegratedScattering : register(u0);
+RWTexture3D<float> g_IntegratedTransmittance : register(u1);
+#endif
 
 
-[numthreads(8, 8, 1)]
+[numthreads(VOLUME_BRICK_SIZE, VOLUME_BRICK_SIZE, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
 	float3 accumulatedLighting = float3(0.0f, 0.0f, 0.0f);
 	float accumulatedTransmittance = 1.0f;
 
-	float previousSliceDepth = ZSliceToFroxelDepth(0, g_PassCB.NearPlane, g_VolumeCB.MaxVolumeDistance, g_VolumeCB.VolumeResolution.z);
+	const uint3 brickGrid = g_VolumeCB.VolumeResolution / VOLUME_BRICK_SIZE;
+	const uint2 brickXY = DTid.xy / VOLUME_BRICK_SIZE;
 
 	for (uint layer = 0; layer < g_VolumeCB.VolumeResolution.z; layer++)
 	{
 		const uint3 layerCoordinate = uint3(DTid.xy, layer);
 
-		float4 scatteringAndExtinction = g_LightScatteringVolume[layerCoordinate];
-		const float3 scattering = scatteringAndExtinction.rgb;
-		const float extinction = scatteringAndExtinction.a;
+		const float stepLength = g_VolumeCB.Slices[layer].IntegrationStep;
 
-		const float sliceDepth = ZSliceToFroxelDepth(layer + 0.5f, g_PassCB.NearPlane, g_VolumeCB.MaxVolumeDistance, g_VolumeCB.VolumeResolution.z);
-		const float stepLength = length(sliceDepth - previousSliceDepth);
-		previousSliceDepth = sliceDepth;
+		// Inactive bricks have no scattering or extinction, so the accumulated values are carried through them without reading the volume
+		// The thread group is within one column of bricks, so all of its threads take the same branch
+		const uint brick = ((layer / VOLUME_BRICK_SIZE) * brickGrid.y + brickXY.y) * brickGrid.x + brickXY.x;
+		if (g_BrickOccupancy[brick / 32] & (1u << (brick % 32)))
+		{
+			float4 scatteringAndExtinction = g_LightScatteringVolume[layerCoordinate];
+			const float3 scattering = scatteringAndExtinction.rgb;
+			const float extinction = scatteringAndExtinction.a;
 
-		const float transmittance = exp(-extinction * stepLength);
+			const float transmittance = exp(-extinction * stepLength);
 
-		const float3 scatteringIntegratedOverSlice = (scattering - scattering * transmittance) / max(extinction, 0.00001f);
-		accumulatedLighting += scatteringIntegratedOverSlice * saturate(accumulatedTransmittance);
+			const float3 scatteringIntegratedOverSlice = (scattering - scattering * transmittance) / max(extinction, 0.00001f);
+			accumulatedLighting += scatteringIntegratedOverSlice * saturate(accumulatedTransmittance);
 
-		accumulatedTransmittance *= transmittance;
+			accumulatedTransmittance *= transmittance;
+		}
 
+#if VOLUME_INTEGRATED_STORAGE == VOLUME_INTEGRATED_STORAGE_RGBA16F
 		g_IntegratedVolume[layerCoordinate] = float4(accumulatedLighting, accumulatedTransmittance);
+#else
+		g_IntegratedScattering[layerCoordinate] = accumulatedLighting;
+		g_IntegratedTransmittance[layerCoordinate] = accumulatedTransmittance;
+#endif
 	}
 }
 
@@ -0,0 +1,150 @@
+#ifndef VOLUMEINTEGRATIONSCANCS_HLSL
+#define VOLUMEINTEGRATIONSCANCS_HLSL
+
+#define HLSL
+#include "../../HlslCompat/StructureHlslCompat.h"
+
+#include "volumetrics.hlsli"
+
+
+// Integrates the same values as volume_integration_cs, but as a parallel prefix scan along each column
+//
+// The integration of a segment of the column is (scattering reaching its front, transmittance through it),
+// and a segment in front (f) combines with the segment behind it (b) as
+//		(f.rgb + f.a * b.rgb, f.a * b.a)
+// which is associative, so the slices can be combined in any grouping, and only differ from the serial march by rounding
+//
+// Each thread integrates a chunk of consecutive slices, the chunk totals of the column are scanned in group shared memory
+// with a work-efficient (Blelloch) scan, and then each thread re-walks its chunk from the integration of everything in front of it
+
+
+ConstantBuffer<PassConstantBuffer> g_PassCB : register(b0);
+ConstantBuffer<VolumetricsConstantBuffer> g_VolumeCB : register(b1);
+
+Texture3D<float4> g_LightScatteringVolume : register(t0);
+// One bit per brick, set for the bricks that may contain fog, see FroxelOccupancy::GetMask
+StructuredBuffer<uint> g_BrickOccupancy : register(t1);
+
+#if VOLUME_INTEGRATED_STORAGE == VOLUME_INTEGRATED_STORAGE_RGBA16F
+RWTexture3D<float4> g_IntegratedVolume : register(u0);
+#else
+RWTexture3D<float3> g_IntegratedScattering : register(u0);
+RWTexture3D<float> g_IntegratedTransmittance : register(u1);
+#endif
+
+
+#define COLUMNS_PER_GROUP (VOLUME_SCAN_GROUP_SIZE_XY * VOLUME_SCAN_GROUP_SIZE_XY)
+
+// RGB - Scattering, A - Transmittance of each chunk, for each column of the group
+groupshared float4 gs_Chunks[COLUMNS_PER_GROUP][VOLUME_SCAN_THREADS_PER_COLUMN];
+
+
+// An empty segment, which combines with others without changing them
+static const float4 g_EmptySegment = float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+float4 CombineSegments(float4 front, float4 back)
+{
+	return float4(front.rgb + front.a * back.rgb, front.a * back.a);
+}
+
+// The integration of a single slice, as in volume_integration_cs
+float4 IntegrateSlice(uint2 column, uint layer)
+{
+	// Inactive bricks have no scattering or extinction
+	const uint3 brickGrid = g_VolumeCB.VolumeResolution / VOLUME_BRICK_SIZE;
+	const uint brick = ((layer / VOLUME_BRICK_SIZE) * brickGrid.y + column.y / VOLUME_BRICK_SIZE) * brickGrid.x + column.x / VOLUME_BRICK_SIZE;
+	if (!(g_BrickOccupancy[brick / 32] & (1u << (brick % 32))))
+		return g_EmptySegment;
+
+	const float4 scatteringAndExtinction = g_LightScatteringVolume[uint3(column, layer)];
+	const float3 scattering = scatteringAndExtinction.rgb;
+	const float extinction = scatteringAndExtinction.a;
+
+	const float stepLength = g_VolumeCB.Slices[layer].IntegrationStep;
+
+	const float transmittance = exp(-extinction * stepLength);
+	return float4((scattering - scattering * transmittance) / max(extinction, 0.00001f), transmittance);
+}
+
+
+[numthreads(VOLUME_SCAN_GROUP_SIZE_XY, VOLUME_SCAN_GROUP_SIZE_XY, VOLUME_SCAN_THREADS_PER_COLUMN)]
+void main(uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID)
+{
+	const uint2 column = DTid.xy;
+	const uint columnIndex = GTid.y * VOLUME_SCAN_GROUP_SIZE_XY + GTid.x;
+	const uint chunk = GTid.z;
+
+	const uint sliceCount = g_VolumeCB.VolumeResolution.z;
+	const uint chunkSlices = (sliceCount + VOLUME_SCAN_THREADS_PER_COLUMN - 1) / VOLUME_SCAN_THREADS_PER_COLUMN;
+	const uint firstSlice = chunk * chunkSlices;
+
+	// Integrate each slice of the chunk, and the chunk as a whole
+	float4 slices[VOLUME_SCAN_MAX_CHUNK_SLICES];
+	float4 chunkTotal = g_EmptySegment;
+
+	[unroll]
+	for (uint i = 0; i < VOLUME_SCAN_MAX_CHUNK_SLICES; i++)
+	{
+		slices[i] = g_EmptySegment;
+		if (i < chunkSlices && firstSlice + i < sliceCount)
+		{
+			slices[i] = IntegrateSlice(column, firstSlice + i);
+			chunkTotal = CombineSegments(chunkTotal, slices[i]);
+		}
+	}
+
+	gs_Chunks[columnIndex][chunk] = chunkTotal;
+	GroupMemoryBarrierWithGroupSync();
+
+	// Up-sweep: the last chunk of each run of 2 * stride chunks gathers the total of the run
+	[unroll]
+	for (uint upStride = 1; upStride < VOLUME_SCAN_THREADS_PER_COLUMN; upStride *= 2)
+	{
+		if ((chunk + 1) % (2 * upStride) == 0)
+		{
+			gs_Chunks[columnIndex][chunk] = CombineSegments(gs_Chunks[columnIndex][chunk - upStride], gs_Chunks[columnIndex][chunk]);
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	// Down-sweep: replaces the totals with the integration of every chunk in front of each one
+	if (chunk == VOLUME_SCAN_THREADS_PER_COLUMN - 1)
+	{
+		gs_Chunks[columnIndex][chunk] = g_EmptySegment;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	[unroll]
+	for (uint downStride = VOLUME_SCAN_THREADS_PER_COLUMN / 2; downStride > 0; downStride /= 2)
+	{
+		if ((chunk + 1) % (2 * downStride) == 0)
+		{
+			const float4 frontRun = gs_Chunks[columnIndex][chunk - downStride];
+			gs_Chunks[columnIndex][chunk - downStride] = gs_Chunks[columnIndex][chunk];
+			gs_Chunks[columnIndex][chunk] = CombineSegments(gs_Chunks[columnIndex][chunk], frontRun);
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	// Walk the chunk again, from everything in front of it
+	float4 accumulated = gs_Chunks[columnIndex][chunk];
+
+	[unroll]
+	for (uint j = 0; j < VOLUME_SCAN_MAX_CHUNK_SLICES; j++)
+	{
+		const uint layer = firstSlice + j;
+		if (j < chunkSlices && layer < sliceCount)
+		{
+			accumulated = CombineSegments(accumulated, slices[j]);
+
+#if VOLUME_INTEGRATED_STORAGE == VOLUME_INTEGRATED_STORAGE_RGBA16F
+			g_IntegratedVolume[uint3(column, layer)] = accumulated;
+#else
+			g_IntegratedScattering[uint3(column, layer)] = accumulated.rgb;
+			g_IntegratedTransmittance[uint3(column, layer)] = accumulated.a;
+#endif
+		}
+	}
+}
+
+#endif
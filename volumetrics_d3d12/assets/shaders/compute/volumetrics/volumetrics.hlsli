@@ -3,55 +3,42 @@
 
 
 #define HLSL
-#include "../../HlslCompat/HlslCompat.h"
+#include "../../HlslCompat/VolumetricsHlslCompat.h"
 
 
-float HGPhaseFunction(float3 v, float3 l, float g)
-{
-	const float numerator = 1.0f - g * g;
-	const float denominator = pow(1.0f + g * g - 2 * g * dot(v, l), 1.5f);
-	return numerator / (4.0f * PI * denominator);
-}
-
+// Memory mode, set by VolumetricRendering when compiling the pipelines
+#ifndef VOLUME_VBUFFERB_STORAGE
+#define VOLUME_VBUFFERB_STORAGE VOLUME_VBUFFERB_STORAGE_FULL
+#endif
 
-#define VOLUME_SLICE_EXPONENTIAL 0
+#ifndef VOLUME_INTEGRATED_STORAGE
+#define VOLUME_INTEGRATED_STORAGE VOLUME_INTEGRATED_STORAGE_RGBA16F
+#endif
 
 
-// Froxel helper functions
-float ZSliceToFroxelDepth(float slice, float fogMinZ, float fogMaxZ, uint volumeDepth)
+// Extinction of the global fog at a world-space position
+// The fog is confined to a cuboid around the origin, and fades in from y = 0
+float EvaluateGlobalFogExtinction(GlobalFogConstantBuffer fog, float3 p_ws)
 {
-#if VOLUME_SLICE_EXPONENTIAL
-	const float sliceNormalized = (float) (slice) / (float) (volumeDepth - 1);
-	return fogMinZ - 1 + pow(1 + fogMaxZ - fogMinZ, sliceNormalized);
-#else
-	const float sliceNormalized = (float) (slice) / (float) (volumeDepth - 1);
-	return lerp(fogMinZ, fogMaxZ, sliceNormalized);
-#endif
-}
+	float extinction = fog.Extinction;
 
-uint FroxelDepthToZSlice(float depth, float fogMinZ, float fogMaxZ, uint volumeDepth)
-{
-#if VOLUME_SLICE_EXPONENTIAL
+	const float r = fog.Radius;
+	const float s = fog.RadiusSmoothing;
 
-	const float sliceNormalized = log2(1 + depth - fogMinZ) / log2(1 + fogMaxZ - fogMinZ);
-	return saturate(sliceNormalized) * volumeDepth - 1;
-#else
-	const float sliceNormalized = (depth - fogMinZ) / (fogMaxZ - fogMinZ);
-	return saturate(sliceNormalized) * volumeDepth - 1;
-#endif
+	// Confine fog to a cuboid
+	extinction *= smoothstep(-r - s, -r, p_ws.x) * (1.0f - smoothstep(r, r + s, p_ws.x));
+	extinction *= smoothstep(-r - s, -r, p_ws.z) * (1.0f - smoothstep(r, r + s, p_ws.z));
+
+	extinction *= smoothstep(0.0f, 1.0f, p_ws.y) * (1.0f - smoothstep(fog.MaxHeight, fog.MaxHeight + fog.HeightSmoothing, p_ws.y));
+
+	return extinction;
 }
 
-// Calculates the W texture coordinate for the volume texture from a given scene depth
-float FroxelDepthToVolumeW(float depth, float fogMinZ, float fogMaxZ)
+float HGPhaseFunction(float3 v, float3 l, float g)
 {
-#if VOLUME_SLICE_EXPONENTIAL
-
-	const float sliceNormalized = log2(1 + depth - fogMinZ) / log2(1 + fogMaxZ - fogMinZ);
-	return saturate(sliceNormalized);
-#else
-	const float sliceNormalized = (depth - fogMinZ) / (fogMaxZ - fogMinZ);
-	return saturate(sliceNormalized);
-#endif
+	const float numerator = 1.0f - g * g;
+	const float denominator = pow(1.0f + g * g - 2 * g * dot(v, l), 1.5f);
+	return numerator / (4.0f * PI * denominator);
 }
 
 
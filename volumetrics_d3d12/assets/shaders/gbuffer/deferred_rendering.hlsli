@@ -26,6 +26,7 @@ struct GeometryPass_VSToPS
 {
 	float4 Position : SV_POSITION;
 	float3 Normal : NORMAL;
+	nointerpolation uint MaterialID : MATERIALID;
 };
 
 struct GeometryPass_PSOutput
@@ -41,4 +42,19 @@ struct DepthPass_VSOutput // No PS used for depth pass
 	float4 Position : SV_POSITION;
 };
 
+
+// Instancing
+// Requires StructureHlslCompat.h to be included first
+
+float3 InstanceTransformPoint(InstanceGPUData instance, float3 p)
+{
+	const float4 p4 = float4(p, 1.0f);
+	return float3(dot(instance.WorldMat[0], p4), dot(instance.WorldMat[1], p4), dot(instance.WorldMat[2], p4));
+}
+
+float3 InstanceTransformDirection(InstanceGPUData instance, float3 d)
+{
+	return float3(dot(instance.WorldMat[0].xyz, d), dot(instance.WorldMat[1].xyz, d), dot(instance.WorldMat[2].xyz, d));
+}
+
 #endif
@@ -6,16 +6,23 @@
 
 #include "deferred_rendering.hlsli"
 
-ConstantBuffer<ObjectConstantBuffer> g_ObjectCB : register(b0);
+ConstantBuffer<InstanceDrawConstants> g_DrawConstants : register(b0);
 ConstantBuffer<LightingConstantBuffer> g_LightingCB : register(b1);
+ConstantBuffer<ShadowPassConstants> g_ShadowPassConstants : register(b2);
 
+StructuredBuffer<InstanceGPUData> g_InstanceBuffer : register(t1);
+StructuredBuffer<uint> g_InstanceIndices : register(t2);
 
-DepthPass_VSOutput main(/* Same input as geometry pass */ GeometryPass_VSInput input)
+
+DepthPass_VSOutput main(/* Same input as geometry pass */ GeometryPass_VSInput input, uint instanceID : SV_InstanceID)
 {
 	DepthPass_VSOutput output;
 
-	const float4 worldPos = mul(input.Position, g_ObjectCB.WorldMat);
-	output.Position = mul(worldPos, g_LightingCB.DirectionalLight.ViewProjection);
+	// Instances are grouped by geometry, so look up which instance this is
+	const InstanceGPUData instance = g_InstanceBuffer[g_InstanceIndices[g_DrawConstants.BaseInstance + instanceID]];
+
+	const float4 worldPos = float4(InstanceTransformPoint(instance, input.Position.xyz), 1.0f);
+	output.Position = mul(worldPos, g_LightingCB.DirectionalLight.CascadeViewProjection[g_ShadowPassConstants.CascadeIndex]);
 
 	return output;
 }
@@ -6,7 +6,6 @@
 
 #include "deferred_rendering.hlsli"
 
-ConstantBuffer<ObjectConstantBuffer> g_ObjectCB : register(b0);
 ConstantBuffer<PassConstantBuffer> g_PassCB : register(b1);
 
 StructuredBuffer<MaterialGPUData> g_MaterialBuffer : register(t0);
@@ -19,7 +18,7 @@ GeometryPass_PSOutput main(GeometryPass_VSToPS input)
 	output.Normal = 0.5f * normalize(input.Normal) + 0.5f;
 
 	// Load material parameters
-	const MaterialGPUData material = g_MaterialBuffer[g_ObjectCB.MaterialID];
+	const MaterialGPUData material = g_MaterialBuffer[input.MaterialID];
 
 	output.Albedo = material.Albedo;
 	output.RoughnessMetalness = float2(material.Roughness, material.Metalness);
@@ -6,18 +6,25 @@
 
 #include "deferred_rendering.hlsli"
 
-ConstantBuffer<ObjectConstantBuffer> g_ObjectCB : register(b0);
+ConstantBuffer<InstanceDrawConstants> g_DrawConstants : register(b0);
 ConstantBuffer<PassConstantBuffer> g_PassCB : register(b1);
 
+StructuredBuffer<InstanceGPUData> g_InstanceBuffer : register(t1);
+StructuredBuffer<uint> g_InstanceIndices : register(t2);
 
-GeometryPass_VSToPS main(GeometryPass_VSInput input)
+
+GeometryPass_VSToPS main(GeometryPass_VSInput input, uint instanceID : SV_InstanceID)
 {
 	GeometryPass_VSToPS output;
 
-	const float4 worldPos = mul(input.Position, g_ObjectCB.WorldMat);
+	// Instances are grouped by geometry, so look up which instance this is
+	const InstanceGPUData instance = g_InstanceBuffer[g_InstanceIndices[g_DrawConstants.BaseInstance + instanceID]];
+
+	const float4 worldPos = float4(InstanceTransformPoint(instance, input.Position.xyz), 1.0f);
 	output.Position = mul(worldPos, g_PassCB.ViewProj);
 
-	output.Normal = mul(float4(input.Normal, 0.0f), g_ObjectCB.WorldMat).xyz;
+	output.Normal = InstanceTransformDirection(instance, input.Normal);
+	output.MaterialID = instance.MaterialID;
 
 	return output;
 }
@@ -6,6 +6,8 @@
 
 #include "../include/lighting_helper.hlsli"
 #include "../include/lighting_ibl.hlsli"
+#include "../include/shadows.hlsli"
+#include "../include/clustered_lighting.hlsli"
 
 
 ConstantBuffer<PassConstantBuffer> g_PassCB : register(b0, space0);
@@ -19,6 +21,8 @@ Texture2D<float> g_Depth : register(t3, space0);
 // Scene lighting
 ConstantBuffer<LightingConstantBuffer> g_LightCB : register(b1, space0);
 StructuredBuffer<PointLightGPUData> g_PointLights : register(t4, space0);
+StructuredBuffer<uint2> g_ClusterLightGrid : register(t5, space0);		// (first index, light count) for each cluster
+StructuredBuffer<uint> g_ClusterLightIndices : register(t6, space0);
 
 // Environmental lighting resources
 TextureCube g_IrradianceMap : register(t0, space1);
@@ -26,7 +30,7 @@ Texture2D g_BRDFIntegrationMap : register(t1, space1);
 TextureCube g_PrefilteredEnvironmentMap : register(t2, space1);
 
 // Shadows
-Texture2D<float> g_SunShadowMap : register(t0, space2);
+Texture2DArray<float> g_SunShadowMap : register(t0, space2);	// One slice per cascade
 
 // Samplers
 SamplerState g_EnvironmentSampler : register(s0, space0);
@@ -48,7 +52,8 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	}
 
 	// Recover NDC coordinates from thread ID
-	float2 uv = (DTid.xy + float2(0.5f, 0.5f)) / float2(dims.xy);
+	const float2 screenUV = (DTid.xy + float2(0.5f, 0.5f)) / float2(dims.xy);
+	float2 uv = screenUV;
 	uv.y = 1.0f - uv.y;
 	float2 ndc = 2.0f * uv - 1.0f;
 
@@ -63,6 +68,8 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	float4 worldPos = mul(float4(ndc, depth, 1.0f), g_PassCB.InvViewProj);
 	worldPos = worldPos / worldPos.w;
 
+	const float viewDepth = mul(worldPos, g_PassCB.View).z;
+
 	// get view vector
 	const float3 v = normalize(g_PassCB.WorldEyePos - worldPos.xyz);
 
@@ -85,13 +92,13 @@ void main(uint3 DTid : SV_DispatchThreadID)
 		const float3 brdf = ggx_brdf(v, l, normal, albedo, f0, roughnessMetallic.x, roughnessMetallic.y);
 
 		// determine visibility
-		float visible;
-		{
-			float4 shadowPos = mul(worldPos, g_LightCB.DirectionalLight.ViewProjection);
-			shadowPos /= shadowPos.w;
+		// Anything beyond the last cascade is treated as lit
+		float visible = 1.0f;
 
-			float2 shadowMapUV = shadowPos.xy * 0.5f + 0.5f;
-			shadowMapUV.y = 1.0f - shadowMapUV.y;
+		const uint cascade = SelectShadowCascade(viewDepth, g_LightCB.DirectionalLight.CascadeSplits, g_LightCB.DirectionalLight.CascadeCount);
+		if (cascade < g_LightCB.DirectionalLight.CascadeCount)
+		{
+			const float3 shadowCoords = GetShadowCascadeCoords(worldPos.xyz, g_LightCB.DirectionalLight.CascadeViewProjection[cascade]);
 
 			const int2 offsets[9] =
 			{
@@ -110,7 +117,7 @@ void main(uint3 DTid : SV_DispatchThreadID)
 			[unroll]
 			for (uint i = 0; i < 9; i++)
 			{
-				percentLit += g_SunShadowMap.SampleCmpLevelZero(g_ShadowMapSampler, shadowMapUV, shadowPos.z, offsets[i]);
+				percentLit += g_SunShadowMap.SampleCmpLevelZero(g_ShadowMapSampler, float3(shadowCoords.xy, cascade), shadowCoords.z, offsets[i]);
 			}
 			visible = percentLit / 9.0f;
 		}
@@ -119,11 +126,15 @@ void main(uint3 DTid : SV_DispatchThreadID)
 		lo += visible * brdf * el * saturate(dot(normal, l));
 	}
 
-	// Apply lighting from all point lights
-	for (uint i = 0; i < g_LightCB.PointLightCount; i++)
+	// Apply lighting from the point lights that reach this pixel's cluster
+	const float froxelSlice = FroxelDepthToZSlice(viewDepth, g_LightCB.ClusterNearDepth, g_LightCB.ClusterFarDepth, g_LightCB.ClusterFroxelSliceCount,
+		g_LightCB.ClusterDepthDistribution, g_LightCB.ClusterHybridLinearDepth);
+	const uint cluster = GetLightClusterIndex(screenUV, froxelSlice, g_LightCB.ClusterGridDimensions, g_LightCB.ClusterDepthScale);
+	const uint2 clusterLights = g_ClusterLightGrid[cluster];
+	for (uint i = 0; i < clusterLights.y; i++)
 	{
 		// Get lighting parameters
-		const PointLightGPUData light = g_PointLights[i];
+		const PointLightGPUData light = g_PointLights[g_ClusterLightIndices[clusterLights.x + i]];
 		const float3 l = normalize(light.Position.xyz - worldPos.xyz);
 		const float3 el = light.Color * light.Intensity;
 		const float d = length(light.Position.xyz - worldPos.xyz);
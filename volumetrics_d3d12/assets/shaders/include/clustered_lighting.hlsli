@@ -0,0 +1,18 @@
+#ifndef CLUSTERED_LIGHTING_HLSLI
+#define CLUSTERED_LIGHTING_HLSLI
+
+#include "../HlslCompat/VolumetricsHlslCompat.h"
+
+
+// Returns the index of the light cluster containing a point
+// screenUV has its origin in the top-left corner of the screen, matching the order of the CPU-side tiles
+// froxelSlice is the point's fractional slice in the volumetrics volume (see FroxelDepthToZSlice)
+uint GetLightClusterIndex(float2 screenUV, float froxelSlice, uint3 gridDimensions, float clusterDepthScale)
+{
+	const uint2 tile = min(uint2(saturate(screenUV) * gridDimensions.xy), gridDimensions.xy - 1);
+	const uint slice = (uint) clamp(froxelSlice * clusterDepthScale, 0.0f, (float) (gridDimensions.z - 1));
+
+	return (slice * gridDimensions.y + tile.y) * gridDimensions.x + tile.x;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef SHADOWS_HLSLI
+#define SHADOWS_HLSLI
+
+
+// Returns the cascade that covers a view-space depth, or cascadeCount if it is beyond the last cascade
+uint SelectShadowCascade(float viewDepth, float4 cascadeSplits, uint cascadeCount)
+{
+	uint cascade = 0;
+
+	[unroll]
+	for (uint i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		cascade += (i < cascadeCount && viewDepth > cascadeSplits[i]) ? 1 : 0;
+	}
+	return cascade;
+}
+
+// Projects a world-space position into a shadow cascade
+// Returns the shadow map UV in xy and the depth in light space in z
+float3 GetShadowCascadeCoords(float3 worldPos, float4x4 cascadeViewProjection)
+{
+	float4 shadowPos = mul(float4(worldPos, 1.0f), cascadeViewProjection);
+	shadowPos /= shadowPos.w;
+
+	float2 shadowMapUV = shadowPos.xy * 0.5f + 0.5f;
+	shadowMapUV.y = 1.0f - shadowMapUV.y;
+
+	return float3(shadowMapUV, shadowPos.z);
+}
+
+#endif
\ No newline at end of file
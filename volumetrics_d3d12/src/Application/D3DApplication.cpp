@@ -8,16 +8,19 @@
 #include <imgui_internal.h>
 
 #include "Renderer/Lighting/IBL.h"
+#include "Renderer/Lighting/VolumetricsSweep.h"
 #include "Renderer/Profiling/GPUProfiler.h"
 
 #include <args.hxx>
 
 #include "pix3.h"
 
+#include <filesystem>
 #include <fstream>
 
 #include "Renderer/D3DDebugTools.h"
 #include "Framework/GuiHelpers.h"
+#include "Framework/ThreadPool.h"
 
 #include "Scenes/VolumetricScene.h"
 
@@ -66,6 +69,25 @@ bool D3DApplication::ParseCommandLineArgs(LPWSTR argv[], int argc)
 	args::Group applicationFlags(parser, "Application Flags");
 	args::Flag orbitalCamera(applicationFlags, "Orbital Camera", "Enable an orbital camera", { "orbital-camera" });
 
+	// Sweeps froxel settings on the CPU and exits, without creating a window
+	bool runSweep = false;
+	VolumetricsSweep::Desc sweepDesc;
+	std::string sweepOutput;
+	args::Command sweepCommand(parser, "sweep", "Measure the error and cost of froxel settings against a ray marched ground truth, then exit", [&](args::Subparser& subparser)
+		{
+			args::ValueFlag<std::string> output(subparser, "path", "Path of the CSV and JSON results, without an extension", { 'o', "output" }, "volumetrics_sweep");
+			args::ValueFlag<float> threshold(subparser, "error", "Largest relative RMS error of a recommended configuration", { "threshold" }, sweepDesc.ErrorThreshold);
+			args::ValueFlag<UINT> lights(subparser, "count", "Number of point lights in the scene", { "lights" }, sweepDesc.PointLightCount);
+			args::ValueFlag<float> step(subparser, "length", "World-space step of the ground truth", { "step" }, sweepDesc.GroundTruthStepLength);
+			subparser.Parse();
+
+			sweepOutput = args::get(output);
+			sweepDesc.ErrorThreshold = args::get(threshold);
+			sweepDesc.PointLightCount = args::get(lights);
+			sweepDesc.GroundTruthStepLength = args::get(step);
+			runSweep = true;
+		});
+
 #ifdef ENABLE_INSTRUMENTATION
 	// These settings won't do anything in a non-instrumented build
 	args::Command profilingCommand(parser, "profile", "Launch application in profiling mode", [this](args::Subparser& subparser)
@@ -112,6 +134,17 @@ bool D3DApplication::ParseCommandLineArgs(LPWSTR argv[], int argc)
 	if (orbitalCamera)
 		m_UseOrbitalCamera = true;
 
+	if (runSweep)
+	{
+		VolumetricsSweep sweep(ThreadPool::GetDefault());
+		sweep.Run(sweepDesc);
+		LOG_INFO(sweep.FormatSummary());
+
+		sweep.SaveCSV(sweepOutput + ".csv");
+		sweep.SaveJSON(sweepOutput + ".json");
+		return false;
+	}
+
 	return true;
 }
 
@@ -156,12 +189,15 @@ void D3DApplication::OnInit()
 		config.BytesPerChannel = 1;
 		config.ResourceState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
 
-		// This will all take a very long time...
-		auto environmentMap = m_TextureLoader->LoadTextureCubeFromFile("assets/textures/environment.png", &config, L"EnvironmentMap");
+		// This will all take a very long time, unless the maps derived from the environment map are cached
+		TextureLoader::DecodedImage decodedEnvironmentMap;
+		auto environmentMap = m_TextureLoader->LoadTextureCubeFromFile("assets/textures/environment.png", &config, L"EnvironmentMap", &decodedEnvironmentMap);
+
+		// The decoded texels are freed once they are uploaded
+		m_LightManager->GetIBL()->PrepareEnvironmentMap(decodedEnvironmentMap);
 
 		m_TextureLoader->PerformUploadsImmediatelyAndBlock();
 		m_LightManager->GetIBL()->ProcessEnvironmentMap(std::move(environmentMap));
-		m_LightManager->GetIBL()->ProjectIrradianceMapToSH();
 	}
 
 	LOG_INFO("Application startup complete.");
@@ -242,7 +278,7 @@ void D3DApplication::OnRender()
 
 	// Update constant buffer
 	UpdatePassCB();
-	m_LightManager->UpdateLightingCB(m_Camera.GetPosition());
+	m_LightManager->UpdateLightingCB(m_Camera);
 
 	m_MaterialManager->UploadMaterialData();
 	m_LightManager->CopyStagingBuffers();
@@ -261,7 +297,7 @@ void D3DApplication::OnRender()
 	m_Scene->PreRender();
 
 	// Render scene
-	m_DeferredRenderer->Render();
+	m_DeferredRenderer->Render(m_Camera);
 
 	// Copy output from deferred renderer to back buffer
 	ID3D12Resource* outputResource = m_DeferredRenderer->GetOutputResource();
@@ -543,11 +579,55 @@ bool D3DApplication::ImGuiApplicationInfo()
 				D3DDebugTools::PIXGPUCaptureFrame(1);
 			}
 		}
+
+		ImGui::Separator();
+		if (ImGui::CollapsingHeader("Memory"))
+		{
+			ImGuiMemoryInfo();
+		}
 	}
 	ImGui::End();
 	return open;
 }
 
+void D3DApplication::ImGuiMemoryInfo()
+{
+	auto HeapInfo = [](const char* name, const DescriptorHeap* heap)
+		{
+			ImGui::Text("%-8s %6u / %6u, %u pending free, %.2f fragmentation",
+				name, heap->GetCount(), heap->GetCapacity(), heap->GetPendingFreeCount(), heap->GetFragmentation());
+		};
+
+	HeapInfo("SRV", m_GraphicsContext->GetSRVHeap());
+	HeapInfo("Sampler", m_GraphicsContext->GetSamplerHeap());
+	HeapInfo("RTV", m_GraphicsContext->GetRTVHeap());
+	HeapInfo("DSV", m_GraphicsContext->GetDSVHeap());
+
+	ImGui::Separator();
+
+	// A recorded trace is replayed offline by the tlsf_replay benchmark of volumetrics_bench
+	DescriptorHeap* srvHeap = m_GraphicsContext->GetSRVHeap();
+	if (!srvHeap->IsRecordingTrace())
+	{
+		if (ImGui::Button("Record SRV Heap Trace"))
+			srvHeap->BeginTraceRecording();
+	}
+	else
+	{
+		if (ImGui::Button("Save SRV Heap Trace"))
+		{
+			std::error_code error;
+			std::filesystem::create_directories(s_DescriptorTraceDirectory, error);
+
+			const std::string path = std::string(s_DescriptorTraceDirectory) + "/srv_heap.tlsftrace";
+			if (srvHeap->EndTraceRecording().Save(path))
+				LOG_INFO("Wrote the SRV heap trace to {}", path);
+		}
+		ImGui::SameLine();
+		ImGui::Text("%zu operations", srvHeap->GetTraceOperationCount());
+	}
+}
+
 
 
 void D3DApplication::OnResized()
@@ -61,6 +61,7 @@ private:
 
 	// ImGui Windows
 	bool ImGuiApplicationInfo();
+	void ImGuiMemoryInfo();
 
 private:
 	std::unique_ptr<D3DGraphicsContext> m_GraphicsContext;
@@ -95,6 +96,8 @@ private:
 	bool m_ShowSceneInfo = true;
 	bool m_ShowSceneControls = true;
 
+	inline static constexpr const char* s_DescriptorTraceDirectory = "cache/descriptor_traces";
+
 	float m_TimeScale = 1.0f;
 	bool m_Paused = false;
 
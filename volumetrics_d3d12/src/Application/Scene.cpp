@@ -4,6 +4,7 @@
 #include "imgui.h"
 
 #include "Framework/Math.h"
+#include "Renderer/Geometry/InstanceData.h"
 
 #include "D3DApplication.h"
 
@@ -13,38 +14,42 @@
 Scene::Scene(D3DApplication* application, UINT maxGeometryInstances)
 	: m_Application(application)
 	, m_MaxGeometryInstances(maxGeometryInstances)
-	, m_ObjectCBs(D3DGraphicsContext::GetBackBufferCount())
 {
 	ASSERT(m_Application, "Invalid app.");
 
 	// As there is a fixed max of instances, reserving them in advance ensures the vector will never re-allocate
 	m_GeometryInstances.reserve(m_MaxGeometryInstances);
-
-	for (auto& cb : m_ObjectCBs)
-	{
-		cb.Allocate(g_D3DGraphicsContext->GetDevice(), maxGeometryInstances, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, L"Object Constant Buffer");
-	}
+	m_InstanceStaging.reserve(m_MaxGeometryInstances);
 }
 
 
 void Scene::PreRender()
 {
-	const auto& objectCB = m_ObjectCBs.at(g_D3DGraphicsContext->GetCurrentBackBuffer());
+	m_InstanceStaging.resize(m_GeometryInstances.size());
 
 	for (auto& geometryInstance : m_GeometryInstances)
 	{
 		if (geometryInstance.IsDirty())
 		{
-			ObjectConstantBuffer cbData = {};
-			cbData.WorldMat = XMMatrixTranspose(geometryInstance.GetTransform().GetWorldMatrix());
 			const Material* material = geometryInstance.GetMaterial();
-			cbData.MaterialID = material ? material->GetMaterialID() : 0;
-
-			objectCB.CopyElement(geometryInstance.GetInstanceID(), cbData);
+			PackInstanceGPUData(
+				geometryInstance.GetTransform().GetWorldMatrix(),
+				material ? material->GetMaterialID() : 0,
+				m_InstanceStaging.at(geometryInstance.GetInstanceID()));
 
 			geometryInstance.DecrementFramesDirty();
 		}
 	}
+
+	if (m_InstanceStaging.empty())
+		return;
+
+	// Upload every instance into this frame's memory
+	const UploadAllocation allocation = g_D3DGraphicsContext->GetFrameUploadAllocator()->AllocateElements(
+		m_InstanceStaging.data(), static_cast<UINT>(m_InstanceStaging.size()), alignof(InstanceGPUData));
+	ASSERT(allocation.IsValid(), "Failed to allocate instance buffer");
+
+	m_InstanceBufferAddress = allocation.GPUAddress;
 }
 
 
@@ -64,18 +69,11 @@ GeometryInstance* Scene::CreateGeometryInstance(size_t geometryHandle)
 	}
 
 	UINT instanceID = static_cast<UINT>(m_GeometryInstances.size());
-	m_GeometryInstances.emplace_back(instanceID, m_Geometries.at(geometryHandle).get());
+	m_GeometryInstances.emplace_back(instanceID, m_Geometries.at(geometryHandle).get(), static_cast<UINT>(geometryHandle));
 	return &m_GeometryInstances.back();
 }
 
 
-D3D12_GPU_VIRTUAL_ADDRESS Scene::GetObjectCBAddress(UINT object) const
-{
-	return m_ObjectCBs.at(g_D3DGraphicsContext->GetCurrentBackBuffer()).GetAddressOfElement(object);
-}
-
-
-
 bool Scene::DisplayGeneralGui() const
 {
 	bool open = false;
@@ -30,7 +30,8 @@ public:
 	inline const std::vector<GeometryInstance>& GetAllGeometryInstances() const { return m_GeometryInstances; }
 	inline const std::vector<std::unique_ptr<TriangleGeometry>>& GetAllGeometries() const { return m_Geometries; }
 
-	D3D12_GPU_VIRTUAL_ADDRESS GetObjectCBAddress(UINT object = 0) const;
+	// Structured buffer of InstanceGPUData for every geometry instance, indexed by instance ID
+	inline D3D12_GPU_VIRTUAL_ADDRESS GetInstanceBufferAddress() const { return m_InstanceBufferAddress; }
 
 	// Gui
 	virtual bool DisplayGui() { return false; }
@@ -46,7 +47,10 @@ private:
 	UINT m_MaxGeometryInstances = 0;
 	std::vector<GeometryInstance> m_GeometryInstances;
 
+	// CPU copy of the instance data, so that only dirty instances need to be rebuilt each frame
+	std::vector<InstanceGPUData> m_InstanceStaging;
+
 	// GPU Data for the geometry instances
-	// One buffer for each set of frame resources
-	std::vector<UploadBuffer<ObjectConstantBuffer>> m_ObjectCBs;
+	// This is re-allocated from the frame's upload memory each frame
+	D3D12_GPU_VIRTUAL_ADDRESS m_InstanceBufferAddress = 0;
 };
@@ -48,6 +48,11 @@ void Camera::RebuildProjIfDirty()
 	}
 }
 
+Frustum Camera::GetFrustum()
+{
+	return Frustum::FromViewProjection(XMMatrixMultiply(GetViewMatrix(), GetProjectionMatrix()));
+}
+
 void Camera::ClampYaw()
 {
 	if (m_Yaw > 3.14f)
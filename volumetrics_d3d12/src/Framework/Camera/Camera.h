@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Framework/Frustum.h"
+
 using namespace DirectX;
 
 
@@ -43,6 +45,9 @@ public:
 
 	inline const XMMATRIX& GetProjectionMatrix() { RebuildProjIfDirty(); return m_ProjectionMatrix; }
 
+	// World-space view frustum
+	Frustum GetFrustum();
+
 private:
 	void RebuildViewIfDirty();
 	void RebuildProjIfDirty();
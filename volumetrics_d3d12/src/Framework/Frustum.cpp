@@ -0,0 +1,24 @@
+#include "pch.h"
+#include "Frustum.h"
+
+
+Frustum Frustum::FromViewProjection(const XMMATRIX& viewProjection)
+{
+	// With row vectors, each clip-space component is the dot product of the position with a column of the matrix
+	const XMMATRIX m = XMMatrixTranspose(viewProjection);
+
+	XMVECTOR planes[Plane_Count];
+	planes[Plane_Left] = m.r[3] + m.r[0];		// -w <= x
+	planes[Plane_Right] = m.r[3] - m.r[0];		//  x <= w
+	planes[Plane_Bottom] = m.r[3] + m.r[1];		// -w <= y
+	planes[Plane_Top] = m.r[3] - m.r[1];		//  y <= w
+	planes[Plane_Near] = m.r[2];				//  0 <= z
+	planes[Plane_Far] = m.r[3] - m.r[2];		//  z <= w
+
+	Frustum frustum;
+	for (UINT i = 0; i < Plane_Count; i++)
+	{
+		XMStoreFloat4(&frustum.Planes.at(i), XMPlaneNormalize(planes[i]));
+	}
+	return frustum;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+using namespace DirectX;
+
+
+/**
+ *	The six planes bounding a view volume, pointing inwards.
+ *	A point p is inside the volume when dot(plane.xyz, p) + plane.w >= 0 for every plane.
+ */
+struct Frustum
+{
+	enum Plane
+	{
+		Plane_Left = 0,
+		Plane_Right,
+		Plane_Bottom,
+		Plane_Top,
+		Plane_Near,
+		Plane_Far,
+		Plane_Count
+	};
+
+	std::array<XMFLOAT4, Plane_Count> Planes;
+
+	// Extracts the planes from a (row-vector convention, D3D clip space) view-projection matrix
+	// Works for both perspective and orthographic projections
+	static Frustum FromViewProjection(const XMMATRIX& viewProjection);
+
+	// Replaces a plane with one that accepts every point, leaving the volume unbounded in that direction
+	inline void DisablePlane(Plane plane) { Planes.at(plane) = { 0.0f, 0.0f, 0.0f, 1.0f }; }
+};
@@ -0,0 +1,122 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+
+// Set on worker threads, and on a thread while it is inside a ParallelFor, so that nested calls run serially
+static thread_local bool t_InsideParallelFor = false;
+
+
+ThreadPool::ThreadPool(UINT workerCount)
+{
+	m_Workers.reserve(workerCount);
+	for (UINT i = 0; i < workerCount; i++)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Exit = true;
+	}
+	m_WorkAvailable.notify_all();
+
+	for (auto& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+
+void ThreadPool::ParallelFor(UINT count, UINT grainSize, const RangeFunction& func)
+{
+	if (count == 0)
+		return;
+
+	grainSize = max(grainSize, 1u);
+
+	// Not worth waking the workers for a single chunk
+	if (t_InsideParallelFor || m_Workers.empty() || count <= grainSize)
+	{
+		func(0, count);
+		return;
+	}
+
+	std::lock_guard submitLock(m_SubmitMutex);
+	t_InsideParallelFor = true;
+
+	{
+		std::lock_guard lock(m_Mutex);
+		m_Function = &func;
+		m_Count = count;
+		m_GrainSize = grainSize;
+		m_NextIndex.store(0, std::memory_order_relaxed);
+		m_RangeOpen = true;
+		m_Generation++;
+	}
+	m_WorkAvailable.notify_all();
+
+	ProcessChunks();
+
+	// Close the range so that late workers do not join, then wait for those still running a chunk
+	{
+		std::unique_lock lock(m_Mutex);
+		m_RangeOpen = false;
+		m_WorkComplete.wait(lock, [this] { return m_ActiveWorkers == 0; });
+		m_Function = nullptr;
+	}
+
+	t_InsideParallelFor = false;
+}
+
+ThreadPool& ThreadPool::GetDefault()
+{
+	static ThreadPool pool(max(std::thread::hardware_concurrency(), 1u) - 1);
+	return pool;
+}
+
+
+void ThreadPool::WorkerLoop()
+{
+	t_InsideParallelFor = true;
+
+	UINT64 seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock lock(m_Mutex);
+			m_WorkAvailable.wait(lock, [&] { return m_Exit || m_Generation != seenGeneration; });
+			if (m_Exit)
+				return;
+
+			seenGeneration = m_Generation;
+			if (!m_RangeOpen)
+				continue;
+
+			m_ActiveWorkers++;
+		}
+
+		ProcessChunks();
+
+		{
+			std::lock_guard lock(m_Mutex);
+			m_ActiveWorkers--;
+		}
+		m_WorkComplete.notify_one();
+	}
+}
+
+void ThreadPool::ProcessChunks()
+{
+	while (true)
+	{
+		const UINT begin = m_NextIndex.fetch_add(m_GrainSize, std::memory_order_relaxed);
+		if (begin >= m_Count)
+			return;
+
+		const UINT end = min(begin + m_GrainSize, m_Count);
+		(*m_Function)(begin, end);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Core.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+
+/**
+ *	A ThreadPool keeps a set of worker threads alive for the lifetime of the application,
+ *	so that per-frame CPU work can be split across cores without creating threads every frame.
+ *
+ *	Work is submitted as a range of indices which is split into chunks. The workers and the calling thread
+ *	take chunks until the range is exhausted, and ParallelFor returns once every chunk has completed.
+ *	Only one range is processed at a time; a ParallelFor issued from inside a chunk runs serially on that thread.
+ */
+class ThreadPool
+{
+public:
+	// Called with a half-open range [begin, end) of indices to process
+	using RangeFunction = std::function<void(UINT begin, UINT end)>;
+
+public:
+	// workerCount does not include the calling thread, so a pool with no workers runs everything serially
+	ThreadPool(UINT workerCount);
+	~ThreadPool();
+
+	DISALLOW_COPY(ThreadPool)
+	DISALLOW_MOVE(ThreadPool)
+
+	// Calls func over [0, count) in chunks of at most grainSize indices
+	void ParallelFor(UINT count, UINT grainSize, const RangeFunction& func);
+
+	// Including the calling thread
+	inline UINT GetThreadCount() const { return static_cast<UINT>(m_Workers.size()) + 1; }
+
+	// A pool with a worker for every hardware thread except the calling one, created on first use
+	static ThreadPool& GetDefault();
+
+private:
+	void WorkerLoop();
+	// Takes chunks of the current range until there are none left
+	void ProcessChunks();
+
+private:
+	std::vector<std::thread> m_Workers;
+
+	// Serialises ParallelFor calls made from different threads
+	std::mutex m_SubmitMutex;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkAvailable;
+	std::condition_variable m_WorkComplete;
+	bool m_Exit = false;
+
+	// The current range. Workers may only join while the range is open
+	UINT64 m_Generation = 0;
+	bool m_RangeOpen = false;
+	UINT m_ActiveWorkers = 0;
+	const RangeFunction* m_Function = nullptr;
+	UINT m_Count = 0;
+	UINT m_GrainSize = 1;
+	std::atomic<UINT> m_NextIndex = 0;
+};
@@ -69,6 +69,21 @@ public:
 		return value;
 	}
 
+	// Reads count consecutive elements with a single map
+	void ReadElements(UINT firstElement, UINT count, T* outValues) const
+	{
+		ASSERT(firstElement + count <= m_ElementCount, "Out of bounds access");
+		ASSERT(m_ElementStride == sizeof(T), "Cannot bulk read padded elements");
+
+		T* pData;
+
+		const CD3DX12_RANGE readRange(firstElement * sizeof(T), (firstElement + count) * sizeof(T));
+
+		THROW_IF_FAIL(m_ReadbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
+		memcpy(outValues, pData + firstElement, count * sizeof(T));
+		m_ReadbackBuffer->Unmap(0, nullptr);
+	}
+
 private:
 	ComPtr<ID3D12Resource> m_ReadbackBuffer;
 
@@ -25,3 +25,18 @@ void Texture::Allocate(const D3D12_RESOURCE_DESC* const desc, D3D12_RESOURCE_STA
 
 	D3D_NAME(m_Resource, resourceName);
 }
+
+void Texture::AllocatePlaced(ID3D12Heap* heap, UINT64 heapOffset, const D3D12_RESOURCE_DESC* const desc, D3D12_RESOURCE_STATES initialState, const wchar_t* resourceName, const D3D12_CLEAR_VALUE* const clearValue)
+{
+	m_Format = desc->Format;
+
+	THROW_IF_FAIL(g_D3DGraphicsContext->GetDevice()->CreatePlacedResource(
+		heap,
+		heapOffset,
+		desc,
+		initialState,
+		clearValue,
+		IID_PPV_ARGS(&m_Resource)));
+
+	D3D_NAME(m_Resource, resourceName);
+}
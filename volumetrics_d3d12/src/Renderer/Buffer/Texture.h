@@ -17,6 +17,8 @@ public:
 	DEFAULT_MOVE(Texture);
 
 	void Allocate(const D3D12_RESOURCE_DESC* const desc, D3D12_RESOURCE_STATES initialState, const wchar_t* resourceName, const D3D12_CLEAR_VALUE* const clearValue = nullptr);
+	// Creates the texture at an offset in an existing heap, where it may alias other resources
+	void AllocatePlaced(ID3D12Heap* heap, UINT64 heapOffset, const D3D12_RESOURCE_DESC* const desc, D3D12_RESOURCE_STATES initialState, const wchar_t* resourceName, const D3D12_CLEAR_VALUE* const clearValue = nullptr);
 
 	inline ID3D12Resource* GetResource() const { return m_Resource.Get(); }
 	inline DXGI_FORMAT GetFormat() const { return m_Format; }
@@ -66,7 +66,7 @@ std::unique_ptr<Texture> TextureLoader::LoadTextureFromFile(const std::string& f
 }
 
 
-std::unique_ptr<Texture> TextureLoader::LoadTextureCubeFromFile(const std::string& filename, const LoadTextureConfig* const config, const wchar_t* resourceName)
+std::unique_ptr<Texture> TextureLoader::LoadTextureCubeFromFile(const std::string& filename, const LoadTextureConfig* const config, const wchar_t* resourceName, DecodedImage* decodedImage)
 {
 	int width, height, channels;
 
@@ -103,6 +103,15 @@ std::unique_ptr<Texture> TextureLoader::LoadTextureCubeFromFile(const std::strin
 	job.ResourceState = config->ResourceState;
 	job.ElementStride = config->BytesPerChannel * channels;
 
+	if (decodedImage)
+	{
+		decodedImage->Data = data;
+		decodedImage->Width = static_cast<UINT>(width);
+		decodedImage->Height = static_cast<UINT>(height);
+		decodedImage->Channels = config->DesiredChannels;
+		decodedImage->BytesPerChannel = config->BytesPerChannel;
+	}
+
 	return tex;
 }
 
@@ -18,6 +18,16 @@ public:
 		D3D12_RESOURCE_STATES ResourceState;
 	};
 
+	// Texels as they were decoded from a file, before they are uploaded
+	struct DecodedImage
+	{
+		const unsigned char* Data = nullptr;
+		UINT Width = 0;
+		UINT Height = 0;
+		UINT Channels = 0;
+		UINT BytesPerChannel = 0;
+	};
+
 public:
 	TextureLoader();
 	~TextureLoader();
@@ -26,7 +36,8 @@ public:
 	DEFAULT_MOVE(TextureLoader);
 
 	std::unique_ptr<Texture> LoadTextureFromFile(const std::string& filename, const LoadTextureConfig* const config, const wchar_t* resourceName);
-	std::unique_ptr<Texture> LoadTextureCubeFromFile(const std::string& filename, const LoadTextureConfig* const config, const wchar_t* resourceName);
+	// When decodedImage is given, it is pointed at the decoded texels, which are only valid until the next PerformUploads
+	std::unique_ptr<Texture> LoadTextureCubeFromFile(const std::string& filename, const LoadTextureConfig* const config, const wchar_t* resourceName, DecodedImage* decodedImage = nullptr);
 
 	void PerformUploads();
 	void PerformUploadsImmediatelyAndBlock();
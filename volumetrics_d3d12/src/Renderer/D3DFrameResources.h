@@ -3,8 +3,7 @@
 using Microsoft::WRL::ComPtr;
 
 #include "Core.h"
-#include "Memory/MemoryAllocator.h"
-#include "Buffer/UploadBuffer.h"
+#include "Memory/LinearUploadAllocator.h"
 
 #include "HlslCompat/StructureHlslCompat.h"
 
@@ -22,8 +21,7 @@ public:
 	inline ID3D12CommandAllocator* GetCommandAllocator() const { return m_CommandAllocator.Get(); }
 	inline UINT64 GetFenceValue() const { return m_FenceValue; }
 
-	inline D3D12_GPU_DESCRIPTOR_HANDLE GetPassCBV() const { return m_CBVs.GetGPUHandle(m_PassCBV); }
-	inline D3D12_GPU_VIRTUAL_ADDRESS GetPassCBAddress() const { return m_PassCB.GetAddressOfElement(0); }
+	inline D3D12_GPU_VIRTUAL_ADDRESS GetPassCBAddress() const { return m_PassCBAddress; }
 
 	// Reset alloc
 	inline void ResetAllocator() const { THROW_IF_FAIL(m_CommandAllocator->Reset()); }
@@ -33,7 +31,7 @@ public:
 	inline void SetFence(UINT64 fence) { m_FenceValue = fence; }
 
 	// Upload new constant buffer data
-	inline void CopyPassData(const PassConstantBuffer& passData) const { m_PassCB.CopyElement(0, passData); }
+	void CopyPassData(LinearUploadAllocator& uploadAllocator, const PassConstantBuffer& passData);
 
 	void DeferRelease(const ComPtr<IUnknown>& resource);
 	void ProcessDeferrals();
@@ -45,11 +43,8 @@ private:
 	UINT64 m_FenceValue = 0;
 
 	// Constant buffers
-	UploadBuffer<PassConstantBuffer> m_PassCB;		// All data that is constant per pass
-
-	// Constant buffer views
-	DescriptorAllocation m_CBVs;
-	UINT m_PassCBV = -1;
+	// The pass CB is re-allocated from the frame's upload memory each frame
+	D3D12_GPU_VIRTUAL_ADDRESS m_PassCBAddress = 0;	// All data that is constant per pass
 
 	// Resources to be released when the GPU is finished with them
 	// A release collection is required per frame resources to ensure that
@@ -55,6 +55,7 @@ D3DGraphicsContext::D3DGraphicsContext(HWND window, UINT width, UINT height, con
 
 	CreateRTVs();
 	CreateFrameResources();
+	CreateFrameUploadAllocator();
 	CreateDepthStencilBuffer();
 
 	if (CheckRaytracingSupport())
@@ -106,6 +107,9 @@ D3DGraphicsContext::~D3DGraphicsContext()
 	m_DSV.Free();
 	m_ImGuiResources.Free();
 
+	m_TransientSRVRing.reset();
+	m_TransientSRVs.Free();
+
 	// Free frame resources
 	for (UINT n = 0; n < s_FrameCount; n++)
 		m_FrameResources[n].reset();
@@ -167,7 +171,7 @@ bool D3DGraphicsContext::CheckDeviceRemovedStatus() const
 
 void D3DGraphicsContext::StartDraw(const PassConstantBuffer& passCB) const
 {
-	m_CurrentFrameResources->CopyPassData(passCB);
+	m_CurrentFrameResources->CopyPassData(*m_FrameUploadAllocator, passCB);
 
 
 	PIXBeginEvent(PIX_COLOR_INDEX(2), L"Start Draw");
@@ -305,6 +309,10 @@ void D3DGraphicsContext::Resize(UINT width, UINT height)
 	CreateRTVs();
 	CreateDepthStencilBuffer();
 
+	// The GPU is idle, so the transient allocators can safely follow the frame index
+	m_TransientSRVRing->BeginFrame(m_FrameIndex);
+	m_FrameUploadAllocator->BeginFrame(m_FrameIndex);
+
 	m_Viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(m_ClientWidth), static_cast<float>(m_ClientHeight));
 	m_ScissorRect = CD3DX12_RECT(0, 0, static_cast<LONG>(m_ClientWidth), static_cast<LONG>(m_ClientHeight));
 
@@ -472,9 +480,16 @@ void D3DGraphicsContext::CreateDescriptorHeaps()
 
 	// SRV/CBV/UAV heap
 	constexpr UINT Count = 256;
-	m_SRVHeap = std::make_unique<DescriptorHeap>(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, Count, false);
+	m_SRVHeap = std::make_unique<DescriptorHeap>(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, Count + s_FrameCount * s_TransientSRVsPerFrame, false);
 
 	m_SamplerHeap = std::make_unique<DescriptorHeap>(D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 8, false);
+
+	// Region of the shader visible SRV heap for descriptors that only live for one frame
+	m_TransientSRVs = m_SRVHeap->Allocate(s_TransientSRVsPerFrame * s_FrameCount);
+	ASSERT(m_TransientSRVs.IsValid(), "Failed to allocate transient descriptor ring");
+	m_TransientSRVRing = std::make_unique<TransientDescriptorRing>(m_TransientSRVs.GetCPUHandle(), m_TransientSRVs.GetGPUHandle(),
+		m_SRVHeap->GetDescriptorSize(), s_TransientSRVsPerFrame, s_FrameCount);
+	m_TransientSRVRing->BeginFrame(m_FrameIndex);
 }
 
 void D3DGraphicsContext::CreateCommandAllocator()
@@ -518,6 +533,29 @@ void D3DGraphicsContext::CreateFrameResources()
 	m_CurrentFrameResources = m_FrameResources[m_FrameIndex].get();
 }
 
+void D3DGraphicsContext::CreateFrameUploadAllocator()
+{
+	const UINT64 width = s_FrameUploadBytesPerFrame * s_FrameCount;
+
+	const CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
+	const auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(width);
+	THROW_IF_FAIL(m_Device->CreateCommittedResource(
+		&uploadHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_FrameUploadBuffer)));
+	D3D_NAME_AUTO(m_FrameUploadBuffer);
+
+	// The buffer stays mapped for its entire lifetime
+	UINT8* mappedData = nullptr;
+	THROW_IF_FAIL(m_FrameUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedData)));
+
+	m_FrameUploadAllocator = std::make_unique<LinearUploadAllocator>(mappedData, m_FrameUploadBuffer->GetGPUVirtualAddress(), s_FrameUploadBytesPerFrame, s_FrameCount);
+	m_FrameUploadAllocator->BeginFrame(m_FrameIndex);
+}
+
 void D3DGraphicsContext::CreateDepthStencilBuffer()
 {
 	// Create a resource for the depth buffer
@@ -599,14 +637,29 @@ void D3DGraphicsContext::ProcessDeferrals(UINT frameIndex) const
 	if (m_FrameResources[frameIndex])
 		m_FrameResources[frameIndex]->ProcessDeferrals();
 
-	m_RTVHeap->ProcessDeferredFree(frameIndex);
-	m_DSVHeap->ProcessDeferredFree(frameIndex);
-	m_SRVHeap->ProcessDeferredFree(frameIndex);
-	m_SamplerHeap->ProcessDeferredFree(frameIndex);
+	// The GPU has finished with this frame's transient descriptors and upload memory
+	m_TransientSRVRing->BeginFrame(frameIndex);
+	m_FrameUploadAllocator->BeginFrame(frameIndex);
+
+	// Descriptor frees are tagged with the fence value of their last use,
+	// so anything the GPU has finished with can be returned regardless of which frame freed it
+	const UINT64 completedFenceValue = m_DirectQueue->PollCurrentFenceValue();
+	m_RTVHeap->ProcessDeferredFree(completedFenceValue);
+	m_DSVHeap->ProcessDeferredFree(completedFenceValue);
+	m_SRVHeap->ProcessDeferredFree(completedFenceValue);
+	m_SamplerHeap->ProcessDeferredFree(completedFenceValue);
 }
 
 void D3DGraphicsContext::ProcessAllDeferrals() const
 {
 	for (UINT n = 0; n < s_FrameCount; ++n)
-		ProcessDeferrals(n);
-}
+	{
+		if (m_FrameResources[n])
+			m_FrameResources[n]->ProcessDeferrals();
+	}
+
+	m_RTVHeap->ProcessAllDeferredFree();
+	m_DSVHeap->ProcessAllDeferredFree();
+	m_SRVHeap->ProcessAllDeferredFree();
+	m_SamplerHeap->ProcessAllDeferredFree();
+}
\ No newline at end of file
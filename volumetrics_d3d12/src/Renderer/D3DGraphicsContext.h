@@ -2,6 +2,8 @@
 
 #include "Core.h"
 #include "Memory/MemoryAllocator.h"
+#include "Memory/TransientDescriptorRing.h"
+#include "Memory/LinearUploadAllocator.h"
 
 #include "D3DQueue.h"
 #include "HlslCompat/StructureHlslCompat.h"
@@ -95,6 +97,13 @@ public:
 	inline DescriptorHeap* GetRTVHeap() const { return m_RTVHeap.get(); }
 	inline DescriptorHeap* GetDSVHeap() const { return m_DSVHeap.get(); }
 
+	// Transient descriptors are only valid for the current frame, and can be allocated from any thread
+	inline TransientDescriptorRing* GetTransientSRVRing() const { return m_TransientSRVRing.get(); }
+
+	// Upload memory for data that is re-written every frame, such as constant buffers
+	// Allocations are only valid for the current frame, and can be made from any thread
+	inline LinearUploadAllocator* GetFrameUploadAllocator() const { return m_FrameUploadAllocator.get(); }
+
 	// For ImGui
 	inline ID3D12DescriptorHeap* GetImGuiResourcesHeap() const { return m_ImGuiResources.GetHeap(); }
 	inline D3D12_CPU_DESCRIPTOR_HANDLE GetImGuiCPUDescriptor() const { return m_ImGuiResources.GetCPUHandle(); }
@@ -127,6 +136,7 @@ private:
 	void CreateCommandList();
 	void CreateRTVs();
 	void CreateFrameResources();
+	void CreateFrameUploadAllocator();
 	void CreateDepthStencilBuffer();
 
 	// Raytracing
@@ -140,6 +150,11 @@ private:
 
 private:
 	static constexpr UINT s_FrameCount = 2;
+
+	// Size of the region of the shader visible SRV heap reserved for transient descriptors, per frame in flight
+	static constexpr UINT s_TransientSRVsPerFrame = 256;
+	// Size of the upload memory for per-frame data, per frame in flight
+	static constexpr UINT64 s_FrameUploadBytesPerFrame = 4 * 1024 * 1024;
 	UINT64 m_TotalFrameCount = 0;
 
 	// Context properties
@@ -189,12 +204,19 @@ private:
 	std::vector<std::unique_ptr<D3DFrameResources>> m_FrameResources;
 	D3DFrameResources* m_CurrentFrameResources = nullptr;
 
+	// Persistently mapped upload buffer that all per-frame data is sub-allocated from
+	ComPtr<ID3D12Resource> m_FrameUploadBuffer;
+	std::unique_ptr<LinearUploadAllocator> m_FrameUploadAllocator;
+
 	// Descriptor heaps
 	std::unique_ptr<DescriptorHeap> m_RTVHeap;
 	std::unique_ptr<DescriptorHeap> m_DSVHeap;
 	std::unique_ptr<DescriptorHeap> m_SRVHeap;				// SRV, UAV, and CBV heap (named SRVHeap for brevity)
 	std::unique_ptr<DescriptorHeap> m_SamplerHeap;
 
+	DescriptorAllocation m_TransientSRVs;	// The region of the SRV heap that the ring occupies
+	std::unique_ptr<TransientDescriptorRing> m_TransientSRVRing;
+
 	// DirectX Raytracing (DXR) objects
 	ComPtr<ID3D12Device5> m_DXRDevice;
 	ComPtr<ID3D12GraphicsCommandList4> m_DXRCommandList;
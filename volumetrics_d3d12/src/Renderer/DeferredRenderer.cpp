@@ -5,6 +5,7 @@
 #include "imgui.h"
 
 #include "Application/Scene.h"
+#include "Framework/Camera/Camera.h"
 
 #include "Lighting/LightManager.h"
 #include "Lighting/IBL.h"
@@ -20,7 +21,9 @@ namespace GeometryPassRootSignature
 {
 	enum Parameters
 	{
-		ObjectConstantBuffer = 0,
+		InstanceDrawConstants = 0,
+		InstanceBuffer,
+		InstanceIndices,
 		PassConstantBuffer,
 		MaterialBuffer,
 		Count
@@ -31,8 +34,11 @@ namespace DepthPassRootSignature
 {
 	enum Parameters
 	{
-		ObjectConstantBuffer = 0,
+		InstanceDrawConstants = 0,
+		InstanceBuffer,
+		InstanceIndices,
 		LightConstantBuffer,
+		ShadowPassConstants,
 		Count
 	};
 }
@@ -54,10 +60,11 @@ namespace LightingPassRootSignature
 	enum Parameters
 	{
 		PassConstantBuffer = 0,
-		GBuffer,				// GBuffer SRVs are sequential
-		DepthBuffer,
+		GBuffer,				// GBuffer SRVs are sequential, followed by the current depth buffer
 		LightingConstantBuffer,	// Constant buffer with universal lighting parameters
 		PointLightBuffer,		// A buffer of all point lights in the scene
+		ClusterLightGrid,		// The range of ClusterLightIndices used by each light cluster
+		ClusterLightIndices,	// Indices into PointLightBuffer of the lights in each cluster
 		EnvironmentMaps,		// Environment maps are sequential
 		EnvironmentSamplers,	// Environment samplers are sequential
 		SunShadowMap,			// Shadow map for the sun
@@ -150,7 +157,9 @@ void DeferredRenderer::CreatePipelines()
 
 		// Set up root parameters
 		CD3DX12_ROOT_PARAMETER1 rootParameters[GeometryPassRootSignature::Count];
-		rootParameters[GeometryPassRootSignature::ObjectConstantBuffer].InitAsConstantBufferView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_ALL);
+		rootParameters[GeometryPassRootSignature::InstanceDrawConstants].InitAsConstants(SizeOfInUint32(InstanceDrawConstants), 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+		rootParameters[GeometryPassRootSignature::InstanceBuffer].InitAsShaderResourceView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+		rootParameters[GeometryPassRootSignature::InstanceIndices].InitAsShaderResourceView(2, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
 		rootParameters[GeometryPassRootSignature::PassConstantBuffer].InitAsConstantBufferView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_ALL);
 		rootParameters[GeometryPassRootSignature::MaterialBuffer].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_PIXEL);
 
@@ -189,8 +198,11 @@ void DeferredRenderer::CreatePipelines()
 		D3DGraphicsPipelineDesc psoDesc = {};
 
 		CD3DX12_ROOT_PARAMETER1 rootParameters[DepthPassRootSignature::Count];
-		rootParameters[DepthPassRootSignature::ObjectConstantBuffer].InitAsConstantBufferView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+		rootParameters[DepthPassRootSignature::InstanceDrawConstants].InitAsConstants(SizeOfInUint32(InstanceDrawConstants), 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+		rootParameters[DepthPassRootSignature::InstanceBuffer].InitAsShaderResourceView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+		rootParameters[DepthPassRootSignature::InstanceIndices].InitAsShaderResourceView(2, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
 		rootParameters[DepthPassRootSignature::LightConstantBuffer].InitAsConstantBufferView(1, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_VERTEX);
+		rootParameters[DepthPassRootSignature::ShadowPassConstants].InitAsConstants(SizeOfInUint32(ShadowPassConstants), 2, 0, D3D12_SHADER_VISIBILITY_VERTEX);
 
 		psoDesc.NumRootParameters = DepthPassRootSignature::Count;
 		psoDesc.RootParameters = rootParameters;
@@ -221,6 +233,9 @@ void DeferredRenderer::CreatePipelines()
 		psoDesc.RasterizerDesc.DepthBiasClamp = 0.01f;
 		psoDesc.RasterizerDesc.SlopeScaledDepthBias = 2.5f;
 
+		// Casters between the light and the near plane are clamped onto it rather than clipped
+		psoDesc.RasterizerDesc.DepthClipEnable = FALSE;
+
 		m_DepthOnlyPipeline.Create(&psoDesc);
 	}
 
@@ -271,42 +286,40 @@ void DeferredRenderer::CreatePipelines()
 	{
 		D3DComputePipelineDesc psoDesc = {};
 
-		CD3DX12_DESCRIPTOR_RANGE1 ranges[7];
+		CD3DX12_DESCRIPTOR_RANGE1 ranges[6];
 
 		// All descriptors in the g-buffer are contiguous
 		// There will be one for each render target plus the depth buffer
-		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, s_RTCount, 0, 0);
-
-		// Depth buffer
-		ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3, 0);
+		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, s_RTCount + 1, 0, 0);
 
 		// Environment lighting descriptors
-		ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 1);
+		ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 1);
 
 		// Environment samplers
-		ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 2, 0, 0);
+		ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 2, 0, 0);
 
 		// Shadow map
-		ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 2);
+		ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 2);
 
-		ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 2, 0);
+		ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 2, 0);
 
 		// Output UAV
-		ranges[6].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0);
+		ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0);
 
 
 		// Set up root parameters
 		CD3DX12_ROOT_PARAMETER1 rootParameters[LightingPassRootSignature::Count];
 		rootParameters[LightingPassRootSignature::PassConstantBuffer].InitAsConstantBufferView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE);
 		rootParameters[LightingPassRootSignature::GBuffer].InitAsDescriptorTable(1, &ranges[0]);
-		rootParameters[LightingPassRootSignature::DepthBuffer].InitAsDescriptorTable(1, &ranges[1]);
 		rootParameters[LightingPassRootSignature::LightingConstantBuffer].InitAsConstantBufferView(1, 0);
 		rootParameters[LightingPassRootSignature::PointLightBuffer].InitAsShaderResourceView(4, 0);
-		rootParameters[LightingPassRootSignature::EnvironmentMaps].InitAsDescriptorTable(1, &ranges[2]);
-		rootParameters[LightingPassRootSignature::EnvironmentSamplers].InitAsDescriptorTable(1, &ranges[3]);
-		rootParameters[LightingPassRootSignature::SunShadowMap].InitAsDescriptorTable(1, &ranges[4]);
-		rootParameters[LightingPassRootSignature::ShadowMapSampler].InitAsDescriptorTable(1, &ranges[5]);
-		rootParameters[LightingPassRootSignature::OutputResource].InitAsDescriptorTable(1, &ranges[6]);
+		rootParameters[LightingPassRootSignature::ClusterLightGrid].InitAsShaderResourceView(5, 0);
+		rootParameters[LightingPassRootSignature::ClusterLightIndices].InitAsShaderResourceView(6, 0);
+		rootParameters[LightingPassRootSignature::EnvironmentMaps].InitAsDescriptorTable(1, &ranges[1]);
+		rootParameters[LightingPassRootSignature::EnvironmentSamplers].InitAsDescriptorTable(1, &ranges[2]);
+		rootParameters[LightingPassRootSignature::SunShadowMap].InitAsDescriptorTable(1, &ranges[3]);
+		rootParameters[LightingPassRootSignature::ShadowMapSampler].InitAsDescriptorTable(1, &ranges[4]);
+		rootParameters[LightingPassRootSignature::OutputResource].InitAsDescriptorTable(1, &ranges[5]);
 
 		psoDesc.NumRootParameters = LightingPassRootSignature::Count;
 		psoDesc.RootParameters = rootParameters;
@@ -491,7 +504,7 @@ void DeferredRenderer::CreateResolutionDependentResources()
 	ASSERT(m_SRVs.IsValid(), "Failed to alloc!");
 
 	{
-		// Create SRVs for render targets
+		// Create SRVs for depth buffers
 		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -500,12 +513,6 @@ void DeferredRenderer::CreateResolutionDependentResources()
 		srvDesc.Texture2D.PlaneSlice = 0;
 		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
 
-		for (UINT rt = 0; rt < s_RTCount; rt++)
-		{
-			srvDesc.Format = m_RTFormats.at(rt);
-			device->CreateShaderResourceView(m_RenderTargets.at(rt).GetResource(), &srvDesc, m_SRVs.GetCPUHandle(rt));
-		}
-
 		srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
 		device->CreateShaderResourceView(m_DepthBuffers.at(0).GetResource(), &srvDesc, m_SRVs.GetCPUHandle(GB_SRV_Depth0));
 		device->CreateShaderResourceView(m_DepthBuffers.at(1).GetResource(), &srvDesc, m_SRVs.GetCPUHandle(GB_SRV_Depth1));
@@ -526,8 +533,10 @@ void DeferredRenderer::CreateResolutionDependentResources()
 }
 
 
-void DeferredRenderer::Render()
+void DeferredRenderer::Render(Camera& camera)
 {
+	const Frustum viewFrustum = camera.GetFrustum();
+
 	const auto commandList = g_D3DGraphicsContext->GetCommandList();
 
 	std::vector<D3D12_RESOURCE_BARRIER> barriers;
@@ -541,6 +550,59 @@ void DeferredRenderer::Render()
 		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource.GetResource(), before, after));
 	};
 
+	// Cull the scene against the camera and each of the sun's cascades
+	{
+		const auto& geometryInstances = m_Scene->GetAllGeometryInstances();
+
+		m_FrustumCuller.Resize(geometryInstances.size());
+		m_InstanceGeometryHandles.resize(geometryInstances.size());
+		for (const auto& geometryInstance : geometryInstances)
+		{
+			const UINT instanceID = geometryInstance.GetInstanceID();
+			const TriangleGeometry* geometry = geometryInstance.GetGeometry();
+
+			m_FrustumCuller.SetInstanceBounds(instanceID, geometry->BoundsMin, geometry->BoundsMax, geometryInstance.GetTransform().GetWorldMatrix());
+			m_InstanceGeometryHandles.at(instanceID) = geometryInstance.GetGeometryHandle();
+		}
+
+		m_MainViewVisibleInstances.clear();
+		m_FrustumCuller.Cull(viewFrustum, m_MainViewVisibleInstances);
+		BuildDrawList(m_MainViewDrawList, m_MainViewVisibleInstances);
+
+		for (UINT cascadeIndex = 0; cascadeIndex < MAX_SHADOW_CASCADES; cascadeIndex++)
+		{
+			auto& cascade = m_SunCascades.at(cascadeIndex);
+			cascade.VisibleInstances.clear();
+
+			if (cascadeIndex >= m_LightManager->GetCascadeCount())
+			{
+				// Unused slices hold stale data, so must be re-rendered if they are enabled again
+				cascade.Cache.Invalidate();
+				cascade.RenderThisFrame = false;
+				continue;
+			}
+
+			m_FrustumCuller.Cull(m_LightManager->GetCascadeShadowCasterFrustum(cascadeIndex), cascade.VisibleInstances);
+
+			bool castersDirty = false;
+			for (UINT instanceID : cascade.VisibleInstances)
+			{
+				if (geometryInstances.at(instanceID).IsDirty())
+				{
+					castersDirty = true;
+					break;
+				}
+			}
+
+			cascade.Cache.SetEnabled(m_CacheSunShadowMaps);
+			cascade.RenderThisFrame = cascade.Cache.Update(m_LightManager->GetCascade(cascadeIndex).ViewProjection, cascade.VisibleInstances, castersDirty);
+			if (cascade.RenderThisFrame)
+			{
+				BuildDrawList(cascade.DrawList, cascade.VisibleInstances);
+			}
+		}
+	}
+
 	// Render shadow maps first
 	RenderShadowMaps();
 
@@ -588,7 +650,7 @@ void DeferredRenderer::Render()
 
 	if (m_UseVolumetrics)
 	{
-		RenderVolumetrics();
+		RenderVolumetrics(camera);
 	}
 
 	// Switch resource states back
@@ -625,28 +687,49 @@ void DeferredRenderer::RenderShadowMaps() const
 {
 	const auto commandList = g_D3DGraphicsContext->GetCommandList();
 
+	// Cached cascades are still valid from a previous frame
+	bool anyCascadeToRender = false;
+	for (const auto& cascade : m_SunCascades)
+		anyCascadeToRender |= cascade.RenderThisFrame;
+
+	if (!anyCascadeToRender)
+		return;
+
 	PIXBeginEvent(commandList, PIX_COLOR_INDEX(2), "Shadow Map");
 
 
 	// Render directional light shadow map
 	const auto& shadowMap = m_LightManager->GetSunShadowMap();
-	const auto dsv = shadowMap.GetDSV();
 
 	auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(shadowMap.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,D3D12_RESOURCE_STATE_DEPTH_WRITE);
 	commandList->ResourceBarrier(1, &barrier);
 
 	shadowMap.ApplyViewport(commandList);
 
-	// Clear shadow map
-	commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-
-	// Set depth stencil view and no render targets
-	commandList->OMSetRenderTargets(0, nullptr, false, &dsv);
-
 	m_DepthOnlyPipeline.Bind(commandList);
 	commandList->SetGraphicsRootConstantBufferView(DepthPassRootSignature::LightConstantBuffer, m_LightManager->GetLightingConstantBuffer());
 
-	DrawAllGeometry(commandList, DepthPassRootSignature::ObjectConstantBuffer);
+	commandList->SetGraphicsRootShaderResourceView(DepthPassRootSignature::InstanceBuffer, m_Scene->GetInstanceBufferAddress());
+
+	for (UINT cascadeIndex = 0; cascadeIndex < MAX_SHADOW_CASCADES; cascadeIndex++)
+	{
+		const auto& cascade = m_SunCascades.at(cascadeIndex);
+		if (!cascade.RenderThisFrame)
+			continue;
+
+		const auto dsv = shadowMap.GetDSV(cascadeIndex);
+
+		// Clear shadow map
+		commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+
+		// Set depth stencil view and no render targets
+		commandList->OMSetRenderTargets(0, nullptr, false, &dsv);
+
+		const ShadowPassConstants shadowPassConstants{ .CascadeIndex = cascadeIndex };
+		commandList->SetGraphicsRoot32BitConstants(DepthPassRootSignature::ShadowPassConstants, SizeOfInUint32(shadowPassConstants), &shadowPassConstants, 0);
+
+		DrawAllGeometry(commandList, cascade.DrawList, DepthPassRootSignature::InstanceDrawConstants, DepthPassRootSignature::InstanceIndices);
+	}
 
 	barrier = CD3DX12_RESOURCE_BARRIER::Transition(shadowMap.GetResource(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 	commandList->ResourceBarrier(1, &barrier);
@@ -681,7 +764,8 @@ void DeferredRenderer::CreateESM() const
 		const UINT dispatchX = (cb.OutDimensions.x + 15) / 16;
 		const UINT dispatchY = (cb.OutDimensions.y + 15) / 16;
 
-		commandList->Dispatch(dispatchX, dispatchY, 1);
+		// One slice per active cascade
+		commandList->Dispatch(dispatchX, dispatchY, m_LightManager->GetCascadeCount());
 
 		barrier = CD3DX12_RESOURCE_BARRIER::Transition(esm.GetWriteResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 		commandList->ResourceBarrier(1, &barrier);
@@ -710,7 +794,7 @@ void DeferredRenderer::CreateESM() const
 			const UINT dispatchX = (cb.ResourceDimensions.x + 15) / 16;
 			const UINT dispatchY = (cb.ResourceDimensions.y + 15) / 16;
 
-			commandList->Dispatch(dispatchX, dispatchY, 1);
+			commandList->Dispatch(dispatchX, dispatchY, m_LightManager->GetCascadeCount());
 
 			barrier = CD3DX12_RESOURCE_BARRIER::UAV(esm.GetWriteResource());
 			commandList->ResourceBarrier(1, &barrier);
@@ -760,7 +844,9 @@ void DeferredRenderer::GeometryPass() const
 	commandList->SetGraphicsRootConstantBufferView(GeometryPassRootSignature::PassConstantBuffer, g_D3DGraphicsContext->GetPassCBAddress());
 	commandList->SetGraphicsRootShaderResourceView(GeometryPassRootSignature::MaterialBuffer, m_MaterialManager->GetMaterialBufferAddress());
 
-	DrawAllGeometry(commandList, GeometryPassRootSignature::ObjectConstantBuffer);
+	commandList->SetGraphicsRootShaderResourceView(GeometryPassRootSignature::InstanceBuffer, m_Scene->GetInstanceBufferAddress());
+
+	DrawAllGeometry(commandList, m_MainViewDrawList, GeometryPassRootSignature::InstanceDrawConstants, GeometryPassRootSignature::InstanceIndices);
 
 	PIXEndEvent(commandList);
 }
@@ -808,12 +894,18 @@ void DeferredRenderer::LightingPass() const
 	// Lighting pass
 	m_LightingPipeline.Bind(commandList);
 
+	// The depth buffer alternates between frames, so the table is written for each frame
+	const TransientDescriptorAllocation gbufferTable = g_D3DGraphicsContext->GetTransientSRVRing()->Allocate(static_cast<UINT>(s_RTCount) + 1);
+	ASSERT(gbufferTable.IsValid(), "Transient SRV ring is exhausted");
+	CreateGBufferTable(gbufferTable);
+
 	// Set root arguments
 	commandList->SetComputeRootConstantBufferView(LightingPassRootSignature::PassConstantBuffer, g_D3DGraphicsContext->GetPassCBAddress());
-	commandList->SetComputeRootDescriptorTable(LightingPassRootSignature::GBuffer, m_SRVs.GetGPUHandle());
-	commandList->SetComputeRootDescriptorTable(LightingPassRootSignature::DepthBuffer, GetCurrentDepthBufferSRV());
+	commandList->SetComputeRootDescriptorTable(LightingPassRootSignature::GBuffer, gbufferTable.GetGPUHandle());
 	commandList->SetComputeRootConstantBufferView(LightingPassRootSignature::LightingConstantBuffer, m_LightManager->GetLightingConstantBuffer());
 	commandList->SetComputeRootShaderResourceView(LightingPassRootSignature::PointLightBuffer, m_LightManager->GetPointLightBuffer());
+	commandList->SetComputeRootShaderResourceView(LightingPassRootSignature::ClusterLightGrid, m_LightManager->GetClusterLightGridBuffer());
+	commandList->SetComputeRootShaderResourceView(LightingPassRootSignature::ClusterLightIndices, m_LightManager->GetClusterLightIndexBuffer());
 	commandList->SetComputeRootDescriptorTable(LightingPassRootSignature::EnvironmentMaps, ibl->GetSRVTable());
 	commandList->SetComputeRootDescriptorTable(LightingPassRootSignature::EnvironmentSamplers, ibl->GetSamplerTable());
 	commandList->SetComputeRootDescriptorTable(LightingPassRootSignature::SunShadowMap, m_LightManager->GetSunShadowMap().GetSRV());
@@ -830,8 +922,30 @@ void DeferredRenderer::LightingPass() const
 	PIXEndEvent(commandList);
 }
 
+void DeferredRenderer::CreateGBufferTable(const TransientDescriptorAllocation& table) const
+{
+	const auto device = g_D3DGraphicsContext->GetDevice();
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = 1;
+	srvDesc.Texture2D.PlaneSlice = 0;
+	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+	for (UINT rt = 0; rt < s_RTCount; rt++)
+	{
+		srvDesc.Format = m_RTFormats.at(rt);
+		device->CreateShaderResourceView(m_RenderTargets.at(rt).GetResource(), &srvDesc, table.GetCPUHandle(rt));
+	}
+
+	srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+	device->CreateShaderResourceView(m_DepthBuffers.at(m_CurrentDepthBuffer).GetResource(), &srvDesc, table.GetCPUHandle(static_cast<UINT>(s_RTCount)));
+}
 
-void DeferredRenderer::RenderVolumetrics() const
+
+void DeferredRenderer::RenderVolumetrics(Camera& camera) const
 {
 	const auto commandList = g_D3DGraphicsContext->GetCommandList();
 
@@ -845,7 +959,12 @@ void DeferredRenderer::RenderVolumetrics() const
 			.DepthBuffer = GetCurrentDepthBufferSRV(),
 			.DepthBufferDimensions = { m_GBufferWidth, m_GBufferHeight },
 			.PreviousDepthBuffer = GetPreviousDepthBufferSRV(),
-			.PreviousDepthBufferDimensions = { m_PrevGBufferWidth, m_PrevGBufferHeight }
+			.PreviousDepthBufferDimensions = { m_PrevGBufferWidth, m_PrevGBufferHeight },
+
+			.View = camera.GetViewMatrix(),
+			.Projection = camera.GetProjectionMatrix(),
+			.NearPlane = camera.GetNearPlane(),
+			.EyePosition = camera.GetPosition()
 		};
 		m_VolumeRenderer->RenderVolumetrics(params);
 	}
@@ -898,22 +1017,43 @@ void DeferredRenderer::Tonemapping() const
 }
 
 
-void DeferredRenderer::DrawAllGeometry(ID3D12GraphicsCommandList* commandList, UINT objectCBParamIndex) const
+void DeferredRenderer::BuildDrawList(GeometryDrawList& drawList, const std::vector<UINT>& instanceIDs)
 {
+	drawList.Batcher.Build(instanceIDs.data(), instanceIDs.size(), m_InstanceGeometryHandles.data(), static_cast<UINT>(m_Scene->GetAllGeometries().size()));
+
+	const auto& instanceIndices = drawList.Batcher.GetInstanceIndices();
+	if (instanceIndices.empty())
+		return;
+
+	const UploadAllocation allocation = g_D3DGraphicsContext->GetFrameUploadAllocator()->AllocateElements(
+		instanceIndices.data(), static_cast<UINT>(instanceIndices.size()), sizeof(UINT));
+	ASSERT(allocation.IsValid(), "Failed to allocate instance index buffer");
+
+	drawList.InstanceIndexBuffer = allocation.GPUAddress;
+}
+
+void DeferredRenderer::DrawAllGeometry(ID3D12GraphicsCommandList* commandList, const GeometryDrawList& drawList, UINT drawConstantsParamIndex, UINT instanceIndicesParamIndex) const
+{
+	if (drawList.Batcher.GetBatches().empty())
+		return;
+
 	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	commandList->SetGraphicsRootShaderResourceView(instanceIndicesParamIndex, drawList.InstanceIndexBuffer);
 
-	for (const auto& geometryInstance : m_Scene->GetAllGeometryInstances())
+	const auto& geometries = m_Scene->GetAllGeometries();
+	for (const auto& batch : drawList.Batcher.GetBatches())
 	{
-		// Set material root parameters
-		commandList->SetGraphicsRootConstantBufferView(objectCBParamIndex, m_Scene->GetObjectCBAddress(geometryInstance.GetInstanceID()));
+		// Point the shader at this batch's range of the instance index list
+		const InstanceDrawConstants drawConstants{ batch.FirstInstance };
+		commandList->SetGraphicsRoot32BitConstants(drawConstantsParamIndex, SizeOfInUint32(drawConstants), &drawConstants, 0);
 
 		// Bind geometry
-		const TriangleGeometry* geometry = geometryInstance.GetGeometry();
+		const TriangleGeometry* geometry = geometries.at(batch.GeometryHandle).get();
 
 		commandList->IASetIndexBuffer(&geometry->IndexBufferView);
 		commandList->IASetVertexBuffers(0, 1, &geometry->VertexBufferView);
 
-		commandList->DrawIndexedInstanced(geometry->IndexBuffer.GetElementCount(), 1, 0, 0, 0);
+		commandList->DrawIndexedInstanced(geometry->IndexBuffer.GetElementCount(), batch.InstanceCount, 0, 0, 0);
 	}
 }
 
@@ -922,6 +1062,17 @@ void DeferredRenderer::DrawGui()
 {
 	ImGui::Text("Renderer");
 
+	ImGui::Text("Visible instances: %d / %d", static_cast<int>(m_MainViewVisibleInstances.size()), static_cast<int>(m_FrustumCuller.GetInstanceCount()));
+
+	ImGui::Checkbox("Cache Sun Shadow Map", &m_CacheSunShadowMaps);
+	for (UINT cascadeIndex = 0; cascadeIndex < m_LightManager->GetCascadeCount(); cascadeIndex++)
+	{
+		const auto& cascade = m_SunCascades.at(cascadeIndex);
+		ImGui::Text("Cascade %u: %d / %d casters, %llu / %llu frames skipped", cascadeIndex,
+			static_cast<int>(cascade.VisibleInstances.size()), static_cast<int>(m_FrustumCuller.GetInstanceCount()),
+			cascade.Cache.GetSkippedFrameCount(), cascade.Cache.GetSkippedFrameCount() + cascade.Cache.GetRenderedFrameCount());
+	}
+
 	{
 		ImGui::Checkbox("Use Volumetrics", &m_UseVolumetrics);
 		GuiHelpers::DisableScope disable(!m_UseVolumetrics);
@@ -4,11 +4,16 @@
 
 #include "D3DPipeline.h"
 #include "Buffer/Texture.h"
+#include "Geometry/InstanceBatcher.h"
+#include "Geometry/FrustumCuller.h"
+#include "Lighting/ShadowMapCache.h"
 #include "Lighting/VolumetricRendering.h"
 #include "Memory/MemoryAllocator.h"
+#include "Memory/TransientDescriptorRing.h"
 
 
 class MaterialManager;
+class Camera;
 class LightManager;
 using namespace DirectX;
 
@@ -24,12 +29,11 @@ class DeferredRenderer
 		GB_RTV_RoughnessMetalness,
 		GB_RTV_MAX
 	};
+	// The g-buffer render targets are only read together with the current depth buffer,
+	// from a table that is written every frame, so only the depth buffers have persistent SRVs
 	enum GB_SRV
 	{
-		GB_SRV_Albedo = 0,
-		GB_SRV_Normal,
-		GB_SRV_RoughnessMetalness,
-		GB_SRV_Depth0,
+		GB_SRV_Depth0 = 0,
 		GB_SRV_Depth1,
 		GB_SRV_MAX
 	};
@@ -49,7 +53,8 @@ public:
 	// Rendering
 
 	// Perform g buffer population pass
-	void Render();
+	// Geometry outside of the camera's frustum will not be drawn
+	void Render(Camera& camera);
 
 	ID3D12Resource* GetOutputResource() const { return m_OutputResource.GetResource(); }
 	ID3D12Resource* GetGBufferResource(UINT index) const { return m_RenderTargets.at(index).GetResource(); }
@@ -79,14 +84,26 @@ private:
 	void GeometryPass() const;
 	void RenderSkybox() const;
 	void LightingPass() const;
+	// Writes SRVs of each render target followed by the current depth buffer, as the lighting pass reads them
+	void CreateGBufferTable(const TransientDescriptorAllocation& table) const;
 
-	void RenderVolumetrics() const;
+	void RenderVolumetrics(Camera& camera) const;
 
 	// Post processing
 	void Tonemapping() const;
 
-	// Submits Draw calls for all geometry in the scene
-	void DrawAllGeometry(ID3D12GraphicsCommandList* commandList, UINT objectCBParamIndex) const;
+	// The instances drawn by a pass, grouped into one instanced draw per geometry
+	struct GeometryDrawList
+	{
+		InstanceBatcher Batcher;
+		D3D12_GPU_VIRTUAL_ADDRESS InstanceIndexBuffer = 0;
+	};
+
+	// Groups the instances by geometry and uploads the instance index list for this frame
+	void BuildDrawList(GeometryDrawList& drawList, const std::vector<UINT>& instanceIDs);
+
+	// Submits Draw calls for all geometry in the draw list
+	void DrawAllGeometry(ID3D12GraphicsCommandList* commandList, const GeometryDrawList& drawList, UINT drawConstantsParamIndex, UINT instanceIndicesParamIndex) const;
 
 private:
 	// The scene to render
@@ -96,6 +113,25 @@ private:
 	const MaterialManager* m_MaterialManager = nullptr;
 
 	std::unique_ptr<VolumetricRendering> m_VolumeRenderer;
+
+	// Instances to draw this frame
+	FrustumCuller m_FrustumCuller;
+	std::vector<UINT> m_InstanceGeometryHandles;	// Indexed by instance ID
+
+	std::vector<UINT> m_MainViewVisibleInstances;
+	GeometryDrawList m_MainViewDrawList;
+
+	// Each sun shadow cascade is culled separately, and only re-rendered when the cascade or its casters change
+	struct ShadowCascadeDrawState
+	{
+		std::vector<UINT> VisibleInstances;
+		GeometryDrawList DrawList;
+		ShadowMapCache Cache;
+		bool RenderThisFrame = false;
+	};
+	std::array<ShadowCascadeDrawState, MAX_SHADOW_CASCADES> m_SunCascades;
+	bool m_CacheSunShadowMaps = true;
+
 	bool m_UseVolumetrics = true;
 
 	// G-buffer resources
@@ -0,0 +1,219 @@
+#include "pch.h"
+#include "FrustumCuller.h"
+
+#include <bit>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+// MSVC allows AVX intrinsics in any function; GCC and Clang need the function to be compiled for AVX
+#if defined(__GNUC__) || defined(__clang__)
+#define CULL_TARGET_AVX __attribute__((target("avx")))
+#else
+#define CULL_TARGET_AVX
+#endif
+
+
+void FrustumCuller::Resize(size_t instanceCount)
+{
+	m_CenterX.resize(instanceCount);
+	m_CenterY.resize(instanceCount);
+	m_CenterZ.resize(instanceCount);
+	m_ExtentX.resize(instanceCount);
+	m_ExtentY.resize(instanceCount);
+	m_ExtentZ.resize(instanceCount);
+}
+
+void FrustumCuller::SetInstanceBounds(size_t index, const XMFLOAT3& localMin, const XMFLOAT3& localMax, const XMMATRIX& worldMatrix)
+{
+	ASSERT(index < GetInstanceCount(), "Out of bounds access");
+
+	const XMVECTOR boundsMin = XMLoadFloat3(&localMin);
+	const XMVECTOR boundsMax = XMLoadFloat3(&localMax);
+
+	const XMVECTOR localCenter = 0.5f * (boundsMax + boundsMin);
+	const XMVECTOR localExtent = 0.5f * (boundsMax - boundsMin);
+
+	// The extents of the transformed box are found by projecting the local extents onto the absolute value of each axis
+	const XMVECTOR center = XMVector3Transform(localCenter, worldMatrix);
+	const XMVECTOR extent = XMVectorAbs(worldMatrix.r[0]) * XMVectorSplatX(localExtent)
+						  + XMVectorAbs(worldMatrix.r[1]) * XMVectorSplatY(localExtent)
+						  + XMVectorAbs(worldMatrix.r[2]) * XMVectorSplatZ(localExtent);
+
+	m_CenterX[index] = XMVectorGetX(center);
+	m_CenterY[index] = XMVectorGetY(center);
+	m_CenterZ[index] = XMVectorGetZ(center);
+	m_ExtentX[index] = XMVectorGetX(extent);
+	m_ExtentY[index] = XMVectorGetY(extent);
+	m_ExtentZ[index] = XMVectorGetZ(extent);
+}
+
+
+void FrustumCuller::Cull(const Frustum& frustum, std::vector<UINT>& visibleInstances) const
+{
+	static const bool useAVX = IsAVXSupported();
+
+	if (useAVX)
+		CullAVX(frustum, visibleInstances);
+	else
+		CullSSE(frustum, visibleInstances);
+}
+
+void FrustumCuller::CullScalar(const Frustum& frustum, std::vector<UINT>& visibleInstances) const
+{
+	CullScalar(frustum, 0, GetInstanceCount(), visibleInstances);
+}
+
+void FrustumCuller::CullSSE(const Frustum& frustum, std::vector<UINT>& visibleInstances) const
+{
+	const size_t count = GetInstanceCount();
+	const size_t next = CullSSE(frustum, 0, count, visibleInstances);
+
+	// Remaining instances that do not fill a SIMD register
+	CullScalar(frustum, next, count, visibleInstances);
+}
+
+void FrustumCuller::CullAVX(const Frustum& frustum, std::vector<UINT>& visibleInstances) const
+{
+	ASSERT(IsAVXSupported(), "AVX is not supported");
+
+	// The SSE path takes 4 of the fewer than 8 that remain
+	const size_t count = GetInstanceCount();
+	size_t next = CullAVX(frustum, 0, count, visibleInstances);
+	next = CullSSE(frustum, next, count, visibleInstances);
+	CullScalar(frustum, next, count, visibleInstances);
+}
+
+
+bool FrustumCuller::IsAVXSupported()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+
+	// The CPU must support AVX, and the OS must save the YMM registers on context switch
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#elif defined(__GNUC__) || defined(__clang__)
+	return __builtin_cpu_supports("avx");
+#else
+	return false;
+#endif
+}
+
+
+size_t FrustumCuller::CullSSE(const Frustum& frustum, size_t begin, size_t end, std::vector<UINT>& visibleInstances) const
+{
+	// Broadcast each plane and its absolute normal once
+	__m128 planeX[Frustum::Plane_Count], planeY[Frustum::Plane_Count], planeZ[Frustum::Plane_Count], planeW[Frustum::Plane_Count];
+	__m128 absPlaneX[Frustum::Plane_Count], absPlaneY[Frustum::Plane_Count], absPlaneZ[Frustum::Plane_Count];
+	for (UINT p = 0; p < Frustum::Plane_Count; p++)
+	{
+		const XMFLOAT4& plane = frustum.Planes.at(p);
+		planeX[p] = _mm_set1_ps(plane.x);
+		planeY[p] = _mm_set1_ps(plane.y);
+		planeZ[p] = _mm_set1_ps(plane.z);
+		planeW[p] = _mm_set1_ps(plane.w);
+		absPlaneX[p] = _mm_set1_ps(fabsf(plane.x));
+		absPlaneY[p] = _mm_set1_ps(fabsf(plane.y));
+		absPlaneZ[p] = _mm_set1_ps(fabsf(plane.z));
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		const __m128 cx = _mm_loadu_ps(&m_CenterX[i]);
+		const __m128 cy = _mm_loadu_ps(&m_CenterY[i]);
+		const __m128 cz = _mm_loadu_ps(&m_CenterZ[i]);
+		const __m128 ex = _mm_loadu_ps(&m_ExtentX[i]);
+		const __m128 ey = _mm_loadu_ps(&m_ExtentY[i]);
+		const __m128 ez = _mm_loadu_ps(&m_ExtentZ[i]);
+
+		// A box is outside if it is entirely behind any plane
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (UINT p = 0; p < Frustum::Plane_Count; p++)
+		{
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+			const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlaneX[p], ex), _mm_mul_ps(absPlaneY[p], ey)), _mm_mul_ps(absPlaneZ[p], ez));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		while (mask)
+		{
+			const int lane = std::countr_zero(static_cast<unsigned>(mask));
+			visibleInstances.push_back(static_cast<UINT>(i + lane));
+			mask &= mask - 1;
+		}
+	}
+	return i;
+}
+
+CULL_TARGET_AVX
+size_t FrustumCuller::CullAVX(const Frustum& frustum, size_t begin, size_t end, std::vector<UINT>& visibleInstances) const
+{
+	__m256 planeX[Frustum::Plane_Count], planeY[Frustum::Plane_Count], planeZ[Frustum::Plane_Count], planeW[Frustum::Plane_Count];
+	__m256 absPlaneX[Frustum::Plane_Count], absPlaneY[Frustum::Plane_Count], absPlaneZ[Frustum::Plane_Count];
+	for (UINT p = 0; p < Frustum::Plane_Count; p++)
+	{
+		const XMFLOAT4& plane = frustum.Planes.at(p);
+		planeX[p] = _mm256_set1_ps(plane.x);
+		planeY[p] = _mm256_set1_ps(plane.y);
+		planeZ[p] = _mm256_set1_ps(plane.z);
+		planeW[p] = _mm256_set1_ps(plane.w);
+		absPlaneX[p] = _mm256_set1_ps(fabsf(plane.x));
+		absPlaneY[p] = _mm256_set1_ps(fabsf(plane.y));
+		absPlaneZ[p] = _mm256_set1_ps(fabsf(plane.z));
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		const __m256 cx = _mm256_loadu_ps(&m_CenterX[i]);
+		const __m256 cy = _mm256_loadu_ps(&m_CenterY[i]);
+		const __m256 cz = _mm256_loadu_ps(&m_CenterZ[i]);
+		const __m256 ex = _mm256_loadu_ps(&m_ExtentX[i]);
+		const __m256 ey = _mm256_loadu_ps(&m_ExtentY[i]);
+		const __m256 ez = _mm256_loadu_ps(&m_ExtentZ[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (UINT p = 0; p < Frustum::Plane_Count; p++)
+		{
+			const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], cx), _mm256_mul_ps(planeY[p], cy)), _mm256_add_ps(_mm256_mul_ps(planeZ[p], cz), planeW[p]));
+			const __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absPlaneX[p], ex), _mm256_mul_ps(absPlaneY[p], ey)), _mm256_mul_ps(absPlaneZ[p], ez));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		while (mask)
+		{
+			const int lane = std::countr_zero(static_cast<unsigned>(mask));
+			visibleInstances.push_back(static_cast<UINT>(i + lane));
+			mask &= mask - 1;
+		}
+	}
+	return i;
+}
+
+void FrustumCuller::CullScalar(const Frustum& frustum, size_t begin, size_t end, std::vector<UINT>& visibleInstances) const
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (const XMFLOAT4& plane : frustum.Planes)
+		{
+			const float distance = plane.x * m_CenterX[i] + plane.y * m_CenterY[i] + (plane.z * m_CenterZ[i] + plane.w);
+			const float radius = fabsf(plane.x) * m_ExtentX[i] + fabsf(plane.y) * m_ExtentY[i] + fabsf(plane.z) * m_ExtentZ[i];
+			inside &= distance + radius >= 0.0f;
+		}
+
+		if (inside)
+			visibleInstances.push_back(static_cast<UINT>(i));
+	}
+}
+
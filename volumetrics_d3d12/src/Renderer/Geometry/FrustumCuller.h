@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Core.h"
+#include "Framework/Frustum.h"
+
+using namespace DirectX;
+
+
+/**
+ *	A FrustumCuller holds the world-space bounding boxes of a set of instances and
+ *	produces the list of instances that intersect a frustum.
+ *
+ *	Bounds are stored as centre/extents in structure-of-arrays form, so that the same bounds can be
+ *	tested against several frustums (e.g. the main camera and the sun) with wide SIMD.
+ *	8 instances are tested per iteration with AVX when the CPU supports it, otherwise 4 with SSE.
+ *
+ *	The culler has no knowledge of D3D or the scene; instances are identified by their index.
+ */
+class FrustumCuller
+{
+public:
+	FrustumCuller() = default;
+	~FrustumCuller() = default;
+
+	DEFAULT_COPY(FrustumCuller)
+	DEFAULT_MOVE(FrustumCuller)
+
+	void Resize(size_t instanceCount);
+	// Transforms a local-space AABB into world space and stores it for the instance
+	void SetInstanceBounds(size_t index, const XMFLOAT3& localMin, const XMFLOAT3& localMax, const XMMATRIX& worldMatrix);
+
+	// Appends the index of every instance whose bounds intersect the frustum to visibleInstances
+	// Indices are appended in increasing order
+	void Cull(const Frustum& frustum, std::vector<UINT>& visibleInstances) const;
+	// Reference implementation of Cull that tests one instance at a time
+	void CullScalar(const Frustum& frustum, std::vector<UINT>& visibleInstances) const;
+	// Cull restricted to one SIMD width, so that each path can be tested and timed on its own
+	// CullAVX must only be called if IsAVXSupported
+	void CullSSE(const Frustum& frustum, std::vector<UINT>& visibleInstances) const;
+	void CullAVX(const Frustum& frustum, std::vector<UINT>& visibleInstances) const;
+
+	inline size_t GetInstanceCount() const { return m_CenterX.size(); }
+
+	static bool IsAVXSupported();
+
+private:
+	// Each processes the instances in [begin, end), and returns the index of the first instance it did not process
+	size_t CullSSE(const Frustum& frustum, size_t begin, size_t end, std::vector<UINT>& visibleInstances) const;
+	size_t CullAVX(const Frustum& frustum, size_t begin, size_t end, std::vector<UINT>& visibleInstances) const;
+	void CullScalar(const Frustum& frustum, size_t begin, size_t end, std::vector<UINT>& visibleInstances) const;
+
+private:
+	// World-space bounds
+	std::vector<float> m_CenterX;
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_ExtentX;
+	std::vector<float> m_ExtentY;
+	std::vector<float> m_ExtentZ;
+};
@@ -2,24 +2,11 @@
 
 #include "Core.h"
 #include "Renderer/Buffer/UploadBuffer.h"
+#include "MeshData.h"
 
 using namespace DirectX;
 
 
-struct VertexType
-{
-	XMFLOAT3 Position;
-	XMFLOAT3 Normal;
-
-	inline static constexpr D3D12_INPUT_ELEMENT_DESC InputLayout[] = {
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-	};
-};
-
-typedef UINT16 IndexType;
-
-
 struct TriangleGeometry
 {
 	TriangleGeometry() = default;
@@ -34,6 +21,10 @@ struct TriangleGeometry
 
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView;
 	D3D12_INDEX_BUFFER_VIEW IndexBufferView;
+
+	// Local-space axis aligned bounding box
+	XMFLOAT3 BoundsMin{ 0.0f, 0.0f, 0.0f };
+	XMFLOAT3 BoundsMax{ 0.0f, 0.0f, 0.0f };
 };
 
 
@@ -47,5 +38,5 @@ public:
 	static std::unique_ptr<TriangleGeometry> BuildSphere(float radius, UINT segments, UINT slices);
 
 	static std::unique_ptr<TriangleGeometry> BuildFromVerticesIndices(UINT vertexCount, const VertexType* vertices, UINT indexCount, const IndexType* indices);
-
+	static std::unique_ptr<TriangleGeometry> BuildFromMeshData(const MeshData& mesh);
 };
@@ -4,9 +4,10 @@
 #include "Renderer/D3DGraphicsContext.h"
 
 
-GeometryInstance::GeometryInstance(UINT instanceID, TriangleGeometry* geometry)
+GeometryInstance::GeometryInstance(UINT instanceID, TriangleGeometry* geometry, UINT geometryHandle)
 	: m_InstanceID(instanceID)
 	, m_Geometry(geometry)
+	, m_GeometryHandle(geometryHandle)
 	, m_FramesDirty(D3DGraphicsContext::GetBackBufferCount())
 {
 	ASSERT(m_InstanceID != INVALID_INSTANCE_ID, "Invalid instance ID");
@@ -13,10 +13,12 @@ class Material;
 class GeometryInstance
 {
 public:
-	GeometryInstance(UINT instanceID, TriangleGeometry* geometry);
+	GeometryInstance(UINT instanceID, TriangleGeometry* geometry, UINT geometryHandle);
 
 	inline UINT GetInstanceID() const { return m_InstanceID; }
 	inline TriangleGeometry* GetGeometry() const { return m_Geometry; }
+	// Index of the geometry in the scene
+	inline UINT GetGeometryHandle() const { return m_GeometryHandle; }
 
 	inline const Transform& GetTransform() const { return m_Transform; }
 	void SetTransform(const Transform& transform);
@@ -30,6 +32,7 @@ public:
 private:
 	UINT m_InstanceID = INVALID_INSTANCE_ID;
 	TriangleGeometry* m_Geometry = nullptr;
+	UINT m_GeometryHandle = 0;
 
 	Material* m_Material = nullptr;
 
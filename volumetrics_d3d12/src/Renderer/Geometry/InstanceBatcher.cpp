@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "InstanceBatcher.h"
+
+
+void InstanceBatcher::Build(const UINT* instanceIDs, size_t instanceCount, const UINT* geometryHandles, UINT geometryCount)
+{
+	m_Batches.clear();
+	m_InstanceIndices.resize(instanceCount);
+
+	if (instanceCount == 0)
+		return;
+
+	ASSERT(instanceIDs && geometryHandles, "Invalid instance data");
+
+	// Count the instances of each geometry
+	m_GeometryOffsets.assign(geometryCount, 0);
+	for (size_t i = 0; i < instanceCount; i++)
+	{
+		const UINT geometry = geometryHandles[instanceIDs[i]];
+		ASSERT(geometry < geometryCount, "Invalid geometry handle");
+		m_GeometryOffsets[geometry]++;
+	}
+
+	// Turn the counts into the offset of each geometry's range, emitting a batch for each geometry in use
+	UINT offset = 0;
+	for (UINT geometry = 0; geometry < geometryCount; geometry++)
+	{
+		const UINT count = m_GeometryOffsets[geometry];
+		m_GeometryOffsets[geometry] = offset;
+
+		if (count > 0)
+		{
+			m_Batches.push_back({ geometry, offset, count });
+			offset += count;
+		}
+	}
+
+	// Scatter the instances into their geometry's range
+	// Instances keep their relative order within a batch
+	for (size_t i = 0; i < instanceCount; i++)
+	{
+		const UINT instanceID = instanceIDs[i];
+		m_InstanceIndices[m_GeometryOffsets[geometryHandles[instanceID]]++] = instanceID;
+	}
+}
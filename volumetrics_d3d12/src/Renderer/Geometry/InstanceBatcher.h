@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Core.h"
+
+
+// A single instanced draw of one geometry
+struct DrawBatch
+{
+	UINT GeometryHandle;
+	UINT FirstInstance;		// Index into the instance index list of the first instance in this batch
+	UINT InstanceCount;
+};
+
+
+/**
+ *	An InstanceBatcher groups a list of instances by the geometry they use, so that each
+ *	unique geometry can be drawn with a single instanced draw call.
+ *
+ *	Building produces a compact list of instance IDs ordered by geometry, which the vertex shader
+ *	indexes with the batch's first instance plus SV_InstanceID, and one DrawBatch per geometry in use.
+ *
+ *	Grouping is a counting sort over geometry handles, so it is linear in the number of instances
+ *	and geometries. The batcher has no knowledge of D3D or the scene.
+ */
+class InstanceBatcher
+{
+public:
+	InstanceBatcher() = default;
+	~InstanceBatcher() = default;
+
+	DEFAULT_COPY(InstanceBatcher)
+	DEFAULT_MOVE(InstanceBatcher)
+
+	// instanceIDs: the instances to draw
+	// geometryHandles: the geometry handle of each instance, indexed by instance ID
+	// geometryCount: all geometry handles must be less than this
+	void Build(const UINT* instanceIDs, size_t instanceCount, const UINT* geometryHandles, UINT geometryCount);
+
+	// Getters
+	inline const std::vector<DrawBatch>& GetBatches() const { return m_Batches; }
+	inline const std::vector<UINT>& GetInstanceIndices() const { return m_InstanceIndices; }
+
+private:
+	std::vector<DrawBatch> m_Batches;
+	std::vector<UINT> m_InstanceIndices;
+
+	// Kept between builds to avoid re-allocating every frame
+	std::vector<UINT> m_GeometryOffsets;
+};
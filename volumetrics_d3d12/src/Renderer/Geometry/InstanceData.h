@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+
+using namespace DirectX;
+
+
+// Packs a world matrix (row-vector convention, as used by Transform) into the compact 3x4 layout the shaders read
+inline void PackInstanceGPUData(const XMMATRIX& worldMatrix, UINT materialID, InstanceGPUData& output)
+{
+	// Transposing turns the columns of the affine matrix into rows, so the constant last column can be dropped
+	const XMMATRIX transposed = XMMatrixTranspose(worldMatrix);
+	XMStoreFloat4(&output.WorldMat[0], transposed.r[0]);
+	XMStoreFloat4(&output.WorldMat[1], transposed.r[1]);
+	XMStoreFloat4(&output.WorldMat[2], transposed.r[2]);
+	output.MaterialID = materialID;
+}
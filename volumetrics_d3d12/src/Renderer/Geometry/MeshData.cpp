@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "MeshData.h"
+
+
+MeshData MeshData::CreateUnitCube()
+{
+	// Geometry definition:
+	MeshData mesh;
+	mesh.Vertices = {
+		// Front
+		{ { -1.0f, 1.0f, -1.0f }, { 0.0f, 0.0f, -1.0f } },
+		{ { 1.0f, 1.0f, -1.0f }, { 0.0f, 0.0f, -1.0f } },
+		{ { 1.0f, -1.0f, -1.0f }, { 0.0f, 0.0f, -1.0f } },
+		{ { -1.0f, -1.0f, -1.0f }, { 0.0f, 0.0f, -1.0f } },
+		// Back
+		{ { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } },
+		{ { -1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } },
+		{ { -1.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } },
+		{ { 1.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } },
+		// Left
+		{ { -1.0f, 1.0f, 1.0f }, { -1.0f, 0.0f, 0.0f } },
+		{ { -1.0f, 1.0f, -1.0f }, { -1.0f, 0.0f, 0.0f } },
+		{ { -1.0f, -1.0f, -1.0f }, { -1.0f, 0.0f, 0.0f } },
+		{ { -1.0f, -1.0f, 1.0f }, { -1.0f, 0.0f, 0.0f } },
+		// Right
+		{ { 1.0f, 1.0f, -1.0f }, { 1.0f, 0.0f, 0.0f } },
+		{ { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f, 0.0f } },
+		{ { 1.0f, -1.0f, 1.0f }, { 1.0f, 0.0f, 0.0f } },
+		{ { 1.0f, -1.0f, -1.0f }, { 1.0f, 0.0f, 0.0f } },
+		// Top
+		{ { -1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 1.0f, 1.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -1.0f, 1.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+		// Bottom
+		{ { -1.0f, -1.0f, -1.0f }, { 0.0f, -1.0f, 0.0f } },
+		{ { 1.0f, -1.0f, -1.0f }, { 0.0f, -1.0f, 0.0f } },
+		{ { 1.0f, -1.0f, 1.0f }, { 0.0f, -1.0f, 0.0f } },
+		{ { -1.0f, -1.0f, 1.0f }, { 0.0f, -1.0f, 0.0f } },
+	};
+
+	mesh.Indices = {
+		// Front
+		0, 1, 2,
+		0, 2, 3,
+		// Back
+		4, 5, 6,
+		4, 6, 7,
+		// Left
+		8, 9, 10,
+		8, 10, 11,
+		// Right
+		12, 13, 14,
+		12, 14, 15,
+		// Top
+		16, 17, 18,
+		16, 18, 19,
+		// Bottom
+		20, 21, 22,
+		20, 22, 23
+	};
+
+	return mesh;
+}
+
+
+MeshData MeshData::CreatePlane()
+{
+	MeshData mesh;
+	mesh.Vertices = {
+		{ { -1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 1.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 1.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -1.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } }
+	};
+	mesh.Indices = {
+		0, 1, 2,
+		0, 2, 3
+	};
+
+	return mesh;
+}
+
+
+MeshData MeshData::CreateSphere(float radius, UINT segments, UINT slices)
+{
+	MeshData mesh;
+	std::vector<VertexType>& vertices = mesh.Vertices;
+	vertices.resize((segments + 1) * slices + 2);
+
+	constexpr float _pi = XM_PI;
+	constexpr float _2pi = XM_2PI;
+
+	vertices[0].Position = XMFLOAT3(0, radius, 0);
+	for (UINT lat = 0; lat < slices; lat++)
+	{
+		const float a1 = _pi * static_cast<float>(lat + 1) / static_cast<float>(slices + 1);
+		const float sin1 = sinf(a1);
+		const float cos1 = cosf(a1);
+
+		for (UINT lon = 0; lon <= segments; lon++)
+		{
+			const float a2 = _2pi * static_cast<float>(lon == segments ? 0 : lon) / static_cast<float>(segments);
+			const float sin2 = sinf(a2);
+			const float cos2 = cosf(a2);
+
+			vertices[lon + lat * (segments + 1) + 1].Position = XMFLOAT3(sin1 * cos2 * radius, cos1 * radius, sin1 * sin2 * radius);
+		}
+	}
+	vertices[vertices.size() - 1].Position = XMFLOAT3(0, -radius, 0);
+
+	for (int n = 0; n < vertices.size(); n++)
+	{
+		XMStoreFloat3(&vertices[n].Normal, XMVector3Normalize(XMLoadFloat3(&vertices[n].Position)));
+	}
+
+	std::vector<IndexType>& indices = mesh.Indices;
+	indices.resize(vertices.size() * 6);
+
+	UINT  i = 0;
+	for (UINT lon = 0; lon < segments; lon++)
+	{
+		indices[i++] = static_cast<IndexType>(lon + 2);
+		indices[i++] = static_cast<IndexType>(lon + 1);
+		indices[i++] = static_cast<IndexType>(0);
+	}
+
+	//Middle
+	for (UINT lat = 0; lat < slices - 1; lat++)
+	{
+		for (UINT lon = 0; lon < segments; lon++)
+		{
+			const UINT current = lon + lat * (segments + 1) + 1;
+			const UINT next = current + segments + 1;
+
+			indices[i++] = static_cast<IndexType>(current);
+			indices[i++] = static_cast<IndexType>(current + 1);
+			indices[i++] = static_cast<IndexType>(next + 1);
+
+			indices[i++] = static_cast<IndexType>(current);
+			indices[i++] = static_cast<IndexType>(next + 1);
+			indices[i++] = static_cast<IndexType>(next);
+		}
+	}
+
+	//Bottom Cap
+	for (UINT lon = 0; lon < segments; lon++)
+	{
+		indices[i++] = static_cast<IndexType>(vertices.size() - 1);
+		indices[i++] = static_cast<IndexType>(vertices.size() - (lon + 2) - 1);
+		indices[i++] = static_cast<IndexType>(vertices.size() - (lon + 1) - 1);
+	}
+
+	return mesh;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+using namespace DirectX;
+
+
+struct VertexType
+{
+	XMFLOAT3 Position;
+	XMFLOAT3 Normal;
+
+	inline static constexpr D3D12_INPUT_ELEMENT_DESC InputLayout[] = {
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+	};
+};
+
+typedef UINT16 IndexType;
+
+
+// Vertices and indices of a mesh on the CPU, as they are uploaded by GeometryFactory
+struct MeshData
+{
+	std::vector<VertexType> Vertices;
+	std::vector<IndexType> Indices;
+
+	// The meshes of the GeometryFactory Build functions, kept on the CPU for processing such as voxelization
+	static MeshData CreateUnitCube();
+	static MeshData CreatePlane();
+	static MeshData CreateSphere(float radius, UINT segments, UINT slices);
+};
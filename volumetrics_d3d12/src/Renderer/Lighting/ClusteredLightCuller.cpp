@@ -0,0 +1,294 @@
+#include "pch.h"
+#include "ClusteredLightCuller.h"
+
+#include "Framework/ThreadPool.h"
+
+#include <bit>
+#include <immintrin.h>
+
+
+void ClusteredLightCuller::SetClusterGrid(const XMUINT3& gridDimensions, const float* sliceDepths, const XMMATRIX& projection)
+{
+	ASSERT(gridDimensions.x > 0 && gridDimensions.y > 0 && gridDimensions.z > 0, "Invalid cluster grid dimensions");
+
+	XMFLOAT4X4 projectionFloats;
+	XMStoreFloat4x4(&projectionFloats, projection);
+
+	const size_t sliceDepthCount = gridDimensions.z + 1;
+	const bool changed = gridDimensions.x != m_GridDimensions.x
+		|| gridDimensions.y != m_GridDimensions.y
+		|| gridDimensions.z != m_GridDimensions.z
+		|| memcmp(&projectionFloats, &m_Projection, sizeof(XMFLOAT4X4)) != 0
+		|| memcmp(sliceDepths, m_SliceDepths.data(), sliceDepthCount * sizeof(float)) != 0;
+	if (!changed)
+		return;
+
+	m_GridDimensions = gridDimensions;
+	m_Projection = projectionFloats;
+	m_SliceDepths.assign(sliceDepths, sliceDepths + sliceDepthCount);
+
+	// Unproject each tile corner onto the near and far planes
+	// View-space depth varies linearly along the line between the two, for perspective and orthographic projections alike
+	const XMMATRIX invProjection = XMMatrixInverse(nullptr, projection);
+
+	const UINT cornersX = gridDimensions.x + 1;
+	const UINT cornersY = gridDimensions.y + 1;
+	std::vector<XMFLOAT3> nearCorners(cornersX * cornersY);
+	std::vector<XMFLOAT3> farCorners(cornersX * cornersY);
+	for (UINT y = 0; y < cornersY; y++)
+	{
+		for (UINT x = 0; x < cornersX; x++)
+		{
+			const float ndcX = -1.0f + 2.0f * static_cast<float>(x) / static_cast<float>(gridDimensions.x);
+			const float ndcY = 1.0f - 2.0f * static_cast<float>(y) / static_cast<float>(gridDimensions.y);
+
+			XMStoreFloat3(&nearCorners.at(y * cornersX + x), XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), invProjection));
+			XMStoreFloat3(&farCorners.at(y * cornersX + x), XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), invProjection));
+		}
+	}
+
+	m_ClusterBounds.resize(GetClusterCount());
+	m_RowBounds.resize(gridDimensions.y * gridDimensions.z);
+	m_SliceBounds.resize(gridDimensions.z);
+
+	const Bounds emptyBounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+
+	for (UINT z = 0; z < gridDimensions.z; z++)
+	{
+		const float depths[2] = { m_SliceDepths.at(z), m_SliceDepths.at(z + 1) };
+
+		Bounds& sliceBounds = m_SliceBounds.at(z);
+		sliceBounds = emptyBounds;
+
+		for (UINT y = 0; y < gridDimensions.y; y++)
+		{
+			Bounds& rowBounds = m_RowBounds.at(z * gridDimensions.y + y);
+			rowBounds = emptyBounds;
+
+			for (UINT x = 0; x < gridDimensions.x; x++)
+			{
+				// The cluster is bounded by its 4 tile corners at each of the slice's 2 depths
+				Bounds clusterBounds = emptyBounds;
+				for (UINT corner = 0; corner < 4; corner++)
+				{
+					const UINT cornerIndex = (y + corner / 2) * cornersX + (x + corner % 2);
+					const XMVECTOR nearCorner = XMLoadFloat3(&nearCorners.at(cornerIndex));
+					const XMVECTOR farCorner = XMLoadFloat3(&farCorners.at(cornerIndex));
+					const float nearDepth = nearCorners.at(cornerIndex).z;
+					const float farDepth = farCorners.at(cornerIndex).z;
+
+					for (const float depth : depths)
+					{
+						XMFLOAT3 p;
+						XMStoreFloat3(&p, XMVectorLerp(nearCorner, farCorner, (depth - nearDepth) / (farDepth - nearDepth)));
+
+						// Use the exact slice depth, so that neighbouring slices share their boundary
+						p.z = depth;
+
+						clusterBounds = Union(clusterBounds, { p, p });
+					}
+				}
+
+				m_ClusterBounds.at((z * gridDimensions.y + y) * gridDimensions.x + x) = clusterBounds;
+				rowBounds = Union(rowBounds, clusterBounds);
+			}
+
+			sliceBounds = Union(sliceBounds, rowBounds);
+		}
+	}
+}
+
+void ClusteredLightCuller::SetLights(const PointLightGPUData* lights, UINT lightCount, const XMMATRIX& view)
+{
+	m_Lights.X.resize(lightCount);
+	m_Lights.Y.resize(lightCount);
+	m_Lights.Z.resize(lightCount);
+	m_Lights.Radius.resize(lightCount);
+	m_Lights.Index.resize(lightCount);
+
+	for (UINT i = 0; i < lightCount; i++)
+	{
+		const XMVECTOR position = XMVector3Transform(XMLoadFloat3(&lights[i].Position), view);
+
+		m_Lights.X[i] = XMVectorGetX(position);
+		m_Lights.Y[i] = XMVectorGetY(position);
+		m_Lights.Z[i] = XMVectorGetZ(position);
+		m_Lights.Radius[i] = lights[i].Range;
+		m_Lights.Index[i] = i;
+	}
+}
+
+
+void ClusteredLightCuller::BinLights(ThreadPool& threadPool)
+{
+	const UINT sliceCount = m_GridDimensions.z;
+	const UINT clustersPerSlice = m_GridDimensions.x * m_GridDimensions.y;
+
+	m_SliceBins.resize(sliceCount);
+	threadPool.ParallelFor(sliceCount, 1, [this](UINT begin, UINT end)
+		{
+			for (UINT slice = begin; slice < end; slice++)
+			{
+				BinSlice(slice);
+			}
+		});
+
+	// Each slice's indices follow on from those of the previous slices
+	UINT indexCount = 0;
+	for (auto& bins : m_SliceBins)
+	{
+		bins.FirstIndex = indexCount;
+		indexCount += static_cast<UINT>(bins.LightIndices.size());
+	}
+
+	m_ClusterLightRanges.resize(GetClusterCount());
+	m_LightIndices.resize(indexCount);
+	threadPool.ParallelFor(sliceCount, 1, [this, clustersPerSlice](UINT begin, UINT end)
+		{
+			for (UINT slice = begin; slice < end; slice++)
+			{
+				const SliceBins& bins = m_SliceBins.at(slice);
+
+				XMUINT2* ranges = &m_ClusterLightRanges.at(slice * clustersPerSlice);
+				for (UINT cluster = 0; cluster < clustersPerSlice; cluster++)
+				{
+					ranges[cluster] = { bins.FirstIndex + bins.ClusterLightRanges[cluster].x, bins.ClusterLightRanges[cluster].y };
+				}
+
+				if (!bins.LightIndices.empty())
+				{
+					memcpy(&m_LightIndices.at(bins.FirstIndex), bins.LightIndices.data(), bins.LightIndices.size() * sizeof(UINT));
+				}
+			}
+		});
+}
+
+void ClusteredLightCuller::BinLightsReference(std::vector<XMUINT2>& clusterLightRanges, std::vector<UINT>& lightIndices) const
+{
+	clusterLightRanges.resize(GetClusterCount());
+	lightIndices.clear();
+
+	for (UINT cluster = 0; cluster < GetClusterCount(); cluster++)
+	{
+		const UINT first = static_cast<UINT>(lightIndices.size());
+		for (size_t i = 0; i < m_Lights.Index.size(); i++)
+		{
+			if (Intersects(m_Lights, i, m_ClusterBounds.at(cluster)))
+				lightIndices.push_back(m_Lights.Index[i]);
+		}
+		clusterLightRanges.at(cluster) = { first, static_cast<UINT>(lightIndices.size()) - first };
+	}
+}
+
+
+void ClusteredLightCuller::BinSlice(UINT slice)
+{
+	const UINT tilesX = m_GridDimensions.x;
+	const UINT tilesY = m_GridDimensions.y;
+
+	SliceBins& bins = m_SliceBins.at(slice);
+	bins.ClusterLightRanges.resize(tilesX * tilesY);
+	bins.LightIndices.clear();
+
+	bins.SliceLights.Clear();
+	ForEachIntersectingLight(m_Lights, m_SliceBounds.at(slice), [&](size_t i) { bins.SliceLights.Push(m_Lights, i); });
+
+	for (UINT y = 0; y < tilesY; y++)
+	{
+		bins.RowLights.Clear();
+		ForEachIntersectingLight(bins.SliceLights, m_RowBounds.at(slice * tilesY + y), [&](size_t i) { bins.RowLights.Push(bins.SliceLights, i); });
+
+		for (UINT x = 0; x < tilesX; x++)
+		{
+			const UINT first = static_cast<UINT>(bins.LightIndices.size());
+
+			const Bounds& clusterBounds = m_ClusterBounds.at((slice * tilesY + y) * tilesX + x);
+			ForEachIntersectingLight(bins.RowLights, clusterBounds, [&](size_t i) { bins.LightIndices.push_back(bins.RowLights.Index[i]); });
+
+			bins.ClusterLightRanges.at(y * tilesX + x) = { first, static_cast<UINT>(bins.LightIndices.size()) - first };
+		}
+	}
+}
+
+
+template <typename Func>
+void ClusteredLightCuller::ForEachIntersectingLight(const LightSpheres& lights, const Bounds& bounds, Func&& func)
+{
+	const __m128 minX = _mm_set1_ps(bounds.Min.x);
+	const __m128 minY = _mm_set1_ps(bounds.Min.y);
+	const __m128 minZ = _mm_set1_ps(bounds.Min.z);
+	const __m128 maxX = _mm_set1_ps(bounds.Max.x);
+	const __m128 maxY = _mm_set1_ps(bounds.Max.y);
+	const __m128 maxZ = _mm_set1_ps(bounds.Max.z);
+	const __m128 zero = _mm_setzero_ps();
+
+	const size_t count = lights.Index.size();
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&lights.X[i]);
+		const __m128 y = _mm_loadu_ps(&lights.Y[i]);
+		const __m128 z = _mm_loadu_ps(&lights.Z[i]);
+		const __m128 radius = _mm_loadu_ps(&lights.Radius[i]);
+
+		// Same operations, in the same order, as Intersects
+		const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+		const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+		const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+		const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_mul_ps(radius, radius)));
+		while (mask)
+		{
+			const int lane = std::countr_zero(static_cast<unsigned>(mask));
+			func(i + lane);
+			mask &= mask - 1;
+		}
+	}
+
+	// Remaining lights that do not fill a SIMD register
+	for (; i < count; i++)
+	{
+		if (Intersects(lights, i, bounds))
+			func(i);
+	}
+}
+
+bool ClusteredLightCuller::Intersects(const LightSpheres& lights, size_t i, const Bounds& bounds)
+{
+	// Distance from the sphere centre to the box along each axis, which is 0 if the centre is within the box on that axis
+	const float dx = max(max(bounds.Min.x - lights.X[i], lights.X[i] - bounds.Max.x), 0.0f);
+	const float dy = max(max(bounds.Min.y - lights.Y[i], lights.Y[i] - bounds.Max.y), 0.0f);
+	const float dz = max(max(bounds.Min.z - lights.Z[i], lights.Z[i] - bounds.Max.z), 0.0f);
+	const float distanceSq = (dx * dx + dy * dy) + dz * dz;
+
+	return distanceSq <= lights.Radius[i] * lights.Radius[i];
+}
+
+ClusteredLightCuller::Bounds ClusteredLightCuller::Union(const Bounds& a, const Bounds& b)
+{
+	return {
+		{ min(a.Min.x, b.Min.x), min(a.Min.y, b.Min.y), min(a.Min.z, b.Min.z) },
+		{ max(a.Max.x, b.Max.x), max(a.Max.y, b.Max.y), max(a.Max.z, b.Max.z) }
+	};
+}
+
+
+void ClusteredLightCuller::LightSpheres::Clear()
+{
+	X.clear();
+	Y.clear();
+	Z.clear();
+	Radius.clear();
+	Index.clear();
+}
+
+void ClusteredLightCuller::LightSpheres::Push(const LightSpheres& other, size_t i)
+{
+	X.push_back(other.X[i]);
+	Y.push_back(other.Y[i]);
+	Z.push_back(other.Z[i]);
+	Radius.push_back(other.Radius[i]);
+	Index.push_back(other.Index[i]);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+
+class ThreadPool;
+
+using namespace DirectX;
+
+
+/**
+ *	A ClusteredLightCuller bins point lights into a view-space grid of clusters, so that shading
+ *	only has to consider the lights that can reach the cluster a pixel or froxel lies in.
+ *
+ *	The screen is split into tiles, and the view depth into slices whose boundaries are supplied by the caller
+ *	(so that they can be aligned with the volumetric froxel slices). Each cluster is bounded by a view-space AABB.
+ *
+ *	Lights are binned hierarchically: each slice is handled by one thread, which first filters the lights
+ *	against the bounds of the whole slice, then each row of tiles, and finally each cluster in the row.
+ *	Each step tests 4 light spheres against a box at a time with SSE. Every box encloses the boxes below it,
+ *	so the filtering never rejects a light that the per-cluster test would accept, and the result is
+ *	identical to testing every light against every cluster.
+ *
+ *	The culler has no knowledge of D3D; lights are identified by their index.
+ */
+class ClusteredLightCuller
+{
+public:
+	ClusteredLightCuller() = default;
+	~ClusteredLightCuller() = default;
+
+	DEFAULT_COPY(ClusteredLightCuller)
+	DEFAULT_MOVE(ClusteredLightCuller)
+
+	// Rebuilds the view-space bounds of every cluster, if any of the inputs have changed
+	// Tile (0, 0) is in the top-left corner of the screen
+	// sliceDepths holds the gridDimensions.z + 1 increasing view-space depths that bound the slices
+	void SetClusterGrid(const XMUINT3& gridDimensions, const float* sliceDepths, const XMMATRIX& projection);
+
+	// Transforms the lights into view space
+	void SetLights(const PointLightGPUData* lights, UINT lightCount, const XMMATRIX& view);
+
+	// Builds the list of lights that intersect each cluster, with the slices split across the threads of the pool
+	void BinLights(ThreadPool& threadPool);
+	// Reference implementation of BinLights that tests every light against every cluster
+	void BinLightsReference(std::vector<XMUINT2>& clusterLightRanges, std::vector<UINT>& lightIndices) const;
+
+	// (first index into the light index list, light count) for each cluster
+	// Clusters are ordered by x, then y, then z
+	inline const std::vector<XMUINT2>& GetClusterLightRanges() const { return m_ClusterLightRanges; }
+	// Light indices are in increasing order within each cluster
+	inline const std::vector<UINT>& GetLightIndices() const { return m_LightIndices; }
+
+	inline const XMUINT3& GetGridDimensions() const { return m_GridDimensions; }
+	inline UINT GetClusterCount() const { return m_GridDimensions.x * m_GridDimensions.y * m_GridDimensions.z; }
+	inline UINT GetLightCount() const { return static_cast<UINT>(m_Lights.Index.size()); }
+
+private:
+	struct Bounds
+	{
+		XMFLOAT3 Min;
+		XMFLOAT3 Max;
+	};
+
+	// View-space light spheres in structure-of-arrays form
+	struct LightSpheres
+	{
+		std::vector<float> X;
+		std::vector<float> Y;
+		std::vector<float> Z;
+		std::vector<float> Radius;
+		std::vector<UINT> Index;
+
+		void Clear();
+		void Push(const LightSpheres& other, size_t i);
+	};
+
+	// Scratch space for binning a single slice, only touched by the thread binning that slice
+	struct SliceBins
+	{
+		LightSpheres SliceLights;
+		LightSpheres RowLights;
+
+		// Per-cluster ranges relative to the start of this slice's indices
+		std::vector<XMUINT2> ClusterLightRanges;
+		std::vector<UINT> LightIndices;
+
+		UINT FirstIndex = 0;
+	};
+
+	void BinSlice(UINT slice);
+
+	// Calls func with the position of every light in the set whose sphere intersects the box
+	template <typename Func>
+	static void ForEachIntersectingLight(const LightSpheres& lights, const Bounds& bounds, Func&& func);
+	static bool Intersects(const LightSpheres& lights, size_t i, const Bounds& bounds);
+
+	static Bounds Union(const Bounds& a, const Bounds& b);
+
+private:
+	XMUINT3 m_GridDimensions = { 0, 0, 0 };
+	std::vector<float> m_SliceDepths;
+	XMFLOAT4X4 m_Projection = {};
+
+	// Bounds of each cluster, of each row of clusters within a slice, and of each slice
+	std::vector<Bounds> m_ClusterBounds;
+	std::vector<Bounds> m_RowBounds;
+	std::vector<Bounds> m_SliceBounds;
+
+	LightSpheres m_Lights;
+
+	std::vector<SliceBins> m_SliceBins;
+
+	std::vector<XMUINT2> m_ClusterLightRanges;
+	std::vector<UINT> m_LightIndices;
+};
@@ -16,8 +16,9 @@ void ExponentialShadowMap::CreateExponentialShadowMap(const ShadowMap& shadowMap
 	ASSERT(dims.x % 4 == 0 && dims.y % 4 == 0, "Invalid shadow map resolution to create ESM!");
 
 	m_Dimensions = { dims.x / 4, dims.y / 4 };
+	m_ArraySize = shadowMap.GetArraySize();
 
-	auto desc = CD3DX12_RESOURCE_DESC::Tex2D(ShadowMap::GetSRVFormat(), m_Dimensions.x, m_Dimensions.y);
+	auto desc = CD3DX12_RESOURCE_DESC::Tex2D(ShadowMap::GetSRVFormat(), m_Dimensions.x, m_Dimensions.y, static_cast<UINT16>(m_ArraySize), 1);
 	desc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 
 	for (auto& texture : m_Textures)
@@ -29,10 +30,23 @@ void ExponentialShadowMap::CreateExponentialShadowMap(const ShadowMap& shadowMap
 	m_Descriptors = g_D3DGraphicsContext->GetSRVHeap()->Allocate(4);
 	ASSERT(m_Descriptors.IsValid(), "Failed to alloc!");
 
+	// The ESM shaders always operate on arrays, even if there is only a single slice
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = ShadowMap::GetSRVFormat();
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.ArraySize = m_ArraySize;
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = ShadowMap::GetSRVFormat();
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+	uavDesc.Texture2DArray.ArraySize = m_ArraySize;
+
 	UINT i = 0;
 	for (const auto& texture : m_Textures)
 	{
-		g_D3DGraphicsContext->GetDevice()->CreateShaderResourceView(texture.GetResource(), nullptr, m_Descriptors.GetCPUHandle(i++));
-		g_D3DGraphicsContext->GetDevice()->CreateUnorderedAccessView(texture.GetResource(), nullptr, nullptr, m_Descriptors.GetCPUHandle(i++));
+		g_D3DGraphicsContext->GetDevice()->CreateShaderResourceView(texture.GetResource(), &srvDesc, m_Descriptors.GetCPUHandle(i++));
+		g_D3DGraphicsContext->GetDevice()->CreateUnorderedAccessView(texture.GetResource(), nullptr, &uavDesc, m_Descriptors.GetCPUHandle(i++));
 	}
 }
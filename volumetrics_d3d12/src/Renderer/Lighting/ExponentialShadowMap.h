@@ -16,6 +16,7 @@ public:
 	void CreateExponentialShadowMap(const class ShadowMap& shadowMap);
 
 	inline const XMUINT2& GetDimensions() const { return m_Dimensions; }
+	inline UINT GetArraySize() const { return m_ArraySize; }
 
 	inline ID3D12Resource* GetReadResource() const { return m_Textures.at(m_ReadIndex).GetResource(); }
 	inline ID3D12Resource* GetWriteResource() const { return m_Textures.at(1 - m_ReadIndex).GetResource(); }
@@ -30,6 +31,7 @@ private:
 	UINT m_ReadIndex = 0;
 
 	XMUINT2 m_Dimensions;
+	UINT m_ArraySize = 1;	// Matches the shadow map it is created from
 
 	DescriptorAllocation m_Descriptors;
 };
@@ -0,0 +1,183 @@
+#include "pch.h"
+#include "FogClipmapPlanner.h"
+
+
+FogClipmapPlanner::FogClipmapPlanner(UINT resolution, float baseVoxelSize)
+	: m_Resolution(resolution)
+	, m_BaseVoxelSize(baseVoxelSize)
+{
+	ASSERT(resolution > 0 && resolution % 2 == 0, "Clipmap resolution must be even");
+	ASSERT(baseVoxelSize > 0.0f, "Invalid clipmap voxel size");
+
+	m_Origins.fill({ 0, 0, 0 });
+}
+
+
+void FogClipmapPlanner::Update(const XMFLOAT3& cameraPosition)
+{
+	m_Updates.clear();
+
+	const INT resolution = static_cast<INT>(m_Resolution);
+
+	for (UINT cascade = 0; cascade < s_CascadeCount; cascade++)
+	{
+		// The camera is in the voxel at the centre of the cascade
+		const float voxelSize = GetVoxelSize(cascade);
+		const XMINT3 origin = {
+			static_cast<INT>(floorf(cameraPosition.x / voxelSize)) - resolution / 2,
+			static_cast<INT>(floorf(cameraPosition.y / voxelSize)) - resolution / 2,
+			static_cast<INT>(floorf(cameraPosition.z / voxelSize)) - resolution / 2
+		};
+
+		const XMINT3 previousOrigin = m_Origins.at(cascade);
+		m_Origins.at(cascade) = origin;
+
+		if (!m_Valid)
+		{
+			AddUpdate(cascade, origin, { origin.x + resolution, origin.y + resolution, origin.z + resolution });
+			continue;
+		}
+
+		// The voxels that are new to the cascade are split into a slab per axis
+		// Each slab spans the part of the other axes that the previous slabs have not covered,
+		// which ends as the overlap of the new and previous cascades, so no voxel is baked twice
+		INT boxMin[3] = { origin.x, origin.y, origin.z };
+		INT boxMax[3] = { origin.x + resolution, origin.y + resolution, origin.z + resolution };
+		const INT previousMin[3] = { previousOrigin.x, previousOrigin.y, previousOrigin.z };
+
+		for (UINT axis = 0; axis < 3; axis++)
+		{
+			if (boxMin[axis] == previousMin[axis])
+				continue;
+
+			// The part of the new range along this axis that was also in the previous cascade
+			const INT overlapMin = max(boxMin[axis], previousMin[axis]);
+			const INT overlapMax = min(boxMax[axis], previousMin[axis] + resolution);
+
+			INT slabMin[3] = { boxMin[0], boxMin[1], boxMin[2] };
+			INT slabMax[3] = { boxMax[0], boxMax[1], boxMax[2] };
+
+			if (overlapMin >= overlapMax)
+			{
+				// Moved by the whole cascade, so nothing is kept
+				AddUpdate(cascade, { slabMin[0], slabMin[1], slabMin[2] }, { slabMax[0], slabMax[1], slabMax[2] });
+				break;
+			}
+
+			if (boxMin[axis] < previousMin[axis])
+			{
+				slabMax[axis] = overlapMin;
+			}
+			else
+			{
+				slabMin[axis] = overlapMax;
+			}
+
+			AddUpdate(cascade, { slabMin[0], slabMin[1], slabMin[2] }, { slabMax[0], slabMax[1], slabMax[2] });
+
+			boxMin[axis] = overlapMin;
+			boxMax[axis] = overlapMax;
+		}
+	}
+
+	m_Valid = true;
+}
+
+void FogClipmapPlanner::Invalidate()
+{
+	m_Valid = false;
+}
+
+void FogClipmapPlanner::SetBaseVoxelSize(float baseVoxelSize)
+{
+	ASSERT(baseVoxelSize > 0.0f, "Invalid clipmap voxel size");
+
+	if (baseVoxelSize != m_BaseVoxelSize)
+	{
+		m_BaseVoxelSize = baseVoxelSize;
+		Invalidate();
+	}
+}
+
+UINT FogClipmapPlanner::GetUpdatedVoxelCount() const
+{
+	UINT count = 0;
+	for (const UpdateBox& update : m_Updates)
+	{
+		count += update.GetVoxelCount();
+	}
+	return count;
+}
+
+
+XMUINT3 FogClipmapPlanner::GetTexel(const XMINT3& voxel) const
+{
+	// Voxel coordinates can be negative, so the remainder is wrapped into [0, resolution)
+	auto Wrap = [resolution = static_cast<INT>(m_Resolution)](INT v)
+		{
+			return static_cast<UINT>(((v % resolution) + resolution) % resolution);
+		};
+
+	return { Wrap(voxel.x), Wrap(voxel.y), Wrap(voxel.z) };
+}
+
+FogClipmapConstantBuffer FogClipmapPlanner::GetConstants() const
+{
+	FogClipmapConstantBuffer constants = {};
+	for (UINT cascade = 0; cascade < s_CascadeCount; cascade++)
+	{
+		constants.Cascades[cascade].Origin = m_Origins.at(cascade);
+		constants.Cascades[cascade].VoxelSize = GetVoxelSize(cascade);
+	}
+	constants.Resolution = m_Resolution;
+	constants.Enabled = 1;
+
+	return constants;
+}
+
+
+void FogClipmapPlanner::AddUpdate(UINT cascade, const XMINT3& voxelMin, const XMINT3& voxelMax)
+{
+	if (voxelMin.x >= voxelMax.x || voxelMin.y >= voxelMax.y || voxelMin.z >= voxelMax.z)
+		return;
+
+	// Each axis splits into at most two ranges: up to the edge of the texture, and the rest from texel 0
+	struct Range
+	{
+		INT VoxelMin;
+		UINT TexelMin;
+		UINT Size;
+	};
+
+	auto SplitAxis = [this](INT first, INT end, Range (&ranges)[2])
+		{
+			const UINT texelMin = GetTexel({ first, 0, 0 }).x;
+			const UINT size = static_cast<UINT>(end - first);
+			const UINT firstSize = min(size, m_Resolution - texelMin);
+
+			ranges[0] = { first, texelMin, firstSize };
+			ranges[1] = { first + static_cast<INT>(firstSize), 0, size - firstSize };
+			return ranges[1].Size > 0 ? 2u : 1u;
+		};
+
+	Range x[2], y[2], z[2];
+	const UINT countX = SplitAxis(voxelMin.x, voxelMax.x, x);
+	const UINT countY = SplitAxis(voxelMin.y, voxelMax.y, y);
+	const UINT countZ = SplitAxis(voxelMin.z, voxelMax.z, z);
+
+	for (UINT k = 0; k < countZ; k++)
+	{
+		for (UINT j = 0; j < countY; j++)
+		{
+			for (UINT i = 0; i < countX; i++)
+			{
+				m_Updates.push_back({
+					.Cascade = cascade,
+					.VoxelMin = { x[i].VoxelMin, y[j].VoxelMin, z[k].VoxelMin },
+					.TexelMin = { x[i].TexelMin, y[j].TexelMin, z[k].TexelMin },
+					.Size = { x[i].Size, y[j].Size, z[k].Size }
+				});
+			}
+		}
+	}
+}
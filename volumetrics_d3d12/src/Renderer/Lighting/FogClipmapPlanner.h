@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+
+using namespace DirectX;
+
+
+/**
+ *	Plans the updates of a world-space fog clipmap: nested cascades of resolution^3 voxels centred on the camera,
+ *	with the voxel size doubling from each cascade to the next.
+ *
+ *	Each cascade is stored toroidally, with voxel v at texel v mod resolution, so when the camera moves
+ *	the voxels that stay inside the cascade keep their texels, and only the slabs of newly exposed voxels are re-baked.
+ *	The slabs are split where they wrap around the edges of the texture, so each update is a single box of texels.
+ *
+ *	Cascades are snapped to their own voxel grid, so coarse cascades move less often than fine ones.
+ *	The planner has no knowledge of D3D, so that it can be tested on its own.
+ */
+class FogClipmapPlanner
+{
+public:
+	inline static constexpr UINT s_CascadeCount = FOG_CLIPMAP_CASCADE_COUNT;
+
+	// A box of voxels of one cascade to re-bake, laid out as FogClipmapUpdateConstants
+	struct UpdateBox
+	{
+		UINT Cascade;
+		XMINT3 VoxelMin;
+		XMUINT3 TexelMin;
+		XMUINT3 Size;
+
+		inline UINT GetVoxelCount() const { return Size.x * Size.y * Size.z; }
+	};
+
+public:
+	FogClipmapPlanner(UINT resolution, float baseVoxelSize);
+	~FogClipmapPlanner() = default;
+
+	DEFAULT_COPY(FogClipmapPlanner)
+	DEFAULT_MOVE(FogClipmapPlanner)
+
+	// Re-centres the cascades on the camera, and lists the voxels that have entered them since the last call
+	// Every voxel is listed after construction or Invalidate
+	void Update(const XMFLOAT3& cameraPosition);
+	// Marks the contents of every cascade as stale, for when the baked media change
+	void Invalidate();
+
+	// Changing the voxel size invalidates the clipmap
+	void SetBaseVoxelSize(float baseVoxelSize);
+
+	inline const std::vector<UpdateBox>& GetUpdates() const { return m_Updates; }
+	UINT GetUpdatedVoxelCount() const;
+
+	inline UINT GetResolution() const { return m_Resolution; }
+	inline float GetBaseVoxelSize() const { return m_BaseVoxelSize; }
+	inline float GetVoxelSize(UINT cascade) const { return m_BaseVoxelSize * static_cast<float>(1u << cascade); }
+	inline const XMINT3& GetCascadeOrigin(UINT cascade) const { return m_Origins.at(cascade); }
+
+	// The texel that a voxel of any cascade is stored in
+	XMUINT3 GetTexel(const XMINT3& voxel) const;
+
+	// Constants for sampling the clipmap as it is after the last Update
+	FogClipmapConstantBuffer GetConstants() const;
+
+private:
+	// Appends a box of voxels of a cascade, split into boxes that do not wrap around the edges of the texture
+	void AddUpdate(UINT cascade, const XMINT3& voxelMin, const XMINT3& voxelMax);
+
+private:
+	UINT m_Resolution;
+	float m_BaseVoxelSize;
+
+	std::array<XMINT3, s_CascadeCount> m_Origins;
+	bool m_Valid = false;
+
+	std::vector<UpdateBox> m_Updates;
+};
@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "FogDensityAtlas.h"
+
+
+FogDensityAtlas::FogDensityAtlas(const XMUINT3& dimensions)
+	: m_Dimensions(dimensions)
+{
+	ASSERT(dimensions.x > 0 && dimensions.y > 0 && dimensions.z > 0, "Invalid atlas dimensions");
+	Clear();
+}
+
+
+void FogDensityAtlas::Clear()
+{
+	m_Texels.assign(static_cast<size_t>(m_Dimensions.x) * m_Dimensions.y * m_Dimensions.z, 0);
+
+	m_Cursor = { 0, 0, 0 };
+	m_ShelfHeight = 0;
+	m_LayerDepth = 0;
+
+	m_EntryCount = 0;
+	m_UsedTexels = 0;
+}
+
+bool FogDensityAtlas::Add(const XMUINT3& dimensions, const UINT8* density, Entry& entry)
+{
+	const XMUINT3 size = { dimensions.x + 2 * s_Border, dimensions.y + 2 * s_Border, dimensions.z + 2 * s_Border };
+	if (size.x > m_Dimensions.x || size.y > m_Dimensions.y || size.z > m_Dimensions.z)
+		return false;
+
+	XMUINT3 cursor = m_Cursor;
+	UINT shelfHeight = m_ShelfHeight;
+	UINT layerDepth = m_LayerDepth;
+
+	// Start a new shelf when the grid does not fit at the end of this one, and a new layer when the shelf does not fit in this one
+	if (cursor.x + size.x > m_Dimensions.x)
+	{
+		cursor.x = 0;
+		cursor.y += shelfHeight;
+		shelfHeight = 0;
+	}
+	if (cursor.y + size.y > m_Dimensions.y)
+	{
+		cursor.x = 0;
+		cursor.y = 0;
+		cursor.z += layerDepth;
+		shelfHeight = 0;
+		layerDepth = 0;
+	}
+	if (cursor.z + size.z > m_Dimensions.z)
+		return false;
+
+	entry.Origin = { cursor.x + s_Border, cursor.y + s_Border, cursor.z + s_Border };
+	entry.Dimensions = dimensions;
+	entry.UVWOffset = {
+		static_cast<float>(entry.Origin.x) / static_cast<float>(m_Dimensions.x),
+		static_cast<float>(entry.Origin.y) / static_cast<float>(m_Dimensions.y),
+		static_cast<float>(entry.Origin.z) / static_cast<float>(m_Dimensions.z)
+	};
+	entry.UVWScale = {
+		static_cast<float>(dimensions.x) / static_cast<float>(m_Dimensions.x),
+		static_cast<float>(dimensions.y) / static_cast<float>(m_Dimensions.y),
+		static_cast<float>(dimensions.z) / static_cast<float>(m_Dimensions.z)
+	};
+
+	for (UINT z = 0; z < dimensions.z; z++)
+	{
+		for (UINT y = 0; y < dimensions.y; y++)
+		{
+			const size_t source = (static_cast<size_t>(z) * dimensions.y + y) * dimensions.x;
+			const size_t destination = (static_cast<size_t>(entry.Origin.z + z) * m_Dimensions.y + entry.Origin.y + y) * m_Dimensions.x + entry.Origin.x;
+			memcpy(&m_Texels[destination], &density[source], dimensions.x);
+		}
+	}
+
+	m_Cursor = { cursor.x + size.x, cursor.y, cursor.z };
+	m_ShelfHeight = max(shelfHeight, size.y);
+	m_LayerDepth = max(layerDepth, size.z);
+
+	m_EntryCount++;
+	m_UsedTexels += static_cast<UINT64>(dimensions.x) * dimensions.y * dimensions.z;
+	return true;
+}
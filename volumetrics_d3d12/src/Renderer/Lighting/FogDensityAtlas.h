@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Core.h"
+
+using namespace DirectX;
+
+
+/**
+ *	A FogDensityAtlas packs the density grids of baked fog volumes, such as those from a FogVoxelizer,
+ *	into a single UNORM8 3D texture, so that density estimation can sample any of them through one descriptor.
+ *
+ *	Grids are packed in order into shelves along x, which are stacked along y into layers, which are stacked along z.
+ *	Each grid is surrounded by empty texels, so that filtering at its edges does not read its neighbours.
+ *
+ *	The atlas has no knowledge of D3D; the renderer uploads its texels.
+ */
+class FogDensityAtlas
+{
+public:
+	// Empty texels around each grid
+	inline static constexpr UINT s_Border = 1;
+
+	struct Entry
+	{
+		XMUINT3 Origin = { 0, 0, 0 };
+		XMUINT3 Dimensions = { 0, 0, 0 };
+
+		// Maps [0, 1] across the grid onto the texture coordinates of its texels in the atlas
+		XMFLOAT3 UVWOffset = { 0.0f, 0.0f, 0.0f };
+		XMFLOAT3 UVWScale = { 0.0f, 0.0f, 0.0f };
+	};
+
+public:
+	FogDensityAtlas(const XMUINT3& dimensions);
+	~FogDensityAtlas() = default;
+
+	DEFAULT_COPY(FogDensityAtlas)
+	DEFAULT_MOVE(FogDensityAtlas)
+
+	// Removes every grid and empties the texels
+	void Clear();
+	// Copies a grid of densities, stored x first, then y, then z, into the next free space
+	// Returns false, and leaves the atlas as it was, if the grid does not fit
+	bool Add(const XMUINT3& dimensions, const UINT8* density, Entry& entry);
+
+	// Getters
+	inline const XMUINT3& GetDimensions() const { return m_Dimensions; }
+	// One byte per texel, stored x first, then y, then z
+	inline const std::vector<UINT8>& GetTexels() const { return m_Texels; }
+	inline UINT GetRowPitch() const { return m_Dimensions.x; }
+	inline UINT GetSlicePitch() const { return m_Dimensions.x * m_Dimensions.y; }
+
+	inline UINT GetEntryCount() const { return m_EntryCount; }
+	// Fraction of the texels covered by grids, not counting their borders
+	inline float GetUsedFraction() const { return static_cast<float>(static_cast<double>(m_UsedTexels) / static_cast<double>(m_Texels.size())); }
+
+private:
+	XMUINT3 m_Dimensions;
+	std::vector<UINT8> m_Texels;
+
+	// The corner of the next grid, and the height of the current shelf and depth of the current layer
+	XMUINT3 m_Cursor = { 0, 0, 0 };
+	UINT m_ShelfHeight = 0;
+	UINT m_LayerDepth = 0;
+
+	UINT m_EntryCount = 0;
+	UINT64 m_UsedTexels = 0;
+};
@@ -0,0 +1,602 @@
+#include "pch.h"
+#include "FogNoiseBaker.h"
+
+#include "Framework/ThreadPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <immintrin.h>
+
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	inline double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+
+	// Lattice hashing
+	// The hash of a cell is seed ^ x * c_HashX ^ y * c_HashY ^ z * c_HashZ, followed by an integer finaliser
+
+	constexpr UINT c_HashX = 0x8da6b343u;
+	constexpr UINT c_HashY = 0xd8163841u;
+	constexpr UINT c_HashZ = 0xcb1ab31fu;
+
+	// Each octave of each channel is seeded differently, so that they are not correlated
+	inline UINT GetOctaveSeed(UINT seed, UINT octave, UINT channel)
+	{
+		return seed * 0x9e3779b9u + (octave * FogNoiseBaker::s_ChannelCount + channel + 1) * 0x632be5abu;
+	}
+
+	inline UINT FinaliseHash(UINT h)
+	{
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+	inline UINT HashCell(UINT seed, UINT x, UINT y, UINT z)
+	{
+		return FinaliseHash(seed ^ x * c_HashX ^ y * c_HashY ^ z * c_HashZ);
+	}
+
+	// Cells are wrapped at the period, which is the number of cells across the texture
+	inline UINT WrapCell(int cell, UINT period)
+	{
+		return static_cast<UINT>(cell < 0 ? cell + static_cast<int>(period) : (cell >= static_cast<int>(period) ? cell - static_cast<int>(period) : cell));
+	}
+
+	// A random offset in [0, 1) for each axis of a Worley feature point, from 10 bits of the hash each
+	inline float GetFeatureOffset(UINT h, UINT axis)
+	{
+		return static_cast<float>((h >> (axis * 10)) & 0x3ff) * (1.0f / 1024.0f);
+	}
+
+
+	// Improved Perlin noise
+
+	inline float Fade(float t)
+	{
+		return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+	}
+
+	inline float Lerp(float a, float b, float t)
+	{
+		return a + (b - a) * t;
+	}
+
+	// One of the 12 gradients to the edge centres of a cube (with 4 repeated) dotted with the offset
+	inline float Grad(UINT h, float x, float y, float z)
+	{
+		h &= 15;
+		const float u = h < 8 ? x : y;
+		const float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+		return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+	}
+
+	// p must be in [0, period) on each axis
+	float GradientNoise(UINT seed, UINT period, float px, float py, float pz)
+	{
+		const UINT ix = static_cast<UINT>(px);
+		const UINT iy = static_cast<UINT>(py);
+		const UINT iz = static_cast<UINT>(pz);
+
+		const float fx = px - static_cast<float>(ix);
+		const float fy = py - static_cast<float>(iy);
+		const float fz = pz - static_cast<float>(iz);
+
+		const UINT ix1 = WrapCell(ix + 1, period);
+		const UINT iy1 = WrapCell(iy + 1, period);
+		const UINT iz1 = WrapCell(iz + 1, period);
+
+		const float n000 = Grad(HashCell(seed, ix, iy, iz), fx, fy, fz);
+		const float n100 = Grad(HashCell(seed, ix1, iy, iz), fx - 1.0f, fy, fz);
+		const float n010 = Grad(HashCell(seed, ix, iy1, iz), fx, fy - 1.0f, fz);
+		const float n110 = Grad(HashCell(seed, ix1, iy1, iz), fx - 1.0f, fy - 1.0f, fz);
+		const float n001 = Grad(HashCell(seed, ix, iy, iz1), fx, fy, fz - 1.0f);
+		const float n101 = Grad(HashCell(seed, ix1, iy, iz1), fx - 1.0f, fy, fz - 1.0f);
+		const float n011 = Grad(HashCell(seed, ix, iy1, iz1), fx, fy - 1.0f, fz - 1.0f);
+		const float n111 = Grad(HashCell(seed, ix1, iy1, iz1), fx - 1.0f, fy - 1.0f, fz - 1.0f);
+
+		const float u = Fade(fx);
+		const float v = Fade(fy);
+		const float w = Fade(fz);
+
+		return Lerp(
+			Lerp(Lerp(n000, n100, u), Lerp(n010, n110, u), v),
+			Lerp(Lerp(n001, n101, u), Lerp(n011, n111, u), v),
+			w);
+	}
+
+	// Distance to the nearest feature point, with one point per cell, clamped to 1
+	// p must be in [0, period) on each axis
+	float WorleyNoise(UINT seed, UINT period, float px, float py, float pz)
+	{
+		const int ix = static_cast<int>(px);
+		const int iy = static_cast<int>(py);
+		const int iz = static_cast<int>(pz);
+
+		const float fx = px - static_cast<float>(ix);
+		const float fy = py - static_cast<float>(iy);
+		const float fz = pz - static_cast<float>(iz);
+
+		float minDistanceSq = 1.0f;
+		for (int dz = -1; dz <= 1; dz++)
+		{
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					const UINT h = HashCell(seed, WrapCell(ix + dx, period), WrapCell(iy + dy, period), WrapCell(iz + dz, period));
+
+					const float ox = static_cast<float>(dx) + GetFeatureOffset(h, 0) - fx;
+					const float oy = static_cast<float>(dy) + GetFeatureOffset(h, 1) - fy;
+					const float oz = static_cast<float>(dz) + GetFeatureOffset(h, 2) - fz;
+
+					minDistanceSq = min(minDistanceSq, ox * ox + oy * oy + oz * oz);
+				}
+			}
+		}
+
+		return sqrtf(minDistanceSq);
+	}
+
+	inline UINT8 QuantiseUNorm8(float x)
+	{
+		return static_cast<UINT8>(min(max(x, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+
+	// 4-wide versions of the noise, along x
+	// Only SSE2 is used, which every x64 processor supports
+
+	// 32-bit multiply, keeping the low half, as _mm_mullo_epi32 needs SSE4.1
+	inline __m128i MulLo32(__m128i a, __m128i b)
+	{
+		const __m128i even = _mm_mul_epu32(a, b);
+		const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+	}
+
+	inline __m128i FinaliseHash4(__m128i h)
+	{
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+		h = MulLo32(h, _mm_set1_epi32(0x7feb352d));
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+		h = MulLo32(h, _mm_set1_epi32(static_cast<int>(0x846ca68bu)));
+		h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+		return h;
+	}
+
+	// Every lane shares the y and z of the cell, which are folded into yzSeed = seed ^ y * c_HashY ^ z * c_HashZ
+	inline __m128i HashCell4(UINT yzSeed, __m128i x)
+	{
+		return FinaliseHash4(_mm_xor_si128(_mm_set1_epi32(static_cast<int>(yzSeed)), MulLo32(x, _mm_set1_epi32(static_cast<int>(c_HashX)))));
+	}
+
+	inline UINT GetYZSeed(UINT seed, UINT y, UINT z)
+	{
+		return seed ^ y * c_HashY ^ z * c_HashZ;
+	}
+
+	// Wraps cells that are at most one period outside [0, period)
+	inline __m128i WrapCell4(__m128i cell, UINT period)
+	{
+		const __m128i periodV = _mm_set1_epi32(static_cast<int>(period));
+		const __m128i below = _mm_cmplt_epi32(cell, _mm_setzero_si128());
+		const __m128i above = _mm_cmpgt_epi32(cell, _mm_sub_epi32(periodV, _mm_set1_epi32(1)));
+		cell = _mm_add_epi32(cell, _mm_and_si128(below, periodV));
+		return _mm_sub_epi32(cell, _mm_and_si128(above, periodV));
+	}
+
+	inline __m128 Select4(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	inline __m128 Fade4(__m128 t)
+	{
+		const __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+		return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+	}
+
+	inline __m128 Lerp4(__m128 a, __m128 b, __m128 t)
+	{
+		return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+	}
+
+	inline __m128 Grad4(__m128i h, __m128 x, float y, float z)
+	{
+		h = _mm_and_si128(h, _mm_set1_epi32(15));
+
+		const __m128 yV = _mm_set1_ps(y);
+		const __m128 zV = _mm_set1_ps(z);
+
+		const __m128 below8 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8)));
+		const __m128 below4 = _mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4)));
+		const __m128 useX = _mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14))));
+
+		const __m128 u = Select4(below8, x, yV);
+		const __m128 v = Select4(below4, yV, Select4(useX, x, zV));
+
+		// Bits 0 and 1 of the hash flip the signs of u and v
+		const __m128 signU = _mm_castsi128_ps(_mm_slli_epi32(h, 31));
+		const __m128 signV = _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(h, 1), 31));
+		return _mm_add_ps(_mm_xor_ps(u, signU), _mm_xor_ps(v, signV));
+	}
+
+	__m128 GradientNoise4(UINT seed, UINT period, __m128 px, float py, float pz)
+	{
+		// p is never negative, so truncation is the floor
+		const __m128i ix = _mm_cvttps_epi32(px);
+		const UINT iy = static_cast<UINT>(py);
+		const UINT iz = static_cast<UINT>(pz);
+
+		const __m128 fx = _mm_sub_ps(px, _mm_cvtepi32_ps(ix));
+		const float fy = py - static_cast<float>(iy);
+		const float fz = pz - static_cast<float>(iz);
+
+		const __m128i ix1 = WrapCell4(_mm_add_epi32(ix, _mm_set1_epi32(1)), period);
+		const UINT iy1 = WrapCell(iy + 1, period);
+		const UINT iz1 = WrapCell(iz + 1, period);
+
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 fx1 = _mm_sub_ps(fx, one);
+
+		const UINT seed00 = GetYZSeed(seed, iy, iz);
+		const UINT seed10 = GetYZSeed(seed, iy1, iz);
+		const UINT seed01 = GetYZSeed(seed, iy, iz1);
+		const UINT seed11 = GetYZSeed(seed, iy1, iz1);
+
+		const __m128 n000 = Grad4(HashCell4(seed00, ix), fx, fy, fz);
+		const __m128 n100 = Grad4(HashCell4(seed00, ix1), fx1, fy, fz);
+		const __m128 n010 = Grad4(HashCell4(seed10, ix), fx, fy - 1.0f, fz);
+		const __m128 n110 = Grad4(HashCell4(seed10, ix1), fx1, fy - 1.0f, fz);
+		const __m128 n001 = Grad4(HashCell4(seed01, ix), fx, fy, fz - 1.0f);
+		const __m128 n101 = Grad4(HashCell4(seed01, ix1), fx1, fy, fz - 1.0f);
+		const __m128 n011 = Grad4(HashCell4(seed11, ix), fx, fy - 1.0f, fz - 1.0f);
+		const __m128 n111 = Grad4(HashCell4(seed11, ix1), fx1, fy - 1.0f, fz - 1.0f);
+
+		const __m128 u = Fade4(fx);
+		const __m128 v = _mm_set1_ps(Fade(fy));
+		const __m128 w = _mm_set1_ps(Fade(fz));
+
+		return Lerp4(
+			Lerp4(Lerp4(n000, n100, u), Lerp4(n010, n110, u), v),
+			Lerp4(Lerp4(n001, n101, u), Lerp4(n011, n111, u), v),
+			w);
+	}
+
+	__m128 WorleyNoise4(UINT seed, UINT period, __m128 px, float py, float pz)
+	{
+		const __m128i ix = _mm_cvttps_epi32(px);
+		const int iy = static_cast<int>(py);
+		const int iz = static_cast<int>(pz);
+
+		const __m128 fx = _mm_sub_ps(px, _mm_cvtepi32_ps(ix));
+		const float fy = py - static_cast<float>(iy);
+		const float fz = pz - static_cast<float>(iz);
+
+		// The neighbouring cells along x, which differ per lane
+		const __m128i cellsX[3] = {
+			WrapCell4(_mm_sub_epi32(ix, _mm_set1_epi32(1)), period),
+			ix,
+			WrapCell4(_mm_add_epi32(ix, _mm_set1_epi32(1)), period)
+		};
+
+		const __m128i offsetMask = _mm_set1_epi32(0x3ff);
+		const __m128 offsetScale = _mm_set1_ps(1.0f / 1024.0f);
+
+		__m128 minDistanceSq = _mm_set1_ps(1.0f);
+		for (int dz = -1; dz <= 1; dz++)
+		{
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				const UINT yzSeed = GetYZSeed(seed, WrapCell(iy + dy, period), WrapCell(iz + dz, period));
+
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					const __m128i h = HashCell4(yzSeed, cellsX[dx + 1]);
+
+					const __m128 offsetX = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(h, offsetMask)), offsetScale);
+					const __m128 offsetY = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(h, 10), offsetMask)), offsetScale);
+					const __m128 offsetZ = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(h, 20), offsetMask)), offsetScale);
+
+					const __m128 ox = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(dx)), offsetX), fx);
+					const __m128 oy = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(dy)), offsetY), _mm_set1_ps(fy));
+					const __m128 oz = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(dz)), offsetZ), _mm_set1_ps(fz));
+
+					const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz));
+					minDistanceSq = _mm_min_ps(minDistanceSq, distanceSq);
+				}
+			}
+		}
+
+		return _mm_sqrt_ps(minDistanceSq);
+	}
+
+
+	// 64-bit FNV-1a
+	constexpr UINT64 c_FNVOffsetBasis = 0xcbf29ce484222325ull;
+	constexpr UINT64 c_FNVPrime = 0x100000001b3ull;
+
+	inline UINT64 HashBytes(const void* data, size_t size, UINT64 hash = c_FNVOffsetBasis)
+	{
+		const UINT8* bytes = static_cast<const UINT8*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= c_FNVPrime;
+		}
+		return hash;
+	}
+
+	template<typename T>
+	inline UINT64 HashValue(const T& value, UINT64 hash)
+	{
+		return HashBytes(&value, sizeof(T), hash);
+	}
+
+
+	struct CacheFileHeader
+	{
+		char Magic[4];
+		UINT Version;
+		UINT64 DescHash;
+
+		UINT Resolution;
+		UINT Seed;
+		UINT Octaves;
+		UINT Frequency;
+		float Persistence;
+		UINT Padding;
+
+		UINT64 TexelHash;
+	};
+
+	constexpr char s_CacheFileMagic[4] = { 'F', 'N', 'O', 'Z' };
+}
+
+
+FogNoiseBaker::FogNoiseBaker(ThreadPool& threadPool)
+	: m_ThreadPool(&threadPool)
+{
+}
+
+
+void FogNoiseBaker::Bake(const Desc& desc)
+{
+	const auto start = Clock::now();
+
+	m_Desc = desc;
+	BakeSlices(desc, m_Texels, *m_ThreadPool);
+
+	m_LastBakeMilliseconds = MillisecondsSince(start);
+	m_LoadedFromCache = false;
+}
+
+void FogNoiseBaker::LoadOrBake(const Desc& desc, const std::string& cacheDirectory)
+{
+	const std::string path = GetCachePath(cacheDirectory, desc);
+
+	const auto start = Clock::now();
+	if (LoadCache(path, desc))
+	{
+		m_LastBakeMilliseconds = MillisecondsSince(start);
+		m_LoadedFromCache = true;
+
+		LOG_INFO("Fog noise: Loaded {}^3 texture from {} in {:.2f} ms", desc.Resolution, path, m_LastBakeMilliseconds);
+		return;
+	}
+
+	Bake(desc);
+	LOG_INFO("Fog noise: Baked {}^3 texture in {:.2f} ms", desc.Resolution, m_LastBakeMilliseconds);
+
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+	if (error)
+	{
+		LOG_WARN("Fog noise: Failed to create the cache directory {}", cacheDirectory);
+		return;
+	}
+
+	SaveCache(path);
+}
+
+
+UINT64 FogNoiseBaker::HashDesc(const Desc& desc)
+{
+	// Fields are hashed one at a time, so that padding does not affect the hash
+	UINT64 hash = c_FNVOffsetBasis;
+	hash = HashValue(s_Version, hash);
+	hash = HashValue(desc.Resolution, hash);
+	hash = HashValue(desc.Seed, hash);
+	hash = HashValue(desc.Octaves, hash);
+	hash = HashValue(desc.Frequency, hash);
+	hash = HashValue(desc.Persistence, hash);
+	return hash;
+}
+
+std::string FogNoiseBaker::GetCachePath(const std::string& cacheDirectory, const Desc& desc)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "fog_noise_%016llx.bin", static_cast<unsigned long long>(HashDesc(desc)));
+	return cacheDirectory + "/" + name;
+}
+
+bool FogNoiseBaker::SaveCache(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for writing", path);
+		return false;
+	}
+
+	CacheFileHeader header = {};
+	memcpy(header.Magic, s_CacheFileMagic, sizeof(header.Magic));
+	header.Version = s_Version;
+	header.DescHash = HashDesc(m_Desc);
+	header.Resolution = m_Desc.Resolution;
+	header.Seed = m_Desc.Seed;
+	header.Octaves = m_Desc.Octaves;
+	header.Frequency = m_Desc.Frequency;
+	header.Persistence = m_Desc.Persistence;
+	header.TexelHash = HashBytes(m_Texels.data(), m_Texels.size());
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_Texels.data()), m_Texels.size());
+	return file.good();
+}
+
+bool FogNoiseBaker::LoadCache(const std::string& path, const Desc& desc)
+{
+	// A missing file is the usual case for parameters that have not been baked before
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	CacheFileHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || memcmp(header.Magic, s_CacheFileMagic, sizeof(header.Magic)) != 0 || header.Version != s_Version)
+	{
+		LOG_WARN("Fog noise: {} is not a cache file of this version", path);
+		return false;
+	}
+
+	const Desc fileDesc = {
+		.Resolution = header.Resolution,
+		.Seed = header.Seed,
+		.Octaves = header.Octaves,
+		.Frequency = header.Frequency,
+		.Persistence = header.Persistence
+	};
+
+	if (!(fileDesc == desc) || header.DescHash != HashDesc(desc))
+	{
+		LOG_WARN("Fog noise: {} was baked with different parameters", path);
+		return false;
+	}
+
+	std::vector<UINT8> texels(static_cast<size_t>(desc.Resolution) * desc.Resolution * desc.Resolution * s_ChannelCount);
+	file.read(reinterpret_cast<char*>(texels.data()), texels.size());
+	if (!file || HashBytes(texels.data(), texels.size()) != header.TexelHash)
+	{
+		LOG_WARN("Fog noise: {} is truncated or corrupt", path);
+		return false;
+	}
+
+	m_Desc = desc;
+	m_Texels = std::move(texels);
+	return true;
+}
+
+
+void FogNoiseBaker::EvaluateTexel(const Desc& desc, UINT x, UINT y, UINT z, float& gradient, float& worley)
+{
+	const float invResolution = 1.0f / static_cast<float>(desc.Resolution);
+
+	float gradientSum = 0.0f;
+	float worleySum = 0.0f;
+	float amplitudeSum = 0.0f;
+
+	float amplitude = 1.0f;
+	for (UINT octave = 0; octave < desc.Octaves; octave++)
+	{
+		const UINT period = desc.Frequency << octave;
+		const float scale = static_cast<float>(period) * invResolution;
+
+		// Texel centres, in cells of this octave
+		const float px = (static_cast<float>(x) + 0.5f) * scale;
+		const float py = (static_cast<float>(y) + 0.5f) * scale;
+		const float pz = (static_cast<float>(z) + 0.5f) * scale;
+
+		gradientSum += amplitude * GradientNoise(GetOctaveSeed(desc.Seed, octave, 0), period, px, py, pz);
+		worleySum += amplitude * (1.0f - WorleyNoise(GetOctaveSeed(desc.Seed, octave, 1), period, px, py, pz));
+		amplitudeSum += amplitude;
+
+		amplitude *= desc.Persistence;
+	}
+
+	// Gradient noise is in [-1, 1]
+	const float invAmplitudeSum = 1.0f / amplitudeSum;
+	gradient = 0.5f + 0.5f * (gradientSum * invAmplitudeSum);
+	worley = worleySum * invAmplitudeSum;
+}
+
+
+void FogNoiseBaker::BakeSlices(const Desc& desc, std::vector<UINT8>& texels, ThreadPool& threadPool)
+{
+	ASSERT(desc.Resolution > 0 && desc.Resolution % 4 == 0, "The resolution must be a multiple of 4");
+	ASSERT(desc.Octaves > 0 && desc.Frequency > 0, "Invalid noise parameters");
+	// The lattice of the last octave must fit the hash's cell coordinates
+	ASSERT((static_cast<UINT64>(desc.Frequency) << (desc.Octaves - 1)) <= (1u << 24), "Too many octaves for the frequency");
+
+	const UINT resolution = desc.Resolution;
+	texels.resize(static_cast<size_t>(resolution) * resolution * resolution * s_ChannelCount);
+
+	const float invResolution = 1.0f / static_cast<float>(resolution);
+	const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+	threadPool.ParallelFor(resolution, 1, [&](UINT begin, UINT end)
+		{
+			for (UINT z = begin; z < end; z++)
+			{
+				for (UINT y = 0; y < resolution; y++)
+				{
+					UINT8* row = texels.data() + (static_cast<size_t>(z) * resolution + y) * resolution * s_ChannelCount;
+
+					for (UINT x = 0; x < resolution; x += 4)
+					{
+						const __m128 texelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+
+						__m128 gradientSum = _mm_setzero_ps();
+						__m128 worleySum = _mm_setzero_ps();
+						float amplitudeSum = 0.0f;
+
+						float amplitude = 1.0f;
+						for (UINT octave = 0; octave < desc.Octaves; octave++)
+						{
+							const UINT period = desc.Frequency << octave;
+							const float scale = static_cast<float>(period) * invResolution;
+
+							const __m128 px = _mm_mul_ps(texelX, _mm_set1_ps(scale));
+							const float py = (static_cast<float>(y) + 0.5f) * scale;
+							const float pz = (static_cast<float>(z) + 0.5f) * scale;
+
+							const __m128 amplitudeV = _mm_set1_ps(amplitude);
+							const __m128 gradient = GradientNoise4(GetOctaveSeed(desc.Seed, octave, 0), period, px, py, pz);
+							const __m128 worley = _mm_sub_ps(_mm_set1_ps(1.0f), WorleyNoise4(GetOctaveSeed(desc.Seed, octave, 1), period, px, py, pz));
+
+							gradientSum = _mm_add_ps(gradientSum, _mm_mul_ps(amplitudeV, gradient));
+							worleySum = _mm_add_ps(worleySum, _mm_mul_ps(amplitudeV, worley));
+							amplitudeSum += amplitude;
+
+							amplitude *= desc.Persistence;
+						}
+
+						const __m128 invAmplitudeSum = _mm_set1_ps(1.0f / amplitudeSum);
+
+						alignas(16) float gradients[4];
+						alignas(16) float worleys[4];
+						_mm_store_ps(gradients, _mm_add_ps(_mm_set1_ps(0.5f), _mm_mul_ps(_mm_set1_ps(0.5f), _mm_mul_ps(gradientSum, invAmplitudeSum))));
+						_mm_store_ps(worleys, _mm_mul_ps(worleySum, invAmplitudeSum));
+
+						for (UINT lane = 0; lane < 4; lane++)
+						{
+							row[(x + lane) * s_ChannelCount + 0] = QuantiseUNorm8(gradients[lane]);
+							row[(x + lane) * s_ChannelCount + 1] = QuantiseUNorm8(worleys[lane]);
+						}
+					}
+				}
+			}
+		});
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Core.h"
+
+#include <string>
+
+class ThreadPool;
+
+
+/**
+ *	Bakes a tileable 3D noise texture on the CPU, for density estimation to modulate the fog with
+ *	instead of evaluating noise per froxel per frame.
+ *
+ *	Each texel holds two channels of fractal (fBm) noise, stored as UNORM8:
+ *		R - Gradient (Perlin) noise
+ *		G - Inverted Worley (cellular) noise, 1 - F1
+ *	Every octave uses a lattice with a whole number of cells across the texture, wrapped at its edges,
+ *	so the texture tiles seamlessly with wrap addressing.
+ *
+ *	Slices of the texture are split across a ThreadPool, and each row is evaluated 4 texels at a time with SSE2.
+ *
+ *	Bakes are cached on disk in files named after a hash of the bake parameters, so that startup only bakes
+ *	a texture that has not been baked before. The cache files also hold a hash of the texels, and are rebaked if it does not match.
+ *	The baker has no knowledge of D3D, so that it can be tested and benchmarked on its own.
+ */
+class FogNoiseBaker
+{
+public:
+	inline static constexpr UINT s_ChannelCount = 2;
+
+	// Bumped when the noise functions or the cache file layout change, so that old cache files are not loaded
+	inline static constexpr UINT s_Version = 1;
+
+	struct Desc
+	{
+		// Texels along each axis, which must be a multiple of 4
+		UINT Resolution = 64;
+		UINT Seed = 0;
+		UINT Octaves = 4;
+		// Cells across the texture in the first octave, which doubles with each octave
+		UINT Frequency = 4;
+		// Amplitude of each octave relative to the previous one
+		float Persistence = 0.5f;
+
+		bool operator==(const Desc& other) const = default;
+	};
+
+public:
+	FogNoiseBaker(ThreadPool& threadPool);
+	~FogNoiseBaker() = default;
+
+	DISALLOW_COPY(FogNoiseBaker)
+	DEFAULT_MOVE(FogNoiseBaker)
+
+	// Bakes the texture, without reading or writing the cache
+	void Bake(const Desc& desc);
+	// Loads the texture from the cache directory if it has been baked with the same parameters before,
+	// otherwise bakes it and writes it to the cache
+	void LoadOrBake(const Desc& desc, const std::string& cacheDirectory);
+
+	// Cache files
+	static UINT64 HashDesc(const Desc& desc);
+	static std::string GetCachePath(const std::string& cacheDirectory, const Desc& desc);
+	bool SaveCache(const std::string& path) const;
+	// Fails if the file was baked with different parameters, or its texels do not match their hash
+	bool LoadCache(const std::string& path, const Desc& desc);
+
+	// The value of both channels of a texel, in [0, 1], evaluated without SSE
+	// This is the definition that the vectorised bake follows
+	static void EvaluateTexel(const Desc& desc, UINT x, UINT y, UINT z, float& gradient, float& worley);
+
+	// Getters
+	inline const Desc& GetDesc() const { return m_Desc; }
+	// s_ChannelCount bytes per texel, stored x first, then y, then z
+	inline const std::vector<UINT8>& GetTexels() const { return m_Texels; }
+	inline UINT GetRowPitch() const { return m_Desc.Resolution * s_ChannelCount; }
+	inline UINT GetSlicePitch() const { return GetRowPitch() * m_Desc.Resolution; }
+
+	// Time spent in the last Bake or LoadOrBake, and whether it was loaded from the cache
+	inline double GetLastBakeMilliseconds() const { return m_LastBakeMilliseconds; }
+	inline bool WasLoadedFromCache() const { return m_LoadedFromCache; }
+
+private:
+	static void BakeSlices(const Desc& desc, std::vector<UINT8>& texels, ThreadPool& threadPool);
+
+private:
+	ThreadPool* m_ThreadPool;
+
+	Desc m_Desc;
+	std::vector<UINT8> m_Texels;
+
+	double m_LastBakeMilliseconds = 0.0;
+	bool m_LoadedFromCache = false;
+};
@@ -0,0 +1,470 @@
+#include "pch.h"
+#include "FogVolumeBinner.h"
+
+#include "Framework/Frustum.h"
+#include "Framework/ThreadPool.h"
+
+#include <bit>
+#include <immintrin.h>
+
+
+XMMATRIX FogVolume::GetLocalToWorld() const
+{
+	const XMFLOAT3 scale = Shape == FOG_VOLUME_SHAPE_SPHERE ? XMFLOAT3(Extents.x, Extents.x, Extents.x) : Extents;
+
+	return XMMatrixScaling(scale.x, scale.y, scale.z)
+		* XMMatrixRotationRollPitchYaw(Rotation.x, Rotation.y, Rotation.z)
+		* XMMatrixTranslation(Position.x, Position.y, Position.z);
+}
+
+FogVolumeGPUData FogVolume::GetGPUData() const
+{
+	const XMMATRIX worldToLocal = XMMatrixTranspose(XMMatrixInverse(nullptr, GetLocalToWorld()));
+
+	FogVolumeGPUData data;
+	XMStoreFloat4(&data.WorldToLocal[0], worldToLocal.r[0]);
+	XMStoreFloat4(&data.WorldToLocal[1], worldToLocal.r[1]);
+	XMStoreFloat4(&data.WorldToLocal[2], worldToLocal.r[2]);
+
+	data.Albedo = Albedo;
+	data.Extinction = Extinction;
+	data.Emission = Emission;
+	data.Anisotropy = Anisotropy;
+	data.Shape = Shape;
+	data.Falloff = Falloff;
+	data.AtlasOffset = AtlasOffset;
+	data.AtlasScale = AtlasScale;
+	return data;
+}
+
+
+void FogVolumeBinner::SetFroxelGrid(const XMUINT3& froxelResolution, const float* froxelSliceDepths, const XMMATRIX& projection)
+{
+	ASSERT(froxelResolution.x > 0 && froxelResolution.y > 0 && froxelResolution.z > 0 &&
+		froxelResolution.x % s_TileSize == 0 &&
+		froxelResolution.y % s_TileSize == 0 &&
+		froxelResolution.z % s_TileSize == 0,
+		"Invalid froxel resolution");
+
+	XMFLOAT4X4 projectionFloats;
+	XMStoreFloat4x4(&projectionFloats, projection);
+
+	const size_t sliceDepthCount = froxelResolution.z + 1;
+	const bool changed = froxelResolution.x != m_FroxelResolution.x
+		|| froxelResolution.y != m_FroxelResolution.y
+		|| froxelResolution.z != m_FroxelResolution.z
+		|| memcmp(&projectionFloats, &m_Projection, sizeof(XMFLOAT4X4)) != 0
+		|| memcmp(froxelSliceDepths, m_FroxelSliceDepths.data(), sliceDepthCount * sizeof(float)) != 0;
+	if (!changed)
+		return;
+
+	m_FroxelResolution = froxelResolution;
+	m_TileGridDimensions = {
+		froxelResolution.x / s_TileSize,
+		froxelResolution.y / s_TileSize,
+		froxelResolution.z / s_TileSize
+	};
+	m_Projection = projectionFloats;
+	m_FroxelSliceDepths.assign(froxelSliceDepths, froxelSliceDepths + sliceDepthCount);
+
+	// Unproject each tile corner onto the near and far planes
+	// View-space depth varies linearly along the line between the two, for perspective and orthographic projections alike
+	const XMMATRIX invProjection = XMMatrixInverse(nullptr, projection);
+
+	const UINT cornersX = m_TileGridDimensions.x + 1;
+	const UINT cornersY = m_TileGridDimensions.y + 1;
+	std::vector<XMFLOAT3> nearCorners(cornersX * cornersY);
+	std::vector<XMFLOAT3> farCorners(cornersX * cornersY);
+	for (UINT y = 0; y < cornersY; y++)
+	{
+		for (UINT x = 0; x < cornersX; x++)
+		{
+			const float ndcX = -1.0f + 2.0f * static_cast<float>(x) / static_cast<float>(m_TileGridDimensions.x);
+			const float ndcY = 1.0f - 2.0f * static_cast<float>(y) / static_cast<float>(m_TileGridDimensions.y);
+
+			XMStoreFloat3(&nearCorners.at(y * cornersX + x), XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), invProjection));
+			XMStoreFloat3(&farCorners.at(y * cornersX + x), XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), invProjection));
+		}
+	}
+
+	m_TileBounds.resize(GetTileCount());
+	m_RowBounds.resize(m_TileGridDimensions.y * m_TileGridDimensions.z);
+	m_SliceBounds.resize(m_TileGridDimensions.z);
+
+	const Bounds emptyBounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+
+	for (UINT z = 0; z < m_TileGridDimensions.z; z++)
+	{
+		// The tile's density samples lie on its first s_TileSize froxel slices, which end before the next tile's first slice
+		const float depths[2] = { m_FroxelSliceDepths.at(z * s_TileSize), m_FroxelSliceDepths.at((z + 1) * s_TileSize) };
+
+		Bounds& sliceBounds = m_SliceBounds.at(z);
+		sliceBounds = emptyBounds;
+
+		for (UINT y = 0; y < m_TileGridDimensions.y; y++)
+		{
+			Bounds& rowBounds = m_RowBounds.at(z * m_TileGridDimensions.y + y);
+			rowBounds = emptyBounds;
+
+			for (UINT x = 0; x < m_TileGridDimensions.x; x++)
+			{
+				// The tile is bounded by its 4 corners at each of the slice's 2 depths
+				Bounds tileBounds = emptyBounds;
+				for (UINT corner = 0; corner < 4; corner++)
+				{
+					const UINT cornerIndex = (y + corner / 2) * cornersX + (x + corner % 2);
+					const XMVECTOR nearCorner = XMLoadFloat3(&nearCorners.at(cornerIndex));
+					const XMVECTOR farCorner = XMLoadFloat3(&farCorners.at(cornerIndex));
+					const float nearDepth = nearCorners.at(cornerIndex).z;
+					const float farDepth = farCorners.at(cornerIndex).z;
+
+					for (const float depth : depths)
+					{
+						XMFLOAT3 p;
+						XMStoreFloat3(&p, XMVectorLerp(nearCorner, farCorner, (depth - nearDepth) / (farDepth - nearDepth)));
+
+						// Use the exact slice depth, so that neighbouring slices share their boundary
+						p.z = depth;
+
+						tileBounds = Union(tileBounds, { p, p });
+					}
+				}
+
+				m_TileBounds.at((z * m_TileGridDimensions.y + y) * m_TileGridDimensions.x + x) = tileBounds;
+				rowBounds = Union(rowBounds, tileBounds);
+			}
+
+			sliceBounds = Union(sliceBounds, rowBounds);
+		}
+	}
+}
+
+void FogVolumeBinner::SetVolumes(const FogVolume* volumes, UINT volumeCount, const XMMATRIX& view)
+{
+	ASSERT(!m_FroxelSliceDepths.empty(), "The froxel grid must be set before the volumes");
+
+	// The view frustum, cut down to the depth range of the froxel volume
+	Frustum frustum = Frustum::FromViewProjection(XMLoadFloat4x4(&m_Projection));
+	frustum.Planes.at(Frustum::Plane_Near) = { 0.0f, 0.0f, 1.0f, -m_FroxelSliceDepths.front() };
+	frustum.Planes.at(Frustum::Plane_Far) = { 0.0f, 0.0f, -1.0f, m_FroxelSliceDepths.back() };
+
+	m_ViewToLocal.resize(volumeCount);
+	m_Shapes.resize(volumeCount);
+	m_Volumes.Clear();
+
+	for (UINT i = 0; i < volumeCount; i++)
+	{
+		const FogVolume& volume = volumes[i];
+
+		const XMMATRIX localToView = volume.GetLocalToWorld() * view;
+		XMStoreFloat4x4(&m_ViewToLocal.at(i), XMMatrixInverse(nullptr, localToView));
+		m_Shapes.at(i) = volume.Shape;
+
+		// The rows are the view-space axes of the volume, scaled by its extents, and are orthogonal
+		XMFLOAT4X4 m;
+		XMStoreFloat4x4(&m, localToView);
+
+		const XMFLOAT3 center = { m._41, m._42, m._43 };
+		XMFLOAT3 extent;
+		float radius;
+		if (FogVolume::IsBoxShape(volume.Shape))
+		{
+			// Projection of the box onto each view axis, and the distance to its corners
+			extent.x = fabsf(m._11) + fabsf(m._21) + fabsf(m._31);
+			extent.y = fabsf(m._12) + fabsf(m._22) + fabsf(m._32);
+			extent.z = fabsf(m._13) + fabsf(m._23) + fabsf(m._33);
+			radius = sqrtf(
+				m._11 * m._11 + m._12 * m._12 + m._13 * m._13 +
+				m._21 * m._21 + m._22 * m._22 + m._23 * m._23 +
+				m._31 * m._31 + m._32 * m._32 + m._33 * m._33);
+		}
+		else
+		{
+			// The tight box around an ellipsoid, and its largest radius
+			extent.x = sqrtf(m._11 * m._11 + m._21 * m._21 + m._31 * m._31);
+			extent.y = sqrtf(m._12 * m._12 + m._22 * m._22 + m._32 * m._32);
+			extent.z = sqrtf(m._13 * m._13 + m._23 * m._23 + m._33 * m._33);
+			radius = sqrtf(max(max(
+				m._11 * m._11 + m._12 * m._12 + m._13 * m._13,
+				m._21 * m._21 + m._22 * m._22 + m._23 * m._23),
+				m._31 * m._31 + m._32 * m._32 + m._33 * m._33));
+		}
+
+		bool visible = true;
+		for (const XMFLOAT4& plane : frustum.Planes)
+		{
+			const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			const float boxReach = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+			if (distance < -radius || distance < -boxReach)
+			{
+				visible = false;
+				break;
+			}
+		}
+		if (!visible)
+			continue;
+
+		m_Volumes.CenterX.push_back(center.x);
+		m_Volumes.CenterY.push_back(center.y);
+		m_Volumes.CenterZ.push_back(center.z);
+		m_Volumes.ExtentX.push_back(extent.x);
+		m_Volumes.ExtentY.push_back(extent.y);
+		m_Volumes.ExtentZ.push_back(extent.z);
+		m_Volumes.Radius.push_back(radius);
+		m_Volumes.Index.push_back(i);
+	}
+}
+
+
+void FogVolumeBinner::BinVolumes(ThreadPool& threadPool)
+{
+	const UINT sliceCount = m_TileGridDimensions.z;
+	const UINT tilesPerSlice = m_TileGridDimensions.x * m_TileGridDimensions.y;
+
+	m_SliceBins.resize(sliceCount);
+	threadPool.ParallelFor(sliceCount, 1, [this](UINT begin, UINT end)
+		{
+			for (UINT slice = begin; slice < end; slice++)
+			{
+				BinSlice(slice);
+			}
+		});
+
+	// Each slice's indices follow on from those of the previous slices
+	UINT indexCount = 0;
+	for (auto& bins : m_SliceBins)
+	{
+		bins.FirstIndex = indexCount;
+		indexCount += static_cast<UINT>(bins.VolumeIndices.size());
+	}
+
+	m_TileVolumeRanges.resize(GetTileCount());
+	m_VolumeIndices.resize(indexCount);
+	threadPool.ParallelFor(sliceCount, 1, [this, tilesPerSlice](UINT begin, UINT end)
+		{
+			for (UINT slice = begin; slice < end; slice++)
+			{
+				const SliceBins& bins = m_SliceBins.at(slice);
+
+				XMUINT2* ranges = &m_TileVolumeRanges.at(slice * tilesPerSlice);
+				for (UINT tile = 0; tile < tilesPerSlice; tile++)
+				{
+					ranges[tile] = { bins.FirstIndex + bins.TileVolumeRanges[tile].x, bins.TileVolumeRanges[tile].y };
+				}
+
+				if (!bins.VolumeIndices.empty())
+				{
+					memcpy(&m_VolumeIndices.at(bins.FirstIndex), bins.VolumeIndices.data(), bins.VolumeIndices.size() * sizeof(UINT));
+				}
+			}
+		});
+}
+
+void FogVolumeBinner::BinVolumesReference(std::vector<XMUINT2>& tileVolumeRanges, std::vector<UINT>& volumeIndices) const
+{
+	const XMMATRIX projection = XMLoadFloat4x4(&m_Projection);
+	const XMMATRIX invProjection = XMMatrixInverse(nullptr, projection);
+
+	// View-space position of each froxel's density sample, as computed by density estimation
+	std::vector<XMFLOAT3> samples(static_cast<size_t>(m_FroxelResolution.x) * m_FroxelResolution.y * m_FroxelResolution.z);
+	for (UINT z = 0; z < m_FroxelResolution.z; z++)
+	{
+		const XMVECTOR clip = XMVector4Transform(XMVectorSet(0.0f, 0.0f, m_FroxelSliceDepths.at(z), 1.0f), projection);
+		const float ndcZ = XMVectorGetZ(clip) / XMVectorGetW(clip);
+
+		for (UINT y = 0; y < m_FroxelResolution.y; y++)
+		{
+			for (UINT x = 0; x < m_FroxelResolution.x; x++)
+			{
+				const float ndcX = 2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(m_FroxelResolution.x) - 1.0f;
+				const float ndcY = 1.0f - 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(m_FroxelResolution.y);
+
+				XMStoreFloat3(&samples.at((static_cast<size_t>(z) * m_FroxelResolution.y + y) * m_FroxelResolution.x + x),
+					XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, ndcZ, 1.0f), invProjection));
+			}
+		}
+	}
+
+	// Whether each volume covers any sample of each tile
+	const UINT tileCount = GetTileCount();
+	std::vector<bool> overlaps(static_cast<size_t>(tileCount) * GetVolumeCount(), false);
+
+	for (UINT volume = 0; volume < GetVolumeCount(); volume++)
+	{
+		const XMMATRIX viewToLocal = XMLoadFloat4x4(&m_ViewToLocal.at(volume));
+		const bool isBox = FogVolume::IsBoxShape(m_Shapes.at(volume));
+
+		for (UINT z = 0; z < m_FroxelResolution.z; z++)
+		{
+			for (UINT y = 0; y < m_FroxelResolution.y; y++)
+			{
+				for (UINT x = 0; x < m_FroxelResolution.x; x++)
+				{
+					const XMFLOAT3& sample = samples.at((static_cast<size_t>(z) * m_FroxelResolution.y + y) * m_FroxelResolution.x + x);
+
+					XMFLOAT3 p;
+					XMStoreFloat3(&p, XMVector3Transform(XMLoadFloat3(&sample), viewToLocal));
+
+					// The density is only non-zero strictly inside the volume
+					const float distance = isBox ? max(max(fabsf(p.x), fabsf(p.y)), fabsf(p.z)) : sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+					if (distance >= 1.0f)
+						continue;
+
+					const UINT tile = ((z / s_TileSize) * m_TileGridDimensions.y + y / s_TileSize) * m_TileGridDimensions.x + x / s_TileSize;
+					overlaps.at(static_cast<size_t>(tile) * GetVolumeCount() + volume) = true;
+				}
+			}
+		}
+	}
+
+	tileVolumeRanges.resize(tileCount);
+	volumeIndices.clear();
+
+	for (UINT tile = 0; tile < tileCount; tile++)
+	{
+		const UINT first = static_cast<UINT>(volumeIndices.size());
+		for (UINT volume = 0; volume < GetVolumeCount(); volume++)
+		{
+			if (overlaps.at(static_cast<size_t>(tile) * GetVolumeCount() + volume))
+				volumeIndices.push_back(volume);
+		}
+		tileVolumeRanges.at(tile) = { first, static_cast<UINT>(volumeIndices.size()) - first };
+	}
+}
+
+void FogVolumeBinner::TruncateTileVolumeRanges(UINT maxIndexCount, XMUINT2* ranges) const
+{
+	for (size_t tile = 0; tile < m_TileVolumeRanges.size(); tile++)
+	{
+		const XMUINT2& range = m_TileVolumeRanges.at(tile);
+		const UINT available = range.x < maxIndexCount ? maxIndexCount - range.x : 0;
+		ranges[tile] = { range.x, min(range.y, available) };
+	}
+}
+
+
+void FogVolumeBinner::BinSlice(UINT slice)
+{
+	const UINT tilesX = m_TileGridDimensions.x;
+	const UINT tilesY = m_TileGridDimensions.y;
+
+	SliceBins& bins = m_SliceBins.at(slice);
+	bins.TileVolumeRanges.resize(tilesX * tilesY);
+	bins.VolumeIndices.clear();
+
+	bins.SliceVolumes.Clear();
+	ForEachIntersectingVolume(m_Volumes, m_SliceBounds.at(slice), [&](size_t i) { bins.SliceVolumes.Push(m_Volumes, i); });
+
+	for (UINT y = 0; y < tilesY; y++)
+	{
+		bins.RowVolumes.Clear();
+		ForEachIntersectingVolume(bins.SliceVolumes, m_RowBounds.at(slice * tilesY + y), [&](size_t i) { bins.RowVolumes.Push(bins.SliceVolumes, i); });
+
+		for (UINT x = 0; x < tilesX; x++)
+		{
+			const UINT first = static_cast<UINT>(bins.VolumeIndices.size());
+
+			const Bounds& tileBounds = m_TileBounds.at((slice * tilesY + y) * tilesX + x);
+			ForEachIntersectingVolume(bins.RowVolumes, tileBounds, [&](size_t i) { bins.VolumeIndices.push_back(bins.RowVolumes.Index[i]); });
+
+			bins.TileVolumeRanges.at(y * tilesX + x) = { first, static_cast<UINT>(bins.VolumeIndices.size()) - first };
+		}
+	}
+}
+
+
+template <typename Func>
+void FogVolumeBinner::ForEachIntersectingVolume(const VolumeBounds& volumes, const Bounds& bounds, Func&& func)
+{
+	const __m128 minX = _mm_set1_ps(bounds.Min.x);
+	const __m128 minY = _mm_set1_ps(bounds.Min.y);
+	const __m128 minZ = _mm_set1_ps(bounds.Min.z);
+	const __m128 maxX = _mm_set1_ps(bounds.Max.x);
+	const __m128 maxY = _mm_set1_ps(bounds.Max.y);
+	const __m128 maxZ = _mm_set1_ps(bounds.Max.z);
+	const __m128 zero = _mm_setzero_ps();
+
+	const size_t count = volumes.Index.size();
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&volumes.CenterX[i]);
+		const __m128 y = _mm_loadu_ps(&volumes.CenterY[i]);
+		const __m128 z = _mm_loadu_ps(&volumes.CenterZ[i]);
+		const __m128 extentX = _mm_loadu_ps(&volumes.ExtentX[i]);
+		const __m128 extentY = _mm_loadu_ps(&volumes.ExtentY[i]);
+		const __m128 extentZ = _mm_loadu_ps(&volumes.ExtentZ[i]);
+		const __m128 radius = _mm_loadu_ps(&volumes.Radius[i]);
+
+		// Same operations, in the same order, as Intersects
+		const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+		const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+		const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+		const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		const __m128 boxesOverlap = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(dx, extentX), _mm_cmple_ps(dy, extentY)), _mm_cmple_ps(dz, extentZ));
+		const __m128 sphereOverlaps = _mm_cmple_ps(distanceSq, _mm_mul_ps(radius, radius));
+
+		int mask = _mm_movemask_ps(_mm_and_ps(boxesOverlap, sphereOverlaps));
+		while (mask)
+		{
+			const int lane = std::countr_zero(static_cast<unsigned>(mask));
+			func(i + lane);
+			mask &= mask - 1;
+		}
+	}
+
+	// Remaining volumes that do not fill a SIMD register
+	for (; i < count; i++)
+	{
+		if (Intersects(volumes, i, bounds))
+			func(i);
+	}
+}
+
+bool FogVolumeBinner::Intersects(const VolumeBounds& volumes, size_t i, const Bounds& bounds)
+{
+	// Distance from the volume centre to the box along each axis, which is 0 if the centre is within the box on that axis
+	const float dx = max(max(bounds.Min.x - volumes.CenterX[i], volumes.CenterX[i] - bounds.Max.x), 0.0f);
+	const float dy = max(max(bounds.Min.y - volumes.CenterY[i], volumes.CenterY[i] - bounds.Max.y), 0.0f);
+	const float dz = max(max(bounds.Min.z - volumes.CenterZ[i], volumes.CenterZ[i] - bounds.Max.z), 0.0f);
+	const float distanceSq = (dx * dx + dy * dy) + dz * dz;
+
+	// The volume's box overlaps when it reaches the box along every axis, and its bounding sphere when it is close enough
+	const bool boxesOverlap = dx <= volumes.ExtentX[i] && dy <= volumes.ExtentY[i] && dz <= volumes.ExtentZ[i];
+	return boxesOverlap && distanceSq <= volumes.Radius[i] * volumes.Radius[i];
+}
+
+FogVolumeBinner::Bounds FogVolumeBinner::Union(const Bounds& a, const Bounds& b)
+{
+	return {
+		{ min(a.Min.x, b.Min.x), min(a.Min.y, b.Min.y), min(a.Min.z, b.Min.z) },
+		{ max(a.Max.x, b.Max.x), max(a.Max.y, b.Max.y), max(a.Max.z, b.Max.z) }
+	};
+}
+
+
+void FogVolumeBinner::VolumeBounds::Clear()
+{
+	CenterX.clear();
+	CenterY.clear();
+	CenterZ.clear();
+	ExtentX.clear();
+	ExtentY.clear();
+	ExtentZ.clear();
+	Radius.clear();
+	Index.clear();
+}
+
+void FogVolumeBinner::VolumeBounds::Push(const VolumeBounds& other, size_t i)
+{
+	CenterX.push_back(other.CenterX[i]);
+	CenterY.push_back(other.CenterY[i]);
+	CenterZ.push_back(other.CenterZ[i]);
+	ExtentX.push_back(other.ExtentX[i]);
+	ExtentY.push_back(other.ExtentY[i]);
+	ExtentZ.push_back(other.ExtentZ[i]);
+	Radius.push_back(other.Radius[i]);
+	Index.push_back(other.Index[i]);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+
+class ThreadPool;
+
+using namespace DirectX;
+
+
+// A local fog volume as it is edited, before it is converted to its GPU form
+struct FogVolume
+{
+	UINT Shape = FOG_VOLUME_SHAPE_BOX;	// FOG_VOLUME_SHAPE_*
+
+	XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+	XMFLOAT3 Rotation = { 0.0f, 0.0f, 0.0f };	// Pitch, yaw and roll in radians
+	// Half-size of a box or radii of an ellipsoid. Spheres only use x
+	XMFLOAT3 Extents = { 1.0f, 1.0f, 1.0f };
+
+	XMFLOAT3 Albedo = { 1.0f, 1.0f, 1.0f };
+	float Extinction = 0.1f;
+
+	XMFLOAT3 Emission = { 0.0f, 0.0f, 0.0f };
+	float Anisotropy = 0.0f;
+
+	float Falloff = 0.25f;
+
+	// Baked and sparse volumes only: the volume's region of its atlas, see FogVolumeGPUData
+	XMFLOAT3 AtlasOffset = { 0.0f, 0.0f, 0.0f };
+	XMFLOAT3 AtlasScale = { 0.0f, 0.0f, 0.0f };
+
+	// Maps the unit cube or sphere onto the volume
+	XMMATRIX GetLocalToWorld() const;
+	FogVolumeGPUData GetGPUData() const;
+
+	// Baked and sparse volumes fill the box of their grid, so they are bounded as boxes
+	static inline bool IsBoxShape(UINT shape) { return shape == FOG_VOLUME_SHAPE_BOX || shape == FOG_VOLUME_SHAPE_BAKED || shape == FOG_VOLUME_SHAPE_SPARSE; }
+};
+
+
+/**
+ *	A FogVolumeBinner culls local fog volumes against the froxel volume and bins them into tiles of
+ *	s_TileSize * s_TileSize * s_TileSize froxels, so that density estimation only evaluates the volumes
+ *	that can overlap the froxels of its thread group.
+ *
+ *	Each tile is bounded by a view-space AABB, built the same way as the clusters of ClusteredLightCuller.
+ *	Each volume is bounded by a view-space AABB and a sphere around its centre, and a volume is binned into a
+ *	tile when both intersect the tile's box. The bounds enclose the volume, so the lists are conservative:
+ *	they contain every volume that covers one of the tile's density samples, and possibly a few that do not.
+ *
+ *	Volumes outside the view frustum, clipped to the depth range of the froxel volume, are dropped before binning.
+ *	Binning is then hierarchical, as in ClusteredLightCuller: each slice of tiles is handled by one thread,
+ *	which filters the volumes against the slice, then each row of tiles, then each tile, 4 volumes at a time with SSE.
+ *
+ *	The binner has no knowledge of D3D; volumes are identified by their index.
+ */
+class FogVolumeBinner
+{
+public:
+	// Froxels along each axis of a tile, matching the thread groups of density estimation
+	inline static constexpr UINT s_TileSize = 8;
+	// Limit on the combined length of the per-tile volume lists given to density estimation each frame
+	inline static constexpr UINT s_MaxVolumeIndices = 256 * 1024;
+
+	// View-space box
+	struct Bounds
+	{
+		XMFLOAT3 Min;
+		XMFLOAT3 Max;
+	};
+
+public:
+	FogVolumeBinner() = default;
+	~FogVolumeBinner() = default;
+
+	DEFAULT_COPY(FogVolumeBinner)
+	DEFAULT_MOVE(FogVolumeBinner)
+
+	// Rebuilds the view-space bounds of every tile, if any of the inputs have changed
+	// Every dimension of froxelResolution must be a multiple of s_TileSize
+	// froxelSliceDepths holds the froxelResolution.z + 1 increasing view-space depths of the froxel slices,
+	// where the density of slice z is sampled at depth froxelSliceDepths[z]
+	void SetFroxelGrid(const XMUINT3& froxelResolution, const float* froxelSliceDepths, const XMMATRIX& projection);
+
+	// Transforms the volumes into view space, and culls those outside of the froxel volume
+	void SetVolumes(const FogVolume* volumes, UINT volumeCount, const XMMATRIX& view);
+
+	// Builds the list of volumes that may overlap each tile, with the slices of tiles split across the threads of the pool
+	void BinVolumes(ThreadPool& threadPool);
+	// Reference for BinVolumes, that lists the volumes containing at least one of each tile's density samples
+	// Tests the sample of every froxel against every volume, culled or not, so it is only practical at low resolutions
+	void BinVolumesReference(std::vector<XMUINT2>& tileVolumeRanges, std::vector<UINT>& volumeIndices) const;
+
+	// Writes the tile ranges with the lists that run past the first maxIndexCount volume indices cut short,
+	// so that they only reference indices that fit within the limit
+	void TruncateTileVolumeRanges(UINT maxIndexCount, XMUINT2* ranges) const;
+
+	// (first index into the volume index list, volume count) for each tile
+	// Tiles are ordered by x, then y, then z
+	inline const std::vector<XMUINT2>& GetTileVolumeRanges() const { return m_TileVolumeRanges; }
+	// Volume indices are in increasing order within each tile
+	inline const std::vector<UINT>& GetVolumeIndices() const { return m_VolumeIndices; }
+
+	inline const XMUINT3& GetTileGridDimensions() const { return m_TileGridDimensions; }
+	inline UINT GetTileCount() const { return m_TileGridDimensions.x * m_TileGridDimensions.y * m_TileGridDimensions.z; }
+	// Bounds of the density samples of each tile, in the same order as the tile ranges
+	inline const std::vector<Bounds>& GetTileBounds() const { return m_TileBounds; }
+	inline UINT GetVolumeCount() const { return static_cast<UINT>(m_Shapes.size()); }
+	inline UINT GetVisibleVolumeCount() const { return static_cast<UINT>(m_Volumes.Index.size()); }
+
+private:
+	// View-space bounds of the volumes in structure-of-arrays form
+	struct VolumeBounds
+	{
+		std::vector<float> CenterX;
+		std::vector<float> CenterY;
+		std::vector<float> CenterZ;
+		std::vector<float> ExtentX;
+		std::vector<float> ExtentY;
+		std::vector<float> ExtentZ;
+		std::vector<float> Radius;
+		std::vector<UINT> Index;
+
+		void Clear();
+		void Push(const VolumeBounds& other, size_t i);
+	};
+
+	// Scratch space for binning a single slice, only touched by the thread binning that slice
+	struct SliceBins
+	{
+		VolumeBounds SliceVolumes;
+		VolumeBounds RowVolumes;
+
+		// Per-tile ranges relative to the start of this slice's indices
+		std::vector<XMUINT2> TileVolumeRanges;
+		std::vector<UINT> VolumeIndices;
+
+		UINT FirstIndex = 0;
+	};
+
+	void BinSlice(UINT slice);
+
+	// Calls func with the position of every volume in the set whose bounds intersect the box
+	template <typename Func>
+	static void ForEachIntersectingVolume(const VolumeBounds& volumes, const Bounds& bounds, Func&& func);
+	static bool Intersects(const VolumeBounds& volumes, size_t i, const Bounds& bounds);
+
+	static Bounds Union(const Bounds& a, const Bounds& b);
+
+private:
+	XMUINT3 m_FroxelResolution = { 0, 0, 0 };
+	XMUINT3 m_TileGridDimensions = { 0, 0, 0 };
+	std::vector<float> m_FroxelSliceDepths;
+	XMFLOAT4X4 m_Projection = {};
+
+	// Bounds of each tile, of each row of tiles within a slice, and of each slice
+	std::vector<Bounds> m_TileBounds;
+	std::vector<Bounds> m_RowBounds;
+	std::vector<Bounds> m_SliceBounds;
+
+	// Every volume, for the reference
+	std::vector<XMFLOAT4X4> m_ViewToLocal;
+	std::vector<UINT> m_Shapes;
+
+	// Volumes that survived culling
+	VolumeBounds m_Volumes;
+
+	std::vector<SliceBins> m_SliceBins;
+
+	std::vector<XMUINT2> m_TileVolumeRanges;
+	std::vector<UINT> m_VolumeIndices;
+};
@@ -0,0 +1,720 @@
+#include "pch.h"
+#include "FogVoxelizer.h"
+
+#include "Framework/ThreadPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <immintrin.h>
+
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	inline double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	inline int FloorToInt(float value)
+	{
+		return static_cast<int>(floorf(value));
+	}
+
+	inline UINT ClampToGrid(int value, UINT size)
+	{
+		return static_cast<UINT>(min(max(value, 0), static_cast<int>(size) - 1));
+	}
+
+
+	// Where a ray along x crosses a triangle, and whether the triangle faces along the ray or against it
+	struct Crossing
+	{
+		float X;
+		int Direction;
+	};
+
+	// Twice the signed area of (a, b, p) projected onto the yz plane, positive when p is to the left of a -> b
+	// Evaluated in double, where the differences and products of the float coordinates are exact
+	inline double EdgeFunction(const XMFLOAT3& a, const XMFLOAT3& b, double py, double pz)
+	{
+		return (static_cast<double>(b.y) - a.y) * (pz - a.z) - (static_cast<double>(b.z) - a.z) * (py - a.y);
+	}
+
+	// A ray through an edge belongs to the triangle on the side this rule picks, as in rasterization
+	// Any rule works as long as it picks exactly one direction of each edge
+	inline bool OwnsEdge(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return b.z < a.z || (b.z == a.z && b.y > a.y);
+	}
+
+	inline bool IsInsideEdge(double w, const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return w > 0.0 || (w == 0.0 && OwnsEdge(a, b));
+	}
+
+
+	// HLSL sign() of each lane: -1, 0 or 1
+	inline __m128 Sign4(__m128 x)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 zero = _mm_setzero_ps();
+		return _mm_sub_ps(_mm_and_ps(_mm_cmpgt_ps(x, zero), one), _mm_and_ps(_mm_cmplt_ps(x, zero), one));
+	}
+
+	inline __m128 Saturate4(__m128 x)
+	{
+		return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+
+	// Squared distance from each lane's point to the segment from the origin to e, where p is the point relative to the segment's start
+	inline __m128 SegmentDistanceSq4(const XMFLOAT3& e, float invLengthSq, __m128 px, __m128 py, __m128 pz)
+	{
+		const __m128 ex = _mm_set1_ps(e.x);
+		const __m128 ey = _mm_set1_ps(e.y);
+		const __m128 ez = _mm_set1_ps(e.z);
+
+		const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, px), _mm_mul_ps(ey, py)), _mm_mul_ps(ez, pz));
+		const __m128 t = Saturate4(_mm_mul_ps(dot, _mm_set1_ps(invLengthSq)));
+
+		const __m128 dx = _mm_sub_ps(_mm_mul_ps(ex, t), px);
+		const __m128 dy = _mm_sub_ps(_mm_mul_ps(ey, t), py);
+		const __m128 dz = _mm_sub_ps(_mm_mul_ps(ez, t), pz);
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+	}
+
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	inline XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline float InverseOrZero(float value) { return value > 0.0f ? 1.0f / value : 0.0f; }
+}
+
+
+void FogVoxelizer::Grid::GetDensity(float falloffDistance, std::vector<UINT8>& density) const
+{
+	density.resize(Values.size());
+
+	const float invFalloff = 1.0f / max(falloffDistance, 1e-4f);
+	for (size_t i = 0; i < Values.size(); i++)
+	{
+		float value = Values[i];
+		if (Mode == Mode_SignedDistance)
+		{
+			const float t = min(max(-value * invFalloff, 0.0f), 1.0f);
+			value = t * t * (3.0f - 2.0f * t);
+		}
+
+		density[i] = static_cast<UINT8>(min(max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+
+FogVoxelizer::FogVoxelizer(ThreadPool& threadPool)
+	: m_ThreadPool(&threadPool)
+{
+}
+
+
+void FogVoxelizer::Voxelize(const VertexType* vertices, UINT vertexCount, const IndexType* indices, UINT indexCount,
+	const XMMATRIX& transform, const Settings& settings, Grid& grid)
+{
+	const auto start = Clock::now();
+
+	m_Statistics = {};
+	Prepare(vertices, vertexCount, indices, indexCount, transform, settings, grid);
+
+	auto startPass = Clock::now();
+	if (settings.Mode == Mode_Solid)
+	{
+		VoxelizeSurface(grid, true, *m_ThreadPool);
+		m_Statistics.SurfaceMilliseconds = MillisecondsSince(startPass);
+	}
+
+	startPass = Clock::now();
+	FillInside(grid, settings.FillRule, *m_ThreadPool);
+	m_Statistics.FillMilliseconds = MillisecondsSince(startPass);
+
+	if (settings.Mode == Mode_SignedDistance)
+	{
+		startPass = Clock::now();
+		ComputeDistances(grid, settings.Band, *m_ThreadPool);
+		m_Statistics.DistanceMilliseconds = MillisecondsSince(startPass);
+	}
+
+	// Gather the passes into the grid
+	const XMUINT3 dimensions = grid.Dimensions;
+	const float band = settings.Band * grid.VoxelSize;
+
+	grid.Values.resize(grid.GetVoxelCount());
+	m_ThreadPool->ParallelFor(dimensions.z, 1, [&](UINT begin, UINT end)
+		{
+			for (UINT z = begin; z < end; z++)
+			{
+				for (UINT y = 0; y < dimensions.y; y++)
+				{
+					const size_t row = (static_cast<size_t>(z) * dimensions.y + y) * m_RowStride;
+					for (UINT x = 0; x < dimensions.x; x++)
+					{
+						const bool inside = m_Inside[row + x] != 0;
+
+						float value;
+						if (settings.Mode == Mode_Solid)
+						{
+							value = inside || m_Surface[row + x] ? 1.0f : 0.0f;
+						}
+						else
+						{
+							const float distance = min(sqrtf(m_DistanceSq[row + x]) * grid.VoxelSize, band);
+							value = inside ? -distance : distance;
+						}
+
+						grid.At(x, y, z) = value;
+					}
+				}
+			}
+		});
+
+	m_Statistics.TotalMilliseconds = MillisecondsSince(start);
+}
+
+
+FogVoxelizer::BenchmarkResult FogVoxelizer::Benchmark(const MeshData& mesh, const XMMATRIX& transform, const Settings& settings, UINT iterations)
+{
+	ASSERT(iterations > 0, "No iterations to benchmark");
+
+	const Statistics statistics = m_Statistics;
+
+	BenchmarkResult result;
+	result.Triangles = static_cast<UINT>(mesh.Indices.size() / 3);
+	result.ThreadCount = m_ThreadPool->GetThreadCount();
+
+	Grid grid;
+	auto TimeIterations = [&](auto&& func)
+		{
+			const auto start = Clock::now();
+			for (UINT i = 0; i < iterations; i++)
+			{
+				func();
+			}
+			return max(MillisecondsSince(start), 1e-3);
+		};
+
+	// A pool without workers runs every slice on the calling thread
+	ThreadPool singleThread(0);
+	ThreadPool* threadPool = m_ThreadPool;
+
+	const double threadedMilliseconds = TimeIterations([&]() { Voxelize(mesh, transform, settings, grid); });
+	m_ThreadPool = &singleThread;
+	const double singleThreadMilliseconds = TimeIterations([&]() { Voxelize(mesh, transform, settings, grid); });
+	m_ThreadPool = threadPool;
+
+	result.Voxels = grid.GetVoxelCount();
+	const double triangleVoxels = static_cast<double>(result.Triangles) * static_cast<double>(result.Voxels) * iterations;
+	result.TriangleVoxelsPerSecond = triangleVoxels * 1000.0 / threadedMilliseconds;
+	result.SingleThreadTriangleVoxelsPerSecond = triangleVoxels * 1000.0 / singleThreadMilliseconds;
+
+	// The surface pass alone, on a solid grid
+	Settings solid = settings;
+	solid.Mode = Mode_Solid;
+	Prepare(mesh.Vertices.data(), static_cast<UINT>(mesh.Vertices.size()), mesh.Indices.data(), static_cast<UINT>(mesh.Indices.size()), transform, solid, grid);
+
+	auto OverlapTestsPerSecond = [&](bool useSSE)
+		{
+			UINT64 tests = 0;
+			const double milliseconds = TimeIterations([&]()
+				{
+					m_Statistics.OverlapTests = 0;
+					VoxelizeSurface(grid, useSSE, singleThread);
+					tests += m_Statistics.OverlapTests;
+				});
+			return static_cast<double>(tests) * 1000.0 / milliseconds;
+		};
+
+	result.OverlapTestsPerSecond = OverlapTestsPerSecond(true);
+	result.ScalarOverlapTestsPerSecond = OverlapTestsPerSecond(false);
+
+	m_Statistics = statistics;
+	return result;
+}
+
+std::string FogVoxelizer::BenchmarkResult::Format() const
+{
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer),
+		"%u triangles, %llu voxels, %u threads\n"
+		"  Threaded       %8.2f G triangle-voxels/s\n"
+		"  Single         %8.2f G triangle-voxels/s\n"
+		"  Overlap SSE2   %8.2f M tests/s\n"
+		"  Overlap scalar %8.2f M tests/s",
+		Triangles, static_cast<unsigned long long>(Voxels), ThreadCount,
+		TriangleVoxelsPerSecond * 1.0e-9,
+		SingleThreadTriangleVoxelsPerSecond * 1.0e-9,
+		OverlapTestsPerSecond * 1.0e-6,
+		ScalarOverlapTestsPerSecond * 1.0e-6);
+
+	return buffer;
+}
+
+
+bool FogVoxelizer::TriangleBoxOverlap(const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2, const XMFLOAT3& boxCenter, const XMFLOAT3& boxHalfSize)
+{
+	// Move the box to the origin
+	const XMFLOAT3 v[3] = { Subtract(v0, boxCenter), Subtract(v1, boxCenter), Subtract(v2, boxCenter) };
+	const XMFLOAT3 e[3] = { Subtract(v[1], v[0]), Subtract(v[2], v[1]), Subtract(v[0], v[2]) };
+
+	// Separated along an axis when the projections of the triangle and the box do not overlap
+	// Touching counts as overlapping
+	auto IsSeparatingAxis = [&](const XMFLOAT3& axis)
+		{
+			const float p0 = Dot(axis, v[0]);
+			const float p1 = Dot(axis, v[1]);
+			const float p2 = Dot(axis, v[2]);
+			const float r = boxHalfSize.x * fabsf(axis.x) + boxHalfSize.y * fabsf(axis.y) + boxHalfSize.z * fabsf(axis.z);
+			return min(min(p0, p1), p2) > r || max(max(p0, p1), p2) < -r;
+		};
+
+	// The box normals, where the projection of the box is its half size
+	if (IsSeparatingAxis({ 1.0f, 0.0f, 0.0f }) || IsSeparatingAxis({ 0.0f, 1.0f, 0.0f }) || IsSeparatingAxis({ 0.0f, 0.0f, 1.0f }))
+		return false;
+
+	// The plane of the triangle
+	if (IsSeparatingAxis(Cross(e[0], e[1])))
+		return false;
+
+	// The cross products of the box normals and the edges
+	const XMFLOAT3 boxAxes[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+	for (const XMFLOAT3& boxAxis : boxAxes)
+	{
+		for (const XMFLOAT3& edge : e)
+		{
+			if (IsSeparatingAxis(Cross(boxAxis, edge)))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+void FogVoxelizer::Prepare(const VertexType* vertices, UINT vertexCount, const IndexType* indices, UINT indexCount,
+	const XMMATRIX& transform, const Settings& settings, Grid& grid)
+{
+	ASSERT(vertexCount > 0 && indexCount % 3 == 0, "Invalid triangle list");
+	ASSERT(settings.Resolution > 2 * settings.Padding, "The grid has no room for the mesh");
+
+	// Every triangle sharing a vertex has to see the same position, or rays could slip between them
+	std::vector<XMFLOAT3> positions(vertexCount);
+	XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+	XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+	for (UINT i = 0; i < vertexCount; i++)
+	{
+		const XMVECTOR position = XMVector3TransformCoord(XMLoadFloat3(&vertices[i].Position), transform);
+		XMStoreFloat3(&positions[i], position);
+		boundsMin = XMVectorMin(boundsMin, position);
+		boundsMax = XMVectorMax(boundsMax, position);
+	}
+
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, XMVectorSubtract(boundsMax, boundsMin));
+	const float longestExtent = max(max(extent.x, extent.y), extent.z);
+	ASSERT(longestExtent > 0.0f, "The mesh has no extent");
+
+	// The longest axis spans the resolution, and the other axes are fitted with voxels of the same size
+	const UINT interior = settings.Resolution - 2 * settings.Padding;
+	grid.VoxelSize = longestExtent / static_cast<float>(interior);
+
+	auto GetAxisVoxels = [&](float axisExtent)
+		{
+			const UINT voxels = static_cast<UINT>(ceilf(axisExtent / grid.VoxelSize));
+			return min(max(voxels, 1u), interior) + 2 * settings.Padding;
+		};
+	grid.Mode = settings.Mode;
+	grid.Dimensions = { GetAxisVoxels(extent.x), GetAxisVoxels(extent.y), GetAxisVoxels(extent.z) };
+
+	// Centred on the mesh
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f));
+	grid.Min = {
+		center.x - 0.5f * grid.VoxelSize * static_cast<float>(grid.Dimensions.x),
+		center.y - 0.5f * grid.VoxelSize * static_cast<float>(grid.Dimensions.y),
+		center.z - 0.5f * grid.VoxelSize * static_cast<float>(grid.Dimensions.z)
+	};
+
+	const float invVoxelSize = 1.0f / grid.VoxelSize;
+	for (XMFLOAT3& position : positions)
+	{
+		position = {
+			(position.x - grid.Min.x) * invVoxelSize,
+			(position.y - grid.Min.y) * invVoxelSize,
+			(position.z - grid.Min.z) * invVoxelSize
+		};
+	}
+
+	const UINT triangleCount = indexCount / 3;
+	m_Statistics.Triangles = triangleCount;
+	m_Triangles.resize(triangleCount);
+
+	const float tolerance = 1e-5f * static_cast<float>(max(max(grid.Dimensions.x, grid.Dimensions.y), grid.Dimensions.z));
+	m_ThreadPool->ParallelFor(triangleCount, 256, [&](UINT begin, UINT end)
+		{
+			for (UINT i = begin; i < end; i++)
+			{
+				PreparedTriangle& triangle = m_Triangles[i];
+				for (UINT corner = 0; corner < 3; corner++)
+				{
+					const UINT index = indices[i * 3 + corner];
+					ASSERT(index < vertexCount, "Index out of range");
+					triangle.V[corner] = positions[index];
+				}
+
+				const XMFLOAT3* v = triangle.V;
+				// The bounds and the projections onto each axis are widened by their rounding error within the grid,
+				// so that voxels touching the triangle are never dropped
+				triangle.Min = {
+					min(min(v[0].x, v[1].x), v[2].x) - tolerance,
+					min(min(v[0].y, v[1].y), v[2].y) - tolerance,
+					min(min(v[0].z, v[1].z), v[2].z) - tolerance
+				};
+				triangle.Max = {
+					max(max(v[0].x, v[1].x), v[2].x) + tolerance,
+					max(max(v[0].y, v[1].y), v[2].y) + tolerance,
+					max(max(v[0].z, v[1].z), v[2].z) + tolerance
+				};
+
+				// The axes of TriangleBoxOverlap, with the voxel's half size of 0.5 folded into the bounds
+				const XMFLOAT3 e[3] = { Subtract(v[1], v[0]), Subtract(v[2], v[1]), Subtract(v[0], v[2]) };
+				const XMFLOAT3 boxAxes[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+
+				XMFLOAT3 axes[s_SeparatingAxisCount] = { boxAxes[0], boxAxes[1], boxAxes[2], Cross(e[0], e[1]) };
+				UINT axisCount = 4;
+				for (const XMFLOAT3& boxAxis : boxAxes)
+				{
+					for (const XMFLOAT3& edge : e)
+					{
+						axes[axisCount++] = Cross(boxAxis, edge);
+					}
+				}
+
+				for (UINT axis = 0; axis < s_SeparatingAxisCount; axis++)
+				{
+					const XMFLOAT3& a = axes[axis];
+					const float p0 = Dot(a, v[0]);
+					const float p1 = Dot(a, v[1]);
+					const float p2 = Dot(a, v[2]);
+					const float axisLength = fabsf(a.x) + fabsf(a.y) + fabsf(a.z);
+					const float r = 0.5f * axisLength + axisLength * tolerance;
+
+					triangle.AxisX[axis] = a.x;
+					triangle.AxisY[axis] = a.y;
+					triangle.AxisZ[axis] = a.z;
+					triangle.Lo[axis] = min(min(p0, p1), p2) - r;
+					triangle.Hi[axis] = max(max(p0, p1), p2) + r;
+				}
+			}
+		});
+
+	// Bin the triangles into every slice that a pass may visit them for
+	// Distances reach out from the triangles by the band
+	const float reach = settings.Mode == Mode_SignedDistance ? settings.Band : 0.0f;
+
+	m_SliceTriangles.resize(grid.Dimensions.z);
+	for (auto& slice : m_SliceTriangles)
+	{
+		slice.clear();
+	}
+
+	for (UINT i = 0; i < triangleCount; i++)
+	{
+		const PreparedTriangle& triangle = m_Triangles[i];
+		const UINT first = ClampToGrid(FloorToInt(triangle.Min.z - reach), grid.Dimensions.z);
+		const UINT last = ClampToGrid(FloorToInt(triangle.Max.z + reach), grid.Dimensions.z);
+		for (UINT z = first; z <= last; z++)
+		{
+			m_SliceTriangles[z].push_back(i);
+		}
+	}
+
+	m_RowStride = Align(grid.Dimensions.x, 4u);
+	const size_t paddedVoxelCount = static_cast<size_t>(m_RowStride) * grid.Dimensions.y * grid.Dimensions.z;
+	m_Surface.assign(paddedVoxelCount, 0);
+	m_Inside.assign(paddedVoxelCount, 0);
+	m_DistanceSq.resize(settings.Mode == Mode_SignedDistance ? paddedVoxelCount : 0);
+}
+
+
+void FogVoxelizer::VoxelizeSurface(const Grid& grid, bool useSSE, ThreadPool& threadPool)
+{
+	const XMUINT3 dimensions = grid.Dimensions;
+	std::vector<UINT64> sliceTests(dimensions.z, 0);
+	std::vector<UINT64> sliceSurfaceVoxels(dimensions.z, 0);
+
+	threadPool.ParallelFor(dimensions.z, 1, [&](UINT begin, UINT end)
+		{
+			for (UINT z = begin; z < end; z++)
+			{
+				UINT8* slice = &m_Surface[static_cast<size_t>(z) * dimensions.y * m_RowStride];
+				const float cz = static_cast<float>(z) + 0.5f;
+				UINT64 tests = 0;
+
+				for (const UINT index : m_SliceTriangles[z])
+				{
+					const PreparedTriangle& triangle = m_Triangles[index];
+
+					// Voxels outside the triangle's bounds are separated along a box normal
+					if (FloorToInt(triangle.Min.z) > static_cast<int>(z) || FloorToInt(triangle.Max.z) < static_cast<int>(z))
+						continue;
+
+					const UINT y0 = ClampToGrid(FloorToInt(triangle.Min.y), dimensions.y);
+					const UINT y1 = ClampToGrid(FloorToInt(triangle.Max.y), dimensions.y);
+					const UINT x1 = ClampToGrid(FloorToInt(triangle.Max.x), dimensions.x);
+					// Groups of 4 start on a multiple of 4, and may test a few voxels before the bounds that are sure to be separated
+					const UINT x0 = ClampToGrid(FloorToInt(triangle.Min.x), dimensions.x) & ~3u;
+
+					for (UINT y = y0; y <= y1; y++)
+					{
+						UINT8* row = slice + static_cast<size_t>(y) * m_RowStride;
+						const float cy = static_cast<float>(y) + 0.5f;
+
+						if (!useSSE)
+						{
+							for (UINT x = x0; x <= x1; x++, tests++)
+							{
+								if (TriangleBoxOverlap(triangle.V[0], triangle.V[1], triangle.V[2], { static_cast<float>(x) + 0.5f, cy, cz }, { 0.5f, 0.5f, 0.5f }))
+									row[x] = 1;
+							}
+							continue;
+						}
+
+						// The projection of the voxel centre onto each axis is AxisX * cx + rowOffset, which has to be within [Lo, Hi]
+						// Axes without an x component give the same answer for the whole row
+						float rowLo[s_SeparatingAxisCount];
+						float rowHi[s_SeparatingAxisCount];
+						bool separated = false;
+						for (UINT axis = 0; axis < s_SeparatingAxisCount; axis++)
+						{
+							const float rowOffset = triangle.AxisY[axis] * cy + triangle.AxisZ[axis] * cz;
+							rowLo[axis] = triangle.Lo[axis] - rowOffset;
+							rowHi[axis] = triangle.Hi[axis] - rowOffset;
+							separated |= triangle.AxisX[axis] == 0.0f && (rowLo[axis] > 0.0f || rowHi[axis] < 0.0f);
+						}
+						if (separated)
+							continue;
+
+						for (UINT x = x0; x <= x1; x += 4, tests += 4)
+						{
+							const __m128 cx = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+
+							__m128 overlap = _mm_castsi128_ps(_mm_set1_epi32(-1));
+							for (UINT axis = 0; axis < s_SeparatingAxisCount; axis++)
+							{
+								const __m128 d = _mm_mul_ps(_mm_set1_ps(triangle.AxisX[axis]), cx);
+								overlap = _mm_and_ps(overlap, _mm_cmpge_ps(d, _mm_set1_ps(rowLo[axis])));
+								overlap = _mm_and_ps(overlap, _mm_cmple_ps(d, _mm_set1_ps(rowHi[axis])));
+							}
+
+							// Lanes past the end of the row land in its padding
+							UINT mask = static_cast<UINT>(_mm_movemask_ps(overlap));
+							while (mask)
+							{
+								const UINT lane = std::countr_zero(mask);
+								mask &= mask - 1;
+								row[x + lane] = 1;
+							}
+						}
+					}
+				}
+
+				UINT64 surfaceVoxels = 0;
+				for (UINT y = 0; y < dimensions.y; y++)
+				{
+					const UINT8* row = slice + static_cast<size_t>(y) * m_RowStride;
+					for (UINT x = 0; x < dimensions.x; x++)
+					{
+						surfaceVoxels += row[x];
+					}
+				}
+
+				sliceTests[z] = tests;
+				sliceSurfaceVoxels[z] = surfaceVoxels;
+			}
+		});
+
+	for (UINT z = 0; z < dimensions.z; z++)
+	{
+		m_Statistics.OverlapTests += sliceTests[z];
+		m_Statistics.SurfaceVoxels += sliceSurfaceVoxels[z];
+	}
+}
+
+void FogVoxelizer::FillInside(const Grid& grid, UINT fillRule, ThreadPool& threadPool)
+{
+	const XMUINT3 dimensions = grid.Dimensions;
+	std::vector<UINT64> sliceInsideVoxels(dimensions.z, 0);
+
+	threadPool.ParallelFor(dimensions.z, 1, [&](UINT begin, UINT end)
+		{
+			// The crossings of the ray through the centres of each row
+			std::vector<std::vector<Crossing>> rows(dimensions.y);
+
+			for (UINT z = begin; z < end; z++)
+			{
+				for (auto& row : rows)
+				{
+					row.clear();
+				}
+
+				const double pz = static_cast<double>(z) + 0.5;
+				for (const UINT index : m_SliceTriangles[z])
+				{
+					const PreparedTriangle& triangle = m_Triangles[index];
+					if (pz < triangle.Min.z || pz > triangle.Max.z)
+						continue;
+
+					// Wind the triangle anticlockwise in the yz plane, so that the inside of every edge is on its left
+					const double area = EdgeFunction(triangle.V[0], triangle.V[1], triangle.V[2].y, triangle.V[2].z);
+					if (area == 0.0)
+						continue;
+
+					const int direction = area > 0.0 ? 1 : -1;
+					const XMFLOAT3& v0 = triangle.V[0];
+					const XMFLOAT3& v1 = area > 0.0 ? triangle.V[1] : triangle.V[2];
+					const XMFLOAT3& v2 = area > 0.0 ? triangle.V[2] : triangle.V[1];
+
+					// Rows whose centres are within the triangle's bounds
+					const int first = max(static_cast<int>(ceilf(triangle.Min.y - 0.5f)), 0);
+					const int last = min(FloorToInt(triangle.Max.y - 0.5f), static_cast<int>(dimensions.y) - 1);
+					for (int y = first; y <= last; y++)
+					{
+						const double py = static_cast<double>(y) + 0.5;
+						const double w0 = EdgeFunction(v1, v2, py, pz);
+						const double w1 = EdgeFunction(v2, v0, py, pz);
+						const double w2 = EdgeFunction(v0, v1, py, pz);
+						if (!IsInsideEdge(w0, v1, v2) || !IsInsideEdge(w1, v2, v0) || !IsInsideEdge(w2, v0, v1))
+							continue;
+
+						const double x = (w0 * v0.x + w1 * v1.x + w2 * v2.x) / (w0 + w1 + w2);
+						rows[y].push_back({ static_cast<float>(x), direction });
+					}
+				}
+
+				UINT64 insideVoxels = 0;
+				for (UINT y = 0; y < dimensions.y; y++)
+				{
+					auto& crossings = rows[y];
+					std::sort(crossings.begin(), crossings.end(), [](const Crossing& a, const Crossing& b) { return a.X < b.X; });
+
+					UINT8* row = &m_Inside[(static_cast<size_t>(z) * dimensions.y + y) * m_RowStride];
+					size_t next = 0;
+					int count = 0;
+					int winding = 0;
+					for (UINT x = 0; x < dimensions.x; x++)
+					{
+						const float px = static_cast<float>(x) + 0.5f;
+						for (; next < crossings.size() && crossings[next].X < px; next++)
+						{
+							count++;
+							winding += crossings[next].Direction;
+						}
+
+						const bool inside = fillRule == FillRule_Parity ? (count & 1) != 0 : winding != 0;
+						row[x] = inside ? 1 : 0;
+						insideVoxels += inside ? 1 : 0;
+					}
+				}
+
+				sliceInsideVoxels[z] = insideVoxels;
+			}
+		});
+
+	for (UINT z = 0; z < dimensions.z; z++)
+	{
+		m_Statistics.InsideVoxels += sliceInsideVoxels[z];
+	}
+}
+
+void FogVoxelizer::ComputeDistances(const Grid& grid, float band, ThreadPool& threadPool)
+{
+	const XMUINT3 dimensions = grid.Dimensions;
+	std::fill(m_DistanceSq.begin(), m_DistanceSq.end(), band * band);
+
+	threadPool.ParallelFor(dimensions.z, 1, [&](UINT begin, UINT end)
+		{
+			for (UINT z = begin; z < end; z++)
+			{
+				float* slice = &m_DistanceSq[static_cast<size_t>(z) * dimensions.y * m_RowStride];
+				const float cz = static_cast<float>(z) + 0.5f;
+
+				for (const UINT index : m_SliceTriangles[z])
+				{
+					const PreparedTriangle& triangle = m_Triangles[index];
+					const XMFLOAT3& a = triangle.V[0];
+					const XMFLOAT3& b = triangle.V[1];
+					const XMFLOAT3& c = triangle.V[2];
+
+					// The distance to a triangle, after Inigo Quilez: to its plane when the point is over the triangle,
+					// otherwise to the closest of its edges
+					// Degenerate triangles have no normal, so they always take the distance to their edges
+					const XMFLOAT3 ba = Subtract(b, a);
+					const XMFLOAT3 cb = Subtract(c, b);
+					const XMFLOAT3 ac = Subtract(a, c);
+					const XMFLOAT3 normal = Cross(ba, ac);
+					const XMFLOAT3 edgeNormals[3] = { Cross(ba, normal), Cross(cb, normal), Cross(ac, normal) };
+					const float invNormalLengthSq = InverseOrZero(Dot(normal, normal));
+					const float invEdgeLengthSq[3] = { InverseOrZero(Dot(ba, ba)), InverseOrZero(Dot(cb, cb)), InverseOrZero(Dot(ac, ac)) };
+
+					// Voxel centres that may be within the band
+					const UINT y0 = ClampToGrid(static_cast<int>(ceilf(triangle.Min.y - band - 0.5f)), dimensions.y);
+					const UINT y1 = ClampToGrid(FloorToInt(triangle.Max.y + band - 0.5f), dimensions.y);
+					const UINT x0 = ClampToGrid(static_cast<int>(ceilf(triangle.Min.x - band - 0.5f)), dimensions.x) & ~3u;
+					const UINT x1 = ClampToGrid(FloorToInt(triangle.Max.x + band - 0.5f), dimensions.x);
+
+					for (UINT y = y0; y <= y1; y++)
+					{
+						float* row = slice + static_cast<size_t>(y) * m_RowStride;
+						const float cy = static_cast<float>(y) + 0.5f;
+
+						const __m128 pay = _mm_set1_ps(cy - a.y);
+						const __m128 paz = _mm_set1_ps(cz - a.z);
+						const __m128 pby = _mm_set1_ps(cy - b.y);
+						const __m128 pbz = _mm_set1_ps(cz - b.z);
+						const __m128 pcy = _mm_set1_ps(cy - c.y);
+						const __m128 pcz = _mm_set1_ps(cz - c.z);
+
+						for (UINT x = x0; x <= x1; x += 4)
+						{
+							const __m128 cx = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+							const __m128 pax = _mm_sub_ps(cx, _mm_set1_ps(a.x));
+							const __m128 pbx = _mm_sub_ps(cx, _mm_set1_ps(b.x));
+							const __m128 pcx = _mm_sub_ps(cx, _mm_set1_ps(c.x));
+
+							auto Dot4 = [](const XMFLOAT3& v, __m128 x, __m128 y, __m128 z)
+								{
+									return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.x), x), _mm_mul_ps(_mm_set1_ps(v.y), y)), _mm_mul_ps(_mm_set1_ps(v.z), z));
+								};
+
+							const __m128 sides = _mm_add_ps(_mm_add_ps(
+								Sign4(Dot4(edgeNormals[0], pax, pay, paz)),
+								Sign4(Dot4(edgeNormals[1], pbx, pby, pbz))),
+								Sign4(Dot4(edgeNormals[2], pcx, pcy, pcz)));
+
+							const __m128 planeDistance = Dot4(normal, pax, pay, paz);
+							const __m128 planeDistanceSq = _mm_mul_ps(_mm_mul_ps(planeDistance, planeDistance), _mm_set1_ps(invNormalLengthSq));
+
+							const __m128 edgeDistanceSq = _mm_min_ps(_mm_min_ps(
+								SegmentDistanceSq4(ba, invEdgeLengthSq[0], pax, pay, paz),
+								SegmentDistanceSq4(cb, invEdgeLengthSq[1], pbx, pby, pbz)),
+								SegmentDistanceSq4(ac, invEdgeLengthSq[2], pcx, pcy, pcz));
+
+							// Lanes past the end of the row land in its padding
+							const __m128 overTriangle = _mm_cmpge_ps(sides, _mm_set1_ps(2.0f));
+							const __m128 distanceSq = _mm_or_ps(_mm_and_ps(overTriangle, planeDistanceSq), _mm_andnot_ps(overTriangle, edgeDistanceSq));
+							_mm_storeu_ps(row + x, _mm_min_ps(_mm_loadu_ps(row + x), distanceSq));
+						}
+					}
+				}
+			}
+		});
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "Core.h"
+#include "Renderer/Geometry/MeshData.h"
+
+#include <string>
+
+class ThreadPool;
+
+using namespace DirectX;
+
+
+/**
+ *	Voxelizes a closed triangle mesh on the CPU into a grid, for fog that takes the shape of a mesh,
+ *	such as smoke filling a room. FogDensityAtlas packs the grids into the texture that density estimation
+ *	samples baked fog volumes from.
+ *
+ *	The grid holds either solid occupancy, or the signed distance to the mesh so that the fog can fade in from its surface.
+ *	It is axis aligned in the space the mesh is transformed into, and sized to fit the mesh with cubic voxels.
+ *
+ *	Voxelization runs in up to three passes, each with the slices of the grid split across a ThreadPool:
+ *		Surface  - Voxels touching a triangle, from the separating axis test of Akenine-Moller, 4 voxels at a time with SSE2
+ *		Fill     - Voxel centres inside the mesh, from where rays along x cross the triangles,
+ *		           counted with the parity (even-odd) or the winding number rule
+ *		Distance - Signed distance grids only: the distance from each voxel centre to the closest triangle,
+ *		           within a band around the surface, 4 voxels at a time with SSE2
+ *	Crossings are found with edge functions and a consistent rule for rays through an edge or vertex,
+ *	so a ray crosses exactly one of the triangles sharing it, and watertight meshes fill without leaks.
+ *	Degenerate triangles have no area to cross and are left out of the fill.
+ *
+ *	The voxelizer has no knowledge of D3D, so it can be tested and benchmarked on its own.
+ */
+class FogVoxelizer
+{
+public:
+	enum Mode
+	{
+		Mode_Solid = 0,
+		Mode_SignedDistance,
+		ModeCount
+	};
+
+	enum FillRule
+	{
+		FillRule_Parity = 0,	// Inside where a ray crosses the surface an odd number of times
+		FillRule_Winding,		// Inside where the surface winds around the point, which tolerates overlapping parts
+		FillRuleCount
+	};
+
+	struct Settings
+	{
+		UINT Mode = Mode_SignedDistance;
+		UINT FillRule = FillRule_Winding;
+
+		// Voxels along the longest axis of the mesh bounds, including the padding
+		UINT Resolution = 64;
+		// Empty voxels between the mesh bounds and each side of the grid, so that the fog fades out within the grid
+		UINT Padding = 2;
+		// Signed distances are exact up to this many voxels from the surface, and clamped beyond
+		float Band = 4.0f;
+	};
+
+	struct Grid
+	{
+		UINT Mode = Mode_Solid;
+		XMUINT3 Dimensions = { 0, 0, 0 };
+
+		// Minimum corner in the space the mesh was transformed into, and the size of each cubic voxel
+		XMFLOAT3 Min = { 0.0f, 0.0f, 0.0f };
+		float VoxelSize = 0.0f;
+
+		// Stored x first, then y, then z
+		// Solid: 1 for voxels inside or touching the surface, 0 elsewhere
+		// Signed distance: distance from the voxel centre to the surface, negative inside
+		std::vector<float> Values;
+
+		inline float& At(UINT x, UINT y, UINT z) { return Values[(static_cast<size_t>(z) * Dimensions.y + y) * Dimensions.x + x]; }
+		inline float At(UINT x, UINT y, UINT z) const { return Values[(static_cast<size_t>(z) * Dimensions.y + y) * Dimensions.x + x]; }
+
+		inline UINT64 GetVoxelCount() const { return static_cast<UINT64>(Dimensions.x) * Dimensions.y * Dimensions.z; }
+		inline XMFLOAT3 GetMax() const
+		{
+			return {
+				Min.x + VoxelSize * static_cast<float>(Dimensions.x),
+				Min.y + VoxelSize * static_cast<float>(Dimensions.y),
+				Min.z + VoxelSize * static_cast<float>(Dimensions.z)
+			};
+		}
+
+		// Density in [0, 1] as UNORM8, laid out as Values
+		// Signed distances fade in from the surface to falloffDistance inside it, with the smoothstep of the analytic volumes
+		void GetDensity(float falloffDistance, std::vector<UINT8>& density) const;
+	};
+
+	struct Statistics
+	{
+		UINT Triangles = 0;
+		// Triangle-voxel pairs tested by the surface pass
+		UINT64 OverlapTests = 0;
+		UINT64 SurfaceVoxels = 0;
+		UINT64 InsideVoxels = 0;
+
+		double SurfaceMilliseconds = 0.0;
+		double FillMilliseconds = 0.0;
+		double DistanceMilliseconds = 0.0;
+		double TotalMilliseconds = 0.0;
+	};
+
+	struct BenchmarkResult
+	{
+		UINT Triangles = 0;
+		UINT64 Voxels = 0;
+		UINT ThreadCount = 0;
+
+		// Triangles * voxels of the grid per second, for the whole voxelization with the pool and on a single thread
+		double TriangleVoxelsPerSecond = 0.0;
+		double SingleThreadTriangleVoxelsPerSecond = 0.0;
+
+		// Triangle-box tests per second in the surface pass on a single thread, with SSE2 and with the scalar test
+		double OverlapTestsPerSecond = 0.0;
+		double ScalarOverlapTestsPerSecond = 0.0;
+
+		std::string Format() const;
+	};
+
+public:
+	FogVoxelizer(ThreadPool& threadPool);
+	~FogVoxelizer() = default;
+
+	DISALLOW_COPY(FogVoxelizer)
+	DEFAULT_MOVE(FogVoxelizer)
+
+	// Voxelizes the triangle list given by the indices, after transforming the vertices by transform
+	void Voxelize(const VertexType* vertices, UINT vertexCount, const IndexType* indices, UINT indexCount,
+		const XMMATRIX& transform, const Settings& settings, Grid& grid);
+	inline void Voxelize(const MeshData& mesh, const XMMATRIX& transform, const Settings& settings, Grid& grid)
+	{
+		Voxelize(mesh.Vertices.data(), static_cast<UINT>(mesh.Vertices.size()), mesh.Indices.data(), static_cast<UINT>(mesh.Indices.size()),
+			transform, settings, grid);
+	}
+
+	// Voxelizes the mesh iterations times with the pool and on a single thread, and times the surface pass with SSE2 and with the scalar test
+	BenchmarkResult Benchmark(const MeshData& mesh, const XMMATRIX& transform, const Settings& settings, UINT iterations);
+
+	// Whether a triangle touches an axis-aligned box, evaluated without SSE
+	// This is the test that the vectorised surface pass follows
+	static bool TriangleBoxOverlap(const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2, const XMFLOAT3& boxCenter, const XMFLOAT3& boxHalfSize);
+
+	// Statistics of the last Voxelize
+	inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+private:
+	// Separating axes of a triangle and a voxel: the 3 box normals, the triangle normal, and the 9 cross products of their edges
+	inline static constexpr UINT s_SeparatingAxisCount = 13;
+
+	// A triangle in grid space, where voxel (x, y, z) covers [x, x + 1] * [y, y + 1] * [z, z + 1]
+	struct PreparedTriangle
+	{
+		XMFLOAT3 V[3];
+		XMFLOAT3 Min;
+		XMFLOAT3 Max;
+
+		// A voxel touches the triangle when the projection of its centre onto every axis is within [Lo, Hi]
+		float AxisX[s_SeparatingAxisCount];
+		float AxisY[s_SeparatingAxisCount];
+		float AxisZ[s_SeparatingAxisCount];
+		float Lo[s_SeparatingAxisCount];
+		float Hi[s_SeparatingAxisCount];
+	};
+
+	// Fits the grid to the mesh, transforms the triangles into grid space, and bins them into slices of voxels
+	void Prepare(const VertexType* vertices, UINT vertexCount, const IndexType* indices, UINT indexCount,
+		const XMMATRIX& transform, const Settings& settings, Grid& grid);
+
+	void VoxelizeSurface(const Grid& grid, bool useSSE, ThreadPool& threadPool);
+	void FillInside(const Grid& grid, UINT fillRule, ThreadPool& threadPool);
+	void ComputeDistances(const Grid& grid, float band, ThreadPool& threadPool);
+
+private:
+	ThreadPool* m_ThreadPool;
+
+	Statistics m_Statistics;
+
+	std::vector<PreparedTriangle> m_Triangles;
+	// Indices of the triangles within reach of each slice of voxels, for every pass
+	std::vector<std::vector<UINT>> m_SliceTriangles;
+
+	// Rows are padded to a multiple of 4 voxels, so that every pass can work on whole groups of 4
+	UINT m_RowStride = 0;
+	std::vector<UINT8> m_Surface;
+	std::vector<UINT8> m_Inside;
+	// Squared distances in voxels
+	std::vector<float> m_DistanceSq;
+};
@@ -0,0 +1,154 @@
+#include "pch.h"
+#include "FroxelOccupancy.h"
+
+#include "Framework/ThreadPool.h"
+
+#include <bit>
+
+
+void FroxelOccupancy::Classify(const FogVolumeBinner& binner, const GlobalFogConstantBuffer& globalFog, const XMMATRIX& view, ThreadPool& threadPool, float globalFogMargin)
+{
+	Resize(binner.GetTileGridDimensions());
+
+	const auto& tileVolumeRanges = binner.GetTileVolumeRanges();
+	const auto& tileBounds = binner.GetTileBounds();
+	ASSERT(tileVolumeRanges.size() == GetBrickCount() && tileBounds.size() == GetBrickCount(), "The fog volumes have not been binned");
+
+	// The global fog fades out over the smoothing distances, and its height fade starts at y = 0
+	// (see density_estimation_cs), so its density is 0 outside this world-space box
+	const float radius = max(globalFog.Radius, globalFog.Radius + globalFog.RadiusSmoothing);
+	const float height = max(globalFog.MaxHeight, globalFog.MaxHeight + globalFog.HeightSmoothing);
+	const bool hasGlobalFog = globalFog.Extinction > 0.0f && radius > 0.0f && height > 0.0f;
+
+	const XMFLOAT3 fogMin = { -radius - globalFogMargin, -globalFogMargin, -radius - globalFogMargin };
+	const XMFLOAT3 fogMax = { radius + globalFogMargin, height + globalFogMargin, radius + globalFogMargin };
+
+	// The box is tested against each brick in view space and in world space, which both have to overlap
+	// Either test alone would be loose when the view is rotated relative to the box
+	FogVolumeBinner::Bounds fogViewBounds = { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	for (UINT corner = 0; corner < 8; corner++)
+	{
+		const XMVECTOR p_ws = XMVectorSet(
+			corner & 1 ? fogMax.x : fogMin.x,
+			corner & 2 ? fogMax.y : fogMin.y,
+			corner & 4 ? fogMax.z : fogMin.z,
+			1.0f);
+
+		XMFLOAT3 p;
+		XMStoreFloat3(&p, XMVector3TransformCoord(p_ws, view));
+		fogViewBounds.Min = { min(fogViewBounds.Min.x, p.x), min(fogViewBounds.Min.y, p.y), min(fogViewBounds.Min.z, p.z) };
+		fogViewBounds.Max = { max(fogViewBounds.Max.x, p.x), max(fogViewBounds.Max.y, p.y), max(fogViewBounds.Max.z, p.z) };
+	}
+
+	const XMMATRIX invView = XMMatrixInverse(nullptr, view);
+
+	auto Overlaps = [](const XMFLOAT3& minA, const XMFLOAT3& maxA, const XMFLOAT3& minB, const XMFLOAT3& maxB)
+		{
+			return minA.x <= maxB.x && maxA.x >= minB.x
+				&& minA.y <= maxB.y && maxA.y >= minB.y
+				&& minA.z <= maxB.z && maxA.z >= minB.z;
+		};
+
+	auto OverlapsGlobalFog = [&](const FogVolumeBinner::Bounds& bounds)
+		{
+			if (!Overlaps(bounds.Min, bounds.Max, fogViewBounds.Min, fogViewBounds.Max))
+				return false;
+
+			XMFLOAT3 worldMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+			XMFLOAT3 worldMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (UINT corner = 0; corner < 8; corner++)
+			{
+				const XMVECTOR p_vs = XMVectorSet(
+					corner & 1 ? bounds.Max.x : bounds.Min.x,
+					corner & 2 ? bounds.Max.y : bounds.Min.y,
+					corner & 4 ? bounds.Max.z : bounds.Min.z,
+					1.0f);
+
+				XMFLOAT3 p;
+				XMStoreFloat3(&p, XMVector3TransformCoord(p_vs, invView));
+				worldMin = { min(worldMin.x, p.x), min(worldMin.y, p.y), min(worldMin.z, p.z) };
+				worldMax = { max(worldMax.x, p.x), max(worldMax.y, p.y), max(worldMax.z, p.z) };
+			}
+
+			return Overlaps(worldMin, worldMax, fogMin, fogMax);
+		};
+
+	// Each slice of bricks is classified by one thread
+	const UINT bricksPerSlice = m_BrickGridDimensions.x * m_BrickGridDimensions.y;
+	threadPool.ParallelFor(m_BrickGridDimensions.z, 1, [&](UINT begin, UINT end)
+		{
+			for (UINT brick = begin * bricksPerSlice; brick < end * bricksPerSlice; brick++)
+			{
+				const bool active = tileVolumeRanges[brick].y > 0 || (hasGlobalFog && OverlapsGlobalFog(tileBounds[brick]));
+				m_BrickActive[brick] = active ? 1 : 0;
+			}
+		});
+
+	Compact();
+}
+
+void FroxelOccupancy::SetAllActive(const XMUINT3& brickGridDimensions)
+{
+	Resize(brickGridDimensions);
+	m_BrickActive.assign(GetBrickCount(), 1);
+	Compact();
+}
+
+void FroxelOccupancy::GetDeactivatedBricks(const std::vector<UINT>& mask, std::vector<UINT>& bricks) const
+{
+	ASSERT(mask.size() == m_Mask.size(), "The masks are for different grids");
+
+	const UINT brickCount = GetBrickCount();
+	for (UINT word = 0; word < static_cast<UINT>(mask.size()); word++)
+	{
+		UINT bits = mask[word] & ~m_Mask[word];
+		while (bits)
+		{
+			const UINT brick = word * s_BricksPerMaskWord + std::countr_zero(bits);
+			bits &= bits - 1;
+
+			// Masks can have bits set past the last brick
+			if (brick >= brickCount)
+				break;
+
+			const UINT x = brick % m_BrickGridDimensions.x;
+			const UINT y = (brick / m_BrickGridDimensions.x) % m_BrickGridDimensions.y;
+			const UINT z = brick / (m_BrickGridDimensions.x * m_BrickGridDimensions.y);
+			bricks.push_back(Volumetrics::PackBrick(x, y, z));
+		}
+	}
+}
+
+
+void FroxelOccupancy::Resize(const XMUINT3& brickGridDimensions)
+{
+	ASSERT(brickGridDimensions.x <= VOLUME_BRICK_COORD_MASK + 1 &&
+		brickGridDimensions.y <= VOLUME_BRICK_COORD_MASK + 1 &&
+		brickGridDimensions.z <= VOLUME_BRICK_COORD_MASK + 1,
+		"Brick coordinates do not fit in their packed form");
+
+	m_BrickGridDimensions = brickGridDimensions;
+	m_BrickActive.resize(GetBrickCount());
+}
+
+void FroxelOccupancy::Compact()
+{
+	m_ActiveBricks.clear();
+	m_Mask.assign(GetMaskWordCount(GetBrickCount()), 0);
+
+	UINT brick = 0;
+	for (UINT z = 0; z < m_BrickGridDimensions.z; z++)
+	{
+		for (UINT y = 0; y < m_BrickGridDimensions.y; y++)
+		{
+			for (UINT x = 0; x < m_BrickGridDimensions.x; x++, brick++)
+			{
+				if (!m_BrickActive[brick])
+					continue;
+
+				m_ActiveBricks.push_back(Volumetrics::PackBrick(x, y, z));
+				m_Mask[brick / s_BricksPerMaskWord] |= 1u << (brick % s_BricksPerMaskWord);
+			}
+		}
+	}
+}
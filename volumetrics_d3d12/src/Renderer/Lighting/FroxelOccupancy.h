@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+#include "HlslCompat/VolumetricsHlslCompat.h"
+#include "FogVolumeBinner.h"
+
+class ThreadPool;
+
+using namespace DirectX;
+
+
+/**
+ *	FroxelOccupancy splits the froxel volume into bricks of s_BrickSize * s_BrickSize * s_BrickSize froxels,
+ *	and marks the bricks that fog may reach, so that the volumetrics stages can skip the rest of the volume.
+ *
+ *	The bricks are the tiles of a FogVolumeBinner, so a brick is active when the binner has listed a local fog volume for it,
+ *	or when its bounds intersect the box that the global fog is confined to. Both tests are conservative:
+ *	every brick with a non-zero density sample is active, and the density of every inactive brick is exactly 0.
+ *
+ *	The result is a list of the active bricks, packed with PackBrick for the indirect dispatches,
+ *	and a mask with a bit per brick, for the stages that walk the whole volume.
+ *
+ *	The occupancy has no knowledge of D3D, so it is shared by the renderer and VolumetricsReference.
+ */
+class FroxelOccupancy
+{
+public:
+	inline static constexpr UINT s_BrickSize = VOLUME_BRICK_SIZE;
+	static_assert(s_BrickSize == FogVolumeBinner::s_TileSize, "Bricks must match the fog volume tiles");
+
+	// Bricks per word of the mask
+	inline static constexpr UINT s_BricksPerMaskWord = 32;
+
+public:
+	FroxelOccupancy() = default;
+	~FroxelOccupancy() = default;
+
+	DEFAULT_COPY(FroxelOccupancy)
+	DEFAULT_MOVE(FroxelOccupancy)
+
+	// Classifies the bricks of the binner's tile grid, which must have its volumes binned for this frame
+	// view is the view matrix that the binner was given the volumes with
+	// The global fog's box is grown by globalFogMargin, for when its density is filtered from a grid with voxels of that size
+	void Classify(const FogVolumeBinner& binner, const GlobalFogConstantBuffer& globalFog, const XMMATRIX& view, ThreadPool& threadPool, float globalFogMargin = 0.0f);
+	// Marks every brick of a grid as active, to process the whole volume
+	void SetAllActive(const XMUINT3& brickGridDimensions);
+
+	// Appends the bricks that are set in mask but are not active, packed with PackBrick
+	// mask must be laid out as GetMask, for a grid of the same dimensions
+	void GetDeactivatedBricks(const std::vector<UINT>& mask, std::vector<UINT>& bricks) const;
+
+	// Packed bricks, ordered by x, then y, then z
+	inline const std::vector<UINT>& GetActiveBricks() const { return m_ActiveBricks; }
+	// Bit (i % 32) of word (i / 32) is set when brick i is active, where i = (z * height + y) * width + x
+	inline const std::vector<UINT>& GetMask() const { return m_Mask; }
+
+	inline bool IsActive(UINT x, UINT y, UINT z) const
+	{
+		const UINT brick = (z * m_BrickGridDimensions.y + y) * m_BrickGridDimensions.x + x;
+		return (m_Mask[brick / s_BricksPerMaskWord] >> (brick % s_BricksPerMaskWord)) & 1;
+	}
+
+	inline const XMUINT3& GetBrickGridDimensions() const { return m_BrickGridDimensions; }
+	inline UINT GetBrickCount() const { return m_BrickGridDimensions.x * m_BrickGridDimensions.y * m_BrickGridDimensions.z; }
+	inline UINT GetActiveBrickCount() const { return static_cast<UINT>(m_ActiveBricks.size()); }
+	inline float GetActiveFraction() const { return GetBrickCount() > 0 ? static_cast<float>(GetActiveBrickCount()) / static_cast<float>(GetBrickCount()) : 0.0f; }
+
+	static inline UINT GetMaskWordCount(UINT brickCount) { return (brickCount + s_BricksPerMaskWord - 1) / s_BricksPerMaskWord; }
+
+private:
+	void Resize(const XMUINT3& brickGridDimensions);
+	// Builds the brick list and mask from m_BrickActive
+	void Compact();
+
+private:
+	XMUINT3 m_BrickGridDimensions = { 0, 0, 0 };
+
+	// One entry per brick, so that bricks can be classified in parallel without sharing mask words
+	std::vector<UINT8> m_BrickActive;
+
+	std::vector<UINT> m_ActiveBricks;
+	std::vector<UINT> m_Mask;
+};
@@ -0,0 +1,40 @@
+#include "pch.h"
+#include "FroxelSliceTable.h"
+
+
+void FroxelSliceTable::Build(VolumetricsConstantBuffer& volume, float nearPlane, const XMMATRIX& projection)
+{
+	const UINT sliceCount = volume.VolumeResolution.z;
+	ASSERT(sliceCount > 1 && sliceCount <= VOLUME_MAX_SLICES, "Invalid volume depth");
+
+	// The shaders scale NDC xy alone, so the projection cannot be off-centre
+	XMFLOAT4X4 p;
+	XMStoreFloat4x4(&p, projection);
+	ASSERT(p._31 == 0.0f && p._32 == 0.0f, "The froxel grid requires a symmetric projection");
+
+	// A perspective projection maps view-space x to NDC x = x * _11 / depth
+	volume.ViewRayScale = { 1.0f / p._11, 1.0f / p._22 };
+
+	auto SliceDepth = [&](float slice)
+		{
+			return Volumetrics::ZSliceToFroxelDepth(slice, nearPlane, volume.MaxVolumeDistance, sliceCount, volume.DepthDistribution, volume.HybridLinearDepth);
+		};
+
+	// Volume integration starts its march at the front of the volume
+	float previousCentreDepth = SliceDepth(0.0f);
+
+	for (UINT i = 0; i < sliceCount; i++)
+	{
+		FroxelSliceGPUData& slice = volume.Slices[i];
+
+		slice.Depth = SliceDepth(static_cast<float>(i));
+		slice.CentreDepth = SliceDepth(static_cast<float>(i) + 0.5f);
+		slice.FrontDepth = SliceDepth(static_cast<float>(i) - 0.5f);
+
+		slice.IntegrationStep = fabsf(slice.CentreDepth - previousCentreDepth);
+		previousCentreDepth = slice.CentreDepth;
+
+		slice.RayScale = { volume.ViewRayScale.x * slice.Depth, volume.ViewRayScale.y * slice.Depth };
+		slice.CentreRayScale = { volume.ViewRayScale.x * slice.CentreDepth, volume.ViewRayScale.y * slice.CentreDepth };
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+#include "HlslCompat/VolumetricsHlslCompat.h"
+
+using namespace DirectX;
+
+
+/**
+ *	The per-slice tables of the froxel grid, uploaded in VolumetricsConstantBuffer.
+ *
+ *	Every froxel of a slice shares its depth and the scale from NDC to view space, so the volumetrics shaders
+ *	read them from the table and reconstruct view-space positions as (ndc.xy * RayScale, Depth),
+ *	rather than evaluating ZSliceToFroxelDepth and un-projecting with InvProj for each froxel.
+ *
+ *	Jittered light scattering samples lie between FrontDepth and CentreDepth, and are placed linearly between
+ *	those and Depth, which is exact for the linear distribution and within a fraction of a slice for the others.
+ */
+namespace FroxelSliceTable
+{
+	// Fills volume.ViewRayScale and the first volume.VolumeResolution.z entries of volume.Slices
+	// from the depth distribution of the volume, for a symmetric perspective projection
+	void Build(VolumetricsConstantBuffer& volume, float nearPlane, const XMMATRIX& projection);
+}
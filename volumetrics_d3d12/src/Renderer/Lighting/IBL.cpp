@@ -5,9 +5,14 @@
 
 #include "HlslCompat/LightingHlslCompat.h"
 
+#include "Framework/ThreadPool.h"
+
 #include "pix.h"
 #include "DirectXTex/DirectXTex.h"
 
+#include <chrono>
+#include <filesystem>
+
 
 // Pipeline root signatures
 namespace IrradianceMapPipelineSignature
@@ -282,6 +287,13 @@ void IBL::ProcessEnvironmentMap(std::unique_ptr<Texture>&& map)
 
 	g_D3DGraphicsContext->GetDevice()->CreateShaderResourceView(m_EnvironmentMap->GetResource(), &srvDesc, m_GlobalLightingSRVs.GetCPUHandle(EnvironmentMapSRV));
 
+	// Maps loaded from the cache only need to be uploaded
+	if (m_CachedMaps)
+	{
+		UploadCachedMaps();
+		return;
+	}
+
 	GlobalLightingParamsBuffer params;
 	auto SetParamsForFace = [&params](UINT face)
 		{
@@ -472,40 +484,215 @@ void IBL::ProcessEnvironmentMap(std::unique_ptr<Texture>&& map)
 	irradianceMapFaceUAVs.Free();
 	BRDFIntegrationMapUAV.Free();
 	PEMFaceUAVs.Free();
+
+	// Only known once PrepareEnvironmentMap has hashed the map
+	if (!m_CachePath.empty())
+		SaveCache();
 }
 
 
-void IBL::ProjectIrradianceMapToSH()
+void IBL::PrepareEnvironmentMap(const TextureLoader::DecodedImage& image)
+{
+	ASSERT(image.Data, "The environment map has already been uploaded");
+
+	const auto start = std::chrono::steady_clock::now();
+
+	m_CacheDesc = GetCacheDesc(IBLCache::HashSourceImage(image.Data, image.Width, image.Height, image.Channels, image.BytesPerChannel));
+	m_CachePath = IBLCache::GetCachePath(s_CacheDirectory, m_CacheDesc);
+
+	auto cachedMaps = std::make_unique<IBLCache::Contents>();
+	m_LoadedFromCache = IBLCache::Load(m_CachePath, m_CacheDesc, *cachedMaps);
+	if (m_LoadedFromCache)
+	{
+		m_SkyIrradianceSH = cachedMaps->SkySH;
+		m_CachedMaps = std::move(cachedMaps);
+
+		LOG_INFO("IBL: Loaded the derived maps from {} in {:.2f} ms", m_CachePath,
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		return;
+	}
+
+	m_CachedMaps.reset();
+	ProjectEnvironmentMapToSH(image);
+}
+
+void IBL::ProjectEnvironmentMapToSH(const TextureLoader::DecodedImage& image)
+{
+	ASSERT(image.Data, "The environment map has already been uploaded");
+	ASSERT(image.Width == 6 * image.Height, "Invalid cubemap format! It should be laid out as 6 square faces in one row.");
+
+	const size_t texelSize = static_cast<size_t>(image.Channels) * image.BytesPerChannel;
+
+	SHProjector::Cubemap cubemap;
+	cubemap.Data = image.Data;
+	cubemap.FaceSize = image.Height;
+	cubemap.Channels = image.Channels;
+	cubemap.BytesPerChannel = image.BytesPerChannel;
+	cubemap.RowPitch = image.Width * texelSize;
+	cubemap.FacePitch = image.Height * texelSize;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	SHProjector projector(ThreadPool::GetDefault());
+	projector.Project(cubemap, m_SkyIrradianceSH);
+
+	m_SHProjectionMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	LOG_INFO("Projected the environment map to SH in {:.2f} ms", m_SHProjectionMilliseconds);
+}
+
+
+IBLCache::Desc IBL::GetCacheDesc(UINT64 sourceHash) const
+{
+	IBLCache::Desc desc;
+	desc.SourceHash = sourceHash;
+	desc.IrradianceMapResolution = m_IrradianceMapResolution;
+	desc.BRDFIntegrationMapResolution = m_BRDFIntegrationMapResolution;
+	desc.PEMResolution = m_PEMResolution;
+	desc.PEMRoughnessBins = m_PEMRoughnessBins;
+	desc.IrradianceMapFormat = m_IrradianceMap->GetFormat();
+	desc.BRDFIntegrationMapFormat = m_BRDFIntegrationMap->GetFormat();
+	desc.PEMFormat = m_PreFilteredEnvironmentMap->GetFormat();
+	return desc;
+}
+
+void IBL::UploadCachedMaps()
 {
 	const auto device = g_D3DGraphicsContext->GetDevice();
+
+	struct CachedMap
+	{
+		Texture* Map;
+		const std::vector<UINT8>* Texels;
+		UINT Resolution;
+		UINT ArraySize;
+		UINT MipLevels;
+	};
+	const CachedMap cachedMaps[] = {
+		{ m_IrradianceMap.get(), &m_CachedMaps->IrradianceMap, m_IrradianceMapResolution, 6, 1 },
+		{ m_BRDFIntegrationMap.get(), &m_CachedMaps->BRDFIntegrationMap, m_BRDFIntegrationMapResolution, 1, 1 },
+		{ m_PreFilteredEnvironmentMap.get(), &m_CachedMaps->PreFilteredEnvironmentMap, m_PEMResolution, 6, m_PEMRoughnessBins }
+	};
+
+	// The same synchronization as processing the environment map
+	const auto directQueue = g_D3DGraphicsContext->GetDirectCommandQueue();
+	const auto computeQueue = g_D3DGraphicsContext->GetComputeCommandQueue();
+	computeQueue->InsertWaitForQueue(directQueue);
+	THROW_IF_FAIL(m_CommandAllocator->Reset());
+	THROW_IF_FAIL(m_CommandList->Reset(m_CommandAllocator.Get(), nullptr));
+
+	PIXBeginEvent(m_CommandList.Get(), PIX_COLOR_INDEX(56), L"Environment upload");
+
+	{
+		D3D12_RESOURCE_BARRIER barriers[] = {
+			CD3DX12_RESOURCE_BARRIER::Transition(m_IrradianceMap->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+			CD3DX12_RESOURCE_BARRIER::Transition(m_BRDFIntegrationMap->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+			CD3DX12_RESOURCE_BARRIER::Transition(m_PreFilteredEnvironmentMap->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST)
+		};
+		m_CommandList->ResourceBarrier(ARRAYSIZE(barriers), barriers);
+	}
+
+	for (const CachedMap& cachedMap : cachedMaps)
+	{
+		const std::vector<IBLCache::Subresource> subresources = IBLCache::GetSubresources(cachedMap.Resolution, cachedMap.ArraySize, cachedMap.MipLevels, cachedMap.Map->GetFormat());
+
+		std::vector<D3D12_SUBRESOURCE_DATA> subresourceData(subresources.size());
+		for (size_t i = 0; i < subresources.size(); i++)
+		{
+			subresourceData[i].pData = cachedMap.Texels->data() + subresources[i].Offset;
+			subresourceData[i].RowPitch = static_cast<LONG_PTR>(subresources[i].RowPitch);
+			subresourceData[i].SlicePitch = static_cast<LONG_PTR>(subresources[i].RowPitch * subresources[i].Height);
+		}
+
+		ComPtr<ID3D12Resource> uploadHeap;
+		const UINT64 uploadBufferSize = GetRequiredIntermediateSize(cachedMap.Map->GetResource(), 0, static_cast<UINT>(subresources.size()));
+
+		const auto uploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		const auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
+		THROW_IF_FAIL(device->CreateCommittedResource(
+			&uploadHeapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&uploadDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&uploadHeap)));
+
+		UpdateSubresources(m_CommandList.Get(), cachedMap.Map->GetResource(), uploadHeap.Get(), 0, 0, static_cast<UINT>(subresources.size()), subresourceData.data());
+
+		// The upload buffer should not be released until the copy has completed
+		g_D3DGraphicsContext->DeferRelease(uploadHeap);
+	}
+
+	{
+		D3D12_RESOURCE_BARRIER barriers[] = {
+			CD3DX12_RESOURCE_BARRIER::Transition(m_IrradianceMap->GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+			CD3DX12_RESOURCE_BARRIER::Transition(m_BRDFIntegrationMap->GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+			CD3DX12_RESOURCE_BARRIER::Transition(m_PreFilteredEnvironmentMap->GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+			CD3DX12_RESOURCE_BARRIER::Transition(m_EnvironmentMap->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COMMON)
+		};
+		m_CommandList->ResourceBarrier(ARRAYSIZE(barriers), barriers);
+	}
+
+	PIXEndEvent(m_CommandList.Get());
+
+	THROW_IF_FAIL(m_CommandList->Close());
+	ID3D12CommandList* ppCommandLists[] = { m_CommandList.Get() };
+	m_PreviousWorkFence = computeQueue->ExecuteCommandLists(ARRAYSIZE(ppCommandLists), ppCommandLists);
+
+	directQueue->InsertWaitForQueue(computeQueue);
+	computeQueue->WaitForFenceCPUBlocking(m_PreviousWorkFence);
+
+	m_CachedMaps.reset();
+}
+
+void IBL::SaveCache()
+{
 	const auto queue = g_D3DGraphicsContext->GetDirectCommandQueue();
 
-	const auto& irradianceMapDesc = m_IrradianceMap->GetResource()->GetDesc();
+	IBLCache::Contents contents;
+	contents.SkySH = m_SkyIrradianceSH;
+
+	// This is slow, but only happens the first time that an environment map is processed
+	auto ReadBack = [queue](const Texture& map, bool isCubeMap, UINT resolution, UINT arraySize, UINT mipLevels, std::vector<UINT8>& texels)
+		{
+			ScratchImage result;
+			THROW_IF_FAIL(CaptureTexture(queue->GetCommandQueue(), map.GetResource(), isCubeMap, result, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+
+			const std::vector<IBLCache::Subresource> subresources = IBLCache::GetSubresources(resolution, arraySize, mipLevels, map.GetFormat());
+			texels.resize(IBLCache::GetMapSize(resolution, arraySize, mipLevels, map.GetFormat()));
+
+			for (UINT slice = 0; slice < arraySize; slice++)
+			{
+				for (UINT mip = 0; mip < mipLevels; mip++)
+				{
+					const IBLCache::Subresource& subresource = subresources[mip + slice * mipLevels];
+					const Image* image = result.GetImage(mip, slice, 0);
+					ASSERT(image && image->width == subresource.Width && image->height == subresource.Height, "Unexpected captured subresource");
+
+					// Captured rows may be padded
+					for (UINT y = 0; y < subresource.Height; y++)
+					{
+						memcpy(texels.data() + subresource.Offset + y * subresource.RowPitch, image->pixels + y * image->rowPitch, subresource.RowPitch);
+					}
+				}
+			}
+		};
 
-	// This is slow but that's okay for now
-	ScratchImage result;
-	THROW_IF_FAIL(CaptureTexture(queue->GetCommandQueue(), m_IrradianceMap->GetResource(), true, result, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+	ReadBack(*m_IrradianceMap, true, m_IrradianceMapResolution, 6, 1, contents.IrradianceMap);
+	ReadBack(*m_BRDFIntegrationMap, false, m_BRDFIntegrationMapResolution, 1, 1, contents.BRDFIntegrationMap);
+	ReadBack(*m_PreFilteredEnvironmentMap, true, m_PEMResolution, 6, m_PEMRoughnessBins, contents.PreFilteredEnvironmentMap);
 	// Wait until all work has finished to be safe
 	queue->WaitForIdleCPUBlocking();
 
-	ASSERT(result.GetImageCount() == 6, "Incorrect number of images!");
-
-	D3D12_SUBRESOURCE_DATA subresources[6];
-	const Image* image = result.GetImages();
-	for (auto& subresource : subresources)
+	std::error_code error;
+	std::filesystem::create_directories(s_CacheDirectory, error);
+	if (error)
 	{
-		subresource.RowPitch = static_cast<LONG_PTR>(image->rowPitch);
-		subresource.SlicePitch = static_cast<LONG_PTR>(image->slicePitch);
-		subresource.pData = image->pixels;
-
-		// Go to next image
-		image++;
+		LOG_WARN("IBL: Failed to create the cache directory {}", s_CacheDirectory);
+		return;
 	}
 
-	// Now create SH representation from the subresource data
-	THROW_IF_FAIL(SHProjectCubeMap(3, irradianceMapDesc, subresources,
-		m_SkyIrradianceSH.R.data(), m_SkyIrradianceSH.G.data(), m_SkyIrradianceSH.B.data()
-	));
+	if (IBLCache::Save(m_CachePath, m_CacheDesc, contents))
+		LOG_INFO("IBL: Wrote the derived maps to {}", m_CachePath);
 }
 
 
@@ -3,7 +3,10 @@
 #include "Core.h"
 #include "Renderer/D3DPipeline.h"
 #include "Renderer/Buffer/Texture.h"
+#include "Renderer/Buffer/TextureLoader.h"
 #include "Renderer/Memory/MemoryAllocator.h"
+#include "IBLCache.h"
+#include "SHProjector.h"
 
 
 class IBL
@@ -33,14 +36,9 @@ class IBL
 		SamplerCount
 	};
 
-	template<size_t Order>
-	struct SkyIrradianceSH
-	{
-		// A set of SH Coefficients for each channel to represent sky irradiance
-		std::array<float, Order * Order> R;
-		std::array<float, Order * Order> G;
-		std::array<float, Order * Order> B;
-	};
+public:
+	// Maps derived from an environment map are cached here, so that startup can load them rather than recompute them
+	inline static constexpr const char* s_CacheDirectory = "cache/ibl";
 
 public:
 	IBL();
@@ -49,12 +47,21 @@ public:
 	DISALLOW_COPY(IBL)
 	DEFAULT_MOVE(IBL)
 
-	// These methods are REALLY SLOW - only call once
+	// Call with the environment map as decoded by the TextureLoader, before it is uploaded
+	// Loads the derived maps and sky SH from the cache if this map has been processed with the same settings before, otherwise projects the SH
+	void PrepareEnvironmentMap(const TextureLoader::DecodedImage& image);
+	// Uploads the derived maps if they were loaded from the cache
+	// Otherwise computes them, which is REALLY SLOW, and writes them to the cache
 	void ProcessEnvironmentMap(std::unique_ptr<Texture>&& map);
-	void ProjectIrradianceMapToSH();
+	// Projects the sky radiance onto SH from the environment map as decoded by the TextureLoader, laid out as 6 square faces in one row
+	// Runs on the CPU, so it can be called before the map is uploaded
+	void ProjectEnvironmentMapToSH(const TextureLoader::DecodedImage& image);
 
 	void PopulateSkyIrradianceSHConstants(XMFLOAT4* OutConstants) const;
 
+	inline double GetSHProjectionMilliseconds() const { return m_SHProjectionMilliseconds; }
+	inline bool WasLoadedFromCache() const { return m_LoadedFromCache; }
+
 	// Get resources
 	inline Texture* GetEnvironmentMap() const { return m_EnvironmentMap.get(); }
 	inline D3D12_GPU_DESCRIPTOR_HANDLE GetEnvironmentMapSRV() const { return m_GlobalLightingSRVs.GetGPUHandle(EnvironmentMapSRV); }
@@ -68,6 +75,11 @@ private:
 	void CreatePipelines();
 	void CreateResources();
 
+	IBLCache::Desc GetCacheDesc(UINT64 sourceHash) const;
+	void UploadCachedMaps();
+	// Reads the derived maps back from the GPU
+	void SaveCache();
+
 private:
 	// Environmental lighting resources
 	std::unique_ptr<Texture> m_EnvironmentMap;
@@ -83,8 +95,17 @@ private:
 	std::unique_ptr<Texture> m_BRDFIntegrationMap;
 	std::unique_ptr<Texture> m_PreFilteredEnvironmentMap;
 
-	// Spherical harmonic representation of sky irradiance
-	SkyIrradianceSH<3> m_SkyIrradianceSH;
+	// Spherical harmonic representation of sky radiance
+	// The diffuse convolution is applied when the constants are packed
+	SHProjector::Coefficients m_SkyIrradianceSH;
+	double m_SHProjectionMilliseconds = 0.0;
+
+	// Cache of the derived maps, for the environment map passed to PrepareEnvironmentMap
+	IBLCache::Desc m_CacheDesc;
+	std::string m_CachePath;
+	// Loaded from the cache and held until they are uploaded
+	std::unique_ptr<IBLCache::Contents> m_CachedMaps;
+	bool m_LoadedFromCache = false;
 
 	// All descriptors for global lighting
 	DescriptorAllocation m_GlobalLightingSRVs;
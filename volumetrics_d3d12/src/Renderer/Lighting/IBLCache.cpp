@@ -0,0 +1,281 @@
+#include "pch.h"
+#include "IBLCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+
+namespace
+{
+	// 64-bit FNV-1a
+	constexpr UINT64 c_FNVOffsetBasis = 0xcbf29ce484222325ull;
+	constexpr UINT64 c_FNVPrime = 0x100000001b3ull;
+
+	inline UINT64 HashBytes(const void* data, size_t size, UINT64 hash = c_FNVOffsetBasis)
+	{
+		const UINT8* bytes = static_cast<const UINT8*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= c_FNVPrime;
+		}
+		return hash;
+	}
+
+	template<typename T>
+	inline UINT64 HashValue(const T& value, UINT64 hash)
+	{
+		return HashBytes(&value, sizeof(T), hash);
+	}
+
+	// FNV-1a taken 8 bytes at a time, which is fast enough to hash a large environment map at every startup
+	inline UINT64 HashWords(const void* data, size_t size, UINT64 hash)
+	{
+		const UINT8* bytes = static_cast<const UINT8*>(data);
+		const size_t wordCount = size / sizeof(UINT64);
+		for (size_t i = 0; i < wordCount; i++)
+		{
+			UINT64 word;
+			memcpy(&word, bytes + i * sizeof(UINT64), sizeof(UINT64));
+			hash ^= word;
+			hash *= c_FNVPrime;
+		}
+		return HashBytes(bytes + wordCount * sizeof(UINT64), size % sizeof(UINT64), hash);
+	}
+
+
+	struct CacheFileHeader
+	{
+		char Magic[4];
+		UINT Version;
+		UINT64 DescHash;
+
+		UINT64 SourceHash;
+		UINT IrradianceMapResolution;
+		UINT BRDFIntegrationMapResolution;
+		UINT PEMResolution;
+		UINT PEMRoughnessBins;
+		UINT IrradianceMapFormat;
+		UINT BRDFIntegrationMapFormat;
+		UINT PEMFormat;
+		UINT Padding;
+
+		float SkySH[3 * SHProjector::s_CoefficientCount];
+
+		// Of the sky SH, then the maps in the order that they follow the header
+		UINT64 ContentHash;
+	};
+
+	constexpr char s_CacheFileMagic[4] = { 'I', 'B', 'L', 'C' };
+
+	// Bytes of each map that a desc gives, in the order that they are stored
+	std::array<size_t, 3> GetMapSizes(const IBLCache::Desc& desc)
+	{
+		return {
+			IBLCache::GetMapSize(desc.IrradianceMapResolution, 6, 1, desc.IrradianceMapFormat),
+			IBLCache::GetMapSize(desc.BRDFIntegrationMapResolution, 1, 1, desc.BRDFIntegrationMapFormat),
+			IBLCache::GetMapSize(desc.PEMResolution, 6, desc.PEMRoughnessBins, desc.PEMFormat)
+		};
+	}
+}
+
+
+std::vector<IBLCache::Subresource> IBLCache::GetSubresources(UINT resolution, UINT arraySize, UINT mipLevels, DXGI_FORMAT format)
+{
+	const UINT bytesPerTexel = GetBytesPerTexel(format);
+	ASSERT(bytesPerTexel > 0, "Unsupported format");
+
+	std::vector<Subresource> subresources;
+	subresources.reserve(static_cast<size_t>(arraySize) * mipLevels);
+
+	size_t offset = 0;
+	for (UINT slice = 0; slice < arraySize; slice++)
+	{
+		for (UINT mip = 0; mip < mipLevels; mip++)
+		{
+			Subresource& subresource = subresources.emplace_back();
+			subresource.Offset = offset;
+			subresource.Width = max(resolution >> mip, 1u);
+			subresource.Height = subresource.Width;
+			subresource.RowPitch = static_cast<size_t>(subresource.Width) * bytesPerTexel;
+
+			offset += subresource.RowPitch * subresource.Height;
+		}
+	}
+
+	return subresources;
+}
+
+size_t IBLCache::GetMapSize(UINT resolution, UINT arraySize, UINT mipLevels, DXGI_FORMAT format)
+{
+	const std::vector<Subresource> subresources = GetSubresources(resolution, arraySize, mipLevels, format);
+	if (subresources.empty())
+		return 0;
+
+	const Subresource& last = subresources.back();
+	return last.Offset + last.RowPitch * last.Height;
+}
+
+UINT IBLCache::GetBytesPerTexel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 16;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return 8;
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+
+UINT64 IBLCache::HashSourceImage(const void* data, UINT width, UINT height, UINT channels, UINT bytesPerChannel)
+{
+	UINT64 hash = c_FNVOffsetBasis;
+	hash = HashValue(width, hash);
+	hash = HashValue(height, hash);
+	hash = HashValue(channels, hash);
+	hash = HashValue(bytesPerChannel, hash);
+	return HashWords(data, static_cast<size_t>(width) * height * channels * bytesPerChannel, hash);
+}
+
+UINT64 IBLCache::HashDesc(const Desc& desc)
+{
+	// Fields are hashed one at a time, so that padding does not affect the hash
+	UINT64 hash = c_FNVOffsetBasis;
+	hash = HashValue(s_Version, hash);
+	hash = HashValue(desc.SourceHash, hash);
+	hash = HashValue(desc.IrradianceMapResolution, hash);
+	hash = HashValue(desc.BRDFIntegrationMapResolution, hash);
+	hash = HashValue(desc.PEMResolution, hash);
+	hash = HashValue(desc.PEMRoughnessBins, hash);
+	hash = HashValue(static_cast<UINT>(desc.IrradianceMapFormat), hash);
+	hash = HashValue(static_cast<UINT>(desc.BRDFIntegrationMapFormat), hash);
+	hash = HashValue(static_cast<UINT>(desc.PEMFormat), hash);
+	return hash;
+}
+
+std::string IBLCache::GetCachePath(const std::string& cacheDirectory, const Desc& desc)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "ibl_%016llx.bin", static_cast<unsigned long long>(HashDesc(desc)));
+	return cacheDirectory + "/" + name;
+}
+
+
+bool IBLCache::Save(const std::string& path, const Desc& desc, const Contents& contents)
+{
+	const std::array<size_t, 3> sizes = GetMapSizes(desc);
+	const std::array<const std::vector<UINT8>*, 3> maps = { &contents.IrradianceMap, &contents.BRDFIntegrationMap, &contents.PreFilteredEnvironmentMap };
+	for (UINT i = 0; i < 3; i++)
+	{
+		if (maps[i]->size() != sizes[i])
+		{
+			LOG_ERROR("IBL cache: Map {} is {} bytes rather than {}", i, maps[i]->size(), sizes[i]);
+			return false;
+		}
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for writing", path);
+		return false;
+	}
+
+	CacheFileHeader header = {};
+	memcpy(header.Magic, s_CacheFileMagic, sizeof(header.Magic));
+	header.Version = s_Version;
+	header.DescHash = HashDesc(desc);
+	header.SourceHash = desc.SourceHash;
+	header.IrradianceMapResolution = desc.IrradianceMapResolution;
+	header.BRDFIntegrationMapResolution = desc.BRDFIntegrationMapResolution;
+	header.PEMResolution = desc.PEMResolution;
+	header.PEMRoughnessBins = desc.PEMRoughnessBins;
+	header.IrradianceMapFormat = static_cast<UINT>(desc.IrradianceMapFormat);
+	header.BRDFIntegrationMapFormat = static_cast<UINT>(desc.BRDFIntegrationMapFormat);
+	header.PEMFormat = static_cast<UINT>(desc.PEMFormat);
+
+	memcpy(&header.SkySH[0], contents.SkySH.R.data(), sizeof(contents.SkySH.R));
+	memcpy(&header.SkySH[SHProjector::s_CoefficientCount], contents.SkySH.G.data(), sizeof(contents.SkySH.G));
+	memcpy(&header.SkySH[2 * SHProjector::s_CoefficientCount], contents.SkySH.B.data(), sizeof(contents.SkySH.B));
+
+	UINT64 contentHash = HashBytes(header.SkySH, sizeof(header.SkySH));
+	for (const std::vector<UINT8>* map : maps)
+	{
+		contentHash = HashWords(map->data(), map->size(), contentHash);
+	}
+	header.ContentHash = contentHash;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	for (const std::vector<UINT8>* map : maps)
+	{
+		file.write(reinterpret_cast<const char*>(map->data()), map->size());
+	}
+	return file.good();
+}
+
+bool IBLCache::Load(const std::string& path, const Desc& desc, Contents& contents)
+{
+	// A missing file is the usual case for an environment map that has not been processed before
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	CacheFileHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || memcmp(header.Magic, s_CacheFileMagic, sizeof(header.Magic)) != 0 || header.Version != s_Version)
+	{
+		LOG_WARN("IBL cache: {} is not a cache file of this version", path);
+		return false;
+	}
+
+	const Desc fileDesc = {
+		.SourceHash = header.SourceHash,
+		.IrradianceMapResolution = header.IrradianceMapResolution,
+		.BRDFIntegrationMapResolution = header.BRDFIntegrationMapResolution,
+		.PEMResolution = header.PEMResolution,
+		.PEMRoughnessBins = header.PEMRoughnessBins,
+		.IrradianceMapFormat = static_cast<DXGI_FORMAT>(header.IrradianceMapFormat),
+		.BRDFIntegrationMapFormat = static_cast<DXGI_FORMAT>(header.BRDFIntegrationMapFormat),
+		.PEMFormat = static_cast<DXGI_FORMAT>(header.PEMFormat)
+	};
+
+	if (!(fileDesc == desc) || header.DescHash != HashDesc(desc))
+	{
+		LOG_WARN("IBL cache: {} was written for a different environment map or settings", path);
+		return false;
+	}
+
+	const std::array<size_t, 3> sizes = GetMapSizes(desc);
+	Contents loaded;
+	const std::array<std::vector<UINT8>*, 3> maps = { &loaded.IrradianceMap, &loaded.BRDFIntegrationMap, &loaded.PreFilteredEnvironmentMap };
+
+	UINT64 contentHash = HashBytes(header.SkySH, sizeof(header.SkySH));
+	for (UINT i = 0; i < 3; i++)
+	{
+		maps[i]->resize(sizes[i]);
+		file.read(reinterpret_cast<char*>(maps[i]->data()), maps[i]->size());
+		contentHash = HashWords(maps[i]->data(), maps[i]->size(), contentHash);
+	}
+
+	if (!file || contentHash != header.ContentHash)
+	{
+		LOG_WARN("IBL cache: {} is truncated or corrupt", path);
+		return false;
+	}
+
+	memcpy(loaded.SkySH.R.data(), &header.SkySH[0], sizeof(loaded.SkySH.R));
+	memcpy(loaded.SkySH.G.data(), &header.SkySH[SHProjector::s_CoefficientCount], sizeof(loaded.SkySH.G));
+	memcpy(loaded.SkySH.B.data(), &header.SkySH[2 * SHProjector::s_CoefficientCount], sizeof(loaded.SkySH.B));
+
+	contents = std::move(loaded);
+	return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Core.h"
+#include "SHProjector.h"
+
+#include <string>
+
+
+/**
+ *	Reads and writes the maps that IBL derives from an environment map, so that startup can load them
+ *	rather than recomputing them every time.
+ *
+ *	A cache file holds the irradiance map, the BRDF integration map, every mip of the pre-filtered environment map and the sky SH.
+ *	It is named after a hash of the decoded environment map and the quality settings, which its header also holds,
+ *	with a hash of its contents so that a truncated or corrupt file is recomputed rather than loaded.
+ *
+ *	The subresources of each map are packed without padding in D3D subresource order, every mip of a face before the next face.
+ *	The cache has no knowledge of the device, so that it can be tested on its own.
+ */
+class IBLCache
+{
+public:
+	// Bumped when the shaders that compute the maps or the file layout change, so that old cache files are not loaded
+	inline static constexpr UINT s_Version = 1;
+
+	struct Desc
+	{
+		// From HashSourceImage
+		UINT64 SourceHash = 0;
+
+		UINT IrradianceMapResolution = 0;
+		UINT BRDFIntegrationMapResolution = 0;
+		UINT PEMResolution = 0;
+		UINT PEMRoughnessBins = 0;
+
+		DXGI_FORMAT IrradianceMapFormat = DXGI_FORMAT_UNKNOWN;
+		DXGI_FORMAT BRDFIntegrationMapFormat = DXGI_FORMAT_UNKNOWN;
+		DXGI_FORMAT PEMFormat = DXGI_FORMAT_UNKNOWN;
+
+		bool operator==(const Desc& other) const = default;
+	};
+
+	struct Contents
+	{
+		std::vector<UINT8> IrradianceMap;
+		std::vector<UINT8> BRDFIntegrationMap;
+		std::vector<UINT8> PreFilteredEnvironmentMap;
+
+		SHProjector::Coefficients SkySH;
+	};
+
+	struct Subresource
+	{
+		size_t Offset = 0;
+		UINT Width = 0;
+		UINT Height = 0;
+		size_t RowPitch = 0;
+	};
+
+public:
+	IBLCache() = delete;
+
+	// The layout of every subresource of a square map, in D3D subresource order
+	static std::vector<Subresource> GetSubresources(UINT resolution, UINT arraySize, UINT mipLevels, DXGI_FORMAT format);
+	// Bytes of the packed subresources of a square map
+	static size_t GetMapSize(UINT resolution, UINT arraySize, UINT mipLevels, DXGI_FORMAT format);
+	// Only the formats that IBL uses are supported, others are 0
+	static UINT GetBytesPerTexel(DXGI_FORMAT format);
+
+	// Hashes of the decoded environment map and its dimensions, and of every field of a desc
+	static UINT64 HashSourceImage(const void* data, UINT width, UINT height, UINT channels, UINT bytesPerChannel);
+	static UINT64 HashDesc(const Desc& desc);
+	static std::string GetCachePath(const std::string& cacheDirectory, const Desc& desc);
+
+	// Fails if a map does not have the size that the desc gives it
+	static bool Save(const std::string& path, const Desc& desc, const Contents& contents);
+	// Fails if the file was written with a different version or desc, or its contents do not match their hash
+	static bool Load(const std::string& path, const Desc& desc, Contents& contents);
+};
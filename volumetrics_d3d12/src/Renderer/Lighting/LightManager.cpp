@@ -4,6 +4,8 @@
 
 #include "Renderer/D3DGraphicsContext.h"
 #include "Framework/Math.h"
+#include "Framework/Camera/Camera.h"
+#include "Framework/ThreadPool.h"
 
 #include "IBL.h"
 
@@ -28,8 +30,7 @@ LightManager::LightManager()
 
 	m_LightingCBStaging.UseSHIrradiance = false;
 
-	m_LightingCBStaging.PointLightCount = s_MaxLights;
-
+	m_PointLightsStaging.resize(s_MaxLights);
 	for (auto& light : m_PointLightsStaging)
 	{
 		light.Position = { 0.0f, 2.0f, 0.0f };
@@ -38,24 +39,19 @@ LightManager::LightManager()
 		light.Range = 3.0f;
 	}
 
-	// Set up shadow camera and shadow map
-	// TODO: Sun shadow projection matrices will be handled a lot neater once cascaded shadow maps are implemented
-	m_ShadowCameraProjectionMatrix = XMMatrixOrthographicLH(30.0f, 30.0f, 0.1f, 100.0f);
+	// Set up shadow cascades and shadow map
+	// Cascades are fitted to the camera each frame
+	for (auto& cascade : m_Cascades)
+	{
+		cascade = ShadowCascade{ XMMatrixIdentity(), 0.0f, 0.0f, 0.0f };
+	}
 
 	constexpr UINT shadowMapW = 1024;
 	constexpr UINT shadowMapH = 1024;
-	m_SunShadowMap.CreateShadowMap(shadowMapW, shadowMapH);
+	m_SunShadowMap.CreateShadowMap(shadowMapW, shadowMapH, MAX_SHADOW_CASCADES);
 	m_SunESM.CreateExponentialShadowMap(m_SunShadowMap);
 
 
-	// Create light buffers
-	m_LightingResources.resize(D3DGraphicsContext::GetBackBufferCount());
-	for (auto& resources : m_LightingResources)
-	{
-		resources.LightingCB.Allocate(g_D3DGraphicsContext->GetDevice(), 1, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, L"Lighting Constant Buffer");
-		resources.PointLights.Allocate(g_D3DGraphicsContext->GetDevice(), s_MaxLights, 0, L"Point Light Buffer");
-	}
-
 	// Create shadow sampler
 	{
 		m_ShadowSamplers = g_D3DGraphicsContext->GetSamplerHeap()->Allocate(ShadowSampler_Count);
@@ -92,47 +88,163 @@ LightManager::~LightManager()
 	m_ShadowSamplers.Free();
 }
 
-void LightManager::UpdateLightingCB(const XMFLOAT3& eyePos)
+void LightManager::UpdateLightingCB(Camera& camera)
 {
-	// TODO: A nicer encapsulation of a shadow camera would be really nice
-	// Create a view matrix for the directional light
-	XMVECTOR forward = XMVector3Normalize(XMLoadFloat3(&m_LightingCBStaging.DirectionalLight.Direction));
-	XMVECTOR up = { 0.0f, 1.0f, 0.0f };
+	auto& directionalLight = m_LightingCBStaging.DirectionalLight;
+
+	// Fit each cascade to its slice of the camera frustum
+	{
+		const XMMATRIX invView = XMMatrixInverse(nullptr, camera.GetViewMatrix());
+		const XMMATRIX invProj = XMMatrixInverse(nullptr, camera.GetProjectionMatrix());
 
-	XMVECTOR right = XMVector3Normalize(XMVector3Cross(up, forward));
-	up = XMVector3Cross(forward, right);
+		const float nearPlane = camera.GetNearPlane();
+		const float farPlane = camera.GetFarPlane();
 
-	// subtract a distance from the eye position to get a position for the camera
-	constexpr float d = 50.0f;
-	XMVECTOR position = - d * forward;
+		std::array<float, MAX_SHADOW_CASCADES> splits{};
+		ShadowCascades::ComputeSplits(nearPlane, min(m_ShadowDistance, farPlane), m_CascadeSplitLambda, m_CascadeCount, splits.data());
 
-	XMMATRIX view = XMMatrixLookAtLH(position, position + forward, up);
+		const XMVECTOR lightDirection = XMLoadFloat3(&directionalLight.Direction);
+		const UINT resolution = m_SunShadowMap.GetDimensions().x;
 
-	// Now update the CB with the new camera matrix
-	const XMMATRIX viewProj = XMMatrixMultiply(view, m_ShadowCameraProjectionMatrix);
-	m_LightingCBStaging.DirectionalLight.ViewProjection = XMMatrixTranspose(viewProj);
+		float splitNear = nearPlane;
+		for (UINT i = 0; i < m_CascadeCount; i++)
+		{
+			m_Cascades.at(i) = ShadowCascades::FitCascade(invView, invProj, nearPlane, farPlane, splitNear, splits.at(i), lightDirection, resolution);
+			directionalLight.CascadeViewProjection[i] = XMMatrixTranspose(m_Cascades.at(i).ViewProjection);
+
+			splitNear = splits.at(i);
+		}
+
+		directionalLight.CascadeSplits = { splits.at(0), splits.at(1), splits.at(2), splits.at(3) };
+		directionalLight.CascadeCount = m_CascadeCount;
+	}
+
+	directionalLight.UseESM = m_UseESM;
 
-	m_LightingCBStaging.DirectionalLight.UseESM = m_UseESM;
+	UpdateLightClusters(camera);
 
 	m_IBL->PopulateSkyIrradianceSHConstants(m_LightingCBStaging.SkyIrradianceEnvironmentMap);
 }
 
-void LightManager::CopyStagingBuffers() const
+void LightManager::SetFroxelGrid(const VolumetricsConstantBuffer& volume)
+{
+	ASSERT(volume.VolumeResolution.z > 1, "Invalid volume resolution");
+
+	m_FroxelGridResolution = volume.VolumeResolution;
+	m_MaxVolumeDistance = volume.MaxVolumeDistance;
+	m_FroxelDepthDistribution = volume.DepthDistribution;
+	m_FroxelHybridLinearDepth = volume.HybridLinearDepth;
+}
+
+void LightManager::UpdateLightClusters(Camera& camera)
+{
+	const float nearPlane = camera.GetNearPlane();
+	const float farPlane = camera.GetFarPlane();
+
+	// An extra slice beyond the end of the volume holds lights for anything further away
+	const XMUINT3 gridDimensions = {
+		max(m_FroxelGridResolution.x / s_ClusterFroxelsXY, 1u),
+		max(m_FroxelGridResolution.y / s_ClusterFroxelsXY, 1u),
+		m_FroxelGridResolution.z / s_ClusterFroxelSlices + 1
+	};
+
+	// Cluster slices start on every s_ClusterFroxelSlices-th froxel slice, using the same depth distribution as the volume
+	auto ClusterSliceDepth = [&](UINT clusterSlice)
+		{
+			return Volumetrics::ZSliceToFroxelDepth(static_cast<float>(clusterSlice * s_ClusterFroxelSlices), nearPlane, m_MaxVolumeDistance,
+				m_FroxelGridResolution.z, m_FroxelDepthDistribution, m_FroxelHybridLinearDepth);
+		};
+
+	m_ClusterSliceDepths.resize(gridDimensions.z + 1);
+	for (UINT i = 0; i < gridDimensions.z; i++)
+	{
+		m_ClusterSliceDepths.at(i) = ClusterSliceDepth(i);
+	}
+	m_ClusterSliceDepths.at(gridDimensions.z) = max(farPlane, ClusterSliceDepth(gridDimensions.z));
+
+	m_LightCuller.SetClusterGrid(gridDimensions, m_ClusterSliceDepths.data(), camera.GetProjectionMatrix());
+	m_LightCuller.SetLights(m_PointLightsStaging.data(), m_PointLightCount, camera.GetViewMatrix());
+	m_LightCuller.BinLights(ThreadPool::GetDefault());
+
+	m_LightingCBStaging.PointLightCount = m_PointLightCount;
+	m_LightingCBStaging.ClusterDepthScale = 1.0f / static_cast<float>(s_ClusterFroxelSlices);
+	m_LightingCBStaging.ClusterNearDepth = nearPlane;
+	m_LightingCBStaging.ClusterFarDepth = m_MaxVolumeDistance;
+	m_LightingCBStaging.ClusterFroxelSliceCount = m_FroxelGridResolution.z;
+	m_LightingCBStaging.ClusterDepthDistribution = m_FroxelDepthDistribution;
+	m_LightingCBStaging.ClusterHybridLinearDepth = m_FroxelHybridLinearDepth;
+	m_LightingCBStaging.ClusterGridDimensions = gridDimensions;
+}
+
+void LightManager::ScatterPointLights()
 {
-	const auto& resources = m_LightingResources.at(g_D3DGraphicsContext->GetCurrentBackBuffer());
+	for (UINT i = 0; i < m_PointLightCount; i++)
+	{
+		auto& light = m_PointLightsStaging.at(i);
 
-	resources.LightingCB.CopyElement(0, m_LightingCBStaging);
-	resources.PointLights.CopyElements(0, static_cast<UINT>(m_PointLightsStaging.size()), m_PointLightsStaging.data());
+		light.Position = {
+			Random::Float(-m_ScatterRadius, m_ScatterRadius),
+			Random::Float(0.0f, m_ScatterHeight),
+			Random::Float(-m_ScatterRadius, m_ScatterRadius)
+		};
+		light.Color = { Random::NormalizedFloat(), Random::NormalizedFloat(), Random::NormalizedFloat() };
+		light.Intensity = Random::Float(0.5f, 2.0f);
+		light.Range = Random::Float(1.0f, 4.0f);
+	}
 }
 
-D3D12_GPU_VIRTUAL_ADDRESS LightManager::GetLightingConstantBuffer() const
+Frustum LightManager::GetCascadeShadowCasterFrustum(UINT cascade) const
 {
-	return m_LightingResources.at(g_D3DGraphicsContext->GetCurrentBackBuffer()).LightingCB.GetAddressOfElement(0);
+	// The shadow pass clamps depth rather than clipping, so casters behind the near plane are flattened onto it
+	Frustum frustum = Frustum::FromViewProjection(m_Cascades.at(cascade).ViewProjection);
+	frustum.DisablePlane(Frustum::Plane_Near);
+	return frustum;
 }
 
-D3D12_GPU_VIRTUAL_ADDRESS LightManager::GetPointLightBuffer() const
+void LightManager::CopyStagingBuffers()
 {
-	return m_LightingResources.at(g_D3DGraphicsContext->GetCurrentBackBuffer()).PointLights.GetAddressOfElement(0);
+	const auto uploadAllocator = g_D3DGraphicsContext->GetFrameUploadAllocator();
+
+	const UploadAllocation lightingCB = uploadAllocator->AllocateConstants(m_LightingCBStaging);
+	// Always upload at least one element so that the root SRVs point at valid memory
+	const UploadAllocation pointLights = uploadAllocator->AllocateElements(m_PointLightsStaging.data(), max(m_PointLightCount, 1u));
+	ASSERT(lightingCB.IsValid() && pointLights.IsValid(), "Failed to allocate lighting buffers");
+
+	m_LightingCBAddress = lightingCB.GPUAddress;
+	m_PointLightsAddress = pointLights.GPUAddress;
+
+	// Cluster light lists
+	{
+		const auto& clusterLightRanges = m_LightCuller.GetClusterLightRanges();
+		const auto& lightIndices = m_LightCuller.GetLightIndices();
+
+		const UINT clusterCount = static_cast<UINT>(clusterLightRanges.size());
+		const UINT indexCount = min(static_cast<UINT>(lightIndices.size()), s_MaxClusterLightIndices);
+
+		const UploadAllocation clusterGrid = uploadAllocator->AllocateElements(clusterLightRanges.data(), clusterCount);
+		const UploadAllocation clusterIndices = uploadAllocator->Allocate(max(indexCount, 1u) * sizeof(UINT));
+		ASSERT(clusterGrid.IsValid() && clusterIndices.IsValid(), "Failed to allocate cluster light lists");
+
+		if (indexCount > 0)
+		{
+			memcpy(clusterIndices.CPUAddress, lightIndices.data(), indexCount * sizeof(UINT));
+		}
+
+		// Lists that run past the limit are cut short
+		if (lightIndices.size() > s_MaxClusterLightIndices)
+		{
+			XMUINT2* ranges = reinterpret_cast<XMUINT2*>(clusterGrid.CPUAddress);
+			for (UINT i = 0; i < clusterCount; i++)
+			{
+				const XMUINT2& range = clusterLightRanges.at(i);
+				const UINT available = range.x < s_MaxClusterLightIndices ? s_MaxClusterLightIndices - range.x : 0;
+				ranges[i] = { range.x, min(range.y, available) };
+			}
+		}
+
+		m_ClusterLightGridAddress = clusterGrid.GPUAddress;
+		m_ClusterLightIndicesAddress = clusterIndices.GPUAddress;
+	}
 }
 
 
@@ -171,6 +283,17 @@ void LightManager::DrawGui()
 		}
 
 		ImGui::Checkbox("Use ESM", &m_UseESM);
+
+		int cascadeCount = static_cast<int>(m_CascadeCount);
+		if (ImGui::SliderInt("Shadow Cascades", &cascadeCount, 1, MAX_SHADOW_CASCADES))
+		{
+			m_CascadeCount = static_cast<UINT>(cascadeCount);
+		}
+		ImGui::SliderFloat("Cascade Split Lambda", &m_CascadeSplitLambda, 0.0f, 1.0f);
+		if (ImGui::DragFloat("Shadow Distance", &m_ShadowDistance, 0.1f))
+		{
+			m_ShadowDistance = max(1.0f, m_ShadowDistance);
+		}
 	}
 
 	{
@@ -182,24 +305,84 @@ void LightManager::DrawGui()
 		{
 			m_LightingCBStaging.UseSHIrradiance = static_cast<UINT>(useSH);
 		}
+
+		if (m_IBL->WasLoadedFromCache())
+			ImGui::Text("Environment maps and SH loaded from the cache");
+		else
+			ImGui::Text("SH projected in %.2f ms", m_IBL->GetSHProjectionMilliseconds());
+
+		// Takes a few seconds, as the scalar projection of the largest faces is included
+		if (ImGui::Button("Benchmark SH Projection"))
+		{
+			const SHProjector projector(ThreadPool::GetDefault());
+
+			m_SHProjectionBenchmarks.clear();
+			for (UINT faceSize = 512; faceSize <= 2048; faceSize *= 2)
+			{
+				m_SHProjectionBenchmarks.push_back(projector.Benchmark(faceSize, 2));
+				LOG_INFO("SH projection benchmark:\n{}", m_SHProjectionBenchmarks.back().Format());
+			}
+		}
+		for (const SHProjector::BenchmarkResult& benchmark : m_SHProjectionBenchmarks)
+		{
+			ImGui::Text("%s", benchmark.Format().c_str());
+		}
 	}
 
-	for (size_t i = 0; i < m_PointLightsStaging.size(); i++)
+	if (ImGui::TreeNode("Point Lights"))
 	{
-		auto& light = m_PointLightsStaging.at(i);
+		int lightCount = static_cast<int>(m_PointLightCount);
+		if (ImGui::SliderInt("Light Count", &lightCount, 0, static_cast<int>(s_MaxLights)))
+		{
+			m_PointLightCount = static_cast<UINT>(lightCount);
+		}
 
-		ImGui::Text("Light %d", i);
+		ImGui::DragFloat("Scatter Radius", &m_ScatterRadius, 0.1f, 0.0f, 1000.0f);
+		ImGui::DragFloat("Scatter Height", &m_ScatterHeight, 0.1f, 0.0f, 1000.0f);
+		if (ImGui::Button("Scatter Lights"))
+		{
+			ScatterPointLights();
+		}
+
+		if (m_PointLightCount > 0)
+		{
+			m_SelectedLight = min(m_SelectedLight, static_cast<int>(m_PointLightCount) - 1);
+			ImGui::SliderInt("Selected Light", &m_SelectedLight, 0, static_cast<int>(m_PointLightCount) - 1);
+
+			auto& light = m_PointLightsStaging.at(m_SelectedLight);
+
+			ImGui::DragFloat3("Position", &light.Position.x, 0.01f);
+			ImGui::ColorEdit3("Color", &light.Color.x);
+			if (ImGui::DragFloat("Intensity", &light.Intensity, 0.01f))
+			{
+				light.Intensity = max(0.0f, light.Intensity);
+			}
+			if (ImGui::DragFloat("Range", &light.Range, 0.01f))
+			{
+				light.Range = max(0.0f, light.Range);
+			}
+		}
+
+		// Cluster statistics
+		const XMUINT3& gridDimensions = m_LightCuller.GetGridDimensions();
+		const auto& clusterLightRanges = m_LightCuller.GetClusterLightRanges();
 
-		ImGui::DragFloat3("Position", &light.Position.x, 0.01f);
-		ImGui::ColorEdit3("Color", &light.Color.x);
-		if (ImGui::DragFloat("Intensity", &light.Intensity, 0.01f))
+		UINT maxClusterLights = 0;
+		for (const auto& range : clusterLightRanges)
 		{
-			light.Intensity = max(0.0f, light.Intensity);
+			maxClusterLights = max(maxClusterLights, range.y);
 		}
-		if (ImGui::DragFloat("Range", &light.Range, 0.01f))
+
+		const UINT indexCount = static_cast<UINT>(m_LightCuller.GetLightIndices().size());
+		ImGui::Text("Clusters: %u x %u x %u", gridDimensions.x, gridDimensions.y, gridDimensions.z);
+		ImGui::Text("Cluster light indices: %u / %u", indexCount, s_MaxClusterLightIndices);
+		ImGui::Text("Max lights in a cluster: %u", maxClusterLights);
+		if (indexCount > s_MaxClusterLightIndices)
 		{
-			light.Range = max(0.0f, light.Range);
+			ImGui::Text("Cluster light lists are being truncated!");
 		}
+
+		ImGui::TreePop();
 	}
 
 	/*
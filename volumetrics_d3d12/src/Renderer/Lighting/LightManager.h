@@ -3,13 +3,18 @@
 #include "Core.h"
 #include "ShadowMap.h"
 #include "HlslCompat/StructureHlslCompat.h"
+#include "HlslCompat/VolumetricsHlslCompat.h"
 #include "Renderer/D3DPipeline.h"
 
-#include "Renderer/Buffer/UploadBuffer.h"
 #include "Renderer/Memory/MemoryAllocator.h"
 #include "ExponentialShadowMap.h"
+#include "ShadowCascades.h"
+#include "ClusteredLightCuller.h"
+#include "SHProjector.h"
+#include "Framework/Frustum.h"
 
 class IBL;
+class Camera;
 
 using namespace DirectX;
 
@@ -31,7 +36,12 @@ public:
 	DISALLOW_COPY(LightManager);
 	DEFAULT_MOVE(LightManager);
 
-	void UpdateLightingCB(const XMFLOAT3& eyePos);
+	// Fits the sun's shadow cascades to the camera and bins the point lights into its clusters
+	void UpdateLightingCB(Camera& camera);
+
+	// Aligns the light clusters with blocks of froxels in the volumetric lighting volume
+	// Reads the volume's resolution, max distance and slice distribution
+	void SetFroxelGrid(const VolumetricsConstantBuffer& volume);
 
 	ShadowMap& GetSunShadowMap() { return m_SunShadowMap; }
 
@@ -42,12 +52,20 @@ public:
 	D3D12_GPU_DESCRIPTOR_HANDLE GetShadowSampler(ShadowSampler sampler) const { return m_ShadowSamplers.GetGPUHandle(sampler); }
 
 	// Call each frame to move the latest lighting data to the GPU
-	void CopyStagingBuffers() const;
+	void CopyStagingBuffers();
+
+	// Sun shadow cascades
+	inline UINT GetCascadeCount() const { return m_CascadeCount; }
+	inline const ShadowCascade& GetCascade(UINT cascade) const { return m_Cascades.at(cascade); }
+	// The volume of a cascade extended towards the light, as geometry between the light and the near plane can still cast shadows into it
+	Frustum GetCascadeShadowCasterFrustum(UINT cascade) const;
 
-	D3D12_GPU_VIRTUAL_ADDRESS GetLightingConstantBuffer() const;
-	D3D12_GPU_VIRTUAL_ADDRESS GetPointLightBuffer() const;
+	inline D3D12_GPU_VIRTUAL_ADDRESS GetLightingConstantBuffer() const { return m_LightingCBAddress; }
+	inline D3D12_GPU_VIRTUAL_ADDRESS GetPointLightBuffer() const { return m_PointLightsAddress; }
+	inline D3D12_GPU_VIRTUAL_ADDRESS GetClusterLightGridBuffer() const { return m_ClusterLightGridAddress; }
+	inline D3D12_GPU_VIRTUAL_ADDRESS GetClusterLightIndexBuffer() const { return m_ClusterLightIndicesAddress; }
 
-	inline UINT GetLightCount() const { return s_MaxLights; }
+	inline UINT GetLightCount() const { return m_PointLightCount; }
 
 	IBL* GetIBL() const { return m_IBL.get(); }
 
@@ -55,25 +73,59 @@ public:
 
 
 private:
-	inline static constexpr size_t s_MaxLights = 1;
+	void UpdateLightClusters(Camera& camera);
+
+	// Places the point lights at random within a region around the origin
+	void ScatterPointLights();
+
+private:
+	inline static constexpr UINT s_MaxLights = 8192;
+
+	// Each cluster covers a block of s_ClusterFroxelsXY * s_ClusterFroxelsXY * s_ClusterFroxelSlices froxels
+	inline static constexpr UINT s_ClusterFroxelsXY = 32;
+	inline static constexpr UINT s_ClusterFroxelSlices = 4;
+	// Limit on the combined length of the per-cluster light lists uploaded each frame
+	inline static constexpr UINT s_MaxClusterLightIndices = 256 * 1024;
 
 	LightingConstantBuffer m_LightingCBStaging;
-	std::array<PointLightGPUData, s_MaxLights> m_PointLightsStaging;
+	std::vector<PointLightGPUData> m_PointLightsStaging;
+	UINT m_PointLightCount = 1;
+
+	// Point light clustering
+	XMUINT3 m_FroxelGridResolution = { 512, 288, 128 };
+	float m_MaxVolumeDistance = 50.0f;
+	UINT m_FroxelDepthDistribution = VOLUME_DEPTH_DISTRIBUTION_LINEAR;
+	float m_FroxelHybridLinearDepth = 10.0f;
 
-	XMMATRIX m_ShadowCameraProjectionMatrix;
-	ShadowMap m_SunShadowMap;	// Shadow map for the directional light
+	std::vector<float> m_ClusterSliceDepths;
+	ClusteredLightCuller m_LightCuller;
+
+	// Sky SH projection benchmarks, one for each face size
+	std::vector<SHProjector::BenchmarkResult> m_SHProjectionBenchmarks;
+
+	// Point light GUI
+	int m_SelectedLight = 0;
+	float m_ScatterRadius = 20.0f;
+	float m_ScatterHeight = 5.0f;
+
+	ShadowMap m_SunShadowMap;	// Shadow map for the directional light, with one array slice per cascade
+
+	// Cascaded shadow map settings
+	UINT m_CascadeCount = MAX_SHADOW_CASCADES;
+	float m_CascadeSplitLambda = 0.75f;	// Blends between uniform (0) and logarithmic (1) splits
+	float m_ShadowDistance = 100.0f;	// Shadows are only rendered up to this view-space depth
+
+	std::array<ShadowCascade, MAX_SHADOW_CASCADES> m_Cascades;
 
 	ExponentialShadowMap m_SunESM;
 	bool m_UseESM;
 
 	// Light GPU Resources
-	// This is a buffered resource so that light data can be modified between frames
-	struct LightingGPUResourcesPerFrame
-	{
-		UploadBuffer<LightingConstantBuffer> LightingCB;
-		UploadBuffer<PointLightGPUData> PointLights;
-	};
-	std::vector<LightingGPUResourcesPerFrame> m_LightingResources;
+	// These are re-allocated from the frame's upload memory each frame so that light data can be modified between frames
+	D3D12_GPU_VIRTUAL_ADDRESS m_LightingCBAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_PointLightsAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_ClusterLightGridAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_ClusterLightIndicesAddress = 0;
 
 	DescriptorAllocation m_ShadowSamplers;
 
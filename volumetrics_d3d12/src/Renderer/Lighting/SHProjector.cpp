@@ -0,0 +1,447 @@
+#include "pch.h"
+#include "SHProjector.h"
+
+#include "Framework/ThreadPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <immintrin.h>
+
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	inline double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+
+	// The direction through a point (u, v) in [-1, 1] of a face is normal + u * tangent + v * bitangent,
+	// as with the faces that IBL processes
+	constexpr float c_FaceNormals[6][3] = {
+		{ 1.0f, 0.0f, 0.0f },
+		{ -1.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f },
+		{ 0.0f, -1.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f },
+		{ 0.0f, 0.0f, -1.0f }
+	};
+	constexpr float c_FaceTangents[6][3] = {
+		{ 0.0f, 0.0f, -1.0f },
+		{ 0.0f, 0.0f, 1.0f },
+		{ 1.0f, 0.0f, 0.0f },
+		{ 1.0f, 0.0f, 0.0f },
+		{ 1.0f, 0.0f, 0.0f },
+		{ -1.0f, 0.0f, 0.0f }
+	};
+	constexpr float c_FaceBitangents[6][3] = {
+		{ 0.0f, -1.0f, 0.0f },
+		{ 0.0f, -1.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f },
+		{ 0.0f, 0.0f, -1.0f },
+		{ 0.0f, -1.0f, 0.0f },
+		{ 0.0f, -1.0f, 0.0f }
+	};
+
+	// Basis constants of bands 0 to 2
+	constexpr float c_SH0 = 0.282094792f;
+	constexpr float c_SH1 = 0.488602512f;
+	constexpr float c_SH2 = 1.092548431f;
+	constexpr float c_SH3 = 0.946174696f;
+	constexpr float c_SH4 = 0.315391565f;
+	constexpr float c_SH5 = 0.546274215f;
+
+	// Sums of each row: the weighted RGB of every coefficient, then the weight
+	constexpr UINT c_RowSumCount = 3 * SHProjector::s_CoefficientCount + 1;
+
+	// Centre of texel i of a face, in [-1, 1]
+	inline float GetTexelCoordinate(UINT i, float invFaceSize)
+	{
+		return static_cast<float>(2 * i + 1) * invFaceSize - 1.0f;
+	}
+
+	inline const UINT8* GetRow(const SHProjector::Cubemap& cubemap, UINT face, UINT y)
+	{
+		return static_cast<const UINT8*>(cubemap.Data) + face * cubemap.FacePitch + y * cubemap.RowPitch;
+	}
+
+	inline void ReadTexel(const SHProjector::Cubemap& cubemap, const UINT8* row, UINT x, float* rgb)
+	{
+		const UINT8* texel = row + static_cast<size_t>(x) * cubemap.Channels * cubemap.BytesPerChannel;
+		if (cubemap.BytesPerChannel == 1)
+		{
+			for (UINT c = 0; c < 3; c++)
+			{
+				rgb[c] = static_cast<float>(texel[c]) * (1.0f / 255.0f);
+			}
+		}
+		else
+		{
+			memcpy(rgb, texel, 3 * sizeof(float));
+		}
+	}
+
+	inline void AccumulateTexel(const XMFLOAT3& direction, float weight, const float* rgb, double* sums)
+	{
+		float basis[SHProjector::s_CoefficientCount];
+		SHProjector::EvaluateBasis(direction, basis);
+
+		for (UINT i = 0; i < SHProjector::s_CoefficientCount; i++)
+		{
+			for (UINT c = 0; c < 3; c++)
+			{
+				sums[3 * i + c] += static_cast<double>(basis[i] * rgb[c] * weight);
+			}
+		}
+		sums[c_RowSumCount - 1] += static_cast<double>(weight);
+	}
+
+
+	// Loaders of 4 consecutive texels of a row as RGB
+
+	struct LoadUNORM8RGBA
+	{
+		inline void operator()(const UINT8* row, UINT x, __m128& r, __m128& g, __m128& b) const
+		{
+			const __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 4 * static_cast<size_t>(x)));
+			const __m128i mask = _mm_set1_epi32(0xFF);
+			const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+			r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(texels, mask)), scale);
+			g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 8), mask)), scale);
+			b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, 16), mask)), scale);
+		}
+	};
+
+	struct LoadFloatRGBA
+	{
+		inline void operator()(const UINT8* row, UINT x, __m128& r, __m128& g, __m128& b) const
+		{
+			const float* texels = reinterpret_cast<const float*>(row) + 4 * static_cast<size_t>(x);
+			__m128 t0 = _mm_loadu_ps(texels);
+			__m128 t1 = _mm_loadu_ps(texels + 4);
+			__m128 t2 = _mm_loadu_ps(texels + 8);
+			__m128 t3 = _mm_loadu_ps(texels + 12);
+			_MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+
+			r = t0;
+			g = t1;
+			b = t2;
+		}
+	};
+
+	// Any other layout is read a texel at a time
+	struct LoadAnyTexels
+	{
+		const SHProjector::Cubemap* Cubemap;
+
+		inline void operator()(const UINT8* row, UINT x, __m128& r, __m128& g, __m128& b) const
+		{
+			alignas(16) float rgb[3][4];
+			for (UINT i = 0; i < 4; i++)
+			{
+				float texel[3];
+				ReadTexel(*Cubemap, row, x + i, texel);
+				rgb[0][i] = texel[0];
+				rgb[1][i] = texel[1];
+				rgb[2][i] = texel[2];
+			}
+
+			r = _mm_load_ps(rgb[0]);
+			g = _mm_load_ps(rgb[1]);
+			b = _mm_load_ps(rgb[2]);
+		}
+	};
+
+	inline double HorizontalSum(__m128 v)
+	{
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, v);
+		return (static_cast<double>(lanes[0]) + lanes[1]) + (static_cast<double>(lanes[2]) + lanes[3]);
+	}
+
+	// Accumulates a row of a face into c_RowSumCount sums, 4 texels at a time
+	// The texels past the last multiple of 4 are accumulated with the scalar projection
+	template<typename LoadTexels>
+	void AccumulateRow(const SHProjector::Cubemap& cubemap, UINT face, UINT y, const LoadTexels& load, double* sums)
+	{
+		const UINT faceSize = cubemap.FaceSize;
+		const float invFaceSize = 1.0f / static_cast<float>(faceSize);
+		const float v = GetTexelCoordinate(y, invFaceSize);
+		const UINT8* row = GetRow(cubemap, face, y);
+
+		// The part of the direction that is constant along the row
+		const __m128 rowX = _mm_set1_ps(c_FaceNormals[face][0] + v * c_FaceBitangents[face][0]);
+		const __m128 rowY = _mm_set1_ps(c_FaceNormals[face][1] + v * c_FaceBitangents[face][1]);
+		const __m128 rowZ = _mm_set1_ps(c_FaceNormals[face][2] + v * c_FaceBitangents[face][2]);
+		const __m128 tangentX = _mm_set1_ps(c_FaceTangents[face][0]);
+		const __m128 tangentY = _mm_set1_ps(c_FaceTangents[face][1]);
+		const __m128 tangentZ = _mm_set1_ps(c_FaceTangents[face][2]);
+
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 rowRadius = _mm_set1_ps(1.0f + v * v);
+		const __m128 laneOffsets = _mm_setr_ps(0.0f, 2.0f, 4.0f, 6.0f);
+		const __m128 vInvFaceSize = _mm_set1_ps(invFaceSize);
+
+		__m128 accumulators[c_RowSumCount];
+		for (__m128& accumulator : accumulators)
+		{
+			accumulator = _mm_setzero_ps();
+		}
+
+		UINT x = 0;
+		for (; x + 4 <= faceSize; x += 4)
+		{
+			const __m128 u = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(2 * x + 1)), laneOffsets), vInvFaceSize), one);
+
+			// The differential solid angle of a texel at distance r from the centre of the cube is proportional to 1 / r^3
+			const __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(rowRadius, _mm_mul_ps(u, u))));
+			const __m128 weight = _mm_mul_ps(_mm_mul_ps(invLength, invLength), invLength);
+
+			const __m128 dx = _mm_mul_ps(_mm_add_ps(rowX, _mm_mul_ps(u, tangentX)), invLength);
+			const __m128 dy = _mm_mul_ps(_mm_add_ps(rowY, _mm_mul_ps(u, tangentY)), invLength);
+			const __m128 dz = _mm_mul_ps(_mm_add_ps(rowZ, _mm_mul_ps(u, tangentZ)), invLength);
+
+			__m128 r, g, b;
+			load(row, x, r, g, b);
+			r = _mm_mul_ps(r, weight);
+			g = _mm_mul_ps(g, weight);
+			b = _mm_mul_ps(b, weight);
+
+			// EvaluateBasis
+			const __m128 basis[SHProjector::s_CoefficientCount] = {
+				_mm_set1_ps(c_SH0),
+				_mm_mul_ps(_mm_set1_ps(-c_SH1), dy),
+				_mm_mul_ps(_mm_set1_ps(c_SH1), dz),
+				_mm_mul_ps(_mm_set1_ps(-c_SH1), dx),
+				_mm_mul_ps(_mm_set1_ps(c_SH2), _mm_mul_ps(dx, dy)),
+				_mm_mul_ps(_mm_set1_ps(-c_SH2), _mm_mul_ps(dy, dz)),
+				_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(c_SH3), _mm_mul_ps(dz, dz)), _mm_set1_ps(c_SH4)),
+				_mm_mul_ps(_mm_set1_ps(-c_SH2), _mm_mul_ps(dx, dz)),
+				_mm_mul_ps(_mm_set1_ps(c_SH5), _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)))
+			};
+
+			for (UINT i = 0; i < SHProjector::s_CoefficientCount; i++)
+			{
+				accumulators[3 * i + 0] = _mm_add_ps(accumulators[3 * i + 0], _mm_mul_ps(basis[i], r));
+				accumulators[3 * i + 1] = _mm_add_ps(accumulators[3 * i + 1], _mm_mul_ps(basis[i], g));
+				accumulators[3 * i + 2] = _mm_add_ps(accumulators[3 * i + 2], _mm_mul_ps(basis[i], b));
+			}
+			accumulators[c_RowSumCount - 1] = _mm_add_ps(accumulators[c_RowSumCount - 1], weight);
+		}
+
+		for (UINT i = 0; i < c_RowSumCount; i++)
+		{
+			sums[i] = HorizontalSum(accumulators[i]);
+		}
+
+		for (; x < faceSize; x++)
+		{
+			float rgb[3];
+			ReadTexel(cubemap, row, x, rgb);
+			AccumulateTexel(SHProjector::GetTexelDirection(face, x, y, faceSize), SHProjector::GetTexelWeight(x, y, faceSize), rgb, sums);
+		}
+	}
+
+	// Scales the sums so that the weights cover the 4 pi steradians of the sphere
+	void NormaliseSums(const double* sums, SHProjector::Coefficients& coefficients)
+	{
+		const double weight = sums[c_RowSumCount - 1];
+		const double scale = weight > 0.0 ? 4.0 * XM_PI / weight : 0.0;
+
+		for (UINT i = 0; i < SHProjector::s_CoefficientCount; i++)
+		{
+			coefficients.R[i] = static_cast<float>(sums[3 * i + 0] * scale);
+			coefficients.G[i] = static_cast<float>(sums[3 * i + 1] * scale);
+			coefficients.B[i] = static_cast<float>(sums[3 * i + 2] * scale);
+		}
+	}
+}
+
+
+SHProjector::SHProjector(ThreadPool& threadPool)
+	: m_ThreadPool(&threadPool)
+{
+}
+
+
+void SHProjector::Project(const Cubemap& cubemap, Coefficients& coefficients) const
+{
+	ProjectRows(cubemap, coefficients, *m_ThreadPool);
+}
+
+void SHProjector::ProjectRows(const Cubemap& cubemap, Coefficients& coefficients, ThreadPool& threadPool)
+{
+	ASSERT(cubemap.Data && cubemap.FaceSize > 0, "Empty cubemap");
+	ASSERT(cubemap.Channels >= 3, "The cubemap must have RGB channels");
+	ASSERT(cubemap.BytesPerChannel == 1 || cubemap.BytesPerChannel == 4, "Only UNORM8 and 32-bit float cubemaps can be projected");
+
+	const UINT faceSize = cubemap.FaceSize;
+	const UINT rowCount = 6 * faceSize;
+	std::vector<double> rowSums(static_cast<size_t>(rowCount) * c_RowSumCount);
+
+	threadPool.ParallelFor(rowCount, 8, [&](UINT begin, UINT end)
+		{
+			for (UINT row = begin; row < end; row++)
+			{
+				const UINT face = row / faceSize;
+				const UINT y = row % faceSize;
+				double* sums = &rowSums[static_cast<size_t>(row) * c_RowSumCount];
+
+				if (cubemap.Channels == 4 && cubemap.BytesPerChannel == 1)
+					AccumulateRow(cubemap, face, y, LoadUNORM8RGBA(), sums);
+				else if (cubemap.Channels == 4 && cubemap.BytesPerChannel == 4)
+					AccumulateRow(cubemap, face, y, LoadFloatRGBA(), sums);
+				else
+					AccumulateRow(cubemap, face, y, LoadAnyTexels{ &cubemap }, sums);
+			}
+		});
+
+	// Rows are combined in order, so that the result is the same for any number of threads
+	double sums[c_RowSumCount] = {};
+	for (UINT row = 0; row < rowCount; row++)
+	{
+		const double* rowSum = &rowSums[static_cast<size_t>(row) * c_RowSumCount];
+		for (UINT i = 0; i < c_RowSumCount; i++)
+		{
+			sums[i] += rowSum[i];
+		}
+	}
+
+	NormaliseSums(sums, coefficients);
+}
+
+void SHProjector::ProjectScalar(const Cubemap& cubemap, Coefficients& coefficients)
+{
+	ASSERT(cubemap.Data && cubemap.FaceSize > 0, "Empty cubemap");
+	ASSERT(cubemap.Channels >= 3, "The cubemap must have RGB channels");
+	ASSERT(cubemap.BytesPerChannel == 1 || cubemap.BytesPerChannel == 4, "Only UNORM8 and 32-bit float cubemaps can be projected");
+
+	double sums[c_RowSumCount] = {};
+	for (UINT face = 0; face < 6; face++)
+	{
+		for (UINT y = 0; y < cubemap.FaceSize; y++)
+		{
+			const UINT8* row = GetRow(cubemap, face, y);
+			for (UINT x = 0; x < cubemap.FaceSize; x++)
+			{
+				float rgb[3];
+				ReadTexel(cubemap, row, x, rgb);
+				AccumulateTexel(GetTexelDirection(face, x, y, cubemap.FaceSize), GetTexelWeight(x, y, cubemap.FaceSize), rgb, sums);
+			}
+		}
+	}
+
+	NormaliseSums(sums, coefficients);
+}
+
+
+XMFLOAT3 SHProjector::GetTexelDirection(UINT face, UINT x, UINT y, UINT faceSize)
+{
+	const float invFaceSize = 1.0f / static_cast<float>(faceSize);
+	const float u = GetTexelCoordinate(x, invFaceSize);
+	const float v = GetTexelCoordinate(y, invFaceSize);
+
+	const float invLength = 1.0f / sqrtf(1.0f + u * u + v * v);
+	return {
+		(c_FaceNormals[face][0] + u * c_FaceTangents[face][0] + v * c_FaceBitangents[face][0]) * invLength,
+		(c_FaceNormals[face][1] + u * c_FaceTangents[face][1] + v * c_FaceBitangents[face][1]) * invLength,
+		(c_FaceNormals[face][2] + u * c_FaceTangents[face][2] + v * c_FaceBitangents[face][2]) * invLength
+	};
+}
+
+float SHProjector::GetTexelWeight(UINT x, UINT y, UINT faceSize)
+{
+	const float invFaceSize = 1.0f / static_cast<float>(faceSize);
+	const float u = GetTexelCoordinate(x, invFaceSize);
+	const float v = GetTexelCoordinate(y, invFaceSize);
+
+	const float invLength = 1.0f / sqrtf(1.0f + u * u + v * v);
+	return invLength * invLength * invLength;
+}
+
+void SHProjector::EvaluateBasis(const XMFLOAT3& direction, float* basis)
+{
+	const float x = direction.x;
+	const float y = direction.y;
+	const float z = direction.z;
+
+	basis[0] = c_SH0;
+	basis[1] = -c_SH1 * y;
+	basis[2] = c_SH1 * z;
+	basis[3] = -c_SH1 * x;
+	basis[4] = c_SH2 * x * y;
+	basis[5] = -c_SH2 * y * z;
+	basis[6] = c_SH3 * z * z - c_SH4;
+	basis[7] = -c_SH2 * x * z;
+	basis[8] = c_SH5 * (x * x - y * y);
+}
+
+
+SHProjector::BenchmarkResult SHProjector::Benchmark(UINT faceSize, UINT iterations) const
+{
+	ASSERT(faceSize > 0 && iterations > 0, "Nothing to benchmark");
+
+	// Noise in faces laid out in one row, as the TextureLoader loads them
+	std::vector<UINT> texels(6 * static_cast<size_t>(faceSize) * faceSize);
+	UINT state = 0x9e3779b9u;
+	for (UINT& texel : texels)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		texel = state;
+	}
+
+	Cubemap cubemap;
+	cubemap.Data = texels.data();
+	cubemap.FaceSize = faceSize;
+	cubemap.Channels = 4;
+	cubemap.BytesPerChannel = 1;
+	cubemap.RowPitch = 6 * static_cast<size_t>(faceSize) * 4;
+	cubemap.FacePitch = static_cast<size_t>(faceSize) * 4;
+
+	BenchmarkResult result;
+	result.FaceSize = faceSize;
+	result.Texels = texels.size() * iterations;
+	result.ThreadCount = m_ThreadPool->GetThreadCount();
+
+	Coefficients coefficients;
+	auto TexelsPerSecond = [&](auto&& project)
+		{
+			const auto start = Clock::now();
+			for (UINT i = 0; i < iterations; i++)
+			{
+				project();
+			}
+			return static_cast<double>(result.Texels) * 1000.0 / max(MillisecondsSince(start), 1e-3);
+		};
+
+	// A pool without workers runs every row on the calling thread
+	ThreadPool singleThread(0);
+
+	result.TexelsPerSecond = TexelsPerSecond([&]() { ProjectRows(cubemap, coefficients, *m_ThreadPool); });
+	result.SingleThreadTexelsPerSecond = TexelsPerSecond([&]() { ProjectRows(cubemap, coefficients, singleThread); });
+	result.ScalarTexelsPerSecond = TexelsPerSecond([&]() { ProjectScalar(cubemap, coefficients); });
+
+	return result;
+}
+
+std::string SHProjector::BenchmarkResult::Format() const
+{
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer),
+		"%u^2 faces, %llu texels, %u threads\n"
+		"  Threaded SSE2  %8.2f Mtexels/s\n"
+		"  Single SSE2    %8.2f Mtexels/s\n"
+		"  Single scalar  %8.2f Mtexels/s",
+		FaceSize, static_cast<unsigned long long>(Texels), ThreadCount,
+		TexelsPerSecond * 1.0e-6,
+		SingleThreadTexelsPerSecond * 1.0e-6,
+		ScalarTexelsPerSecond * 1.0e-6);
+
+	return buffer;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Core.h"
+
+#include <string>
+
+class ThreadPool;
+
+using namespace DirectX;
+
+
+/**
+ *	Projects a cubemap onto the first three bands (L2) of the real spherical harmonics on the CPU,
+ *	so that the sky lighting can be computed from the decoded environment map while it is still in memory,
+ *	rather than by reading a texture back from the GPU.
+ *
+ *	Each texel is weighted by the solid angle that it subtends, and the weights are normalised to sum to 4 pi.
+ *	The faces, texel directions and basis follow the D3D cubemap layout and the sign conventions of DirectXMath's XMSHEvalDirection,
+ *	which IBL::PopulateSkyIrradianceSHConstants packs for the shaders.
+ *
+ *	Rows of every face are split across a ThreadPool, and each row is accumulated 4 texels at a time with SSE2.
+ *	Each row is summed on its own and the rows are combined in order, so the result does not depend on the number of threads.
+ *	The projector has no knowledge of D3D, so that it can be tested and benchmarked on its own.
+ */
+class SHProjector
+{
+public:
+	inline static constexpr UINT s_CoefficientCount = 9;
+
+	// Coefficients of each colour channel
+	struct Coefficients
+	{
+		std::array<float, s_CoefficientCount> R = {};
+		std::array<float, s_CoefficientCount> G = {};
+		std::array<float, s_CoefficientCount> B = {};
+	};
+
+	// Six square faces in memory, in the order +X, -X, +Y, -Y, +Z, -Z
+	struct Cubemap
+	{
+		const void* Data = nullptr;
+		UINT FaceSize = 0;
+		// At least 3, of which the first three are RGB
+		UINT Channels = 4;
+		// 1 for UNORM8 or 4 for 32-bit floats
+		UINT BytesPerChannel = 1;
+		// Bytes between the rows of a face, and between the first texels of consecutive faces
+		// Faces laid out in one row, as they are loaded by the TextureLoader, have a row pitch of 6 faces and a face pitch of one face
+		size_t RowPitch = 0;
+		size_t FacePitch = 0;
+	};
+
+	struct BenchmarkResult
+	{
+		UINT FaceSize = 0;
+		UINT64 Texels = 0;
+		UINT ThreadCount = 0;
+
+		// Texels projected per second, with the whole pool, on a single thread, and on a single thread without SSE
+		double TexelsPerSecond = 0.0;
+		double SingleThreadTexelsPerSecond = 0.0;
+		double ScalarTexelsPerSecond = 0.0;
+
+		std::string Format() const;
+	};
+
+public:
+	SHProjector(ThreadPool& threadPool);
+	~SHProjector() = default;
+
+	DISALLOW_COPY(SHProjector)
+	DEFAULT_MOVE(SHProjector)
+
+	void Project(const Cubemap& cubemap, Coefficients& coefficients) const;
+
+	// Projects UNORM8 RGBA faces of each size iterations times with the pool, on a single thread and with the scalar projection,
+	// and measures the throughput of each
+	BenchmarkResult Benchmark(UINT faceSize, UINT iterations) const;
+
+	// The projection evaluated one texel at a time without SSE
+	// This is the definition that the vectorised projection follows
+	static void ProjectScalar(const Cubemap& cubemap, Coefficients& coefficients);
+
+	// The unit direction through the centre of a texel
+	static XMFLOAT3 GetTexelDirection(UINT face, UINT x, UINT y, UINT faceSize);
+	// The solid angle of a texel, up to a constant factor that the normalisation removes
+	static float GetTexelWeight(UINT x, UINT y, UINT faceSize);
+	static void EvaluateBasis(const XMFLOAT3& direction, float* basis);
+
+private:
+	static void ProjectRows(const Cubemap& cubemap, Coefficients& coefficients, ThreadPool& threadPool);
+
+private:
+	ThreadPool* m_ThreadPool;
+};
@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "ShadowCascades.h"
+
+
+void ShadowCascades::ComputeSplits(float nearPlane, float farPlane, float lambda, UINT cascadeCount, float* outSplitFar)
+{
+	ASSERT(nearPlane > 0.0f && farPlane > nearPlane, "Invalid depth range");
+
+	// From "Parallel-Split Shadow Maps on Programmable GPUs" (Zhang et al.)
+	for (UINT i = 1; i <= cascadeCount; i++)
+	{
+		const float t = static_cast<float>(i) / static_cast<float>(cascadeCount);
+
+		const float logSplit = nearPlane * powf(farPlane / nearPlane, t);
+		const float linearSplit = nearPlane + (farPlane - nearPlane) * t;
+
+		outSplitFar[i - 1] = lambda * logSplit + (1.0f - lambda) * linearSplit;
+	}
+
+	// Avoid any rounding leaving a gap at the end of the range
+	if (cascadeCount > 0)
+		outSplitFar[cascadeCount - 1] = farPlane;
+}
+
+
+XMMATRIX ShadowCascades::ComputeLightView(FXMVECTOR lightDirection)
+{
+	const XMVECTOR forward = XMVector3Normalize(lightDirection);
+
+	// Pick an up vector that is not parallel to the light
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	if (fabsf(XMVectorGetY(forward)) > 0.99f)
+		up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+
+	// Translation is left at the origin, so that texel snapping in light space is relative to a fixed grid
+	return XMMatrixLookToLH(XMVectorZero(), forward, up);
+}
+
+
+std::array<XMVECTOR, 8> ShadowCascades::ComputeFrustumSliceCorners(const XMMATRIX& cameraInvProjection, float cameraNear, float cameraFar, float splitNear, float splitFar)
+{
+	// View-space depth varies linearly along each edge of the frustum, for both perspective and orthographic projections
+	const float tNear = (splitNear - cameraNear) / (cameraFar - cameraNear);
+	const float tFar = (splitFar - cameraNear) / (cameraFar - cameraNear);
+
+	std::array<XMVECTOR, 8> corners;
+	UINT i = 0;
+	for (float y : { -1.0f, 1.0f })
+	{
+		for (float x : { -1.0f, 1.0f })
+		{
+			const XMVECTOR nearCorner = XMVector3TransformCoord(XMVectorSet(x, y, 0.0f, 1.0f), cameraInvProjection);
+			const XMVECTOR farCorner = XMVector3TransformCoord(XMVectorSet(x, y, 1.0f, 1.0f), cameraInvProjection);
+
+			corners[i++] = XMVectorLerp(nearCorner, farCorner, tNear);
+			corners[i++] = XMVectorLerp(nearCorner, farCorner, tFar);
+		}
+	}
+	return corners;
+}
+
+
+ShadowCascade ShadowCascades::FitCascade(const XMMATRIX& cameraInvView, const XMMATRIX& cameraInvProjection, float cameraNear, float cameraFar, float splitNear, float splitFar, FXMVECTOR lightDirection, UINT shadowMapResolution)
+{
+	ASSERT(shadowMapResolution > 2, "Invalid shadow map resolution");
+
+	const auto corners = ComputeFrustumSliceCorners(cameraInvProjection, cameraNear, cameraFar, splitNear, splitFar);
+
+	// Bounding sphere of the slice
+	// This is found in view space so that the radius stays exactly the same as the camera moves and rotates
+	XMVECTOR center = XMVectorZero();
+	for (const XMVECTOR& corner : corners)
+		center += corner;
+	center /= static_cast<float>(corners.size());
+
+	float radius = 0.0f;
+	for (const XMVECTOR& corner : corners)
+		radius = max(radius, XMVectorGetX(XMVector3Length(corner - center)));
+
+	// Remove floating point noise from the radius, which would otherwise change the texel size from frame to frame
+	radius = ceilf(radius * 16.0f) / 16.0f;
+
+	// Snapping can move the center by up to a texel, so grow the projection by a texel on each side to keep the sphere covered
+	const float resolution = static_cast<float>(shadowMapResolution);
+	const float halfExtent = radius * resolution / (resolution - 2.0f);
+	const float texelSize = 2.0f * halfExtent / resolution;
+
+	const XMMATRIX lightView = ComputeLightView(lightDirection);
+	const XMVECTOR centerWS = XMVector3TransformCoord(center, cameraInvView);
+	const XMVECTOR centerLS = XMVector3TransformCoord(centerWS, lightView);
+
+	// Snap to the texel grid in the light's view plane
+	const float snappedX = floorf(XMVectorGetX(centerLS) / texelSize) * texelSize;
+	const float snappedY = floorf(XMVectorGetY(centerLS) / texelSize) * texelSize;
+	const float centerZ = XMVectorGetZ(centerLS);
+
+	// Casters in front of the near plane are clamped onto it when rendering, so depth only needs to cover the sphere
+	const XMMATRIX projection = XMMatrixOrthographicOffCenterLH(
+		snappedX - halfExtent, snappedX + halfExtent,
+		snappedY - halfExtent, snappedY + halfExtent,
+		centerZ - radius, centerZ + radius);
+
+	return ShadowCascade{
+		.ViewProjection = XMMatrixMultiply(lightView, projection),
+		.SplitNear = splitNear,
+		.SplitFar = splitFar,
+		.TexelSize = texelSize
+	};
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Core.h"
+
+using namespace DirectX;
+
+
+// A single cascade of a directional light's cascaded shadow map
+struct ShadowCascade
+{
+	XMMATRIX ViewProjection;
+
+	// The range of camera view-space depth that this cascade covers
+	float SplitNear;
+	float SplitFar;
+
+	// World-space size of one shadow map texel
+	float TexelSize;
+};
+
+
+/**
+ *	CPU-side math for cascaded shadow maps.
+ *
+ *	The camera depth range is divided into cascades, and each cascade is covered by an orthographic
+ *	projection along the light direction. Each projection is fitted to the bounding sphere of its slice
+ *	of the camera frustum, which does not change size as the camera rotates, and its origin is snapped
+ *	to whole shadow map texels so that the rasterized shadows do not shimmer as the camera moves.
+ *
+ *	None of this depends on D3D, so it can be used and tested in isolation.
+ */
+namespace ShadowCascades
+{
+	// Distributes the far distance of each of the cascadeCount cascades over [nearPlane, farPlane]
+	// lambda blends between uniform (0) and logarithmic (1) split distributions
+	void ComputeSplits(float nearPlane, float farPlane, float lambda, UINT cascadeCount, float* outSplitFar);
+
+	// A view matrix looking along the light direction, with a fixed orientation for a given direction
+	XMMATRIX ComputeLightView(FXMVECTOR lightDirection);
+
+	// The view-space corners of the camera frustum between view-space depths splitNear and splitFar
+	// cameraNear and cameraFar are the depths of the camera's own near and far planes
+	std::array<XMVECTOR, 8> ComputeFrustumSliceCorners(const XMMATRIX& cameraInvProjection, float cameraNear, float cameraFar, float splitNear, float splitFar);
+
+	// Fits a stable, texel-snapped orthographic projection around the given slice of the camera frustum
+	// The bounding sphere is found in view space, so its radius only depends on the projection and not on the camera's placement
+	ShadowCascade FitCascade(const XMMATRIX& cameraInvView, const XMMATRIX& cameraInvProjection, float cameraNear, float cameraFar, float splitNear, float splitFar, FXMVECTOR lightDirection, UINT shadowMapResolution);
+}
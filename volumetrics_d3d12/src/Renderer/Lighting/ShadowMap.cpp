@@ -19,6 +19,7 @@ ShadowMap::~ShadowMap()
 void ShadowMap::CreateShadowMap(UINT width, UINT height, UINT arraySize)
 {
 	m_Dimensions = { width, height };
+	m_ArraySize = arraySize;
 
 	const auto desc = CD3DX12_RESOURCE_DESC::Tex2D(s_DSVFormat, width, height, arraySize, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
 
@@ -30,26 +31,35 @@ void ShadowMap::CreateShadowMap(UINT width, UINT height, UINT arraySize)
 	m_Texture.Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"Shadow Map", &clearValue);
 
 
-	// Create DSV
+	// Create DSVs
 	{
+		m_DSV = g_D3DGraphicsContext->GetDSVHeap()->Allocate(arraySize);
+		ASSERT(m_DSV.IsValid(), "Failed to alloc");
+
 		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc;
 		dsvDesc.Format = s_DSVFormat;
 		dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
 
 		if (arraySize > 1)
 		{
-			// TODO: Need a separate DSV for each array slice
-			NOT_IMPLEMENTED;
+			// A separate DSV for each array slice, so that each can be rendered individually
+			dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+			dsvDesc.Texture2DArray.MipSlice = 0;
+			dsvDesc.Texture2DArray.ArraySize = 1;
+
+			for (UINT slice = 0; slice < arraySize; slice++)
+			{
+				dsvDesc.Texture2DArray.FirstArraySlice = slice;
+				g_D3DGraphicsContext->GetDevice()->CreateDepthStencilView(m_Texture.GetResource(), &dsvDesc, m_DSV.GetCPUHandle(slice));
+			}
 		}
 		else
 		{
 			dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
 			dsvDesc.Texture2D.MipSlice = 0;
-		}
 
-		m_DSV = g_D3DGraphicsContext->GetDSVHeap()->Allocate(1);
-		ASSERT(m_DSV.IsValid(), "Failed to alloc");
-		g_D3DGraphicsContext->GetDevice()->CreateDepthStencilView(m_Texture.GetResource(), &dsvDesc, m_DSV.GetCPUHandle());
+			g_D3DGraphicsContext->GetDevice()->CreateDepthStencilView(m_Texture.GetResource(), &dsvDesc, m_DSV.GetCPUHandle());
+		}
 	}
 
 	// Create SRV
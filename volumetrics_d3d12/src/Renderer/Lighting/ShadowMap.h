@@ -20,9 +20,11 @@ public:
 	void CreateShadowMap(UINT width, UINT height, UINT arraySize = 1);
 
 	inline const XMUINT2& GetDimensions() const { return m_Dimensions; }
+	inline UINT GetArraySize() const { return m_ArraySize; }
 	inline ID3D12Resource* GetResource() const { return m_Texture.GetResource(); }
 
-	inline D3D12_CPU_DESCRIPTOR_HANDLE GetDSV() const { return m_DSV.GetCPUHandle(); }
+	// Each array slice has its own DSV
+	inline D3D12_CPU_DESCRIPTOR_HANDLE GetDSV(UINT arraySlice = 0) const { return m_DSV.GetCPUHandle(arraySlice); }
 	inline D3D12_GPU_DESCRIPTOR_HANDLE GetSRV() const { return m_SRV.GetGPUHandle(); }
 
 	void ApplyViewport(ID3D12GraphicsCommandList* commandList) const;
@@ -32,6 +34,7 @@ public:
 
 private:
 	XMUINT2 m_Dimensions;
+	UINT m_ArraySize = 1;
 	Texture m_Texture;
 
 	static constexpr DXGI_FORMAT s_DSVFormat = DXGI_FORMAT_D32_FLOAT;
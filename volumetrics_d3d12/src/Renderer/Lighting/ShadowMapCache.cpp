@@ -0,0 +1,25 @@
+#include "pch.h"
+#include "ShadowMapCache.h"
+
+
+bool ShadowMapCache::Update(const XMMATRIX& lightViewProjection, const std::vector<UINT>& casters, bool castersDirty)
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, lightViewProjection);
+
+	// The light matrix is rebuilt each frame from the same inputs, so an exact comparison is sufficient
+	const bool lightChanged = memcmp(&viewProjection, &m_LightViewProjection, sizeof(XMFLOAT4X4)) != 0;
+
+	if (m_Enabled && m_Valid && !lightChanged && !castersDirty && casters == m_Casters)
+	{
+		m_SkippedFrames++;
+		return false;
+	}
+
+	m_LightViewProjection = viewProjection;
+	m_Casters = casters;
+	m_Valid = m_Enabled;
+
+	m_RenderedFrames++;
+	return true;
+}
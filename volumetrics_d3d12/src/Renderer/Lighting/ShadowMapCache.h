@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Core.h"
+
+using namespace DirectX;
+
+
+/**
+ *	A ShadowMapCache decides whether a shadow map needs to be re-rendered this frame.
+ *
+ *	The contents of a shadow map only depend on the light's view-projection and on the casters drawn into it,
+ *	so if the matrix is unchanged, the same set of casters is visible, and none of them has moved,
+ *	the previous frame's shadow map can be reused as-is.
+ *
+ *	It only compares CPU state and does not touch any D3D objects.
+ */
+class ShadowMapCache
+{
+public:
+	ShadowMapCache() = default;
+	~ShadowMapCache() = default;
+
+	DEFAULT_COPY(ShadowMapCache)
+	DEFAULT_MOVE(ShadowMapCache)
+
+	// Call once per frame with the casters that will be drawn (in ascending order) and whether any of them has changed
+	// Returns true if the shadow map must be rendered
+	bool Update(const XMMATRIX& lightViewProjection, const std::vector<UINT>& casters, bool castersDirty);
+
+	// Forces the next Update to request a render
+	inline void Invalidate() { m_Valid = false; }
+
+	inline void SetEnabled(bool enabled) { m_Enabled = enabled; if (!enabled) Invalidate(); }
+	inline bool IsEnabled() const { return m_Enabled; }
+
+	inline UINT64 GetRenderedFrameCount() const { return m_RenderedFrames; }
+	inline UINT64 GetSkippedFrameCount() const { return m_SkippedFrames; }
+
+private:
+	bool m_Enabled = true;
+	bool m_Valid = false;
+
+	// The state the cached shadow map was rendered with
+	XMFLOAT4X4 m_LightViewProjection = {};
+	std::vector<UINT> m_Casters;
+
+	UINT64 m_RenderedFrames = 0;
+	UINT64 m_SkippedFrames = 0;
+};
@@ -0,0 +1,198 @@
+#include "pch.h"
+#include "SparseBrickAtlas.h"
+
+#include "SparseFogVolume.h"
+
+#include <algorithm>
+
+
+namespace
+{
+	inline UINT EncodeBrickSlot(UINT slot)
+	{
+		constexpr UINT mask = (1u << SPARSE_FOG_INDIRECTION_SLOT_BITS) - 1;
+		const UINT x = slot % SparseBrickAtlas::s_SlotsPerRow;
+		const UINT y = (slot / SparseBrickAtlas::s_SlotsPerRow) % SparseBrickAtlas::s_SlotsPerRow;
+		const UINT z = slot / SparseBrickAtlas::s_SlotsPerLayer;
+		return SPARSE_FOG_INDIRECTION_BRICK | (x & mask) | ((y & mask) << SPARSE_FOG_INDIRECTION_SLOT_BITS) | ((z & mask) << (2 * SPARSE_FOG_INDIRECTION_SLOT_BITS));
+	}
+}
+
+
+SparseBrickAtlas::SparseBrickAtlas(const XMUINT3& indirectionDimensions, UINT maxBrickCount)
+	: m_IndirectionDimensions(indirectionDimensions)
+	, m_MaxBrickCount(maxBrickCount)
+{
+	ASSERT(indirectionDimensions.x > 0 && indirectionDimensions.y > 0 && indirectionDimensions.z > 0, "Invalid indirection dimensions");
+	// The depth of the brick texture is limited to D3D12_REQ_TEXTURE3D_U_V_OR_W_DIMENSION
+	ASSERT(maxBrickCount <= s_SlotsPerLayer * min(s_MaxSlotLayers, 2048u / s_SlotSize), "Too many bricks for the atlas");
+	Clear();
+}
+
+
+void SparseBrickAtlas::Clear()
+{
+	m_BrickTexels.assign(static_cast<size_t>(GetBrickSlicePitch()) * s_SlotSize, 0);
+	m_Indirection.assign(static_cast<size_t>(m_IndirectionDimensions.x) * m_IndirectionDimensions.y * m_IndirectionDimensions.z, 0);
+
+	m_Cursor = { 0, 0, 0 };
+	m_ShelfHeight = 0;
+	m_LayerDepth = 0;
+
+	m_EntryCount = 0;
+	m_BrickCount = 0;
+}
+
+bool SparseBrickAtlas::Add(const SparseFogVolume& volume, Entry& entry)
+{
+	if (m_BrickCount + volume.GetBrickCount() > m_MaxBrickCount)
+		return false;
+
+	const XMUINT3 size = volume.GetBrickGridDimensions();
+	if (size.x > m_IndirectionDimensions.x || size.y > m_IndirectionDimensions.y || size.z > m_IndirectionDimensions.z)
+		return false;
+
+	XMUINT3 cursor = m_Cursor;
+	UINT shelfHeight = m_ShelfHeight;
+	UINT layerDepth = m_LayerDepth;
+
+	// Start a new shelf when the grid does not fit at the end of this one, and a new layer when the shelf does not fit in this one
+	if (cursor.x + size.x > m_IndirectionDimensions.x)
+	{
+		cursor.x = 0;
+		cursor.y += shelfHeight;
+		shelfHeight = 0;
+	}
+	if (cursor.y + size.y > m_IndirectionDimensions.y)
+	{
+		cursor.x = 0;
+		cursor.y = 0;
+		cursor.z += layerDepth;
+		shelfHeight = 0;
+		layerDepth = 0;
+	}
+	if (cursor.z + size.z > m_IndirectionDimensions.z)
+		return false;
+
+	entry.IndirectionOrigin = cursor;
+	entry.BrickGridDimensions = size;
+	entry.Dimensions = volume.GetDimensions();
+	entry.BrickCount = volume.GetBrickCount();
+	entry.AtlasOffset = { static_cast<float>(cursor.x), static_cast<float>(cursor.y), static_cast<float>(cursor.z) };
+	entry.AtlasScale = { static_cast<float>(entry.Dimensions.x), static_cast<float>(entry.Dimensions.y), static_cast<float>(entry.Dimensions.z) };
+
+	const UINT newLayerCount = max((m_BrickCount + entry.BrickCount + s_SlotsPerLayer - 1) / s_SlotsPerLayer, 1u);
+	m_BrickTexels.resize(static_cast<size_t>(GetBrickSlicePitch()) * newLayerCount * s_SlotSize, 0);
+
+	const UINT rowPitch = GetBrickRowPitch();
+	const UINT slicePitch = GetBrickSlicePitch();
+	for (UINT bz = 0; bz < size.z; bz++)
+	{
+		for (UINT by = 0; by < size.y; by++)
+		{
+			for (UINT bx = 0; bx < size.x; bx++)
+			{
+				UINT& indirection = m_Indirection[(static_cast<size_t>(cursor.z + bz) * m_IndirectionDimensions.y + cursor.y + by) * m_IndirectionDimensions.x + cursor.x + bx];
+
+				UINT8 uniformValue;
+				if (!volume.FindBrick(bx, by, bz, uniformValue))
+				{
+					indirection = uniformValue;
+					continue;
+				}
+
+				const UINT slot = m_BrickCount++;
+				indirection = EncodeBrickSlot(slot);
+
+				// The apron is read from the neighbouring bricks, or is 0 past the edges of the grid
+				const XMUINT3 origin = {
+					(slot % s_SlotsPerRow) * s_SlotSize,
+					((slot / s_SlotsPerRow) % s_SlotsPerRow) * s_SlotSize,
+					(slot / s_SlotsPerLayer) * s_SlotSize
+				};
+				const int x0 = static_cast<int>(bx * SPARSE_FOG_BRICK_SIZE) - SPARSE_FOG_BRICK_APRON;
+				const int y0 = static_cast<int>(by * SPARSE_FOG_BRICK_SIZE) - SPARSE_FOG_BRICK_APRON;
+				const int z0 = static_cast<int>(bz * SPARSE_FOG_BRICK_SIZE) - SPARSE_FOG_BRICK_APRON;
+				for (UINT z = 0; z < s_SlotSize; z++)
+				{
+					for (UINT y = 0; y < s_SlotSize; y++)
+					{
+						UINT8* row = &m_BrickTexels[static_cast<size_t>(origin.z + z) * slicePitch + static_cast<size_t>(origin.y + y) * rowPitch + origin.x];
+						for (UINT x = 0; x < s_SlotSize; x++)
+						{
+							row[x] = volume.GetValue(x0 + static_cast<int>(x), y0 + static_cast<int>(y), z0 + static_cast<int>(z));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	m_Cursor = { cursor.x + size.x, cursor.y, cursor.z };
+	m_ShelfHeight = max(shelfHeight, size.y);
+	m_LayerDepth = max(layerDepth, size.z);
+
+	m_EntryCount++;
+	return true;
+}
+
+
+float SparseBrickAtlas::Sample(const XMFLOAT3& indirectionOrigin, const XMFLOAT3& dimensions, const XMFLOAT3& uvw) const
+{
+	// SampleSparseFog from density_estimation_cs
+	const float voxel[3] = { uvw.x * dimensions.x, uvw.y * dimensions.y, uvw.z * dimensions.z };
+	const float origin[3] = { indirectionOrigin.x, indirectionOrigin.y, indirectionOrigin.z };
+	const float gridDimensions[3] = { dimensions.x, dimensions.y, dimensions.z };
+
+	// The brick of the grid, kept within the grid for points on its far faces
+	UINT brick[3];
+	UINT entry[3];
+	for (UINT i = 0; i < 3; i++)
+	{
+		const UINT lastBrick = (static_cast<UINT>(gridDimensions[i]) + SPARSE_FOG_BRICK_SIZE - 1) / SPARSE_FOG_BRICK_SIZE - 1;
+		brick[i] = min(static_cast<UINT>(max(voxel[i], 0.0f)) / SPARSE_FOG_BRICK_SIZE, lastBrick);
+		entry[i] = static_cast<UINT>(origin[i]) + brick[i];
+	}
+
+	const UINT indirection = m_Indirection[(static_cast<size_t>(entry[2]) * m_IndirectionDimensions.y + entry[1]) * m_IndirectionDimensions.x + entry[0]];
+	if ((indirection & SPARSE_FOG_INDIRECTION_BRICK) == 0)
+		return static_cast<float>(indirection & 0xFF) * (1.0f / 255.0f);
+
+	// Within the slot, where the centre of texel i is at i + 0.5, as for the voxels of the grid
+	constexpr UINT mask = (1u << SPARSE_FOG_INDIRECTION_SLOT_BITS) - 1;
+	const UINT slot[3] = {
+		indirection & mask,
+		(indirection >> SPARSE_FOG_INDIRECTION_SLOT_BITS) & mask,
+		(indirection >> (2 * SPARSE_FOG_INDIRECTION_SLOT_BITS)) & mask
+	};
+
+	const XMUINT3 textureDimensions = GetBrickTextureDimensions();
+	const UINT extent[3] = { textureDimensions.x, textureDimensions.y, textureDimensions.z };
+
+	int texel[3];
+	float fraction[3];
+	for (UINT i = 0; i < 3; i++)
+	{
+		const float local = voxel[i] - static_cast<float>(brick[i] * SPARSE_FOG_BRICK_SIZE);
+		const float p = static_cast<float>(slot[i] * s_SlotSize + SPARSE_FOG_BRICK_APRON) + local - 0.5f;
+		texel[i] = static_cast<int>(floorf(p));
+		fraction[i] = p - static_cast<float>(texel[i]);
+	}
+
+	// Clamped addressing, although the apron keeps the footprint within the slot
+	auto Texel = [&](int x, int y, int z) -> float
+		{
+			x = std::clamp(x, 0, static_cast<int>(extent[0]) - 1);
+			y = std::clamp(y, 0, static_cast<int>(extent[1]) - 1);
+			z = std::clamp(z, 0, static_cast<int>(extent[2]) - 1);
+			return m_BrickTexels[static_cast<size_t>(z) * GetBrickSlicePitch() + static_cast<size_t>(y) * GetBrickRowPitch() + x];
+		};
+
+	auto Lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+	const int x = texel[0], y = texel[1], z = texel[2];
+	const float c00 = Lerp(Texel(x, y, z), Texel(x + 1, y, z), fraction[0]);
+	const float c10 = Lerp(Texel(x, y + 1, z), Texel(x + 1, y + 1, z), fraction[0]);
+	const float c01 = Lerp(Texel(x, y, z + 1), Texel(x + 1, y, z + 1), fraction[0]);
+	const float c11 = Lerp(Texel(x, y + 1, z + 1), Texel(x + 1, y + 1, z + 1), fraction[0]);
+	return Lerp(Lerp(c00, c10, fraction[1]), Lerp(c01, c11, fraction[1]), fraction[2]) * (1.0f / 255.0f);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+
+using namespace DirectX;
+
+class SparseFogVolume;
+
+
+/**
+ *	Packs the stored bricks of SparseFogVolumes into a UNORM8 3D texture, so that only the parts of baked fog
+ *	that are not uniform are uploaded, along with an R32_UINT indirection table for density estimation to find them with.
+ *
+ *	Each brick gets a slot of SPARSE_FOG_BRICK_SLOT_SIZE^3 texels, with the brick in the middle and the voxels of its neighbours
+ *	around it, so that hardware filtering within a slot matches filtering the dense grid.
+ *	Slots fill s_SlotsPerRow along x and y, and the texture grows along z with the number of bricks.
+ *
+ *	The indirection table has one entry for each brick of each volume: the slot of a stored brick, or the value of a uniform one,
+ *	encoded as SPARSE_FOG_INDIRECTION_*. The grids of bricks are packed into the table in shelves, as FogDensityAtlas packs its grids.
+ *
+ *	The atlas has no knowledge of D3D; the renderer uploads its texels.
+ */
+class SparseBrickAtlas
+{
+public:
+	inline static constexpr UINT s_SlotSize = SPARSE_FOG_BRICK_SLOT_SIZE;
+	inline static constexpr UINT s_SlotsPerRow = 16;
+	inline static constexpr UINT s_SlotsPerLayer = s_SlotsPerRow * s_SlotsPerRow;
+	// Slots along z are limited by the bits of an indirection entry
+	inline static constexpr UINT s_MaxSlotLayers = 1u << SPARSE_FOG_INDIRECTION_SLOT_BITS;
+
+	struct Entry
+	{
+		XMUINT3 IndirectionOrigin = { 0, 0, 0 };
+		XMUINT3 BrickGridDimensions = { 0, 0, 0 };
+		XMUINT3 Dimensions = { 0, 0, 0 };
+		UINT BrickCount = 0;
+
+		// For FogVolumeGPUData::AtlasOffset and AtlasScale
+		XMFLOAT3 AtlasOffset = { 0.0f, 0.0f, 0.0f };
+		XMFLOAT3 AtlasScale = { 0.0f, 0.0f, 0.0f };
+	};
+
+public:
+	SparseBrickAtlas(const XMUINT3& indirectionDimensions, UINT maxBrickCount);
+	~SparseBrickAtlas() = default;
+
+	DEFAULT_COPY(SparseBrickAtlas)
+	DEFAULT_MOVE(SparseBrickAtlas)
+
+	// Removes every volume and brick
+	void Clear();
+	// Copies the stored bricks of a volume into free slots, and its grid of bricks into the indirection table
+	// Returns false, and leaves the atlas as it was, if either does not fit
+	bool Add(const SparseFogVolume& volume, Entry& entry);
+
+	// Trilinear filtering, in [0, 1], of a volume at uvw in [0, 1] across its grid, as density estimation samples it
+	// indirectionOrigin and dimensions are the AtlasOffset and AtlasScale of its Entry
+	float Sample(const XMFLOAT3& indirectionOrigin, const XMFLOAT3& dimensions, const XMFLOAT3& uvw) const;
+
+	// Getters
+	inline UINT GetEntryCount() const { return m_EntryCount; }
+	inline UINT GetBrickCount() const { return m_BrickCount; }
+	inline UINT GetMaxBrickCount() const { return m_MaxBrickCount; }
+
+	// One byte per texel, stored x first, then y, then z, with at least one layer of slots
+	inline XMUINT3 GetBrickTextureDimensions() const { return { s_SlotsPerRow * s_SlotSize, s_SlotsPerRow * s_SlotSize, GetSlotLayerCount() * s_SlotSize }; }
+	inline const std::vector<UINT8>& GetBrickTexels() const { return m_BrickTexels; }
+	inline UINT GetBrickRowPitch() const { return s_SlotsPerRow * s_SlotSize; }
+	inline UINT GetBrickSlicePitch() const { return GetBrickRowPitch() * s_SlotsPerRow * s_SlotSize; }
+
+	inline const XMUINT3& GetIndirectionDimensions() const { return m_IndirectionDimensions; }
+	inline const std::vector<UINT>& GetIndirection() const { return m_Indirection; }
+	inline UINT GetIndirectionRowPitch() const { return m_IndirectionDimensions.x * sizeof(UINT); }
+	inline UINT GetIndirectionSlicePitch() const { return GetIndirectionRowPitch() * m_IndirectionDimensions.y; }
+
+	// Bytes of both textures
+	inline UINT64 GetSizeInBytes() const { return m_BrickTexels.size() + m_Indirection.size() * sizeof(UINT); }
+
+private:
+	inline UINT GetSlotLayerCount() const { return max((m_BrickCount + s_SlotsPerLayer - 1) / s_SlotsPerLayer, 1u); }
+
+private:
+	XMUINT3 m_IndirectionDimensions;
+	UINT m_MaxBrickCount;
+
+	std::vector<UINT8> m_BrickTexels;
+	std::vector<UINT> m_Indirection;
+
+	// The corner of the next grid of bricks in the indirection table, and the height of the current shelf and depth of the current layer
+	XMUINT3 m_Cursor = { 0, 0, 0 };
+	UINT m_ShelfHeight = 0;
+	UINT m_LayerDepth = 0;
+
+	UINT m_EntryCount = 0;
+	UINT m_BrickCount = 0;
+};
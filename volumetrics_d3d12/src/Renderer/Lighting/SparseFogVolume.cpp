@@ -0,0 +1,505 @@
+#include "pch.h"
+#include "SparseFogVolume.h"
+
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	inline double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	constexpr char s_FileMagic[4] = { 'S', 'F', 'V', 'B' };
+	// Sections start on cache lines
+	constexpr UINT64 s_SectionAlignment = 64;
+
+	inline UINT DivideRoundUp(UINT value, UINT divisor)
+	{
+		return (value + divisor - 1) / divisor;
+	}
+
+	inline UINT GetBrickVoxelIndex(UINT x, UINT y, UINT z)
+	{
+		constexpr UINT mask = SparseFogVolume::s_BrickSize - 1;
+		return ((z & mask) * SparseFogVolume::s_BrickSize + (y & mask)) * SparseFogVolume::s_BrickSize + (x & mask);
+	}
+
+	// Trilinear filtering of a dense grid, with the conventions of SparseFogVolume::Sample
+	float SampleDense(const XMUINT3& dimensions, const UINT8* density, const XMFLOAT3& voxel)
+	{
+		auto Value = [&](int x, int y, int z) -> float
+			{
+				if (x < 0 || y < 0 || z < 0 || x >= static_cast<int>(dimensions.x) || y >= static_cast<int>(dimensions.y) || z >= static_cast<int>(dimensions.z))
+					return 0.0f;
+				return density[(static_cast<size_t>(z) * dimensions.y + y) * dimensions.x + x];
+			};
+
+		const float px = voxel.x - 0.5f;
+		const float py = voxel.y - 0.5f;
+		const float pz = voxel.z - 0.5f;
+		const int x = static_cast<int>(floorf(px));
+		const int y = static_cast<int>(floorf(py));
+		const int z = static_cast<int>(floorf(pz));
+		const float fx = px - static_cast<float>(x);
+		const float fy = py - static_cast<float>(y);
+		const float fz = pz - static_cast<float>(z);
+
+		auto Lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+		const float c00 = Lerp(Value(x, y, z), Value(x + 1, y, z), fx);
+		const float c10 = Lerp(Value(x, y + 1, z), Value(x + 1, y + 1, z), fx);
+		const float c01 = Lerp(Value(x, y, z + 1), Value(x + 1, y, z + 1), fx);
+		const float c11 = Lerp(Value(x, y + 1, z + 1), Value(x + 1, y + 1, z + 1), fx);
+		return Lerp(Lerp(c00, c10, fy), Lerp(c01, c11, fy), fz) * (1.0f / 255.0f);
+	}
+}
+
+static_assert(sizeof(SparseFogVolume::Header) == 88, "The header is part of the file layout");
+static_assert(sizeof(SparseFogVolume::Node) == 600, "Nodes are part of the file layout");
+static_assert(SparseFogVolume::s_NodeBrickCount % 64 == 0, "Node masks are made of whole words");
+
+
+void SparseFogVolume::Reset()
+{
+	m_Storage.clear();
+	m_Mapping.reset();
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+
+void SparseFogVolume::Build(const XMUINT3& dimensions, const UINT8* density, const XMFLOAT3& min, float voxelSize)
+{
+	ASSERT(dimensions.x > 0 && dimensions.y > 0 && dimensions.z > 0, "Invalid sparse fog volume dimensions");
+	ASSERT(density, "No densities to build the sparse fog volume from");
+
+	Reset();
+
+	const XMUINT3 brickGrid = { DivideRoundUp(dimensions.x, s_BrickSize), DivideRoundUp(dimensions.y, s_BrickSize), DivideRoundUp(dimensions.z, s_BrickSize) };
+	const XMUINT3 rootDimensions = { DivideRoundUp(brickGrid.x, s_NodeSize), DivideRoundUp(brickGrid.y, s_NodeSize), DivideRoundUp(brickGrid.z, s_NodeSize) };
+
+	auto Value = [&](int x, int y, int z) -> UINT8
+		{
+			if (x < 0 || y < 0 || z < 0 || x >= static_cast<int>(dimensions.x) || y >= static_cast<int>(dimensions.y) || z >= static_cast<int>(dimensions.z))
+				return 0;
+			return density[(static_cast<size_t>(z) * dimensions.y + y) * dimensions.x + x];
+		};
+
+	// Whether a brick and the voxels around it, which filtering reads, all hold the same value
+	auto IsUniform = [&](const XMUINT3& brick, UINT8& uniformValue) -> bool
+		{
+			const int x0 = static_cast<int>(brick.x * s_BrickSize) - SPARSE_FOG_BRICK_APRON;
+			const int y0 = static_cast<int>(brick.y * s_BrickSize) - SPARSE_FOG_BRICK_APRON;
+			const int z0 = static_cast<int>(brick.z * s_BrickSize) - SPARSE_FOG_BRICK_APRON;
+
+			uniformValue = Value(x0, y0, z0);
+			for (int z = z0; z < z0 + SPARSE_FOG_BRICK_SLOT_SIZE; z++)
+			{
+				for (int y = y0; y < y0 + SPARSE_FOG_BRICK_SLOT_SIZE; y++)
+				{
+					for (int x = x0; x < x0 + SPARSE_FOG_BRICK_SLOT_SIZE; x++)
+					{
+						if (Value(x, y, z) != uniformValue)
+							return false;
+					}
+				}
+			}
+			return true;
+		};
+
+	std::vector<UINT> root(static_cast<size_t>(rootDimensions.x) * rootDimensions.y * rootDimensions.z, s_EmptyNode);
+	std::vector<Node> nodes;
+	std::vector<UINT8> bricks;
+	UINT brickCount = 0;
+
+	for (UINT nz = 0; nz < rootDimensions.z; nz++)
+	{
+		for (UINT ny = 0; ny < rootDimensions.y; ny++)
+		{
+			for (UINT nx = 0; nx < rootDimensions.x; nx++)
+			{
+				Node node = {};
+				node.FirstBrick = brickCount;
+				bool isEmpty = true;
+
+				for (UINT child = 0; child < s_NodeBrickCount; child++)
+				{
+					const XMUINT3 brick = {
+						nx * s_NodeSize + child % s_NodeSize,
+						ny * s_NodeSize + (child / s_NodeSize) % s_NodeSize,
+						nz * s_NodeSize + child / (s_NodeSize * s_NodeSize)
+					};
+
+					// Bricks past the edge of the grid are left uniformly 0
+					if (brick.x >= brickGrid.x || brick.y >= brickGrid.y || brick.z >= brickGrid.z)
+						continue;
+
+					UINT8 uniformValue;
+					if (IsUniform(brick, uniformValue))
+					{
+						node.UniformValues[child] = uniformValue;
+						isEmpty &= uniformValue == 0;
+						continue;
+					}
+
+					node.BrickMask[child / 64] |= 1ull << (child % 64);
+					isEmpty = false;
+
+					const size_t offset = bricks.size();
+					bricks.resize(offset + s_BrickVoxelCount);
+					for (UINT z = 0; z < s_BrickSize; z++)
+					{
+						for (UINT y = 0; y < s_BrickSize; y++)
+						{
+							for (UINT x = 0; x < s_BrickSize; x++)
+							{
+								bricks[offset + GetBrickVoxelIndex(x, y, z)] = Value(brick.x * s_BrickSize + x, brick.y * s_BrickSize + y, brick.z * s_BrickSize + z);
+							}
+						}
+					}
+					brickCount++;
+				}
+
+				if (isEmpty)
+					continue;
+
+				UINT prefix = 0;
+				for (UINT word = 0; word < s_NodeMaskWords; word++)
+				{
+					node.WordPrefix[word] = static_cast<UINT16>(prefix);
+					prefix += static_cast<UINT>(std::popcount(node.BrickMask[word]));
+				}
+
+				root[(static_cast<size_t>(nz) * rootDimensions.y + ny) * rootDimensions.x + nx] = static_cast<UINT>(nodes.size());
+				nodes.push_back(node);
+			}
+		}
+	}
+
+	Header header = {};
+	memcpy(header.Magic, s_FileMagic, sizeof(header.Magic));
+	header.Version = s_Version;
+	header.Dimensions = dimensions;
+	header.NodeCount = static_cast<UINT>(nodes.size());
+	header.RootDimensions = rootDimensions;
+	header.BrickCount = brickCount;
+	header.Min = min;
+	header.VoxelSize = voxelSize;
+	header.RootOffset = Align(static_cast<UINT64>(sizeof(Header)), s_SectionAlignment);
+	header.NodeOffset = Align(header.RootOffset + root.size() * sizeof(UINT), s_SectionAlignment);
+	header.BrickOffset = Align(header.NodeOffset + nodes.size() * sizeof(Node), s_SectionAlignment);
+	header.Size = header.BrickOffset + bricks.size();
+
+	m_Storage.assign(static_cast<size_t>(header.Size), 0);
+	memcpy(m_Storage.data(), &header, sizeof(header));
+	memcpy(m_Storage.data() + header.RootOffset, root.data(), root.size() * sizeof(UINT));
+	if (!nodes.empty())
+	{
+		memcpy(m_Storage.data() + header.NodeOffset, nodes.data(), nodes.size() * sizeof(Node));
+		memcpy(m_Storage.data() + header.BrickOffset, bricks.data(), bricks.size());
+	}
+
+	m_Data = m_Storage.data();
+	m_Size = header.Size;
+}
+
+void SparseFogVolume::Decode(std::vector<UINT8>& density) const
+{
+	const XMUINT3& dimensions = GetDimensions();
+	const XMUINT3 brickGrid = GetBrickGridDimensions();
+	density.resize(static_cast<size_t>(GetDenseSizeInBytes()));
+
+	for (UINT bz = 0; bz < brickGrid.z; bz++)
+	{
+		for (UINT by = 0; by < brickGrid.y; by++)
+		{
+			for (UINT bx = 0; bx < brickGrid.x; bx++)
+			{
+				UINT8 uniformValue;
+				const UINT8* brick = FindBrick(bx, by, bz, uniformValue);
+
+				// Bricks at the far edges of the grid are cut short
+				for (UINT z = bz * s_BrickSize; z < min((bz + 1) * s_BrickSize, dimensions.z); z++)
+				{
+					for (UINT y = by * s_BrickSize; y < min((by + 1) * s_BrickSize, dimensions.y); y++)
+					{
+						for (UINT x = bx * s_BrickSize; x < min((bx + 1) * s_BrickSize, dimensions.x); x++)
+						{
+							density[(static_cast<size_t>(z) * dimensions.y + y) * dimensions.x + x] = brick ? brick[GetBrickVoxelIndex(x, y, z)] : uniformValue;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+
+bool SparseFogVolume::Save(const std::string& path) const
+{
+	ASSERT(!IsEmpty(), "Empty sparse fog volume");
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for writing", path);
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(m_Data), static_cast<std::streamsize>(m_Size));
+	return file.good();
+}
+
+bool SparseFogVolume::Load(const std::string& path)
+{
+	Reset();
+
+	const HANDLE file = CreateFileW(std::filesystem::path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		LOG_WARN("Sparse fog volume: Failed to open {}", path);
+		return false;
+	}
+
+	LARGE_INTEGER fileSize = {};
+	const bool hasSize = GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(sizeof(Header));
+
+	// The view keeps the mapping open, and the mapping keeps the file open
+	const HANDLE mapping = hasSize ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	CloseHandle(file);
+	const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (mapping)
+	{
+		CloseHandle(mapping);
+	}
+
+	if (!view)
+	{
+		LOG_WARN("Sparse fog volume: Failed to map {}", path);
+		return false;
+	}
+
+	m_Mapping = std::shared_ptr<const UINT8>(static_cast<const UINT8*>(view), [](const UINT8* data) { UnmapViewOfFile(data); });
+	m_Data = m_Mapping.get();
+	m_Size = static_cast<UINT64>(fileSize.QuadPart);
+
+	// Only the header, root and nodes are checked, so that the bricks are not read until they are sampled
+	const Header& header = GetHeader();
+	const UINT64 rootCount = static_cast<UINT64>(header.RootDimensions.x) * header.RootDimensions.y * header.RootDimensions.z;
+	bool isValid = memcmp(header.Magic, s_FileMagic, sizeof(header.Magic)) == 0
+		&& header.Version == s_Version
+		&& header.Size == m_Size
+		&& header.RootDimensions.x == DivideRoundUp(DivideRoundUp(header.Dimensions.x, s_BrickSize), s_NodeSize)
+		&& header.RootDimensions.y == DivideRoundUp(DivideRoundUp(header.Dimensions.y, s_BrickSize), s_NodeSize)
+		&& header.RootDimensions.z == DivideRoundUp(DivideRoundUp(header.Dimensions.z, s_BrickSize), s_NodeSize)
+		&& header.RootOffset >= sizeof(Header)
+		&& header.NodeOffset >= header.RootOffset + rootCount * sizeof(UINT)
+		&& header.BrickOffset >= header.NodeOffset + static_cast<UINT64>(header.NodeCount) * sizeof(Node)
+		&& header.Size >= header.BrickOffset + static_cast<UINT64>(header.BrickCount) * s_BrickVoxelCount;
+
+	for (UINT64 i = 0; isValid && i < rootCount; i++)
+	{
+		isValid = GetRoot()[i] == s_EmptyNode || GetRoot()[i] < header.NodeCount;
+	}
+	for (UINT i = 0; isValid && i < header.NodeCount; i++)
+	{
+		const Node& node = GetNodes()[i];
+
+		UINT prefix = 0;
+		for (UINT word = 0; isValid && word < s_NodeMaskWords; word++)
+		{
+			isValid = node.WordPrefix[word] == prefix;
+			prefix += static_cast<UINT>(std::popcount(node.BrickMask[word]));
+		}
+		isValid = isValid && static_cast<UINT64>(node.FirstBrick) + prefix <= header.BrickCount;
+	}
+
+	if (!isValid)
+	{
+		LOG_WARN("Sparse fog volume: {} is not a sparse fog volume of version {}, or is corrupt", path, s_Version);
+		Reset();
+		return false;
+	}
+
+	return true;
+}
+
+
+const UINT8* SparseFogVolume::FindBrick(UINT x, UINT y, UINT z, UINT8& uniformValue) const
+{
+	const Header& header = GetHeader();
+
+	const UINT nodeIndex = GetRoot()[((z / s_NodeSize) * header.RootDimensions.y + y / s_NodeSize) * header.RootDimensions.x + x / s_NodeSize];
+	if (nodeIndex == s_EmptyNode)
+	{
+		uniformValue = 0;
+		return nullptr;
+	}
+
+	const Node& node = GetNodes()[nodeIndex];
+	const UINT child = ((z % s_NodeSize) * s_NodeSize + y % s_NodeSize) * s_NodeSize + x % s_NodeSize;
+	const UINT64 word = node.BrickMask[child / 64];
+	const UINT64 bit = 1ull << (child % 64);
+	if ((word & bit) == 0)
+	{
+		uniformValue = node.UniformValues[child];
+		return nullptr;
+	}
+
+	const UINT brick = node.FirstBrick + node.WordPrefix[child / 64] + static_cast<UINT>(std::popcount(word & (bit - 1)));
+	return GetBricks() + static_cast<size_t>(brick) * s_BrickVoxelCount;
+}
+
+UINT8 SparseFogVolume::GetValue(int x, int y, int z) const
+{
+	const XMUINT3& dimensions = GetDimensions();
+	if (x < 0 || y < 0 || z < 0 || x >= static_cast<int>(dimensions.x) || y >= static_cast<int>(dimensions.y) || z >= static_cast<int>(dimensions.z))
+		return 0;
+
+	UINT8 uniformValue;
+	const UINT8* brick = FindBrick(x / s_BrickSize, y / s_BrickSize, z / s_BrickSize, uniformValue);
+	return brick ? brick[GetBrickVoxelIndex(x, y, z)] : uniformValue;
+}
+
+float SparseFogVolume::Sample(const XMFLOAT3& voxel) const
+{
+	const XMUINT3& dimensions = GetDimensions();
+
+	const float px = voxel.x - 0.5f;
+	const float py = voxel.y - 0.5f;
+	const float pz = voxel.z - 0.5f;
+	const int x = static_cast<int>(floorf(px));
+	const int y = static_cast<int>(floorf(py));
+	const int z = static_cast<int>(floorf(pz));
+	const float fx = px - static_cast<float>(x);
+	const float fy = py - static_cast<float>(y);
+	const float fz = pz - static_cast<float>(z);
+
+	float values[8];
+
+	// Most footprints are within a single brick, which is only looked up once
+	constexpr int lastInBrick = s_BrickSize - 1;
+	const bool isInsideGrid = x >= 0 && y >= 0 && z >= 0
+		&& x + 1 < static_cast<int>(dimensions.x) && y + 1 < static_cast<int>(dimensions.y) && z + 1 < static_cast<int>(dimensions.z);
+	if (isInsideGrid && (x & lastInBrick) != lastInBrick && (y & lastInBrick) != lastInBrick && (z & lastInBrick) != lastInBrick)
+	{
+		UINT8 uniformValue;
+		const UINT8* brick = FindBrick(x / s_BrickSize, y / s_BrickSize, z / s_BrickSize, uniformValue);
+		if (!brick)
+			return static_cast<float>(uniformValue) * (1.0f / 255.0f);
+
+		const UINT8* first = brick + GetBrickVoxelIndex(x, y, z);
+		constexpr UINT row = s_BrickSize;
+		constexpr UINT slice = s_BrickSize * s_BrickSize;
+		values[0] = first[0];
+		values[1] = first[1];
+		values[2] = first[row];
+		values[3] = first[row + 1];
+		values[4] = first[slice];
+		values[5] = first[slice + 1];
+		values[6] = first[slice + row];
+		values[7] = first[slice + row + 1];
+	}
+	else
+	{
+		for (UINT i = 0; i < 8; i++)
+		{
+			values[i] = GetValue(x + (i & 1), y + ((i >> 1) & 1), z + (i >> 2));
+		}
+	}
+
+	auto Lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+	const float c00 = Lerp(values[0], values[1], fx);
+	const float c10 = Lerp(values[2], values[3], fx);
+	const float c01 = Lerp(values[4], values[5], fx);
+	const float c11 = Lerp(values[6], values[7], fx);
+	return Lerp(Lerp(c00, c10, fy), Lerp(c01, c11, fy), fz) * (1.0f / 255.0f);
+}
+
+
+SparseFogVolume::BenchmarkResult SparseFogVolume::Benchmark(UINT sampleCount, UINT iterations) const
+{
+	ASSERT(sampleCount > 0 && iterations > 0, "No samples to benchmark");
+
+	const XMUINT3& dimensions = GetDimensions();
+
+	BenchmarkResult result;
+	result.Voxels = GetDenseSizeInBytes();
+	result.BrickCount = GetBrickCount();
+	result.SparseBytes = GetSizeInBytes();
+	result.DenseBytes = GetDenseSizeInBytes();
+	result.Samples = static_cast<UINT64>(sampleCount) * iterations;
+
+	std::vector<UINT8> dense;
+	Decode(dense);
+
+	// The same points for both, spread over the whole grid
+	std::mt19937 generator(0x5F0B);
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+	std::vector<XMFLOAT3> points(sampleCount);
+	for (XMFLOAT3& point : points)
+	{
+		point = {
+			distribution(generator) * static_cast<float>(dimensions.x),
+			distribution(generator) * static_cast<float>(dimensions.y),
+			distribution(generator) * static_cast<float>(dimensions.z)
+		};
+	}
+
+	auto SamplesPerSecond = [&](auto&& sample)
+		{
+			const auto start = Clock::now();
+			float sum = 0.0f;
+			for (UINT i = 0; i < iterations; i++)
+			{
+				for (const XMFLOAT3& point : points)
+				{
+					sum += sample(point);
+				}
+			}
+			const double milliseconds = MillisecondsSince(start);
+
+			// Keeps the samples from being optimised away
+			volatile float sink = sum;
+			(void)sink;
+
+			return static_cast<double>(result.Samples) * 1000.0 / max(milliseconds, 1e-3);
+		};
+
+	result.SparseSamplesPerSecond = SamplesPerSecond([&](const XMFLOAT3& point) { return Sample(point); });
+	result.DenseSamplesPerSecond = SamplesPerSecond([&](const XMFLOAT3& point) { return SampleDense(dimensions, dense.data(), point); });
+
+	for (const XMFLOAT3& point : points)
+	{
+		result.MaxDifference = max(result.MaxDifference, fabsf(Sample(point) - SampleDense(dimensions, dense.data(), point)));
+	}
+
+	return result;
+}
+
+std::string SparseFogVolume::BenchmarkResult::Format() const
+{
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer),
+		"%llu voxels, %u bricks, %llu samples\n"
+		"  Sparse  %8.3f MB (%.1f%% of dense)\n"
+		"  Dense   %8.3f MB\n"
+		"  Sparse  %8.2f Msamples/s\n"
+		"  Dense   %8.2f Msamples/s\n"
+		"  Max difference %g",
+		Voxels, BrickCount, Samples,
+		static_cast<double>(SparseBytes) / (1024.0 * 1024.0), 100.0 * static_cast<double>(SparseBytes) / max(static_cast<double>(DenseBytes), 1.0),
+		static_cast<double>(DenseBytes) / (1024.0 * 1024.0),
+		SparseSamplesPerSecond / 1e6,
+		DenseSamplesPerSecond / 1e6,
+		MaxDifference);
+	return buffer;
+}
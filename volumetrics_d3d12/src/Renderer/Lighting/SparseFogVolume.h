@@ -0,0 +1,162 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+
+#include <memory>
+#include <string>
+
+using namespace DirectX;
+
+
+/**
+ *	A grid of UNORM8 fog densities stored sparsely, in the manner of NanoVDB, so that baked or imported fog
+ *	only takes memory where it is not uniform. SparseBrickAtlas packs its bricks into the textures that density estimation samples.
+ *
+ *	The grid is split into bricks of SPARSE_FOG_BRICK_SIZE^3 voxels, which are indexed by two levels:
+ *		Root  - A grid with one entry for each node, holding the index of the node, or s_EmptyNode where every voxel is 0
+ *		Node  - s_NodeSize^3 bricks, with a mask of the bricks that are stored, and the uniform value of those that are not
+ *	The stored bricks of a node are contiguous, in the order of their bits in the mask, so a brick is found from the number of bits set before it.
+ *
+ *	A brick is stored unless it and the voxels around it, which filtering reads, all hold the same value.
+ *	So sampling the atlas on the GPU only needs the brick a point is in, and matches sampling the dense grid everywhere.
+ *	Voxels outside the grid are 0.
+ *
+ *	Everything is stored in a single block in the layout of the file, with offsets in place of pointers,
+ *	so that a file is loaded by memory mapping it, and only the pages that are sampled are read from disk.
+ *	The volume has no knowledge of D3D, so that it can be tested and benchmarked on its own.
+ */
+class SparseFogVolume
+{
+public:
+	inline static constexpr UINT s_BrickSize = SPARSE_FOG_BRICK_SIZE;
+	inline static constexpr UINT s_BrickVoxelCount = s_BrickSize * s_BrickSize * s_BrickSize;
+	// Bricks along each axis of a node
+	inline static constexpr UINT s_NodeSize = 8;
+	inline static constexpr UINT s_NodeBrickCount = s_NodeSize * s_NodeSize * s_NodeSize;
+	inline static constexpr UINT s_NodeMaskWords = s_NodeBrickCount / 64;
+
+	inline static constexpr UINT s_EmptyNode = 0xFFFFFFFF;
+
+	// Bumped when the file layout changes, so that old files are not loaded
+	inline static constexpr UINT s_Version = 1;
+
+	// The start of the file, with the offsets of the sections that follow it
+	struct Header
+	{
+		char Magic[4];
+		UINT Version;
+
+		XMUINT3 Dimensions;
+		UINT NodeCount;
+		XMUINT3 RootDimensions;
+		UINT BrickCount;
+
+		// Minimum corner of the grid, and the size of each cubic voxel
+		XMFLOAT3 Min;
+		float VoxelSize;
+
+		UINT64 RootOffset;
+		UINT64 NodeOffset;
+		UINT64 BrickOffset;
+		UINT64 Size;
+	};
+
+	struct Node
+	{
+		// One bit for each brick, set when the brick is stored
+		UINT64 BrickMask[s_NodeMaskWords];
+		// Index of the node's first stored brick, and the number of bits set in the words before each word of the mask
+		UINT FirstBrick;
+		UINT16 WordPrefix[s_NodeMaskWords];
+		UINT Padding;
+
+		// The value of every voxel of each brick that is not stored
+		UINT8 UniformValues[s_NodeBrickCount];
+	};
+
+	struct BenchmarkResult
+	{
+		UINT64 Voxels = 0;
+		UINT BrickCount = 0;
+		UINT64 SparseBytes = 0;
+		UINT64 DenseBytes = 0;
+
+		UINT64 Samples = 0;
+		// Trilinear samples at random points per second, from the sparse volume and from the dense grid
+		double SparseSamplesPerSecond = 0.0;
+		double DenseSamplesPerSecond = 0.0;
+		// Largest difference between the sparse and dense samples, which should be 0
+		float MaxDifference = 0.0f;
+
+		std::string Format() const;
+	};
+
+public:
+	SparseFogVolume() = default;
+	~SparseFogVolume() = default;
+
+	DISALLOW_COPY(SparseFogVolume)
+	DEFAULT_MOVE(SparseFogVolume)
+
+	// Builds the volume from a dense grid of densities, stored x first, then y, then z
+	void Build(const XMUINT3& dimensions, const UINT8* density, const XMFLOAT3& min, float voxelSize);
+	// Expands the volume back into a dense grid, laid out as the grid it was built from
+	void Decode(std::vector<UINT8>& density) const;
+
+	bool Save(const std::string& path) const;
+	// Memory maps the file, which stays open until the volume is built or loaded again, or destroyed
+	// Fails, and leaves the volume empty, if the file is not a volume of this version or its sections do not fit in it
+	bool Load(const std::string& path);
+
+	// The voxel at (x, y, z), or 0 outside the grid
+	UINT8 GetValue(int x, int y, int z) const;
+	// Trilinear filtering, in [0, 1], at a position in voxels, where the centre of voxel (x, y, z) is at (x + 0.5, y + 0.5, z + 0.5)
+	float Sample(const XMFLOAT3& voxel) const;
+
+	// The stored brick containing brick (x, y, z) of the grid, or nullptr with the value of its voxels
+	const UINT8* FindBrick(UINT x, UINT y, UINT z, UINT8& uniformValue) const;
+
+	// Samples the volume and the dense grid it decodes to at sampleCount random points, iterations times each
+	BenchmarkResult Benchmark(UINT sampleCount, UINT iterations) const;
+
+	// Getters
+	inline bool IsEmpty() const { return m_Data == nullptr; }
+	inline bool IsMapped() const { return m_Mapping != nullptr; }
+
+	inline const XMUINT3& GetDimensions() const { return GetHeader().Dimensions; }
+	inline XMUINT3 GetBrickGridDimensions() const
+	{
+		const XMUINT3& dimensions = GetDimensions();
+		return { (dimensions.x + s_BrickSize - 1) / s_BrickSize, (dimensions.y + s_BrickSize - 1) / s_BrickSize, (dimensions.z + s_BrickSize - 1) / s_BrickSize };
+	}
+	inline const XMFLOAT3& GetMin() const { return GetHeader().Min; }
+	inline float GetVoxelSize() const { return GetHeader().VoxelSize; }
+
+	inline UINT GetNodeCount() const { return GetHeader().NodeCount; }
+	inline UINT GetBrickCount() const { return GetHeader().BrickCount; }
+	// Bytes of the whole volume, as stored on disk, and of the dense grid of the same dimensions
+	inline UINT64 GetSizeInBytes() const { return m_Size; }
+	inline UINT64 GetDenseSizeInBytes() const
+	{
+		const XMUINT3& dimensions = GetDimensions();
+		return static_cast<UINT64>(dimensions.x) * dimensions.y * dimensions.z;
+	}
+
+private:
+	inline const Header& GetHeader() const { ASSERT(m_Data, "Empty sparse fog volume"); return *reinterpret_cast<const Header*>(m_Data); }
+	inline const UINT* GetRoot() const { return reinterpret_cast<const UINT*>(m_Data + GetHeader().RootOffset); }
+	inline const Node* GetNodes() const { return reinterpret_cast<const Node*>(m_Data + GetHeader().NodeOffset); }
+	inline const UINT8* GetBricks() const { return m_Data + GetHeader().BrickOffset; }
+
+	void Reset();
+
+private:
+	// Either the storage of a built volume, or the view of a mapped file
+	std::vector<UINT8> m_Storage;
+	// Unmaps the view and closes the file when released
+	std::shared_ptr<const UINT8> m_Mapping;
+
+	const UINT8* m_Data = nullptr;
+	UINT64 m_Size = 0;
+};
@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "VolumetricMemory.h"
+
+
+namespace VolumetricMemory
+{
+	DXGI_FORMAT GetVBufferBFormat(UINT vbufferBStorage)
+	{
+		switch (vbufferBStorage)
+		{
+		case VOLUME_VBUFFERB_STORAGE_FULL:		return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case VOLUME_VBUFFERB_STORAGE_PACKED:	return DXGI_FORMAT_R32_UINT;
+		case VOLUME_VBUFFERB_STORAGE_ANALYTIC:	return DXGI_FORMAT_UNKNOWN;
+		default:
+			ASSERT(false, "Invalid VBufferB storage");
+			return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	DXGI_FORMAT GetIntegratedFormat(UINT integratedStorage)
+	{
+		switch (integratedStorage)
+		{
+		case VOLUME_INTEGRATED_STORAGE_RGBA16F:			return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case VOLUME_INTEGRATED_STORAGE_R11G11B10_R16:	return DXGI_FORMAT_R11G11B10_FLOAT;
+		case VOLUME_INTEGRATED_STORAGE_R11G11B10_R8:	return DXGI_FORMAT_R11G11B10_FLOAT;
+		default:
+			ASSERT(false, "Invalid integrated volume storage");
+			return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	DXGI_FORMAT GetIntegratedTransmittanceFormat(UINT integratedStorage)
+	{
+		switch (integratedStorage)
+		{
+		case VOLUME_INTEGRATED_STORAGE_RGBA16F:			return DXGI_FORMAT_UNKNOWN;
+		case VOLUME_INTEGRATED_STORAGE_R11G11B10_R16:	return DXGI_FORMAT_R16_UNORM;
+		case VOLUME_INTEGRATED_STORAGE_R11G11B10_R8:	return DXGI_FORMAT_R8_UNORM;
+		default:
+			ASSERT(false, "Invalid integrated volume storage");
+			return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	UINT GetBytesPerTexel(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_UNKNOWN:				return 0;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:	return 8;
+		case DXGI_FORMAT_R32_UINT:				return 4;
+		case DXGI_FORMAT_R11G11B10_FLOAT:		return 4;
+		case DXGI_FORMAT_R16_UNORM:				return 2;
+		case DXGI_FORMAT_R8_UNORM:				return 1;
+		default:
+			ASSERT(false, "Unsupported volume format");
+			return 0;
+		}
+	}
+
+
+	VolumetricMemoryFootprint CalculateFootprint(const VolumetricMemoryConfig& config, const XMUINT3& resolution)
+	{
+		const UINT64 texelCount = static_cast<UINT64>(resolution.x) * resolution.y * resolution.z;
+
+		auto VolumeBytes = [texelCount](DXGI_FORMAT format)
+			{
+				const UINT64 bytes = texelCount * GetBytesPerTexel(format);
+				return bytes > 0 ? Align(bytes, static_cast<UINT64>(D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT)) : 0;
+			};
+
+		VolumetricMemoryFootprint footprint;
+		footprint.VBufferA = VolumeBytes(DXGI_FORMAT_R16G16B16A16_FLOAT);
+		footprint.VBufferB = VolumeBytes(GetVBufferBFormat(config.VBufferBStorage));
+		footprint.LightScatteringVolumes = 2 * VolumeBytes(DXGI_FORMAT_R16G16B16A16_FLOAT);
+		footprint.IntegratedVolume = VolumeBytes(GetIntegratedFormat(config.IntegratedStorage)) + VolumeBytes(GetIntegratedTransmittanceFormat(config.IntegratedStorage));
+
+		if (config.AliasVBufferAWithIntegrated)
+		{
+			footprint.AliasedBytes = min(footprint.VBufferA, footprint.IntegratedVolume);
+		}
+
+		footprint.Total = footprint.VBufferA + footprint.VBufferB + footprint.LightScatteringVolumes + footprint.IntegratedVolume - footprint.AliasedBytes;
+		return footprint;
+	}
+
+	std::string FormatFootprintReport(const XMUINT3& resolution)
+	{
+		std::string report;
+		char line[256];
+
+		snprintf(line, sizeof(line), "Volume %ux%ux%u\n%-10s %-16s %-8s %10s\n", resolution.x, resolution.y, resolution.z, "VBufferB", "Integrated", "Aliased", "Total (MB)");
+		report += line;
+
+		for (UINT vbufferB = 0; vbufferB < VOLUME_VBUFFERB_STORAGE_COUNT; vbufferB++)
+		{
+			for (UINT integrated = 0; integrated < VOLUME_INTEGRATED_STORAGE_COUNT; integrated++)
+			{
+				for (UINT alias = 0; alias < 2; alias++)
+				{
+					const VolumetricMemoryConfig config = {
+						.VBufferBStorage = vbufferB,
+						.IntegratedStorage = integrated,
+						.AliasVBufferAWithIntegrated = alias != 0
+					};
+					const VolumetricMemoryFootprint footprint = CalculateFootprint(config, resolution);
+
+					snprintf(line, sizeof(line), "%-10s %-16s %-8s %10.2f\n",
+						GetVBufferBStorageName(vbufferB),
+						GetIntegratedStorageName(integrated),
+						alias ? "Yes" : "No",
+						static_cast<double>(footprint.Total) / (1024.0 * 1024.0));
+					report += line;
+				}
+			}
+		}
+
+		return report;
+	}
+
+
+	const char* GetVBufferBStorageName(UINT vbufferBStorage)
+	{
+		static const char* names[] = { "Full", "Packed", "Analytic" };
+		static_assert(ARRAYSIZE(names) == VOLUME_VBUFFERB_STORAGE_COUNT);
+		return vbufferBStorage < VOLUME_VBUFFERB_STORAGE_COUNT ? names[vbufferBStorage] : "Invalid";
+	}
+
+	const char* GetIntegratedStorageName(UINT integratedStorage)
+	{
+		static const char* names[] = { "RGBA16F", "R11G11B10F + R16", "R11G11B10F + R8" };
+		static_assert(ARRAYSIZE(names) == VOLUME_INTEGRATED_STORAGE_COUNT);
+		return integratedStorage < VOLUME_INTEGRATED_STORAGE_COUNT ? names[integratedStorage] : "Invalid";
+	}
+}
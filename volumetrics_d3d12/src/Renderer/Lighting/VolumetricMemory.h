@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/VolumetricsHlslCompat.h"
+
+
+// How the froxel volumes are stored
+// The light scattering volumes are always RGBA16F, as they are also the temporal history
+struct VolumetricMemoryConfig
+{
+	UINT VBufferBStorage = VOLUME_VBUFFERB_STORAGE_FULL;			// VOLUME_VBUFFERB_STORAGE_*
+	UINT IntegratedStorage = VOLUME_INTEGRATED_STORAGE_RGBA16F;		// VOLUME_INTEGRATED_STORAGE_*
+
+	// VBufferA is last read by light scattering, and the integrated volume is first written by volume integration,
+	// so the two can share memory within a frame
+	bool AliasVBufferAWithIntegrated = false;
+
+	bool operator==(const VolumetricMemoryConfig& other) const = default;
+};
+
+// Bytes used by the volumes of a configuration
+// Each volume is rounded up to the default placement alignment, as the real allocations are
+struct VolumetricMemoryFootprint
+{
+	UINT64 VBufferA = 0;
+	UINT64 VBufferB = 0;
+	UINT64 LightScatteringVolumes = 0;		// Both of the double-buffered volumes
+	UINT64 IntegratedVolume = 0;			// Scattering and transmittance
+
+	UINT64 AliasedBytes = 0;				// Bytes shared between VBufferA and the integrated volume
+	UINT64 Total = 0;
+};
+
+
+/**
+ *	Formats and memory use of the volumetrics memory configurations.
+ *
+ *	Precision of the reduced formats:
+ *	- Packed VBufferB: see PackEmissionAnisotropy in VolumetricsHlslCompat.h.
+ *	- R11G11B10F scattering has 6 (R, G) and 5 (B) bit mantissas, a relative error of up to 1/128 and 1/64.
+ *	- R16 and R8 transmittance are within 1/131070 and 1/510 of the unclamped transmittance.
+ */
+namespace VolumetricMemory
+{
+	// DXGI_FORMAT_UNKNOWN if VBufferB is not stored
+	DXGI_FORMAT GetVBufferBFormat(UINT vbufferBStorage);
+	DXGI_FORMAT GetIntegratedFormat(UINT integratedStorage);
+	// DXGI_FORMAT_UNKNOWN if the transmittance is stored with the scattering
+	DXGI_FORMAT GetIntegratedTransmittanceFormat(UINT integratedStorage);
+
+	UINT GetBytesPerTexel(DXGI_FORMAT format);
+
+	VolumetricMemoryFootprint CalculateFootprint(const VolumetricMemoryConfig& config, const XMUINT3& resolution);
+
+	// A table of the total memory of every configuration at a resolution
+	std::string FormatFootprintReport(const XMUINT3& resolution);
+
+	const char* GetVBufferBStorageName(UINT vbufferBStorage);
+	const char* GetIntegratedStorageName(UINT integratedStorage);
+}
@@ -2,12 +2,17 @@
 #include "VolumetricRendering.h"
 
 #include <pix3.h>
+#include <chrono>
 
 #include "imgui.h"
 
 #include "LightManager.h"
 #include "IBL.h"
+#include "FroxelSliceTable.h"
 #include "Framework/GuiHelpers.h"
+#include "Framework/Math.h"
+#include "Framework/ThreadPool.h"
+#include "HlslCompat/VolumetricsHlslCompat.h"
 #include "Renderer/D3DGraphicsContext.h"
 
 
@@ -19,6 +24,27 @@ namespace DensityEstimationRootSignature
 		VolumeConstantBuffer,
 		GlobalFogConstantBuffer,
 		VBuffer,
+		FogVolumes,
+		FogVolumeTiles,
+		FogVolumeIndices,
+		ActiveBricks,
+		FogClipmapConstantBuffer,
+		FogClipmap,
+		FogNoiseConstants,
+		FogNoise,
+		FogDensityAtlas,
+		SparseFog,
+		Count
+	};
+}
+
+namespace FogClipmapUpdateRootSignature
+{
+	enum Parameters
+	{
+		GlobalFogConstantBuffer = 0,
+		UpdateConstants,
+		Cascade,
 		Count
 	};
 }
@@ -31,9 +57,12 @@ namespace LightScatteringRootSignature
 		LightConstantBuffer,
 		VolumeConstantBuffer,
 		LightScatteringConstantBuffer,
+		GlobalFogConstantBuffer,
 
 		VBuffer,
 		PointLightBuffer,
+		ClusterLightGrid,
+		ClusterLightIndices,
 		SunSM,
 		SceneDepth,
 
@@ -45,6 +74,8 @@ namespace LightScatteringRootSignature
 		PreviousLightScatteringVolume,
 		PreviousSceneDepth,
 
+		Bricks,
+
 		Count
 	};
 }
@@ -57,6 +88,7 @@ namespace VolumeIntegrationRootSignature
 		VolumeConstantBuffer,
 		LightScatteringVolume,
 		IntegratedVolume,
+		BrickOccupancy,
 		Count
 	};
 }
@@ -77,13 +109,28 @@ namespace ApplyVolumetricsRootSignature
 
 
 VolumetricRendering::VolumetricRendering(LightManager& lightManager)
-	: m_LightManager(&lightManager)
+	: m_ResolutionController(std::vector<XMUINT3>(std::begin(s_ResolutionTiers), std::end(s_ResolutionTiers)))
+	, m_StageTimer(VolumetricResolutionController::StageCount, L"Volumetrics Stage Timer")
+	, m_FogNoiseBaker(ThreadPool::GetDefault())
+	, m_FogVoxelizer(ThreadPool::GetDefault())
+	, m_LightManager(&lightManager)
 {
-	ASSERT(
-		m_VolumeResolution.x % 8 == 0 &&
-		m_VolumeResolution.y % 8 == 0 &&
-		m_VolumeResolution.z % 8 == 0,
-		"Invalid volume resolution");
+	for (const XMUINT3& resolution : s_ResolutionTiers)
+	{
+		ASSERT(
+			resolution.x % 8 == 0 &&
+			resolution.y % 8 == 0 &&
+			resolution.z % 8 == 0,
+			"Invalid volume resolution");
+
+		// Bricks are dispatched along x alone
+		ASSERT((resolution.x / 8) * (resolution.y / 8) * (resolution.z / 8) <= D3D12_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION,
+			"Too many bricks in the volume");
+
+		// The parallel scan holds a column's slices in a fixed number of registers per thread
+		ASSERT(resolution.z <= VOLUME_SCAN_MAX_SLICES, "Too many slices for the parallel scan integration");
+		ASSERT(resolution.z <= VOLUME_MAX_SLICES, "Too many slices for the slice table");
+	}
 
 	m_DispatchGroups = {
 		m_VolumeResolution.x / 8,
@@ -91,6 +138,31 @@ VolumetricRendering::VolumetricRendering(LightManager& lightManager)
 		m_VolumeResolution.z / 8
 	};
 
+	m_FrameTiers.resize(D3DGraphicsContext::GetBackBufferCount(), m_ResolutionController.GetTier());
+
+	// Smoke filling a room, and a cloud of dust
+	m_BakedFogAssets = {
+		{
+			.Mesh = MeshData::CreateUnitCube(),
+			.Scale = XMFLOAT3(4.0f, 1.5f, 3.0f),
+			.Rotation = XMFLOAT3(0.0f, 0.6f, 0.0f),
+			.Position = XMFLOAT3(-8.0f, 1.5f, 6.0f),
+			.Albedo = XMFLOAT3(0.9f, 0.9f, 0.9f),
+			.Extinction = 0.6f
+		},
+		{
+			.Mesh = MeshData::CreateSphere(1.0f, 20, 20),
+			.Scale = XMFLOAT3(2.5f, 1.5f, 2.5f),
+			.Rotation = XMFLOAT3(0.0f, 0.0f, 0.0f),
+			.Position = XMFLOAT3(8.0f, 2.0f, 6.0f),
+			.Albedo = XMFLOAT3(1.0f, 0.8f, 0.6f),
+			.Extinction = 0.8f
+		}
+	};
+
+	// Grids with their borders are 64 texels across, so several fit in the atlas
+	m_FogVoxelizerSettings.Resolution = 64 - 2 * FogDensityAtlas::s_Border;
+
 	CreateResources();
 	CreatePipelines();
 
@@ -101,9 +173,15 @@ VolumetricRendering::VolumetricRendering(LightManager& lightManager)
 
 		.UseTemporalReprojection = 1,
 		.LightScatteringJitterMultiplier = 1.0f,
-		.HistoryWeight = 0.9f
+		.HistoryWeight = 0.9f,
+
+		.DepthDistribution = VOLUME_DEPTH_DISTRIBUTION_LINEAR,
+		.HybridLinearDepth = 10.0f,
+		.HistorySliceCount = m_VolumeResolution.z
 	};
 
+	m_LightManager->SetFroxelGrid(m_VolumeStagingBuffer);
+
 	m_GlobalFogStagingBuffer = 
 	{
 		.Albedo = XMFLOAT3(1.5f, 1.5f, 1.5f),
@@ -114,11 +192,32 @@ VolumetricRendering::VolumetricRendering(LightManager& lightManager)
 		.Radius = 5.0f,
 		.RadiusSmoothing = 3.0f
 	};
+
+	m_FogNoiseStagingBuffer =
+	{
+		.WindVelocity = XMFLOAT3(0.5f, 0.0f, 0.25f),
+		.Frequency = 1.0f / 16.0f,
+
+		.Strength = 0.75f,
+		.WorleyWeight = 0.5f
+	};
+
+	m_FogVolumes.resize(s_MaxFogVolumes);
+	for (auto& volume : m_FogVolumes)
+	{
+		volume.Position = { 0.0f, 1.0f, 0.0f };
+		volume.Albedo = { 1.0f, 1.0f, 1.0f };
+		volume.Extinction = 0.5f;
+	}
 }
 
 VolumetricRendering::~VolumetricRendering()
 {
 	m_Descriptors.Free();
+	m_FogClipmapDescriptors.Free();
+	m_FogNoiseDescriptor.Free();
+	m_FogDensityAtlasDescriptor.Free();
+	m_SparseFogDescriptors.Free();
 	m_LightVolumeSampler.Free();
 }
 
@@ -127,23 +226,131 @@ void VolumetricRendering::CreateResources()
 {
 	const auto device = g_D3DGraphicsContext->GetDevice();
 
+	CreateVolumes();
+	CreateFogClipmap();
+	CreateFogNoise();
+	CreateBakedFog();
+
+	// Create volume sampler
+	m_LightVolumeSampler = g_D3DGraphicsContext->GetSamplerHeap()->Allocate(1);
+	ASSERT(m_LightVolumeSampler.IsValid(), "Failed to alloc!");
+	{
+		D3D12_SAMPLER_DESC desc = {};
+		desc.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+		desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+		desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+		desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+		desc.MipLODBias = 0.0f;
+		desc.MaxAnisotropy = 0;
+		desc.ComparisonFunc = D3D12_COMPARISON_FUNC_ALWAYS;
+		desc.BorderColor[0] = 0.0f;
+		desc.BorderColor[1] = 0.0f;
+		desc.BorderColor[2] = 0.0f;
+		desc.BorderColor[3] = 0.0f;
+		desc.MinLOD = 0.0f;
+		desc.MaxLOD = 0.0f;
+
+		device->CreateSampler(&desc, m_LightVolumeSampler.GetCPUHandle());
+	}
+
+	// Density estimation and light scattering dispatch a thread group per listed brick, with the counts written each frame
+	{
+		D3D12_INDIRECT_ARGUMENT_DESC argument = {};
+		argument.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+
+		D3D12_COMMAND_SIGNATURE_DESC desc = {};
+		desc.ByteStride = sizeof(D3D12_DISPATCH_ARGUMENTS);
+		desc.NumArgumentDescs = 1;
+		desc.pArgumentDescs = &argument;
+
+		THROW_IF_FAIL(device->CreateCommandSignature(&desc, nullptr, IID_PPV_ARGS(&m_DispatchSignature)));
+		m_DispatchSignature->SetName(L"Volumetrics Dispatch Signature");
+
+		m_DispatchArguments.Allocate(device, D3DGraphicsContext::GetBackBufferCount() * DispatchArgsCount, 0, L"Volumetrics Dispatch Arguments");
+	}
+}
+
+void VolumetricRendering::CreateVolumes()
+{
+	const auto device = g_D3DGraphicsContext->GetDevice();
+
 	// Allocate volume resources
 	{
-		const auto desc = CD3DX12_RESOURCE_DESC::Tex3D(
-			m_Format,
-			m_VolumeResolution.x,
-			m_VolumeResolution.y,
-			m_VolumeResolution.z,
-			1,
-			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+		auto VolumeDesc = [this](DXGI_FORMAT format)
+			{
+				return CD3DX12_RESOURCE_DESC::Tex3D(
+					format,
+					m_VolumeResolution.x,
+					m_VolumeResolution.y,
+					m_VolumeResolution.z,
+					1,
+					D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+			};
 
-		m_VBufferA.Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"VBufferA");
-		m_VBufferB.Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"VBufferB");
+		const auto desc = VolumeDesc(m_Format);
+		const auto integratedDesc = VolumeDesc(VolumetricMemory::GetIntegratedFormat(m_MemoryConfig.IntegratedStorage));
 
-		m_LightScatteringVolumes.at(0).Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, CREATE_INDEXED_NAME(L"LSV", 0));
-		m_LightScatteringVolumes.at(1).Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, CREATE_INDEXED_NAME(L"LSV", 1));
+		const DXGI_FORMAT vbufferBFormat = VolumetricMemory::GetVBufferBFormat(m_MemoryConfig.VBufferBStorage);
+		if (vbufferBFormat != DXGI_FORMAT_UNKNOWN)
+		{
+			const auto vbufferBDesc = VolumeDesc(vbufferBFormat);
+			m_VBufferB.Allocate(&vbufferBDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"VBufferB");
+		}
+
+		// Kept when only the memory configuration changes
+		if (!m_LightScatteringVolumes.at(0).GetResource())
+		{
+			m_LightScatteringVolumes.at(0).Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, CREATE_INDEXED_NAME(L"LSV", 0));
+			m_LightScatteringVolumes.at(1).Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, CREATE_INDEXED_NAME(L"LSV", 1));
+
+			// Every brick of the new volumes is cleared the first time they are written
+			const UINT brickCount = (m_VolumeResolution.x / 8) * (m_VolumeResolution.y / 8) * (m_VolumeResolution.z / 8);
+			for (auto& occupancy : m_LightScatteringOccupancy)
+			{
+				occupancy.assign(FroxelOccupancy::GetMaskWordCount(brickCount), ~0u);
+			}
+		}
+
+		const DXGI_FORMAT transmittanceFormat = VolumetricMemory::GetIntegratedTransmittanceFormat(m_MemoryConfig.IntegratedStorage);
+		const auto transmittanceDesc = VolumeDesc(transmittanceFormat);
 
-		m_IntegratedVolume.Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"Integrated Volume");
+		if (m_MemoryConfig.AliasVBufferAWithIntegrated)
+		{
+			// VBufferA starts at the beginning of the heap, and the integrated volume (and its transmittance) overlap it
+			// Neither needs initialising after an aliasing barrier, as every texel is written before it is read
+			const auto vbufferAInfo = device->GetResourceAllocationInfo(0, 1, &desc);
+			const auto integratedInfo = device->GetResourceAllocationInfo(0, 1, &integratedDesc);
+
+			UINT64 heapAlignment = max(vbufferAInfo.Alignment, integratedInfo.Alignment);
+			UINT64 integratedSize = integratedInfo.SizeInBytes;
+			UINT64 transmittanceOffset = 0;
+
+			if (transmittanceFormat != DXGI_FORMAT_UNKNOWN)
+			{
+				const auto transmittanceInfo = device->GetResourceAllocationInfo(0, 1, &transmittanceDesc);
+				transmittanceOffset = Align(integratedInfo.SizeInBytes, transmittanceInfo.Alignment);
+				integratedSize = transmittanceOffset + transmittanceInfo.SizeInBytes;
+				heapAlignment = max(heapAlignment, transmittanceInfo.Alignment);
+			}
+
+			const CD3DX12_HEAP_DESC heapDesc(max(vbufferAInfo.SizeInBytes, integratedSize), D3D12_HEAP_TYPE_DEFAULT, heapAlignment, D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES);
+			THROW_IF_FAIL(device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_AliasedVolumeHeap)));
+			m_AliasedVolumeHeap->SetName(L"Aliased Volume Heap");
+
+			m_VBufferA.AllocatePlaced(m_AliasedVolumeHeap.Get(), 0, &desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"VBufferA");
+			m_IntegratedVolume.AllocatePlaced(m_AliasedVolumeHeap.Get(), 0, &integratedDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"Integrated Volume");
+
+			if (transmittanceFormat != DXGI_FORMAT_UNKNOWN)
+				m_IntegratedTransmittance.AllocatePlaced(m_AliasedVolumeHeap.Get(), transmittanceOffset, &transmittanceDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"Integrated Transmittance");
+		}
+		else
+		{
+			m_VBufferA.Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"VBufferA");
+			m_IntegratedVolume.Allocate(&integratedDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"Integrated Volume");
+
+			if (transmittanceFormat != DXGI_FORMAT_UNKNOWN)
+				m_IntegratedTransmittance.Allocate(&transmittanceDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, L"Integrated Transmittance");
+		}
 	}
 
 
@@ -151,9 +358,9 @@ void VolumetricRendering::CreateResources()
 	m_Descriptors = g_D3DGraphicsContext->GetSRVHeap()->Allocate(DescriptorIndices::DescriptorCount);
 	ASSERT(m_Descriptors.IsValid(), "Failed to alloc!");
 
+	// Views are only created for the volumes that the memory configuration allocates
 	{
 		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Format = m_Format;
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
 		srvDesc.Texture3D.MipLevels = 1;
@@ -162,6 +369,10 @@ void VolumetricRendering::CreateResources()
 
 		auto CreateSRV = [&](const auto& resource, const auto& descriptorIndex)
 			{
+				if (!resource.GetResource())
+					return;
+
+				srvDesc.Format = resource.GetFormat();
 				device->CreateShaderResourceView(resource.GetResource(), &srvDesc, m_Descriptors.GetCPUHandle(descriptorIndex));
 			};
 
@@ -170,11 +381,12 @@ void VolumetricRendering::CreateResources()
 		CreateSRV(m_LightScatteringVolumes.at(0), SRV_LightScatteringVolume0);
 		CreateSRV(m_LightScatteringVolumes.at(1), SRV_LightScatteringVolume1);
 		CreateSRV(m_IntegratedVolume, SRV_IntegratedVolume);
+		CreateSRV(m_IntegratedTransmittance, SRV_IntegratedTransmittance);
+		CreateSRV(m_ResizedHistory, SRV_ResizedHistory);
 	}
 
 	{
 		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-		uavDesc.Format = m_Format;
 		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE3D;
 		uavDesc.Texture3D.MipSlice = 0;
 		uavDesc.Texture3D.FirstWSlice = 0;
@@ -182,6 +394,10 @@ void VolumetricRendering::CreateResources()
 
 		auto CreateUAV = [&](const auto& resource, const auto& descriptorIndex)
 			{
+				if (!resource.GetResource())
+					return;
+
+				uavDesc.Format = resource.GetFormat();
 				device->CreateUnorderedAccessView(resource.GetResource(), nullptr, &uavDesc, m_Descriptors.GetCPUHandle(descriptorIndex));
 			};
 
@@ -190,62 +406,286 @@ void VolumetricRendering::CreateResources()
 		CreateUAV(m_LightScatteringVolumes.at(0), UAV_LightScatteringVolume0);
 		CreateUAV(m_LightScatteringVolumes.at(1), UAV_LightScatteringVolume1);
 		CreateUAV(m_IntegratedVolume, UAV_IntegratedVolume);
+		CreateUAV(m_IntegratedTransmittance, UAV_IntegratedTransmittance);
 	}
+}
 
+void VolumetricRendering::CreateFogClipmap()
+{
+	const auto device = g_D3DGraphicsContext->GetDevice();
 
-	// Create constant buffer
-	m_VolumeConstantBuffer.Allocate(device, D3DGraphicsContext::GetBackBufferCount(), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, L"Volume Constant Buffer");
-	m_GlobalFogConstantBuffer.Allocate(device, D3DGraphicsContext::GetBackBufferCount(), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, L"Global Fog Constant Buffer");
+	// The cascades do not depend on the volume resolution, so they are created once
+	const auto desc = CD3DX12_RESOURCE_DESC::Tex3D(
+		DXGI_FORMAT_R16G16B16A16_FLOAT,
+		s_FogClipmapResolution,
+		s_FogClipmapResolution,
+		s_FogClipmapResolution,
+		1,
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
+	for (UINT cascade = 0; cascade < FOG_CLIPMAP_CASCADE_COUNT; cascade++)
+	{
+		const std::wstring name = L"Fog Clipmap Cascade " + std::to_wstring(cascade);
+		m_FogClipmapCascades.at(cascade).Allocate(&desc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, name.c_str());
+	}
 
-	// Create volume sampler
-	m_LightVolumeSampler = g_D3DGraphicsContext->GetSamplerHeap()->Allocate(1);
-	ASSERT(m_LightVolumeSampler.IsValid(), "Failed to alloc!");
+	m_FogClipmapDescriptors = g_D3DGraphicsContext->GetSRVHeap()->Allocate(FogClipmapDescriptorCount);
+	ASSERT(m_FogClipmapDescriptors.IsValid(), "Failed to alloc!");
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+	srvDesc.Texture3D.MipLevels = 1;
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = desc.Format;
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE3D;
+	uavDesc.Texture3D.WSize = -1;
+
+	for (UINT cascade = 0; cascade < FOG_CLIPMAP_CASCADE_COUNT; cascade++)
 	{
-		D3D12_SAMPLER_DESC desc = {};
-		desc.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
-		desc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
-		desc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
-		desc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
-		desc.MipLODBias = 0.0f;
-		desc.MaxAnisotropy = 0;
-		desc.ComparisonFunc = D3D12_COMPARISON_FUNC_ALWAYS;
-		desc.BorderColor[0] = 0.0f;
-		desc.BorderColor[1] = 0.0f;
-		desc.BorderColor[2] = 0.0f;
-		desc.BorderColor[3] = 0.0f;
-		desc.MinLOD = 0.0f;
-		desc.MaxLOD = 0.0f;
+		ID3D12Resource* resource = m_FogClipmapCascades.at(cascade).GetResource();
+		device->CreateShaderResourceView(resource, &srvDesc, m_FogClipmapDescriptors.GetCPUHandle(SRV_FogClipmap0 + cascade));
+		device->CreateUnorderedAccessView(resource, nullptr, &uavDesc, m_FogClipmapDescriptors.GetCPUHandle(UAV_FogClipmap0 + cascade));
+	}
 
-		device->CreateSampler(&desc, m_LightVolumeSampler.GetCPUHandle());
+	// Every voxel is baked on the first frame
+	m_FogClipmapPlanner.Invalidate();
+}
+
+void VolumetricRendering::CreateFogNoise()
+{
+	const auto device = g_D3DGraphicsContext->GetDevice();
+
+	m_FogNoiseBaker.LoadOrBake(m_FogNoiseDesc, s_FogNoiseCacheDirectory);
+
+	// The texture of a previous bake may still be in use by frames in flight
+	if (m_FogNoiseTexture.GetResource())
+	{
+		g_D3DGraphicsContext->DeferRelease(ComPtr<IUnknown>(m_FogNoiseTexture.GetResource()));
+		m_FogNoiseTexture = Texture();
+		m_FogNoiseDescriptor.Free();
 	}
+
+	const UINT resolution = m_FogNoiseDesc.Resolution;
+	const auto desc = CD3DX12_RESOURCE_DESC::Tex3D(DXGI_FORMAT_R8G8_UNORM, resolution, resolution, resolution, 1);
+	m_FogNoiseTexture.Allocate(&desc, D3D12_RESOURCE_STATE_COPY_DEST, L"Fog Noise");
+
+	m_FogNoiseDescriptor = g_D3DGraphicsContext->GetSRVHeap()->Allocate(1);
+	ASSERT(m_FogNoiseDescriptor.IsValid(), "Failed to alloc!");
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+	srvDesc.Texture3D.MipLevels = 1;
+	device->CreateShaderResourceView(m_FogNoiseTexture.GetResource(), &srvDesc, m_FogNoiseDescriptor.GetCPUHandle());
+
+	// The texels are copied on the next frame's command list
+	m_FogNoiseUploadPending = true;
+}
+
+void VolumetricRendering::CreateBakedFog()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	// Signed distances are clamped beyond the band, so the fade has to fit within it
+	FogVoxelizer::Settings settings = m_FogVoxelizerSettings;
+	settings.Band = max(settings.Band, m_BakedFogFalloff);
+
+	m_FogDensityAtlas.Clear();
+	m_SparseBrickAtlas.Clear();
+	m_SparseFogVolumes.clear();
+	m_BakedFogVolumes.clear();
+
+	FogVoxelizer::Grid grid;
+	std::vector<UINT8> density;
+	for (const BakedFogAsset& asset : m_BakedFogAssets)
+	{
+		m_FogVoxelizer.Voxelize(asset.Mesh, XMMatrixScaling(asset.Scale.x, asset.Scale.y, asset.Scale.z), settings, grid);
+		grid.GetDensity(m_BakedFogFalloff * grid.VoxelSize, density);
+
+		FogVolume volume;
+		if (m_UseSparseBakedFog)
+		{
+			SparseFogVolume sparseVolume;
+			sparseVolume.Build(grid.Dimensions, density.data(), grid.Min, grid.VoxelSize);
+
+			SparseBrickAtlas::Entry entry;
+			if (!m_SparseBrickAtlas.Add(sparseVolume, entry))
+			{
+				LOG_WARN("Baked fog: The sparse brick atlas is full, so a {}x{}x{} grid of {} bricks was left out", grid.Dimensions.x, grid.Dimensions.y, grid.Dimensions.z, sparseVolume.GetBrickCount());
+				continue;
+			}
+
+			volume.Shape = FOG_VOLUME_SHAPE_SPARSE;
+			volume.AtlasOffset = entry.AtlasOffset;
+			volume.AtlasScale = entry.AtlasScale;
+			m_SparseFogVolumes.push_back(std::move(sparseVolume));
+		}
+		else
+		{
+			FogDensityAtlas::Entry entry;
+			if (!m_FogDensityAtlas.Add(grid.Dimensions, density.data(), entry))
+			{
+				LOG_WARN("Baked fog: The density atlas is full, so a {}x{}x{} grid was left out", grid.Dimensions.x, grid.Dimensions.y, grid.Dimensions.z);
+				continue;
+			}
+
+			volume.Shape = FOG_VOLUME_SHAPE_BAKED;
+			volume.AtlasOffset = entry.UVWOffset;
+			volume.AtlasScale = entry.UVWScale;
+		}
+
+		// The volume's box is the grid, which is axis aligned before the asset is rotated
+		const XMFLOAT3 gridMax = grid.GetMax();
+		const XMVECTOR gridCenter = XMVectorSet(0.5f * (grid.Min.x + gridMax.x), 0.5f * (grid.Min.y + gridMax.y), 0.5f * (grid.Min.z + gridMax.z), 0.0f);
+		const XMMATRIX rotation = XMMatrixRotationRollPitchYaw(asset.Rotation.x, asset.Rotation.y, asset.Rotation.z);
+
+		XMStoreFloat3(&volume.Position, XMVectorAdd(XMLoadFloat3(&asset.Position), XMVector3TransformNormal(gridCenter, rotation)));
+		volume.Rotation = asset.Rotation;
+		volume.Extents = { 0.5f * (gridMax.x - grid.Min.x), 0.5f * (gridMax.y - grid.Min.y), 0.5f * (gridMax.z - grid.Min.z) };
+		volume.Albedo = asset.Albedo;
+		volume.Extinction = asset.Extinction;
+		m_BakedFogVolumes.push_back(volume);
+	}
+
+	m_BakedFogMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	LOG_INFO("Baked fog: Voxelized {} meshes in {:.2f} ms", m_BakedFogVolumes.size(), m_BakedFogMilliseconds);
+
+	// The textures of a previous bake may still be in use by frames in flight
+	for (Texture* texture : { &m_FogDensityAtlasTexture, &m_SparseFogBrickTexture, &m_SparseFogIndirectionTexture })
+	{
+		if (texture->GetResource())
+		{
+			g_D3DGraphicsContext->DeferRelease(ComPtr<IUnknown>(texture->GetResource()));
+			*texture = Texture();
+		}
+	}
+	m_FogDensityAtlasDescriptor.Free();
+	m_SparseFogDescriptors.Free();
+
+	m_FogDensityAtlasDescriptor = g_D3DGraphicsContext->GetSRVHeap()->Allocate(1);
+	m_SparseFogDescriptors = g_D3DGraphicsContext->GetSRVHeap()->Allocate(SparseFogDescriptorCount);
+	ASSERT(m_FogDensityAtlasDescriptor.IsValid() && m_SparseFogDescriptors.IsValid(), "Failed to alloc!");
+
+	// Only the textures of the format in use are created, and the others are bound as null views
+	if (m_UseSparseBakedFog)
+	{
+		CreateVolumeTexture(m_SparseFogIndirectionTexture, DXGI_FORMAT_R32_UINT, m_SparseBrickAtlas.GetIndirectionDimensions(), L"Sparse Fog Indirection", m_SparseFogDescriptors.GetCPUHandle(SRV_SparseFogIndirection));
+		CreateVolumeTexture(m_SparseFogBrickTexture, DXGI_FORMAT_R8_UNORM, m_SparseBrickAtlas.GetBrickTextureDimensions(), L"Sparse Fog Bricks", m_SparseFogDescriptors.GetCPUHandle(SRV_SparseFogBricks));
+		CreateVolumeTexture(m_FogDensityAtlasTexture, DXGI_FORMAT_R8_UNORM, { 0, 0, 0 }, nullptr, m_FogDensityAtlasDescriptor.GetCPUHandle());
+	}
+	else
+	{
+		CreateVolumeTexture(m_FogDensityAtlasTexture, DXGI_FORMAT_R8_UNORM, m_FogDensityAtlas.GetDimensions(), L"Fog Density Atlas", m_FogDensityAtlasDescriptor.GetCPUHandle());
+		CreateVolumeTexture(m_SparseFogIndirectionTexture, DXGI_FORMAT_R32_UINT, { 0, 0, 0 }, nullptr, m_SparseFogDescriptors.GetCPUHandle(SRV_SparseFogIndirection));
+		CreateVolumeTexture(m_SparseFogBrickTexture, DXGI_FORMAT_R8_UNORM, { 0, 0, 0 }, nullptr, m_SparseFogDescriptors.GetCPUHandle(SRV_SparseFogBricks));
+	}
+
+	// The texels are copied on the next frame's command list
+	m_BakedFogUploadPending = true;
+}
+
+void VolumetricRendering::CreateVolumeTexture(Texture& texture, DXGI_FORMAT format, const XMUINT3& dimensions, const wchar_t* name, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle)
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = format;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+	srvDesc.Texture3D.MipLevels = 1;
+
+	// A null view reads as 0
+	if (dimensions.x == 0 || dimensions.y == 0 || dimensions.z == 0)
+	{
+		g_D3DGraphicsContext->GetDevice()->CreateShaderResourceView(nullptr, &srvDesc, srvHandle);
+		return;
+	}
+
+	const auto desc = CD3DX12_RESOURCE_DESC::Tex3D(format, dimensions.x, dimensions.y, static_cast<UINT16>(dimensions.z), 1);
+	texture.Allocate(&desc, D3D12_RESOURCE_STATE_COPY_DEST, name);
+
+	g_D3DGraphicsContext->GetDevice()->CreateShaderResourceView(texture.GetResource(), &srvDesc, srvHandle);
 }
 
 void VolumetricRendering::CreatePipelines()
 {
+	// The memory configuration is compiled into the shaders
+	const std::vector<std::wstring> defines = {
+		L"VOLUME_VBUFFERB_STORAGE=" + std::to_wstring(m_MemoryConfig.VBufferBStorage),
+		L"VOLUME_INTEGRATED_STORAGE=" + std::to_wstring(m_MemoryConfig.IntegratedStorage)
+	};
+
+	// VBufferB is left out of the VBuffer tables when it is not stored
+	const UINT vbufferCount = m_MemoryConfig.VBufferBStorage != VOLUME_VBUFFERB_STORAGE_ANALYTIC ? 2 : 1;
+	const bool separateTransmittance = VolumetricMemory::GetIntegratedTransmittanceFormat(m_MemoryConfig.IntegratedStorage) != DXGI_FORMAT_UNKNOWN;
+
 	{
-		CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
-		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 0);
+		CD3DX12_DESCRIPTOR_RANGE1 ranges[5];
+		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, vbufferCount, 0);
+		ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, FOG_CLIPMAP_CASCADE_COUNT, 4); // Fog clipmap cascades
+		ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 4 + FOG_CLIPMAP_CASCADE_COUNT); // Fog noise
+		ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 5 + FOG_CLIPMAP_CASCADE_COUNT); // Fog density atlas
+		ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, SparseFogDescriptorCount, 6 + FOG_CLIPMAP_CASCADE_COUNT); // Sparse fog indirection and bricks
 
 		CD3DX12_ROOT_PARAMETER1 rootParams[DensityEstimationRootSignature::Count];
 		rootParams[DensityEstimationRootSignature::PassConstantBuffer].InitAsConstantBufferView(0);
 		rootParams[DensityEstimationRootSignature::VolumeConstantBuffer].InitAsConstantBufferView(1);
 		rootParams[DensityEstimationRootSignature::GlobalFogConstantBuffer].InitAsConstantBufferView(2);
 		rootParams[DensityEstimationRootSignature::VBuffer].InitAsDescriptorTable(1, &ranges[0]);
+		rootParams[DensityEstimationRootSignature::FogVolumes].InitAsShaderResourceView(0);
+		rootParams[DensityEstimationRootSignature::FogVolumeTiles].InitAsShaderResourceView(1);
+		rootParams[DensityEstimationRootSignature::FogVolumeIndices].InitAsShaderResourceView(2);
+		rootParams[DensityEstimationRootSignature::ActiveBricks].InitAsShaderResourceView(3);
+		rootParams[DensityEstimationRootSignature::FogClipmapConstantBuffer].InitAsConstantBufferView(3);
+		rootParams[DensityEstimationRootSignature::FogClipmap].InitAsDescriptorTable(1, &ranges[1]);
+		rootParams[DensityEstimationRootSignature::FogNoiseConstants].InitAsConstants(SizeOfInUint32(FogNoiseConstants), 4);
+		rootParams[DensityEstimationRootSignature::FogNoise].InitAsDescriptorTable(1, &ranges[2]);
+		rootParams[DensityEstimationRootSignature::FogDensityAtlas].InitAsDescriptorTable(1, &ranges[3]);
+		rootParams[DensityEstimationRootSignature::SparseFog].InitAsDescriptorTable(1, &ranges[4]);
+
+		// The cascades are stored toroidally, so filtering wraps around their edges
+		auto sampler = CD3DX12_STATIC_SAMPLER_DESC(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR, D3D12_TEXTURE_ADDRESS_MODE_WRAP, D3D12_TEXTURE_ADDRESS_MODE_WRAP, D3D12_TEXTURE_ADDRESS_MODE_WRAP);
+		// The noise tiles
+		auto noiseSampler = CD3DX12_STATIC_SAMPLER_DESC(1, D3D12_FILTER_MIN_MAG_MIP_LINEAR, D3D12_TEXTURE_ADDRESS_MODE_WRAP, D3D12_TEXTURE_ADDRESS_MODE_WRAP, D3D12_TEXTURE_ADDRESS_MODE_WRAP);
+		// The atlas regions are surrounded by empty texels, so clamping only matters at the edges of the atlas
+		auto atlasSampler = CD3DX12_STATIC_SAMPLER_DESC(2, D3D12_FILTER_MIN_MAG_MIP_LINEAR, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
 
 		D3DComputePipelineDesc psoDesc = {
 			.NumRootParameters = ARRAYSIZE(rootParams),
 			.RootParameters = rootParams,
 			.Shader = L"assets/shaders/compute/volumetrics/density_estimation_cs.hlsl",
-			.EntryPoint = L"main"
+			.EntryPoint = L"main",
+			.StaticSamplers{ sampler, noiseSampler, atlasSampler },
+			.Defines = defines
 		};
 
 		m_DensityEstimationPipeline.Create(&psoDesc);
 	}
 
+	{
+		CD3DX12_DESCRIPTOR_RANGE1 ranges[1];
+		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0); // Cascade
+
+		CD3DX12_ROOT_PARAMETER1 rootParams[FogClipmapUpdateRootSignature::Count];
+		rootParams[FogClipmapUpdateRootSignature::GlobalFogConstantBuffer].InitAsConstantBufferView(0);
+		rootParams[FogClipmapUpdateRootSignature::UpdateConstants].InitAsConstants(SizeOfInUint32(FogClipmapUpdateConstants), 1);
+		rootParams[FogClipmapUpdateRootSignature::Cascade].InitAsDescriptorTable(1, &ranges[0]);
+
+		D3DComputePipelineDesc psoDesc = {
+			.NumRootParameters = ARRAYSIZE(rootParams),
+			.RootParameters = rootParams,
+			.Shader = L"assets/shaders/compute/volumetrics/fog_clipmap_update_cs.hlsl",
+			.EntryPoint = L"main"
+		};
+
+		m_FogClipmapUpdatePipeline.Create(&psoDesc);
+	}
+
 	{
 		CD3DX12_DESCRIPTOR_RANGE1 ranges[7];
-		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 0); // VBuffer
+		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, vbufferCount, 0); // VBuffer
 		ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3); // Sun SM
 		ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 4); // Scene depth
 		ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 2, 0); // Shadow samplers
@@ -259,9 +699,12 @@ void VolumetricRendering::CreatePipelines()
 		rootParams[LightScatteringRootSignature::LightConstantBuffer].InitAsConstantBufferView(1);
 		rootParams[LightScatteringRootSignature::VolumeConstantBuffer].InitAsConstantBufferView(2);
 		rootParams[LightScatteringRootSignature::LightScatteringConstantBuffer].InitAsConstants(SizeOfInUint32(LightScatteringConstantBuffer), 3);
+		rootParams[LightScatteringRootSignature::GlobalFogConstantBuffer].InitAsConstantBufferView(4);
 
 		rootParams[LightScatteringRootSignature::VBuffer].InitAsDescriptorTable(1, &ranges[0]);
 		rootParams[LightScatteringRootSignature::PointLightBuffer].InitAsShaderResourceView(2);
+		rootParams[LightScatteringRootSignature::ClusterLightGrid].InitAsShaderResourceView(5);
+		rootParams[LightScatteringRootSignature::ClusterLightIndices].InitAsShaderResourceView(6);
 		rootParams[LightScatteringRootSignature::SunSM].InitAsDescriptorTable(1, &ranges[1]);
 		rootParams[LightScatteringRootSignature::SceneDepth].InitAsDescriptorTable(1, &ranges[2]);
 
@@ -272,6 +715,8 @@ void VolumetricRendering::CreatePipelines()
 		rootParams[LightScatteringRootSignature::PreviousLightScatteringVolume].InitAsDescriptorTable(1, &ranges[5]);
 		rootParams[LightScatteringRootSignature::PreviousSceneDepth].InitAsDescriptorTable(1, &ranges[6]);
 
+		rootParams[LightScatteringRootSignature::Bricks].InitAsShaderResourceView(7);
+
 		auto sampler = CD3DX12_STATIC_SAMPLER_DESC(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
 		sampler.RegisterSpace = 1;
 
@@ -280,7 +725,8 @@ void VolumetricRendering::CreatePipelines()
 			.RootParameters = rootParams,
 			.Shader = L"assets/shaders/compute/volumetrics/light_scattering_cs.hlsl",
 			.EntryPoint = L"main",
-			.StaticSamplers{ sampler }
+			.StaticSamplers{ sampler },
+			.Defines = defines
 		};
 
 		m_LightScatteringPipeline.Create(&psoDesc);
@@ -289,44 +735,52 @@ void VolumetricRendering::CreatePipelines()
 	{
 		CD3DX12_DESCRIPTOR_RANGE1 ranges[2];
 		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
-		ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+		ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, separateTransmittance ? 2 : 1, 0); // Integrated volume (and transmittance)
 
 		CD3DX12_ROOT_PARAMETER1 rootParams[VolumeIntegrationRootSignature::Count];
 		rootParams[VolumeIntegrationRootSignature::PassConstantBuffer].InitAsConstantBufferView(0);
 		rootParams[VolumeIntegrationRootSignature::VolumeConstantBuffer].InitAsConstantBufferView(1);
 		rootParams[VolumeIntegrationRootSignature::LightScatteringVolume].InitAsDescriptorTable(1, &ranges[0]);
 		rootParams[VolumeIntegrationRootSignature::IntegratedVolume].InitAsDescriptorTable(1, &ranges[1]);
+		rootParams[VolumeIntegrationRootSignature::BrickOccupancy].InitAsShaderResourceView(1);
 
 		D3DComputePipelineDesc psoDesc = {
 			.NumRootParameters = ARRAYSIZE(rootParams),
 			.RootParameters = rootParams,
 			.Shader = L"assets/shaders/compute/volumetrics/volume_integration_cs.hlsl",
-			.EntryPoint = L"main"
+			.EntryPoint = L"main",
+			.Defines = defines
 		};
 
 		m_VolumeIntegrationPipeline.Create(&psoDesc);
+
+		// The parallel scan integration has the same bindings
+		psoDesc.Shader = L"assets/shaders/compute/volumetrics/volume_integration_scan_cs.hlsl";
+		m_VolumeIntegrationScanPipeline.Create(&psoDesc);
 	}
 
 	{
-		CD3DX12_DESCRIPTOR_RANGE1 ranges[4];
-		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
-		ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
-		ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 0);
-		ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+		CD3DX12_DESCRIPTOR_RANGE1 ranges[5];
+		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0); // Integrated volume
+		ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2); // Integrated transmittance, follows the integrated volume in the table
+		ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
+		ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 0);
+		ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
 
 		CD3DX12_ROOT_PARAMETER1 rootParams[ApplyVolumetricsRootSignature::Count];
 		rootParams[ApplyVolumetricsRootSignature::PassConstantBuffer].InitAsConstantBufferView(0);
 		rootParams[ApplyVolumetricsRootSignature::VolumeConstantBuffer].InitAsConstantBufferView(1);
-		rootParams[ApplyVolumetricsRootSignature::IntegratedVolume].InitAsDescriptorTable(1, &ranges[0]);
-		rootParams[ApplyVolumetricsRootSignature::DepthBuffer].InitAsDescriptorTable(1, &ranges[1]);
-		rootParams[ApplyVolumetricsRootSignature::IntegratedVolumeSampler].InitAsDescriptorTable(1, &ranges[2]);
-		rootParams[ApplyVolumetricsRootSignature::Output].InitAsDescriptorTable(1, &ranges[3]);
+		rootParams[ApplyVolumetricsRootSignature::IntegratedVolume].InitAsDescriptorTable(separateTransmittance ? 2 : 1, &ranges[0]);
+		rootParams[ApplyVolumetricsRootSignature::DepthBuffer].InitAsDescriptorTable(1, &ranges[2]);
+		rootParams[ApplyVolumetricsRootSignature::IntegratedVolumeSampler].InitAsDescriptorTable(1, &ranges[3]);
+		rootParams[ApplyVolumetricsRootSignature::Output].InitAsDescriptorTable(1, &ranges[4]);
 
 		D3DComputePipelineDesc psoDesc = {
 			.NumRootParameters = ARRAYSIZE(rootParams),
 			.RootParameters = rootParams,
 			.Shader = L"assets/shaders/compute/volumetrics/apply_volumetrics_cs.hlsl",
-			.EntryPoint = L"main"
+			.EntryPoint = L"main",
+			.Defines = defines
 		};
 
 		m_ApplyVolumetricsPipeline.Create(&psoDesc);
@@ -334,16 +788,274 @@ void VolumetricRendering::CreatePipelines()
 }
 
 
+void VolumetricRendering::UpdateDynamicResolution()
+{
+	// The timings read here are from the last frame that used the current frame resources
+	m_StageTimer.BeginFrame();
+
+	const UINT frameIndex = g_D3DGraphicsContext->GetCurrentBackBuffer();
+
+	VolumetricResolutionController::StageTimes stageTimes;
+	bool validTimes = true;
+	for (UINT stage = 0; stage < VolumetricResolutionController::StageCount; stage++)
+	{
+		stageTimes.at(stage) = m_StageTimer.GetMilliseconds(stage);
+		validTimes &= stageTimes.at(stage) >= 0.0f;
+	}
+
+	if (m_UseDynamicResolution && validTimes)
+	{
+		m_ResolutionController.Update(stageTimes, m_FrameTiers.at(frameIndex));
+	}
+
+	// The tier can also be changed directly from the GUI
+	const XMUINT3& resolution = m_ResolutionController.GetResolution();
+	if (resolution.x != m_VolumeResolution.x || resolution.y != m_VolumeResolution.y || resolution.z != m_VolumeResolution.z)
+	{
+		ReallocateVolumes(resolution);
+	}
+
+	m_FrameTiers.at(frameIndex) = m_ResolutionController.GetTier();
+}
+
+void VolumetricRendering::UpdateMemoryConfig()
+{
+	if (m_RequestedMemoryConfig == m_MemoryConfig)
+		return;
+
+	m_MemoryConfig = m_RequestedMemoryConfig;
+
+	// The old pipelines may still be in use by frames in flight
+	for (const D3DComputePipeline* pipeline : { &m_DensityEstimationPipeline, &m_LightScatteringPipeline, &m_VolumeIntegrationPipeline, &m_VolumeIntegrationScanPipeline, &m_ApplyVolumetricsPipeline, &m_FogClipmapUpdatePipeline })
+	{
+		g_D3DGraphicsContext->DeferRelease(ComPtr<IUnknown>(pipeline->GetPipelineState()));
+		g_D3DGraphicsContext->DeferRelease(ComPtr<IUnknown>(pipeline->GetRootSignature()));
+	}
+
+	ReallocateVolumes(m_VolumeResolution);
+	CreatePipelines();
+}
+
+void VolumetricRendering::ReallocateVolumes(const XMUINT3& resolution)
+{
+	ASSERT(resolution.x % 8 == 0 && resolution.y % 8 == 0 && resolution.z % 8 == 0, "Invalid volume resolution");
+
+	const bool resized = resolution.x != m_VolumeResolution.x || resolution.y != m_VolumeResolution.y || resolution.z != m_VolumeResolution.z;
+
+	// Frames still in flight may reference the old volumes, so hand them to the context to be released once
+	// the current frame's fence has completed, rather than waiting for the GPU here
+	auto DeferRelease = [](Texture& texture)
+		{
+			if (texture.GetResource())
+				g_D3DGraphicsContext->DeferRelease(ComPtr<IUnknown>(texture.GetResource()));
+			texture = Texture();
+		};
+
+	// The light scattering volumes do not depend on the memory configuration, so they are only replaced on a resize
+	if (resized)
+	{
+		// The latest light scattering volume becomes the history for the first frame at the new resolution
+		// This runs before the volumes are flipped, so the latest is still the current volume
+		// Temporal history is sampled with normalized coordinates, so it does not need to match the new resolution
+		DeferRelease(m_ResizedHistory);
+		m_ResizedHistory = std::move(GetCurrentLSV());
+		m_ResizedHistoryResolution = m_VolumeResolution;
+
+		DeferRelease(GetPreviousLSV());
+	}
+
+	DeferRelease(m_VBufferA);
+	DeferRelease(m_VBufferB);
+	DeferRelease(m_IntegratedVolume);
+	DeferRelease(m_IntegratedTransmittance);
+
+	if (m_AliasedVolumeHeap)
+	{
+		g_D3DGraphicsContext->DeferRelease(m_AliasedVolumeHeap);
+		m_AliasedVolumeHeap.Reset();
+	}
+
+	// Descriptor frees are deferred until the GPU has finished with them
+	m_Descriptors.Free();
+
+	m_VolumeResolution = resolution;
+	m_DispatchGroups = {
+		m_VolumeResolution.x / 8,
+		m_VolumeResolution.y / 8,
+		m_VolumeResolution.z / 8
+	};
+
+	CreateVolumes();
+
+	m_VolumeStagingBuffer.VolumeResolution = m_VolumeResolution;
+	m_LightManager->SetFroxelGrid(m_VolumeStagingBuffer);
+
+	LOG_INFO("Volumetrics: Reallocated volumes at {}x{}x{} ({:.2f} MB)", m_VolumeResolution.x, m_VolumeResolution.y, m_VolumeResolution.z,
+		static_cast<double>(VolumetricMemory::CalculateFootprint(m_MemoryConfig, m_VolumeResolution).Total) / (1024.0 * 1024.0));
+}
+
+
+void VolumetricRendering::UpdateFogVolumes(const RenderVolumetricsParams& params)
+{
+	// Density is sampled at the start of each froxel slice
+	m_FroxelSliceDepths.resize(m_VolumeResolution.z + 1);
+	for (UINT i = 0; i <= m_VolumeResolution.z; i++)
+	{
+		m_FroxelSliceDepths.at(i) = Volumetrics::ZSliceToFroxelDepth(static_cast<float>(i), params.NearPlane, m_VolumeStagingBuffer.MaxVolumeDistance,
+			m_VolumeResolution.z, m_VolumeStagingBuffer.DepthDistribution, m_VolumeStagingBuffer.HybridLinearDepth);
+	}
+
+	// The tiles are the density estimation thread groups, so the grid follows the volume resolution
+	m_FogVolumeBinner.SetFroxelGrid(m_VolumeResolution, m_FroxelSliceDepths.data(), params.Projection);
+	// The baked volumes follow the scattered ones
+	m_FrameFogVolumes.assign(m_FogVolumes.begin(), m_FogVolumes.begin() + m_FogVolumeCount);
+	if (m_UseBakedFog)
+	{
+		m_FrameFogVolumes.insert(m_FrameFogVolumes.end(), m_BakedFogVolumes.begin(), m_BakedFogVolumes.end());
+	}
+	const UINT volumeCount = static_cast<UINT>(m_FrameFogVolumes.size());
+
+	m_FogVolumeBinner.SetVolumes(m_FrameFogVolumes.data(), volumeCount, params.View);
+	m_FogVolumeBinner.BinVolumes(ThreadPool::GetDefault());
+
+	const auto uploadAllocator = g_D3DGraphicsContext->GetFrameUploadAllocator();
+
+	// Always upload at least one element so that the root SRVs point at valid memory
+	// The GPU form is built straight into upload memory
+	const UploadAllocation volumes = uploadAllocator->Allocate(max(volumeCount, 1u) * sizeof(FogVolumeGPUData));
+	ASSERT(volumes.IsValid(), "Failed to allocate fog volumes");
+
+	FogVolumeGPUData* volumeData = reinterpret_cast<FogVolumeGPUData*>(volumes.CPUAddress);
+	for (UINT i = 0; i < volumeCount; i++)
+	{
+		volumeData[i] = m_FrameFogVolumes.at(i).GetGPUData();
+	}
+
+	const auto& tileVolumeRanges = m_FogVolumeBinner.GetTileVolumeRanges();
+	const auto& volumeIndices = m_FogVolumeBinner.GetVolumeIndices();
+
+	const UINT tileCount = static_cast<UINT>(tileVolumeRanges.size());
+	const UINT indexCount = min(static_cast<UINT>(volumeIndices.size()), s_MaxFogVolumeIndices);
+
+	const UploadAllocation tiles = uploadAllocator->AllocateElements(tileVolumeRanges.data(), tileCount);
+	const UploadAllocation indices = uploadAllocator->Allocate(max(indexCount, 1u) * sizeof(UINT));
+	ASSERT(tiles.IsValid() && indices.IsValid(), "Failed to allocate fog volume lists");
+
+	if (indexCount > 0)
+	{
+		memcpy(indices.CPUAddress, volumeIndices.data(), indexCount * sizeof(UINT));
+	}
+
+	// Lists that run past the limit are cut short
+	if (volumeIndices.size() > s_MaxFogVolumeIndices)
+	{
+		m_FogVolumeBinner.TruncateTileVolumeRanges(s_MaxFogVolumeIndices, reinterpret_cast<XMUINT2*>(tiles.CPUAddress));
+	}
+
+	m_FogVolumesAddress = volumes.GPUAddress;
+	m_FogVolumeTilesAddress = tiles.GPUAddress;
+	m_FogVolumeIndicesAddress = indices.GPUAddress;
+}
+
+void VolumetricRendering::ScatterFogVolumes()
+{
+	for (UINT i = 0; i < m_FogVolumeCount; i++)
+	{
+		auto& volume = m_FogVolumes.at(i);
+
+		// Baked volumes need a region of the density atlas, so only the analytic shapes are scattered
+		volume.Shape = static_cast<UINT>(Random::Int(FOG_VOLUME_SHAPE_ANALYTIC_COUNT - 1));
+		volume.Position = {
+			Random::Float(-m_FogVolumeScatterRadius, m_FogVolumeScatterRadius),
+			Random::Float(0.0f, m_FogVolumeScatterHeight),
+			Random::Float(-m_FogVolumeScatterRadius, m_FogVolumeScatterRadius)
+		};
+		volume.Rotation = { Random::Float(-XM_PI, XM_PI), Random::Float(-XM_PI, XM_PI), Random::Float(-XM_PI, XM_PI) };
+		volume.Extents = { Random::Float(0.5f, 3.0f), Random::Float(0.5f, 3.0f), Random::Float(0.5f, 3.0f) };
+
+		volume.Albedo = { Random::NormalizedFloat(), Random::NormalizedFloat(), Random::NormalizedFloat() };
+		volume.Extinction = Random::Float(0.1f, 1.0f);
+		volume.Emission = { 0.0f, 0.0f, 0.0f };
+		volume.Anisotropy = Random::Float(-0.5f, 0.9f);
+		volume.Falloff = Random::Float(0.1f, 0.5f);
+	}
+}
+
+void VolumetricRendering::UpdateFroxelOccupancy(const RenderVolumetricsParams& params)
+{
+	// The bricks are the tiles that the fog volumes were just binned into
+	if (m_UseFroxelOccupancy)
+	{
+		// Filtering the clipmap spreads the global fog by up to a voxel of the coarsest cascade
+		const float globalFogMargin = m_UseFogClipmap ? m_FogClipmapPlanner.GetVoxelSize(FOG_CLIPMAP_CASCADE_COUNT - 1) : 0.0f;
+		m_FroxelOccupancy.Classify(m_FogVolumeBinner, m_GlobalFogStagingBuffer, params.View, ThreadPool::GetDefault(), globalFogMargin);
+	}
+	else
+	{
+		m_FroxelOccupancy.SetAllActive(m_FogVolumeBinner.GetTileGridDimensions());
+	}
+
+	// Light scattering also clears the bricks that this volume was last written with, but that are no longer active
+	// Density estimation reads the same list, and only dispatches the active bricks at its start
+	const auto& activeBricks = m_FroxelOccupancy.GetActiveBricks();
+	m_LightScatteringBricks.assign(activeBricks.begin(), activeBricks.end());
+
+	std::vector<UINT>& writtenOccupancy = m_LightScatteringOccupancy.at(m_CurrentLightScatteringVolume);
+	m_FroxelOccupancy.GetDeactivatedBricks(writtenOccupancy, m_LightScatteringBricks);
+	writtenOccupancy = m_FroxelOccupancy.GetMask();
+
+	const UINT activeBrickCount = m_FroxelOccupancy.GetActiveBrickCount();
+	const UINT brickCount = static_cast<UINT>(m_LightScatteringBricks.size());
+	m_ClearedBrickCount = brickCount - activeBrickCount;
+	m_VolumeStagingBuffer.ActiveBrickCount = activeBrickCount;
+
+	const auto uploadAllocator = g_D3DGraphicsContext->GetFrameUploadAllocator();
+
+	// Always upload at least one element so that the root SRV points at valid memory
+	const UploadAllocation bricks = uploadAllocator->Allocate(max(brickCount, 1u) * sizeof(UINT));
+	const UploadAllocation mask = uploadAllocator->AllocateElements(m_FroxelOccupancy.GetMask().data(), static_cast<UINT>(m_FroxelOccupancy.GetMask().size()));
+	ASSERT(bricks.IsValid() && mask.IsValid(), "Failed to allocate froxel bricks");
+
+	if (brickCount > 0)
+	{
+		memcpy(bricks.CPUAddress, m_LightScatteringBricks.data(), brickCount * sizeof(UINT));
+	}
+
+	m_BricksAddress = bricks.GPUAddress;
+	m_BrickOccupancyAddress = mask.GPUAddress;
+
+	// The arguments of this frame were last read by the frame that used the same back buffer, which has completed
+	const UINT firstArgument = g_D3DGraphicsContext->GetCurrentBackBuffer() * DispatchArgsCount;
+	m_DispatchArguments.CopyElement(firstArgument + DispatchArgs_DensityEstimation, { activeBrickCount, 1, 1 });
+	m_DispatchArguments.CopyElement(firstArgument + DispatchArgs_LightScattering, { brickCount, 1, 1 });
+}
+
+
 void VolumetricRendering::RenderVolumetrics(const RenderVolumetricsParams& params)
 {
 	const auto commandList = g_D3DGraphicsContext->GetCommandList();
 
+	UpdateMemoryConfig();
+	UpdateDynamicResolution();
+
+	// Binned after any change of resolution, as the tiles follow the volume
+	UpdateFogVolumes(params);
+
 	// Flip previous and current volume resources
 	m_CurrentLightScatteringVolume = 1 - m_CurrentLightScatteringVolume;
 
+	UpdateFroxelOccupancy(params);
+
+	// History from before a resize has a different slice count to the current volume
+	m_VolumeStagingBuffer.HistorySliceCount = m_ResizedHistory.GetResource() ? m_ResizedHistoryResolution.z : m_VolumeResolution.z;
+
+	// The slice depths follow the GUI settings and the camera's near plane
+	FroxelSliceTable::Build(m_VolumeStagingBuffer, params.NearPlane, params.Projection);
+
 	// Copy staging
-	m_VolumeConstantBuffer.CopyElement(g_D3DGraphicsContext->GetCurrentBackBuffer(), m_VolumeStagingBuffer);
-	m_GlobalFogConstantBuffer.CopyElement(g_D3DGraphicsContext->GetCurrentBackBuffer(), m_GlobalFogStagingBuffer);
+	const auto uploadAllocator = g_D3DGraphicsContext->GetFrameUploadAllocator();
+	m_VolumeCBAddress = uploadAllocator->AllocateConstants(m_VolumeStagingBuffer).GPUAddress;
+	m_GlobalFogCBAddress = uploadAllocator->AllocateConstants(m_GlobalFogStagingBuffer).GPUAddress;
 
 	std::vector<D3D12_RESOURCE_BARRIER> barriers;
 	auto FlushBarriers = [&]()
@@ -351,32 +1063,65 @@ void VolumetricRendering::RenderVolumetrics(const RenderVolumetricsParams& param
 		commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
 		barriers.clear();
 	};
+	// Volumes that the memory configuration does not allocate are skipped
 	auto AddTransition = [&](const auto& resource, auto before, auto after)
 		{
-			barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource.GetResource(), before, after));
+			if (resource.GetResource())
+				barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource.GetResource(), before, after));
+		};
+	auto AddAliasing = [&](const auto& resource)
+		{
+			if (m_MemoryConfig.AliasVBufferAWithIntegrated && resource.GetResource())
+				barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, resource.GetResource()));
 		};
 
+	UpdateFogClipmap(params);
+	UploadFogNoise();
+	UploadBakedFog();
+
+	// VBufferA takes the aliased memory back from the previous frame's integrated volume
+	AddAliasing(m_VBufferA);
 	AddTransition(m_VBufferA, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	AddTransition(m_VBufferB, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	FlushBarriers();
 
+	m_StageTimer.Start(commandList, VolumetricResolutionController::Stage_DensityEstimation);
 	DensityEstimation();
+	m_StageTimer.Stop(commandList, VolumetricResolutionController::Stage_DensityEstimation);
 
 	AddTransition(m_VBufferA, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 	AddTransition(m_VBufferB, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 	AddTransition(GetCurrentLSV(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	FlushBarriers();
 
+	m_StageTimer.Start(commandList, VolumetricResolutionController::Stage_LightScattering);
 	LightScattering(params);
+	m_StageTimer.Stop(commandList, VolumetricResolutionController::Stage_LightScattering);
+
+	// The resized history has now been consumed
+	if (m_ResizedHistory.GetResource())
+	{
+		g_D3DGraphicsContext->DeferRelease(ComPtr<IUnknown>(m_ResizedHistory.GetResource()));
+		m_ResizedHistory = Texture();
+	}
 
+	// VBufferA is no longer needed, so the integrated volume can take over the aliased memory
+	AddAliasing(m_IntegratedVolume);
+	AddAliasing(m_IntegratedTransmittance);
 	AddTransition(GetCurrentLSV(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 	AddTransition(m_IntegratedVolume, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	AddTransition(m_IntegratedTransmittance, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	FlushBarriers();
 
+	m_StageTimer.Start(commandList, VolumetricResolutionController::Stage_VolumeIntegration);
 	VolumeIntegration();
+	m_StageTimer.Stop(commandList, VolumetricResolutionController::Stage_VolumeIntegration);
 
 	AddTransition(m_IntegratedVolume, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	AddTransition(m_IntegratedTransmittance, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 	FlushBarriers();
+
+	m_StageTimer.EndFrame(commandList);
 }
 
 void VolumetricRendering::ApplyVolumetrics(const ApplyVolumetricsParams& params) const
@@ -387,7 +1132,7 @@ void VolumetricRendering::ApplyVolumetrics(const ApplyVolumetricsParams& params)
 	m_ApplyVolumetricsPipeline.Bind(commandList);
 
 	commandList->SetComputeRootConstantBufferView(ApplyVolumetricsRootSignature::PassConstantBuffer, g_D3DGraphicsContext->GetPassCBAddress());
-	commandList->SetComputeRootConstantBufferView(ApplyVolumetricsRootSignature::VolumeConstantBuffer, m_VolumeConstantBuffer.GetAddressOfElement(g_D3DGraphicsContext->GetCurrentBackBuffer()));
+	commandList->SetComputeRootConstantBufferView(ApplyVolumetricsRootSignature::VolumeConstantBuffer, m_VolumeCBAddress);
 	commandList->SetComputeRootDescriptorTable(ApplyVolumetricsRootSignature::IntegratedVolume, m_Descriptors.GetGPUHandle(SRV_IntegratedVolume));
 	commandList->SetComputeRootDescriptorTable(ApplyVolumetricsRootSignature::DepthBuffer, params.DepthBufferSRV);
 	commandList->SetComputeRootDescriptorTable(ApplyVolumetricsRootSignature::IntegratedVolumeSampler, m_LightVolumeSampler.GetGPUHandle());
@@ -402,6 +1147,144 @@ void VolumetricRendering::ApplyVolumetrics(const ApplyVolumetricsParams& params)
 }
 
 
+void VolumetricRendering::UpdateFogClipmap(const RenderVolumetricsParams& params)
+{
+	const auto uploadAllocator = g_D3DGraphicsContext->GetFrameUploadAllocator();
+	m_FogClipmapUpdatedVoxels = 0;
+
+	// The cascades keep their contents while disabled, and catch up with the camera when re-enabled
+	if (!m_UseFogClipmap)
+	{
+		FogClipmapConstantBuffer constants = {};
+		constants.Enabled = 0;
+		m_FogClipmapCBAddress = uploadAllocator->AllocateConstants(constants).GPUAddress;
+		return;
+	}
+
+	if (memcmp(&m_FogClipmapBakedFog, &m_GlobalFogStagingBuffer, sizeof(GlobalFogConstantBuffer)) != 0)
+	{
+		m_FogClipmapBakedFog = m_GlobalFogStagingBuffer;
+		m_FogClipmapPlanner.Invalidate();
+	}
+
+	m_FogClipmapPlanner.Update(params.EyePosition);
+	m_FogClipmapCBAddress = uploadAllocator->AllocateConstants(m_FogClipmapPlanner.GetConstants()).GPUAddress;
+
+	const auto& updates = m_FogClipmapPlanner.GetUpdates();
+	if (updates.empty())
+		return;
+
+	const auto commandList = g_D3DGraphicsContext->GetCommandList();
+	PIXBeginEvent(commandList, PIX_COLOR_INDEX(20), "Fog Clipmap Update");
+
+	// Only the cascades with updates are transitioned
+	std::array<bool, FOG_CLIPMAP_CASCADE_COUNT> updatedCascades = {};
+	for (const auto& update : updates)
+	{
+		updatedCascades.at(update.Cascade) = true;
+	}
+
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+	for (UINT cascade = 0; cascade < FOG_CLIPMAP_CASCADE_COUNT; cascade++)
+	{
+		if (updatedCascades.at(cascade))
+			barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(m_FogClipmapCascades.at(cascade).GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+	}
+	commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+	m_FogClipmapUpdatePipeline.Bind(commandList);
+	commandList->SetComputeRootConstantBufferView(FogClipmapUpdateRootSignature::GlobalFogConstantBuffer, uploadAllocator->AllocateConstants(m_GlobalFogStagingBuffer).GPUAddress);
+
+	// The boxes of an update never overlap, so they are baked without barriers between them
+	for (const auto& update : updates)
+	{
+		const FogClipmapUpdateConstants constants = {
+			.VoxelMin = update.VoxelMin,
+			.VoxelSize = m_FogClipmapPlanner.GetVoxelSize(update.Cascade),
+			.TexelMin = update.TexelMin,
+			.Size = update.Size
+		};
+
+		commandList->SetComputeRoot32BitConstants(FogClipmapUpdateRootSignature::UpdateConstants, SizeOfInUint32(FogClipmapUpdateConstants), &constants, 0);
+		commandList->SetComputeRootDescriptorTable(FogClipmapUpdateRootSignature::Cascade, m_FogClipmapDescriptors.GetGPUHandle(UAV_FogClipmap0 + update.Cascade));
+
+		const UINT groupSize = FOG_CLIPMAP_UPDATE_GROUP_SIZE;
+		commandList->Dispatch(
+			(update.Size.x + groupSize - 1) / groupSize,
+			(update.Size.y + groupSize - 1) / groupSize,
+			(update.Size.z + groupSize - 1) / groupSize);
+
+		m_FogClipmapUpdatedVoxels += update.GetVoxelCount();
+	}
+
+	for (auto& barrier : barriers)
+	{
+		std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+	}
+	commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+	PIXEndEvent(commandList);
+}
+
+
+void VolumetricRendering::UploadFogNoise()
+{
+	if (!m_FogNoiseUploadPending)
+		return;
+
+	m_FogNoiseUploadPending = false;
+
+	UploadVolumeTexels(m_FogNoiseTexture.GetResource(), m_FogNoiseBaker.GetTexels().data(), m_FogNoiseBaker.GetRowPitch(), m_FogNoiseBaker.GetSlicePitch());
+}
+
+void VolumetricRendering::UploadBakedFog()
+{
+	if (!m_BakedFogUploadPending)
+		return;
+
+	m_BakedFogUploadPending = false;
+
+	if (m_SparseFogBrickTexture.GetResource())
+	{
+		UploadVolumeTexels(m_SparseFogIndirectionTexture.GetResource(), m_SparseBrickAtlas.GetIndirection().data(), m_SparseBrickAtlas.GetIndirectionRowPitch(), m_SparseBrickAtlas.GetIndirectionSlicePitch());
+		UploadVolumeTexels(m_SparseFogBrickTexture.GetResource(), m_SparseBrickAtlas.GetBrickTexels().data(), m_SparseBrickAtlas.GetBrickRowPitch(), m_SparseBrickAtlas.GetBrickSlicePitch());
+	}
+	if (m_FogDensityAtlasTexture.GetResource())
+	{
+		UploadVolumeTexels(m_FogDensityAtlasTexture.GetResource(), m_FogDensityAtlas.GetTexels().data(), m_FogDensityAtlas.GetRowPitch(), m_FogDensityAtlas.GetSlicePitch());
+	}
+}
+
+void VolumetricRendering::UploadVolumeTexels(ID3D12Resource* texture, const void* texels, UINT rowPitch, UINT slicePitch)
+{
+	const auto commandList = g_D3DGraphicsContext->GetCommandList();
+
+	ComPtr<ID3D12Resource> uploadBuffer;
+	const auto uploadHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	const auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(GetRequiredIntermediateSize(texture, 0, 1));
+	THROW_IF_FAIL(g_D3DGraphicsContext->GetDevice()->CreateCommittedResource(
+		&uploadHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&uploadDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&uploadBuffer)));
+
+	D3D12_SUBRESOURCE_DATA data = {};
+	data.pData = texels;
+	data.RowPitch = rowPitch;
+	data.SlicePitch = slicePitch;
+
+	UpdateSubresources(commandList, texture, uploadBuffer.Get(), 0, 0, 1, &data);
+
+	const auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(texture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	commandList->ResourceBarrier(1, &barrier);
+
+	// The upload buffer should not be released until the copy has completed
+	g_D3DGraphicsContext->DeferRelease(uploadBuffer);
+}
+
+
 void VolumetricRendering::DensityEstimation() const
 {
 	const auto commandList = g_D3DGraphicsContext->GetCommandList();
@@ -410,11 +1293,26 @@ void VolumetricRendering::DensityEstimation() const
 	m_DensityEstimationPipeline.Bind(commandList);
 
 	commandList->SetComputeRootConstantBufferView(DensityEstimationRootSignature::PassConstantBuffer, g_D3DGraphicsContext->GetPassCBAddress());
-	commandList->SetComputeRootConstantBufferView(DensityEstimationRootSignature::VolumeConstantBuffer, m_VolumeConstantBuffer.GetAddressOfElement(g_D3DGraphicsContext->GetCurrentBackBuffer()));
-	commandList->SetComputeRootConstantBufferView(DensityEstimationRootSignature::GlobalFogConstantBuffer, m_GlobalFogConstantBuffer.GetAddressOfElement(g_D3DGraphicsContext->GetCurrentBackBuffer()));
+	commandList->SetComputeRootConstantBufferView(DensityEstimationRootSignature::VolumeConstantBuffer, m_VolumeCBAddress);
+	commandList->SetComputeRootConstantBufferView(DensityEstimationRootSignature::GlobalFogConstantBuffer, m_GlobalFogCBAddress);
 	commandList->SetComputeRootDescriptorTable(DensityEstimationRootSignature::VBuffer, m_Descriptors.GetGPUHandle(UAV_VBufferA));
-
-	commandList->Dispatch(m_DispatchGroups.x, m_DispatchGroups.y, m_DispatchGroups.z);
+	commandList->SetComputeRootShaderResourceView(DensityEstimationRootSignature::FogVolumes, m_FogVolumesAddress);
+	commandList->SetComputeRootShaderResourceView(DensityEstimationRootSignature::FogVolumeTiles, m_FogVolumeTilesAddress);
+	commandList->SetComputeRootShaderResourceView(DensityEstimationRootSignature::FogVolumeIndices, m_FogVolumeIndicesAddress);
+	commandList->SetComputeRootShaderResourceView(DensityEstimationRootSignature::ActiveBricks, m_BricksAddress);
+	commandList->SetComputeRootConstantBufferView(DensityEstimationRootSignature::FogClipmapConstantBuffer, m_FogClipmapCBAddress);
+	commandList->SetComputeRootDescriptorTable(DensityEstimationRootSignature::FogClipmap, m_FogClipmapDescriptors.GetGPUHandle(SRV_FogClipmap0));
+
+	FogNoiseConstants fogNoise = m_FogNoiseStagingBuffer;
+	fogNoise.Enabled = m_UseFogNoise ? 1 : 0;
+	commandList->SetComputeRoot32BitConstants(DensityEstimationRootSignature::FogNoiseConstants, SizeOfInUint32(FogNoiseConstants), &fogNoise, 0);
+	commandList->SetComputeRootDescriptorTable(DensityEstimationRootSignature::FogNoise, m_FogNoiseDescriptor.GetGPUHandle());
+	commandList->SetComputeRootDescriptorTable(DensityEstimationRootSignature::FogDensityAtlas, m_FogDensityAtlasDescriptor.GetGPUHandle());
+	commandList->SetComputeRootDescriptorTable(DensityEstimationRootSignature::SparseFog, m_SparseFogDescriptors.GetGPUHandle());
+
+	// One thread group per active brick
+	const UINT argumentIndex = g_D3DGraphicsContext->GetCurrentBackBuffer() * DispatchArgsCount + DispatchArgs_DensityEstimation;
+	commandList->ExecuteIndirect(m_DispatchSignature.Get(), 1, m_DispatchArguments.GetResource(), argumentIndex * m_DispatchArguments.GetElementStride(), nullptr, 0);
 
 	PIXEndEvent(commandList);
 }
@@ -430,16 +1328,19 @@ void VolumetricRendering::LightScattering(const RenderVolumetricsParams& params)
 
 	commandList->SetComputeRootConstantBufferView(LightScatteringRootSignature::PassConstantBuffer, g_D3DGraphicsContext->GetPassCBAddress());
 	commandList->SetComputeRootConstantBufferView(LightScatteringRootSignature::LightConstantBuffer, m_LightManager->GetLightingConstantBuffer());
-	commandList->SetComputeRootConstantBufferView(LightScatteringRootSignature::VolumeConstantBuffer, m_VolumeConstantBuffer.GetAddressOfElement(g_D3DGraphicsContext->GetCurrentBackBuffer()));
+	commandList->SetComputeRootConstantBufferView(LightScatteringRootSignature::VolumeConstantBuffer, m_VolumeCBAddress);
 	const LightScatteringConstantBuffer cb
 	{
 		.DepthBufferDimensions = params.DepthBufferDimensions,
 		.PrevDepthBufferDimensions = params.PreviousDepthBufferDimensions
 	};
 	commandList->SetComputeRoot32BitConstants(LightScatteringRootSignature::LightScatteringConstantBuffer, SizeOfInUint32(cb), &cb, 0);
+	commandList->SetComputeRootConstantBufferView(LightScatteringRootSignature::GlobalFogConstantBuffer, m_GlobalFogCBAddress);
 
 	commandList->SetComputeRootDescriptorTable(LightScatteringRootSignature::VBuffer, m_Descriptors.GetGPUHandle(SRV_VBufferA));
 	commandList->SetComputeRootShaderResourceView(LightScatteringRootSignature::PointLightBuffer, m_LightManager->GetPointLightBuffer());
+	commandList->SetComputeRootShaderResourceView(LightScatteringRootSignature::ClusterLightGrid, m_LightManager->GetClusterLightGridBuffer());
+	commandList->SetComputeRootShaderResourceView(LightScatteringRootSignature::ClusterLightIndices, m_LightManager->GetClusterLightIndexBuffer());
 	commandList->SetComputeRootDescriptorTable(LightScatteringRootSignature::SunSM, shadowMap);
 	commandList->SetComputeRootDescriptorTable(LightScatteringRootSignature::SceneDepth, params.DepthBuffer);
 
@@ -450,7 +1351,11 @@ void VolumetricRendering::LightScattering(const RenderVolumetricsParams& params)
 	commandList->SetComputeRootDescriptorTable(LightScatteringRootSignature::PreviousLightScatteringVolume, GetPreviousLSV_SRV());
 	commandList->SetComputeRootDescriptorTable(LightScatteringRootSignature::PreviousSceneDepth, params.PreviousDepthBuffer);
 
-	commandList->Dispatch(m_DispatchGroups.x, m_DispatchGroups.y, m_DispatchGroups.z);
+	commandList->SetComputeRootShaderResourceView(LightScatteringRootSignature::Bricks, m_BricksAddress);
+
+	// One thread group per active brick, then one per brick to clear
+	const UINT argumentIndex = g_D3DGraphicsContext->GetCurrentBackBuffer() * DispatchArgsCount + DispatchArgs_LightScattering;
+	commandList->ExecuteIndirect(m_DispatchSignature.Get(), 1, m_DispatchArguments.GetResource(), argumentIndex * m_DispatchArguments.GetElementStride(), nullptr, 0);
 
 	PIXEndEvent(commandList);
 }
@@ -460,16 +1365,26 @@ void VolumetricRendering::VolumeIntegration() const
 	const auto commandList = g_D3DGraphicsContext->GetCommandList();
 	PIXBeginEvent(commandList, PIX_COLOR_INDEX(23), "Volume Integration");
 
-	m_VolumeIntegrationPipeline.Bind(commandList);
+	const D3DComputePipeline& pipeline = m_IntegrationMode == VOLUME_INTEGRATION_SCAN ? m_VolumeIntegrationScanPipeline : m_VolumeIntegrationPipeline;
+	pipeline.Bind(commandList);
 
 	commandList->SetComputeRootConstantBufferView(VolumeIntegrationRootSignature::PassConstantBuffer, g_D3DGraphicsContext->GetPassCBAddress());
-	commandList->SetComputeRootConstantBufferView(VolumeIntegrationRootSignature::VolumeConstantBuffer, m_VolumeConstantBuffer.GetAddressOfElement(g_D3DGraphicsContext->GetCurrentBackBuffer()));
+	commandList->SetComputeRootConstantBufferView(VolumeIntegrationRootSignature::VolumeConstantBuffer, m_VolumeCBAddress);
 	commandList->SetComputeRootDescriptorTable(VolumeIntegrationRootSignature::LightScatteringVolume, GetCurrentLSV_SRV());
 	commandList->SetComputeRootDescriptorTable(VolumeIntegrationRootSignature::IntegratedVolume, m_Descriptors.GetGPUHandle(UAV_IntegratedVolume));
+	commandList->SetComputeRootShaderResourceView(VolumeIntegrationRootSignature::BrickOccupancy, m_BrickOccupancyAddress);
 
-	// Dispatch a single group along the z axis
-	// A single slice will 'march' through the volume to accumulate values
-	commandList->Dispatch(m_DispatchGroups.x, m_DispatchGroups.y, 1);
+	if (m_IntegrationMode == VOLUME_INTEGRATION_SCAN)
+	{
+		// Each group scans a few whole columns
+		commandList->Dispatch(m_VolumeResolution.x / VOLUME_SCAN_GROUP_SIZE_XY, m_VolumeResolution.y / VOLUME_SCAN_GROUP_SIZE_XY, 1);
+	}
+	else
+	{
+		// Dispatch a single group along the z axis
+		// A single slice will 'march' through the volume to accumulate values
+		commandList->Dispatch(m_DispatchGroups.x, m_DispatchGroups.y, 1);
+	}
 
 	PIXEndEvent(commandList);
 }
@@ -477,7 +1392,33 @@ void VolumetricRendering::VolumeIntegration() const
 
 void VolumetricRendering::DrawGui()
 {
-	ImGui::SliderFloat("Max Distance", &m_VolumeStagingBuffer.MaxVolumeDistance, 0.1f, 100.0f);
+	bool froxelGridChanged = ImGui::SliderFloat("Max Distance", &m_VolumeStagingBuffer.MaxVolumeDistance, 0.1f, 100.0f);
+
+	static const char* depthDistributions[] = { "Linear", "Exponential", "Hybrid" };
+	static_assert(ARRAYSIZE(depthDistributions) == VOLUME_DEPTH_DISTRIBUTION_COUNT);
+	int depthDistribution = static_cast<int>(m_VolumeStagingBuffer.DepthDistribution);
+	if (ImGui::Combo("Slice Distribution", &depthDistribution, depthDistributions, ARRAYSIZE(depthDistributions)))
+	{
+		m_VolumeStagingBuffer.DepthDistribution = static_cast<UINT>(depthDistribution);
+		froxelGridChanged = true;
+	}
+	{
+		GuiHelpers::DisableScope disable(m_VolumeStagingBuffer.DepthDistribution != VOLUME_DEPTH_DISTRIBUTION_HYBRID);
+		froxelGridChanged |= ImGui::SliderFloat("Hybrid Linear Depth", &m_VolumeStagingBuffer.HybridLinearDepth, 0.1f, 100.0f);
+	}
+
+	static const char* integrationModes[] = { "Serial March", "Parallel Scan" };
+	static_assert(ARRAYSIZE(integrationModes) == VOLUME_INTEGRATION_COUNT);
+	int integrationMode = static_cast<int>(m_IntegrationMode);
+	if (ImGui::Combo("Integration", &integrationMode, integrationModes, ARRAYSIZE(integrationModes)))
+	{
+		m_IntegrationMode = static_cast<UINT>(integrationMode);
+	}
+
+	if (froxelGridChanged)
+	{
+		m_LightManager->SetFroxelGrid(m_VolumeStagingBuffer);
+	}
 
 	if (ImGui::TreeNode("Global Fog"))
 	{
@@ -512,6 +1453,230 @@ void VolumetricRendering::DrawGui()
 		ImGui::TreePop();
 	}
 
+	if (ImGui::TreeNode("Local Fog Volumes"))
+	{
+		int volumeCount = static_cast<int>(m_FogVolumeCount);
+		if (ImGui::SliderInt("Count", &volumeCount, 0, static_cast<int>(s_MaxFogVolumes)))
+		{
+			m_FogVolumeCount = static_cast<UINT>(volumeCount);
+		}
+
+		ImGui::DragFloat("Scatter Radius", &m_FogVolumeScatterRadius, 0.1f, 0.0f, 1000.0f);
+		ImGui::DragFloat("Scatter Height", &m_FogVolumeScatterHeight, 0.1f, 0.0f, 1000.0f);
+		if (ImGui::Button("Scatter Volumes"))
+		{
+			ScatterFogVolumes();
+		}
+
+		// Binning statistics
+		const auto& tileVolumeRanges = m_FogVolumeBinner.GetTileVolumeRanges();
+		const XMUINT3& tileGrid = m_FogVolumeBinner.GetTileGridDimensions();
+		const UINT indexCount = static_cast<UINT>(m_FogVolumeBinner.GetVolumeIndices().size());
+		UINT maxTileVolumes = 0;
+		for (const XMUINT2& range : tileVolumeRanges)
+		{
+			maxTileVolumes = max(maxTileVolumes, range.y);
+		}
+
+		ImGui::Text("Visible volumes: %u / %u", m_FogVolumeBinner.GetVisibleVolumeCount(), m_FogVolumeBinner.GetVolumeCount());
+		ImGui::Text("Tiles: %u x %u x %u", tileGrid.x, tileGrid.y, tileGrid.z);
+		ImGui::Text("Tile volume indices: %u / %u", indexCount, s_MaxFogVolumeIndices);
+		ImGui::Text("Max volumes in a tile: %u", maxTileVolumes);
+		if (indexCount > s_MaxFogVolumeIndices)
+		{
+			ImGui::Text("Tile volume lists are being truncated!");
+		}
+
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Fog Clipmap"))
+	{
+		ImGui::Checkbox("Use Clipmap", &m_UseFogClipmap);
+
+		float voxelSize = m_FogClipmapPlanner.GetBaseVoxelSize();
+		if (ImGui::SliderFloat("Voxel Size", &voxelSize, 0.05f, 2.0f))
+		{
+			m_FogClipmapPlanner.SetBaseVoxelSize(max(voxelSize, 0.05f));
+		}
+
+		if (ImGui::Button("Rebake"))
+		{
+			m_FogClipmapPlanner.Invalidate();
+		}
+
+		for (UINT cascade = 0; cascade < FOG_CLIPMAP_CASCADE_COUNT; cascade++)
+		{
+			const float extent = m_FogClipmapPlanner.GetVoxelSize(cascade) * static_cast<float>(s_FogClipmapResolution);
+			ImGui::Text("Cascade %u: %.1f m", cascade, extent);
+		}
+		ImGui::Text("Voxels baked this frame: %u", m_FogClipmapUpdatedVoxels);
+
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Fog Noise"))
+	{
+		ImGui::Checkbox("Use Noise", &m_UseFogNoise);
+
+		ImGui::SliderFloat("Strength", &m_FogNoiseStagingBuffer.Strength, 0.0f, 1.0f);
+		ImGui::SliderFloat("Worley Weight", &m_FogNoiseStagingBuffer.WorleyWeight, 0.0f, 1.0f);
+
+		float tileSize = 1.0f / m_FogNoiseStagingBuffer.Frequency;
+		if (ImGui::DragFloat("Tile Size", &tileSize, 0.1f, 1.0f, 256.0f))
+		{
+			m_FogNoiseStagingBuffer.Frequency = 1.0f / max(tileSize, 1.0f);
+		}
+
+		ImGui::DragFloat3("Wind", &m_FogNoiseStagingBuffer.WindVelocity.x, 0.01f);
+
+		if (ImGui::TreeNode("Bake"))
+		{
+			// Changes are applied by rebaking, or loading the texture from the cache if it has been baked before
+			static const char* resolutions[] = { "32", "64", "128" };
+			int resolution = m_FogNoiseDesc.Resolution >= 128 ? 2 : (m_FogNoiseDesc.Resolution >= 64 ? 1 : 0);
+			if (ImGui::Combo("Resolution", &resolution, resolutions, ARRAYSIZE(resolutions)))
+			{
+				m_FogNoiseDesc.Resolution = 32u << resolution;
+			}
+
+			int seed = static_cast<int>(m_FogNoiseDesc.Seed);
+			if (ImGui::InputInt("Seed", &seed))
+			{
+				m_FogNoiseDesc.Seed = static_cast<UINT>(seed);
+			}
+
+			int octaves = static_cast<int>(m_FogNoiseDesc.Octaves);
+			if (ImGui::SliderInt("Octaves", &octaves, 1, 6))
+			{
+				m_FogNoiseDesc.Octaves = static_cast<UINT>(octaves);
+			}
+
+			int frequency = static_cast<int>(m_FogNoiseDesc.Frequency);
+			if (ImGui::SliderInt("Frequency", &frequency, 1, 16))
+			{
+				m_FogNoiseDesc.Frequency = static_cast<UINT>(frequency);
+			}
+
+			ImGui::SliderFloat("Persistence", &m_FogNoiseDesc.Persistence, 0.0f, 1.0f);
+
+			if (ImGui::Button("Rebake"))
+			{
+				CreateFogNoise();
+			}
+
+			const FogNoiseBaker::Desc& baked = m_FogNoiseBaker.GetDesc();
+			ImGui::Text("Texture: %u^3, %.2f MB", baked.Resolution, static_cast<double>(m_FogNoiseBaker.GetTexels().size()) / (1024.0 * 1024.0));
+			ImGui::Text("%s in %.2f ms", m_FogNoiseBaker.WasLoadedFromCache() ? "Loaded from cache" : "Baked", m_FogNoiseBaker.GetLastBakeMilliseconds());
+
+			ImGui::TreePop();
+		}
+
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Baked Fog"))
+	{
+		ImGui::Checkbox("Use Baked Fog", &m_UseBakedFog);
+
+		// Changes are applied by rebaking
+		static const char* modes[] = { "Solid", "Signed Distance" };
+		static_assert(ARRAYSIZE(modes) == FogVoxelizer::ModeCount);
+		int mode = static_cast<int>(m_FogVoxelizerSettings.Mode);
+		if (ImGui::Combo("Mode", &mode, modes, ARRAYSIZE(modes)))
+		{
+			m_FogVoxelizerSettings.Mode = static_cast<UINT>(mode);
+		}
+
+		static const char* fillRules[] = { "Parity", "Winding" };
+		static_assert(ARRAYSIZE(fillRules) == FogVoxelizer::FillRuleCount);
+		int fillRule = static_cast<int>(m_FogVoxelizerSettings.FillRule);
+		if (ImGui::Combo("Fill Rule", &fillRule, fillRules, ARRAYSIZE(fillRules)))
+		{
+			m_FogVoxelizerSettings.FillRule = static_cast<UINT>(fillRule);
+		}
+
+		int resolution = static_cast<int>(m_FogVoxelizerSettings.Resolution);
+		if (ImGui::SliderInt("Resolution", &resolution, 16, 126))
+		{
+			m_FogVoxelizerSettings.Resolution = static_cast<UINT>(resolution);
+		}
+
+		ImGui::SliderFloat("Falloff (voxels)", &m_BakedFogFalloff, 0.5f, 8.0f);
+		ImGui::Checkbox("Sparse Bricks", &m_UseSparseBakedFog);
+
+		if (ImGui::Button("Rebake"))
+		{
+			CreateBakedFog();
+		}
+
+		if (m_SparseFogBrickTexture.GetResource())
+		{
+			const XMUINT3 brickDimensions = m_SparseBrickAtlas.GetBrickTextureDimensions();
+			ImGui::Text("Brick atlas: %u x %u x %u, %u entries, %u / %u bricks", brickDimensions.x, brickDimensions.y, brickDimensions.z,
+				m_SparseBrickAtlas.GetEntryCount(), m_SparseBrickAtlas.GetBrickCount(), m_SparseBrickAtlas.GetMaxBrickCount());
+
+			// Against the dense grids, which the dense atlas would hold with its borders
+			UINT64 denseBytes = 0;
+			for (const SparseFogVolume& sparseVolume : m_SparseFogVolumes)
+			{
+				denseBytes += sparseVolume.GetDenseSizeInBytes();
+			}
+			ImGui::Text("Uploaded: %.2f MB, dense grids: %.2f MB, dense atlas: %.2f MB",
+				static_cast<double>(m_SparseBrickAtlas.GetSizeInBytes()) / (1024.0 * 1024.0), static_cast<double>(denseBytes) / (1024.0 * 1024.0),
+				static_cast<double>(m_FogDensityAtlas.GetTexels().size()) / (1024.0 * 1024.0));
+
+			// Lookups of the last sparse volume on the CPU against its dense grid
+			if (ImGui::Button("Benchmark Sparse Lookups") && !m_SparseFogVolumes.empty())
+			{
+				m_SparseFogBenchmark = m_SparseFogVolumes.back().Benchmark(1 << 20, 4);
+				LOG_INFO("Sparse fog volume benchmark:\n{}", m_SparseFogBenchmark.Format());
+			}
+			if (m_SparseFogBenchmark.Samples > 0)
+			{
+				ImGui::Text("%s", m_SparseFogBenchmark.Format().c_str());
+			}
+		}
+		else
+		{
+			const XMUINT3& atlasDimensions = m_FogDensityAtlas.GetDimensions();
+			ImGui::Text("Atlas: %u x %u x %u, %u entries, %.1f%% used", atlasDimensions.x, atlasDimensions.y, atlasDimensions.z,
+				m_FogDensityAtlas.GetEntryCount(), 100.0f * m_FogDensityAtlas.GetUsedFraction());
+		}
+		ImGui::Text("Baked %u volumes in %.2f ms", static_cast<UINT>(m_BakedFogVolumes.size()), m_BakedFogMilliseconds);
+
+		// Of the last asset voxelized
+		const FogVoxelizer::Statistics& stats = m_FogVoxelizer.GetStatistics();
+		ImGui::Text("Last mesh: %u triangles, %llu surface voxels, %llu inside", stats.Triangles, stats.SurfaceVoxels, stats.InsideVoxels);
+		ImGui::Text("Surface %.2f ms, Fill %.2f ms, Distance %.2f ms", stats.SurfaceMilliseconds, stats.FillMilliseconds, stats.DistanceMilliseconds);
+
+		// Takes a few seconds, as the scalar overlap test is included
+		if (ImGui::Button("Benchmark") && !m_BakedFogAssets.empty())
+		{
+			const BakedFogAsset& asset = m_BakedFogAssets.back();
+			m_FogVoxelizerBenchmark = m_FogVoxelizer.Benchmark(asset.Mesh, XMMatrixScaling(asset.Scale.x, asset.Scale.y, asset.Scale.z), m_FogVoxelizerSettings, 2);
+			LOG_INFO("Fog voxelizer benchmark:\n{}", m_FogVoxelizerBenchmark.Format());
+		}
+		if (m_FogVoxelizerBenchmark.Voxels > 0)
+		{
+			ImGui::Text("%s", m_FogVoxelizerBenchmark.Format().c_str());
+		}
+
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Sparse Froxels"))
+	{
+		ImGui::Checkbox("Skip Empty Bricks", &m_UseFroxelOccupancy);
+
+		const XMUINT3& brickGrid = m_FroxelOccupancy.GetBrickGridDimensions();
+		ImGui::Text("Bricks: %u x %u x %u", brickGrid.x, brickGrid.y, brickGrid.z);
+		ImGui::Text("Active bricks: %u / %u (%.1f%%)", m_FroxelOccupancy.GetActiveBrickCount(), m_FroxelOccupancy.GetBrickCount(), 100.0f * m_FroxelOccupancy.GetActiveFraction());
+		ImGui::Text("Cleared bricks: %u", m_ClearedBrickCount);
+
+		ImGui::TreePop();
+	}
+
 	if (ImGui::TreeNode(this, "Lighting"))
 	{
 		GuiHelpers::FlagOption(&m_VolumeStagingBuffer.Flags, "Disable Ambient", VOLUME_FLAGS_DISABLE_AMBIENT);
@@ -538,4 +1703,86 @@ void VolumetricRendering::DrawGui()
 		ImGui::TreePop();
 	}
 
+	if (ImGui::TreeNode("Dynamic Resolution"))
+	{
+		ImGui::Checkbox("Enabled", &m_UseDynamicResolution);
+
+		{
+			// The tier can only be picked by hand while the controller is not choosing it
+			GuiHelpers::DisableScope disable(m_UseDynamicResolution);
+
+			int tier = static_cast<int>(m_ResolutionController.GetTier());
+			if (ImGui::SliderInt("Tier", &tier, 0, static_cast<int>(m_ResolutionController.GetTierCount()) - 1))
+			{
+				m_ResolutionController.SetTier(static_cast<UINT>(tier));
+			}
+		}
+
+		ImGui::Text("Resolution: %u x %u x %u", m_VolumeResolution.x, m_VolumeResolution.y, m_VolumeResolution.z);
+		ImGui::Text("Volume Memory: %.1f MB", static_cast<double>(VolumetricMemory::CalculateFootprint(m_MemoryConfig, m_VolumeResolution).Total) / (1024.0 * 1024.0));
+		ImGui::Text("Budget Pressure: %.2f", m_ResolutionController.GetBudgetPressure());
+
+		static const char* stageNames[] = { "Density Estimation", "Light Scattering", "Volume Integration" };
+		static_assert(ARRAYSIZE(stageNames) == VolumetricResolutionController::StageCount);
+
+		auto& settings = m_ResolutionController.GetSettings();
+		const auto& smoothedTimes = m_ResolutionController.GetSmoothedTimes();
+		for (UINT stage = 0; stage < VolumetricResolutionController::StageCount; stage++)
+		{
+			ImGui::Text("%s: %.3f ms (smoothed %.3f ms)", stageNames[stage], m_StageTimer.GetMilliseconds(stage), smoothedTimes.at(stage));
+		}
+
+		if (ImGui::TreeNode("Budgets (ms)"))
+		{
+			for (UINT stage = 0; stage < VolumetricResolutionController::StageCount; stage++)
+			{
+				if (ImGui::DragFloat(stageNames[stage], &settings.StageBudgets.at(stage), 0.01f))
+				{
+					settings.StageBudgets.at(stage) = max(0.0f, settings.StageBudgets.at(stage));
+				}
+			}
+
+			ImGui::TreePop();
+		}
+
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Memory"))
+	{
+		// Changes are applied at the start of the next frame
+		auto vbufferBNameGetter = [](void*, int index) -> const char* { return VolumetricMemory::GetVBufferBStorageName(index); };
+		auto integratedNameGetter = [](void*, int index) -> const char* { return VolumetricMemory::GetIntegratedStorageName(index); };
+
+		int vbufferBStorage = static_cast<int>(m_RequestedMemoryConfig.VBufferBStorage);
+		if (ImGui::Combo("VBufferB", &vbufferBStorage, vbufferBNameGetter, nullptr, VOLUME_VBUFFERB_STORAGE_COUNT))
+		{
+			m_RequestedMemoryConfig.VBufferBStorage = static_cast<UINT>(vbufferBStorage);
+		}
+
+		int integratedStorage = static_cast<int>(m_RequestedMemoryConfig.IntegratedStorage);
+		if (ImGui::Combo("Integrated Volume", &integratedStorage, integratedNameGetter, nullptr, VOLUME_INTEGRATED_STORAGE_COUNT))
+		{
+			m_RequestedMemoryConfig.IntegratedStorage = static_cast<UINT>(integratedStorage);
+		}
+
+		ImGui::Checkbox("Alias VBufferA With Integrated Volume", &m_RequestedMemoryConfig.AliasVBufferAWithIntegrated);
+
+		const VolumetricMemoryFootprint footprint = VolumetricMemory::CalculateFootprint(m_MemoryConfig, m_VolumeResolution);
+		auto MB = [](UINT64 bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+
+		ImGui::Text("VBufferA: %.2f MB", MB(footprint.VBufferA));
+		ImGui::Text("VBufferB: %.2f MB", MB(footprint.VBufferB));
+		ImGui::Text("Light Scattering Volumes: %.2f MB", MB(footprint.LightScatteringVolumes));
+		ImGui::Text("Integrated Volume: %.2f MB", MB(footprint.IntegratedVolume));
+		ImGui::Text("Aliased: -%.2f MB", MB(footprint.AliasedBytes));
+		ImGui::Text("Total: %.2f MB", MB(footprint.Total));
+
+		if (ImGui::Button("Log All Configurations"))
+		{
+			LOG_INFO("Volumetrics memory:\n{}", VolumetricMemory::FormatFootprintReport(m_VolumeResolution));
+		}
+
+		ImGui::TreePop();
+	}
 }
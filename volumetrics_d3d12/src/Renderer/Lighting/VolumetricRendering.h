@@ -5,6 +5,17 @@
 #include "Renderer/Buffer/Texture.h"
 #include "Renderer/Buffer/UploadBuffer.h"
 #include "Renderer/Memory/MemoryAllocator.h"
+#include "Renderer/Profiling/GPUTimer.h"
+#include "FogClipmapPlanner.h"
+#include "FogDensityAtlas.h"
+#include "FogNoiseBaker.h"
+#include "FogVolumeBinner.h"
+#include "FogVoxelizer.h"
+#include "FroxelOccupancy.h"
+#include "SparseBrickAtlas.h"
+#include "SparseFogVolume.h"
+#include "VolumetricMemory.h"
+#include "VolumetricResolutionController.h"
 
 using namespace DirectX;
 
@@ -20,14 +31,41 @@ class VolumetricRendering
 		SRV_LightScatteringVolume0,
 		SRV_LightScatteringVolume1,
 		SRV_IntegratedVolume,
+		SRV_IntegratedTransmittance,
 		UAV_VBufferA,
 		UAV_VBufferB,
 		UAV_LightScatteringVolume0,
 		UAV_LightScatteringVolume1,
 		UAV_IntegratedVolume,
+		UAV_IntegratedTransmittance,
+		SRV_ResizedHistory,
 		DescriptorCount
 	};
 
+	// SRV and UAV of each fog clipmap cascade
+	enum FogClipmapDescriptorIndices
+	{
+		SRV_FogClipmap0 = 0,
+		UAV_FogClipmap0 = SRV_FogClipmap0 + FOG_CLIPMAP_CASCADE_COUNT,
+		FogClipmapDescriptorCount = UAV_FogClipmap0 + FOG_CLIPMAP_CASCADE_COUNT
+	};
+
+	// Textures of the sparse baked fog, in the order of their registers
+	enum SparseFogDescriptorIndices
+	{
+		SRV_SparseFogIndirection = 0,
+		SRV_SparseFogBricks,
+		SparseFogDescriptorCount
+	};
+
+	// Indirect dispatches, with one set of arguments for each frame in flight
+	enum DispatchArguments
+	{
+		DispatchArgs_DensityEstimation = 0,
+		DispatchArgs_LightScattering,
+		DispatchArgsCount
+	};
+
 public:
 
 	struct RenderVolumetricsParams
@@ -37,6 +75,12 @@ public:
 
 		D3D12_GPU_DESCRIPTOR_HANDLE PreviousDepthBuffer;
 		XMUINT2 PreviousDepthBufferDimensions;
+
+		// Camera, for binning the local fog volumes and centring the fog clipmap
+		XMMATRIX View;
+		XMMATRIX Projection;
+		float NearPlane;
+		XMFLOAT3 EyePosition;
 	};
 
 	struct ApplyVolumetricsParams
@@ -62,8 +106,44 @@ public:
 
 private:
 	void CreateResources();
+	void CreateVolumes();
+	void CreateFogClipmap();
+	// Loads or bakes the fog noise with the current settings, and creates a texture for it to be uploaded into
+	void CreateFogNoise();
+	// Voxelizes the baked fog assets into the density atlas, or the sparse brick atlas, with the current settings,
+	// and creates the textures for them to be uploaded into
+	void CreateBakedFog();
+	// Creates a 3D texture in the copy destination state with an SRV, or only a null SRV when the dimensions are empty
+	static void CreateVolumeTexture(Texture& texture, DXGI_FORMAT format, const XMUINT3& dimensions, const wchar_t* name, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle);
 	void CreatePipelines();
 
+	// Reads back the stage timings and changes the volume resolution if the controller has picked a new tier
+	void UpdateDynamicResolution();
+	// Applies a memory configuration picked in the GUI, which needs new pipelines and volumes
+	void UpdateMemoryConfig();
+	// Reallocates the volumes at a resolution with the current memory configuration, without waiting for the GPU
+	// The old volumes are released once the frames using them are complete, and on a resize the latest light scattering volume
+	// is kept as the temporal history for the next frame
+	void ReallocateVolumes(const XMUINT3& resolution);
+
+	// Culls and bins the local fog volumes into the tiles of the current volume, and uploads them with their lists
+	void UpdateFogVolumes(const RenderVolumetricsParams& params);
+	// Places the local fog volumes at random within a region around the origin
+	void ScatterFogVolumes();
+
+	// Finds the bricks of the volume that may contain fog, and uploads the brick lists and dispatch arguments for this frame
+	// Runs once the light scattering volumes have been flipped, as the bricks to clear depend on the current volume
+	void UpdateFroxelOccupancy(const RenderVolumetricsParams& params);
+
+	// Re-centres the fog clipmap on the camera, and bakes the voxels that have entered its cascades
+	void UpdateFogClipmap(const RenderVolumetricsParams& params);
+	// Copies the fog noise into its texture, once after each bake
+	void UploadFogNoise();
+	// Copies the atlases of the baked fog into their textures, once after each bake
+	void UploadBakedFog();
+	// Copies a single subresource of texels into a 3D texture in the copy destination state, which is left readable by compute shaders
+	static void UploadVolumeTexels(ID3D12Resource* texture, const void* texels, UINT rowPitch, UINT slicePitch);
+
 	// Volumetric Rendering sub-stages
 	void DensityEstimation() const;
 	void LightScattering(const RenderVolumetricsParams& params) const;
@@ -79,14 +159,152 @@ private:
 	inline D3D12_GPU_DESCRIPTOR_HANDLE GetCurrentLSV_SRV() const { return m_Descriptors.GetGPUHandle(SRV_LightScatteringVolume0 + m_CurrentLightScatteringVolume); }
 	inline D3D12_GPU_DESCRIPTOR_HANDLE GetCurrentLSV_UAV() const { return m_Descriptors.GetGPUHandle(UAV_LightScatteringVolume0 + m_CurrentLightScatteringVolume); }
 
-	inline D3D12_GPU_DESCRIPTOR_HANDLE GetPreviousLSV_SRV() const { return m_Descriptors.GetGPUHandle(SRV_LightScatteringVolume0 + (1 - m_CurrentLightScatteringVolume)); }
+	inline D3D12_GPU_DESCRIPTOR_HANDLE GetPreviousLSV_SRV() const
+	{
+		return m_ResizedHistory.GetResource() ? m_Descriptors.GetGPUHandle(SRV_ResizedHistory) : m_Descriptors.GetGPUHandle(SRV_LightScatteringVolume0 + (1 - m_CurrentLightScatteringVolume));
+	}
 
 private:
-	XMUINT3 m_VolumeResolution = { 512, 288, 128 };
+	// Resolution tiers for dynamic resolution, from the most expensive to the cheapest
+	// Every dimension must be a multiple of 8
+	inline static constexpr XMUINT3 s_ResolutionTiers[] = {
+		{ 512, 288, 128 },
+		{ 384, 216, 128 },
+		{ 320, 176, 96 },
+		{ 256, 144, 64 },
+		{ 160, 88, 64 }
+	};
+
+	XMUINT3 m_VolumeResolution = s_ResolutionTiers[0];
 	XMUINT3 m_DispatchGroups;
 
+	// Dynamic resolution
+	VolumetricResolutionController m_ResolutionController;
+	bool m_UseDynamicResolution = true;
+
+	// GPU time of each stage, indexed by VolumetricResolutionController::Stage
+	GPUTimer m_StageTimer;
+	// The tier each frame in flight was rendered at, to match its timings with
+	std::vector<UINT> m_FrameTiers;
+
+	// Local fog volumes
+	inline static constexpr UINT s_MaxFogVolumes = 1024;
+	// Limit on the combined length of the per-tile volume lists uploaded each frame
+	inline static constexpr UINT s_MaxFogVolumeIndices = FogVolumeBinner::s_MaxVolumeIndices;
+
+	std::vector<FogVolume> m_FogVolumes;
+	UINT m_FogVolumeCount = 0;
+
+	std::vector<float> m_FroxelSliceDepths;
+	FogVolumeBinner m_FogVolumeBinner;
+
+	// Fog volume GUI
+	float m_FogVolumeScatterRadius = 20.0f;
+	float m_FogVolumeScatterHeight = 5.0f;
+
+	// Fog clipmap
+	// The global fog is baked into world-space cascades around the camera, which density estimation samples
+	inline static constexpr UINT s_FogClipmapResolution = 64;
+
+	bool m_UseFogClipmap = true;
+	FogClipmapPlanner m_FogClipmapPlanner{ s_FogClipmapResolution, 0.25f };
+	std::array<Texture, FOG_CLIPMAP_CASCADE_COUNT> m_FogClipmapCascades;
+	DescriptorAllocation m_FogClipmapDescriptors;
+
+	// The global fog that the clipmap holds, which is re-baked when the GUI changes it
+	GlobalFogConstantBuffer m_FogClipmapBakedFog = {};
+	UINT m_FogClipmapUpdatedVoxels = 0;
+
+	// Fog noise
+	// The global fog is modulated by a tileable noise texture baked on the CPU, which is cached on disk between runs
+	inline static constexpr const char* s_FogNoiseCacheDirectory = "cache/fog_noise";
+
+	bool m_UseFogNoise = true;
+	FogNoiseBaker m_FogNoiseBaker;
+	// The bake settings, which the GUI edits and applies with a rebake
+	FogNoiseBaker::Desc m_FogNoiseDesc;
+	Texture m_FogNoiseTexture;
+	DescriptorAllocation m_FogNoiseDescriptor;
+	bool m_FogNoiseUploadPending = false;
+
+	FogNoiseConstants m_FogNoiseStagingBuffer;
+
+	// Baked fog
+	// Meshes are voxelized on the CPU into grids of density, which are packed into an atlas that baked fog volumes sample
+	// The grids are either packed densely, or stored as SparseFogVolumes with only their bricks that are not uniform uploaded
+	inline static constexpr XMUINT3 s_FogDensityAtlasDimensions = { 256, 128, 128 };
+	// Bricks of the indirection table, which covers the same voxels as the dense atlas twice over
+	inline static constexpr XMUINT3 s_SparseFogIndirectionDimensions = { 64, 32, 32 };
+	inline static constexpr UINT s_MaxSparseFogBricks = 16 * SparseBrickAtlas::s_SlotsPerLayer;
+
+	// A mesh to fill with fog, placed with its scale, rotation and position
+	// It is voxelized after scaling, and the rotation and position are applied to its fog volume
+	struct BakedFogAsset
+	{
+		MeshData Mesh;
+		XMFLOAT3 Scale;
+		XMFLOAT3 Rotation;
+		XMFLOAT3 Position;
+
+		XMFLOAT3 Albedo;
+		float Extinction;
+	};
+
+	bool m_UseBakedFog = true;
+	std::vector<BakedFogAsset> m_BakedFogAssets;
+	FogVoxelizer m_FogVoxelizer;
+	// The bake settings, which the GUI edits and applies with a rebake
+	FogVoxelizer::Settings m_FogVoxelizerSettings;
+	// Voxels from the surface inwards over which signed distance grids fade in
+	float m_BakedFogFalloff = 3.0f;
+
+	FogDensityAtlas m_FogDensityAtlas{ s_FogDensityAtlasDimensions };
+	std::vector<FogVolume> m_BakedFogVolumes;
+	Texture m_FogDensityAtlasTexture;
+	DescriptorAllocation m_FogDensityAtlasDescriptor;
+
+	bool m_UseSparseBakedFog = true;
+	SparseBrickAtlas m_SparseBrickAtlas{ s_SparseFogIndirectionDimensions, s_MaxSparseFogBricks };
+	// Kept on the CPU for the GUI and its benchmark
+	std::vector<SparseFogVolume> m_SparseFogVolumes;
+	Texture m_SparseFogIndirectionTexture;
+	Texture m_SparseFogBrickTexture;
+	DescriptorAllocation m_SparseFogDescriptors;
+	SparseFogVolume::BenchmarkResult m_SparseFogBenchmark;
+
+	bool m_BakedFogUploadPending = false;
+
+	double m_BakedFogMilliseconds = 0.0;
+	FogVoxelizer::BenchmarkResult m_FogVoxelizerBenchmark;
+
+	// The local fog volumes followed by the baked fog volumes, as they are binned this frame
+	std::vector<FogVolume> m_FrameFogVolumes;
+
+	// Sparse froxels
+	// Density estimation and light scattering only run for the bricks of the volume that may contain fog
+	bool m_UseFroxelOccupancy = true;
+	FroxelOccupancy m_FroxelOccupancy;
+
+	// The occupancy mask that each light scattering volume was last written with
+	// Bricks that have since become inactive are cleared, so that they are empty when the volume is sampled as history
+	// Every bit is set for a new volume, as its contents are unknown
+	std::array<std::vector<UINT>, 2> m_LightScatteringOccupancy;
+	// The active bricks followed by the bricks to clear
+	std::vector<UINT> m_LightScatteringBricks;
+	UINT m_ClearedBrickCount = 0;
+
+	UploadBuffer<D3D12_DISPATCH_ARGUMENTS> m_DispatchArguments;
+	ComPtr<ID3D12CommandSignature> m_DispatchSignature;
+
+	// Memory configuration in use, and the one to switch to at the start of the next frame
+	VolumetricMemoryConfig m_MemoryConfig;
+	VolumetricMemoryConfig m_RequestedMemoryConfig;
+
 	DXGI_FORMAT m_Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
 
+	// VOLUME_INTEGRATION_SERIAL or VOLUME_INTEGRATION_SCAN, which produce the same volume within rounding
+	UINT m_IntegrationMode = VOLUME_INTEGRATION_SERIAL;
+
 
 	// Volume resources
 
@@ -97,7 +315,7 @@ private:
 	*/
 	Texture m_VBufferA;
 	/*
-	 * Format: RGBA16F
+	 * Format: RGBA16F, R32_UINT when packed, or not allocated when analytic
 	 * RGB - Emissive
 	 * A   - Phase (g)
 	*/
@@ -112,16 +330,39 @@ private:
 	std::array<Texture, 2> m_LightScatteringVolumes;
 	UINT m_CurrentLightScatteringVolume = 0;
 
+	/*
+	 * Format: RGBA16F, or R11G11B10F when the transmittance is stored separately
+	 * RGB - Integrated scattering
+	 * A   - Transmittance
+	*/
 	Texture m_IntegratedVolume;
-
-	UploadBuffer<VolumetricsConstantBuffer> m_VolumeConstantBuffer;
-	UploadBuffer<GlobalFogConstantBuffer> m_GlobalFogConstantBuffer;
+	// Format: R16_UNORM or R8_UNORM, when not stored in m_IntegratedVolume
+	Texture m_IntegratedTransmittance;
+
+	// Backs VBufferA and the integrated volume when they are aliased
+	ComPtr<ID3D12Heap> m_AliasedVolumeHeap;
+
+	// The light scattering volume from before a resize, used as the temporal history for one frame
+	Texture m_ResizedHistory;
+	XMUINT3 m_ResizedHistoryResolution = { 0, 0, 0 };
+
+	// Constant buffers are re-allocated from the frame's upload memory each frame
+	D3D12_GPU_VIRTUAL_ADDRESS m_VolumeCBAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_GlobalFogCBAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_FogVolumesAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_FogVolumeTilesAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_FogVolumeIndicesAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_BricksAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_BrickOccupancyAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS m_FogClipmapCBAddress = 0;
 
 	// Pipelines
 	D3DComputePipeline m_DensityEstimationPipeline;
 	D3DComputePipeline m_LightScatteringPipeline;
 	D3DComputePipeline m_VolumeIntegrationPipeline;
+	D3DComputePipeline m_VolumeIntegrationScanPipeline;
 	D3DComputePipeline m_ApplyVolumetricsPipeline;
+	D3DComputePipeline m_FogClipmapUpdatePipeline;
 
 	// SRV and UAV for each volume
 	DescriptorAllocation m_Descriptors;
@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "VolumetricResolutionController.h"
+
+
+VolumetricResolutionController::VolumetricResolutionController(const std::vector<XMUINT3>& tiers)
+	: m_Tiers(tiers)
+{
+	ASSERT(!m_Tiers.empty(), "At least one resolution tier is required");
+}
+
+
+bool VolumetricResolutionController::Update(const StageTimes& stageMilliseconds, UINT measuredTier)
+{
+	ASSERT(measuredTier < GetTierCount(), "Invalid tier");
+
+	// Bring measurements from a previous tier in line with the current one
+	const float scale = GetCostScale(measuredTier, m_Tier);
+
+	for (UINT stage = 0; stage < StageCount; stage++)
+	{
+		const float time = stageMilliseconds.at(stage) * scale;
+		m_SmoothedTimes.at(stage) = m_HasMeasurements ? m_SmoothedTimes.at(stage) + m_Settings.Smoothing * (time - m_SmoothedTimes.at(stage)) : time;
+	}
+	m_HasMeasurements = true;
+
+	if (m_CooldownFramesRemaining > 0)
+	{
+		m_CooldownFramesRemaining--;
+		return false;
+	}
+
+	const float pressure = GetBudgetPressure();
+
+	// Downgrade
+	if (pressure > m_Settings.DowngradeThreshold)
+	{
+		m_UnderBudgetFrames = 0;
+		m_OverBudgetFrames++;
+
+		if (m_OverBudgetFrames >= m_Settings.DowngradeFrames && m_Tier + 1 < GetTierCount())
+		{
+			// Drop as many tiers as are needed to fit the budget, so a sudden spike does not take several cooldowns to recover from
+			UINT tier = m_Tier + 1;
+			while (tier + 1 < GetTierCount() && pressure * GetCostScale(m_Tier, tier) > m_Settings.DowngradeThreshold)
+			{
+				tier++;
+			}
+
+			ChangeTier(tier);
+			return true;
+		}
+		return false;
+	}
+	m_OverBudgetFrames = 0;
+
+	// Upgrade
+	if (m_Tier > 0 && pressure * GetCostScale(m_Tier, m_Tier - 1) < m_Settings.UpgradeThreshold)
+	{
+		m_UnderBudgetFrames++;
+
+		if (m_UnderBudgetFrames >= m_Settings.UpgradeFrames)
+		{
+			ChangeTier(m_Tier - 1);
+			return true;
+		}
+	}
+	else
+	{
+		m_UnderBudgetFrames = 0;
+	}
+
+	return false;
+}
+
+void VolumetricResolutionController::SetTier(UINT tier)
+{
+	ASSERT(tier < GetTierCount(), "Invalid tier");
+
+	m_Tier = tier;
+	m_SmoothedTimes = {};
+	m_HasMeasurements = false;
+
+	m_OverBudgetFrames = 0;
+	m_UnderBudgetFrames = 0;
+	m_CooldownFramesRemaining = m_Settings.CooldownFrames;
+}
+
+
+float VolumetricResolutionController::GetBudgetPressure() const
+{
+	float pressure = 0.0f;
+	for (UINT stage = 0; stage < StageCount; stage++)
+	{
+		const float budget = m_Settings.StageBudgets.at(stage);
+		if (budget > 0.0f)
+		{
+			pressure = max(pressure, m_SmoothedTimes.at(stage) / budget);
+		}
+	}
+	return pressure;
+}
+
+
+float VolumetricResolutionController::GetCostScale(UINT fromTier, UINT toTier) const
+{
+	auto FroxelCount = [this](UINT tier)
+		{
+			const XMUINT3& resolution = m_Tiers.at(tier);
+			return static_cast<float>(resolution.x) * static_cast<float>(resolution.y) * static_cast<float>(resolution.z);
+		};
+
+	return FroxelCount(toTier) / FroxelCount(fromTier);
+}
+
+void VolumetricResolutionController::ChangeTier(UINT tier)
+{
+	// Keep the smoothed times continuous by predicting them at the new tier, until real measurements replace them
+	const float scale = GetCostScale(m_Tier, tier);
+	for (float& time : m_SmoothedTimes)
+	{
+		time *= scale;
+	}
+
+	m_Tier = tier;
+
+	m_OverBudgetFrames = 0;
+	m_UnderBudgetFrames = 0;
+	m_CooldownFramesRemaining = m_Settings.CooldownFrames;
+}
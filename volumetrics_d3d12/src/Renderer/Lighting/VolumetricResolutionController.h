@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Core.h"
+
+using namespace DirectX;
+
+
+/**
+ *	A VolumetricResolutionController picks the froxel volume resolution from a list of tiers,
+ *	so that the GPU time of each volumetrics stage stays within its budget.
+ *
+ *	Tiers are ordered from the most expensive (tier 0) to the cheapest. Stage times are smoothed,
+ *	and the cost of a stage is assumed to scale with the number of froxels, which is used to predict
+ *	the cost at other tiers.
+ *
+ *	To avoid oscillating between tiers:
+ *	- A tier is dropped once any stage has been over budget for DowngradeFrames frames in a row,
+ *	  skipping straight to the first tier that is predicted to fit.
+ *	- A tier is only raised once every stage has been predicted to fit at the higher tier, with some headroom,
+ *	  for UpgradeFrames frames in a row.
+ *	- No change is made for CooldownFrames frames after a change, while the new measurements arrive.
+ *
+ *	The controller has no knowledge of D3D, and is driven by timings fed in by the caller.
+ */
+class VolumetricResolutionController
+{
+public:
+	enum Stage
+	{
+		Stage_DensityEstimation = 0,
+		Stage_LightScattering,
+		Stage_VolumeIntegration,
+		StageCount
+	};
+
+	using StageTimes = std::array<float, StageCount>;
+
+	struct Settings
+	{
+		// GPU time allowed for each stage, in milliseconds
+		StageTimes StageBudgets = { 0.3f, 2.0f, 0.5f };
+
+		// Weight of the newest frame in the smoothed stage times
+		float Smoothing = 0.1f;
+
+		// Fraction of the budget that a stage must exceed to count as over budget
+		float DowngradeThreshold = 1.0f;
+		// Fraction of the budget that every stage must be predicted to stay under at the higher tier before upgrading
+		float UpgradeThreshold = 0.8f;
+
+		UINT DowngradeFrames = 8;
+		UINT UpgradeFrames = 120;
+		UINT CooldownFrames = 30;
+	};
+
+public:
+	// tiers must be ordered from the highest froxel count to the lowest
+	// Starts at tier 0 with the default settings, which can be changed through GetSettings()
+	VolumetricResolutionController(const std::vector<XMUINT3>& tiers);
+	~VolumetricResolutionController() = default;
+
+	DEFAULT_COPY(VolumetricResolutionController)
+	DEFAULT_MOVE(VolumetricResolutionController)
+
+	// Feeds in the GPU time of each stage for a frame that was rendered at measuredTier
+	// Frames rendered at a different tier to the current one (while a change is in flight) are rescaled to the current tier
+	// Returns true if the tier has changed
+	bool Update(const StageTimes& stageMilliseconds, UINT measuredTier);
+
+	// Moves to a tier directly, and restarts the measurements
+	void SetTier(UINT tier);
+
+	inline UINT GetTier() const { return m_Tier; }
+	inline UINT GetTierCount() const { return static_cast<UINT>(m_Tiers.size()); }
+	inline const XMUINT3& GetResolution() const { return m_Tiers.at(m_Tier); }
+	inline const XMUINT3& GetTierResolution(UINT tier) const { return m_Tiers.at(tier); }
+
+	// Smoothed stage times at the current tier
+	inline const StageTimes& GetSmoothedTimes() const { return m_SmoothedTimes; }
+	// The largest ratio of smoothed stage time to budget at the current tier
+	float GetBudgetPressure() const;
+
+	inline Settings& GetSettings() { return m_Settings; }
+	inline const Settings& GetSettings() const { return m_Settings; }
+
+private:
+	// Ratio of the froxel count of one tier to another, used to predict stage times
+	float GetCostScale(UINT fromTier, UINT toTier) const;
+
+	void ChangeTier(UINT tier);
+
+private:
+	std::vector<XMUINT3> m_Tiers;
+	Settings m_Settings;
+
+	UINT m_Tier = 0;
+
+	StageTimes m_SmoothedTimes = {};
+	bool m_HasMeasurements = false;
+
+	UINT m_OverBudgetFrames = 0;
+	UINT m_UnderBudgetFrames = 0;
+	UINT m_CooldownFramesRemaining = 0;
+};
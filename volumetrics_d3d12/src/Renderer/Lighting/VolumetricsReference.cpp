@@ -0,0 +1,1528 @@
+#include "pch.h"
+#include "VolumetricsReference.h"
+
+#include "FogNoiseBaker.h"
+#include "SparseBrickAtlas.h"
+#include "Framework/ThreadPool.h"
+
+#include <bit>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <immintrin.h>
+
+
+// Ports of the HLSL helpers used by the volumetrics shaders
+namespace
+{
+	inline float Saturate(float x)
+	{
+		return min(max(x, 0.0f), 1.0f);
+	}
+
+	// random.hlsli
+	XMUINT4 Rand4DPCG32(int px, int py, int pz, int pw)
+	{
+		UINT v[4] = { static_cast<UINT>(px), static_cast<UINT>(py), static_cast<UINT>(pz), static_cast<UINT>(pw) };
+
+		for (UINT& c : v)
+			c = c * 1664525u + 1013904223u;
+
+		v[0] += v[1] * v[3];
+		v[1] += v[2] * v[0];
+		v[2] += v[0] * v[1];
+		v[3] += v[1] * v[2];
+
+		for (UINT& c : v)
+			c ^= c >> 16u;
+
+		v[0] += v[1] * v[3];
+		v[1] += v[2] * v[0];
+		v[2] += v[0] * v[1];
+		v[3] += v[1] * v[2];
+
+		return { v[0], v[1], v[2], v[3] };
+	}
+
+	// clustered_lighting.hlsli
+	UINT GetLightClusterIndex(float u, float v, float froxelSlice, const XMUINT3& gridDimensions, float clusterDepthScale)
+	{
+		const UINT tileX = min(static_cast<UINT>(Saturate(u) * static_cast<float>(gridDimensions.x)), gridDimensions.x - 1);
+		const UINT tileY = min(static_cast<UINT>(Saturate(v) * static_cast<float>(gridDimensions.y)), gridDimensions.y - 1);
+		const float slice = min(max(froxelSlice * clusterDepthScale, 0.0f), static_cast<float>(gridDimensions.z - 1));
+
+		return (static_cast<UINT>(slice) * gridDimensions.y + tileY) * gridDimensions.x + tileX;
+	}
+
+	// EvaluateFogVolumeDensity from density_estimation_cs
+	float EvaluateFogVolumeDensity(const FogVolumeGPUData& volume, float x, float y, float z, const VolumetricsReference::Volume& densityAtlas, const SparseBrickAtlas* sparseAtlas)
+	{
+		auto Transform = [x, y, z](const XMFLOAT4& row) { return row.x * x + row.y * y + row.z * z + row.w; };
+		const float lx = Transform(volume.WorldToLocal[0]);
+		const float ly = Transform(volume.WorldToLocal[1]);
+		const float lz = Transform(volume.WorldToLocal[2]);
+
+		if (volume.Shape == FOG_VOLUME_SHAPE_BAKED)
+		{
+			if (densityAtlas.Texels.empty() || fabsf(lx) >= 1.0f || fabsf(ly) >= 1.0f || fabsf(lz) >= 1.0f)
+				return 0.0f;
+
+			const XMFLOAT3 uvw = {
+				volume.AtlasOffset.x + (lx * 0.5f + 0.5f) * volume.AtlasScale.x,
+				volume.AtlasOffset.y + (ly * 0.5f + 0.5f) * volume.AtlasScale.y,
+				volume.AtlasOffset.z + (lz * 0.5f + 0.5f) * volume.AtlasScale.z
+			};
+			return densityAtlas.SampleTrilinear(uvw).x;
+		}
+		if (volume.Shape == FOG_VOLUME_SHAPE_SPARSE)
+		{
+			if (!sparseAtlas || fabsf(lx) >= 1.0f || fabsf(ly) >= 1.0f || fabsf(lz) >= 1.0f)
+				return 0.0f;
+
+			return sparseAtlas->Sample(volume.AtlasOffset, volume.AtlasScale, { lx * 0.5f + 0.5f, ly * 0.5f + 0.5f, lz * 0.5f + 0.5f });
+		}
+
+		const float d = volume.Shape == FOG_VOLUME_SHAPE_BOX ? max(max(fabsf(lx), fabsf(ly)), fabsf(lz)) : sqrtf(lx * lx + ly * ly + lz * lz);
+
+		const float t = Saturate((1.0f - d) / max(volume.Falloff, 1e-4f));
+		return t * t * (3.0f - 2.0f * t);
+	}
+
+
+	// Scalar versions of the shader math, for the ground truth
+
+	inline float SmoothStep(float a, float b, float x)
+	{
+		const float t = Saturate((x - a) / (b - a));
+		return t * t * (3.0f - 2.0f * t);
+	}
+
+	// (1 - g^2) / (4 pi (1 + g^2 - 2g cos)^1.5)
+	inline float HGPhaseFunction(float cosTheta, float g)
+	{
+		const float base = 1.0f + g * g - 2.0f * g * cosTheta;
+		return (1.0f - g * g) / (4.0f * XM_PI * base * sqrtf(base));
+	}
+
+	// lighting_helper.hlsli
+	inline float DistanceAttenuation(float r, float rmax)
+	{
+		const float a1 = r / max(rmax, 0.0001f);
+		const float a2 = max(0.0f, 1.0f - a1 * a1);
+		return a2 * a2;
+	}
+
+	// GetSkySHDiffuse from lighting_helper.hlsli
+	void SkySHDiffuse(float nx, float ny, float nz, const XMFLOAT4* sh, float out[3])
+	{
+		const float sh6[3] = { sh[6].x, sh[6].y, sh[6].z };
+		for (UINT i = 0; i < 3; i++)
+		{
+			const XMFLOAT4& a = sh[i];
+			const XMFLOAT4& b = sh[3 + i];
+
+			const float intermediate0 = a.x * nx + a.y * ny + a.z * nz + a.w;
+			const float intermediate1 = b.x * nx * ny + b.y * ny * nz + b.z * nz * nz + b.w * nz * nx;
+			const float intermediate2 = sh6[i] * (nx * nx - ny * ny);
+
+			out[i] = max(0.0f, intermediate0 + intermediate1 + intermediate2);
+		}
+	}
+
+	// The media at a point, as density estimation stores them in the V-Buffers
+	struct Medium
+	{
+		XMFLOAT3 Scattering;
+		float Extinction;
+		XMFLOAT3 Emission;
+		float Anisotropy;
+	};
+
+	// volumetrics.hlsli
+	float EvaluateGlobalFogExtinction(const GlobalFogConstantBuffer& fog, float x, float y, float z)
+	{
+		const float r = fog.Radius;
+		const float s = fog.RadiusSmoothing;
+
+		float extinction = fog.Extinction;
+		extinction *= SmoothStep(-r - s, -r, x) * (1.0f - SmoothStep(r, r + s, x));
+		extinction *= SmoothStep(-r - s, -r, z) * (1.0f - SmoothStep(r, r + s, z));
+		extinction *= SmoothStep(0.0f, 1.0f, y) * (1.0f - SmoothStep(fog.MaxHeight, fog.MaxHeight + fog.HeightSmoothing, y));
+		return extinction;
+	}
+
+	// SampleFogClipmap from density_estimation_cs, for the extinction of the finest cascade that covers the point
+	// fog_clipmap_update_cs bakes the global fog at the centre of each voxel, so the voxels are evaluated here rather than stored,
+	// and the scattering of the clipmap is the albedo times its extinction
+	bool SampleFogClipmap(const FogClipmapConstantBuffer& clipmap, const GlobalFogConstantBuffer& fog, float x, float y, float z, float& extinction)
+	{
+		const float p[3] = { x, y, z };
+		const float resolution = static_cast<float>(clipmap.Resolution);
+
+		for (const FogClipmapCascadeGPUData& cascade : clipmap.Cascades)
+		{
+			const int origin[3] = { cascade.Origin.x, cascade.Origin.y, cascade.Origin.z };
+
+			// Filtering reads the voxels within half a voxel of the point, which must all be inside the cascade
+			float voxel[3];
+			bool isCovered = true;
+			for (UINT axis = 0; axis < 3; axis++)
+			{
+				voxel[axis] = p[axis] / cascade.VoxelSize;
+				const float local = voxel[axis] - static_cast<float>(origin[axis]);
+				isCovered &= local >= 0.5f && local <= resolution - 0.5f;
+			}
+			if (!isCovered)
+				continue;
+
+			// Voxel centres are at (i + 0.5) * VoxelSize, as with the texel centres of SampleTrilinear
+			float base[3], frac[3];
+			for (UINT axis = 0; axis < 3; axis++)
+			{
+				base[axis] = floorf(voxel[axis] - 0.5f);
+				frac[axis] = voxel[axis] - 0.5f - base[axis];
+			}
+
+			extinction = 0.0f;
+			for (UINT corner = 0; corner < 8; corner++)
+			{
+				const bool hx = corner & 1;
+				const bool hy = corner & 2;
+				const bool hz = corner & 4;
+
+				const float weight = (hx ? frac[0] : 1.0f - frac[0]) * (hy ? frac[1] : 1.0f - frac[1]) * (hz ? frac[2] : 1.0f - frac[2]);
+				extinction += weight * EvaluateGlobalFogExtinction(fog,
+					(base[0] + (hx ? 1.5f : 0.5f)) * cascade.VoxelSize,
+					(base[1] + (hy ? 1.5f : 0.5f)) * cascade.VoxelSize,
+					(base[2] + (hz ? 1.5f : 0.5f)) * cascade.VoxelSize);
+			}
+			return true;
+		}
+
+		return false;
+	}
+
+	// SampleFogNoise from density_estimation_cs, the factor in [1 - Strength, 1] to scale the global fog by
+	float SampleFogNoise(const VolumetricsReference::FrameInputs& inputs, float x, float y, float z)
+	{
+		const FogNoiseConstants& noise = inputs.FogNoise;
+		const float time = inputs.Pass.TotalTime;
+		const XMFLOAT3 uvw = {
+			(x - noise.WindVelocity.x * time) * noise.Frequency,
+			(y - noise.WindVelocity.y * time) * noise.Frequency,
+			(z - noise.WindVelocity.z * time) * noise.Frequency
+		};
+		const XMFLOAT4 sample = inputs.FogNoiseTexture.SampleTrilinearWrap(uvw);
+
+		const float density = sample.x + (sample.y - sample.x) * noise.WorleyWeight;
+		return 1.0f - noise.Strength * (1.0f - density);
+	}
+
+	// The extinction of the global fog at a point, as density_estimation_cs finds it
+	// It is read from the clipmap where that covers the point, and scaled by the noise
+	float EvaluateGlobalFog(const VolumetricsReference::FrameInputs& inputs, float x, float y, float z)
+	{
+		float extinction;
+		if (!inputs.FogClipmap.Enabled || !SampleFogClipmap(inputs.FogClipmap, inputs.GlobalFog, x, y, z, extinction))
+			extinction = EvaluateGlobalFogExtinction(inputs.GlobalFog, x, y, z);
+
+		if (inputs.FogNoise.Enabled && extinction > 0.0f)
+			extinction *= SampleFogNoise(inputs, x, y, z);
+
+		return extinction;
+	}
+
+	// DensityEstimationRow for a single point, with every fog volume rather than those binned to its tile
+	Medium EvaluateMedium(const VolumetricsReference::FrameInputs& inputs, float x, float y, float z)
+	{
+		const GlobalFogConstantBuffer& fog = inputs.GlobalFog;
+		const float extinction = EvaluateGlobalFog(inputs, x, y, z);
+
+		Medium medium = {
+			{ fog.Albedo.x * extinction, fog.Albedo.y * extinction, fog.Albedo.z * extinction },
+			extinction,
+			fog.Emission,
+			fog.Anisotropy * extinction
+		};
+
+		for (const FogVolumeGPUData& volume : inputs.FogVolumes)
+		{
+			const float density = EvaluateFogVolumeDensity(volume, x, y, z, inputs.FogDensityAtlas, inputs.SparseFogAtlas);
+			const float volumeExtinction = volume.Extinction * density;
+
+			medium.Extinction += volumeExtinction;
+			medium.Scattering.x += volume.Albedo.x * volumeExtinction;
+			medium.Scattering.y += volume.Albedo.y * volumeExtinction;
+			medium.Scattering.z += volume.Albedo.z * volumeExtinction;
+			medium.Emission.x += volume.Emission.x * density;
+			medium.Emission.y += volume.Emission.y * density;
+			medium.Emission.z += volume.Emission.z * density;
+			medium.Anisotropy += volume.Anisotropy * volumeExtinction;
+		}
+
+		// The global anisotropy is kept where there is no fog
+		medium.Anisotropy = medium.Extinction > 0.0f ? medium.Anisotropy / max(medium.Extinction, FLT_MIN) : fog.Anisotropy;
+		return medium;
+	}
+
+
+	// Index of the brick (or fog volume tile) containing a froxel
+	inline UINT GetBrickIndex(const XMUINT3& resolution, UINT x, UINT y, UINT z)
+	{
+		const UINT bricksX = resolution.x / VOLUME_BRICK_SIZE;
+		const UINT bricksY = resolution.y / VOLUME_BRICK_SIZE;
+		return ((z / VOLUME_BRICK_SIZE) * bricksY + y / VOLUME_BRICK_SIZE) * bricksX + x / VOLUME_BRICK_SIZE;
+	}
+
+	// Every brick is occupied without a mask
+	inline bool IsBrickOccupied(const std::vector<UINT>& occupancy, const XMUINT3& resolution, UINT x, UINT y, UINT z)
+	{
+		if (occupancy.empty())
+			return true;
+
+		const UINT brick = GetBrickIndex(resolution, x, y, z);
+		return (occupancy[brick / 32] >> (brick % 32)) & 1;
+	}
+
+
+	// 4-wide versions of the shader math
+
+	inline __m128 Madd(__m128 a, __m128 b, __m128 c)
+	{
+		return _mm_add_ps(_mm_mul_ps(a, b), c);
+	}
+
+	inline __m128 Saturate4(__m128 x)
+	{
+		return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+
+	inline __m128 SmoothStep4(float a, float b, __m128 x)
+	{
+		const __m128 t = Saturate4(_mm_div_ps(_mm_sub_ps(x, _mm_set1_ps(a)), _mm_set1_ps(b - a)));
+		return _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(t, t)));
+	}
+
+	inline __m128 Dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+	{
+		return Madd(ax, bx, Madd(ay, by, _mm_mul_ps(az, bz)));
+	}
+
+	// (1 - g^2) / (4 pi (1 + g^2 - 2g cos)^1.5)
+	inline __m128 HGPhaseFunction4(__m128 cosTheta, __m128 g)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 g2 = _mm_mul_ps(g, g);
+
+		const __m128 numerator = _mm_sub_ps(one, g2);
+		const __m128 base = _mm_sub_ps(_mm_add_ps(one, g2), _mm_mul_ps(_mm_add_ps(g, g), cosTheta));
+		const __m128 denominator = _mm_mul_ps(_mm_set1_ps(4.0f * XM_PI), _mm_mul_ps(base, _mm_sqrt_ps(base)));
+		return _mm_div_ps(numerator, denominator);
+	}
+
+	// lighting_helper.hlsli
+	inline __m128 DistanceAttenuation4(__m128 r, float rmax)
+	{
+		const __m128 a1 = _mm_div_ps(r, _mm_set1_ps(max(rmax, 0.0001f)));
+		const __m128 a2 = _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(a1, a1)));
+		return _mm_mul_ps(a2, a2);
+	}
+
+	// GetSkySHDiffuse from lighting_helper.hlsli
+	void SkySHDiffuse4(__m128 nx, __m128 ny, __m128 nz, const XMFLOAT4* sh, __m128 out[3])
+	{
+		const __m128 bx = _mm_mul_ps(nx, ny);
+		const __m128 by = _mm_mul_ps(ny, nz);
+		const __m128 bz = _mm_mul_ps(nz, nz);
+		const __m128 bw = _mm_mul_ps(nz, nx);
+		const __m128 c = _mm_sub_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny));
+
+		for (UINT i = 0; i < 3; i++)
+		{
+			const XMFLOAT4& a = sh[i];
+			const XMFLOAT4& b = sh[3 + i];
+			const float sh6[3] = { sh[6].x, sh[6].y, sh[6].z };
+
+			const __m128 intermediate0 = Madd(_mm_set1_ps(a.x), nx, Madd(_mm_set1_ps(a.y), ny, Madd(_mm_set1_ps(a.z), nz, _mm_set1_ps(a.w))));
+			const __m128 intermediate1 = Madd(_mm_set1_ps(b.x), bx, Madd(_mm_set1_ps(b.y), by, Madd(_mm_set1_ps(b.z), bz, _mm_mul_ps(_mm_set1_ps(b.w), bw))));
+			const __m128 intermediate2 = _mm_mul_ps(_mm_set1_ps(sh6[i]), c);
+
+			out[i] = _mm_max_ps(_mm_setzero_ps(), _mm_add_ps(_mm_add_ps(intermediate0, intermediate1), intermediate2));
+		}
+	}
+
+	// Loads 4 consecutive texels and splits them into a register per channel
+	inline void LoadTexels4(const XMFLOAT4* texels, __m128& r, __m128& g, __m128& b, __m128& a)
+	{
+		r = _mm_loadu_ps(&texels[0].x);
+		g = _mm_loadu_ps(&texels[1].x);
+		b = _mm_loadu_ps(&texels[2].x);
+		a = _mm_loadu_ps(&texels[3].x);
+		_MM_TRANSPOSE4_PS(r, g, b, a);
+	}
+
+	inline void StoreTexels4(XMFLOAT4* texels, __m128 r, __m128 g, __m128 b, __m128 a)
+	{
+		_MM_TRANSPOSE4_PS(r, g, b, a);
+		_mm_storeu_ps(&texels[0].x, r);
+		_mm_storeu_ps(&texels[1].x, g);
+		_mm_storeu_ps(&texels[2].x, b);
+		_mm_storeu_ps(&texels[3].x, a);
+	}
+
+	// The number of lanes processed at once along a row of froxels
+	constexpr UINT s_Lanes = 4;
+
+	// The integration of a segment of 4 columns, as in volume_integration_scan_cs
+	// RGB - Scattering reaching the front of the segment, T - Transmittance through it
+	struct Segment4
+	{
+		__m128 R;
+		__m128 G;
+		__m128 B;
+		__m128 T;
+	};
+
+	// An empty segment, which combines with others without changing them
+	inline Segment4 EmptySegment4()
+	{
+		return { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_set1_ps(1.0f) };
+	}
+
+	// Appends back to the end of front, with the same operations as a step of the serial march
+	inline Segment4 CombineSegments4(const Segment4& front, const Segment4& back)
+	{
+		return {
+			Madd(back.R, front.T, front.R),
+			Madd(back.G, front.T, front.G),
+			Madd(back.B, front.T, front.B),
+			_mm_mul_ps(front.T, back.T)
+		};
+	}
+
+	using Clock = std::chrono::steady_clock;
+
+	inline double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+
+	// Golden volume file header
+	struct VolumeFileHeader
+	{
+		char Magic[4];
+		UINT Width;
+		UINT Height;
+		UINT Depth;
+	};
+
+	constexpr char s_VolumeFileMagic[4] = { 'F', 'R', 'X', 'V' };
+}
+
+
+void VolumetricsReference::Volume::Resize(const XMUINT3& dimensions)
+{
+	Dimensions = dimensions;
+	Texels.assign(static_cast<size_t>(dimensions.x) * dimensions.y * dimensions.z, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+}
+
+XMFLOAT4 VolumetricsReference::Volume::SampleTrilinear(const XMFLOAT3& uvw) const
+{
+	const float coords[3] = { uvw.x, uvw.y, uvw.z };
+	const UINT dims[3] = { Dimensions.x, Dimensions.y, Dimensions.z };
+
+	// Texel centres are at (i + 0.5) / size, and addresses outside the volume are clamped to the edge
+	UINT i0[3], i1[3];
+	float frac[3];
+	for (UINT axis = 0; axis < 3; axis++)
+	{
+		const float t = coords[axis] * static_cast<float>(dims[axis]) - 0.5f;
+		const float base = floorf(t);
+		frac[axis] = t - base;
+
+		const int maxIndex = static_cast<int>(dims[axis]) - 1;
+		i0[axis] = static_cast<UINT>(min(max(static_cast<int>(base), 0), maxIndex));
+		i1[axis] = static_cast<UINT>(min(max(static_cast<int>(base) + 1, 0), maxIndex));
+	}
+
+	XMVECTOR result = XMVectorZero();
+	for (UINT corner = 0; corner < 8; corner++)
+	{
+		const bool hx = corner & 1;
+		const bool hy = corner & 2;
+		const bool hz = corner & 4;
+
+		const float weight = (hx ? frac[0] : 1.0f - frac[0]) * (hy ? frac[1] : 1.0f - frac[1]) * (hz ? frac[2] : 1.0f - frac[2]);
+		const XMFLOAT4& texel = At(hx ? i1[0] : i0[0], hy ? i1[1] : i0[1], hz ? i1[2] : i0[2]);
+		result += XMLoadFloat4(&texel) * weight;
+	}
+
+	XMFLOAT4 sample;
+	XMStoreFloat4(&sample, result);
+	return sample;
+}
+
+XMFLOAT4 VolumetricsReference::Volume::SampleTrilinearWrap(const XMFLOAT3& uvw) const
+{
+	const float coords[3] = { uvw.x, uvw.y, uvw.z };
+	const UINT dims[3] = { Dimensions.x, Dimensions.y, Dimensions.z };
+
+	// As SampleTrilinear, with addresses outside the volume wrapped around to the other side
+	UINT i0[3], i1[3];
+	float frac[3];
+	for (UINT axis = 0; axis < 3; axis++)
+	{
+		const float t = coords[axis] * static_cast<float>(dims[axis]) - 0.5f;
+		const float base = floorf(t);
+		frac[axis] = t - base;
+
+		const int size = static_cast<int>(dims[axis]);
+		const int index = static_cast<int>(base) % size;
+		i0[axis] = static_cast<UINT>(index < 0 ? index + size : index);
+		i1[axis] = (i0[axis] + 1) % dims[axis];
+	}
+
+	XMVECTOR result = XMVectorZero();
+	for (UINT corner = 0; corner < 8; corner++)
+	{
+		const bool hx = corner & 1;
+		const bool hy = corner & 2;
+		const bool hz = corner & 4;
+
+		const float weight = (hx ? frac[0] : 1.0f - frac[0]) * (hy ? frac[1] : 1.0f - frac[1]) * (hz ? frac[2] : 1.0f - frac[2]);
+		const XMFLOAT4& texel = At(hx ? i1[0] : i0[0], hy ? i1[1] : i0[1], hz ? i1[2] : i0[2]);
+		result += XMLoadFloat4(&texel) * weight;
+	}
+
+	XMFLOAT4 sample;
+	XMStoreFloat4(&sample, result);
+	return sample;
+}
+
+
+VolumetricsReference::VolumetricsReference(ThreadPool& threadPool)
+	: m_ThreadPool(&threadPool)
+{
+}
+
+void VolumetricsReference::RenderFrame(const FrameInputs& inputs)
+{
+	const XMUINT3& resolution = inputs.Volume.VolumeResolution;
+	ASSERT(resolution.x % s_Lanes == 0 && resolution.y > 0 && resolution.z > 1, "Volume width must be a multiple of 4");
+
+	const UINT brickCount = (resolution.x / VOLUME_BRICK_SIZE) * (resolution.y / VOLUME_BRICK_SIZE) * (resolution.z / VOLUME_BRICK_SIZE);
+	const bool usesBricks = !inputs.FogVolumes.empty() || !inputs.BrickOccupancy.empty();
+	ASSERT(!usesBricks || (resolution.x % VOLUME_BRICK_SIZE == 0 && resolution.y % VOLUME_BRICK_SIZE == 0 && resolution.z % VOLUME_BRICK_SIZE == 0),
+		"Every dimension of the volume must be a multiple of the brick size");
+	ASSERT(inputs.FogVolumes.empty() || inputs.FogVolumeTileRanges.size() == brickCount, "Fog volume tiles do not match the volume");
+	ASSERT(inputs.BrickOccupancy.empty() || inputs.BrickOccupancy.size() == (brickCount + 31) / 32, "Brick occupancy does not match the volume");
+	ASSERT(!inputs.FogNoise.Enabled || !inputs.FogNoiseTexture.Texels.empty(), "Fog noise is enabled without a noise texture");
+
+	m_ActiveBrickFraction = 1.0f;
+	if (!inputs.BrickOccupancy.empty())
+	{
+		UINT activeBricks = 0;
+		for (UINT brick = 0; brick < brickCount; brick++)
+		{
+			activeBricks += (inputs.BrickOccupancy[brick / 32] >> (brick % 32)) & 1;
+		}
+		m_ActiveBrickFraction = static_cast<float>(activeBricks) / static_cast<float>(brickCount);
+	}
+
+	auto Matches = [&resolution](const Volume& volume)
+		{
+			return volume.Dimensions.x == resolution.x && volume.Dimensions.y == resolution.y && volume.Dimensions.z == resolution.z;
+		};
+
+	// Volumes only need to be reallocated when the resolution changes
+	if (!Matches(m_VBufferA))
+	{
+		m_VBufferA.Resize(resolution);
+		m_VBufferB.Resize(resolution);
+		m_IntegratedVolume.Resize(resolution);
+
+		if (m_LightScatteringVolumes.at(m_CurrentLightScatteringVolume).Texels.empty())
+			ResetHistory();
+	}
+
+	// Flip previous and current light scattering volumes
+	m_CurrentLightScatteringVolume = 1 - m_CurrentLightScatteringVolume;
+
+	// As on the GPU, history from before a resize is kept, and is sampled at its own resolution
+	Volume& current = m_LightScatteringVolumes.at(m_CurrentLightScatteringVolume);
+	if (!Matches(current))
+		current.Resize(resolution);
+
+	// The shaders multiply row vectors with matrices that were transposed on upload
+	m_Matrices.InvView = XMMatrixTranspose(inputs.Pass.InvView);
+	m_Matrices.InvProj = XMMatrixTranspose(inputs.Pass.InvProj);
+	m_Matrices.PrevView = XMMatrixTranspose(inputs.Pass.PrevView);
+	m_Matrices.PrevProj = XMMatrixTranspose(inputs.Pass.PrevProj);
+
+	Clock::time_point start = Clock::now();
+	DensityEstimation(inputs);
+	m_Timings.DensityEstimation = MillisecondsSince(start);
+
+	start = Clock::now();
+	LightScattering(inputs);
+	m_Timings.LightScattering = MillisecondsSince(start);
+
+	start = Clock::now();
+	VolumeIntegration(inputs);
+	m_Timings.VolumeIntegration = MillisecondsSince(start);
+
+	start = Clock::now();
+	ApplyVolumetrics(inputs);
+	m_Timings.ApplyVolumetrics = MillisecondsSince(start);
+}
+
+void VolumetricsReference::ResetHistory()
+{
+	for (auto& volume : m_LightScatteringVolumes)
+	{
+		volume.Resize(m_VBufferA.Dimensions);
+	}
+}
+
+void VolumetricsReference::RenderGroundTruth(const FrameInputs& inputs, const GroundTruthDesc& desc, Volume& image) const
+{
+	ASSERT(!inputs.FogNoise.Enabled || !inputs.FogNoiseTexture.Texels.empty(), "Fog noise is enabled without a noise texture");
+
+	const PassConstantBuffer& pass = inputs.Pass;
+	const LightingConstantBuffer& lighting = inputs.Lighting;
+	const UINT flags = inputs.Volume.Flags;
+	const XMUINT2& size = pass.RTSize;
+
+	ASSERT(desc.StepLength > 0.0f, "The ground truth step length must be positive");
+
+	const bool hasScene = !inputs.SceneDepth.empty();
+	ASSERT(!hasScene || (inputs.SceneDepth.size() == static_cast<size_t>(size.x) * size.y && inputs.SceneColor.size() == inputs.SceneDepth.size()), "Scene buffers do not match the render target size");
+
+	image.Resize({ size.x, size.y, 1 });
+
+	const XMMATRIX invView = XMMatrixTranspose(pass.InvView);
+	const XMMATRIX invProj = XMMatrixTranspose(pass.InvProj);
+	const XMFLOAT3& eye = pass.WorldEyePos;
+
+	const XMVECTOR sunDirection = -XMVector3Normalize(XMLoadFloat3(&lighting.DirectionalLight.Direction));
+	const XMFLOAT3 sunL = { XMVectorGetX(sunDirection), XMVectorGetY(sunDirection), XMVectorGetZ(sunDirection) };
+	const float sunIntensity = lighting.DirectionalLight.Intensity;
+
+	m_ThreadPool->ParallelFor(size.y, 1, [&](UINT begin, UINT end)
+		{
+			for (UINT y = begin; y < end; y++)
+			{
+				for (UINT x = 0; x < size.x; x++)
+				{
+					const size_t pixel = static_cast<size_t>(y) * size.x + x;
+					const float sceneDepth = hasScene ? inputs.SceneDepth[pixel] : 1.0f;
+					const XMFLOAT4 pixelWithoutFog = hasScene ? inputs.SceneColor[pixel] : XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+					const float u = (static_cast<float>(x) + 0.5f) * pass.InvRTSize.x;
+					const float v = (static_cast<float>(y) + 0.5f) * pass.InvRTSize.y;
+
+					// The view ray through the pixel, with its length per unit of view depth
+					XMVECTOR p_vs = XMVector4Transform(XMVectorSet(2.0f * u - 1.0f, -(2.0f * v - 1.0f), sceneDepth, 1.0f), invProj);
+					p_vs /= XMVectorGetW(p_vs);
+					const float viewDepth = XMVectorGetZ(p_vs);
+
+					const XMVECTOR rayPerDepth = XMVector4Transform(XMVectorSetW(p_vs / viewDepth, 0.0f), invView);
+					const float lengthPerDepth = XMVectorGetX(XMVector3Length(rayPerDepth));
+					XMFLOAT3 ray;
+					XMStoreFloat3(&ray, rayPerDepth / lengthPerDepth);
+
+					// From the near plane to the scene, clipped to the bounds of the fog
+					float tMin = pass.NearPlane * lengthPerDepth;
+					float tMax = viewDepth * lengthPerDepth;
+
+					const float origin[3] = { eye.x, eye.y, eye.z };
+					const float direction[3] = { ray.x, ray.y, ray.z };
+					const float boundsMin[3] = { desc.BoundsMin.x, desc.BoundsMin.y, desc.BoundsMin.z };
+					const float boundsMax[3] = { desc.BoundsMax.x, desc.BoundsMax.y, desc.BoundsMax.z };
+					for (UINT axis = 0; axis < 3; axis++)
+					{
+						if (fabsf(direction[axis]) < 1e-8f)
+						{
+							if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis])
+								tMax = tMin;
+							continue;
+						}
+
+						const float t0 = (boundsMin[axis] - origin[axis]) / direction[axis];
+						const float t1 = (boundsMax[axis] - origin[axis]) / direction[axis];
+						tMin = max(tMin, min(t0, t1));
+						tMax = min(tMax, max(t0, t1));
+					}
+
+					float accumulated[3] = { 0.0f, 0.0f, 0.0f };
+					float accumulatedTransmittance = 1.0f;
+
+					if (tMax > tMin)
+					{
+						// Steps of at most StepLength, each sampled at a random point, so that the remaining error is noise rather than banding
+						const UINT stepCount = static_cast<UINT>(ceilf((tMax - tMin) / desc.StepLength));
+						const float stepLength = (tMax - tMin) / static_cast<float>(stepCount);
+
+						for (UINT step = 0; step < stepCount; step++)
+						{
+							const XMUINT4 rand32Bits = Rand4DPCG32(static_cast<int>(x), static_cast<int>(y), static_cast<int>(step), 0);
+							const float t = tMin + (static_cast<float>(step) + static_cast<float>(rand32Bits.x) / static_cast<float>(0xffffffffu)) * stepLength;
+
+							const float px = eye.x + ray.x * t;
+							const float py = eye.y + ray.y * t;
+							const float pz = eye.z + ray.z * t;
+
+							const Medium medium = EvaluateMedium(inputs, px, py, pz);
+							if (medium.Extinction <= 0.0f)
+								continue;
+
+							const float sunVisibility = inputs.SunVisibility ? inputs.SunVisibility({ px, py, pz }) : 1.0f;
+
+							// Lighting, as in LightScatteringRow
+							float inScattering[3] = { medium.Emission.x, medium.Emission.y, medium.Emission.z };
+
+							if (!(flags & VOLUME_FLAGS_DISABLE_SUN))
+							{
+								const float phase = HGPhaseFunction(ray.x * sunL.x + ray.y * sunL.y + ray.z * sunL.z, medium.Anisotropy) * sunVisibility;
+								inScattering[0] += phase * sunIntensity * lighting.DirectionalLight.Color.x;
+								inScattering[1] += phase * sunIntensity * lighting.DirectionalLight.Color.y;
+								inScattering[2] += phase * sunIntensity * lighting.DirectionalLight.Color.z;
+							}
+
+							if (!(flags & VOLUME_FLAGS_DISABLE_AMBIENT))
+							{
+								float ambient[3];
+								SkySHDiffuse(ray.x * medium.Anisotropy, ray.y * medium.Anisotropy, ray.z * medium.Anisotropy, lighting.SkyIrradianceEnvironmentMap, ambient);
+								for (UINT i = 0; i < 3; i++)
+									inScattering[i] += sunVisibility * ambient[i];
+							}
+
+							if (!(flags & VOLUME_FLAGS_DISABLE_POINT_LIGHTS))
+							{
+								for (const PointLightGPUData& light : inputs.PointLights)
+								{
+									float lx = light.Position.x - px;
+									float ly = light.Position.y - py;
+									float lz = light.Position.z - pz;
+									const float d = sqrtf(lx * lx + ly * ly + lz * lz);
+									if (d >= light.Range)
+										continue;
+
+									lx /= d;
+									ly /= d;
+									lz /= d;
+
+									const float weight = HGPhaseFunction(ray.x * lx + ray.y * ly + ray.z * lz, medium.Anisotropy) * DistanceAttenuation(d, light.Range) * light.Intensity;
+									inScattering[0] += weight * light.Color.x;
+									inScattering[1] += weight * light.Color.y;
+									inScattering[2] += weight * light.Color.z;
+								}
+							}
+
+							// Integration of the step, as in volume_integration_cs
+							const float transmittance = expf(-medium.Extinction * stepLength);
+							const float scattering[3] = { inScattering[0] * medium.Scattering.x, inScattering[1] * medium.Scattering.y, inScattering[2] * medium.Scattering.z };
+							for (UINT i = 0; i < 3; i++)
+								accumulated[i] += (scattering[i] - scattering[i] * transmittance) / max(medium.Extinction, 0.00001f) * accumulatedTransmittance;
+
+							accumulatedTransmittance *= transmittance;
+						}
+					}
+
+					image.At(x, y, 0) = {
+						pixelWithoutFog.x * accumulatedTransmittance + accumulated[0],
+						pixelWithoutFog.y * accumulatedTransmittance + accumulated[1],
+						pixelWithoutFog.z * accumulatedTransmittance + accumulated[2],
+						1.0f
+					};
+				}
+			}
+		});
+}
+
+
+PassConstantBuffer VolumetricsReference::BuildPassConstants(
+	const XMMATRIX& view,
+	const XMMATRIX& projection,
+	const XMMATRIX& prevView,
+	const XMMATRIX& prevProjection,
+	const XMFLOAT3& eyePosition,
+	const XMUINT2& renderTargetSize,
+	float nearPlane,
+	float farPlane,
+	UINT frameIndex)
+{
+	const XMMATRIX viewProj = XMMatrixMultiply(view, projection);
+
+	PassConstantBuffer pass = {};
+	pass.View = XMMatrixTranspose(view);
+	pass.InvView = XMMatrixTranspose(XMMatrixInverse(nullptr, view));
+	pass.Proj = XMMatrixTranspose(projection);
+	pass.InvProj = XMMatrixTranspose(XMMatrixInverse(nullptr, projection));
+	pass.ViewProj = XMMatrixTranspose(viewProj);
+	pass.InvViewProj = XMMatrixTranspose(XMMatrixInverse(nullptr, viewProj));
+
+	pass.PrevView = XMMatrixTranspose(prevView);
+	pass.PrevProj = XMMatrixTranspose(prevProjection);
+	pass.PrevViewProj = XMMatrixTranspose(XMMatrixMultiply(prevView, prevProjection));
+
+	pass.WorldEyePos = eyePosition;
+
+	pass.RTSize = renderTargetSize;
+	pass.InvRTSize = XMFLOAT2(1.0f / static_cast<float>(renderTargetSize.x), 1.0f / static_cast<float>(renderTargetSize.y));
+
+	pass.NearPlane = nearPlane;
+	pass.FarPlane = farPlane;
+	pass.ViewDepthToNDC = {
+		/* A = */ farPlane / (farPlane - nearPlane),
+		/* B = */ farPlane * nearPlane / (farPlane - nearPlane)
+	};
+
+	pass.FrameIndexMod16 = frameIndex % 16;
+
+	return pass;
+}
+
+
+void VolumetricsReference::DensityEstimation(const FrameInputs& inputs)
+{
+	const XMUINT3& resolution = inputs.Volume.VolumeResolution;
+	m_ThreadPool->ParallelFor(resolution.y * resolution.z, 4, [&](UINT begin, UINT end)
+		{
+			for (UINT row = begin; row < end; row++)
+			{
+				DensityEstimationRow(inputs, row % resolution.y, row / resolution.y);
+			}
+		});
+}
+
+void VolumetricsReference::DensityEstimationRow(const FrameInputs& inputs, UINT y, UINT z)
+{
+	const XMUINT3& resolution = inputs.Volume.VolumeResolution;
+	const GlobalFogConstantBuffer& fog = inputs.GlobalFog;
+	const XMMATRIX& invProj = m_Matrices.InvProj;
+	const XMMATRIX& invView = m_Matrices.InvView;
+
+	// Depth and the vertical NDC coordinate are constant along the row, so only x varies between froxels
+	// Density estimation samples froxels at the start of their slice
+	const float depth = Volumetrics::ZSliceToFroxelDepth(static_cast<float>(z), inputs.Pass.NearPlane, inputs.Volume.MaxVolumeDistance, resolution.z,
+		inputs.Volume.DepthDistribution, inputs.Volume.HybridLinearDepth);
+	const float depthNDC = inputs.Pass.ViewDepthToNDC.x - inputs.Pass.ViewDepthToNDC.y / depth;
+	const float ndcY = -(2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(resolution.y) - 1.0f);
+
+	// The part of the un-projection that does not depend on x
+	const XMVECTOR rowConstant = XMVector4Transform(XMVectorSet(0.0f, ndcY, depthNDC, 1.0f), invProj);
+
+	const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 invWidth = _mm_set1_ps(1.0f / static_cast<float>(resolution.x));
+
+	const bool hasFogVolumes = !inputs.FogVolumes.empty();
+	// The clipmap and noise are sampled one lane at a time, and the global fog is evaluated 4 lanes at a time without them
+	const bool sampleGlobalFogPerLane = inputs.FogClipmap.Enabled || inputs.FogNoise.Enabled;
+
+	for (UINT x = 0; x < resolution.x; x += s_Lanes)
+	{
+		// Froxels of inactive bricks are never read, so they are left as they are
+		if (!IsBrickOccupied(inputs.BrickOccupancy, resolution, x, y, z))
+			continue;
+
+		const __m128 uvX = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets), invWidth);
+		const __m128 ndcX = _mm_sub_ps(_mm_add_ps(uvX, uvX), _mm_set1_ps(1.0f));
+
+		// View-space position
+		__m128 vsX = Madd(ndcX, _mm_set1_ps(XMVectorGetX(invProj.r[0])), _mm_set1_ps(XMVectorGetX(rowConstant)));
+		__m128 vsY = Madd(ndcX, _mm_set1_ps(XMVectorGetY(invProj.r[0])), _mm_set1_ps(XMVectorGetY(rowConstant)));
+		__m128 vsZ = Madd(ndcX, _mm_set1_ps(XMVectorGetZ(invProj.r[0])), _mm_set1_ps(XMVectorGetZ(rowConstant)));
+		const __m128 vsW = Madd(ndcX, _mm_set1_ps(XMVectorGetW(invProj.r[0])), _mm_set1_ps(XMVectorGetW(rowConstant)));
+		vsX = _mm_div_ps(vsX, vsW);
+		vsY = _mm_div_ps(vsY, vsW);
+		vsZ = _mm_div_ps(vsZ, vsW);
+
+		// World-space position
+		const __m128 wsX = Madd(vsX, _mm_set1_ps(XMVectorGetX(invView.r[0])), Madd(vsY, _mm_set1_ps(XMVectorGetX(invView.r[1])), Madd(vsZ, _mm_set1_ps(XMVectorGetX(invView.r[2])), _mm_set1_ps(XMVectorGetX(invView.r[3])))));
+		const __m128 wsY = Madd(vsX, _mm_set1_ps(XMVectorGetY(invView.r[0])), Madd(vsY, _mm_set1_ps(XMVectorGetY(invView.r[1])), Madd(vsZ, _mm_set1_ps(XMVectorGetY(invView.r[2])), _mm_set1_ps(XMVectorGetY(invView.r[3])))));
+		const __m128 wsZ = Madd(vsX, _mm_set1_ps(XMVectorGetZ(invView.r[0])), Madd(vsY, _mm_set1_ps(XMVectorGetZ(invView.r[1])), Madd(vsZ, _mm_set1_ps(XMVectorGetZ(invView.r[2])), _mm_set1_ps(XMVectorGetZ(invView.r[3])))));
+
+		__m128 extinction;
+		if (sampleGlobalFogPerLane)
+		{
+			alignas(16) float px[s_Lanes], py[s_Lanes], pz[s_Lanes];
+			alignas(16) float laneExtinction[s_Lanes];
+			_mm_store_ps(px, wsX);
+			_mm_store_ps(py, wsY);
+			_mm_store_ps(pz, wsZ);
+
+			for (UINT lane = 0; lane < s_Lanes; lane++)
+				laneExtinction[lane] = EvaluateGlobalFog(inputs, px[lane], py[lane], pz[lane]);
+
+			extinction = _mm_load_ps(laneExtinction);
+		}
+		else
+		{
+			// Confine fog to a cuboid
+			const float r = fog.Radius;
+			const float s = fog.RadiusSmoothing;
+			const __m128 one = _mm_set1_ps(1.0f);
+
+			extinction = _mm_set1_ps(fog.Extinction);
+			extinction = _mm_mul_ps(extinction, _mm_mul_ps(SmoothStep4(-r - s, -r, wsX), _mm_sub_ps(one, SmoothStep4(r, r + s, wsX))));
+			extinction = _mm_mul_ps(extinction, _mm_mul_ps(SmoothStep4(-r - s, -r, wsZ), _mm_sub_ps(one, SmoothStep4(r, r + s, wsZ))));
+			extinction = _mm_mul_ps(extinction, _mm_mul_ps(SmoothStep4(0.0f, 1.0f, wsY), _mm_sub_ps(one, SmoothStep4(fog.MaxHeight, fog.MaxHeight + fog.HeightSmoothing, wsY))));
+		}
+
+		__m128 scatteringR = _mm_mul_ps(_mm_set1_ps(fog.Albedo.x), extinction);
+		__m128 scatteringG = _mm_mul_ps(_mm_set1_ps(fog.Albedo.y), extinction);
+		__m128 scatteringB = _mm_mul_ps(_mm_set1_ps(fog.Albedo.z), extinction);
+		__m128 emissionR = _mm_set1_ps(fog.Emission.x);
+		__m128 emissionG = _mm_set1_ps(fog.Emission.y);
+		__m128 emissionB = _mm_set1_ps(fog.Emission.z);
+
+		// The phase is averaged over the media, weighted by their extinction
+		__m128 weightedAnisotropy = _mm_mul_ps(_mm_set1_ps(fog.Anisotropy), extinction);
+
+		// Local fog volumes are only listed for some tiles, so they are added one lane at a time
+		// Both lane groups of a brick lie within the same tile
+		const XMUINT2 tileVolumes = hasFogVolumes ? inputs.FogVolumeTileRanges[GetBrickIndex(resolution, x, y, z)] : XMUINT2(0, 0);
+		if (tileVolumes.y > 0)
+		{
+			alignas(16) float px[s_Lanes], py[s_Lanes], pz[s_Lanes];
+			alignas(16) float laneExtinction[s_Lanes], laneAnisotropy[s_Lanes];
+			alignas(16) float laneScattering[3][s_Lanes], laneEmission[3][s_Lanes];
+			_mm_store_ps(px, wsX);
+			_mm_store_ps(py, wsY);
+			_mm_store_ps(pz, wsZ);
+			_mm_store_ps(laneExtinction, extinction);
+			_mm_store_ps(laneAnisotropy, weightedAnisotropy);
+			_mm_store_ps(laneScattering[0], scatteringR);
+			_mm_store_ps(laneScattering[1], scatteringG);
+			_mm_store_ps(laneScattering[2], scatteringB);
+			_mm_store_ps(laneEmission[0], emissionR);
+			_mm_store_ps(laneEmission[1], emissionG);
+			_mm_store_ps(laneEmission[2], emissionB);
+
+			for (UINT i = 0; i < tileVolumes.y; i++)
+			{
+				const FogVolumeGPUData& volume = inputs.FogVolumes[inputs.FogVolumeIndices[tileVolumes.x + i]];
+
+				for (UINT lane = 0; lane < s_Lanes; lane++)
+				{
+					const float density = EvaluateFogVolumeDensity(volume, px[lane], py[lane], pz[lane], inputs.FogDensityAtlas, inputs.SparseFogAtlas);
+					const float volumeExtinction = volume.Extinction * density;
+
+					laneExtinction[lane] += volumeExtinction;
+					laneScattering[0][lane] += volume.Albedo.x * volumeExtinction;
+					laneScattering[1][lane] += volume.Albedo.y * volumeExtinction;
+					laneScattering[2][lane] += volume.Albedo.z * volumeExtinction;
+					laneEmission[0][lane] += volume.Emission.x * density;
+					laneEmission[1][lane] += volume.Emission.y * density;
+					laneEmission[2][lane] += volume.Emission.z * density;
+					laneAnisotropy[lane] += volume.Anisotropy * volumeExtinction;
+				}
+			}
+
+			extinction = _mm_load_ps(laneExtinction);
+			weightedAnisotropy = _mm_load_ps(laneAnisotropy);
+			scatteringR = _mm_load_ps(laneScattering[0]);
+			scatteringG = _mm_load_ps(laneScattering[1]);
+			scatteringB = _mm_load_ps(laneScattering[2]);
+			emissionR = _mm_load_ps(laneEmission[0]);
+			emissionG = _mm_load_ps(laneEmission[1]);
+			emissionB = _mm_load_ps(laneEmission[2]);
+		}
+
+		// The global anisotropy is kept where there is no fog
+		const __m128 hasExtinction = _mm_cmpgt_ps(extinction, _mm_setzero_ps());
+		const __m128 anisotropy = _mm_or_ps(
+			_mm_and_ps(hasExtinction, _mm_div_ps(weightedAnisotropy, _mm_max_ps(extinction, _mm_set1_ps(FLT_MIN)))),
+			_mm_andnot_ps(hasExtinction, _mm_set1_ps(fog.Anisotropy)));
+
+		StoreTexels4(&m_VBufferA.At(x, y, z), scatteringR, scatteringG, scatteringB, extinction);
+		StoreTexels4(&m_VBufferB.At(x, y, z), emissionR, emissionG, emissionB, anisotropy);
+	}
+}
+
+
+void VolumetricsReference::LightScattering(const FrameInputs& inputs)
+{
+	const XMUINT3& resolution = inputs.Volume.VolumeResolution;
+	m_ThreadPool->ParallelFor(resolution.y * resolution.z, 4, [&](UINT begin, UINT end)
+		{
+			for (UINT row = begin; row < end; row++)
+			{
+				LightScatteringRow(inputs, row % resolution.y, row / resolution.y);
+			}
+		});
+}
+
+void VolumetricsReference::LightScatteringRow(const FrameInputs& inputs, UINT y, UINT z)
+{
+	const PassConstantBuffer& pass = inputs.Pass;
+	const LightingConstantBuffer& lighting = inputs.Lighting;
+	const VolumetricsConstantBuffer& volumeCB = inputs.Volume;
+	const XMUINT3& resolution = volumeCB.VolumeResolution;
+
+	const Volume& history = m_LightScatteringVolumes.at(1 - m_CurrentLightScatteringVolume);
+	Volume& output = m_LightScatteringVolumes.at(m_CurrentLightScatteringVolume);
+
+	const bool useClusters = !inputs.ClusterLightRanges.empty();
+
+	// Un-projects a (possibly jittered) position within the volume to world space
+	auto FroxelToWorld = [&](float fx, float fy, float fz)
+		{
+			const float depth = Volumetrics::ZSliceToFroxelDepth(fz, pass.NearPlane, volumeCB.MaxVolumeDistance, resolution.z, volumeCB.DepthDistribution, volumeCB.HybridLinearDepth);
+			const float depthNDC = pass.ViewDepthToNDC.x - pass.ViewDepthToNDC.y / depth;
+
+			const float u = fx / static_cast<float>(resolution.x);
+			const float v = fy / static_cast<float>(resolution.y);
+
+			XMVECTOR p_vs = XMVector4Transform(XMVectorSet(2.0f * u - 1.0f, -(2.0f * v - 1.0f), depthNDC, 1.0f), m_Matrices.InvProj);
+			p_vs /= XMVectorGetW(p_vs);
+			return XMVector4Transform(p_vs, m_Matrices.InvView);
+		};
+
+	// Sun
+	const XMVECTOR sunDirection = -XMVector3Normalize(XMLoadFloat3(&lighting.DirectionalLight.Direction));
+	const __m128 sunLX = _mm_set1_ps(XMVectorGetX(sunDirection));
+	const __m128 sunLY = _mm_set1_ps(XMVectorGetY(sunDirection));
+	const __m128 sunLZ = _mm_set1_ps(XMVectorGetZ(sunDirection));
+	const float sunIntensity = lighting.DirectionalLight.Intensity;
+	const XMFLOAT3 sunRadiance = {
+		sunIntensity * lighting.DirectionalLight.Color.x,
+		sunIntensity * lighting.DirectionalLight.Color.y,
+		sunIntensity * lighting.DirectionalLight.Color.z
+	};
+
+	for (UINT x = 0; x < resolution.x; x += s_Lanes)
+	{
+		// Bricks without fog have no scattering or extinction
+		if (!IsBrickOccupied(inputs.BrickOccupancy, resolution, x, y, z))
+		{
+			StoreTexels4(&output.At(x, y, z), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps());
+			continue;
+		}
+
+		// Per-froxel set-up that does not vectorise well: jitter, un-projection, history lookup and light cluster
+		alignas(16) float px[s_Lanes], py[s_Lanes], pz[s_Lanes];
+		alignas(16) float sunVisibility[s_Lanes];
+		alignas(16) float historyAlpha[s_Lanes];
+		XMFLOAT3 historyUVW[s_Lanes];
+		UINT cluster[s_Lanes];
+
+		for (UINT lane = 0; lane < s_Lanes; lane++)
+		{
+			const UINT fx = x + lane;
+
+			XMFLOAT3 cellOffset = { 0.5f, 0.5f, 0.5f };
+			if (volumeCB.UseTemporalReprojection)
+			{
+				const XMUINT4 rand32Bits = Rand4DPCG32(static_cast<int>(fx), static_cast<int>(y), static_cast<int>(z), static_cast<int>(pass.FrameIndexMod16));
+				const float maxValue = static_cast<float>(0xffffffffu);
+
+				cellOffset.x = volumeCB.LightScatteringJitterMultiplier * (static_cast<float>(rand32Bits.x) / maxValue - 0.5f);
+				cellOffset.y = volumeCB.LightScatteringJitterMultiplier * (static_cast<float>(rand32Bits.y) / maxValue - 0.5f);
+				cellOffset.z = volumeCB.LightScatteringJitterMultiplier * (static_cast<float>(rand32Bits.z) / maxValue - 0.5f);
+			}
+
+			// As in the shader, jitter keeps samples within half a slice of the slice's start, even with a multiplier above 1
+			const float sliceOffset = min(max(cellOffset.z, -0.5f), 0.5f);
+			const XMVECTOR p_ws = FroxelToWorld(static_cast<float>(fx) + cellOffset.x, static_cast<float>(y) + cellOffset.y, static_cast<float>(z) + sliceOffset);
+			px[lane] = XMVectorGetX(p_ws);
+			py[lane] = XMVectorGetY(p_ws);
+			pz[lane] = XMVectorGetZ(p_ws);
+
+			XMFLOAT3 worldPos;
+			XMStoreFloat3(&worldPos, p_ws);
+			sunVisibility[lane] = inputs.SunVisibility ? inputs.SunVisibility(worldPos) : 1.0f;
+
+			// Reproject the froxel centre into the previous frame's volume
+			historyAlpha[lane] = 0.0f;
+			if (volumeCB.UseTemporalReprojection)
+			{
+				const XMVECTOR centre = FroxelToWorld(static_cast<float>(fx) + 0.5f, static_cast<float>(y) + 0.5f, static_cast<float>(z) + 0.5f);
+				const XMVECTOR prev_vs = XMVector4Transform(XMVectorSetW(centre, 1.0f), m_Matrices.PrevView);
+				XMVECTOR prevNDC = XMVector4Transform(prev_vs, m_Matrices.PrevProj);
+				prevNDC /= XMVectorGetW(prevNDC);
+
+				const XMFLOAT3 uvw = {
+					XMVectorGetX(prevNDC) * 0.5f + 0.5f,
+					XMVectorGetY(prevNDC) * -0.5f + 0.5f,
+					Volumetrics::FroxelDepthToZSlice(XMVectorGetZ(prev_vs), pass.NearPlane, volumeCB.MaxVolumeDistance, history.Dimensions.z,
+						volumeCB.DepthDistribution, volumeCB.HybridLinearDepth) / static_cast<float>(history.Dimensions.z)
+				};
+
+				const bool outside = uvw.x < 0.0f || uvw.y < 0.0f || uvw.z < 0.0f || uvw.x > 1.0f || uvw.y > 1.0f || uvw.z > 1.0f;
+				historyAlpha[lane] = outside ? 0.0f : volumeCB.HistoryWeight;
+				historyUVW[lane] = uvw;
+			}
+
+			cluster[lane] = 0;
+			if (useClusters)
+			{
+				const float u = (static_cast<float>(fx) + cellOffset.x) / static_cast<float>(resolution.x);
+				const float v = (static_cast<float>(y) + cellOffset.y) / static_cast<float>(resolution.y);
+				cluster[lane] = GetLightClusterIndex(u, v, static_cast<float>(z) + sliceOffset, lighting.ClusterGridDimensions, lighting.ClusterDepthScale);
+			}
+		}
+
+		const __m128 pX = _mm_load_ps(px);
+		const __m128 pY = _mm_load_ps(py);
+		const __m128 pZ = _mm_load_ps(pz);
+		const __m128 visibility = _mm_load_ps(sunVisibility);
+
+		// View vector
+		__m128 vX = _mm_sub_ps(pX, _mm_set1_ps(pass.WorldEyePos.x));
+		__m128 vY = _mm_sub_ps(pY, _mm_set1_ps(pass.WorldEyePos.y));
+		__m128 vZ = _mm_sub_ps(pZ, _mm_set1_ps(pass.WorldEyePos.z));
+		const __m128 vLength = _mm_sqrt_ps(Dot3(vX, vY, vZ, vX, vY, vZ));
+		vX = _mm_div_ps(vX, vLength);
+		vY = _mm_div_ps(vY, vLength);
+		vZ = _mm_div_ps(vZ, vLength);
+
+		// Load values from the volume buffers
+		__m128 scatteringR, scatteringG, scatteringB, extinction;
+		LoadTexels4(&m_VBufferA.At(x, y, z), scatteringR, scatteringG, scatteringB, extinction);
+
+		__m128 inScatteringR, inScatteringG, inScatteringB, anisotropy;
+		LoadTexels4(&m_VBufferB.At(x, y, z), inScatteringR, inScatteringG, inScatteringB, anisotropy);
+
+		// Directional light
+		if (!(volumeCB.Flags & VOLUME_FLAGS_DISABLE_SUN))
+		{
+			const __m128 phase = _mm_mul_ps(HGPhaseFunction4(Dot3(vX, vY, vZ, sunLX, sunLY, sunLZ), anisotropy), visibility);
+			inScatteringR = Madd(phase, _mm_set1_ps(sunRadiance.x), inScatteringR);
+			inScatteringG = Madd(phase, _mm_set1_ps(sunRadiance.y), inScatteringG);
+			inScatteringB = Madd(phase, _mm_set1_ps(sunRadiance.z), inScatteringB);
+		}
+
+		// Sky ambient lighting
+		if (!(volumeCB.Flags & VOLUME_FLAGS_DISABLE_AMBIENT))
+		{
+			__m128 ambient[3];
+			SkySHDiffuse4(_mm_mul_ps(vX, anisotropy), _mm_mul_ps(vY, anisotropy), _mm_mul_ps(vZ, anisotropy), lighting.SkyIrradianceEnvironmentMap, ambient);
+			inScatteringR = Madd(visibility, ambient[0], inScatteringR);
+			inScatteringG = Madd(visibility, ambient[1], inScatteringG);
+			inScatteringB = Madd(visibility, ambient[2], inScatteringB);
+		}
+
+		// Point lights
+		// Lanes can fall into different clusters, in which case each cluster's lights are only added to its own lanes
+		if (!(volumeCB.Flags & VOLUME_FLAGS_DISABLE_POINT_LIGHTS))
+		{
+			UINT remainingLanes = (1u << s_Lanes) - 1;
+			while (remainingLanes)
+			{
+				const UINT firstLane = std::countr_zero(remainingLanes);
+
+				alignas(16) UINT laneMaskBits[s_Lanes];
+				for (UINT lane = 0; lane < s_Lanes; lane++)
+				{
+					const bool sameCluster = (remainingLanes & (1u << lane)) && cluster[lane] == cluster[firstLane];
+					laneMaskBits[lane] = sameCluster ? 0xffffffffu : 0u;
+					if (sameCluster)
+						remainingLanes &= ~(1u << lane);
+				}
+				const __m128 laneMask = _mm_load_ps(reinterpret_cast<const float*>(laneMaskBits));
+
+				UINT first = 0;
+				UINT count = static_cast<UINT>(inputs.PointLights.size());
+				if (useClusters)
+				{
+					const XMUINT2& range = inputs.ClusterLightRanges.at(cluster[firstLane]);
+					first = range.x;
+					count = range.y;
+				}
+
+				for (UINT i = 0; i < count; i++)
+				{
+					const UINT lightIndex = useClusters ? inputs.ClusterLightIndices[first + i] : i;
+					const PointLightGPUData& light = inputs.PointLights[lightIndex];
+
+					__m128 lX = _mm_sub_ps(_mm_set1_ps(light.Position.x), pX);
+					__m128 lY = _mm_sub_ps(_mm_set1_ps(light.Position.y), pY);
+					__m128 lZ = _mm_sub_ps(_mm_set1_ps(light.Position.z), pZ);
+					const __m128 d = _mm_sqrt_ps(Dot3(lX, lY, lZ, lX, lY, lZ));
+					lX = _mm_div_ps(lX, d);
+					lY = _mm_div_ps(lY, d);
+					lZ = _mm_div_ps(lZ, d);
+
+					const __m128 phase = HGPhaseFunction4(Dot3(vX, vY, vZ, lX, lY, lZ), anisotropy);
+					const __m128 atten = DistanceAttenuation4(d, light.Range);
+					const __m128 weight = _mm_and_ps(_mm_mul_ps(_mm_mul_ps(phase, atten), _mm_set1_ps(light.Intensity)), laneMask);
+
+					inScatteringR = Madd(weight, _mm_set1_ps(light.Color.x), inScatteringR);
+					inScatteringG = Madd(weight, _mm_set1_ps(light.Color.y), inScatteringG);
+					inScatteringB = Madd(weight, _mm_set1_ps(light.Color.z), inScatteringB);
+				}
+			}
+		}
+
+		__m128 outR = _mm_mul_ps(inScatteringR, scatteringR);
+		__m128 outG = _mm_mul_ps(inScatteringG, scatteringG);
+		__m128 outB = _mm_mul_ps(inScatteringB, scatteringB);
+		__m128 outA = extinction;
+
+		// Temporal reprojection
+		if (volumeCB.UseTemporalReprojection)
+		{
+			alignas(16) float historyR[s_Lanes], historyG[s_Lanes], historyB[s_Lanes], historyA[s_Lanes];
+			for (UINT lane = 0; lane < s_Lanes; lane++)
+			{
+				const XMFLOAT4 sample = history.SampleTrilinear(historyUVW[lane]);
+				historyR[lane] = sample.x;
+				historyG[lane] = sample.y;
+				historyB[lane] = sample.z;
+				historyA[lane] = sample.w;
+			}
+
+			const __m128 alpha = _mm_load_ps(historyAlpha);
+			outR = Madd(alpha, _mm_sub_ps(_mm_load_ps(historyR), outR), outR);
+			outG = Madd(alpha, _mm_sub_ps(_mm_load_ps(historyG), outG), outG);
+			outB = Madd(alpha, _mm_sub_ps(_mm_load_ps(historyB), outB), outB);
+			outA = Madd(alpha, _mm_sub_ps(_mm_load_ps(historyA), outA), outA);
+		}
+
+		StoreTexels4(&output.At(x, y, z), outR, outG, outB, outA);
+	}
+}
+
+
+void VolumetricsReference::VolumeIntegration(const FrameInputs& inputs)
+{
+	const XMUINT3& resolution = inputs.Volume.VolumeResolution;
+	const Volume& lightScattering = GetLightScatteringVolume();
+
+	// The step length through each slice only depends on the slice
+	auto SliceDepth = [&](float slice)
+		{
+			return Volumetrics::ZSliceToFroxelDepth(slice, inputs.Pass.NearPlane, inputs.Volume.MaxVolumeDistance, resolution.z,
+				inputs.Volume.DepthDistribution, inputs.Volume.HybridLinearDepth);
+		};
+
+	std::vector<float> stepLengths(resolution.z);
+	float previousSliceDepth = SliceDepth(0.0f);
+	for (UINT layer = 0; layer < resolution.z; layer++)
+	{
+		const float sliceDepth = SliceDepth(static_cast<float>(layer) + 0.5f);
+		stepLengths.at(layer) = fabsf(sliceDepth - previousSliceDepth);
+		previousSliceDepth = sliceDepth;
+	}
+
+	if (inputs.VolumeIntegrationMode == VOLUME_INTEGRATION_SCAN)
+	{
+		VolumeIntegrationScan(inputs, stepLengths);
+		return;
+	}
+
+	// Each row marches 4 columns through the volume at a time
+	m_ThreadPool->ParallelFor(resolution.y, 4, [&](UINT begin, UINT end)
+		{
+			for (UINT y = begin; y < end; y++)
+			{
+				for (UINT x = 0; x < resolution.x; x += s_Lanes)
+				{
+					__m128 accumulatedR = _mm_setzero_ps();
+					__m128 accumulatedG = _mm_setzero_ps();
+					__m128 accumulatedB = _mm_setzero_ps();
+					__m128 accumulatedTransmittance = _mm_set1_ps(1.0f);
+
+					for (UINT layer = 0; layer < resolution.z; layer++)
+					{
+						// Inactive bricks have no scattering or extinction, so the accumulated values are carried through them
+						if (IsBrickOccupied(inputs.BrickOccupancy, resolution, x, y, layer))
+						{
+							__m128 scatteringR, scatteringG, scatteringB, extinction;
+							LoadTexels4(&lightScattering.At(x, y, layer), scatteringR, scatteringG, scatteringB, extinction);
+
+							alignas(16) float opticalDepth[s_Lanes];
+							_mm_store_ps(opticalDepth, _mm_mul_ps(extinction, _mm_set1_ps(-stepLengths[layer])));
+							for (float& value : opticalDepth)
+								value = expf(value);
+							const __m128 transmittance = _mm_load_ps(opticalDepth);
+
+							const __m128 invExtinction = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(extinction, _mm_set1_ps(0.00001f)));
+							const __m128 visibleFraction = Saturate4(accumulatedTransmittance);
+
+							// (scattering - scattering * transmittance) / extinction
+							accumulatedR = Madd(_mm_mul_ps(_mm_sub_ps(scatteringR, _mm_mul_ps(scatteringR, transmittance)), invExtinction), visibleFraction, accumulatedR);
+							accumulatedG = Madd(_mm_mul_ps(_mm_sub_ps(scatteringG, _mm_mul_ps(scatteringG, transmittance)), invExtinction), visibleFraction, accumulatedG);
+							accumulatedB = Madd(_mm_mul_ps(_mm_sub_ps(scatteringB, _mm_mul_ps(scatteringB, transmittance)), invExtinction), visibleFraction, accumulatedB);
+
+							accumulatedTransmittance = _mm_mul_ps(accumulatedTransmittance, transmittance);
+						}
+
+						StoreTexels4(&m_IntegratedVolume.At(x, y, layer), accumulatedR, accumulatedG, accumulatedB, accumulatedTransmittance);
+					}
+				}
+			}
+		});
+}
+
+
+void VolumetricsReference::VolumeIntegrationScan(const FrameInputs& inputs, const std::vector<float>& stepLengths)
+{
+	const XMUINT3& resolution = inputs.Volume.VolumeResolution;
+	const Volume& lightScattering = GetLightScatteringVolume();
+
+	ASSERT(resolution.z <= VOLUME_SCAN_MAX_SLICES, "Too many slices for the parallel scan integration");
+
+	// Slices are split into a chunk for each thread of a column on the GPU
+	constexpr UINT chunkCount = VOLUME_SCAN_THREADS_PER_COLUMN;
+	const UINT chunkSlices = (resolution.z + chunkCount - 1) / chunkCount;
+
+	m_ThreadPool->ParallelFor(resolution.y, 4, [&](UINT begin, UINT end)
+		{
+			std::vector<Segment4> slices(resolution.z);
+			std::array<Segment4, chunkCount> chunks;
+
+			for (UINT y = begin; y < end; y++)
+			{
+				for (UINT x = 0; x < resolution.x; x += s_Lanes)
+				{
+					// Integrate each slice on its own
+					for (UINT layer = 0; layer < resolution.z; layer++)
+					{
+						if (!IsBrickOccupied(inputs.BrickOccupancy, resolution, x, y, layer))
+						{
+							slices[layer] = EmptySegment4();
+							continue;
+						}
+
+						__m128 scatteringR, scatteringG, scatteringB, extinction;
+						LoadTexels4(&lightScattering.At(x, y, layer), scatteringR, scatteringG, scatteringB, extinction);
+
+						alignas(16) float opticalDepth[s_Lanes];
+						_mm_store_ps(opticalDepth, _mm_mul_ps(extinction, _mm_set1_ps(-stepLengths[layer])));
+						for (float& value : opticalDepth)
+							value = expf(value);
+						const __m128 transmittance = _mm_load_ps(opticalDepth);
+
+						const __m128 invExtinction = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(extinction, _mm_set1_ps(0.00001f)));
+
+						slices[layer] = {
+							_mm_mul_ps(_mm_sub_ps(scatteringR, _mm_mul_ps(scatteringR, transmittance)), invExtinction),
+							_mm_mul_ps(_mm_sub_ps(scatteringG, _mm_mul_ps(scatteringG, transmittance)), invExtinction),
+							_mm_mul_ps(_mm_sub_ps(scatteringB, _mm_mul_ps(scatteringB, transmittance)), invExtinction),
+							transmittance
+						};
+					}
+
+					// Chunk totals
+					for (UINT chunk = 0; chunk < chunkCount; chunk++)
+					{
+						Segment4 total = EmptySegment4();
+						for (UINT layer = chunk * chunkSlices; layer < min((chunk + 1) * chunkSlices, resolution.z); layer++)
+						{
+							total = CombineSegments4(total, slices[layer]);
+						}
+						chunks[chunk] = total;
+					}
+
+					// Work-efficient exclusive scan of the chunk totals, in the order that the shader combines them
+					for (UINT stride = 1; stride < chunkCount; stride *= 2)
+					{
+						for (UINT chunk = 2 * stride - 1; chunk < chunkCount; chunk += 2 * stride)
+						{
+							chunks[chunk] = CombineSegments4(chunks[chunk - stride], chunks[chunk]);
+						}
+					}
+
+					chunks[chunkCount - 1] = EmptySegment4();
+					for (UINT stride = chunkCount / 2; stride > 0; stride /= 2)
+					{
+						for (UINT chunk = 2 * stride - 1; chunk < chunkCount; chunk += 2 * stride)
+						{
+							const Segment4 frontRun = chunks[chunk - stride];
+							chunks[chunk - stride] = chunks[chunk];
+							chunks[chunk] = CombineSegments4(chunks[chunk], frontRun);
+						}
+					}
+
+					// Walk each chunk again, from everything in front of it
+					for (UINT chunk = 0; chunk < chunkCount; chunk++)
+					{
+						Segment4 accumulated = chunks[chunk];
+						for (UINT layer = chunk * chunkSlices; layer < min((chunk + 1) * chunkSlices, resolution.z); layer++)
+						{
+							accumulated = CombineSegments4(accumulated, slices[layer]);
+							StoreTexels4(&m_IntegratedVolume.At(x, y, layer), accumulated.R, accumulated.G, accumulated.B, accumulated.T);
+						}
+					}
+				}
+			}
+		});
+}
+
+
+void VolumetricsReference::ApplyVolumetrics(const FrameInputs& inputs)
+{
+	const PassConstantBuffer& pass = inputs.Pass;
+	const XMUINT2& size = pass.RTSize;
+
+	if (m_OutputImage.Dimensions.x != size.x || m_OutputImage.Dimensions.y != size.y)
+	{
+		m_OutputImage.Resize({ size.x, size.y, 1 });
+	}
+
+	const bool hasScene = !inputs.SceneDepth.empty();
+	ASSERT(!hasScene || (inputs.SceneDepth.size() == static_cast<size_t>(size.x) * size.y && inputs.SceneColor.size() == inputs.SceneDepth.size()), "Scene buffers do not match the render target size");
+
+	m_ThreadPool->ParallelFor(size.y, 8, [&](UINT begin, UINT end)
+		{
+			for (UINT y = begin; y < end; y++)
+			{
+				for (UINT x = 0; x < size.x; x++)
+				{
+					const size_t pixel = static_cast<size_t>(y) * size.x + x;
+					const float sceneDepth = hasScene ? inputs.SceneDepth[pixel] : 1.0f;
+					const XMFLOAT4 pixelWithoutFog = hasScene ? inputs.SceneColor[pixel] : XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
+					const float u = (static_cast<float>(x) + 0.5f) * pass.InvRTSize.x;
+					const float v = (static_cast<float>(y) + 0.5f) * pass.InvRTSize.y;
+
+					// View-space position
+					XMVECTOR p_vs = XMVector4Transform(XMVectorSet(2.0f * u - 1.0f, -(2.0f * v - 1.0f), sceneDepth, 1.0f), m_Matrices.InvProj);
+					p_vs /= XMVectorGetW(p_vs);
+
+					const float volumeZ = Volumetrics::FroxelDepthToVolumeW(XMVectorGetZ(p_vs), pass.NearPlane, inputs.Volume.MaxVolumeDistance,
+						inputs.Volume.DepthDistribution, inputs.Volume.HybridLinearDepth);
+					const XMFLOAT4 scatteringAndTransmittance = m_IntegratedVolume.SampleTrilinear({ u, v, volumeZ });
+
+					m_OutputImage.At(x, y, 0) = {
+						pixelWithoutFog.x * scatteringAndTransmittance.w + scatteringAndTransmittance.x,
+						pixelWithoutFog.y * scatteringAndTransmittance.w + scatteringAndTransmittance.y,
+						pixelWithoutFog.z * scatteringAndTransmittance.w + scatteringAndTransmittance.z,
+						1.0f
+					};
+				}
+			}
+		});
+}
+
+
+std::string VolumetricsReference::FormatTimingReport() const
+{
+	const XMUINT3& volume = m_VBufferA.Dimensions;
+	const XMUINT3& image = m_OutputImage.Dimensions;
+	const double froxelCount = static_cast<double>(volume.x) * volume.y * volume.z;
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer),
+		"Volume %ux%ux%u, output %ux%u, %u threads\n"
+		"  Density estimation  %9.3f ms\n"
+		"  Light scattering    %9.3f ms\n"
+		"  Volume integration  %9.3f ms\n"
+		"  Apply volumetrics   %9.3f ms\n"
+		"  Total               %9.3f ms (%.1f ns per froxel)\n"
+		"  Active bricks       %9.1f %%\n",
+		volume.x, volume.y, volume.z, image.x, image.y, m_ThreadPool->GetThreadCount(),
+		m_Timings.DensityEstimation,
+		m_Timings.LightScattering,
+		m_Timings.VolumeIntegration,
+		m_Timings.ApplyVolumetrics,
+		m_Timings.GetTotal(), froxelCount > 0.0 ? m_Timings.GetTotal() * 1.0e6 / froxelCount : 0.0,
+		100.0 * m_ActiveBrickFraction);
+
+	return buffer;
+}
+
+
+bool VolumetricsReference::SaveVolume(const std::string& path, const Volume& volume)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for writing", path);
+		return false;
+	}
+
+	VolumeFileHeader header;
+	memcpy(header.Magic, s_VolumeFileMagic, sizeof(header.Magic));
+	header.Width = volume.Dimensions.x;
+	header.Height = volume.Dimensions.y;
+	header.Depth = volume.Dimensions.z;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(volume.Texels.data()), volume.Texels.size() * sizeof(XMFLOAT4));
+	return file.good();
+}
+
+bool VolumetricsReference::LoadVolume(const std::string& path, Volume& volume)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for reading", path);
+		return false;
+	}
+
+	VolumeFileHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || memcmp(header.Magic, s_VolumeFileMagic, sizeof(header.Magic)) != 0)
+	{
+		LOG_ERROR("{} is not a volume file", path);
+		return false;
+	}
+
+	volume.Resize({ header.Width, header.Height, header.Depth });
+	file.read(reinterpret_cast<char*>(volume.Texels.data()), volume.Texels.size() * sizeof(XMFLOAT4));
+	return file.good();
+}
+
+bool VolumetricsReference::SaveImagePFM(const std::string& path, const Volume& image)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for writing", path);
+		return false;
+	}
+
+	// A negative scale marks the data as little-endian
+	file << "PF\n" << image.Dimensions.x << " " << image.Dimensions.y << "\n-1.0\n";
+
+	// Rows are stored from the bottom of the image to the top
+	std::vector<float> row(image.Dimensions.x * 3);
+	for (UINT y = image.Dimensions.y; y-- > 0;)
+	{
+		for (UINT x = 0; x < image.Dimensions.x; x++)
+		{
+			const XMFLOAT4& texel = image.At(x, y, 0);
+			row[x * 3 + 0] = texel.x;
+			row[x * 3 + 1] = texel.y;
+			row[x * 3 + 2] = texel.z;
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+	}
+	return file.good();
+}
+
+void VolumetricsReference::LoadFogNoiseTexture(const FogNoiseBaker& baker, Volume& texture)
+{
+	const UINT resolution = baker.GetDesc().Resolution;
+	const std::vector<UINT8>& texels = baker.GetTexels();
+
+	texture.Resize({ resolution, resolution, resolution });
+	for (size_t i = 0; i < texture.Texels.size(); i++)
+	{
+		const UINT8* texel = &texels[i * FogNoiseBaker::s_ChannelCount];
+		texture.Texels[i] = XMFLOAT4(static_cast<float>(texel[0]) / 255.0f, static_cast<float>(texel[1]) / 255.0f, 0.0f, 0.0f);
+	}
+}
+
+float VolumetricsReference::MaxAbsoluteDifference(const Volume& a, const Volume& b)
+{
+	if (a.Dimensions.x != b.Dimensions.x || a.Dimensions.y != b.Dimensions.y || a.Dimensions.z != b.Dimensions.z)
+		return FLT_MAX;
+
+	float maxDifference = 0.0f;
+	for (size_t i = 0; i < a.Texels.size(); i++)
+	{
+		maxDifference = max(maxDifference, fabsf(a.Texels[i].x - b.Texels[i].x));
+		maxDifference = max(maxDifference, fabsf(a.Texels[i].y - b.Texels[i].y));
+		maxDifference = max(maxDifference, fabsf(a.Texels[i].z - b.Texels[i].z));
+		maxDifference = max(maxDifference, fabsf(a.Texels[i].w - b.Texels[i].w));
+	}
+	return maxDifference;
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+#include "HlslCompat/VolumetricsHlslCompat.h"
+
+#include <cfloat>
+#include <functional>
+#include <string>
+
+class FogNoiseBaker;
+class SparseBrickAtlas;
+class ThreadPool;
+
+using namespace DirectX;
+
+
+/**
+ *	A CPU implementation of the froxel volumetrics pipeline, following the math of
+ *	density_estimation_cs, light_scattering_cs, volume_integration_cs and apply_volumetrics_cs.
+ *
+ *	It consumes the same constant buffer structures as the shaders (with matrices transposed, as uploaded),
+ *	so that volumetric quality and cost can be regression-tested and profiled without a GPU.
+ *	Rows of froxels are split across a ThreadPool, and each row is evaluated 4 froxels at a time with SSE.
+ *
+ *	Given the brick occupancy mask of a FroxelOccupancy, the stages skip the bricks without fog as the shaders do,
+ *	so that the savings of sparse froxels can be measured for a scene.
+ *
+ *	RenderGroundTruth ray marches the same media and lights without a froxel grid, so that the error of the froxel settings can be measured.
+ *
+ *	The differences from the GPU are that volumes are stored as 32-bit rather than 16-bit floats,
+ *	that the voxels of the fog clipmap are evaluated from the global fog when sampled rather than stored,
+ *	and that the sun's shadow map is replaced by an optional visibility function.
+ */
+class VolumetricsReference
+{
+public:
+	// A grid of RGBA values, stored x first, then y, then z
+	// Images are volumes with a depth of 1
+	struct Volume
+	{
+		XMUINT3 Dimensions = { 0, 0, 0 };
+		std::vector<XMFLOAT4> Texels;
+
+		void Resize(const XMUINT3& dimensions);
+
+		inline XMFLOAT4& At(UINT x, UINT y, UINT z) { return Texels[(static_cast<size_t>(z) * Dimensions.y + y) * Dimensions.x + x]; }
+		inline const XMFLOAT4& At(UINT x, UINT y, UINT z) const { return Texels[(static_cast<size_t>(z) * Dimensions.y + y) * Dimensions.x + x]; }
+
+		// Linear filtering with clamped addressing, as with the samplers used by the shaders
+		XMFLOAT4 SampleTrilinear(const XMFLOAT3& uvw) const;
+		// Linear filtering with wrapped addressing, as with the fog noise sampler
+		XMFLOAT4 SampleTrilinearWrap(const XMFLOAT3& uvw) const;
+	};
+
+	struct FrameInputs
+	{
+		PassConstantBuffer Pass;
+		LightingConstantBuffer Lighting;
+		VolumetricsConstantBuffer Volume;
+		GlobalFogConstantBuffer GlobalFog;
+		// Optional clipmap of the global fog, as planned by a FogClipmapPlanner
+		// The global fog is evaluated directly where no cascade covers a point, and everywhere when Enabled is 0
+		FogClipmapConstantBuffer FogClipmap = {};
+		// Optional noise that modulates the global fog, with the texels of a FogNoiseBaker, see LoadFogNoiseTexture
+		// The global fog is not modulated when Enabled is 0
+		FogNoiseConstants FogNoise = {};
+		VolumetricsReference::Volume FogNoiseTexture;
+
+		std::vector<PointLightGPUData> PointLights;
+
+		// Optional per-cluster light lists, as uploaded by the LightManager
+		// When empty, every point light is evaluated for every froxel
+		std::vector<XMUINT2> ClusterLightRanges;
+		std::vector<UINT> ClusterLightIndices;
+
+		// Optional local fog volumes, with the per-tile lists of a FogVolumeBinner for the same volume
+		std::vector<FogVolumeGPUData> FogVolumes;
+		std::vector<XMUINT2> FogVolumeTileRanges;
+		std::vector<UINT> FogVolumeIndices;
+		// Optional densities of the baked fog volumes, as the texels of a FogDensityAtlas in x
+		// Baked volumes are empty without it
+		VolumetricsReference::Volume FogDensityAtlas;
+		// Optional bricks and indirection table of the sparse fog volumes, which must outlive the frame
+		// Sparse volumes are empty without it
+		const SparseBrickAtlas* SparseFogAtlas = nullptr;
+
+		// Optional brick occupancy, laid out as FroxelOccupancy::GetMask
+		// Density estimation and light scattering skip the inactive bricks, which are left empty, and volume integration steps over them
+		// When empty, every froxel is evaluated
+		std::vector<UINT> BrickOccupancy;
+
+		// VOLUME_INTEGRATION_SERIAL or VOLUME_INTEGRATION_SCAN, as picked in the VolumetricRendering GUI
+		UINT VolumeIntegrationMode = VOLUME_INTEGRATION_SERIAL;
+
+		// Optional sun visibility at a world-space position, in place of the shadow map
+		// The sun is unshadowed when this is not set
+		std::function<float(const XMFLOAT3& worldPos)> SunVisibility;
+
+		// Scene depth (NDC) and lit scene colour, each Pass.RTSize in size
+		// When empty, every pixel is treated as black sky at the far plane
+		std::vector<float> SceneDepth;
+		std::vector<XMFLOAT4> SceneColor;
+	};
+
+	// Wall-clock time spent in each stage of the last frame, in milliseconds
+	struct StageTimings
+	{
+		double DensityEstimation = 0.0;
+		double LightScattering = 0.0;
+		double VolumeIntegration = 0.0;
+		double ApplyVolumetrics = 0.0;
+
+		inline double GetTotal() const { return DensityEstimation + LightScattering + VolumeIntegration + ApplyVolumetrics; }
+	};
+
+	// Settings of RenderGroundTruth
+	struct GroundTruthDesc
+	{
+		// World-space distance between samples along each view ray
+		float StepLength = 0.02f;
+		// View rays are clipped to this world-space box, outside of which there must be no fog
+		XMFLOAT3 BoundsMin = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		XMFLOAT3 BoundsMax = { FLT_MAX, FLT_MAX, FLT_MAX };
+	};
+
+public:
+	VolumetricsReference(ThreadPool& threadPool);
+	~VolumetricsReference() = default;
+
+	DISALLOW_COPY(VolumetricsReference)
+	DEFAULT_MOVE(VolumetricsReference)
+
+	// Runs every stage of the pipeline for one frame
+	// The light scattering volume is kept for temporal reprojection in the next frame
+	void RenderFrame(const FrameInputs& inputs);
+
+	// Discards the light scattering history, as if no frame had been rendered before
+	void ResetHistory();
+
+	// Renders the image that the froxel pipeline approximates, by ray marching every pixel in small steps
+	// The media and lights are those of RenderFrame, evaluated at every step rather than once per froxel,
+	// with every fog volume and point light rather than the binned lists, and out to the scene depth rather than MaxVolumeDistance
+	// Does not touch the volumes or history of the pipeline
+	void RenderGroundTruth(const FrameInputs& inputs, const GroundTruthDesc& desc, Volume& image) const;
+
+	// Builds the pass constants in the same way as the application does, for use without a window
+	static PassConstantBuffer BuildPassConstants(
+		const XMMATRIX& view,
+		const XMMATRIX& projection,
+		const XMMATRIX& prevView,
+		const XMMATRIX& prevProjection,
+		const XMFLOAT3& eyePosition,
+		const XMUINT2& renderTargetSize,
+		float nearPlane,
+		float farPlane,
+		UINT frameIndex);
+
+	// Getters
+	inline const Volume& GetVBufferA() const { return m_VBufferA; }
+	inline const Volume& GetVBufferB() const { return m_VBufferB; }
+	inline const Volume& GetLightScatteringVolume() const { return m_LightScatteringVolumes.at(m_CurrentLightScatteringVolume); }
+	inline const Volume& GetIntegratedVolume() const { return m_IntegratedVolume; }
+	inline const Volume& GetOutputImage() const { return m_OutputImage; }
+
+	inline const StageTimings& GetTimings() const { return m_Timings; }
+	// Fraction of the bricks that were evaluated in the last frame
+	inline float GetActiveBrickFraction() const { return m_ActiveBrickFraction; }
+	std::string FormatTimingReport() const;
+
+	// Golden data
+	// Volumes are saved as a small header followed by raw 32-bit float RGBA texels
+	static bool SaveVolume(const std::string& path, const Volume& volume);
+	static bool LoadVolume(const std::string& path, Volume& volume);
+	// Saves the first slice of a volume as an RGB portable float map (.pfm)
+	static bool SaveImagePFM(const std::string& path, const Volume& image);
+
+	// Converts the texels of a FogNoiseBaker to a volume for FrameInputs::FogNoiseTexture
+	// RG - Gradient and Worley noise in [0, 1], as the shaders read the UNORM8 texture
+	static void LoadFogNoiseTexture(const FogNoiseBaker& baker, Volume& texture);
+
+	// Largest absolute difference between any two channels, or FLT_MAX if the dimensions differ
+	static float MaxAbsoluteDifference(const Volume& a, const Volume& b);
+
+private:
+	void DensityEstimation(const FrameInputs& inputs);
+	void LightScattering(const FrameInputs& inputs);
+	void VolumeIntegration(const FrameInputs& inputs);
+	// The parallel scan formulation of volume_integration_scan_cs, combining the slices in the same order as the shader
+	// The combine step is associative, so this only differs from the serial march by the rounding of the regrouped sums and products
+	// Each output passes through at most chunk size + 2 * log2(chunk count) combines, rather than one per slice in front of it
+	void VolumeIntegrationScan(const FrameInputs& inputs, const std::vector<float>& stepLengths);
+	void ApplyVolumetrics(const FrameInputs& inputs);
+
+	// Evaluates a row of froxels at the given y and z
+	void DensityEstimationRow(const FrameInputs& inputs, UINT y, UINT z);
+	void LightScatteringRow(const FrameInputs& inputs, UINT y, UINT z);
+
+private:
+	// The pass matrices for the current frame, transposed back to row-vector form
+	struct FrameMatrices
+	{
+		XMMATRIX InvView;
+		XMMATRIX InvProj;
+		XMMATRIX PrevView;
+		XMMATRIX PrevProj;
+	};
+
+	ThreadPool* m_ThreadPool;
+	FrameMatrices m_Matrices;
+
+	Volume m_VBufferA;		// RGB - Scattering, A - Extinction
+	Volume m_VBufferB;		// RGB - Emission, A - Phase (g)
+
+	// Double-buffered for temporal reprojection
+	std::array<Volume, 2> m_LightScatteringVolumes;
+	UINT m_CurrentLightScatteringVolume = 0;
+
+	Volume m_IntegratedVolume;	// RGB - Accumulated scattering, A - Transmittance
+	Volume m_OutputImage;
+
+	StageTimings m_Timings;
+	float m_ActiveBrickFraction = 1.0f;
+};
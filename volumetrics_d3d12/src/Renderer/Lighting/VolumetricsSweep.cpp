@@ -0,0 +1,529 @@
+#include "pch.h"
+#include "VolumetricsSweep.h"
+
+#include "FogVolumeBinner.h"
+#include "VolumetricsReference.h"
+#include "Framework/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <random>
+
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	inline double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	const char* GetDepthDistributionName(UINT distribution)
+	{
+		static const char* names[] = { "linear", "exponential", "hybrid" };
+		return distribution < VOLUME_DEPTH_DISTRIBUTION_COUNT ? names[distribution] : "unknown";
+	}
+
+	// The camera of the application, orbiting the centre of the fog
+	constexpr float s_FieldOfView = 0.25f * XM_PI;
+	constexpr float s_NearPlane = 0.1f;
+	constexpr float s_FarPlane = 100.0f;
+	constexpr XMFLOAT3 s_OrbitCentre = { 0.0f, 2.0f, 0.0f };
+	constexpr float s_OrbitRadius = 10.0f;
+
+	constexpr XMFLOAT4 s_GroundColor = { 0.1f, 0.1f, 0.1f, 1.0f };
+
+	// A frame of the camera's orbit, with the ground plane rendered from it
+	struct FrameView
+	{
+		XMMATRIX View;
+		PassConstantBuffer Pass;
+		std::vector<float> SceneDepth;
+		std::vector<XMFLOAT4> SceneColor;
+	};
+
+	// The fog, lights and fog volumes of the scene, which do not change between frames
+	// The fog, sun and fog volumes are the defaults of VolumetricRendering and LightManager, with a constant sky ambient in place of the IBL
+	void BuildScene(const VolumetricsSweep::Desc& desc, VolumetricsReference::FrameInputs& inputs, std::vector<FogVolume>& fogVolumes)
+	{
+		inputs.GlobalFog = {
+			.Albedo = XMFLOAT3(1.5f, 1.5f, 1.5f),
+			.Extinction = 0.25f,
+
+			.MaxHeight = 5.0f,
+			.HeightSmoothing = 3.0f,
+			.Radius = 5.0f,
+			.RadiusSmoothing = 3.0f
+		};
+
+		inputs.Lighting.DirectionalLight.Direction = { 0.0f, -0.7f, 0.7f };
+		inputs.Lighting.DirectionalLight.Intensity = 2.0f;
+		inputs.Lighting.DirectionalLight.Color = { 1.0f, 1.0f, 1.0f };
+		for (UINT i = 0; i < 3; i++)
+		{
+			inputs.Lighting.SkyIrradianceEnvironmentMap[i].w = 0.1f;
+		}
+
+		// Scattered through the fog, as LightManager::ScatterPointLights does
+		std::mt19937 random(desc.Seed);
+		auto Float = [&random](float min, float max) { return std::uniform_real_distribution<float>(min, max)(random); };
+
+		const float scatterRadius = inputs.GlobalFog.Radius + inputs.GlobalFog.RadiusSmoothing;
+		inputs.PointLights.resize(desc.PointLightCount);
+		for (PointLightGPUData& light : inputs.PointLights)
+		{
+			light.Position = { Float(-scatterRadius, scatterRadius), Float(0.0f, inputs.GlobalFog.MaxHeight), Float(-scatterRadius, scatterRadius) };
+			light.Color = { Float(0.0f, 1.0f), Float(0.0f, 1.0f), Float(0.0f, 1.0f) };
+			light.Intensity = Float(0.5f, 2.0f);
+			light.Range = Float(1.0f, 4.0f);
+		}
+
+		fogVolumes.resize(3);
+		fogVolumes[0].Shape = FOG_VOLUME_SHAPE_SPHERE;
+		fogVolumes[0].Position = { -3.0f, 1.5f, 0.0f };
+		fogVolumes[0].Extents = { 1.5f, 1.5f, 1.5f };
+		fogVolumes[0].Extinction = 0.5f;
+
+		fogVolumes[1].Shape = FOG_VOLUME_SHAPE_BOX;
+		fogVolumes[1].Position = { 3.0f, 1.0f, 2.0f };
+		fogVolumes[1].Rotation = { 0.0f, 0.5f, 0.0f };
+		fogVolumes[1].Extents = { 1.5f, 1.0f, 1.5f };
+		fogVolumes[1].Extinction = 0.8f;
+		fogVolumes[1].Anisotropy = 0.3f;
+
+		fogVolumes[2].Shape = FOG_VOLUME_SHAPE_ELLIPSOID;
+		fogVolumes[2].Position = { 0.0f, 3.0f, 4.0f };
+		fogVolumes[2].Extents = { 3.0f, 0.75f, 1.5f };
+		fogVolumes[2].Extinction = 0.3f;
+		fogVolumes[2].Emission = { 0.05f, 0.02f, 0.0f };
+
+		inputs.FogVolumes.clear();
+		for (const FogVolume& volume : fogVolumes)
+		{
+			inputs.FogVolumes.push_back(volume.GetGPUData());
+		}
+	}
+
+	// A box around the global fog and every fog volume
+	void GetFogBounds(const VolumetricsReference::FrameInputs& inputs, const std::vector<FogVolume>& fogVolumes, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)
+	{
+		const GlobalFogConstantBuffer& fog = inputs.GlobalFog;
+		const float radius = fog.Radius + fog.RadiusSmoothing;
+		boundsMin = { -radius, 0.0f, -radius };
+		boundsMax = { radius, fog.MaxHeight + fog.HeightSmoothing, radius };
+
+		for (const FogVolume& volume : fogVolumes)
+		{
+			// The distance to the furthest corner of the box, which bounds every shape and rotation
+			const XMFLOAT3 extents = volume.Shape == FOG_VOLUME_SHAPE_SPHERE ? XMFLOAT3(volume.Extents.x, volume.Extents.x, volume.Extents.x) : volume.Extents;
+			const float reach = sqrtf(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+
+			boundsMin = { min(boundsMin.x, volume.Position.x - reach), min(boundsMin.y, volume.Position.y - reach), min(boundsMin.z, volume.Position.z - reach) };
+			boundsMax = { max(boundsMax.x, volume.Position.x + reach), max(boundsMax.y, volume.Position.y + reach), max(boundsMax.z, volume.Position.z + reach) };
+		}
+	}
+
+	// The camera orbits so that it reaches the application's default view on the last frame
+	std::vector<FrameView> BuildFrameViews(const VolumetricsSweep::Desc& desc, UINT frameCount)
+	{
+		const XMUINT2& size = desc.ImageSize;
+		const XMMATRIX projection = XMMatrixPerspectiveFovLH(s_FieldOfView, static_cast<float>(size.x) / static_cast<float>(size.y), s_NearPlane, s_FarPlane);
+		const XMMATRIX invProjection = XMMatrixInverse(nullptr, projection);
+		const XMVECTOR centre = XMLoadFloat3(&s_OrbitCentre);
+
+		std::vector<FrameView> frames(frameCount);
+		for (UINT frame = 0; frame < frameCount; frame++)
+		{
+			const float angle = static_cast<float>(static_cast<int>(frame) - static_cast<int>(frameCount - 1)) * desc.CameraOrbitPerFrame;
+			const XMVECTOR eye = centre + XMVectorSet(s_OrbitRadius * sinf(angle), 0.0f, -s_OrbitRadius * cosf(angle), 0.0f);
+
+			FrameView& view = frames[frame];
+			view.View = XMMatrixLookAtLH(eye, centre, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+			XMFLOAT3 eyePosition;
+			XMStoreFloat3(&eyePosition, eye);
+			const XMMATRIX& prevView = frame > 0 ? frames[frame - 1].View : view.View;
+			view.Pass = VolumetricsReference::BuildPassConstants(view.View, projection, prevView, projection, eyePosition, size, s_NearPlane, s_FarPlane, frame);
+
+			// The ground plane at y = 0, where view depth grows linearly along the ray from the eye to the far plane
+			const XMMATRIX invView = XMMatrixInverse(nullptr, view.View);
+			view.SceneDepth.assign(static_cast<size_t>(size.x) * size.y, 1.0f);
+			view.SceneColor.assign(view.SceneDepth.size(), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+			for (UINT y = 0; y < size.y; y++)
+			{
+				for (UINT x = 0; x < size.x; x++)
+				{
+					const float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(size.x);
+					const float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(size.y);
+
+					XMVECTOR farPoint = XMVector4Transform(XMVectorSet(2.0f * u - 1.0f, -(2.0f * v - 1.0f), 1.0f, 1.0f), invProjection);
+					farPoint = XMVector4Transform(farPoint / XMVectorGetW(farPoint), invView);
+
+					const float farHeight = XMVectorGetY(farPoint);
+					if (farHeight >= 0.0f)
+						continue;
+
+					const float viewDepth = s_FarPlane * eyePosition.y / (eyePosition.y - farHeight);
+					const size_t pixel = static_cast<size_t>(y) * size.x + x;
+					view.SceneDepth[pixel] = view.Pass.ViewDepthToNDC.x - view.Pass.ViewDepthToNDC.y / viewDepth;
+					view.SceneColor[pixel] = s_GroundColor;
+				}
+			}
+		}
+
+		return frames;
+	}
+
+	// RMS and largest difference over the RGB of every pixel, and the RMS of the ground truth
+	void MeasureError(const VolumetricsReference::Volume& image, const VolumetricsReference::Volume& groundTruth, float& rmsError, float& maxError, float& rmsGroundTruth)
+	{
+		ASSERT(image.Texels.size() == groundTruth.Texels.size(), "The image does not match the ground truth");
+
+		double sumSquaredError = 0.0;
+		double sumSquaredTruth = 0.0;
+		maxError = 0.0f;
+		for (size_t i = 0; i < image.Texels.size(); i++)
+		{
+			const float a[3] = { image.Texels[i].x, image.Texels[i].y, image.Texels[i].z };
+			const float b[3] = { groundTruth.Texels[i].x, groundTruth.Texels[i].y, groundTruth.Texels[i].z };
+			for (UINT c = 0; c < 3; c++)
+			{
+				const float difference = a[c] - b[c];
+				sumSquaredError += static_cast<double>(difference) * difference;
+				sumSquaredTruth += static_cast<double>(b[c]) * b[c];
+				maxError = max(maxError, fabsf(difference));
+			}
+		}
+
+		const double count = static_cast<double>(max(image.Texels.size() * 3, size_t(1)));
+		rmsError = static_cast<float>(sqrt(sumSquaredError / count));
+		rmsGroundTruth = static_cast<float>(sqrt(sumSquaredTruth / count));
+	}
+
+	void WriteConfigurationJSON(std::ofstream& file, const VolumetricsSweep::Result& result, bool recommended)
+	{
+		const VolumetricsSweep::Configuration& config = result.Config;
+
+		char buffer[1024];
+		snprintf(buffer, sizeof(buffer),
+			"{ \"resolution\": [%u, %u, %u], \"max_volume_distance\": %g, \"depth_distribution\": \"%s\", \"history_weight\": %g, \"jitter_multiplier\": %g, "
+			"\"froxels\": %llu, \"lights\": %u, \"estimated_cost\": %llu, "
+			"\"rms_error\": %.6g, \"relative_error\": %.6g, \"max_error\": %.6g, \"frames\": %u, \"reference_ms\": %.3f, "
+			"\"pareto\": %s, \"recommended\": %s }",
+			config.Resolution.x, config.Resolution.y, config.Resolution.z, config.MaxVolumeDistance, GetDepthDistributionName(config.DepthDistribution),
+			config.HistoryWeight, config.JitterMultiplier,
+			static_cast<unsigned long long>(result.FroxelCount), result.LightCount, static_cast<unsigned long long>(result.EstimatedCost),
+			result.RMSError, result.RelativeError, result.MaxError, result.FrameCount, result.ReferenceMilliseconds,
+			result.OnParetoFront ? "true" : "false", recommended ? "true" : "false");
+		file << buffer;
+	}
+}
+
+
+VolumetricsSweep::VolumetricsSweep(ThreadPool& threadPool)
+	: m_ThreadPool(&threadPool)
+{
+}
+
+
+void VolumetricsSweep::Run(const Desc& desc)
+{
+	ASSERT(desc.ImageSize.x > 0 && desc.ImageSize.y > 0 && desc.MinFrameCount > 0, "Invalid sweep settings");
+
+	const Clock::time_point runStart = Clock::now();
+	m_Desc = desc;
+	m_Results.clear();
+	m_RecommendedIndex = s_NoConfiguration;
+
+	VolumetricsReference::FrameInputs scene;
+	std::vector<FogVolume> fogVolumes;
+	BuildScene(desc, scene, fogVolumes);
+
+	// Configurations that need fewer frames render the end of the orbit of those that need the most
+	const std::vector<Configuration> configurations = EnumerateConfigurations(desc);
+	UINT maxFrameCount = desc.MinFrameCount;
+	for (const Configuration& config : configurations)
+	{
+		maxFrameCount = max(maxFrameCount, GetFrameCount(desc, config));
+	}
+
+	const std::vector<FrameView> frames = BuildFrameViews(desc, maxFrameCount);
+	const FrameView& lastFrame = frames.back();
+
+	// Every configuration is compared with the same image
+	VolumetricsReference::GroundTruthDesc groundTruthDesc;
+	groundTruthDesc.StepLength = desc.GroundTruthStepLength;
+	GetFogBounds(scene, fogVolumes, groundTruthDesc.BoundsMin, groundTruthDesc.BoundsMax);
+
+	VolumetricsReference::FrameInputs inputs = scene;
+	inputs.Pass = lastFrame.Pass;
+	inputs.SceneDepth = lastFrame.SceneDepth;
+	inputs.SceneColor = lastFrame.SceneColor;
+
+	VolumetricsReference::Volume groundTruth;
+	Clock::time_point start = Clock::now();
+	VolumetricsReference(*m_ThreadPool).RenderGroundTruth(inputs, groundTruthDesc, groundTruth);
+	m_GroundTruthMilliseconds = MillisecondsSince(start);
+
+	LOG_INFO("Volumetrics sweep: Rendered the ground truth in {:.1f} ms", m_GroundTruthMilliseconds);
+
+	const UINT lightCount = desc.PointLightCount + 1;
+	const XMMATRIX projection = XMMatrixTranspose(lastFrame.Pass.Proj);
+
+	for (const Configuration& config : configurations)
+	{
+		const XMUINT3& resolution = config.Resolution;
+		ASSERT(resolution.x % VOLUME_BRICK_SIZE == 0 && resolution.y % VOLUME_BRICK_SIZE == 0 && resolution.z % VOLUME_BRICK_SIZE == 0,
+			"Every dimension of a swept resolution must be a multiple of the brick size");
+
+		inputs.Volume = {};
+		inputs.Volume.VolumeResolution = resolution;
+		inputs.Volume.MaxVolumeDistance = config.MaxVolumeDistance;
+		inputs.Volume.UseTemporalReprojection = config.HistoryWeight > 0.0f;
+		inputs.Volume.LightScatteringJitterMultiplier = config.JitterMultiplier;
+		inputs.Volume.HistoryWeight = config.HistoryWeight;
+		inputs.Volume.DepthDistribution = config.DepthDistribution;
+		inputs.Volume.HybridLinearDepth = desc.HybridLinearDepth;
+		inputs.Volume.HistorySliceCount = resolution.z;
+
+		// The fog volumes are binned into the froxel grid of the configuration, as the renderer bins them
+		std::vector<float> sliceDepths(resolution.z + 1);
+		for (UINT i = 0; i <= resolution.z; i++)
+		{
+			sliceDepths[i] = Volumetrics::ZSliceToFroxelDepth(static_cast<float>(i), s_NearPlane, config.MaxVolumeDistance, resolution.z,
+				config.DepthDistribution, desc.HybridLinearDepth);
+		}
+
+		FogVolumeBinner binner;
+		binner.SetFroxelGrid(resolution, sliceDepths.data(), projection);
+
+		const UINT frameCount = GetFrameCount(desc, config);
+
+		VolumetricsReference reference(*m_ThreadPool);
+		for (UINT i = maxFrameCount - frameCount; i < maxFrameCount; i++)
+		{
+			const FrameView& frame = frames[i];
+			binner.SetVolumes(fogVolumes.data(), static_cast<UINT>(fogVolumes.size()), frame.View);
+			binner.BinVolumes(*m_ThreadPool);
+
+			inputs.Pass = frame.Pass;
+			inputs.SceneDepth = frame.SceneDepth;
+			inputs.SceneColor = frame.SceneColor;
+			inputs.FogVolumeTileRanges = binner.GetTileVolumeRanges();
+			inputs.FogVolumeIndices = binner.GetVolumeIndices();
+
+			reference.RenderFrame(inputs);
+		}
+
+		Result& result = m_Results.emplace_back();
+		result.Config = config;
+		result.FroxelCount = static_cast<UINT64>(resolution.x) * resolution.y * resolution.z;
+		result.LightCount = lightCount;
+		result.EstimatedCost = result.FroxelCount * lightCount;
+		result.FrameCount = frameCount;
+		result.ReferenceMilliseconds = reference.GetTimings().GetTotal();
+
+		float rmsGroundTruth;
+		MeasureError(reference.GetOutputImage(), groundTruth, result.RMSError, result.MaxError, rmsGroundTruth);
+		result.RelativeError = rmsGroundTruth > 0.0f ? result.RMSError / rmsGroundTruth : result.RMSError;
+
+		LOG_INFO("Volumetrics sweep: {}/{} {}x{}x{}, {} m, {}, history {}, jitter {} - relative error {:.4f}",
+			m_Results.size(), configurations.size(), resolution.x, resolution.y, resolution.z, config.MaxVolumeDistance,
+			GetDepthDistributionName(config.DepthDistribution), config.HistoryWeight, config.JitterMultiplier, result.RelativeError);
+	}
+
+	FindParetoFront(m_Results);
+	m_RecommendedIndex = FindCheapestWithinThreshold(m_Results, desc.ErrorThreshold);
+
+	m_TotalMilliseconds = MillisecondsSince(runStart);
+}
+
+
+std::vector<VolumetricsSweep::Configuration> VolumetricsSweep::EnumerateConfigurations(const Desc& desc)
+{
+	std::vector<Configuration> configurations;
+	for (const XMUINT3& resolution : desc.Resolutions)
+	{
+		for (float maxVolumeDistance : desc.MaxVolumeDistances)
+		{
+			for (UINT depthDistribution : desc.DepthDistributions)
+			{
+				for (float historyWeight : desc.HistoryWeights)
+				{
+					// Jitter is only applied with temporal reprojection
+					if (historyWeight <= 0.0f)
+					{
+						configurations.push_back({ resolution, maxVolumeDistance, depthDistribution, 0.0f, 0.0f });
+						continue;
+					}
+
+					for (float jitterMultiplier : desc.JitterMultipliers)
+					{
+						configurations.push_back({ resolution, maxVolumeDistance, depthDistribution, historyWeight, jitterMultiplier });
+					}
+				}
+			}
+		}
+	}
+	return configurations;
+}
+
+UINT VolumetricsSweep::GetFrameCount(const Desc& desc, const Configuration& config)
+{
+	if (config.HistoryWeight <= 0.0f || config.HistoryWeight >= 1.0f)
+		return desc.MinFrameCount;
+
+	// The first frame's history keeps a weight of HistoryWeight^n after n more frames
+	const float settleFrames = ceilf(logf(desc.HistorySettleThreshold) / logf(config.HistoryWeight));
+	return max(desc.MinFrameCount, static_cast<UINT>(settleFrames) + 1);
+}
+
+void VolumetricsSweep::FindParetoFront(std::vector<Result>& results)
+{
+	std::vector<UINT> order(results.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(order.begin(), order.end(), [&results](UINT a, UINT b)
+		{
+			if (results[a].EstimatedCost != results[b].EstimatedCost)
+				return results[a].EstimatedCost < results[b].EstimatedCost;
+			return results[a].RelativeError < results[b].RelativeError;
+		});
+
+	// In order of cost, a result is on the front when it is more accurate than everything cheaper,
+	// or as accurate as the result of the same cost that is
+	float frontError = FLT_MAX;
+	UINT64 frontCost = 0;
+	for (UINT index : order)
+	{
+		Result& result = results[index];
+		result.OnParetoFront = result.RelativeError < frontError || (result.RelativeError == frontError && result.EstimatedCost == frontCost);
+		if (result.RelativeError < frontError)
+		{
+			frontError = result.RelativeError;
+			frontCost = result.EstimatedCost;
+		}
+	}
+}
+
+UINT VolumetricsSweep::FindCheapestWithinThreshold(const std::vector<Result>& results, float errorThreshold)
+{
+	UINT cheapest = s_NoConfiguration;
+	for (UINT i = 0; i < static_cast<UINT>(results.size()); i++)
+	{
+		const Result& result = results[i];
+		if (result.RelativeError > errorThreshold)
+			continue;
+
+		if (cheapest == s_NoConfiguration
+			|| result.EstimatedCost < results[cheapest].EstimatedCost
+			|| (result.EstimatedCost == results[cheapest].EstimatedCost && result.RelativeError < results[cheapest].RelativeError))
+		{
+			cheapest = i;
+		}
+	}
+	return cheapest;
+}
+
+
+bool VolumetricsSweep::SaveCSV(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for writing", path);
+		return false;
+	}
+
+	file << "resolution_x,resolution_y,resolution_z,max_volume_distance,depth_distribution,history_weight,jitter_multiplier,"
+		"froxels,lights,estimated_cost,rms_error,relative_error,max_error,frames,reference_ms,pareto,recommended\n";
+
+	for (UINT i = 0; i < static_cast<UINT>(m_Results.size()); i++)
+	{
+		const Result& result = m_Results[i];
+		const Configuration& config = result.Config;
+
+		char line[512];
+		snprintf(line, sizeof(line), "%u,%u,%u,%g,%s,%g,%g,%llu,%u,%llu,%.6g,%.6g,%.6g,%u,%.3f,%d,%d\n",
+			config.Resolution.x, config.Resolution.y, config.Resolution.z, config.MaxVolumeDistance, GetDepthDistributionName(config.DepthDistribution),
+			config.HistoryWeight, config.JitterMultiplier,
+			static_cast<unsigned long long>(result.FroxelCount), result.LightCount, static_cast<unsigned long long>(result.EstimatedCost),
+			result.RMSError, result.RelativeError, result.MaxError, result.FrameCount, result.ReferenceMilliseconds,
+			result.OnParetoFront ? 1 : 0, i == m_RecommendedIndex ? 1 : 0);
+		file << line;
+	}
+
+	return file.good();
+}
+
+bool VolumetricsSweep::SaveJSON(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for writing", path);
+		return false;
+	}
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer),
+		"{\n"
+		"  \"version\": %u,\n"
+		"  \"settings\": { \"image_size\": [%u, %u], \"min_frame_count\": %u, \"history_settle_threshold\": %g, \"camera_orbit_per_frame\": %g, \"point_lights\": %u, \"seed\": %u, "
+		"\"ground_truth_step_length\": %g, \"hybrid_linear_depth\": %g, \"error_threshold\": %g },\n"
+		"  \"ground_truth_ms\": %.3f,\n"
+		"  \"total_ms\": %.3f,\n",
+		s_Version,
+		m_Desc.ImageSize.x, m_Desc.ImageSize.y, m_Desc.MinFrameCount, m_Desc.HistorySettleThreshold, m_Desc.CameraOrbitPerFrame, m_Desc.PointLightCount, m_Desc.Seed,
+		m_Desc.GroundTruthStepLength, m_Desc.HybridLinearDepth, m_Desc.ErrorThreshold,
+		m_GroundTruthMilliseconds,
+		m_TotalMilliseconds);
+	file << buffer;
+
+	file << "  \"recommended\": ";
+	if (m_RecommendedIndex != s_NoConfiguration)
+		WriteConfigurationJSON(file, m_Results[m_RecommendedIndex], true);
+	else
+		file << "null";
+	file << ",\n";
+
+	file << "  \"results\": [\n";
+	for (UINT i = 0; i < static_cast<UINT>(m_Results.size()); i++)
+	{
+		file << "    ";
+		WriteConfigurationJSON(file, m_Results[i], i == m_RecommendedIndex);
+		file << (i + 1 < m_Results.size() ? ",\n" : "\n");
+	}
+	file << "  ]\n}\n";
+
+	return file.good();
+}
+
+std::string VolumetricsSweep::FormatSummary() const
+{
+	const UINT frontSize = static_cast<UINT>(std::count_if(m_Results.begin(), m_Results.end(), [](const Result& result) { return result.OnParetoFront; }));
+
+	char buffer[512];
+	int length = snprintf(buffer, sizeof(buffer),
+		"Swept %u configurations in %.1f s, with %u on the Pareto front (ground truth %.1f ms)\n",
+		static_cast<UINT>(m_Results.size()), m_TotalMilliseconds / 1000.0, frontSize, m_GroundTruthMilliseconds);
+
+	if (m_RecommendedIndex == s_NoConfiguration)
+	{
+		snprintf(buffer + length, sizeof(buffer) - length, "  No configuration is within the error threshold of %g\n", m_Desc.ErrorThreshold);
+		return buffer;
+	}
+
+	const Result& result = m_Results[m_RecommendedIndex];
+	const Configuration& config = result.Config;
+	snprintf(buffer + length, sizeof(buffer) - length,
+		"  Recommended %ux%ux%u, max distance %g, %s slices, history weight %g, jitter %g\n"
+		"  Relative error %.4f (threshold %g), estimated cost %.2f M froxel-lights\n",
+		config.Resolution.x, config.Resolution.y, config.Resolution.z, config.MaxVolumeDistance, GetDepthDistributionName(config.DepthDistribution),
+		config.HistoryWeight, config.JitterMultiplier,
+		result.RelativeError, m_Desc.ErrorThreshold, static_cast<double>(result.EstimatedCost) / 1.0e6);
+	return buffer;
+}
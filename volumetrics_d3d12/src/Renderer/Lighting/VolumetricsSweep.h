@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Core.h"
+#include "HlslCompat/StructureHlslCompat.h"
+#include "HlslCompat/VolumetricsHlslCompat.h"
+
+#include <string>
+
+class ThreadPool;
+
+using namespace DirectX;
+
+
+/**
+ *	Measures the image error of froxel settings against their estimated GPU cost, to pick the volume resolution,
+ *	slice distribution and temporal parameters from data rather than by eye.
+ *
+ *	A fixed scene with the renderer's default fog, sun and ambient lighting, scattered point lights, a few local fog volumes
+ *	and a ground plane is rendered by VolumetricsReference once for every combination of the swept settings.
+ *	The camera orbits the fog a little each frame, so that temporal reprojection is judged on a moving view once its history has settled,
+ *	and the last frame of each configuration is compared with a ray marched ground truth of the same view.
+ *
+ *	The error of a configuration is the RMS difference from the ground truth over the RGB of every pixel, relative to the RMS of the ground truth.
+ *	Its cost is estimated as its froxel count times the number of lights that each froxel evaluates, with the sun counted as a light.
+ *	The configurations that no other is both cheaper and more accurate than form the Pareto front,
+ *	and the cheapest of those within the error threshold is the recommended one.
+ *
+ *	Every stage of the pipeline and the ground truth are split across a ThreadPool.
+ *	The sweep has no knowledge of D3D; results are written as CSV and JSON, so that they can be tracked over time.
+ */
+class VolumetricsSweep
+{
+public:
+	// Bumped when the scene, error or cost change, so that results from different versions are not compared
+	inline static constexpr UINT s_Version = 1;
+
+	inline static constexpr UINT s_NoConfiguration = 0xFFFFFFFF;
+
+	struct Desc
+	{
+		// Render target that the errors are measured on
+		XMUINT2 ImageSize = { 320, 180 };
+		// The fewest frames rendered for each configuration, the last of which is compared with the ground truth
+		UINT MinFrameCount = 8;
+		// With temporal reprojection, frames are rendered until the weight left on the empty history of the first frame is below this
+		float HistorySettleThreshold = 0.01f;
+		// Angle that the camera orbits the fog by each frame, in radians
+		float CameraOrbitPerFrame = 0.01f;
+
+		UINT PointLightCount = 16;
+		UINT Seed = 0;
+
+		// World-space step of the ground truth's ray march
+		float GroundTruthStepLength = 0.02f;
+
+		// Largest error, relative to the RMS of the ground truth, of a configuration that may be recommended
+		float ErrorThreshold = 0.05f;
+
+		// Swept settings, every combination of which is rendered
+		// Every dimension of a resolution must be a multiple of VOLUME_BRICK_SIZE
+		std::vector<XMUINT3> Resolutions = { { 64, 40, 32 }, { 128, 72, 64 }, { 160, 88, 64 }, { 256, 144, 64 }, { 320, 176, 96 } };
+		std::vector<float> MaxVolumeDistances = { 25.0f, 50.0f, 100.0f };
+		std::vector<UINT> DepthDistributions = { VOLUME_DEPTH_DISTRIBUTION_LINEAR, VOLUME_DEPTH_DISTRIBUTION_EXPONENTIAL, VOLUME_DEPTH_DISTRIBUTION_HYBRID };
+		float HybridLinearDepth = 10.0f;
+		// A weight of 0 turns temporal reprojection off, and so is only rendered without jitter
+		std::vector<float> HistoryWeights = { 0.0f, 0.8f, 0.9f, 0.95f };
+		std::vector<float> JitterMultipliers = { 0.5f, 1.0f };
+	};
+
+	struct Configuration
+	{
+		XMUINT3 Resolution = { 0, 0, 0 };
+		float MaxVolumeDistance = 0.0f;
+		UINT DepthDistribution = VOLUME_DEPTH_DISTRIBUTION_LINEAR;
+		float HistoryWeight = 0.0f;
+		float JitterMultiplier = 0.0f;
+	};
+
+	struct Result
+	{
+		Configuration Config;
+
+		UINT64 FroxelCount = 0;
+		UINT LightCount = 0;
+		// FroxelCount * LightCount
+		UINT64 EstimatedCost = 0;
+
+		float RMSError = 0.0f;
+		float RelativeError = 0.0f;
+		float MaxError = 0.0f;
+
+		// Frames rendered, and the wall-clock time of the reference pipeline for the last of them
+		UINT FrameCount = 0;
+		double ReferenceMilliseconds = 0.0;
+
+		bool OnParetoFront = false;
+	};
+
+public:
+	VolumetricsSweep(ThreadPool& threadPool);
+	~VolumetricsSweep() = default;
+
+	DISALLOW_COPY(VolumetricsSweep)
+	DEFAULT_MOVE(VolumetricsSweep)
+
+	// Renders the ground truth, then every configuration, and finds the Pareto front and the recommended configuration
+	void Run(const Desc& desc);
+
+	bool SaveCSV(const std::string& path) const;
+	bool SaveJSON(const std::string& path) const;
+	// The recommended configuration and the size of the sweep, for logging
+	std::string FormatSummary() const;
+
+	// Every combination of the swept settings, in the order that they are rendered
+	static std::vector<Configuration> EnumerateConfigurations(const Desc& desc);
+	// Frames rendered for a configuration, enough for its history to settle
+	static UINT GetFrameCount(const Desc& desc, const Configuration& config);
+	// Flags the results that no other result is both cheaper than and at least as accurate as, or as cheap as and more accurate than
+	static void FindParetoFront(std::vector<Result>& results);
+	// The cheapest result within the error threshold, with ties going to the more accurate, or s_NoConfiguration if none are
+	static UINT FindCheapestWithinThreshold(const std::vector<Result>& results, float errorThreshold);
+
+	// Getters
+	inline const Desc& GetDesc() const { return m_Desc; }
+	inline const std::vector<Result>& GetResults() const { return m_Results; }
+	inline UINT GetRecommendedIndex() const { return m_RecommendedIndex; }
+	inline double GetGroundTruthMilliseconds() const { return m_GroundTruthMilliseconds; }
+	inline double GetTotalMilliseconds() const { return m_TotalMilliseconds; }
+
+private:
+	ThreadPool* m_ThreadPool;
+
+	Desc m_Desc;
+	std::vector<Result> m_Results;
+	UINT m_RecommendedIndex = s_NoConfiguration;
+
+	double m_GroundTruthMilliseconds = 0.0;
+	double m_TotalMilliseconds = 0.0;
+};
@@ -0,0 +1,50 @@
+#include "pch.h"
+#include "AtomicLinearAllocator.h"
+
+
+AtomicLinearAllocator::AtomicLinearAllocator(UINT64 capacity)
+{
+	Reset(capacity);
+}
+
+void AtomicLinearAllocator::Reset(UINT64 capacity)
+{
+	m_Capacity = capacity;
+	m_HighWaterMark = 0;
+	m_Offset.store(0, std::memory_order_relaxed);
+}
+
+void AtomicLinearAllocator::Reset()
+{
+	m_HighWaterMark = max(m_HighWaterMark, GetUsed());
+	m_Offset.store(0, std::memory_order_relaxed);
+}
+
+
+UINT64 AtomicLinearAllocator::Allocate(UINT64 size, UINT64 alignment)
+{
+	ASSERT(size > 0, "Invalid allocation size");
+	ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0, "Alignment must be a power of two");
+
+	if (alignment == 1)
+	{
+		// Unaligned allocations can always claim their range with a single atomic add
+		const UINT64 offset = m_Offset.fetch_add(size, std::memory_order_relaxed);
+		if (offset + size > m_Capacity)
+			return InvalidOffset;
+		return offset;
+	}
+
+	// Aligned allocations need to know the current offset to compute the padding,
+	// so claim the range with compare-exchange and retry if another thread got there first
+	UINT64 current = m_Offset.load(std::memory_order_relaxed);
+	UINT64 offset;
+	do
+	{
+		offset = Align(current, alignment);
+		if (offset + size > m_Capacity)
+			return InvalidOffset;
+	} while (!m_Offset.compare_exchange_weak(current, offset + size, std::memory_order_relaxed));
+
+	return offset;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Core.h"
+
+#include <atomic>
+
+
+/**
+ *	An AtomicLinearAllocator hands out sub-ranges of [0, capacity) by bumping a single offset.
+ *
+ *	Allocation is lock-free, so any number of threads can allocate concurrently.
+ *	Individual allocations cannot be freed; instead the whole range is recycled with Reset()
+ *	once nothing is using it any more (typically when the fence of the frame that used it has completed).
+ *
+ *	It has no knowledge of what the offsets refer to, so it does not depend on any D3D objects.
+ */
+class AtomicLinearAllocator
+{
+public:
+	inline static constexpr UINT64 InvalidOffset = static_cast<UINT64>(-1);
+
+public:
+	AtomicLinearAllocator() = default;
+	AtomicLinearAllocator(UINT64 capacity);
+	~AtomicLinearAllocator() = default;
+
+	// The offset is shared between threads so cannot be copied or moved
+	DISALLOW_COPY(AtomicLinearAllocator)
+	DISALLOW_MOVE(AtomicLinearAllocator)
+
+	// Not thread-safe: no other thread may be allocating while the allocator is reset
+	void Reset(UINT64 capacity);
+	void Reset();
+
+	// Returns the offset of the allocation, or InvalidOffset if there is not enough space remaining
+	// Alignment must be a power of two
+	UINT64 Allocate(UINT64 size, UINT64 alignment = 1);
+
+	// Getters
+	inline UINT64 GetCapacity() const { return m_Capacity; }
+	// A failed allocation may push the offset past the end, so the result is clamped to the capacity
+	inline UINT64 GetUsed() const { return min(m_Offset.load(std::memory_order_relaxed), m_Capacity); }
+	inline UINT64 GetHighWaterMark() const { return m_HighWaterMark; }
+
+private:
+	UINT64 m_Capacity = 0;
+	std::atomic<UINT64> m_Offset = 0;
+
+	// The most that has been used between any two resets
+	UINT64 m_HighWaterMark = 0;
+};
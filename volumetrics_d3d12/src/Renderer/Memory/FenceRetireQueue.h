@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Core.h"
+
+
+/**
+ *	A FenceRetireQueue holds items that must not be recycled until the GPU has passed a given fence value.
+ *
+ *	Items are ordered by their fence value, so retiring the k items whose fence has completed
+ *	costs O(k log n) regardless of how many items are still pending, and the number of frames in flight
+ *	does not need to be known in advance.
+ *
+ *	The queue only compares fence values, so it can be driven by a simulated fence without a device.
+ */
+template <typename T>
+class FenceRetireQueue
+{
+	struct Entry
+	{
+		UINT64 FenceValue;
+		T Item;
+
+		// Inverted so that std::priority_queue yields the smallest fence value first
+		bool operator<(const Entry& other) const { return FenceValue > other.FenceValue; }
+	};
+
+public:
+	FenceRetireQueue() = default;
+	~FenceRetireQueue() = default;
+
+	DEFAULT_COPY(FenceRetireQueue)
+	DEFAULT_MOVE(FenceRetireQueue)
+
+	// The item can be retired once the fence has reached fenceValue
+	void Push(UINT64 fenceValue, const T& item)
+	{
+		m_Pending.push({ fenceValue, item });
+	}
+
+	// Calls onRetire for every item whose fence value is <= completedFenceValue
+	// Returns the number of items retired
+	template <typename Func>
+	UINT Retire(UINT64 completedFenceValue, Func&& onRetire)
+	{
+		UINT retired = 0;
+		while (!m_Pending.empty() && m_Pending.top().FenceValue <= completedFenceValue)
+		{
+			onRetire(m_Pending.top().Item);
+			m_Pending.pop();
+			retired++;
+		}
+		return retired;
+	}
+
+	// Retires every pending item. Only safe to use when the GPU is idle
+	template <typename Func>
+	UINT RetireAll(Func&& onRetire)
+	{
+		return Retire(static_cast<UINT64>(-1), std::forward<Func>(onRetire));
+	}
+
+	inline bool IsEmpty() const { return m_Pending.empty(); }
+	inline size_t GetPendingCount() const { return m_Pending.size(); }
+	// The fence value that must complete before the next item can be retired
+	inline UINT64 GetNextFenceValue() const { return m_Pending.empty() ? 0 : m_Pending.top().FenceValue; }
+
+private:
+	std::priority_queue<Entry> m_Pending;
+};
+
@@ -0,0 +1,59 @@
+#include "pch.h"
+#include "LinearUploadAllocator.h"
+
+
+LinearUploadAllocator::LinearUploadAllocator(UINT8* cpuBase, D3D12_GPU_VIRTUAL_ADDRESS gpuBase, UINT64 bytesPerFrame, UINT frameCount)
+	: m_CPUBase(cpuBase)
+	, m_GPUBase(gpuBase)
+	, m_BytesPerFrame(bytesPerFrame)
+	, m_FrameAllocators(frameCount)
+{
+	ASSERT(m_CPUBase, "Invalid upload memory");
+	ASSERT(m_BytesPerFrame > 0 && frameCount > 0, "Invalid allocator size");
+	ASSERT(m_BytesPerFrame % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT == 0, "Frame segments must preserve constant buffer alignment");
+
+	for (auto& allocator : m_FrameAllocators)
+	{
+		allocator.Reset(m_BytesPerFrame);
+	}
+}
+
+
+UploadAllocation LinearUploadAllocator::Allocate(UINT64 size, UINT64 alignment)
+{
+	ASSERT(size > 0, "Invalid allocation size");
+
+	const UINT64 offset = m_FrameAllocators.at(m_CurrentFrame).Allocate(size, alignment);
+	if (offset == AtomicLinearAllocator::InvalidOffset)
+	{
+		LOG_ERROR("Upload allocation failed: frame segment exhausted. Segment size: {0} Size to alloc: {1}", m_BytesPerFrame, size);
+		return {};
+	}
+
+	// Offset of the allocation within the whole region
+	const UINT64 regionOffset = m_CurrentFrame * m_BytesPerFrame + offset;
+	return UploadAllocation{
+		m_CPUBase + regionOffset,
+		m_GPUBase + regionOffset,
+		size
+	};
+}
+
+void LinearUploadAllocator::BeginFrame(UINT frameIndex)
+{
+	ASSERT(frameIndex < m_FrameAllocators.size(), "Invalid frame index");
+
+	m_CurrentFrame = frameIndex;
+	m_FrameAllocators.at(m_CurrentFrame).Reset();
+}
+
+
+UINT64 LinearUploadAllocator::GetHighWaterMark() const
+{
+	UINT64 highWaterMark = 0;
+	for (const auto& allocator : m_FrameAllocators)
+	{
+		highWaterMark = max(highWaterMark, max(allocator.GetHighWaterMark(), allocator.GetUsed()));
+	}
+	return highWaterMark;
+}
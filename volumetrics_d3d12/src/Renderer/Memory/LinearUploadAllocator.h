@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Core.h"
+#include "AtomicLinearAllocator.h"
+
+
+// A region of upload memory that is only valid for the frame it was allocated in
+struct UploadAllocation
+{
+	UINT8* CPUAddress = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS GPUAddress = 0;
+	UINT64 Size = 0;
+
+	inline bool IsValid() const { return CPUAddress != nullptr; }
+};
+
+
+/**
+ *	A LinearUploadAllocator sub-allocates per-frame data (constant buffers, small structured buffers)
+ *	from one large persistently mapped region, instead of each buffer owning a committed resource per frame.
+ *
+ *	The region is split into one segment per frame in flight. Allocations bump-allocate from the
+ *	current frame's segment without locks, and a segment is recycled all at once when the fence of
+ *	the frame that last used it has completed.
+ *
+ *	The allocator only deals in addresses, so it can be backed by plain host memory for testing.
+ */
+class LinearUploadAllocator
+{
+public:
+	// cpuBase and gpuBase are the start of a mapped region of bytesPerFrame * frameCount bytes
+	LinearUploadAllocator(UINT8* cpuBase, D3D12_GPU_VIRTUAL_ADDRESS gpuBase, UINT64 bytesPerFrame, UINT frameCount);
+	~LinearUploadAllocator() = default;
+
+	DISALLOW_COPY(LinearUploadAllocator)
+	DISALLOW_MOVE(LinearUploadAllocator)
+
+	// Thread-safe
+	// Returns an invalid allocation if the current frame's segment is exhausted
+	UploadAllocation Allocate(UINT64 size, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+	// Allocate and fill a constant buffer
+	template<typename T>
+	UploadAllocation AllocateConstants(const T& data)
+	{
+		const UploadAllocation allocation = Allocate(sizeof(T));
+		if (allocation.IsValid())
+			memcpy(allocation.CPUAddress, &data, sizeof(T));
+		return allocation;
+	}
+
+	// Allocate and fill a tightly packed array, such as the contents of a structured buffer
+	template<typename T>
+	UploadAllocation AllocateElements(const T* data, UINT count, UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT)
+	{
+		const UploadAllocation allocation = Allocate(sizeof(T) * count, alignment);
+		if (allocation.IsValid())
+			memcpy(allocation.CPUAddress, data, sizeof(T) * count);
+		return allocation;
+	}
+
+	// Recycles the segment for this frame and makes it current
+	// The GPU must have finished all work from the last time this frame index was used
+	void BeginFrame(UINT frameIndex);
+
+	// Getters
+	inline UINT64 GetBytesPerFrame() const { return m_BytesPerFrame; }
+	inline UINT64 GetCurrentFrameUsage() const { return m_FrameAllocators.at(m_CurrentFrame).GetUsed(); }
+	// The most bytes used by any single frame so far
+	UINT64 GetHighWaterMark() const;
+
+private:
+	UINT8* m_CPUBase = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS m_GPUBase = 0;
+
+	UINT64 m_BytesPerFrame = 0;
+	UINT m_CurrentFrame = 0;
+
+	std::vector<AtomicLinearAllocator> m_FrameAllocators;
+};
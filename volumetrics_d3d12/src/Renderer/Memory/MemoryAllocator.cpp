@@ -119,8 +119,7 @@ DescriptorHeap::DescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE type, UINT capacity, b
 	m_DescriptorIncrementSize = g_D3DGraphicsContext->GetDevice()->GetDescriptorHandleIncrementSize(m_Type);
 
 	// Currently, the entire heap is free
-	m_FreeBlocks.insert({ 0, m_Capacity });
-	m_DeferredFrees.resize(g_D3DGraphicsContext->GetBackBufferCount());
+	m_Allocator.Reset(m_Capacity);
 }
 
 DescriptorHeap::~DescriptorHeap()
@@ -143,29 +142,15 @@ DescriptorAllocation DescriptorHeap::Allocate(UINT countToAlloc)
 		return {};
 	}
 
-	// Find the next free block
-	auto freeBlockIt = m_FreeBlocks.begin();
-	for (; freeBlockIt != m_FreeBlocks.end() && freeBlockIt->second < countToAlloc; ++freeBlockIt) {}
-	if (freeBlockIt == m_FreeBlocks.end())
+	const UINT allocIndex = m_Allocator.Allocate(countToAlloc);
+	m_TraceRecorder.OnAllocate(allocIndex, countToAlloc);
+	if (allocIndex == TLSFAllocator::InvalidIndex)
 	{
-		// No space in the heap
-		LOG_ERROR("Descriptor allocation failed: no capacity in heap. Heap size: {0} Count to alloc: {1}", m_Capacity, countToAlloc);
+		// No contiguous block large enough in the heap
+		LOG_ERROR("Descriptor allocation failed: heap too fragmented. Heap size: {0} Count to alloc: {1} Largest free block: {2}", m_Capacity, countToAlloc, m_Allocator.GetLargestFreeBlock());
 		return {};
 	}
 
-
-	const UINT allocIndex = freeBlockIt->first;
-
-	// Update the free blocks to reflect the changes
-	UINT newFreeIndex = allocIndex + countToAlloc;
-	UINT newFreeSize = freeBlockIt->second - countToAlloc;
-	m_FreeBlocks.erase(freeBlockIt);
-	// If there is still empty space insert it into the free blocks
-	if (newFreeSize > 0)
-	{
-		m_FreeBlocks.insert(std::make_pair(newFreeIndex, newFreeSize));
-	}
-
 	m_Count += countToAlloc;
 
 	return DescriptorAllocation{ this, allocIndex, countToAlloc, m_CPUOnly };
@@ -179,39 +164,26 @@ void DescriptorHeap::Free(DescriptorAllocation& allocation)
 	// Make sure this heap contains this allocation
 	ASSERT(allocation.GetHeap() == GetHeap(), "Trying to free an allocation from the wrong heap");
 
-	m_DeferredFrees[g_D3DGraphicsContext->GetCurrentBackBuffer()].push_back(std::make_pair(allocation.GetIndex(), allocation.GetCount()));
+	// Work that uses this allocation may still be recorded in the current command list,
+	// so it is not safe to reuse until the next signal of the direct queue has been reached
+	const UINT64 fenceValue = g_D3DGraphicsContext->GetDirectCommandQueue()->GetNextFenceValue();
+	m_DeferredFrees.Push(fenceValue, std::make_pair(allocation.GetIndex(), allocation.GetCount()));
 	allocation.Reset();
 }
 
-void DescriptorHeap::ProcessDeferredFree(UINT frameIndex)
+void DescriptorHeap::ProcessDeferredFree(UINT64 completedFenceValue)
 {
-	// TODO: add validation
-
-	if (m_DeferredFrees[frameIndex].empty())
-		// No deferred frees to be made
-		return;
-
-	for (const auto& freedRange : m_DeferredFrees[frameIndex])
-	{
-		// Return freed allocation to the heap
-		m_FreeBlocks.insert(freedRange);
-		m_Count -= freedRange.second;
-	}
-	m_DeferredFrees[frameIndex].clear();
-
-	// Combine adjacent freed blocks
-	for (auto it = m_FreeBlocks.begin(); it != m_FreeBlocks.end();)
-	{
-		auto toMerge = m_FreeBlocks.find(it->first + it->second);
-		if (toMerge != m_FreeBlocks.end())
-		{
-			// Contiguous block exists, merge into a single block
-			it->second += toMerge->second;
-			it = m_FreeBlocks.erase(toMerge);
-		}
-		else
+	m_DeferredFrees.Retire(completedFenceValue, [this](const std::pair<UINT, UINT>& freedRange)
 		{
-			++it;
-		}
-	}
+			// Return freed allocation to the heap
+			// Adjacent free blocks are merged as the range is inserted
+			m_Allocator.Free(freedRange.first, freedRange.second);
+			m_TraceRecorder.OnFree(freedRange.first, freedRange.second);
+			m_Count -= freedRange.second;
+		});
+}
+
+void DescriptorHeap::ProcessAllDeferredFree()
+{
+	ProcessDeferredFree(static_cast<UINT64>(-1));
 }
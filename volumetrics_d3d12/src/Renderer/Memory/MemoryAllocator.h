@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Core.h"
+#include "TLSFAllocator.h"
+#include "TLSFTrace.h"
+#include "FenceRetireQueue.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -58,9 +61,14 @@ public:
 
 
 	DescriptorAllocation Allocate(UINT countToAlloc);
+	// The descriptors will be returned to the heap once the direct queue has completed all work submitted so far
+	// Frees are tagged with fence values of the direct queue only, which is the queue that ProcessDeferredFree is given
 	void Free(DescriptorAllocation& allocation);
 
-	void ProcessDeferredFree(UINT frameIndex);
+	// Return all freed ranges whose direct queue fence value has been reached to the heap
+	void ProcessDeferredFree(UINT64 completedFenceValue);
+	// NOTE: this is only safe to do so when ALL WORK HAS BEEN COMPLETED ON THE GPU!!!
+	void ProcessAllDeferredFree();
 
 	// Getters
 	inline ID3D12DescriptorHeap* GetHeap() const { return m_Heap.Get(); }
@@ -69,6 +77,16 @@ public:
 
 	inline UINT GetCapacity() const { return m_Capacity; }
 	inline UINT GetCount() const { return m_Count; }
+	inline UINT GetPendingFreeCount() const { return static_cast<UINT>(m_DeferredFrees.GetPendingCount()); }
+
+	inline float GetFragmentation() const { return m_Allocator.GetFragmentation(); }
+
+	// Records the allocations and frees that reach the TLSF allocator, for offline replay by volumetrics_bench
+	// Deferred frees are recorded when they are retired, as that is when the allocator sees them
+	inline void BeginTraceRecording() { m_TraceRecorder.Begin(m_Allocator); }
+	inline TLSFTrace EndTraceRecording() { return m_TraceRecorder.End(); }
+	inline bool IsRecordingTrace() const { return m_TraceRecorder.IsRecording(); }
+	inline size_t GetTraceOperationCount() const { return m_TraceRecorder.GetOperationCount(); }
 
 private:
 	// In this design, a D3DDescriptor heap owns its entire heap
@@ -82,8 +100,9 @@ private:
 
 	bool m_CPUOnly = false;
 
-	std::map<UINT, UINT> m_FreeBlocks; // Map of index to size of free blocks
+	TLSFAllocator m_Allocator; // Tracks which descriptor indices in the heap are free
+	TLSFTraceRecorder m_TraceRecorder;
 
-	using DeferredFreeCollection = std::vector<std::pair<UINT, UINT>>;
-	std::vector<DeferredFreeCollection> m_DeferredFrees; // One collection is required for each frame in flight
+	// Freed ranges of (index, count) waiting for the GPU to finish using them
+	FenceRetireQueue<std::pair<UINT, UINT>> m_DeferredFrees;
 };
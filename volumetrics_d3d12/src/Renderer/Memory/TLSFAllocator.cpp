@@ -0,0 +1,251 @@
+#include "pch.h"
+#include "TLSFAllocator.h"
+
+#include <bit>
+
+
+TLSFAllocator::TLSFAllocator(UINT capacity)
+{
+	Reset(capacity);
+}
+
+void TLSFAllocator::Reset(UINT capacity)
+{
+	m_Capacity = capacity;
+	m_FreeCount = 0;
+	m_FreeBlockCount = 0;
+
+	m_Blocks.assign(m_Capacity, FreeBlock{});
+	m_BlockStartFromEnd.assign(m_Capacity, InvalidIndex);
+
+	m_FLBitmap = 0;
+	m_SLBitmaps.fill(0);
+	for (auto& heads : m_FreeHeads)
+		heads.fill(InvalidIndex);
+
+	// Initially the entire range is a single free block
+	if (m_Capacity > 0)
+		InsertFreeBlock(0, m_Capacity);
+}
+
+
+UINT TLSFAllocator::Allocate(UINT count)
+{
+	ASSERT(count > 0, "Invalid allocation size");
+
+	if (count == 0 || count > m_FreeCount)
+		return InvalidIndex;
+
+	UINT index = InvalidIndex;
+
+	UINT fl, sl;
+	if (MappingSearch(count, fl, sl))
+	{
+		index = FindSuitableBlock(fl, sl);
+	}
+
+	if (index == InvalidIndex)
+	{
+		// Rounding the size up to the next class can skip over blocks that would fit in the class that contains 'count'
+		// Before failing, check that class directly
+		Mapping(count, fl, sl);
+		for (UINT block = m_FreeHeads[fl][sl]; block != InvalidIndex; block = m_Blocks[block].NextFree)
+		{
+			if (m_Blocks[block].Size >= count)
+			{
+				index = block;
+				break;
+			}
+		}
+
+		if (index == InvalidIndex)
+			return InvalidIndex;
+	}
+
+	const UINT blockSize = m_Blocks[index].Size;
+	RemoveFreeBlock(index);
+
+	// Return the remaining space to the free-list
+	if (blockSize > count)
+	{
+		InsertFreeBlock(index + count, blockSize - count);
+	}
+
+	return index;
+}
+
+void TLSFAllocator::Free(UINT index, UINT count)
+{
+	ASSERT(count > 0, "Invalid free size");
+	ASSERT(index + count <= m_Capacity, "Freeing out of range");
+	ASSERT(m_Blocks[index].Size == 0, "Double free");
+
+	// Merge with the preceding block if it is free
+	if (index > 0)
+	{
+		const UINT prev = m_BlockStartFromEnd[index - 1];
+		if (prev != InvalidIndex)
+		{
+			count += m_Blocks[prev].Size;
+			RemoveFreeBlock(prev);
+			index = prev;
+		}
+	}
+
+	// Merge with the following block if it is free
+	const UINT next = index + count;
+	if (next < m_Capacity && m_Blocks[next].Size > 0)
+	{
+		count += m_Blocks[next].Size;
+		RemoveFreeBlock(next);
+	}
+
+	InsertFreeBlock(index, count);
+}
+
+
+UINT TLSFAllocator::GetLargestFreeBlock() const
+{
+	if (m_FLBitmap == 0)
+		return 0;
+
+	// The largest block will be in the highest populated size class
+	const UINT fl = std::bit_width(m_FLBitmap) - 1;
+	const UINT sl = std::bit_width(m_SLBitmaps[fl]) - 1;
+
+	UINT largest = 0;
+	for (UINT block = m_FreeHeads[fl][sl]; block != InvalidIndex; block = m_Blocks[block].NextFree)
+	{
+		largest = max(largest, m_Blocks[block].Size);
+	}
+	return largest;
+}
+
+std::vector<std::pair<UINT, UINT>> TLSFAllocator::GetFreeBlocks() const
+{
+	std::vector<std::pair<UINT, UINT>> freeBlocks;
+	freeBlocks.reserve(m_FreeBlockCount);
+
+	for (UINT index = 0; index < m_Capacity;)
+	{
+		const UINT size = m_Blocks[index].Size;
+		if (size > 0)
+			freeBlocks.emplace_back(index, size);
+		index += max(size, 1u);
+	}
+	return freeBlocks;
+}
+
+float TLSFAllocator::GetFragmentation() const
+{
+	if (m_FreeCount == 0)
+		return 0.0f;
+
+	return 1.0f - static_cast<float>(GetLargestFreeBlock()) / static_cast<float>(m_FreeCount);
+}
+
+
+void TLSFAllocator::InsertFreeBlock(UINT index, UINT size)
+{
+	UINT fl, sl;
+	Mapping(size, fl, sl);
+
+	const UINT head = m_FreeHeads[fl][sl];
+
+	m_Blocks[index] = { size, InvalidIndex, head };
+	if (head != InvalidIndex)
+		m_Blocks[head].PrevFree = index;
+	m_FreeHeads[fl][sl] = index;
+
+	m_BlockStartFromEnd[index + size - 1] = index;
+
+	m_FLBitmap |= 1u << fl;
+	m_SLBitmaps[fl] |= 1u << sl;
+
+	m_FreeCount += size;
+	m_FreeBlockCount++;
+}
+
+void TLSFAllocator::RemoveFreeBlock(UINT index)
+{
+	FreeBlock& block = m_Blocks[index];
+	ASSERT(block.Size > 0, "Block is not free");
+
+	UINT fl, sl;
+	Mapping(block.Size, fl, sl);
+
+	if (block.PrevFree != InvalidIndex)
+		m_Blocks[block.PrevFree].NextFree = block.NextFree;
+	else
+		m_FreeHeads[fl][sl] = block.NextFree;
+
+	if (block.NextFree != InvalidIndex)
+		m_Blocks[block.NextFree].PrevFree = block.PrevFree;
+
+	// Clear the bitmaps if the size class is now empty
+	if (m_FreeHeads[fl][sl] == InvalidIndex)
+	{
+		m_SLBitmaps[fl] &= ~(1u << sl);
+		if (m_SLBitmaps[fl] == 0)
+			m_FLBitmap &= ~(1u << fl);
+	}
+
+	m_BlockStartFromEnd[index + block.Size - 1] = InvalidIndex;
+
+	m_FreeCount -= block.Size;
+	m_FreeBlockCount--;
+
+	block = FreeBlock{};
+}
+
+
+void TLSFAllocator::Mapping(UINT size, UINT& fl, UINT& sl)
+{
+	if (size < s_SLCount)
+	{
+		// Small sizes map linearly into the first class
+		fl = 0;
+		sl = size;
+	}
+	else
+	{
+		const UINT msb = std::bit_width(size) - 1;
+		fl = msb - s_SLLog2 + 1;
+		sl = (size >> (msb - s_SLLog2)) - s_SLCount;
+	}
+}
+
+bool TLSFAllocator::MappingSearch(UINT size, UINT& fl, UINT& sl)
+{
+	UINT64 roundedSize = size;
+	if (size >= s_SLCount)
+	{
+		const UINT msb = std::bit_width(size) - 1;
+		roundedSize += (1ull << (msb - s_SLLog2)) - 1;
+	}
+
+	if (roundedSize > static_cast<UINT>(-1))
+		return false;
+
+	Mapping(static_cast<UINT>(roundedSize), fl, sl);
+	return true;
+}
+
+UINT TLSFAllocator::FindSuitableBlock(UINT fl, UINT sl) const
+{
+	// Look for a populated class in the same first-level class
+	UINT slMap = m_SLBitmaps[fl] & (~0u << sl);
+	if (slMap == 0)
+	{
+		// Otherwise, take the next populated first-level class
+		const UINT flMap = m_FLBitmap & (~0u << (fl + 1));
+		if (flMap == 0)
+			return InvalidIndex;
+
+		fl = std::countr_zero(flMap);
+		slMap = m_SLBitmaps[fl];
+	}
+
+	sl = std::countr_zero(slMap);
+	return m_FreeHeads[fl][sl];
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Core.h"
+
+
+/**
+ *	A TLSFAllocator manages a contiguous range of indices [0, capacity) using
+ *	a two-level segregated fit free-list.
+ *
+ *	Free blocks are bucketed by size into first-level (power of two) and second-level
+ *	(linear subdivision) classes, with a bitmap over each level so that a suitable
+ *	block can be found with a couple of bit scans. Allocation and free are O(1),
+ *	and freed ranges are merged with their immediate neighbours on insertion.
+ *
+ *	It has no knowledge of what the indices refer to, so it is used to manage the
+ *	descriptors of a DescriptorHeap but does not depend on any D3D objects.
+ */
+class TLSFAllocator
+{
+public:
+	inline static constexpr UINT InvalidIndex = static_cast<UINT>(-1);
+
+public:
+	TLSFAllocator() = default;
+	TLSFAllocator(UINT capacity);
+	~TLSFAllocator() = default;
+
+	DEFAULT_COPY(TLSFAllocator)
+	DEFAULT_MOVE(TLSFAllocator)
+
+	void Reset(UINT capacity);
+
+	// Returns the first index of a free range of 'count' indices, or InvalidIndex if no such range exists
+	UINT Allocate(UINT count);
+	// Returns a range to the free-list, merging it with any free neighbours
+	void Free(UINT index, UINT count);
+
+	// Getters
+	inline UINT GetCapacity() const { return m_Capacity; }
+	inline UINT GetAllocatedCount() const { return m_Capacity - m_FreeCount; }
+	inline UINT GetFreeCount() const { return m_FreeCount; }
+	inline UINT GetFreeBlockCount() const { return m_FreeBlockCount; }
+
+	UINT GetLargestFreeBlock() const;
+	// 0 when all free space is contiguous, approaching 1 as free space is split into many small blocks
+	float GetFragmentation() const;
+
+	// (index, count) of every free block in index order, walking the whole range
+	std::vector<std::pair<UINT, UINT>> GetFreeBlocks() const;
+
+private:
+	void InsertFreeBlock(UINT index, UINT size);
+	void RemoveFreeBlock(UINT index);
+
+	// Find the size class that contains blocks of exactly this size
+	static void Mapping(UINT size, UINT& fl, UINT& sl);
+	// Find the smallest size class where every block is guaranteed to be at least this size
+	static bool MappingSearch(UINT size, UINT& fl, UINT& sl);
+
+	UINT FindSuitableBlock(UINT fl, UINT sl) const;
+
+private:
+	inline static constexpr UINT s_SLLog2 = 4;
+	inline static constexpr UINT s_SLCount = 1 << s_SLLog2;
+	inline static constexpr UINT s_FLCount = 32 - s_SLLog2 + 1;
+
+	struct FreeBlock
+	{
+		UINT Size = 0;		// 0 if there is no free block beginning at this index
+		UINT PrevFree = InvalidIndex;
+		UINT NextFree = InvalidIndex;
+	};
+
+	UINT m_Capacity = 0;
+	UINT m_FreeCount = 0;
+	UINT m_FreeBlockCount = 0;
+
+	// Block headers are stored per-index so that neighbours can be found in constant time
+	std::vector<FreeBlock> m_Blocks;
+	// Maps the last index of a free block back to its first index (InvalidIndex otherwise)
+	std::vector<UINT> m_BlockStartFromEnd;
+
+	// Size class bitmaps and the head of the free-list for each size class
+	UINT m_FLBitmap = 0;
+	std::array<UINT, s_FLCount> m_SLBitmaps{};
+	std::array<std::array<UINT, s_SLCount>, s_FLCount> m_FreeHeads{};
+};
@@ -0,0 +1,133 @@
+#include "pch.h"
+#include "TLSFTrace.h"
+
+#include <fstream>
+
+
+namespace
+{
+	constexpr UINT s_Version = 1;
+
+	struct TraceFileHeader
+	{
+		char Magic[4];
+		UINT Version;
+		UINT Capacity;
+		UINT SlotCount;
+		UINT64 InitialFreeBlockCount;
+		UINT64 OperationCount;
+	};
+
+	constexpr char s_TraceFileMagic[4] = { 'T', 'L', 'S', 'F' };
+}
+
+
+bool TLSFTrace::Save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for writing", path);
+		return false;
+	}
+
+	TraceFileHeader header = {};
+	memcpy(header.Magic, s_TraceFileMagic, sizeof(header.Magic));
+	header.Version = s_Version;
+	header.Capacity = Capacity;
+	header.SlotCount = SlotCount;
+	header.InitialFreeBlockCount = InitialFreeBlocks.size();
+	header.OperationCount = Operations.size();
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(InitialFreeBlocks.data()), InitialFreeBlocks.size() * sizeof(InitialFreeBlocks[0]));
+	file.write(reinterpret_cast<const char*>(Operations.data()), Operations.size() * sizeof(Operation));
+	return file.good();
+}
+
+bool TLSFTrace::Load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		LOG_ERROR("Failed to open {} for reading", path);
+		return false;
+	}
+
+	TraceFileHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || memcmp(header.Magic, s_TraceFileMagic, sizeof(header.Magic)) != 0 || header.Version != s_Version)
+	{
+		LOG_WARN("TLSF trace: {} is not a trace file of this version", path);
+		return false;
+	}
+
+	Capacity = header.Capacity;
+	SlotCount = header.SlotCount;
+	InitialFreeBlocks.resize(header.InitialFreeBlockCount);
+	Operations.resize(header.OperationCount);
+
+	file.read(reinterpret_cast<char*>(InitialFreeBlocks.data()), InitialFreeBlocks.size() * sizeof(InitialFreeBlocks[0]));
+	file.read(reinterpret_cast<char*>(Operations.data()), Operations.size() * sizeof(Operation));
+	if (!file)
+	{
+		LOG_WARN("TLSF trace: {} is truncated", path);
+		return false;
+	}
+
+	// Check the slots so that a corrupt file cannot index out of range on replay
+	for (const Operation& operation : Operations)
+	{
+		if (operation.Type != OperationType::FreeRange && operation.Slot >= SlotCount)
+		{
+			LOG_WARN("TLSF trace: {} refers to a slot out of range", path);
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void TLSFTraceRecorder::Begin(const TLSFAllocator& allocator)
+{
+	m_IsRecording = true;
+	m_SlotFromIndex.clear();
+
+	m_Trace = {};
+	m_Trace.Capacity = allocator.GetCapacity();
+	m_Trace.InitialFreeBlocks = allocator.GetFreeBlocks();
+}
+
+TLSFTrace TLSFTraceRecorder::End()
+{
+	m_IsRecording = false;
+	m_SlotFromIndex.clear();
+	return std::move(m_Trace);
+}
+
+void TLSFTraceRecorder::OnAllocate(UINT index, UINT count)
+{
+	if (!m_IsRecording)
+		return;
+
+	const UINT slot = m_Trace.SlotCount++;
+	m_Trace.Operations.push_back({ TLSFTrace::OperationType::Allocate, slot, index, count });
+	if (index != TLSFAllocator::InvalidIndex)
+		m_SlotFromIndex[index] = slot;
+}
+
+void TLSFTraceRecorder::OnFree(UINT index, UINT count)
+{
+	if (!m_IsRecording)
+		return;
+
+	const auto slotIt = m_SlotFromIndex.find(index);
+	if (slotIt == m_SlotFromIndex.end())
+	{
+		m_Trace.Operations.push_back({ TLSFTrace::OperationType::FreeRange, TLSFAllocator::InvalidIndex, index, count });
+		return;
+	}
+
+	m_Trace.Operations.push_back({ TLSFTrace::OperationType::Free, slotIt->second, index, count });
+	m_SlotFromIndex.erase(slotIt);
+}
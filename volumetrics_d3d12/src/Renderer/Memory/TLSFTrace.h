@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Core.h"
+#include "TLSFAllocator.h"
+
+#include <string>
+#include <unordered_map>
+
+
+/**
+ *	A TLSFTrace is the sequence of allocations and frees that a TLSFAllocator received,
+ *	recorded from a DescriptorHeap by TLSFTraceRecorder so that it can be replayed offline
+ *	against this allocator or others.
+ *
+ *	Recording can begin while the heap is in use. The free blocks at that point are stored,
+ *	and the allocations that were made before recording are freed by index rather than by
+ *	the slot of a recorded allocation.
+ */
+struct TLSFTrace
+{
+	enum class OperationType : UINT
+	{
+		Allocate,	// Allocates Count indices for Slot; Index is where the recording allocator placed them
+		Free,		// Frees the indices allocated for Slot
+		FreeRange	// Frees Count indices from Index, allocated before recording began
+	};
+
+	struct Operation
+	{
+		OperationType Type;
+		UINT Slot;
+		UINT Index;
+		UINT Count;
+	};
+
+	UINT Capacity = 0;
+	UINT SlotCount = 0;
+
+	// (index, count) of each free block when recording began
+	std::vector<std::pair<UINT, UINT>> InitialFreeBlocks;
+	std::vector<Operation> Operations;
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	// Replays the trace against any allocator with the interface of TLSFAllocator
+	// The allocator is brought to the state of the recording's start by allocating everything and freeing
+	// the initial free blocks; 'onOperation(allocator, operation, index)' is then called after each operation,
+	// with the index that this allocator returned for allocations
+	template <typename Allocator, typename Callback>
+	void Replay(Allocator& allocator, std::vector<UINT>& slotIndices, Callback&& onOperation) const;
+};
+
+
+template <typename Allocator, typename Callback>
+void TLSFTrace::Replay(Allocator& allocator, std::vector<UINT>& slotIndices, Callback&& onOperation) const
+{
+	const bool startsEmpty = InitialFreeBlocks.size() == 1 && InitialFreeBlocks[0] == std::make_pair(0u, Capacity);
+	if (!startsEmpty && Capacity > 0)
+	{
+		const UINT everything = allocator.Allocate(Capacity);
+		ASSERT(everything == 0, "The allocator must be empty before replay");
+		(void)everything;
+
+		for (const auto& [index, count] : InitialFreeBlocks)
+			allocator.Free(index, count);
+	}
+
+	slotIndices.assign(SlotCount, TLSFAllocator::InvalidIndex);
+	for (const Operation& operation : Operations)
+	{
+		UINT index = TLSFAllocator::InvalidIndex;
+		switch (operation.Type)
+		{
+		case OperationType::Allocate:
+			index = allocator.Allocate(operation.Count);
+			slotIndices[operation.Slot] = index;
+			break;
+
+		case OperationType::Free:
+			// An allocation that failed in this replay has nothing to free
+			index = slotIndices[operation.Slot];
+			if (index != TLSFAllocator::InvalidIndex)
+				allocator.Free(index, operation.Count);
+			slotIndices[operation.Slot] = TLSFAllocator::InvalidIndex;
+			break;
+
+		case OperationType::FreeRange:
+			index = operation.Index;
+			allocator.Free(index, operation.Count);
+			break;
+		}
+
+		onOperation(allocator, operation, index);
+	}
+}
+
+
+/**
+ *	Records the operations on a TLSFAllocator into a TLSFTrace.
+ *	The owner of the allocator reports each operation as it is applied to the allocator.
+ */
+class TLSFTraceRecorder
+{
+public:
+	TLSFTraceRecorder() = default;
+	~TLSFTraceRecorder() = default;
+
+	DISALLOW_COPY(TLSFTraceRecorder)
+	DEFAULT_MOVE(TLSFTraceRecorder)
+
+	void Begin(const TLSFAllocator& allocator);
+	// Returns the recorded trace and stops recording
+	TLSFTrace End();
+
+	// 'index' is the result of TLSFAllocator::Allocate, which may be InvalidIndex
+	void OnAllocate(UINT index, UINT count);
+	void OnFree(UINT index, UINT count);
+
+	inline bool IsRecording() const { return m_IsRecording; }
+	inline size_t GetOperationCount() const { return m_Trace.Operations.size(); }
+
+private:
+	bool m_IsRecording = false;
+	TLSFTrace m_Trace;
+
+	// The slot of each live allocation that was recorded, by its first index
+	std::unordered_map<UINT, UINT> m_SlotFromIndex;
+};
@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "TransientDescriptorRing.h"
+
+
+// TransientDescriptorAllocation
+
+
+TransientDescriptorAllocation::TransientDescriptorAllocation(D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle, D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle, UINT count, UINT descriptorSize)
+	: m_CPUHandle(cpuHandle)
+	, m_GPUHandle(gpuHandle)
+	, m_Count(count)
+	, m_DescriptorSize(descriptorSize)
+{
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE TransientDescriptorAllocation::GetCPUHandle(UINT index) const
+{
+	ASSERT(IsValid(), "Cannot get handle on an invalid allocation");
+	ASSERT(index < m_Count, "Invalid descriptor index");
+
+	return { m_CPUHandle.ptr + static_cast<SIZE_T>(index) * m_DescriptorSize };
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE TransientDescriptorAllocation::GetGPUHandle(UINT index) const
+{
+	ASSERT(IsValid(), "Cannot get handle on an invalid allocation");
+	ASSERT(index < m_Count, "Invalid descriptor index");
+
+	return { m_GPUHandle.ptr + static_cast<UINT64>(index) * m_DescriptorSize };
+}
+
+
+// TransientDescriptorRing
+
+
+TransientDescriptorRing::TransientDescriptorRing(D3D12_CPU_DESCRIPTOR_HANDLE cpuBase, D3D12_GPU_DESCRIPTOR_HANDLE gpuBase, UINT descriptorSize, UINT descriptorsPerFrame, UINT frameCount)
+	: m_CPUBase(cpuBase)
+	, m_GPUBase(gpuBase)
+	, m_DescriptorSize(descriptorSize)
+	, m_DescriptorsPerFrame(descriptorsPerFrame)
+	, m_FrameAllocators(frameCount)
+{
+	ASSERT(m_CPUBase.ptr != 0, "Invalid descriptor range");
+	ASSERT(m_DescriptorsPerFrame > 0 && frameCount > 0, "Invalid ring size");
+
+	for (auto& allocator : m_FrameAllocators)
+	{
+		allocator.Reset(m_DescriptorsPerFrame);
+	}
+}
+
+
+TransientDescriptorAllocation TransientDescriptorRing::Allocate(UINT count)
+{
+	ASSERT(count > 0, "Invalid quantity of descriptors");
+
+	const UINT64 offset = m_FrameAllocators.at(m_CurrentFrame).Allocate(count);
+	if (offset == AtomicLinearAllocator::InvalidOffset)
+	{
+		LOG_ERROR("Transient descriptor allocation failed: frame segment exhausted. Segment size: {0} Count to alloc: {1}", m_DescriptorsPerFrame, count);
+		return {};
+	}
+
+	// Index of the allocation within the ring
+	const UINT index = m_CurrentFrame * m_DescriptorsPerFrame + static_cast<UINT>(offset);
+	return TransientDescriptorAllocation{
+		{ m_CPUBase.ptr + static_cast<SIZE_T>(index) * m_DescriptorSize },
+		{ m_GPUBase.ptr + static_cast<UINT64>(index) * m_DescriptorSize },
+		count,
+		m_DescriptorSize
+	};
+}
+
+void TransientDescriptorRing::BeginFrame(UINT frameIndex)
+{
+	ASSERT(frameIndex < m_FrameAllocators.size(), "Invalid frame index");
+
+	m_CurrentFrame = frameIndex;
+	m_FrameAllocators.at(m_CurrentFrame).Reset();
+}
+
+
+UINT TransientDescriptorRing::GetHighWaterMark() const
+{
+	UINT64 highWaterMark = 0;
+	for (const auto& allocator : m_FrameAllocators)
+	{
+		highWaterMark = max(highWaterMark, max(allocator.GetHighWaterMark(), allocator.GetUsed()));
+	}
+	return static_cast<UINT>(highWaterMark);
+}
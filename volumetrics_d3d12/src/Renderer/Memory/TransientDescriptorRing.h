@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Core.h"
+#include "AtomicLinearAllocator.h"
+
+
+// A range of descriptors that is only valid for the frame it was allocated in
+// It does not need to be freed
+class TransientDescriptorAllocation
+{
+public:
+	TransientDescriptorAllocation() = default;
+	TransientDescriptorAllocation(
+		D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle,
+		D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle,
+		UINT count,
+		UINT descriptorSize
+	);
+	~TransientDescriptorAllocation() = default;
+
+	DEFAULT_COPY(TransientDescriptorAllocation)
+	DEFAULT_MOVE(TransientDescriptorAllocation)
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCPUHandle(UINT index = 0) const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGPUHandle(UINT index = 0) const;
+
+	inline bool IsValid() const { return m_Count > 0; }
+	inline UINT GetCount() const { return m_Count; }
+
+private:
+	D3D12_CPU_DESCRIPTOR_HANDLE m_CPUHandle{ 0 };
+	D3D12_GPU_DESCRIPTOR_HANDLE m_GPUHandle{ 0 };
+	UINT m_Count = 0;
+	UINT m_DescriptorSize = 0;
+};
+
+
+/**
+ *	A TransientDescriptorRing is a region of a shader-visible DescriptorHeap set aside for
+ *	descriptor tables that only live for a single frame.
+ *
+ *	The region is split into one segment per frame in flight. Allocations bump-allocate from the
+ *	current frame's segment without taking any locks, so any thread recording commands can allocate.
+ *	A segment is recycled all at once when the fence of the frame that last used it has completed.
+ *
+ *	The ring only deals in descriptor handles, so the owner carves its region out of the heap,
+ *	and it can be driven without a device for testing.
+ */
+class TransientDescriptorRing
+{
+public:
+	// cpuBase and gpuBase are the first of descriptorsPerFrame * frameCount contiguous descriptors
+	TransientDescriptorRing(D3D12_CPU_DESCRIPTOR_HANDLE cpuBase, D3D12_GPU_DESCRIPTOR_HANDLE gpuBase, UINT descriptorSize, UINT descriptorsPerFrame, UINT frameCount);
+	~TransientDescriptorRing() = default;
+
+	DISALLOW_COPY(TransientDescriptorRing)
+	DISALLOW_MOVE(TransientDescriptorRing)
+
+	// Thread-safe
+	// Returns an invalid allocation if the current frame's segment is exhausted
+	TransientDescriptorAllocation Allocate(UINT count);
+
+	// Recycles the segment for this frame and makes it current
+	// The GPU must have finished all work from the last time this frame index was used
+	void BeginFrame(UINT frameIndex);
+
+	// Getters
+	inline UINT GetDescriptorsPerFrame() const { return m_DescriptorsPerFrame; }
+	inline UINT GetCurrentFrameUsage() const { return static_cast<UINT>(m_FrameAllocators.at(m_CurrentFrame).GetUsed()); }
+	// The most descriptors used by any single frame so far
+	UINT GetHighWaterMark() const;
+
+private:
+	D3D12_CPU_DESCRIPTOR_HANDLE m_CPUBase{ 0 };
+	D3D12_GPU_DESCRIPTOR_HANDLE m_GPUBase{ 0 };
+	UINT m_DescriptorSize = 0;
+
+	UINT m_DescriptorsPerFrame = 0;
+	UINT m_CurrentFrame = 0;
+
+	std::vector<AtomicLinearAllocator> m_FrameAllocators;
+};
@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "GPUTimer.h"
+
+#include "Renderer/D3DGraphicsContext.h"
+
+
+GPUTimer::GPUTimer(UINT timerCount, const wchar_t* name)
+	: m_TimerCount(timerCount)
+{
+	ASSERT(timerCount > 0, "A GPU timer needs at least one timer");
+
+	const auto device = g_D3DGraphicsContext->GetDevice();
+	const UINT queryCount = 2 * timerCount * D3DGraphicsContext::GetBackBufferCount();
+
+	D3D12_QUERY_HEAP_DESC heapDesc = {};
+	heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	heapDesc.Count = queryCount;
+	heapDesc.NodeMask = 0;
+	THROW_IF_FAIL(device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&m_QueryHeap)));
+	if (name)
+		m_QueryHeap->SetName(name);
+
+	m_ReadbackBuffer.Allocate(device, queryCount, 0, name);
+
+	THROW_IF_FAIL(g_D3DGraphicsContext->GetDirectCommandQueue()->GetCommandQueue()->GetTimestampFrequency(&m_TimestampFrequency));
+
+	m_TimerWritten.resize(timerCount * D3DGraphicsContext::GetBackBufferCount(), false);
+	m_Milliseconds.resize(timerCount, -1.0f);
+	m_Timestamps.resize(2 * timerCount);
+}
+
+
+void GPUTimer::BeginFrame()
+{
+	const UINT frameTimerOffset = g_D3DGraphicsContext->GetCurrentBackBuffer() * m_TimerCount;
+
+	m_ReadbackBuffer.ReadElements(GetFrameQueryOffset(), 2 * m_TimerCount, m_Timestamps.data());
+
+	for (UINT timer = 0; timer < m_TimerCount; timer++)
+	{
+		if (m_TimerWritten.at(frameTimerOffset + timer))
+		{
+			const UINT64 start = m_Timestamps.at(2 * timer);
+			const UINT64 end = m_Timestamps.at(2 * timer + 1);
+			const UINT64 ticks = end > start ? end - start : 0;
+			m_Milliseconds.at(timer) = static_cast<float>(1000.0 * static_cast<double>(ticks) / static_cast<double>(m_TimestampFrequency));
+		}
+		else
+		{
+			m_Milliseconds.at(timer) = -1.0f;
+		}
+
+		m_TimerWritten.at(frameTimerOffset + timer) = false;
+	}
+}
+
+void GPUTimer::Start(ID3D12GraphicsCommandList* commandList, UINT timer)
+{
+	ASSERT(timer < m_TimerCount, "Invalid timer");
+	commandList->EndQuery(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, GetFrameQueryOffset() + 2 * timer);
+}
+
+void GPUTimer::Stop(ID3D12GraphicsCommandList* commandList, UINT timer)
+{
+	ASSERT(timer < m_TimerCount, "Invalid timer");
+	commandList->EndQuery(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, GetFrameQueryOffset() + 2 * timer + 1);
+
+	m_TimerWritten.at(g_D3DGraphicsContext->GetCurrentBackBuffer() * m_TimerCount + timer) = true;
+}
+
+void GPUTimer::EndFrame(ID3D12GraphicsCommandList* commandList)
+{
+	const UINT frameTimerOffset = g_D3DGraphicsContext->GetCurrentBackBuffer() * m_TimerCount;
+
+	// Only resolve the timers that were written, as resolving a query that was never ended is invalid
+	for (UINT timer = 0; timer < m_TimerCount; timer++)
+	{
+		if (!m_TimerWritten.at(frameTimerOffset + timer))
+			continue;
+
+		const UINT firstQuery = GetFrameQueryOffset() + 2 * timer;
+		commandList->ResolveQueryData(m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, 2, m_ReadbackBuffer.GetResource(), firstQuery * sizeof(UINT64));
+	}
+}
+
+
+UINT GPUTimer::GetFrameQueryOffset() const
+{
+	return 2 * m_TimerCount * g_D3DGraphicsContext->GetCurrentBackBuffer();
+}
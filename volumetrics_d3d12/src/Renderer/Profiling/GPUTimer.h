@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Core.h"
+#include "Renderer/Buffer/ReadbackBuffer.h"
+
+using Microsoft::WRL::ComPtr;
+
+
+/**
+ *	A GPUTimer measures the GPU time between pairs of timestamps written on the direct queue.
+ *
+ *	Each frame in flight writes its timestamps into its own region of a query heap, which is resolved into
+ *	the matching region of a readback buffer at the end of the frame. The results are read when the same
+ *	frame resources come around again, at which point the GPU has finished with them, so reading never stalls.
+ *	Results are therefore GetBackBufferCount() frames old.
+ */
+class GPUTimer
+{
+public:
+	GPUTimer(UINT timerCount, const wchar_t* name);
+	~GPUTimer() = default;
+
+	DISALLOW_COPY(GPUTimer)
+	DEFAULT_MOVE(GPUTimer)
+
+	// Reads the results written the last time the current frame resources were used
+	// Call once per frame, before any timers are started
+	void BeginFrame();
+
+	void Start(ID3D12GraphicsCommandList* commandList, UINT timer);
+	void Stop(ID3D12GraphicsCommandList* commandList, UINT timer);
+
+	// Resolves the timestamps written this frame
+	void EndFrame(ID3D12GraphicsCommandList* commandList);
+
+	// Time between Start and Stop in the frame read by BeginFrame, or a negative value if the timer was not used in that frame
+	inline float GetMilliseconds(UINT timer) const { return m_Milliseconds.at(timer); }
+	inline UINT GetTimerCount() const { return m_TimerCount; }
+
+private:
+	// Index of the first timestamp of the current frame
+	UINT GetFrameQueryOffset() const;
+
+private:
+	UINT m_TimerCount = 0;
+
+	ComPtr<ID3D12QueryHeap> m_QueryHeap;
+	ReadbackBuffer<UINT64> m_ReadbackBuffer;
+	UINT64 m_TimestampFrequency = 1;
+
+	// Whether each timer was both started and stopped, per frame resources
+	std::vector<bool> m_TimerWritten;
+
+	std::vector<float> m_Milliseconds;
+	std::vector<UINT64> m_Timestamps;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+// Benchmarks of the engine's CPU modules, run by volumetrics_bench
+// Each prints its own results, and is selected on the command line by name
+
+#include <chrono>
+#include <cstdio>
+
+
+namespace Bench
+{
+	using Clock = std::chrono::steady_clock;
+
+	inline double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	void RunTLSFReplay();
+	void RunFenceRetireQueue();
+	void RunLinearAllocatorContention();
+	void RunLinearUploadAllocator();
+	void RunInstanceBatcher();
+	void RunFrustumCuller();
+	void RunClusteredLightCuller();
+	void RunFogNoiseBaker();
+}
@@ -0,0 +1,58 @@
+#include "pch.h"
+#include "Framework/Log.h"
+#include "Bench.h"
+
+#include <cstring>
+
+
+namespace
+{
+	struct Benchmark
+	{
+		const char* Name;
+		void (*Run)();
+	};
+
+	// Registered benchmarks, in the order they run when none is named
+	const Benchmark s_Benchmarks[] = {
+		{ "tlsf_replay", Bench::RunTLSFReplay },
+		{ "fence_retire_queue", Bench::RunFenceRetireQueue },
+		{ "linear_allocator_contention", Bench::RunLinearAllocatorContention },
+		{ "linear_upload_allocator", Bench::RunLinearUploadAllocator },
+		{ "instance_batcher", Bench::RunInstanceBatcher },
+		{ "frustum_culler", Bench::RunFrustumCuller },
+		{ "clustered_light_culler", Bench::RunClusteredLightCuller },
+		{ "fog_noise_baker", Bench::RunFogNoiseBaker },
+	};
+}
+
+
+// Usage: volumetrics_bench [name...]
+// Runs the named benchmarks, or all of them if none is named
+int main(int argc, char** argv)
+{
+	Log::Init();
+
+	int ran = 0;
+	for (const Benchmark& benchmark : s_Benchmarks)
+	{
+		bool selected = argc <= 1;
+		for (int i = 1; i < argc && !selected; i++)
+			selected = strcmp(argv[i], benchmark.Name) == 0;
+		if (!selected)
+			continue;
+
+		printf("== %s\n", benchmark.Name);
+		benchmark.Run();
+		printf("\n");
+		ran++;
+	}
+
+	if (ran == 0)
+	{
+		printf("No benchmark selected. Available:\n");
+		for (const Benchmark& benchmark : s_Benchmarks)
+			printf("  %s\n", benchmark.Name);
+	}
+	return 0;
+}
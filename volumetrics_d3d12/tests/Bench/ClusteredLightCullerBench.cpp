@@ -0,0 +1,50 @@
+#include "pch.h"
+#include "Renderer/Lighting/ClusteredLightCuller.h"
+#include "Framework/ThreadPool.h"
+#include "Common/SyntheticLights.h"
+#include "Bench.h"
+
+
+// Binning the lights of the default cluster grid, with the hierarchical SIMD binning against the per-cluster reference
+void Bench::RunClusteredLightCuller()
+{
+	ThreadPool& threadPool = ThreadPool::GetDefault();
+	ThreadPool serialPool(0);
+
+	printf("16x9x33 clusters, %u threads\n", threadPool.GetThreadCount());
+	printf("  Lights  Indices   Binned ms  1 thread ms  Reference ms\n");
+
+	for (UINT lightCount : { 1'000u, 10'000u, 50'000u })
+	{
+		const SyntheticLightScene scene = CreateSyntheticLightScene(lightCount, 0x1C);
+
+		ClusteredLightCuller culler;
+		culler.SetClusterGrid(scene.GridDimensions, scene.SliceDepths.data(), scene.Projection);
+		culler.SetLights(scene.Lights.data(), lightCount, scene.View);
+
+		// As LightManager does every frame
+		auto TimeBinning = [&](ThreadPool& pool, UINT iterations)
+			{
+				const auto start = Clock::now();
+				for (UINT i = 0; i < iterations; i++)
+				{
+					culler.SetLights(scene.Lights.data(), lightCount, scene.View);
+					culler.BinLights(pool);
+				}
+				return MillisecondsSince(start) / iterations;
+			};
+
+		const UINT iterations = max(1u, 200'000u / lightCount);
+		const double binnedMilliseconds = TimeBinning(threadPool, iterations);
+		const double serialMilliseconds = TimeBinning(serialPool, iterations);
+
+		std::vector<XMUINT2> referenceRanges;
+		std::vector<UINT> referenceIndices;
+		const auto start = Clock::now();
+		culler.BinLightsReference(referenceRanges, referenceIndices);
+		const double referenceMilliseconds = MillisecondsSince(start);
+
+		printf("  %6u  %7zu  %10.3f  %11.3f  %12.3f\n",
+			lightCount, culler.GetLightIndices().size(), binnedMilliseconds, serialMilliseconds, referenceMilliseconds);
+	}
+}
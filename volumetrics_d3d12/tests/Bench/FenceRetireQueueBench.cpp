@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "Renderer/Memory/FenceRetireQueue.h"
+#include "Common/SimulatedFence.h"
+#include "Bench.h"
+
+
+namespace
+{
+	constexpr UINT s_FramesInFlight = 2;
+	constexpr UINT s_ItemsPerFrame = 256;
+	constexpr UINT s_Frames = 20000;
+
+	struct OccupancyResult
+	{
+		// Cost per frame of retiring the completed items, and of pushing the frame's items
+		double RetireNanosecondsPerFrame = 0.0;
+		double PushNanosecondsPerFrame = 0.0;
+		// Per-frame buckets, which only retire once all of a frame has completed
+		double BucketNanosecondsPerFrame = 0.0;
+	};
+
+	// The queue is first filled with 'occupancy' items that are guarded by a fence far in the future,
+	// as frees of long-lived allocations waiting on another queue would be, so that every push and retire
+	// of the simulated frames works on a heap of at least that size
+	OccupancyResult Run(const SimulatedFrames& simulated, size_t occupancy)
+	{
+		OccupancyResult result;
+
+		// Keeps the retirements from being optimised away
+		UINT64 sum = 0;
+		auto Sink = [&sum](UINT item) { sum += item; };
+
+		{
+			FenceRetireQueue<UINT> queue;
+			const UINT64 neverCompleted = static_cast<UINT64>(-2);
+			for (size_t i = 0; i < occupancy; i++)
+				queue.Push(neverCompleted, static_cast<UINT>(i));
+
+			double retireMilliseconds = 0.0;
+			double pushMilliseconds = 0.0;
+			for (UINT f = 0; f < s_Frames; f++)
+			{
+				const auto retireStart = Bench::Clock::now();
+				queue.Retire(simulated.CompletedFenceValues[f], Sink);
+				retireMilliseconds += Bench::MillisecondsSince(retireStart);
+
+				const auto pushStart = Bench::Clock::now();
+				for (UINT i = 0; i < s_ItemsPerFrame; i++)
+				{
+					const UINT item = f * s_ItemsPerFrame + i;
+					queue.Push(simulated.ItemFenceValues[item], item);
+				}
+				pushMilliseconds += Bench::MillisecondsSince(pushStart);
+			}
+			result.RetireNanosecondsPerFrame = retireMilliseconds * 1.0e6 / s_Frames;
+			result.PushNanosecondsPerFrame = pushMilliseconds * 1.0e6 / s_Frames;
+		}
+
+		// A bucket for each frame that can be in flight, and one that holds the long-lived items and is never retired
+		// Items that were last used by an earlier frame are held until the current frame completes
+		{
+			const UINT bucketCount = s_FramesInFlight + 2;
+			std::vector<std::vector<UINT>> buckets(bucketCount);
+			std::vector<UINT64> bucketFenceValues(bucketCount, 0);
+			for (std::vector<UINT>& bucket : buckets)
+				bucket.reserve(s_ItemsPerFrame);
+
+			std::vector<UINT> longLived(occupancy);
+			for (size_t i = 0; i < occupancy; i++)
+				longLived[i] = static_cast<UINT>(i);
+
+			const auto start = Bench::Clock::now();
+			for (UINT f = 0; f < s_Frames; f++)
+			{
+				for (UINT b = 0; b < bucketCount; b++)
+				{
+					if (!buckets[b].empty() && bucketFenceValues[b] <= simulated.CompletedFenceValues[f])
+					{
+						for (UINT item : buckets[b])
+							Sink(item);
+						buckets[b].clear();
+					}
+				}
+
+				const UINT b = f % bucketCount;
+				bucketFenceValues[b] = static_cast<UINT64>(f) + 1;
+				for (UINT i = 0; i < s_ItemsPerFrame; i++)
+					buckets[b].push_back(f * s_ItemsPerFrame + i);
+			}
+			result.BucketNanosecondsPerFrame = Bench::MillisecondsSince(start) * 1.0e6 / s_Frames;
+			sum += longLived.size();
+		}
+
+		volatile UINT64 sink = sum;
+		(void)sink;
+
+		return result;
+	}
+}
+
+
+// Sweeps the number of items pending in the queue, and reports the per-frame cost of retiring and pushing at each
+void Bench::RunFenceRetireQueue()
+{
+	const SimulatedFrames simulated = SimulateFrames(s_FramesInFlight, s_ItemsPerFrame, s_Frames);
+
+	printf("%u frames, %u in flight, %u items per frame\n", s_Frames, s_FramesInFlight, s_ItemsPerFrame);
+	printf("  Occupancy  Retire ns/frame  Push ns/frame  Buckets ns/frame\n");
+	for (size_t occupancy : { 0, 1000, 10000, 100000, 1000000 })
+	{
+		const OccupancyResult result = Run(simulated, occupancy);
+		printf("  %9zu  %15.1f  %13.1f  %16.1f\n",
+			occupancy, result.RetireNanosecondsPerFrame, result.PushNanosecondsPerFrame, result.BucketNanosecondsPerFrame);
+	}
+}
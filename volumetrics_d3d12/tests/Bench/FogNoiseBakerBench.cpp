@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "Renderer/Lighting/FogNoiseBaker.h"
+#include "Framework/ThreadPool.h"
+#include "Bench.h"
+
+
+// Bakes of the default texture and the largest that the GUI offers, with the default pool, on a single thread,
+// and with the scalar EvaluateTexel that the SSE2 bake follows
+void Bench::RunFogNoiseBaker()
+{
+	// A pool without workers runs every slice on the calling thread
+	ThreadPool singleThread(0);
+	FogNoiseBaker threadedBaker(ThreadPool::GetDefault());
+	FogNoiseBaker singleThreadBaker(singleThread);
+
+	printf("%u threads\n", ThreadPool::GetDefault().GetThreadCount());
+	printf("  Resolution  Threaded SSE2  Single SSE2  Single scalar  (Mvoxels/s)\n");
+
+	for (UINT resolution : { 64u, 128u })
+	{
+		FogNoiseBaker::Desc desc;
+		desc.Resolution = resolution;
+
+		// Each path bakes about 4 million voxels
+		const UINT64 voxels = static_cast<UINT64>(resolution) * resolution * resolution;
+		const UINT iterations = static_cast<UINT>(max<UINT64>(1, (4ull << 20) / voxels));
+
+		auto MvoxelsPerSecond = [&](auto&& bake)
+			{
+				const auto start = Clock::now();
+				for (UINT i = 0; i < iterations; i++)
+				{
+					bake();
+				}
+				return static_cast<double>(voxels * iterations) * 1.0e-3 / max(MillisecondsSince(start), 1e-3);
+			};
+
+		volatile float sink = 0.0f;
+		const double threaded = MvoxelsPerSecond([&]() { threadedBaker.Bake(desc); });
+		const double single = MvoxelsPerSecond([&]() { singleThreadBaker.Bake(desc); });
+		const double scalar = MvoxelsPerSecond([&]()
+			{
+				float sum = 0.0f;
+				for (UINT z = 0; z < resolution; z++)
+				{
+					for (UINT y = 0; y < resolution; y++)
+					{
+						for (UINT x = 0; x < resolution; x++)
+						{
+							float gradient, worley;
+							FogNoiseBaker::EvaluateTexel(desc, x, y, z, gradient, worley);
+							sum += gradient + worley;
+						}
+					}
+				}
+				sink = sink + sum;
+			});
+
+		printf("  %7u^3  %13.2f  %11.2f  %13.2f\n", resolution, threaded, single, scalar);
+	}
+}
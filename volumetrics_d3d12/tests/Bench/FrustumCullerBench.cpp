@@ -0,0 +1,88 @@
+#include "pch.h"
+#include "Renderer/Geometry/FrustumCuller.h"
+#include "Bench.h"
+
+#include <random>
+
+
+namespace
+{
+	// Boxes of a few metres, spread through a kilometre cube around the camera
+	FrustumCuller CreateScene(size_t instanceCount)
+	{
+		FrustumCuller culler;
+		culler.Resize(instanceCount);
+
+		std::mt19937 generator(0xC011);
+		std::uniform_real_distribution<float> positionDistribution(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> sizeDistribution(0.5f, 5.0f);
+		std::uniform_real_distribution<float> angleDistribution(-XM_PI, XM_PI);
+
+		const XMFLOAT3 localMin = { -1.0f, -1.0f, -1.0f };
+		const XMFLOAT3 localMax = { 1.0f, 1.0f, 1.0f };
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			const XMMATRIX scale = XMMatrixScaling(sizeDistribution(generator), sizeDistribution(generator), sizeDistribution(generator));
+			const XMMATRIX rotation = XMMatrixRotationRollPitchYaw(angleDistribution(generator), angleDistribution(generator), angleDistribution(generator));
+			const XMMATRIX translation = XMMatrixTranslation(positionDistribution(generator), positionDistribution(generator), positionDistribution(generator));
+			culler.SetInstanceBounds(i, localMin, localMax, scale * rotation * translation);
+		}
+		return culler;
+	}
+}
+
+
+// Each culling path against a camera frustum and an orthographic sun frustum, as the renderer culls every frame
+void Bench::RunFrustumCuller()
+{
+	const XMMATRIX cameraView = XMMatrixLookToLH(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const XMMATRIX cameraProjection = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	const XMMATRIX sunView = XMMatrixLookToLH(XMVectorSet(0.0f, 500.0f, 0.0f, 1.0f), XMVector3Normalize(XMVectorSet(0.3f, -1.0f, 0.2f, 0.0f)), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f));
+	const XMMATRIX sunProjection = XMMatrixOrthographicLH(400.0f, 400.0f, 0.0f, 1000.0f);
+
+	const std::array<Frustum, 2> frustums = {
+		Frustum::FromViewProjection(cameraView * cameraProjection),
+		Frustum::FromViewProjection(sunView * sunProjection)
+	};
+
+	const bool avxSupported = FrustumCuller::IsAVXSupported();
+	printf("Camera and sun frustums%s\n", avxSupported ? "" : ", AVX not supported");
+	printf("  Instances  Camera     Sun   Scalar      SSE      AVX  (Minstances/s per frustum)\n");
+
+	for (size_t instanceCount = 10'000; instanceCount <= 1'000'000; instanceCount *= 10)
+	{
+		const FrustumCuller culler = CreateScene(instanceCount);
+
+		// Each size culls about 10 million instances per frustum with each path
+		const UINT iterations = static_cast<UINT>(10'000'000 / instanceCount);
+
+		std::vector<UINT> visible;
+		visible.reserve(instanceCount);
+		auto MinstancesPerSecond = [&](void (FrustumCuller::*cull)(const Frustum&, std::vector<UINT>&) const)
+			{
+				const auto start = Clock::now();
+				for (UINT i = 0; i < iterations; i++)
+				{
+					for (const Frustum& frustum : frustums)
+					{
+						visible.clear();
+						(culler.*cull)(frustum, visible);
+					}
+				}
+				return static_cast<double>(instanceCount) * frustums.size() * iterations * 1.0e-3 / max(MillisecondsSince(start), 1e-3);
+			};
+
+		std::array<size_t, 2> visibleCounts;
+		for (size_t f = 0; f < frustums.size(); f++)
+		{
+			visible.clear();
+			culler.CullScalar(frustums[f], visible);
+			visibleCounts[f] = visible.size();
+		}
+
+		const double scalar = MinstancesPerSecond(&FrustumCuller::CullScalar);
+		const double sse = MinstancesPerSecond(&FrustumCuller::CullSSE);
+		const double avx = avxSupported ? MinstancesPerSecond(&FrustumCuller::CullAVX) : 0.0;
+		printf("  %9zu  %6zu  %6zu  %7.1f  %7.1f  %7.1f\n", instanceCount, visibleCounts[0], visibleCounts[1], scalar, sse, avx);
+	}
+}
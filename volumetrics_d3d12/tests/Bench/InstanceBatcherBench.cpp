@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "Renderer/Geometry/InstanceBatcher.h"
+#include "Bench.h"
+
+#include <algorithm>
+#include <random>
+
+
+namespace
+{
+	constexpr UINT s_GeometryCount = 256;
+
+	struct SyntheticScene
+	{
+		std::vector<UINT> GeometryHandles;
+		std::vector<UINT> VisibleInstances;
+	};
+
+	// A third of the instances are visible, and a few geometries are used by most instances, as with the repeated meshes of a real scene
+	SyntheticScene CreateScene(size_t instanceCount)
+	{
+		std::mt19937 generator(0xBA7C);
+
+		// Geometry handles follow a geometric distribution, so a few geometries have most of the instances
+		std::geometric_distribution<UINT> geometryDistribution(4.0 / s_GeometryCount);
+		SyntheticScene scene;
+		scene.GeometryHandles.resize(instanceCount);
+		for (UINT& geometry : scene.GeometryHandles)
+		{
+			const UINT sample = geometryDistribution(generator);
+			geometry = min(sample, s_GeometryCount - 1);
+		}
+
+		// The visible instances are in increasing order, as the FrustumCuller produces them
+		std::bernoulli_distribution visibleDistribution(1.0 / 3.0);
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			if (visibleDistribution(generator))
+				scene.VisibleInstances.push_back(static_cast<UINT>(i));
+		}
+		return scene;
+	}
+}
+
+
+// The counting sort of InstanceBatcher against the stable sort by geometry handle that it replaces
+void Bench::RunInstanceBatcher()
+{
+	printf("%u geometries, a third of the scene visible\n", s_GeometryCount);
+	printf("  Instances  Visible  Batches  Counting sort  Stable sort  (Minstances/s)\n");
+
+	for (size_t instanceCount = 10'000; instanceCount <= 1'000'000; instanceCount *= 10)
+	{
+		const SyntheticScene scene = CreateScene(instanceCount);
+		const size_t visibleCount = scene.VisibleInstances.size();
+
+		// Each size builds about 10 million instances
+		const UINT iterations = static_cast<UINT>(10'000'000 / instanceCount);
+
+		InstanceBatcher batcher;
+		double batcherMilliseconds;
+		{
+			const auto start = Clock::now();
+			for (UINT i = 0; i < iterations; i++)
+				batcher.Build(scene.VisibleInstances.data(), visibleCount, scene.GeometryHandles.data(), s_GeometryCount);
+			batcherMilliseconds = MillisecondsSince(start);
+		}
+
+		double sortMilliseconds;
+		{
+			std::vector<UINT> sorted;
+			std::vector<DrawBatch> batches;
+
+			const auto start = Clock::now();
+			for (UINT i = 0; i < iterations; i++)
+			{
+				sorted = scene.VisibleInstances;
+				std::stable_sort(sorted.begin(), sorted.end(), [&](UINT a, UINT b) { return scene.GeometryHandles[a] < scene.GeometryHandles[b]; });
+
+				batches.clear();
+				for (UINT first = 0; first < sorted.size();)
+				{
+					const UINT geometry = scene.GeometryHandles[sorted[first]];
+					UINT last = first + 1;
+					while (last < sorted.size() && scene.GeometryHandles[sorted[last]] == geometry)
+						last++;
+
+					batches.push_back({ geometry, first, last - first });
+					first = last;
+				}
+			}
+			sortMilliseconds = MillisecondsSince(start);
+		}
+
+		const double instancesBuilt = static_cast<double>(visibleCount) * iterations;
+		printf("  %9zu  %7zu  %7zu  %13.2f  %11.2f\n",
+			instanceCount, visibleCount, batcher.GetBatches().size(),
+			instancesBuilt * 1.0e-3 / max(batcherMilliseconds, 1e-3), instancesBuilt * 1.0e-3 / max(sortMilliseconds, 1e-3));
+	}
+}
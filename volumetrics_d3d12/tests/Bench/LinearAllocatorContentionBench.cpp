@@ -0,0 +1,135 @@
+#include "pch.h"
+#include "Renderer/Memory/AtomicLinearAllocator.h"
+#include "Renderer/Memory/TransientDescriptorRing.h"
+#include "Bench.h"
+
+#include <barrier>
+#include <mutex>
+#include <thread>
+
+
+namespace
+{
+	constexpr UINT s_Frames = 200;
+	constexpr UINT s_AllocationsPerThreadPerFrame = 2000;
+	constexpr UINT s_FrameCount = 2;
+
+	// The same bump allocation behind a lock, as the baseline that the lock-free allocators replace
+	class MutexLinearAllocator
+	{
+	public:
+		MutexLinearAllocator(UINT64 capacity) : m_Capacity(capacity) {}
+
+		UINT64 Allocate(UINT64 size, UINT64 alignment = 1)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			const UINT64 offset = Align(m_Offset, alignment);
+			if (offset + size > m_Capacity)
+				return AtomicLinearAllocator::InvalidOffset;
+			m_Offset = offset + size;
+			return offset;
+		}
+
+		void Reset()
+		{
+			m_Offset = 0;
+		}
+
+	private:
+		std::mutex m_Mutex;
+		UINT64 m_Capacity = 0;
+		UINT64 m_Offset = 0;
+	};
+
+	// Runs 'allocate(thread, i)' from each thread for every frame, and 'beginFrame(frame)' between frames
+	// while no thread is allocating. Returns nanoseconds per allocation over all threads
+	template <typename AllocateFunc, typename BeginFrameFunc>
+	double RunThreads(UINT threadCount, AllocateFunc&& allocate, BeginFrameFunc&& beginFrame)
+	{
+		UINT frame = 0;
+		auto OnFrameEnd = [&]() noexcept { beginFrame(++frame); };
+		std::barrier frameBarrier(threadCount, OnFrameEnd);
+		std::barrier startBarrier(threadCount + 1);
+
+		std::vector<UINT64> failures(threadCount, 0);
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount);
+		for (UINT t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([&, t]()
+				{
+					startBarrier.arrive_and_wait();
+					for (UINT f = 0; f < s_Frames; f++)
+					{
+						for (UINT i = 0; i < s_AllocationsPerThreadPerFrame; i++)
+							failures[t] += !allocate(t, i);
+						frameBarrier.arrive_and_wait();
+					}
+				});
+		}
+
+		beginFrame(0);
+		const auto start = Bench::Clock::now();
+		startBarrier.arrive_and_wait();
+		for (std::thread& thread : threads)
+			thread.join();
+		const double milliseconds = Bench::MillisecondsSince(start);
+
+		UINT64 failed = 0;
+		for (UINT64 threadFailures : failures)
+			failed += threadFailures;
+		if (failed > 0)
+			printf("  %llu allocations failed, the capacity is too small\n", static_cast<unsigned long long>(failed));
+
+		const double allocations = static_cast<double>(threadCount) * s_Frames * s_AllocationsPerThreadPerFrame;
+		return milliseconds * 1.0e6 / allocations;
+	}
+
+	// Descriptor table sizes, and constant buffer sizes, cycled through by each thread
+	inline UINT DescriptorCount(UINT i) { return 1 + (i % 8); }
+	inline UINT64 ConstantBufferSize(UINT i) { return 64 + 64 * (i % 8); }
+}
+
+
+// Allocates from N threads at once, and reports the cost per allocation of each allocator against a mutex
+// The benchmark measures contention, so its numbers mean the most with at least as many cores as threads
+void Bench::RunLinearAllocatorContention()
+{
+	printf("%u frames of %u allocations per thread, %u hardware threads\n",
+		s_Frames, s_AllocationsPerThreadPerFrame, std::thread::hardware_concurrency());
+	printf("  Threads  Atomic ns  Aligned ns  Ring ns  Mutex ns  Aligned mutex ns\n");
+
+	for (UINT threadCount : { 1, 2, 4, 8, 16 })
+	{
+		const UINT64 descriptorsPerFrame = static_cast<UINT64>(threadCount) * s_AllocationsPerThreadPerFrame * 8;
+		const UINT64 bytesPerFrame = static_cast<UINT64>(threadCount) * s_AllocationsPerThreadPerFrame * 768;
+
+		AtomicLinearAllocator atomic(descriptorsPerFrame);
+		const double atomicNs = RunThreads(threadCount,
+			[&](UINT, UINT i) { return atomic.Allocate(DescriptorCount(i)) != AtomicLinearAllocator::InvalidOffset; },
+			[&](UINT) { atomic.Reset(); });
+
+		AtomicLinearAllocator aligned(bytesPerFrame);
+		const double alignedNs = RunThreads(threadCount,
+			[&](UINT, UINT i) { return aligned.Allocate(ConstantBufferSize(i), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT) != AtomicLinearAllocator::InvalidOffset; },
+			[&](UINT) { aligned.Reset(); });
+
+		// Handles in a made up address range, as the ring never dereferences them
+		TransientDescriptorRing ring({ 0x10000 }, { 0x10000 }, 32, static_cast<UINT>(descriptorsPerFrame), s_FrameCount);
+		const double ringNs = RunThreads(threadCount,
+			[&](UINT, UINT i) { return ring.Allocate(DescriptorCount(i)).IsValid(); },
+			[&](UINT frame) { ring.BeginFrame(frame % s_FrameCount); });
+
+		MutexLinearAllocator mutex(descriptorsPerFrame);
+		const double mutexNs = RunThreads(threadCount,
+			[&](UINT, UINT i) { return mutex.Allocate(DescriptorCount(i)) != AtomicLinearAllocator::InvalidOffset; },
+			[&](UINT) { mutex.Reset(); });
+
+		MutexLinearAllocator alignedMutex(bytesPerFrame);
+		const double alignedMutexNs = RunThreads(threadCount,
+			[&](UINT, UINT i) { return alignedMutex.Allocate(ConstantBufferSize(i), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT) != AtomicLinearAllocator::InvalidOffset; },
+			[&](UINT) { alignedMutex.Reset(); });
+
+		printf("  %7u  %9.2f  %10.2f  %7.2f  %8.2f  %16.2f\n", threadCount, atomicNs, alignedNs, ringNs, mutexNs, alignedMutexNs);
+	}
+}
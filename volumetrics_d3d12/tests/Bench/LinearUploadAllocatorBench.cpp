@@ -0,0 +1,53 @@
+#include "pch.h"
+#include "Renderer/Memory/LinearUploadAllocator.h"
+#include "Bench.h"
+
+#include <thread>
+
+
+namespace
+{
+	constexpr UINT s_FrameCount = 2;
+	constexpr UINT s_Frames = 2000;
+
+	// The constant buffers that a frame uploads, all of one size
+	double RunFrames(LinearUploadAllocator& allocator, UINT allocationsPerFrame, UINT64 size, const UINT8* source)
+	{
+		const auto start = Bench::Clock::now();
+		for (UINT f = 0; f < s_Frames; f++)
+		{
+			allocator.BeginFrame(f % s_FrameCount);
+			for (UINT i = 0; i < allocationsPerFrame; i++)
+			{
+				const UploadAllocation allocation = allocator.Allocate(size);
+				memcpy(allocation.CPUAddress, source, size);
+			}
+		}
+		return Bench::MillisecondsSince(start);
+	}
+}
+
+
+// Throughput of allocating and filling per-frame constant data, backed by host memory in place of the mapped upload buffer
+// Host memory is cached, unlike the write-combined upload heap, so the copy costs are a lower bound
+void Bench::RunLinearUploadAllocator()
+{
+	printf("%u frames, host memory standing in for the upload buffer\n", s_Frames);
+	printf("  Size  Allocs/frame  ns/alloc    GB/s\n");
+
+	for (UINT64 size : { 64, 256, 1024, 4096, 16384 })
+	{
+		const UINT allocationsPerFrame = static_cast<UINT>(max(64ull, 4ull * 1024 * 1024 / Align(size, 256ull)));
+		const UINT64 bytesPerFrame = allocationsPerFrame * Align(size, static_cast<UINT64>(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT));
+
+		std::vector<UINT8> backing(bytesPerFrame * s_FrameCount);
+		std::vector<UINT8> source(size, 0xAB);
+		LinearUploadAllocator allocator(backing.data(), 0x10000, bytesPerFrame, s_FrameCount);
+
+		const double milliseconds = RunFrames(allocator, allocationsPerFrame, size, source.data());
+		const double allocations = static_cast<double>(allocationsPerFrame) * s_Frames;
+		const double gigabytesPerSecond = allocations * static_cast<double>(size) / (milliseconds * 1.0e6);
+		printf("  %5llu  %12u  %8.2f  %6.2f\n",
+			static_cast<unsigned long long>(size), allocationsPerFrame, milliseconds * 1.0e6 / allocations, gigabytesPerSecond);
+	}
+}
@@ -0,0 +1,228 @@
+#include "pch.h"
+#include "Renderer/Memory/TLSFTrace.h"
+#include "Bench.h"
+
+#include <filesystem>
+#include <random>
+
+
+namespace
+{
+	// The free-list that DescriptorHeap used before TLSFAllocator, as a baseline
+	// The first block that fits is found with a linear walk, and every free rescans the list to merge neighbours
+	class FirstFitFreeList
+	{
+	public:
+		FirstFitFreeList(UINT capacity)
+		{
+			m_FreeBlocks.insert({ 0, capacity });
+		}
+
+		UINT Allocate(UINT count)
+		{
+			auto freeBlockIt = m_FreeBlocks.begin();
+			for (; freeBlockIt != m_FreeBlocks.end() && freeBlockIt->second < count; ++freeBlockIt) {}
+			if (freeBlockIt == m_FreeBlocks.end())
+				return TLSFAllocator::InvalidIndex;
+
+			const UINT index = freeBlockIt->first;
+			const UINT remaining = freeBlockIt->second - count;
+			m_FreeBlocks.erase(freeBlockIt);
+			if (remaining > 0)
+				m_FreeBlocks.insert({ index + count, remaining });
+
+			return index;
+		}
+
+		void Free(UINT index, UINT count)
+		{
+			m_FreeBlocks.insert({ index, count });
+
+			for (auto it = m_FreeBlocks.begin(); it != m_FreeBlocks.end();)
+			{
+				auto toMerge = m_FreeBlocks.find(it->first + it->second);
+				if (toMerge != m_FreeBlocks.end())
+				{
+					it->second += toMerge->second;
+					m_FreeBlocks.erase(toMerge);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+
+		float GetFragmentation() const
+		{
+			UINT freeCount = 0;
+			UINT largest = 0;
+			for (const auto& [index, size] : m_FreeBlocks)
+			{
+				freeCount += size;
+				largest = max(largest, size);
+			}
+			return freeCount == 0 ? 0.0f : 1.0f - static_cast<float>(largest) / static_cast<float>(freeCount);
+		}
+
+	private:
+		std::map<UINT, UINT> m_FreeBlocks;
+	};
+
+
+	// Used when no trace has been recorded: the mix of sizes and lifetimes of descriptor tables,
+	// which keeps the allocator about three quarters full
+	TLSFTrace GenerateSyntheticTrace(UINT capacity, UINT allocations)
+	{
+		std::mt19937 generator(0x715F);
+		std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+		// Mostly small tables, with a few large ones such as the descriptors of a whole texture array
+		auto RandomCount = [&]()
+			{
+				const float r = distribution(generator);
+				const auto Between = [&](UINT first, UINT last) { return std::uniform_int_distribution<UINT>(first, last)(generator); };
+				if (r < 0.6f)
+					return Between(1, 4);
+				if (r < 0.9f)
+					return Between(5, 16);
+				if (r < 0.98f)
+					return Between(17, 64);
+				return Between(65, 256);
+			};
+
+		TLSFTrace trace;
+		trace.Capacity = capacity;
+		trace.SlotCount = allocations;
+		trace.InitialFreeBlocks = { { 0, capacity } };
+		trace.Operations.reserve(static_cast<size_t>(allocations) * 2);
+
+		// The slots that are allocated at this point in the trace, and the indices that they hold in total
+		std::vector<std::pair<UINT, UINT>> live;
+		UINT liveCount = 0;
+		const UINT targetCount = capacity / 4 * 3;
+
+		for (UINT slot = 0; slot < allocations; slot++)
+		{
+			const UINT count = min(RandomCount(), capacity);
+
+			// Tables with short lifetimes are freed at random, and long lived ones stay until space is needed
+			while (!live.empty() && (liveCount + count > targetCount || distribution(generator) < 0.25f))
+			{
+				const size_t i = std::uniform_int_distribution<size_t>(0, live.size() - 1)(generator);
+				trace.Operations.push_back({ TLSFTrace::OperationType::Free, live[i].first, TLSFAllocator::InvalidIndex, live[i].second });
+				liveCount -= live[i].second;
+				live[i] = live.back();
+				live.pop_back();
+			}
+
+			trace.Operations.push_back({ TLSFTrace::OperationType::Allocate, slot, TLSFAllocator::InvalidIndex, count });
+			live.emplace_back(slot, count);
+			liveCount += count;
+		}
+
+		return trace;
+	}
+
+
+	struct ReplayResult
+	{
+		double Milliseconds = 0.0;
+		UINT64 FailedAllocations = 0;
+		float MeanFragmentation = 0.0f;
+		float MaxFragmentation = 0.0f;
+	};
+
+	// The trace is replayed once to time it, and again to sample the fragmentation without the cost of sampling being timed
+	template <typename Allocator>
+	ReplayResult Replay(const TLSFTrace& trace)
+	{
+		ReplayResult result;
+		std::vector<UINT> slotIndices;
+
+		{
+			Allocator allocator(trace.Capacity);
+			UINT64 failed = 0;
+
+			const auto start = Bench::Clock::now();
+			trace.Replay(allocator, slotIndices, [&](const Allocator&, const TLSFTrace::Operation& operation, UINT index)
+				{
+					failed += operation.Type == TLSFTrace::OperationType::Allocate && index == TLSFAllocator::InvalidIndex;
+				});
+			result.Milliseconds = Bench::MillisecondsSince(start);
+			result.FailedAllocations = failed;
+		}
+
+		Allocator allocator(trace.Capacity);
+		UINT64 samples = 0;
+		double fragmentationSum = 0.0;
+		trace.Replay(allocator, slotIndices, [&](const Allocator& allocator, const TLSFTrace::Operation& operation, UINT)
+			{
+				if (operation.Type == TLSFTrace::OperationType::Allocate)
+					return;
+
+				const float fragmentation = allocator.GetFragmentation();
+				fragmentationSum += fragmentation;
+				result.MaxFragmentation = max(result.MaxFragmentation, fragmentation);
+				samples++;
+			});
+		result.MeanFragmentation = samples > 0 ? static_cast<float>(fragmentationSum / static_cast<double>(samples)) : 0.0f;
+
+		return result;
+	}
+
+	void ReplayTrace(const char* name, const TLSFTrace& trace)
+	{
+		UINT64 allocations = 0;
+		UINT64 frees = 0;
+		for (const TLSFTrace::Operation& operation : trace.Operations)
+		{
+			allocations += operation.Type == TLSFTrace::OperationType::Allocate;
+			frees += operation.Type != TLSFTrace::OperationType::Allocate;
+		}
+
+		printf("%s: %u indices, %zu free blocks at start, %llu allocations, %llu frees\n",
+			name, trace.Capacity, trace.InitialFreeBlocks.size(), static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(frees));
+		printf("             Mallocs/s  Failed  Mean frag  Max frag\n");
+
+		auto Print = [&](const char* allocatorName, const ReplayResult& result)
+			{
+				const double perSecond = static_cast<double>(allocations) * 1000.0 / max(result.Milliseconds, 1e-3);
+				printf("  %-9s  %9.3f  %6llu  %9.3f  %8.3f\n",
+					allocatorName, perSecond * 1.0e-6, static_cast<unsigned long long>(result.FailedAllocations), result.MeanFragmentation, result.MaxFragmentation);
+			};
+
+		Print("TLSF", Replay<TLSFAllocator>(trace));
+		Print("First-fit", Replay<FirstFitFreeList>(trace));
+	}
+}
+
+
+// Replays the traces that the app recorded into cache/descriptor_traces, relative to the working directory
+// or to VOLUMETRICS_TRACE_DIR, or a synthetic trace when there are none
+void Bench::RunTLSFReplay()
+{
+	const char* directoryOverride = getenv("VOLUMETRICS_TRACE_DIR");
+	const std::filesystem::path directory = directoryOverride ? directoryOverride : "cache/descriptor_traces";
+
+	int replayed = 0;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+	{
+		if (entry.path().extension() != ".tlsftrace")
+			continue;
+
+		TLSFTrace trace;
+		if (!trace.Load(entry.path().string()))
+			continue;
+
+		ReplayTrace(entry.path().filename().string().c_str(), trace);
+		replayed++;
+	}
+
+	if (replayed == 0)
+	{
+		printf("No recorded traces in %s, replaying a synthetic trace\n", directory.string().c_str());
+		ReplayTrace("synthetic", GenerateSyntheticTrace(4096, 100000));
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// A camera in a global fog, as VolumetricsReference::RenderFrame consumes it, without lights or scene geometry
+// Shared by the tests of VolumetricsReference
+
+#include "Renderer/Lighting/VolumetricsReference.h"
+
+
+// Places the camera at eye, looking across the fog and a little down
+inline void PlaceFogSceneCamera(VolumetricsReference::FrameInputs& inputs, const XMFLOAT3& eye)
+{
+	constexpr float nearPlane = 0.1f;
+	constexpr float farPlane = 100.0f;
+	constexpr XMUINT2 renderTargetSize = { 64, 32 };
+
+	const XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&eye), XMVector3Normalize(XMVectorSet(0.3f, -0.1f, 1.0f, 0.0f)), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const XMMATRIX projection = XMMatrixPerspectiveFovLH(0.25f * XM_PI, 2.0f, nearPlane, farPlane);
+	inputs.Pass = VolumetricsReference::BuildPassConstants(view, projection, view, projection, eye, renderTargetSize, nearPlane, farPlane, 0);
+}
+
+// The fog is the default of VolumetricRendering, and the camera stands at its edge looking across it,
+// so that the froxels reach from inside the fog, through its smoothed edges, to the empty space beyond
+inline VolumetricsReference::FrameInputs CreateFogScene(const XMUINT3& resolution = { 32, 16, 32 }, UINT depthDistribution = VOLUME_DEPTH_DISTRIBUTION_EXPONENTIAL)
+{
+	VolumetricsReference::FrameInputs inputs;
+	inputs.GlobalFog = {
+		.Albedo = XMFLOAT3(1.5f, 1.5f, 1.5f),
+		.Extinction = 0.25f,
+
+		.MaxHeight = 5.0f,
+		.HeightSmoothing = 3.0f,
+		.Radius = 5.0f,
+		.RadiusSmoothing = 3.0f
+	};
+
+	PlaceFogSceneCamera(inputs, { -3.0f, 2.0f, -6.0f });
+
+	inputs.Lighting.DirectionalLight.Direction = { 0.0f, -0.7f, 0.7f };
+	inputs.Lighting.DirectionalLight.Intensity = 2.0f;
+	inputs.Lighting.DirectionalLight.Color = { 1.0f, 1.0f, 1.0f };
+
+	inputs.Volume.VolumeResolution = resolution;
+	inputs.Volume.MaxVolumeDistance = 20.0f;
+	inputs.Volume.DepthDistribution = depthDistribution;
+	inputs.Volume.HybridLinearDepth = 4.0f;
+	inputs.Volume.HistorySliceCount = resolution.z;
+
+	return inputs;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// A fence that completes some frames behind the CPU, as the direct queue does for DescriptorHeap,
+// generated up front so that it is not part of any timings
+
+#include <random>
+
+
+struct SimulatedFrames
+{
+	// The fence value that the GPU has completed at the start of each frame
+	std::vector<UINT64> CompletedFenceValues;
+	// The fence value that guards each item, itemsPerFrame of them for each frame in turn
+	std::vector<UINT64> ItemFenceValues;
+};
+
+inline SimulatedFrames SimulateFrames(UINT framesInFlight, UINT itemsPerFrame, UINT frames)
+{
+	SimulatedFrames simulated;
+	simulated.CompletedFenceValues.resize(frames);
+	simulated.ItemFenceValues.resize(static_cast<size_t>(frames) * itemsPerFrame);
+
+	std::mt19937 generator(0xFE7CE);
+	std::uniform_int_distribution<UINT> lagDistribution(0, 1);
+
+	// Frame f signals fence value f + 1 once it has been submitted,
+	// and the GPU is up to framesInFlight frames behind, and sometimes one more
+	UINT64 completed = 0;
+	for (UINT f = 0; f < frames; f++)
+	{
+		const UINT64 nextFenceValue = static_cast<UINT64>(f) + 1;
+		const UINT lag = framesInFlight + lagDistribution(generator);
+		if (f + 1 > lag)
+			completed = max(completed, static_cast<UINT64>(f + 1 - lag));
+		simulated.CompletedFenceValues[f] = completed;
+
+		for (UINT i = 0; i < itemsPerFrame; i++)
+		{
+			UINT64 fenceValue = nextFenceValue;
+			// A quarter of the items were last used by a frame that is still in flight
+			if (i % 4 == 3)
+			{
+				std::uniform_int_distribution<UINT64> inFlightDistribution(completed + 1, nextFenceValue);
+				fenceValue = inFlightDistribution(generator);
+			}
+			simulated.ItemFenceValues[static_cast<size_t>(f) * itemsPerFrame + i] = fenceValue;
+		}
+	}
+
+	return simulated;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// A camera, its cluster grid and randomly placed point lights, as LightManager bins them
+// Shared by the ClusteredLightCuller tests and benchmark
+
+#include "HlslCompat/StructureHlslCompat.h"
+
+#include <random>
+
+
+struct SyntheticLightScene
+{
+	// The grid of the default 512x288x128 froxel volume, with a cluster per 32x32x4 froxels and a slice beyond the volume
+	XMUINT3 GridDimensions = { 16, 9, 33 };
+	float NearPlane = 0.1f;
+	float VolumeDepth = 100.0f;
+	float FarPlane = 1000.0f;
+
+	XMMATRIX View;
+	XMMATRIX Projection;
+	std::vector<float> SliceDepths;
+	std::vector<PointLightGPUData> Lights;
+};
+
+// Slices are spaced exponentially up to VolumeDepth, as the froxel slices are, and the last slice reaches the far plane
+// Lights are spread through the volume in front of the camera, with ranges of half a metre to ten metres
+inline SyntheticLightScene CreateSyntheticLightScene(UINT lightCount, UINT seed)
+{
+	SyntheticLightScene scene;
+
+	const XMVECTOR eye = XMVectorSet(20.0f, 3.0f, -10.0f, 1.0f);
+	const XMVECTOR direction = XMVector3Normalize(XMVectorSet(0.4f, -0.1f, 1.0f, 0.0f));
+	scene.View = XMMatrixLookToLH(eye, direction, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	scene.Projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.0f), 16.0f / 9.0f, scene.NearPlane, scene.FarPlane);
+
+	const UINT volumeSlices = scene.GridDimensions.z - 1;
+	scene.SliceDepths.resize(scene.GridDimensions.z + 1);
+	for (UINT i = 0; i <= volumeSlices; i++)
+	{
+		const float t = static_cast<float>(i) / static_cast<float>(volumeSlices);
+		scene.SliceDepths[i] = scene.NearPlane * powf(scene.VolumeDepth / scene.NearPlane, t);
+	}
+	scene.SliceDepths[scene.GridDimensions.z] = scene.FarPlane;
+
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> unitDistribution(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> depthDistribution(0.0f, 1.0f);
+	std::uniform_real_distribution<float> rangeDistribution(0.5f, 10.0f);
+
+	// Placed by view-space depth and a position across the view that reaches a little beyond its sides
+	const XMMATRIX invView = XMMatrixInverse(nullptr, scene.View);
+	const float tanHalfFovY = tanf(XMConvertToRadians(30.0f));
+	scene.Lights.resize(lightCount);
+	for (PointLightGPUData& light : scene.Lights)
+	{
+		const float depth = scene.VolumeDepth * 1.2f * depthDistribution(generator) * depthDistribution(generator);
+		const float halfHeight = depth * tanHalfFovY + 2.0f;
+		const XMVECTOR positionVS = XMVectorSet(
+			unitDistribution(generator) * halfHeight * 16.0f / 9.0f,
+			unitDistribution(generator) * halfHeight,
+			depth - 2.0f,
+			1.0f);
+
+		XMStoreFloat3(&light.Position, XMVector3TransformCoord(positionVS, invView));
+		light.Range = rangeDistribution(generator);
+		light.Color = { 1.0f, 1.0f, 1.0f };
+		light.Intensity = 1.0f;
+	}
+
+	return scene;
+}
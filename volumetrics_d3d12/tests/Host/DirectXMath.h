@@ -0,0 +1,383 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <xmmintrin.h>
+
+
+/**
+ *	The part of DirectXMath that the CPU modules use, for building them on hosts without the Windows SDK.
+ *
+ *	XMVECTOR is an __m128 as it is in DirectXMath on x64, so vector arithmetic uses the compiler's built-in
+ *	vector operators rather than DirectXMath's overloads. Matrices are row-major with row vectors, and the
+ *	projection and view matrices follow the left-handed conventions of the originals.
+ *	Results may differ from DirectXMath in the last bits, so tests compare with tolerances.
+ */
+namespace DirectX
+{
+	constexpr float XM_PI = 3.141592654f;
+	constexpr float XM_2PI = 6.283185307f;
+	constexpr float XM_1DIVPI = 0.318309886f;
+	constexpr float XM_1DIV2PI = 0.159154943f;
+	constexpr float XM_PIDIV2 = 1.570796327f;
+	constexpr float XM_PIDIV4 = 0.785398163f;
+
+	constexpr float XMConvertToRadians(float degrees) { return degrees * (XM_PI / 180.0f); }
+	constexpr float XMConvertToDegrees(float radians) { return radians * (180.0f / XM_PI); }
+
+
+	using XMVECTOR = __m128;
+	using FXMVECTOR = const XMVECTOR;
+	using GXMVECTOR = const XMVECTOR;
+	using HXMVECTOR = const XMVECTOR&;
+	using CXMVECTOR = const XMVECTOR&;
+
+	struct alignas(16) XMMATRIX
+	{
+		XMVECTOR r[4];
+
+		XMMATRIX() = default;
+		constexpr XMMATRIX(FXMVECTOR r0, FXMVECTOR r1, FXMVECTOR r2, CXMVECTOR r3) : r{ r0, r1, r2, r3 } {}
+		XMMATRIX(float m00, float m01, float m02, float m03,
+				 float m10, float m11, float m12, float m13,
+				 float m20, float m21, float m22, float m23,
+				 float m30, float m31, float m32, float m33)
+			: r{ { m00, m01, m02, m03 }, { m10, m11, m12, m13 }, { m20, m21, m22, m23 }, { m30, m31, m32, m33 } }
+		{}
+
+		XMMATRIX operator*(const XMMATRIX& m) const;
+		XMMATRIX& operator*=(const XMMATRIX& m) { *this = *this * m; return *this; }
+	};
+	using FXMMATRIX = const XMMATRIX&;
+	using CXMMATRIX = const XMMATRIX&;
+
+
+	struct XMFLOAT2
+	{
+		float x, y;
+		XMFLOAT2() = default;
+		constexpr XMFLOAT2(float x, float y) : x(x), y(y) {}
+	};
+
+	struct XMFLOAT3
+	{
+		float x, y, z;
+		XMFLOAT3() = default;
+		constexpr XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+		XMFLOAT4() = default;
+		constexpr XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMINT2 { int32_t x, y; };
+	struct XMINT3 { int32_t x, y, z; };
+	struct XMINT4 { int32_t x, y, z, w; };
+	struct XMUINT2 { uint32_t x, y; };
+	struct XMUINT3 { uint32_t x, y, z; };
+	struct XMUINT4 { uint32_t x, y, z, w; };
+
+	struct XMFLOAT4X4
+	{
+		union
+		{
+			struct
+			{
+				float _11, _12, _13, _14;
+				float _21, _22, _23, _24;
+				float _31, _32, _33, _34;
+				float _41, _42, _43, _44;
+			};
+			float m[4][4];
+		};
+
+		XMFLOAT4X4() = default;
+		float operator()(size_t row, size_t column) const { return m[row][column]; }
+		float& operator()(size_t row, size_t column) { return m[row][column]; }
+	};
+
+
+	// Vectors
+
+	inline XMVECTOR XMVectorSet(float x, float y, float z, float w) { return XMVECTOR{ x, y, z, w }; }
+	inline XMVECTOR XMVectorZero() { return XMVECTOR{ 0.0f, 0.0f, 0.0f, 0.0f }; }
+	inline XMVECTOR XMVectorReplicate(float value) { return XMVECTOR{ value, value, value, value }; }
+
+	inline float XMVectorGetX(FXMVECTOR v) { return v[0]; }
+	inline float XMVectorGetY(FXMVECTOR v) { return v[1]; }
+	inline float XMVectorGetZ(FXMVECTOR v) { return v[2]; }
+	inline float XMVectorGetW(FXMVECTOR v) { return v[3]; }
+	inline XMVECTOR XMVectorSetX(XMVECTOR v, float x) { v[0] = x; return v; }
+	inline XMVECTOR XMVectorSetY(XMVECTOR v, float y) { v[1] = y; return v; }
+	inline XMVECTOR XMVectorSetZ(XMVECTOR v, float z) { v[2] = z; return v; }
+	inline XMVECTOR XMVectorSetW(XMVECTOR v, float w) { v[3] = w; return v; }
+
+	inline XMVECTOR XMVectorSplatX(FXMVECTOR v) { return XMVectorReplicate(v[0]); }
+	inline XMVECTOR XMVectorSplatY(FXMVECTOR v) { return XMVectorReplicate(v[1]); }
+	inline XMVECTOR XMVectorSplatZ(FXMVECTOR v) { return XMVectorReplicate(v[2]); }
+	inline XMVECTOR XMVectorSplatW(FXMVECTOR v) { return XMVectorReplicate(v[3]); }
+
+	inline XMVECTOR XMVectorAdd(FXMVECTOR a, FXMVECTOR b) { return a + b; }
+	inline XMVECTOR XMVectorSubtract(FXMVECTOR a, FXMVECTOR b) { return a - b; }
+	inline XMVECTOR XMVectorMultiply(FXMVECTOR a, FXMVECTOR b) { return a * b; }
+	inline XMVECTOR XMVectorDivide(FXMVECTOR a, FXMVECTOR b) { return a / b; }
+	inline XMVECTOR XMVectorMultiplyAdd(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c) { return a * b + c; }
+	inline XMVECTOR XMVectorScale(FXMVECTOR v, float scale) { return v * XMVectorReplicate(scale); }
+	inline XMVECTOR XMVectorNegate(FXMVECTOR v) { return -v; }
+	inline XMVECTOR XMVectorAbs(FXMVECTOR v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+	inline XMVECTOR XMVectorMin(FXMVECTOR a, FXMVECTOR b) { return _mm_min_ps(a, b); }
+	inline XMVECTOR XMVectorMax(FXMVECTOR a, FXMVECTOR b) { return _mm_max_ps(a, b); }
+	inline XMVECTOR XMVectorLerp(FXMVECTOR a, FXMVECTOR b, float t) { return a + (b - a) * XMVectorReplicate(t); }
+	inline XMVECTOR XMVectorFloor(FXMVECTOR v) { return XMVECTOR{ floorf(v[0]), floorf(v[1]), floorf(v[2]), floorf(v[3]) }; }
+	inline XMVECTOR XMVectorRound(FXMVECTOR v) { return XMVECTOR{ nearbyintf(v[0]), nearbyintf(v[1]), nearbyintf(v[2]), nearbyintf(v[3]) }; }
+
+	inline XMVECTOR XMVector3Dot(FXMVECTOR a, FXMVECTOR b) { return XMVectorReplicate(a[0] * b[0] + a[1] * b[1] + a[2] * b[2]); }
+	inline XMVECTOR XMVector4Dot(FXMVECTOR a, FXMVECTOR b) { return XMVectorReplicate(a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]); }
+	inline XMVECTOR XMVector3LengthSq(FXMVECTOR v) { return XMVector3Dot(v, v); }
+	inline XMVECTOR XMVector3Length(FXMVECTOR v) { return XMVectorReplicate(sqrtf(XMVectorGetX(XMVector3Dot(v, v)))); }
+
+	inline XMVECTOR XMVector3Cross(FXMVECTOR a, FXMVECTOR b)
+	{
+		return XMVECTOR{ a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0], 0.0f };
+	}
+
+	// As in DirectXMath, every component is divided by the length of xyz, and a zero vector stays zero
+	inline XMVECTOR XMVector3Normalize(FXMVECTOR v)
+	{
+		const float length = XMVectorGetX(XMVector3Length(v));
+		return length > 0.0f ? v / XMVectorReplicate(length) : XMVectorZero();
+	}
+
+	inline XMVECTOR XMPlaneNormalize(FXMVECTOR plane)
+	{
+		const float length = XMVectorGetX(XMVector3Length(plane));
+		return length > 0.0f ? plane / XMVectorReplicate(length) : XMVectorZero();
+	}
+
+
+	// Loads and stores
+
+	inline XMVECTOR XMLoadFloat2(const XMFLOAT2* source) { return XMVECTOR{ source->x, source->y, 0.0f, 0.0f }; }
+	inline XMVECTOR XMLoadFloat3(const XMFLOAT3* source) { return XMVECTOR{ source->x, source->y, source->z, 0.0f }; }
+	inline XMVECTOR XMLoadFloat4(const XMFLOAT4* source) { return XMVECTOR{ source->x, source->y, source->z, source->w }; }
+	inline void XMStoreFloat2(XMFLOAT2* destination, FXMVECTOR v) { *destination = { v[0], v[1] }; }
+	inline void XMStoreFloat3(XMFLOAT3* destination, FXMVECTOR v) { *destination = { v[0], v[1], v[2] }; }
+	inline void XMStoreFloat4(XMFLOAT4* destination, FXMVECTOR v) { *destination = { v[0], v[1], v[2], v[3] }; }
+
+	inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* source)
+	{
+		XMMATRIX m;
+		for (int i = 0; i < 4; i++)
+			m.r[i] = XMVECTOR{ source->m[i][0], source->m[i][1], source->m[i][2], source->m[i][3] };
+		return m;
+	}
+
+	inline void XMStoreFloat4x4(XMFLOAT4X4* destination, FXMMATRIX m)
+	{
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				destination->m[i][j] = m.r[i][j];
+	}
+
+
+	// Transforms, with v as a row vector
+
+	inline XMVECTOR XMVector4Transform(FXMVECTOR v, FXMMATRIX m)
+	{
+		return XMVectorSplatX(v) * m.r[0] + XMVectorSplatY(v) * m.r[1] + XMVectorSplatZ(v) * m.r[2] + XMVectorSplatW(v) * m.r[3];
+	}
+
+	inline XMVECTOR XMVector3Transform(FXMVECTOR v, FXMMATRIX m)
+	{
+		return XMVectorSplatX(v) * m.r[0] + XMVectorSplatY(v) * m.r[1] + XMVectorSplatZ(v) * m.r[2] + m.r[3];
+	}
+
+	inline XMVECTOR XMVector3TransformCoord(FXMVECTOR v, FXMMATRIX m)
+	{
+		const XMVECTOR result = XMVector3Transform(v, m);
+		return result / XMVectorSplatW(result);
+	}
+
+	inline XMVECTOR XMVector3TransformNormal(FXMVECTOR v, FXMMATRIX m)
+	{
+		return XMVectorSplatX(v) * m.r[0] + XMVectorSplatY(v) * m.r[1] + XMVectorSplatZ(v) * m.r[2];
+	}
+
+
+	// Matrices
+
+	inline XMMATRIX XMMatrixIdentity()
+	{
+		return XMMATRIX(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixMultiply(FXMMATRIX a, CXMMATRIX b)
+	{
+		return XMMATRIX(XMVector4Transform(a.r[0], b), XMVector4Transform(a.r[1], b), XMVector4Transform(a.r[2], b), XMVector4Transform(a.r[3], b));
+	}
+
+	inline XMMATRIX XMMATRIX::operator*(const XMMATRIX& m) const { return XMMatrixMultiply(*this, m); }
+
+	inline XMMATRIX XMMatrixTranspose(FXMMATRIX m)
+	{
+		return XMMATRIX(
+			m.r[0][0], m.r[1][0], m.r[2][0], m.r[3][0],
+			m.r[0][1], m.r[1][1], m.r[2][1], m.r[3][1],
+			m.r[0][2], m.r[1][2], m.r[2][2], m.r[3][2],
+			m.r[0][3], m.r[1][3], m.r[2][3], m.r[3][3]);
+	}
+
+	inline XMMATRIX XMMatrixInverse(XMVECTOR* determinant, FXMMATRIX m)
+	{
+		float a[16];
+		for (int i = 0; i < 16; i++)
+			a[i] = m.r[i / 4][i % 4];
+
+		// Cofactor expansion, in double so that the inverse of a well conditioned matrix is accurate to float precision
+		double inv[16];
+		inv[0] = (double)a[5] * a[10] * a[15] - (double)a[5] * a[11] * a[14] - (double)a[9] * a[6] * a[15] + (double)a[9] * a[7] * a[14] + (double)a[13] * a[6] * a[11] - (double)a[13] * a[7] * a[10];
+		inv[4] = -(double)a[4] * a[10] * a[15] + (double)a[4] * a[11] * a[14] + (double)a[8] * a[6] * a[15] - (double)a[8] * a[7] * a[14] - (double)a[12] * a[6] * a[11] + (double)a[12] * a[7] * a[10];
+		inv[8] = (double)a[4] * a[9] * a[15] - (double)a[4] * a[11] * a[13] - (double)a[8] * a[5] * a[15] + (double)a[8] * a[7] * a[13] + (double)a[12] * a[5] * a[11] - (double)a[12] * a[7] * a[9];
+		inv[12] = -(double)a[4] * a[9] * a[14] + (double)a[4] * a[10] * a[13] + (double)a[8] * a[5] * a[14] - (double)a[8] * a[6] * a[13] - (double)a[12] * a[5] * a[10] + (double)a[12] * a[6] * a[9];
+		inv[1] = -(double)a[1] * a[10] * a[15] + (double)a[1] * a[11] * a[14] + (double)a[9] * a[2] * a[15] - (double)a[9] * a[3] * a[14] - (double)a[13] * a[2] * a[11] + (double)a[13] * a[3] * a[10];
+		inv[5] = (double)a[0] * a[10] * a[15] - (double)a[0] * a[11] * a[14] - (double)a[8] * a[2] * a[15] + (double)a[8] * a[3] * a[14] + (double)a[12] * a[2] * a[11] - (double)a[12] * a[3] * a[10];
+		inv[9] = -(double)a[0] * a[9] * a[15] + (double)a[0] * a[11] * a[13] + (double)a[8] * a[1] * a[15] - (double)a[8] * a[3] * a[13] - (double)a[12] * a[1] * a[11] + (double)a[12] * a[3] * a[9];
+		inv[13] = (double)a[0] * a[9] * a[14] - (double)a[0] * a[10] * a[13] - (double)a[8] * a[1] * a[14] + (double)a[8] * a[2] * a[13] + (double)a[12] * a[1] * a[10] - (double)a[12] * a[2] * a[9];
+		inv[2] = (double)a[1] * a[6] * a[15] - (double)a[1] * a[7] * a[14] - (double)a[5] * a[2] * a[15] + (double)a[5] * a[3] * a[14] + (double)a[13] * a[2] * a[7] - (double)a[13] * a[3] * a[6];
+		inv[6] = -(double)a[0] * a[6] * a[15] + (double)a[0] * a[7] * a[14] + (double)a[4] * a[2] * a[15] - (double)a[4] * a[3] * a[14] - (double)a[12] * a[2] * a[7] + (double)a[12] * a[3] * a[6];
+		inv[10] = (double)a[0] * a[5] * a[15] - (double)a[0] * a[7] * a[13] - (double)a[4] * a[1] * a[15] + (double)a[4] * a[3] * a[13] + (double)a[12] * a[1] * a[7] - (double)a[12] * a[3] * a[5];
+		inv[14] = -(double)a[0] * a[5] * a[14] + (double)a[0] * a[6] * a[13] + (double)a[4] * a[1] * a[14] - (double)a[4] * a[2] * a[13] - (double)a[12] * a[1] * a[6] + (double)a[12] * a[2] * a[5];
+		inv[3] = -(double)a[1] * a[6] * a[11] + (double)a[1] * a[7] * a[10] + (double)a[5] * a[2] * a[11] - (double)a[5] * a[3] * a[10] - (double)a[9] * a[2] * a[7] + (double)a[9] * a[3] * a[6];
+		inv[7] = (double)a[0] * a[6] * a[11] - (double)a[0] * a[7] * a[10] - (double)a[4] * a[2] * a[11] + (double)a[4] * a[3] * a[10] + (double)a[8] * a[2] * a[7] - (double)a[8] * a[3] * a[6];
+		inv[11] = -(double)a[0] * a[5] * a[11] + (double)a[0] * a[7] * a[9] + (double)a[4] * a[1] * a[11] - (double)a[4] * a[3] * a[9] - (double)a[8] * a[1] * a[7] + (double)a[8] * a[3] * a[5];
+		inv[15] = (double)a[0] * a[5] * a[10] - (double)a[0] * a[6] * a[9] - (double)a[4] * a[1] * a[10] + (double)a[4] * a[2] * a[9] + (double)a[8] * a[1] * a[6] - (double)a[8] * a[2] * a[5];
+
+		const double det = a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12];
+		if (determinant)
+			*determinant = XMVectorReplicate(static_cast<float>(det));
+
+		const double invDet = 1.0 / det;
+		XMMATRIX result;
+		for (int i = 0; i < 16; i++)
+			result.r[i / 4][i % 4] = static_cast<float>(inv[i] * invDet);
+		return result;
+	}
+
+	inline XMMATRIX XMMatrixTranslation(float x, float y, float z)
+	{
+		return XMMATRIX(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			x, y, z, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixScaling(float x, float y, float z)
+	{
+		return XMMATRIX(
+			x, 0.0f, 0.0f, 0.0f,
+			0.0f, y, 0.0f, 0.0f,
+			0.0f, 0.0f, z, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixRotationX(float angle)
+	{
+		const float s = sinf(angle), c = cosf(angle);
+		return XMMATRIX(
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, c, s, 0.0f,
+			0.0f, -s, c, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixRotationY(float angle)
+	{
+		const float s = sinf(angle), c = cosf(angle);
+		return XMMATRIX(
+			c, 0.0f, -s, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			s, 0.0f, c, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixRotationZ(float angle)
+	{
+		const float s = sinf(angle), c = cosf(angle);
+		return XMMATRIX(
+			c, s, 0.0f, 0.0f,
+			-s, c, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	// Roll about z, then pitch about x, then yaw about y
+	inline XMMATRIX XMMatrixRotationRollPitchYaw(float pitch, float yaw, float roll)
+	{
+		return XMMatrixMultiply(XMMatrixMultiply(XMMatrixRotationZ(roll), XMMatrixRotationX(pitch)), XMMatrixRotationY(yaw));
+	}
+
+	inline XMMATRIX XMMatrixLookToLH(FXMVECTOR eyePosition, FXMVECTOR eyeDirection, FXMVECTOR upDirection)
+	{
+		const XMVECTOR r2 = XMVector3Normalize(eyeDirection);
+		const XMVECTOR r0 = XMVector3Normalize(XMVector3Cross(upDirection, r2));
+		const XMVECTOR r1 = XMVector3Cross(r2, r0);
+		const XMVECTOR negativeEye = -eyePosition;
+
+		return XMMATRIX(
+			r0[0], r1[0], r2[0], 0.0f,
+			r0[1], r1[1], r2[1], 0.0f,
+			r0[2], r1[2], r2[2], 0.0f,
+			XMVectorGetX(XMVector3Dot(r0, negativeEye)), XMVectorGetX(XMVector3Dot(r1, negativeEye)), XMVectorGetX(XMVector3Dot(r2, negativeEye)), 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixLookAtLH(FXMVECTOR eyePosition, FXMVECTOR focusPosition, FXMVECTOR upDirection)
+	{
+		return XMMatrixLookToLH(eyePosition, focusPosition - eyePosition, upDirection);
+	}
+
+	inline XMMATRIX XMMatrixPerspectiveFovLH(float fovAngleY, float aspectRatio, float nearZ, float farZ)
+	{
+		const float height = cosf(0.5f * fovAngleY) / sinf(0.5f * fovAngleY);
+		const float width = height / aspectRatio;
+		const float range = farZ / (farZ - nearZ);
+
+		return XMMATRIX(
+			width, 0.0f, 0.0f, 0.0f,
+			0.0f, height, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -range * nearZ, 0.0f);
+	}
+
+	inline XMMATRIX XMMatrixOrthographicLH(float viewWidth, float viewHeight, float nearZ, float farZ)
+	{
+		const float range = 1.0f / (farZ - nearZ);
+
+		return XMMATRIX(
+			2.0f / viewWidth, 0.0f, 0.0f, 0.0f,
+			0.0f, 2.0f / viewHeight, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 0.0f,
+			0.0f, 0.0f, -range * nearZ, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixOrthographicOffCenterLH(float viewLeft, float viewRight, float viewBottom, float viewTop, float nearZ, float farZ)
+	{
+		const float reciprocalWidth = 1.0f / (viewRight - viewLeft);
+		const float reciprocalHeight = 1.0f / (viewTop - viewBottom);
+		const float range = 1.0f / (farZ - nearZ);
+
+		return XMMATRIX(
+			reciprocalWidth + reciprocalWidth, 0.0f, 0.0f, 0.0f,
+			0.0f, reciprocalHeight + reciprocalHeight, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 0.0f,
+			-(viewLeft + viewRight) * reciprocalWidth, -(viewTop + viewBottom) * reciprocalHeight, -range * nearZ, 1.0f);
+	}
+}
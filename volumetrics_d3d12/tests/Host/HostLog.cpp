@@ -0,0 +1,21 @@
+#include "pch.h"
+#include "Framework/Log.h"
+
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+// Framework/Log.cpp sets Windows console colours, so the host build has its own Init
+
+
+std::shared_ptr<spdlog::logger> Log::s_AppLogger;
+std::shared_ptr<spdlog::logger> Log::s_D3DLogger;
+
+void Log::Init()
+{
+	spdlog::set_pattern("%^[%T] %n: %v%$");
+
+	s_AppLogger = spdlog::stdout_color_mt("App");
+	s_AppLogger->set_level(spdlog::level::info);
+
+	s_D3DLogger = spdlog::stdout_color_mt("D3D");
+	s_D3DLogger->set_level(spdlog::level::trace);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+// The Win32 types, macros and functions that the CPU modules use, implemented with the C++ and POSIX libraries
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+typedef uint8_t		BYTE;
+typedef uint8_t		UINT8;
+typedef uint16_t	UINT16;
+typedef uint32_t	UINT32;
+typedef uint64_t	UINT64;
+typedef int8_t		INT8;
+typedef int16_t		INT16;
+typedef int32_t		INT32;
+typedef int64_t		INT64;
+typedef int			INT;
+typedef unsigned int UINT;
+typedef int			BOOL;
+typedef float		FLOAT;
+typedef uint16_t	WORD;
+typedef uint32_t	DWORD;
+typedef long long	LONGLONG;
+typedef size_t		SIZE_T;
+typedef const wchar_t* LPCWSTR;
+typedef wchar_t*	LPWSTR;
+
+typedef int32_t		HRESULT;
+#define S_OK			((HRESULT)0)
+#define E_FAIL			((HRESULT)0x80004005L)
+#define SUCCEEDED(hr)	(((HRESULT)(hr)) >= 0)
+#define FAILED(hr)		(((HRESULT)(hr)) < 0)
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+// windows.h defines these as macros, and the engine relies on them; libstdc++ uses the names itself, so
+// the host build has functions with the same mixed-type conversions as the macros
+template <typename A, typename B>
+constexpr std::common_type_t<A, B> max(A a, B b) { return a > b ? a : b; }
+template <typename A, typename B>
+constexpr std::common_type_t<A, B> min(A a, B b) { return a < b ? a : b; }
+
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+// A failed ASSERT has already logged its message, so stop here rather than carry on with broken state
+inline void DebugBreak()
+{
+	std::fflush(nullptr);
+	std::abort();
+}
+
+
+// Read-only file mapping, as SparseFogVolume uses it
+
+typedef void* HANDLE;
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+
+union LARGE_INTEGER
+{
+	LONGLONG QuadPart;
+};
+
+#define GENERIC_READ				0x80000000
+#define FILE_SHARE_READ				0x00000001
+#define OPEN_EXISTING				3
+#define FILE_FLAG_RANDOM_ACCESS		0x10000000
+#define PAGE_READONLY				0x02
+#define FILE_MAP_READ				0x0004
+
+namespace Host
+{
+	// Handles are file descriptors offset by one, so that descriptor 0 is not mistaken for a null handle
+	inline HANDLE HandleFromDescriptor(int descriptor) { return descriptor < 0 ? INVALID_HANDLE_VALUE : reinterpret_cast<HANDLE>(static_cast<intptr_t>(descriptor) + 1); }
+	inline int DescriptorFromHandle(HANDLE handle) { return static_cast<int>(reinterpret_cast<intptr_t>(handle) - 1); }
+
+	// Views remember their size so that they can be unmapped, in a header before the view
+	struct MappedView
+	{
+		void* Base;
+		size_t Size;
+	};
+}
+
+inline HANDLE CreateFileW(const char* path, DWORD, DWORD, void*, DWORD, DWORD, void*)
+{
+	return Host::HandleFromDescriptor(open(path, O_RDONLY));
+}
+
+inline BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size)
+{
+	struct stat status;
+	if (fstat(Host::DescriptorFromHandle(file), &status) != 0)
+		return FALSE;
+	size->QuadPart = status.st_size;
+	return TRUE;
+}
+
+inline HANDLE CreateFileMappingW(HANDLE file, void*, DWORD, DWORD, DWORD, const void*)
+{
+	return Host::HandleFromDescriptor(dup(Host::DescriptorFromHandle(file)));
+}
+
+inline BOOL CloseHandle(HANDLE handle)
+{
+	return close(Host::DescriptorFromHandle(handle)) == 0;
+}
+
+inline void* MapViewOfFile(HANDLE mapping, DWORD, DWORD, DWORD, SIZE_T)
+{
+	const int descriptor = Host::DescriptorFromHandle(mapping);
+	struct stat status;
+	if (fstat(descriptor, &status) != 0)
+		return nullptr;
+
+	// The file is mapped after a page that holds the size, so that UnmapViewOfFile can find it
+	const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const size_t size = pageSize + static_cast<size_t>(status.st_size);
+	void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		return nullptr;
+
+	UINT8* view = static_cast<UINT8*>(base) + pageSize;
+	if (status.st_size > 0 && mmap(view, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE | MAP_FIXED, descriptor, 0) == MAP_FAILED)
+	{
+		munmap(base, size);
+		return nullptr;
+	}
+
+	*static_cast<Host::MappedView*>(base) = { base, size };
+	return view;
+}
+
+inline BOOL UnmapViewOfFile(const void* view)
+{
+	const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const Host::MappedView* header = reinterpret_cast<const Host::MappedView*>(static_cast<const UINT8*>(view) - pageSize);
+	return munmap(header->Base, header->Size) == 0;
+}
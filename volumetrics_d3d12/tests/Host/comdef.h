@@ -0,0 +1,17 @@
+#pragma once
+
+// Framework/Exception.h formats HRESULTs with _com_error
+
+#include "HostWindows.h"
+
+
+class _com_error
+{
+public:
+	explicit _com_error(HRESULT hr) : m_Result(hr) {}
+
+	const wchar_t* ErrorMessage() const { return m_Result == S_OK ? L"The operation completed successfully." : L"Unspecified error"; }
+
+private:
+	HRESULT m_Result;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+// The MSVC intrinsics that the CPU modules use for feature detection
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+// cpuid.h has a macro of the same name with a different signature
+#undef __cpuid
+
+
+inline void __cpuid(int info[4], int function)
+{
+	__cpuid_count(function, 0, info[0], info[1], info[2], info[3]);
+}
@@ -0,0 +1,17 @@
+// Stands in for src/pch.h when the CPU modules are built on a host without the Windows SDK.
+// The host include directory is searched before src, so every "pch.h" include in the engine resolves here.
+
+#pragma once
+
+#include "HostWindows.h"
+#include "HostD3D12.h"
+
+#include "DirectXMath.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <array>
+#include <queue>
+#include <deque>
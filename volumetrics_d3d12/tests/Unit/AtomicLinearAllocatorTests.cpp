@@ -0,0 +1,75 @@
+#include "pch.h"
+#include "Renderer/Memory/AtomicLinearAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+
+
+TEST(AtomicLinearAllocator, AlignsAndFailsPastCapacity)
+{
+	AtomicLinearAllocator allocator(1024);
+	EXPECT_EQ(allocator.Allocate(10), 0u);
+	EXPECT_EQ(allocator.Allocate(100, 256), 256u);
+	EXPECT_EQ(allocator.Allocate(512, 512), 512u);
+	EXPECT_EQ(allocator.Allocate(1, 256), AtomicLinearAllocator::InvalidOffset);
+	EXPECT_EQ(allocator.GetUsed(), 1024u);
+
+	// A failed unaligned allocation pushes the offset past the end, and GetUsed must still be clamped
+	EXPECT_EQ(allocator.Allocate(1), AtomicLinearAllocator::InvalidOffset);
+	EXPECT_EQ(allocator.GetUsed(), 1024u);
+
+	allocator.Reset();
+	EXPECT_EQ(allocator.GetUsed(), 0u);
+	EXPECT_EQ(allocator.GetHighWaterMark(), 1024u);
+	EXPECT_EQ(allocator.Allocate(16, 16), 0u);
+}
+
+// Ranges handed out to concurrent threads must never overlap, and together must fill the capacity
+TEST(AtomicLinearAllocator, ConcurrentAllocationsAreDisjoint)
+{
+	constexpr UINT threadCount = 8;
+	constexpr UINT allocationsPerThread = 5000;
+	constexpr UINT64 capacity = 64 * 1024;
+
+	for (UINT64 alignment : { 1ull, 16ull })
+	{
+		AtomicLinearAllocator allocator(capacity);
+		std::vector<std::vector<std::pair<UINT64, UINT64>>> ranges(threadCount);
+
+		std::vector<std::thread> threads;
+		for (UINT t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([&, t]()
+				{
+					for (UINT i = 0; i < allocationsPerThread; i++)
+					{
+						const UINT64 size = 1 + (i + t) % 13;
+						const UINT64 offset = allocator.Allocate(size, alignment);
+						if (offset != AtomicLinearAllocator::InvalidOffset)
+							ranges[t].emplace_back(offset, size);
+					}
+				});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+
+		std::vector<std::pair<UINT64, UINT64>> all;
+		for (const auto& threadRanges : ranges)
+			all.insert(all.end(), threadRanges.begin(), threadRanges.end());
+		std::sort(all.begin(), all.end());
+
+		ASSERT_FALSE(all.empty());
+		for (size_t i = 0; i < all.size(); i++)
+		{
+			EXPECT_EQ(all[i].first % alignment, 0u);
+			EXPECT_LE(all[i].first + all[i].second, capacity);
+			if (i > 0)
+				EXPECT_GE(all[i].first, all[i - 1].first + all[i - 1].second) << "Overlapping ranges at " << all[i].first;
+		}
+
+		// More was asked for than fits, so the allocator must have been filled up to the last size that fit
+		EXPECT_GT(all.back().first + all.back().second + 13 + alignment, capacity);
+	}
+}
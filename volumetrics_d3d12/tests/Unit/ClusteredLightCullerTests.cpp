@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "Renderer/Lighting/ClusteredLightCuller.h"
+#include "Framework/ThreadPool.h"
+#include "Common/SyntheticLights.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+
+namespace
+{
+	void SetScene(ClusteredLightCuller& culler, const SyntheticLightScene& scene)
+	{
+		culler.SetClusterGrid(scene.GridDimensions, scene.SliceDepths.data(), scene.Projection);
+		culler.SetLights(scene.Lights.data(), static_cast<UINT>(scene.Lights.size()), scene.View);
+	}
+
+	bool ClusterHasLight(const ClusteredLightCuller& culler, UINT cluster, UINT light)
+	{
+		const XMUINT2 range = culler.GetClusterLightRanges().at(cluster);
+		const auto first = culler.GetLightIndices().begin() + range.x;
+		return std::binary_search(first, first + range.y, light);
+	}
+}
+
+
+// The hierarchical binning must give exactly the lists of testing every light against every cluster
+TEST(ClusteredLightCuller, MatchesPerClusterReference)
+{
+	ThreadPool threadPool(3);
+
+	for (UINT lightCount : { 0u, 1u, 3u, 4u, 5u, 257u, 2000u })
+	{
+		const SyntheticLightScene scene = CreateSyntheticLightScene(lightCount, lightCount + 1);
+		ClusteredLightCuller culler;
+		SetScene(culler, scene);
+		culler.BinLights(threadPool);
+
+		std::vector<XMUINT2> referenceRanges;
+		std::vector<UINT> referenceIndices;
+		culler.BinLightsReference(referenceRanges, referenceIndices);
+
+		ASSERT_EQ(culler.GetClusterLightRanges().size(), referenceRanges.size());
+		for (UINT cluster = 0; cluster < culler.GetClusterCount(); cluster++)
+		{
+			const XMUINT2 range = culler.GetClusterLightRanges()[cluster];
+			const XMUINT2 referenceRange = referenceRanges[cluster];
+			ASSERT_EQ(range.y, referenceRange.y) << "cluster " << cluster << " of " << lightCount << " lights";
+			EXPECT_TRUE(std::equal(
+				culler.GetLightIndices().begin() + range.x, culler.GetLightIndices().begin() + range.x + range.y,
+				referenceIndices.begin() + referenceRange.x)) << "cluster " << cluster;
+		}
+		EXPECT_EQ(culler.GetLightIndices().size(), referenceIndices.size());
+
+		if (lightCount >= 257)
+			EXPECT_GT(referenceIndices.size(), lightCount) << "Lights should reach more than one cluster";
+	}
+}
+
+// Independently of the cluster bounds: every light that reaches a point in the view must be listed in the cluster that the point lies in
+TEST(ClusteredLightCuller, ListsEveryLightReachingTheCluster)
+{
+	const SyntheticLightScene scene = CreateSyntheticLightScene(500, 0xC1);
+	ClusteredLightCuller culler;
+	SetScene(culler, scene);
+	ThreadPool threadPool(0);
+	culler.BinLights(threadPool);
+
+	const XMMATRIX invProjection = XMMatrixInverse(nullptr, scene.Projection);
+	const XMMATRIX invView = XMMatrixInverse(nullptr, scene.View);
+	const XMUINT3 grid = scene.GridDimensions;
+
+	std::mt19937 generator(0xC2);
+	std::uniform_real_distribution<float> unitDistribution(0.0f, 1.0f);
+
+	UINT64 litSamples = 0;
+	for (UINT sample = 0; sample < 20000; sample++)
+	{
+		const UINT x = generator() % grid.x;
+		const UINT y = generator() % grid.y;
+		const UINT z = generator() % grid.z;
+
+		// A point inside the cluster: tile (0, 0) is at the top left of the screen
+		const float ndcX = -1.0f + 2.0f * (static_cast<float>(x) + unitDistribution(generator)) / static_cast<float>(grid.x);
+		const float ndcY = 1.0f - 2.0f * (static_cast<float>(y) + unitDistribution(generator)) / static_cast<float>(grid.y);
+		const float depth = scene.SliceDepths[z] + (scene.SliceDepths[z + 1] - scene.SliceDepths[z]) * unitDistribution(generator);
+
+		// View-space positions along the ray through the pixel scale with depth
+		const XMVECTOR onFarPlane = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), invProjection);
+		const XMVECTOR positionVS = onFarPlane * (depth / XMVectorGetZ(onFarPlane));
+		const XMVECTOR positionWS = XMVector3TransformCoord(XMVectorSetW(positionVS, 1.0f), invView);
+
+		const UINT cluster = (z * grid.y + y) * grid.x + x;
+		for (UINT light = 0; light < scene.Lights.size(); light++)
+		{
+			const float distance = XMVectorGetX(XMVector3Length(positionWS - XMLoadFloat3(&scene.Lights[light].Position)));
+
+			// Leave a margin for rounding on the edge of the sphere
+			if (distance < scene.Lights[light].Range * 0.999f)
+			{
+				litSamples++;
+				ASSERT_TRUE(ClusterHasLight(culler, cluster, light)) << "light " << light << " missing from cluster " << cluster;
+			}
+		}
+	}
+	EXPECT_GT(litSamples, 1000u);
+}
@@ -0,0 +1,77 @@
+#include "pch.h"
+#include "Renderer/Memory/FenceRetireQueue.h"
+#include "Common/SimulatedFence.h"
+
+#include <gtest/gtest.h>
+
+
+TEST(FenceRetireQueue, RetiresInFenceOrder)
+{
+	FenceRetireQueue<UINT> queue;
+	queue.Push(3, 30);
+	queue.Push(1, 10);
+	queue.Push(2, 20);
+	EXPECT_EQ(queue.GetNextFenceValue(), 1u);
+
+	std::vector<UINT> retired;
+	EXPECT_EQ(queue.Retire(2, [&](UINT item) { retired.push_back(item); }), 2u);
+	EXPECT_EQ(retired, (std::vector<UINT>{ 10, 20 }));
+	EXPECT_EQ(queue.GetPendingCount(), 1u);
+
+	// Nothing is retired until its own fence value has completed
+	EXPECT_EQ(queue.Retire(2, [&](UINT item) { retired.push_back(item); }), 0u);
+	EXPECT_EQ(queue.RetireAll([&](UINT item) { retired.push_back(item); }), 1u);
+	EXPECT_TRUE(queue.IsEmpty());
+}
+
+// Every item must be retired exactly once, on the first frame where the fence that guards it has completed
+class FenceRetireQueueSimulation : public testing::TestWithParam<UINT>
+{
+};
+
+TEST_P(FenceRetireQueueSimulation, RetiresEachItemOnceAndNeverEarly)
+{
+	const UINT framesInFlight = GetParam();
+	constexpr UINT itemsPerFrame = 64;
+	constexpr UINT frames = 2000;
+	const SimulatedFrames simulated = SimulateFrames(framesInFlight, itemsPerFrame, frames);
+
+	FenceRetireQueue<UINT> queue;
+	std::vector<bool> retired(simulated.ItemFenceValues.size(), false);
+
+	UINT64 completed = 0;
+	auto OnRetire = [&](UINT item)
+		{
+			EXPECT_FALSE(retired[item]) << "Item " << item << " retired twice";
+			EXPECT_LE(simulated.ItemFenceValues[item], completed) << "Item " << item << " retired early";
+			retired[item] = true;
+		};
+
+	for (UINT f = 0; f < frames; f++)
+	{
+		completed = simulated.CompletedFenceValues[f];
+		queue.Retire(completed, OnRetire);
+
+		// Anything left must still be in flight
+		if (!queue.IsEmpty())
+			ASSERT_GT(queue.GetNextFenceValue(), completed) << "Item retired late on frame " << f;
+
+		for (UINT i = 0; i < itemsPerFrame; i++)
+		{
+			const UINT item = f * itemsPerFrame + i;
+			queue.Push(simulated.ItemFenceValues[item], item);
+		}
+
+		// Only the frames in flight, and one more when the GPU lags, can be pending
+		EXPECT_LE(queue.GetPendingCount(), static_cast<size_t>(framesInFlight + 2) * itemsPerFrame);
+	}
+
+	// The GPU finishes every frame that was submitted
+	completed = frames;
+	queue.RetireAll(OnRetire);
+
+	for (size_t item = 0; item < retired.size(); item++)
+		EXPECT_TRUE(retired[item]) << "Item " << item << " never retired";
+}
+
+INSTANTIATE_TEST_SUITE_P(FramesInFlight, FenceRetireQueueSimulation, testing::Values(1u, 2u, 3u));
@@ -0,0 +1,66 @@
+#include "pch.h"
+#include "Renderer/Lighting/FogNoiseBaker.h"
+#include "Framework/ThreadPool.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+
+
+// The SSE2 bake follows EvaluateTexel, to within the rounding of the UNORM8 texels
+TEST(FogNoiseBaker, BakeMatchesEvaluateTexel)
+{
+	ThreadPool threadPool(3);
+	FogNoiseBaker baker(threadPool);
+
+	FogNoiseBaker::Desc desc;
+	desc.Resolution = 16;
+	desc.Seed = 7;
+	desc.Octaves = 3;
+	desc.Frequency = 2;
+	baker.Bake(desc);
+
+	const std::vector<UINT8>& texels = baker.GetTexels();
+	ASSERT_EQ(texels.size(), static_cast<size_t>(16 * 16 * 16 * FogNoiseBaker::s_ChannelCount));
+
+	int maxError = 0;
+	for (UINT z = 0; z < desc.Resolution; z++)
+	{
+		for (UINT y = 0; y < desc.Resolution; y++)
+		{
+			for (UINT x = 0; x < desc.Resolution; x++)
+			{
+				float gradient, worley;
+				FogNoiseBaker::EvaluateTexel(desc, x, y, z, gradient, worley);
+
+				const UINT8* texel = &texels[z * baker.GetSlicePitch() + y * baker.GetRowPitch() + x * FogNoiseBaker::s_ChannelCount];
+				maxError = max(maxError, abs(static_cast<int>(texel[0]) - static_cast<int>(gradient * 255.0f + 0.5f)));
+				maxError = max(maxError, abs(static_cast<int>(texel[1]) - static_cast<int>(worley * 255.0f + 0.5f)));
+			}
+		}
+	}
+	EXPECT_LE(maxError, 1);
+}
+
+// A cached bake loads back identically, and only for the parameters that it was baked with
+TEST(FogNoiseBaker, CacheRoundTrip)
+{
+	ThreadPool threadPool(0);
+	FogNoiseBaker baker(threadPool);
+
+	FogNoiseBaker::Desc desc;
+	desc.Resolution = 8;
+	baker.Bake(desc);
+
+	const std::string path = (std::filesystem::temp_directory_path() / "volumetrics_tests_fog_noise.bin").string();
+	ASSERT_TRUE(baker.SaveCache(path));
+
+	FogNoiseBaker loaded(threadPool);
+	EXPECT_TRUE(loaded.LoadCache(path, desc));
+	EXPECT_EQ(loaded.GetTexels(), baker.GetTexels());
+
+	FogNoiseBaker::Desc otherDesc = desc;
+	otherDesc.Seed = 1;
+	EXPECT_FALSE(loaded.LoadCache(path, otherDesc));
+	std::filesystem::remove(path);
+}
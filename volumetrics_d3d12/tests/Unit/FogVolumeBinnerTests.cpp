@@ -0,0 +1,206 @@
+#include "pch.h"
+#include "Renderer/Lighting/FogVolumeBinner.h"
+#include "Framework/ThreadPool.h"
+#include "HlslCompat/VolumetricsHlslCompat.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+
+namespace
+{
+	// A camera looking across a field of randomly placed volumes of every shape,
+	// some of them behind the camera or beyond the froxel volume
+	struct FogVolumeScene
+	{
+		XMUINT3 FroxelResolution;
+		std::vector<float> SliceDepths;
+		XMMATRIX View;
+		XMMATRIX Projection;
+		std::vector<FogVolume> Volumes;
+	};
+
+	FogVolumeScene CreateFogVolumeScene(const XMUINT3& froxelResolution, UINT volumeCount, float maxExtent, UINT seed)
+	{
+		constexpr float nearPlane = 0.1f;
+		constexpr float maxVolumeDistance = 20.0f;
+
+		FogVolumeScene scene;
+		scene.FroxelResolution = froxelResolution;
+		scene.View = XMMatrixLookToLH(XMVectorSet(0.0f, 2.0f, -10.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		scene.Projection = XMMatrixPerspectiveFovLH(XM_PI / 3.0f, 16.0f / 9.0f, nearPlane, 100.0f);
+
+		// Density is sampled at the start of each froxel slice, as in VolumetricRendering
+		scene.SliceDepths.resize(froxelResolution.z + 1);
+		for (UINT i = 0; i <= froxelResolution.z; i++)
+		{
+			scene.SliceDepths[i] = Volumetrics::ZSliceToFroxelDepth(static_cast<float>(i), nearPlane, maxVolumeDistance,
+				froxelResolution.z, VOLUME_DEPTH_DISTRIBUTION_EXPONENTIAL, 1.0f);
+		}
+
+		std::mt19937 generator(seed);
+		auto Uniform = [&](float low, float high) { return std::uniform_real_distribution<float>(low, high)(generator); };
+
+		scene.Volumes.resize(volumeCount);
+		for (FogVolume& volume : scene.Volumes)
+		{
+			volume.Shape = generator() % FOG_VOLUME_SHAPE_COUNT;
+			volume.Position = { Uniform(-15.0f, 15.0f), Uniform(-2.0f, 6.0f), Uniform(-15.0f, 20.0f) };
+			volume.Rotation = { Uniform(-XM_PI, XM_PI), Uniform(-XM_PI, XM_PI), Uniform(-XM_PI, XM_PI) };
+			volume.Extents = { Uniform(0.2f, maxExtent), Uniform(0.2f, maxExtent), Uniform(0.2f, maxExtent) };
+		}
+		return scene;
+	}
+
+	void BinScene(FogVolumeBinner& binner, const FogVolumeScene& scene, ThreadPool& threadPool)
+	{
+		binner.SetFroxelGrid(scene.FroxelResolution, scene.SliceDepths.data(), scene.Projection);
+		binner.SetVolumes(scene.Volumes.data(), static_cast<UINT>(scene.Volumes.size()), scene.View);
+		binner.BinVolumes(threadPool);
+	}
+
+	bool TileHasVolume(const FogVolumeBinner& binner, UINT tile, UINT volume)
+	{
+		const XMUINT2 range = binner.GetTileVolumeRanges().at(tile);
+		const auto first = binner.GetVolumeIndices().begin() + range.x;
+		return std::binary_search(first, first + range.y, volume);
+	}
+
+	// Ranges follow on from each other, and each list is strictly increasing
+	void ExpectWellFormedLists(const FogVolumeBinner& binner)
+	{
+		const std::vector<XMUINT2>& ranges = binner.GetTileVolumeRanges();
+		const std::vector<UINT>& indices = binner.GetVolumeIndices();
+		ASSERT_EQ(ranges.size(), binner.GetTileCount());
+
+		UINT next = 0;
+		for (UINT tile = 0; tile < binner.GetTileCount(); tile++)
+		{
+			ASSERT_EQ(ranges[tile].x, next) << "tile " << tile;
+			next += ranges[tile].y;
+			ASSERT_LE(next, indices.size()) << "tile " << tile;
+
+			const auto first = indices.begin() + ranges[tile].x;
+			EXPECT_TRUE(std::adjacent_find(first, first + ranges[tile].y, std::greater_equal<UINT>()) == first + ranges[tile].y) << "tile " << tile;
+		}
+		EXPECT_EQ(next, indices.size());
+	}
+}
+
+
+// Every volume that covers one of the density samples of an 8^3 tile is listed in that tile
+// The reference tests every sample against every volume, so the lists may hold more volumes, but never fewer
+TEST(FogVolumeBinner, ListsEveryOverlapOfTheReference)
+{
+	ThreadPool threadPool(3);
+
+	for (UINT volumeCount : { 0u, 1u, 5u, 64u })
+	{
+		SCOPED_TRACE(testing::Message() << volumeCount << " volumes");
+
+		const FogVolumeScene scene = CreateFogVolumeScene({ 32, 16, 32 }, volumeCount, 3.0f, volumeCount + 1);
+		FogVolumeBinner binner;
+		BinScene(binner, scene, threadPool);
+		ExpectWellFormedLists(binner);
+
+		std::vector<XMUINT2> referenceRanges;
+		std::vector<UINT> referenceIndices;
+		binner.BinVolumesReference(referenceRanges, referenceIndices);
+		ASSERT_EQ(referenceRanges.size(), binner.GetTileCount());
+
+		UINT missing = 0;
+		for (UINT tile = 0; tile < binner.GetTileCount(); tile++)
+		{
+			const XMUINT2& range = referenceRanges[tile];
+			for (UINT i = 0; i < range.y; i++)
+			{
+				const UINT volume = referenceIndices[range.x + i];
+				if (!TileHasVolume(binner, tile, volume))
+				{
+					ADD_FAILURE() << "volume " << volume << " is missing from tile " << tile;
+					missing++;
+				}
+			}
+		}
+		EXPECT_EQ(missing, 0u);
+
+		if (volumeCount >= 5)
+		{
+			EXPECT_GT(referenceIndices.size(), 0u) << "Volumes should overlap the froxels";
+			EXPECT_LT(binner.GetVisibleVolumeCount(), volumeCount) << "Some volumes should be culled";
+		}
+	}
+}
+
+// Slices are binned independently, so the lists do not depend on the number of threads
+TEST(FogVolumeBinner, MatchesAcrossThreadCounts)
+{
+	const FogVolumeScene scene = CreateFogVolumeScene({ 64, 32, 64 }, 300, 3.0f, 7);
+
+	ThreadPool singleThread(0);
+	FogVolumeBinner single;
+	BinScene(single, scene, singleThread);
+
+	ThreadPool threadPool(3);
+	FogVolumeBinner threaded;
+	BinScene(threaded, scene, threadPool);
+
+	ASSERT_EQ(single.GetTileVolumeRanges().size(), threaded.GetTileVolumeRanges().size());
+	for (size_t tile = 0; tile < single.GetTileVolumeRanges().size(); tile++)
+	{
+		EXPECT_EQ(single.GetTileVolumeRanges()[tile].x, threaded.GetTileVolumeRanges()[tile].x) << "tile " << tile;
+		EXPECT_EQ(single.GetTileVolumeRanges()[tile].y, threaded.GetTileVolumeRanges()[tile].y) << "tile " << tile;
+	}
+	EXPECT_EQ(single.GetVolumeIndices(), threaded.GetVolumeIndices());
+}
+
+// Once the lists run past the index limit, each tile keeps the start of its list that fits below the limit,
+// so that every truncated range is a prefix of the binned one, and the truncated lists fill the limit exactly
+TEST(FogVolumeBinner, TruncatesListsAtTheIndexLimit)
+{
+	// Large volumes over the largest volume resolution, so that the lists run past s_MaxVolumeIndices
+	const FogVolumeScene scene = CreateFogVolumeScene({ 160, 88, 64 }, 1024, 10.0f, 11);
+	ThreadPool threadPool(3);
+	FogVolumeBinner binner;
+	BinScene(binner, scene, threadPool);
+	ExpectWellFormedLists(binner);
+
+	const UINT indexCount = static_cast<UINT>(binner.GetVolumeIndices().size());
+	ASSERT_GT(indexCount, FogVolumeBinner::s_MaxVolumeIndices);
+
+	for (UINT limit : { FogVolumeBinner::s_MaxVolumeIndices, 0u, 1u, indexCount / 2, indexCount, indexCount + 10 })
+	{
+		SCOPED_TRACE(testing::Message() << "limit " << limit);
+
+		std::vector<XMUINT2> truncated(binner.GetTileCount());
+		binner.TruncateTileVolumeRanges(limit, truncated.data());
+
+		UINT truncatedCount = 0;
+		UINT cutTiles = 0;
+		for (UINT tile = 0; tile < binner.GetTileCount(); tile++)
+		{
+			const XMUINT2& range = binner.GetTileVolumeRanges()[tile];
+			ASSERT_EQ(truncated[tile].x, range.x) << "tile " << tile;
+			ASSERT_LE(truncated[tile].y, range.y) << "tile " << tile;
+
+			if (truncated[tile].y > 0)
+				ASSERT_LE(truncated[tile].x + truncated[tile].y, limit) << "tile " << tile;
+			// A list is only cut where it reaches the limit
+			if (truncated[tile].y < range.y)
+			{
+				ASSERT_EQ(max(range.x, limit), range.x + truncated[tile].y) << "tile " << tile;
+				cutTiles++;
+			}
+
+			truncatedCount += truncated[tile].y;
+		}
+
+		EXPECT_EQ(truncatedCount, min(limit, indexCount));
+		if (limit >= indexCount)
+			EXPECT_EQ(cutTiles, 0u);
+		else
+			EXPECT_GT(cutTiles, 0u);
+	}
+}
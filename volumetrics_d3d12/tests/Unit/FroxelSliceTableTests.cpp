@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "Renderer/Lighting/FroxelSliceTable.h"
+
+#include <gtest/gtest.h>
+
+#include <functional>
+
+
+namespace
+{
+	// A froxel volume with the slice mapping of VolumetricsHlslCompat.h
+	struct SliceVolume
+	{
+		UINT Distribution;
+		float NearPlane;
+		float MaxDistance;
+		float HybridLinearDepth;
+		UINT SliceCount;
+
+		float SliceToDepth(float slice) const
+		{
+			return Volumetrics::ZSliceToFroxelDepth(slice, NearPlane, MaxDistance, SliceCount, Distribution, HybridLinearDepth);
+		}
+
+		float DepthToSlice(float depth) const
+		{
+			return Volumetrics::FroxelDepthToZSlice(depth, NearPlane, MaxDistance, SliceCount, Distribution, HybridLinearDepth);
+		}
+	};
+
+	// Every distribution over the ranges of the volumetrics GUI
+	// Only the hybrid distribution depends on the linear depth, so the others are checked with one
+	void ForEachVolume(const std::function<void(const SliceVolume&)>& check)
+	{
+		constexpr float nearPlanes[] = { 0.01f, 0.1f, 1.0f };
+		constexpr float maxDistances[] = { 2.0f, 10.0f, 50.0f, 100.0f };
+		constexpr float hybridLinearDepths[] = { 0.1f, 1.0f, 10.0f, 100.0f };
+		constexpr UINT sliceCounts[] = { 32, 64, VOLUME_MAX_SLICES };
+
+		for (UINT distribution = 0; distribution < VOLUME_DEPTH_DISTRIBUTION_COUNT; distribution++)
+		{
+			for (float nearPlane : nearPlanes)
+			{
+				for (float maxDistance : maxDistances)
+				{
+					for (float hybridLinearDepth : hybridLinearDepths)
+					{
+						if (distribution != VOLUME_DEPTH_DISTRIBUTION_HYBRID && hybridLinearDepth != hybridLinearDepths[0])
+							continue;
+
+						for (UINT sliceCount : sliceCounts)
+						{
+							const SliceVolume volume = { distribution, nearPlane, maxDistance, hybridLinearDepth, sliceCount };
+
+							SCOPED_TRACE(testing::Message() << "distribution " << distribution << ", near " << nearPlane << ", max distance " << maxDistance
+								<< ", hybrid linear depth " << hybridLinearDepth << ", " << sliceCount << " slices");
+							check(volume);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	constexpr UINT s_SamplesPerSlice = 16;
+}
+
+
+// The first and last slices lie on the near plane and the max distance, and volume W is clamped outside them
+TEST(FroxelSliceTable, SlicesSpanTheVolume)
+{
+	ForEachVolume([](const SliceVolume& volume)
+		{
+			const float tolerance = 1.0e-5f * (volume.MaxDistance - volume.NearPlane);
+			EXPECT_NEAR(volume.SliceToDepth(0.0f), volume.NearPlane, tolerance);
+			EXPECT_NEAR(volume.SliceToDepth(static_cast<float>(volume.SliceCount - 1)), volume.MaxDistance, tolerance);
+
+			EXPECT_EQ(Volumetrics::FroxelDepthToVolumeW(0.5f * volume.NearPlane, volume.NearPlane, volume.MaxDistance, volume.Distribution, volume.HybridLinearDepth), 0.0f);
+			EXPECT_EQ(Volumetrics::FroxelDepthToVolumeW(2.0f * volume.MaxDistance, volume.NearPlane, volume.MaxDistance, volume.Distribution, volume.HybridLinearDepth), 1.0f);
+		});
+}
+
+// Depth increases strictly with slice, and slice with depth
+TEST(FroxelSliceTable, MappingIsMonotonic)
+{
+	ForEachVolume([](const SliceVolume& volume)
+		{
+			const UINT sampleCount = (volume.SliceCount - 1) * s_SamplesPerSlice;
+			const float range = volume.MaxDistance - volume.NearPlane;
+
+			UINT nonMonotonic = 0;
+			for (UINT i = 1; i <= sampleCount; i++)
+			{
+				const float slice = static_cast<float>(i) / static_cast<float>(s_SamplesPerSlice);
+				const float previousSlice = static_cast<float>(i - 1) / static_cast<float>(s_SamplesPerSlice);
+				nonMonotonic += volume.SliceToDepth(slice) <= volume.SliceToDepth(previousSlice);
+
+				const float depth = volume.NearPlane + range * static_cast<float>(i) / static_cast<float>(sampleCount);
+				const float previousDepth = volume.NearPlane + range * static_cast<float>(i - 1) / static_cast<float>(sampleCount);
+				nonMonotonic += volume.DepthToSlice(depth) <= volume.DepthToSlice(previousDepth);
+			}
+			EXPECT_EQ(nonMonotonic, 0u);
+		});
+}
+
+// slice -> depth -> slice and depth -> slice -> depth land within a small fraction of a slice
+// When the hybrid linear depth is much larger than the volume, 1 + depth / c keeps few bits of the depth,
+// so those volumes only round trip to around a thousandth of a slice, which is still far below anything visible
+TEST(FroxelSliceTable, MappingRoundTrips)
+{
+	constexpr float tolerance = 1.0f / 64.0f;
+
+	ForEachVolume([&](const SliceVolume& volume)
+		{
+			const UINT sampleCount = (volume.SliceCount - 1) * s_SamplesPerSlice;
+			const float range = volume.MaxDistance - volume.NearPlane;
+
+			float maxSliceError = 0.0f;
+			float maxDepthError = 0.0f;
+			for (UINT i = 0; i <= sampleCount; i++)
+			{
+				const float slice = static_cast<float>(i) / static_cast<float>(s_SamplesPerSlice);
+				maxSliceError = max(maxSliceError, fabsf(volume.DepthToSlice(volume.SliceToDepth(slice)) - slice));
+
+				// Measured against the thickness of the slice at that depth
+				const float depth = volume.NearPlane + range * static_cast<float>(i) / static_cast<float>(sampleCount);
+				const float sampleSlice = volume.DepthToSlice(depth);
+				const float sliceThickness = volume.SliceToDepth(sampleSlice + 0.5f) - volume.SliceToDepth(sampleSlice - 0.5f);
+				maxDepthError = max(maxDepthError, fabsf(volume.SliceToDepth(sampleSlice) - depth) / sliceThickness);
+			}
+			EXPECT_LE(maxSliceError, tolerance);
+			EXPECT_LE(maxDepthError, tolerance);
+		});
+}
@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "Renderer/Geometry/FrustumCuller.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+
+namespace
+{
+	// Random boxes around the origin, some large enough to straddle several planes
+	void FillRandomBounds(FrustumCuller& culler, size_t instanceCount, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> positionDistribution(-200.0f, 200.0f);
+		std::uniform_real_distribution<float> sizeDistribution(0.01f, 20.0f);
+		std::uniform_real_distribution<float> angleDistribution(-XM_PI, XM_PI);
+
+		const XMFLOAT3 localMin = { -1.0f, -1.0f, -1.0f };
+		const XMFLOAT3 localMax = { 1.0f, 1.0f, 1.0f };
+		culler.Resize(instanceCount);
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			const XMMATRIX scale = XMMatrixScaling(sizeDistribution(rng), sizeDistribution(rng), sizeDistribution(rng));
+			const XMMATRIX rotation = XMMatrixRotationRollPitchYaw(angleDistribution(rng), angleDistribution(rng), angleDistribution(rng));
+			const XMMATRIX translation = XMMatrixTranslation(positionDistribution(rng), positionDistribution(rng), positionDistribution(rng));
+			culler.SetInstanceBounds(i, localMin, localMax, scale * rotation * translation);
+		}
+	}
+
+	// A perspective camera or an orthographic light, placed and oriented at random
+	Frustum RandomFrustum(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unitDistribution(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> positionDistribution(-100.0f, 100.0f);
+
+		const XMVECTOR eye = XMVectorSet(positionDistribution(rng), positionDistribution(rng), positionDistribution(rng), 1.0f);
+		XMVECTOR direction = XMVectorSet(unitDistribution(rng), unitDistribution(rng), unitDistribution(rng), 0.0f);
+		if (XMVectorGetX(XMVector3LengthSq(direction)) < 1e-3f)
+			direction = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+		direction = XMVector3Normalize(direction);
+
+		// Any up vector that is not parallel to the direction
+		const XMVECTOR up = fabsf(XMVectorGetY(direction)) > 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		const XMMATRIX view = XMMatrixLookToLH(eye, direction, up);
+
+		const XMMATRIX projection = rng() % 2
+			? XMMatrixPerspectiveFovLH(XMConvertToRadians(20.0f + 100.0f * (unitDistribution(rng) * 0.5f + 0.5f)), 16.0f / 9.0f, 0.1f, 300.0f)
+			: XMMatrixOrthographicLH(50.0f + 200.0f * (unitDistribution(rng) * 0.5f + 0.5f), 100.0f, 0.0f, 400.0f);
+
+		Frustum frustum = Frustum::FromViewProjection(view * projection);
+		// The shadow cascades cull with the near plane disabled, so that casters behind the light are kept
+		if (rng() % 4 == 0)
+			frustum.DisablePlane(Frustum::Plane_Near);
+		return frustum;
+	}
+}
+
+
+// The SIMD paths must give exactly the instances that CullScalar gives, including for the counts that leave a
+// remainder for the narrower paths
+TEST(FrustumCuller, SIMDPathsMatchScalar)
+{
+	std::mt19937 rng(0xC011);
+	const bool avxSupported = FrustumCuller::IsAVXSupported();
+	if (!avxSupported)
+		std::cout << "AVX is not supported by this CPU; only the SSE path is tested\n";
+
+	std::vector<UINT> reference, visible;
+	size_t totalVisible = 0;
+	for (UINT scene = 0; scene < 200; scene++)
+	{
+		const size_t instanceCount = scene < 40 ? scene : rng() % 5000;
+		FrustumCuller culler;
+		FillRandomBounds(culler, instanceCount, rng);
+
+		for (UINT f = 0; f < 4; f++)
+		{
+			const Frustum frustum = RandomFrustum(rng);
+
+			reference.clear();
+			culler.CullScalar(frustum, reference);
+			totalVisible += reference.size();
+
+			visible.clear();
+			culler.CullSSE(frustum, visible);
+			ASSERT_EQ(visible, reference) << "SSE path, " << instanceCount << " instances";
+
+			if (avxSupported)
+			{
+				visible.clear();
+				culler.CullAVX(frustum, visible);
+				ASSERT_EQ(visible, reference) << "AVX path, " << instanceCount << " instances";
+			}
+
+			visible.clear();
+			culler.Cull(frustum, visible);
+			ASSERT_EQ(visible, reference);
+		}
+	}
+
+	// The random frustums must not have culled everything, which would match trivially
+	EXPECT_GT(totalVisible, 1000u);
+}
+
+// A box that touches a plane is kept, and one just beyond it is culled
+TEST(FrustumCuller, BoundaryBoxes)
+{
+	const XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const Frustum frustum = Frustum::FromViewProjection(view * XMMatrixOrthographicLH(20.0f, 20.0f, 0.0f, 100.0f));
+
+	// Unit boxes along +x, 9 instances so that the AVX, SSE and scalar paths each see some of them
+	FrustumCuller culler;
+	culler.Resize(9);
+	const XMFLOAT3 localMin = { -0.5f, -0.5f, -0.5f };
+	const XMFLOAT3 localMax = { 0.5f, 0.5f, 0.5f };
+	for (UINT i = 0; i < 9; i++)
+	{
+		// Instance 4 touches the right plane at x = 10; instance 5 is beyond it
+		const float x = i == 4 ? 10.5f : (i == 5 ? 10.75f : static_cast<float>(i));
+		culler.SetInstanceBounds(i, localMin, localMax, XMMatrixTranslation(x, 0.0f, 50.0f));
+	}
+
+	std::vector<UINT> visible;
+	culler.Cull(frustum, visible);
+	EXPECT_EQ(visible, (std::vector<UINT>{ 0, 1, 2, 3, 4, 6, 7, 8 }));
+}
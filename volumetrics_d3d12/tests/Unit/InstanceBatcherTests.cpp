@@ -0,0 +1,84 @@
+#include "pch.h"
+#include "Renderer/Geometry/InstanceBatcher.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+
+namespace
+{
+	// Every instance must appear once, in the batch of its geometry, in the order that it was given,
+	// which is the order a stable sort by geometry handle gives
+	void ExpectValidBatches(const InstanceBatcher& batcher, const std::vector<UINT>& instanceIDs, const std::vector<UINT>& geometryHandles)
+	{
+		std::vector<UINT> sorted = instanceIDs;
+		std::stable_sort(sorted.begin(), sorted.end(), [&](UINT a, UINT b) { return geometryHandles[a] < geometryHandles[b]; });
+		EXPECT_EQ(batcher.GetInstanceIndices(), sorted);
+
+		UINT nextInstance = 0;
+		UINT previousGeometry = 0;
+		for (const DrawBatch& batch : batcher.GetBatches())
+		{
+			// Batches are contiguous, non-empty and ordered by geometry, with one batch per geometry
+			EXPECT_EQ(batch.FirstInstance, nextInstance);
+			EXPECT_GT(batch.InstanceCount, 0u);
+			if (nextInstance > 0)
+				EXPECT_GT(batch.GeometryHandle, previousGeometry);
+
+			for (UINT i = batch.FirstInstance; i < batch.FirstInstance + batch.InstanceCount; i++)
+				EXPECT_EQ(geometryHandles[batcher.GetInstanceIndices()[i]], batch.GeometryHandle);
+
+			nextInstance += batch.InstanceCount;
+			previousGeometry = batch.GeometryHandle;
+		}
+		EXPECT_EQ(nextInstance, instanceIDs.size());
+	}
+}
+
+
+TEST(InstanceBatcher, MatchesStableSortOnRandomScenes)
+{
+	std::mt19937 rng(0xBA7C);
+	InstanceBatcher batcher;
+
+	// The batcher is reused, as the renderer does every frame
+	for (UINT scene = 0; scene < 200; scene++)
+	{
+		const UINT sceneInstances = rng() % 2000;
+		const UINT geometryCount = 1 + rng() % 64;
+
+		std::vector<UINT> geometryHandles(sceneInstances);
+		for (UINT& geometry : geometryHandles)
+			geometry = rng() % geometryCount;
+
+		// Visible instances are in increasing order, as the FrustumCuller produces them, except in every other
+		// scene where they are shuffled to check that order is kept rather than assumed
+		std::vector<UINT> visible;
+		for (UINT i = 0; i < sceneInstances; i++)
+		{
+			if (rng() % 3 == 0)
+				visible.push_back(i);
+		}
+		if (scene % 2 == 1)
+			std::shuffle(visible.begin(), visible.end(), rng);
+
+		batcher.Build(visible.data(), visible.size(), geometryHandles.data(), geometryCount);
+		ExpectValidBatches(batcher, visible, geometryHandles);
+	}
+}
+
+TEST(InstanceBatcher, EmptyInput)
+{
+	InstanceBatcher batcher;
+	const std::vector<UINT> geometryHandles = { 0, 1 };
+	const std::vector<UINT> instances = { 0, 1 };
+	batcher.Build(instances.data(), instances.size(), geometryHandles.data(), 2);
+	ASSERT_EQ(batcher.GetBatches().size(), 2u);
+
+	// An empty build must not leave the batches of the previous one
+	batcher.Build(nullptr, 0, geometryHandles.data(), 2);
+	EXPECT_TRUE(batcher.GetBatches().empty());
+	EXPECT_TRUE(batcher.GetInstanceIndices().empty());
+}
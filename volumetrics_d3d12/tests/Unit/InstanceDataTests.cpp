@@ -0,0 +1,34 @@
+#include "pch.h"
+#include "Renderer/Geometry/InstanceData.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+
+// The shaders transform positions with dot(WorldMat[i], float4(position, 1)), which must agree with
+// transforming by the full world matrix
+TEST(InstanceData, PackedRowsTransformAsWorldMatrix)
+{
+	std::mt19937 rng(0x1D);
+	std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+
+	for (UINT i = 0; i < 1000; i++)
+	{
+		const XMMATRIX world = XMMatrixScaling(1.0f + fabsf(distribution(rng)), 0.5f, 2.0f)
+			* XMMatrixRotationRollPitchYaw(distribution(rng), distribution(rng), distribution(rng))
+			* XMMatrixTranslation(distribution(rng), distribution(rng), distribution(rng));
+
+		InstanceGPUData packed;
+		PackInstanceGPUData(world, i, packed);
+		EXPECT_EQ(packed.MaterialID, i);
+
+		const XMVECTOR position = XMVectorSet(distribution(rng), distribution(rng), distribution(rng), 1.0f);
+		const XMVECTOR expected = XMVector3TransformCoord(position, world);
+		for (UINT row = 0; row < 3; row++)
+		{
+			const float actual = XMVectorGetX(XMVector4Dot(XMLoadFloat4(&packed.WorldMat[row]), position));
+			EXPECT_NEAR(actual, expected[row], 1e-3f);
+		}
+	}
+}
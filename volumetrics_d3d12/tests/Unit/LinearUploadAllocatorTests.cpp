@@ -0,0 +1,165 @@
+#include "pch.h"
+#include "Renderer/Memory/LinearUploadAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <thread>
+
+
+namespace
+{
+	constexpr UINT64 s_BytesPerFrame = 64 * 1024;
+	constexpr UINT s_FrameCount = 3;
+	// A made up GPU address with a different alignment to the host buffer, so that the two cannot be confused
+	constexpr D3D12_GPU_VIRTUAL_ADDRESS s_GPUBase = 0x7F0000000000ull;
+
+	// Host memory standing in for the persistently mapped upload buffer
+	struct FakeUploadBuffer
+	{
+		FakeUploadBuffer() : Storage(s_BytesPerFrame * s_FrameCount + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT)
+		{
+			// Mapped upload memory is at least 256 byte aligned
+			const uintptr_t address = reinterpret_cast<uintptr_t>(Storage.data());
+			Base = Storage.data() + (Align(static_cast<UINT64>(address), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT) - address);
+		}
+
+		std::vector<UINT8> Storage;
+		UINT8* Base = nullptr;
+	};
+
+	struct LiveAllocation
+	{
+		UploadAllocation Allocation;
+		UINT Frame;
+		UINT8 Pattern;
+	};
+}
+
+
+// Random sizes, alignments and frame changes; every allocation is filled with a pattern that must survive
+// until the segment of the frame that made it is recycled
+TEST(LinearUploadAllocator, FuzzSingleThread)
+{
+	FakeUploadBuffer buffer;
+	LinearUploadAllocator allocator(buffer.Base, s_GPUBase, s_BytesPerFrame, s_FrameCount);
+
+	std::mt19937 rng(0xF022);
+	std::vector<LiveAllocation> live;
+	UINT frame = 0;
+	allocator.BeginFrame(frame);
+	UINT64 failures = 0;
+
+	for (UINT op = 0; op < 200000; op++)
+	{
+		if (rng() % 500 == 0)
+		{
+			frame = (frame + 1) % s_FrameCount;
+			allocator.BeginFrame(frame);
+
+			// Allocations from the recycled segment must have kept their contents until now
+			for (const LiveAllocation& allocation : live)
+			{
+				if (allocation.Frame != frame)
+					continue;
+				for (UINT64 i = 0; i < allocation.Allocation.Size; i++)
+					ASSERT_EQ(allocation.Allocation.CPUAddress[i], allocation.Pattern) << "Overwritten before its frame was recycled";
+			}
+			std::erase_if(live, [frame](const LiveAllocation& allocation) { return allocation.Frame == frame; });
+			continue;
+		}
+
+		const UINT64 size = 1 + rng() % 2048;
+		const UINT64 alignment = 1ull << (rng() % 9);
+		const UploadAllocation allocation = allocator.Allocate(size, alignment);
+		if (!allocation.IsValid())
+		{
+			failures++;
+			continue;
+		}
+
+		ASSERT_EQ(allocation.Size, size);
+		const UINT64 regionOffset = static_cast<UINT64>(allocation.CPUAddress - buffer.Base);
+		ASSERT_EQ(allocation.GPUAddress, s_GPUBase + regionOffset) << "CPU and GPU addresses disagree";
+		ASSERT_EQ(regionOffset % alignment, 0u);
+		ASSERT_EQ(allocation.GPUAddress % alignment, 0u);
+
+		// Within the current frame's segment
+		ASSERT_GE(regionOffset, frame * s_BytesPerFrame);
+		ASSERT_LE(regionOffset + size, (frame + 1) * s_BytesPerFrame);
+
+		const UINT8 pattern = static_cast<UINT8>(rng());
+		memset(allocation.CPUAddress, pattern, size);
+		live.push_back({ allocation, frame, pattern });
+	}
+
+	// Segments must fill up between frame changes for the exhaustion path to be covered
+	EXPECT_GT(failures, 0u);
+	EXPECT_LE(allocator.GetHighWaterMark(), s_BytesPerFrame);
+}
+
+TEST(LinearUploadAllocator, FuzzConcurrentThreads)
+{
+	FakeUploadBuffer buffer;
+	LinearUploadAllocator allocator(buffer.Base, s_GPUBase, s_BytesPerFrame, s_FrameCount);
+	allocator.BeginFrame(1);
+
+	constexpr UINT threadCount = 8;
+	std::vector<std::vector<LiveAllocation>> allocations(threadCount);
+	std::vector<std::thread> threads;
+	for (UINT t = 0; t < threadCount; t++)
+	{
+		threads.emplace_back([&, t]()
+			{
+				std::mt19937 rng(t);
+				for (UINT i = 0; i < 2000; i++)
+				{
+					const UINT64 size = 1 + rng() % 512;
+					const UploadAllocation allocation = rng() % 2 ? allocator.Allocate(size) : allocator.Allocate(size, 16);
+					if (!allocation.IsValid())
+						continue;
+
+					// Each thread writes its own pattern, which another thread's allocation would overwrite if they overlapped
+					const UINT8 pattern = static_cast<UINT8>(t * 31 + i);
+					memset(allocation.CPUAddress, pattern, size);
+					allocations[t].push_back({ allocation, 1, pattern });
+				}
+			});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	UINT64 total = 0;
+	for (const auto& threadAllocations : allocations)
+	{
+		for (const LiveAllocation& allocation : threadAllocations)
+		{
+			for (UINT64 i = 0; i < allocation.Allocation.Size; i++)
+				ASSERT_EQ(allocation.Allocation.CPUAddress[i], allocation.Pattern) << "Allocations of different threads overlap";
+			total += allocation.Allocation.Size;
+		}
+	}
+	EXPECT_LE(total, s_BytesPerFrame);
+	EXPECT_LE(allocator.GetCurrentFrameUsage(), s_BytesPerFrame);
+}
+
+TEST(LinearUploadAllocator, AllocateConstantsCopiesData)
+{
+	FakeUploadBuffer buffer;
+	LinearUploadAllocator allocator(buffer.Base, s_GPUBase, s_BytesPerFrame, s_FrameCount);
+	allocator.BeginFrame(0);
+
+	struct Constants
+	{
+		float Values[16];
+	};
+	Constants constants;
+	for (int i = 0; i < 16; i++)
+		constants.Values[i] = static_cast<float>(i);
+
+	allocator.Allocate(3);
+	const UploadAllocation allocation = allocator.AllocateConstants(constants);
+	ASSERT_TRUE(allocation.IsValid());
+	EXPECT_EQ(allocation.GPUAddress % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, 0u);
+	EXPECT_EQ(memcmp(allocation.CPUAddress, &constants, sizeof(constants)), 0);
+}
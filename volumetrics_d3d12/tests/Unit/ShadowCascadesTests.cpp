@@ -0,0 +1,200 @@
+#include "pch.h"
+#include "Renderer/Lighting/ShadowCascades.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+
+namespace
+{
+	constexpr UINT s_MaxCascadeCount = 4;
+	constexpr UINT s_ShadowMapResolution = 2048;
+	constexpr float s_Lambdas[] = { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f };
+	constexpr std::pair<float, float> s_DepthRanges[] = { { 0.1f, 50.0f }, { 0.1f, 200.0f }, { 1.0f, 1000.0f } };
+
+	// Slice corners may lie on the edge of the projection, so allow for rounding
+	constexpr float s_CoverageEpsilon = 1.0e-4f;
+	// Light-space positions hundreds of metres from the origin keep only a few bits below a texel of the nearest cascade,
+	// so snapping is exact up to that precision rather than to the texel
+	constexpr float s_ShimmerTolerance = 1.0f / 32.0f;
+
+	// The last is close enough to vertical that the light view picks a different up vector
+	const XMVECTOR s_LightDirections[] = {
+		XMVector3Normalize(XMVectorSet(0.3f, -1.0f, 0.4f, 0.0f)),
+		XMVector3Normalize(XMVectorSet(-1.0f, -0.2f, 0.1f, 0.0f)),
+		XMVector3Normalize(XMVectorSet(0.01f, -1.0f, 0.02f, 0.0f))
+	};
+
+	// The cascades of one camera projection, with its splits, as LightManager fits them
+	struct CascadeFitter
+	{
+		CascadeFitter(float nearPlane, float farPlane)
+			: NearPlane(nearPlane)
+			, FarPlane(farPlane)
+			, InvProjection(XMMatrixInverse(nullptr, XMMatrixPerspectiveFovLH(XMConvertToRadians(60.0f), 16.0f / 9.0f, nearPlane, farPlane)))
+		{
+			ShadowCascades::ComputeSplits(nearPlane, farPlane, 0.75f, s_MaxCascadeCount, Splits.data());
+		}
+
+		float GetSplitNear(UINT cascade) const { return cascade == 0 ? NearPlane : Splits[cascade - 1]; }
+
+		std::array<ShadowCascade, s_MaxCascadeCount> Fit(const XMMATRIX& cameraInvView, FXMVECTOR lightDirection) const
+		{
+			std::array<ShadowCascade, s_MaxCascadeCount> cascades;
+			for (UINT i = 0; i < s_MaxCascadeCount; i++)
+				cascades[i] = ShadowCascades::FitCascade(cameraInvView, InvProjection, NearPlane, FarPlane, GetSplitNear(i), Splits[i], lightDirection, s_ShadowMapResolution);
+			return cascades;
+		}
+
+		float NearPlane;
+		float FarPlane;
+		XMMATRIX InvProjection;
+		std::array<float, s_MaxCascadeCount> Splits{};
+	};
+
+	struct RandomCamera
+	{
+		float X, Y, Z;
+		XMMATRIX Rotation;
+
+		XMMATRIX GetInvView() const { return XMMatrixMultiply(Rotation, XMMatrixTranslation(X, Y, Z)); }
+	};
+
+	RandomCamera CreateRandomCamera(std::mt19937& generator)
+	{
+		std::uniform_real_distribution<float> positionDistribution(-200.0f, 200.0f);
+		std::uniform_real_distribution<float> yawDistribution(-XM_PI, XM_PI);
+		std::uniform_real_distribution<float> pitchDistribution(-0.45f * XM_PI, 0.45f * XM_PI);
+
+		RandomCamera camera;
+		camera.X = positionDistribution(generator);
+		camera.Y = positionDistribution(generator);
+		camera.Z = positionDistribution(generator);
+		camera.Rotation = XMMatrixRotationRollPitchYaw(pitchDistribution(generator), yawDistribution(generator), 0.0f);
+		return camera;
+	}
+
+	// The position of a world-space point on a cascade's texel grid
+	XMFLOAT2 GetTexelPosition(const ShadowCascade& cascade, FXMVECTOR positionWS)
+	{
+		const float resolution = static_cast<float>(s_ShadowMapResolution);
+		const XMVECTOR clip = XMVector3TransformCoord(positionWS, cascade.ViewProjection);
+		return XMFLOAT2{ XMVectorGetX(clip) * 0.5f * resolution, XMVectorGetY(clip) * 0.5f * resolution };
+	}
+}
+
+
+TEST(ShadowCascades, SplitsIncreaseAndEndAtFarPlane)
+{
+	for (const auto& [nearPlane, farPlane] : s_DepthRanges)
+	{
+		for (float lambda : s_Lambdas)
+		{
+			for (UINT cascadeCount = 1; cascadeCount <= s_MaxCascadeCount; cascadeCount++)
+			{
+				std::array<float, s_MaxCascadeCount> splits{};
+				ShadowCascades::ComputeSplits(nearPlane, farPlane, lambda, cascadeCount, splits.data());
+
+				EXPECT_EQ(splits[cascadeCount - 1], farPlane);
+				float splitNear = nearPlane;
+				for (UINT i = 0; i < cascadeCount; i++)
+				{
+					EXPECT_GT(splits[i], splitNear) << "lambda " << lambda << ", " << cascadeCount << " cascades";
+					splitNear = splits[i];
+				}
+			}
+		}
+	}
+}
+
+// Every corner of each slice of the camera frustum must be inside its cascade's projection
+TEST(ShadowCascades, CascadesCoverTheirSlice)
+{
+	std::mt19937 generator(0xC5A11);
+
+	for (const auto& [nearPlane, farPlane] : s_DepthRanges)
+	{
+		const CascadeFitter fitter(nearPlane, farPlane);
+		for (const XMVECTOR& lightDirection : s_LightDirections)
+		{
+			for (UINT c = 0; c < 64; c++)
+			{
+				const XMMATRIX cameraInvView = CreateRandomCamera(generator).GetInvView();
+				const auto cascades = fitter.Fit(cameraInvView, lightDirection);
+
+				for (UINT i = 0; i < s_MaxCascadeCount; i++)
+				{
+					for (const XMVECTOR& corner : ShadowCascades::ComputeFrustumSliceCorners(fitter.InvProjection, nearPlane, farPlane, fitter.GetSplitNear(i), fitter.Splits[i]))
+					{
+						const XMVECTOR clip = XMVector3TransformCoord(XMVector3TransformCoord(corner, cameraInvView), cascades[i].ViewProjection);
+						ASSERT_LE(fabsf(XMVectorGetX(clip)), 1.0f + s_CoverageEpsilon);
+						ASSERT_LE(fabsf(XMVectorGetY(clip)), 1.0f + s_CoverageEpsilon);
+						ASSERT_GE(XMVectorGetZ(clip), -s_CoverageEpsilon);
+						ASSERT_LE(XMVectorGetZ(clip), 1.0f + s_CoverageEpsilon);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Moving the camera must move each cascade by whole texels so that shadows do not shimmer,
+// and neither moving nor rotating it may change the size of a texel
+TEST(ShadowCascades, CascadesAreStableAsTheCameraMoves)
+{
+	std::mt19937 generator(0xC5A12);
+	std::uniform_real_distribution<float> offsetDistribution(-0.5f, 0.5f);
+	std::uniform_real_distribution<float> yawDistribution(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> pitchDistribution(-0.45f * XM_PI, 0.45f * XM_PI);
+
+	float maxShimmer = 0.0f;
+	for (const auto& [nearPlane, farPlane] : s_DepthRanges)
+	{
+		const CascadeFitter fitter(nearPlane, farPlane);
+		for (const XMVECTOR& lightDirection : s_LightDirections)
+		{
+			for (UINT c = 0; c < 64; c++)
+			{
+				const RandomCamera camera = CreateRandomCamera(generator);
+				const auto cascades = fitter.Fit(camera.GetInvView(), lightDirection);
+
+				for (UINT move = 0; move < 4; move++)
+				{
+					RandomCamera moved = camera;
+					moved.X += offsetDistribution(generator);
+					moved.Y += offsetDistribution(generator);
+					moved.Z += offsetDistribution(generator);
+					const auto movedCascades = fitter.Fit(moved.GetInvView(), lightDirection);
+
+					for (UINT i = 0; i < s_MaxCascadeCount; i++)
+					{
+						EXPECT_EQ(movedCascades[i].TexelSize, cascades[i].TexelSize);
+
+						// The middle of the slice, which is a point that the cascade covers
+						const float sliceDepth = 0.5f * (cascades[i].SplitNear + cascades[i].SplitFar);
+						const XMVECTOR anchorWS = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, sliceDepth, 1.0f), camera.GetInvView());
+
+						const XMFLOAT2 before = GetTexelPosition(cascades[i], anchorWS);
+						const XMFLOAT2 after = GetTexelPosition(movedCascades[i], anchorWS);
+						const float shiftX = after.x - before.x;
+						const float shiftY = after.y - before.y;
+						maxShimmer = max(maxShimmer, max(fabsf(shiftX - roundf(shiftX)), fabsf(shiftY - roundf(shiftY))));
+					}
+				}
+
+				for (UINT turn = 0; turn < 4; turn++)
+				{
+					RandomCamera turned = camera;
+					turned.Rotation = XMMatrixRotationRollPitchYaw(pitchDistribution(generator), yawDistribution(generator), 0.0f);
+					const auto turnedCascades = fitter.Fit(turned.GetInvView(), lightDirection);
+
+					for (UINT i = 0; i < s_MaxCascadeCount; i++)
+						EXPECT_EQ(turnedCascades[i].TexelSize, cascades[i].TexelSize);
+				}
+			}
+		}
+	}
+
+	EXPECT_LE(maxShimmer, s_ShimmerTolerance) << "Cascades moved by a fraction of a texel";
+}
@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "Renderer/Lighting/ShadowMapCache.h"
+#include "Renderer/Lighting/ShadowCascades.h"
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+	constexpr UINT s_ShadowMapResolution = 2048;
+	constexpr float s_CameraNear = 0.1f;
+	constexpr float s_CameraFar = 200.0f;
+
+	// The first cascade fitted around a camera at position looking along +z, as LightManager refits it every frame
+	XMMATRIX FitFirstCascade(FXMVECTOR cameraPosition, FXMVECTOR lightDirection)
+	{
+		const XMMATRIX view = XMMatrixLookToLH(cameraPosition, XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		const XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.0f), 16.0f / 9.0f, s_CameraNear, s_CameraFar);
+
+		return ShadowCascades::FitCascade(XMMatrixInverse(nullptr, view), XMMatrixInverse(nullptr, projection),
+			s_CameraNear, s_CameraFar, s_CameraNear, 20.0f, lightDirection, s_ShadowMapResolution).ViewProjection;
+	}
+
+	const XMVECTOR s_LightDirection = XMVector3Normalize(XMVectorSet(0.3f, -1.0f, 0.2f, 0.0f));
+	const std::vector<UINT> s_Casters = { 1, 4, 5, 9 };
+}
+
+
+TEST(ShadowMapCache, RendersOnceForStaticScene)
+{
+	ShadowMapCache cache;
+	const XMVECTOR cameraPosition = XMVectorSet(10.0f, 2.0f, -5.0f, 1.0f);
+
+	EXPECT_TRUE(cache.Update(FitFirstCascade(cameraPosition, s_LightDirection), s_Casters, false));
+
+	// Refitting from the same camera must give exactly the same matrix, or the cache would never be used
+	for (UINT frame = 0; frame < 10; frame++)
+		EXPECT_FALSE(cache.Update(FitFirstCascade(cameraPosition, s_LightDirection), s_Casters, false));
+
+	EXPECT_EQ(cache.GetRenderedFrameCount(), 1u);
+	EXPECT_EQ(cache.GetSkippedFrameCount(), 10u);
+}
+
+TEST(ShadowMapCache, CasterMovedInvalidates)
+{
+	ShadowMapCache cache;
+	const XMMATRIX viewProjection = FitFirstCascade(XMVectorSet(0.0f, 2.0f, 0.0f, 1.0f), s_LightDirection);
+	cache.Update(viewProjection, s_Casters, false);
+
+	// A visible caster moved this frame
+	EXPECT_TRUE(cache.Update(viewProjection, s_Casters, true));
+	EXPECT_FALSE(cache.Update(viewProjection, s_Casters, false));
+
+	// A caster moved into or out of the cascade
+	EXPECT_TRUE(cache.Update(viewProjection, { 1, 4, 5, 9, 12 }, false));
+	EXPECT_TRUE(cache.Update(viewProjection, { 1, 5, 9, 12 }, false));
+	EXPECT_FALSE(cache.Update(viewProjection, { 1, 5, 9, 12 }, false));
+}
+
+TEST(ShadowMapCache, LightMovedInvalidates)
+{
+	ShadowMapCache cache;
+	const XMVECTOR cameraPosition = XMVectorSet(0.0f, 2.0f, 0.0f, 1.0f);
+	cache.Update(FitFirstCascade(cameraPosition, s_LightDirection), s_Casters, false);
+
+	// Even a small change of direction rotates the light's view, so the shadow map must be re-rendered
+	const XMVECTOR movedDirection = XMVector3Normalize(XMVectorSet(0.3f, -1.0f, 0.21f, 0.0f));
+	EXPECT_TRUE(cache.Update(FitFirstCascade(cameraPosition, movedDirection), s_Casters, false));
+	EXPECT_FALSE(cache.Update(FitFirstCascade(cameraPosition, movedDirection), s_Casters, false));
+
+	// Only the last state is cached, so moving back renders again
+	EXPECT_TRUE(cache.Update(FitFirstCascade(cameraPosition, s_LightDirection), s_Casters, false));
+}
+
+TEST(ShadowMapCache, CascadeRefitInvalidates)
+{
+	ShadowMapCache cache;
+	cache.Update(FitFirstCascade(XMVectorSet(0.0f, 2.0f, 0.0f, 1.0f), s_LightDirection), s_Casters, false);
+
+	// The camera moving refits the cascade around its new frustum slice
+	UINT rendered = 0;
+	for (UINT frame = 1; frame <= 20; frame++)
+	{
+		const XMVECTOR cameraPosition = XMVectorSet(0.5f * static_cast<float>(frame), 2.0f, 0.0f, 1.0f);
+		rendered += cache.Update(FitFirstCascade(cameraPosition, s_LightDirection), s_Casters, false);
+	}
+	EXPECT_EQ(rendered, 20u);
+
+	// The cascade being disabled and enabled again, as when the cascade count changes
+	cache.Invalidate();
+	const XMMATRIX viewProjection = FitFirstCascade(XMVectorSet(10.0f, 2.0f, 0.0f, 1.0f), s_LightDirection);
+	EXPECT_TRUE(cache.Update(viewProjection, s_Casters, false));
+	EXPECT_FALSE(cache.Update(viewProjection, s_Casters, false));
+}
+
+TEST(ShadowMapCache, DisabledAlwaysRenders)
+{
+	ShadowMapCache cache;
+	cache.SetEnabled(false);
+	const XMMATRIX viewProjection = FitFirstCascade(XMVectorSet(0.0f, 2.0f, 0.0f, 1.0f), s_LightDirection);
+
+	for (UINT frame = 0; frame < 5; frame++)
+		EXPECT_TRUE(cache.Update(viewProjection, s_Casters, false));
+
+	// Enabling again must not reuse a shadow map from while it was disabled without rendering first
+	cache.SetEnabled(true);
+	EXPECT_TRUE(cache.Update(viewProjection, s_Casters, false));
+	EXPECT_FALSE(cache.Update(viewProjection, s_Casters, false));
+}
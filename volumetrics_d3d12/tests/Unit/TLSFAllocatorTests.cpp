@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "Renderer/Memory/TLSFAllocator.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+
+namespace
+{
+	// Checks the allocator's counters against a per-index ownership map of the same operations
+	void ExpectConsistent(const TLSFAllocator& allocator, const std::vector<bool>& allocated)
+	{
+		UINT allocatedCount = 0;
+		UINT freeBlockCount = 0;
+		UINT largestFreeBlock = 0;
+		UINT run = 0;
+		for (size_t i = 0; i <= allocated.size(); i++)
+		{
+			if (i < allocated.size() && !allocated[i])
+			{
+				run++;
+				continue;
+			}
+
+			if (run > 0)
+			{
+				freeBlockCount++;
+				largestFreeBlock = max(largestFreeBlock, run);
+			}
+			run = 0;
+			allocatedCount += i < allocated.size() ? 1 : 0;
+		}
+
+		// Free neighbours are always merged, so the free blocks are exactly the runs of free indices
+		EXPECT_EQ(allocator.GetAllocatedCount(), allocatedCount);
+		EXPECT_EQ(allocator.GetFreeBlockCount(), freeBlockCount);
+		EXPECT_EQ(allocator.GetLargestFreeBlock(), largestFreeBlock);
+	}
+}
+
+
+TEST(TLSFAllocator, AllocatesWholeCapacity)
+{
+	TLSFAllocator allocator(1000);
+	EXPECT_EQ(allocator.GetFreeCount(), 1000u);
+	EXPECT_EQ(allocator.GetFreeBlockCount(), 1u);
+
+	const UINT index = allocator.Allocate(1000);
+	EXPECT_EQ(index, 0u);
+	EXPECT_EQ(allocator.GetFreeCount(), 0u);
+	EXPECT_EQ(allocator.Allocate(1), TLSFAllocator::InvalidIndex);
+
+	allocator.Free(index, 1000);
+	EXPECT_EQ(allocator.GetFreeCount(), 1000u);
+	EXPECT_EQ(allocator.GetLargestFreeBlock(), 1000u);
+	EXPECT_FLOAT_EQ(allocator.GetFragmentation(), 0.0f);
+}
+
+TEST(TLSFAllocator, MergesFreedNeighbours)
+{
+	TLSFAllocator allocator(64);
+	const UINT a = allocator.Allocate(16);
+	const UINT b = allocator.Allocate(16);
+	const UINT c = allocator.Allocate(16);
+	ASSERT_NE(c, TLSFAllocator::InvalidIndex);
+
+	// Freeing a and c leaves b between them, so the free space is split
+	allocator.Free(a, 16);
+	allocator.Free(c, 16);
+	EXPECT_EQ(allocator.GetFreeBlockCount(), 2u);
+	EXPECT_GT(allocator.GetFragmentation(), 0.0f);
+
+	// Freeing b merges all three with the tail into one block
+	allocator.Free(b, 16);
+	EXPECT_EQ(allocator.GetFreeBlockCount(), 1u);
+	EXPECT_EQ(allocator.GetLargestFreeBlock(), 64u);
+}
+
+TEST(TLSFAllocator, FailsWhenNoBlockIsLargeEnough)
+{
+	TLSFAllocator allocator(48);
+	const UINT a = allocator.Allocate(16);
+	allocator.Allocate(16);
+	allocator.Allocate(16);
+	allocator.Free(a, 16);
+
+	EXPECT_EQ(allocator.Allocate(17), TLSFAllocator::InvalidIndex);
+	EXPECT_EQ(allocator.Allocate(16), a);
+}
+
+TEST(TLSFAllocator, RandomOperationsMatchOwnershipMap)
+{
+	constexpr UINT capacity = 4096;
+	TLSFAllocator allocator(capacity);
+	std::vector<bool> allocated(capacity, false);
+	std::vector<std::pair<UINT, UINT>> live;
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<UINT> sizeDist(1, 64);
+	for (UINT op = 0; op < 20000; op++)
+	{
+		if (live.empty() || rng() % 3 != 0)
+		{
+			const UINT count = sizeDist(rng);
+			const UINT index = allocator.Allocate(count);
+			if (index == TLSFAllocator::InvalidIndex)
+				continue;
+
+			ASSERT_LE(index + count, capacity);
+			for (UINT i = index; i < index + count; i++)
+			{
+				ASSERT_FALSE(allocated[i]) << "Index " << i << " handed out twice";
+				allocated[i] = true;
+			}
+			live.emplace_back(index, count);
+		}
+		else
+		{
+			const size_t victim = rng() % live.size();
+			const auto [index, count] = live[victim];
+			live[victim] = live.back();
+			live.pop_back();
+
+			allocator.Free(index, count);
+			for (UINT i = index; i < index + count; i++)
+				allocated[i] = false;
+		}
+
+		if (op % 97 == 0)
+			ExpectConsistent(allocator, allocated);
+	}
+	ExpectConsistent(allocator, allocated);
+}
@@ -0,0 +1,121 @@
+#include "pch.h"
+#include "Renderer/Memory/TLSFTrace.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <random>
+
+
+namespace
+{
+	// Applies random operations to an allocator as DescriptorHeap does, reporting each one to the recorder
+	void RecordRandomOperations(TLSFAllocator& allocator, TLSFTraceRecorder& recorder, std::vector<std::pair<UINT, UINT>>& live, UINT operations, UINT seed)
+	{
+		std::mt19937 rng(seed);
+		for (UINT op = 0; op < operations; op++)
+		{
+			if (live.empty() || rng() % 2 == 0)
+			{
+				const UINT count = 1 + rng() % 32;
+				const UINT index = allocator.Allocate(count);
+				recorder.OnAllocate(index, count);
+				if (index != TLSFAllocator::InvalidIndex)
+					live.emplace_back(index, count);
+			}
+			else
+			{
+				const size_t victim = rng() % live.size();
+				const auto [index, count] = live[victim];
+				live[victim] = live.back();
+				live.pop_back();
+
+				allocator.Free(index, count);
+				recorder.OnFree(index, count);
+			}
+		}
+	}
+}
+
+
+// Replaying against the allocator that recorded the trace must reproduce every index that it returned,
+// including when recording began with allocations live that are freed during the trace
+TEST(TLSFTrace, ReplayReproducesRecordedIndices)
+{
+	TLSFAllocator allocator(1024);
+	TLSFTraceRecorder recorder;
+	std::vector<std::pair<UINT, UINT>> live;
+
+	RecordRandomOperations(allocator, recorder, live, 500, 1);
+	ASSERT_FALSE(recorder.IsRecording());
+
+	recorder.Begin(allocator);
+	RecordRandomOperations(allocator, recorder, live, 5000, 2);
+	const TLSFTrace trace = recorder.End();
+
+	bool hasFreeRange = false;
+	for (const TLSFTrace::Operation& operation : trace.Operations)
+		hasFreeRange |= operation.Type == TLSFTrace::OperationType::FreeRange;
+	EXPECT_TRUE(hasFreeRange);
+	EXPECT_GT(trace.InitialFreeBlocks.size(), 1u);
+
+	TLSFAllocator replayAllocator(trace.Capacity);
+	std::vector<UINT> slotIndices;
+	UINT allocations = 0;
+	trace.Replay(replayAllocator, slotIndices, [&](const TLSFAllocator&, const TLSFTrace::Operation& operation, UINT index)
+		{
+			if (operation.Type != TLSFTrace::OperationType::Allocate)
+				return;
+
+			EXPECT_EQ(index, operation.Index);
+			allocations++;
+		});
+	EXPECT_EQ(allocations, trace.SlotCount);
+
+	EXPECT_EQ(replayAllocator.GetFreeBlocks(), allocator.GetFreeBlocks());
+}
+
+TEST(TLSFTrace, SaveLoadRoundTrip)
+{
+	TLSFAllocator allocator(256);
+	TLSFTraceRecorder recorder;
+	std::vector<std::pair<UINT, UINT>> live;
+
+	recorder.Begin(allocator);
+	RecordRandomOperations(allocator, recorder, live, 300, 3);
+	const TLSFTrace trace = recorder.End();
+
+	const std::string path = (std::filesystem::temp_directory_path() / "volumetrics_tests.tlsftrace").string();
+	ASSERT_TRUE(trace.Save(path));
+
+	TLSFTrace loaded;
+	ASSERT_TRUE(loaded.Load(path));
+	std::filesystem::remove(path);
+
+	EXPECT_EQ(loaded.Capacity, trace.Capacity);
+	EXPECT_EQ(loaded.SlotCount, trace.SlotCount);
+	EXPECT_EQ(loaded.InitialFreeBlocks, trace.InitialFreeBlocks);
+	ASSERT_EQ(loaded.Operations.size(), trace.Operations.size());
+	for (size_t i = 0; i < trace.Operations.size(); i++)
+	{
+		EXPECT_EQ(loaded.Operations[i].Type, trace.Operations[i].Type);
+		EXPECT_EQ(loaded.Operations[i].Slot, trace.Operations[i].Slot);
+		EXPECT_EQ(loaded.Operations[i].Index, trace.Operations[i].Index);
+		EXPECT_EQ(loaded.Operations[i].Count, trace.Operations[i].Count);
+	}
+}
+
+TEST(TLSFTrace, RejectsOtherFiles)
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "volumetrics_tests_not_a_trace.bin").string();
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		ASSERT_NE(file, nullptr);
+		fputs("not a trace", file);
+		fclose(file);
+	}
+
+	TLSFTrace trace;
+	EXPECT_FALSE(trace.Load(path));
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,14 @@
+#include "pch.h"
+#include "Framework/Log.h"
+
+#include <gtest/gtest.h>
+
+
+int main(int argc, char** argv)
+{
+	// ASSERT logs through the app logger before it breaks
+	Log::Init();
+
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
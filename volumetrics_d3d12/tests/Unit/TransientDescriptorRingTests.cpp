@@ -0,0 +1,53 @@
+#include "pch.h"
+#include "Renderer/Memory/TransientDescriptorRing.h"
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+	// Handles in a made up address range, as the ring never dereferences them
+	constexpr D3D12_CPU_DESCRIPTOR_HANDLE s_CPUBase = { 0x10000 };
+	constexpr D3D12_GPU_DESCRIPTOR_HANDLE s_GPUBase = { 0x80000 };
+	constexpr UINT s_DescriptorSize = 32;
+}
+
+
+TEST(TransientDescriptorRing, AllocatesFromTheCurrentFrameSegment)
+{
+	TransientDescriptorRing ring(s_CPUBase, s_GPUBase, s_DescriptorSize, 16, 2);
+
+	ring.BeginFrame(0);
+	const TransientDescriptorAllocation first = ring.Allocate(4);
+	ASSERT_TRUE(first.IsValid());
+	EXPECT_EQ(first.GetCPUHandle().ptr, s_CPUBase.ptr);
+	EXPECT_EQ(first.GetCPUHandle(3).ptr, s_CPUBase.ptr + 3 * s_DescriptorSize);
+	EXPECT_EQ(first.GetGPUHandle(1).ptr, s_GPUBase.ptr + s_DescriptorSize);
+
+	// The second frame's segment begins after the first's
+	ring.BeginFrame(1);
+	const TransientDescriptorAllocation second = ring.Allocate(4);
+	EXPECT_EQ(second.GetCPUHandle().ptr, s_CPUBase.ptr + 16 * s_DescriptorSize);
+	EXPECT_EQ(second.GetGPUHandle().ptr, s_GPUBase.ptr + 16 * s_DescriptorSize);
+	EXPECT_EQ(ring.GetCurrentFrameUsage(), 4u);
+}
+
+TEST(TransientDescriptorRing, RecyclesSegmentsAndFailsWhenExhausted)
+{
+	TransientDescriptorRing ring(s_CPUBase, s_GPUBase, s_DescriptorSize, 16, 2);
+
+	ring.BeginFrame(0);
+	EXPECT_TRUE(ring.Allocate(10).IsValid());
+	EXPECT_TRUE(ring.Allocate(6).IsValid());
+	EXPECT_FALSE(ring.Allocate(1).IsValid());
+
+	ring.BeginFrame(1);
+	EXPECT_TRUE(ring.Allocate(16).IsValid());
+
+	// Coming back to frame 0 recycles the whole segment
+	ring.BeginFrame(0);
+	const TransientDescriptorAllocation recycled = ring.Allocate(16);
+	ASSERT_TRUE(recycled.IsValid());
+	EXPECT_EQ(recycled.GetCPUHandle().ptr, s_CPUBase.ptr);
+	EXPECT_EQ(ring.GetHighWaterMark(), 16u);
+}
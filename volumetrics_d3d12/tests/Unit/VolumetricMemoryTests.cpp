@@ -0,0 +1,306 @@
+#include "pch.h"
+#include "Renderer/Lighting/VolumetricMemory.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+
+namespace
+{
+	// Reference quantiser of the packed VBufferB emission, in doubles
+	// The shared exponent is the smallest that fits the largest channel, once rounded to nearest even, in the mantissa
+	struct PackedEmission
+	{
+		UINT Exponent;
+		UINT Mantissas[3];
+
+		static PackedEmission Quantize(float r, float g, float b)
+		{
+			const double channels[3] = {
+				std::clamp<double>(r, 0.0, VBUFFERB_PACKED_MAX_EMISSION),
+				std::clamp<double>(g, 0.0, VBUFFERB_PACKED_MAX_EMISSION),
+				std::clamp<double>(b, 0.0, VBUFFERB_PACKED_MAX_EMISSION)
+			};
+			const double maxChannel = max(max(channels[0], channels[1]), channels[2]);
+
+			PackedEmission packed = {};
+			while (std::nearbyint(maxChannel / packed.GetScale()) > VBUFFERB_PACKED_MANTISSA_MAX)
+				packed.Exponent++;
+
+			for (UINT channel = 0; channel < 3; channel++)
+				packed.Mantissas[channel] = static_cast<UINT>(std::nearbyint(channels[channel] / packed.GetScale()));
+			return packed;
+		}
+
+		double GetScale() const
+		{
+			return ldexp(1.0, static_cast<int>(Exponent) - VBUFFERB_PACKED_EXPONENT_BIAS - VBUFFERB_PACKED_MANTISSA_BITS);
+		}
+
+		UINT GetBits() const
+		{
+			return Mantissas[0] | (Mantissas[1] << VBUFFERB_PACKED_MANTISSA_BITS) | (Mantissas[2] << (2 * VBUFFERB_PACKED_MANTISSA_BITS)) |
+				(Exponent << (3 * VBUFFERB_PACKED_MANTISSA_BITS));
+		}
+	};
+
+	constexpr UINT s_EmissionBitsMask = (1u << 26) - 1;
+
+	// Reference quantiser of the unsigned small floats of R11G11B10_FLOAT: 5 exponent bits with a bias of 15,
+	// denormals below 2^-14, rounding to nearest even, and clamping to the largest finite value as DirectXPackedVector does
+	double QuantizeSmallFloat(double value, int mantissaBits)
+	{
+		const double maxValue = (2.0 - ldexp(1.0, -mantissaBits)) * 32768.0;
+		if (!(value > 0.0))
+			return 0.0;
+
+		int exponent;
+		frexp(value, &exponent);
+		const double step = ldexp(1.0, max(exponent - 1, -14) - mantissaBits);
+		return min(std::nearbyint(value / step) * step, maxValue);
+	}
+
+	double QuantizeUnorm(double value, int bits)
+	{
+		const double maxCode = ldexp(1.0, bits) - 1.0;
+		return std::nearbyint(std::clamp(value, 0.0, 1.0) * maxCode) / maxCode;
+	}
+
+	// Mantissa bits of the RGB channels of a scattering format
+	std::array<int, 3> GetScatteringMantissaBits(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:	return { 10, 10, 10 };
+		case DXGI_FORMAT_R11G11B10_FLOAT:		return { 6, 6, 5 };
+		default:
+			ADD_FAILURE() << "Unexpected scattering format " << format;
+			return { 0, 0, 0 };
+		}
+	}
+
+	int GetTransmittanceBits(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R16_UNORM:		return 16;
+		case DXGI_FORMAT_R8_UNORM:		return 8;
+		default:
+			ADD_FAILURE() << "Unexpected transmittance format " << format;
+			return 0;
+		}
+	}
+
+	// Log-uniform between 2^minExponent and maxValue
+	class LogUniform
+	{
+	public:
+		LogUniform(double minExponent, double maxValue) : m_Distribution(minExponent, log2(maxValue)) {}
+
+		float operator()(std::mt19937& generator) { return static_cast<float>(exp2(m_Distribution(generator))); }
+
+	private:
+		std::uniform_real_distribution<double> m_Distribution;
+	};
+
+	constexpr UINT s_SampleCount = 200000;
+}
+
+
+// The packed emission bits are those of the reference quantiser, including at and just below powers of two,
+// where log2 may land either side of the exponent, and at and just below halfway between mantissa steps
+TEST(VolumetricMemory, PackedEmissionMatchesReference)
+{
+	std::mt19937 generator(1);
+	LogUniform magnitude(-30.0, 2.0 * VBUFFERB_PACKED_MAX_EMISSION);
+	std::uniform_real_distribution<float> ratio(0.0f, 1.0f);
+
+	auto Check = [](float r, float g, float b)
+		{
+			const UINT packed = Volumetrics::PackEmissionAnisotropy(r, g, b, 0.0f);
+			EXPECT_EQ(packed & s_EmissionBitsMask, PackedEmission::Quantize(r, g, b).GetBits()) << r << ", " << g << ", " << b;
+		};
+
+	for (UINT i = 0; i < s_SampleCount; i++)
+	{
+		const float maxChannel = magnitude(generator);
+		Check(maxChannel, maxChannel * ratio(generator), maxChannel * ratio(generator) * ratio(generator));
+	}
+
+	for (int exponent = -30; exponent <= 16; exponent++)
+	{
+		const float power = ldexpf(1.0f, exponent);
+		Check(power, 0.5f * power, 0.0f);
+		Check(nextafterf(power, 0.0f), 0.0f, power * 0.25f);
+		Check(power * (127.5f / 128.0f), power * 0.3f, power * 0.7f);
+		Check(power, nextafterf(power / 256.0f, 0.0f), power / 256.0f);
+	}
+
+	Check(0.0f, 0.0f, 0.0f);
+	Check(-1.0f, 2.0f, -3.0f);
+	Check(FLT_MAX, 1.0f, 0.0f);
+}
+
+// Each channel is within max(largest channel / 127, 2^-23) up to VBUFFERB_PACKED_MAX_EMISSION, and clamped beyond it
+TEST(VolumetricMemory, PackedEmissionStaysWithinItsBound)
+{
+	std::mt19937 generator(2);
+	LogUniform magnitude(-24.0, VBUFFERB_PACKED_MAX_EMISSION);
+	std::uniform_real_distribution<float> ratio(0.0f, 1.0f);
+
+	double maxRelativeError = 0.0;
+	for (UINT i = 0; i < s_SampleCount; i++)
+	{
+		const float maxChannel = magnitude(generator);
+		const float rgb[3] = { maxChannel * ratio(generator), maxChannel, maxChannel * ratio(generator) * ratio(generator) };
+
+		const UINT packed = Volumetrics::PackEmissionAnisotropy(rgb[0], rgb[1], rgb[2], 0.0f);
+		const double bound = max(maxChannel / 127.0, ldexp(1.0, -23));
+		for (UINT channel = 0; channel < 3; channel++)
+		{
+			const double error = fabs(static_cast<double>(Volumetrics::UnpackEmission(packed, channel)) - rgb[channel]);
+			ASSERT_LE(error, bound) << "channel " << channel << " of " << rgb[0] << ", " << rgb[1] << ", " << rgb[2];
+			maxRelativeError = max(maxRelativeError, error / bound);
+		}
+	}
+
+	// The bound is tight to within a few percent
+	EXPECT_GT(maxRelativeError, 0.95);
+
+	const UINT clamped = Volumetrics::PackEmissionAnisotropy(1.0e6f, -5.0f, VBUFFERB_PACKED_MAX_EMISSION, 0.0f);
+	EXPECT_EQ(Volumetrics::UnpackEmission(clamped, 0), VBUFFERB_PACKED_MAX_EMISSION);
+	EXPECT_EQ(Volumetrics::UnpackEmission(clamped, 1), 0.0f);
+	EXPECT_EQ(Volumetrics::UnpackEmission(clamped, 2), VBUFFERB_PACKED_MAX_EMISSION);
+}
+
+// Anisotropy is within 1/62, its steps and the ends of its range are exact, and it does not disturb the emission
+TEST(VolumetricMemory, PackedAnisotropyStaysWithinItsBound)
+{
+	constexpr float emission[3] = { 0.3f, 2.0f, 0.01f };
+	const UINT emissionBits = PackedEmission::Quantize(emission[0], emission[1], emission[2]).GetBits();
+
+	constexpr UINT sampleCount = 100000;
+	for (UINT i = 0; i <= sampleCount; i++)
+	{
+		const float anisotropy = -1.0f + 2.0f * static_cast<float>(i) / static_cast<float>(sampleCount);
+		const UINT packed = Volumetrics::PackEmissionAnisotropy(emission[0], emission[1], emission[2], anisotropy);
+
+		ASSERT_LE(fabsf(Volumetrics::UnpackAnisotropy(packed) - anisotropy), 1.0f / (2.0f * VBUFFERB_PACKED_ANISOTROPY_STEPS) + 1e-6f) << anisotropy;
+		ASSERT_EQ(packed & s_EmissionBitsMask, emissionBits) << anisotropy;
+	}
+
+	for (int step = -VBUFFERB_PACKED_ANISOTROPY_STEPS; step <= VBUFFERB_PACKED_ANISOTROPY_STEPS; step++)
+	{
+		const float anisotropy = static_cast<float>(step) / VBUFFERB_PACKED_ANISOTROPY_STEPS;
+		EXPECT_EQ(Volumetrics::UnpackAnisotropy(Volumetrics::PackEmissionAnisotropy(1.0f, 1.0f, 1.0f, anisotropy)), anisotropy);
+	}
+
+	EXPECT_EQ(Volumetrics::UnpackAnisotropy(Volumetrics::PackEmissionAnisotropy(1.0f, 1.0f, 1.0f, 5.0f)), 1.0f);
+	EXPECT_EQ(Volumetrics::UnpackAnisotropy(Volumetrics::PackEmissionAnisotropy(1.0f, 1.0f, 1.0f, -5.0f)), -1.0f);
+}
+
+// The scattering of every integrated storage is within a relative 2^-(mantissa bits + 1) across the normal range,
+// and within half a denormal step below it, as documented on VolumetricMemory
+TEST(VolumetricMemory, IntegratedScatteringStaysWithinItsBound)
+{
+	for (UINT storage = 0; storage < VOLUME_INTEGRATED_STORAGE_COUNT; storage++)
+	{
+		SCOPED_TRACE(VolumetricMemory::GetIntegratedStorageName(storage));
+
+		const std::array<int, 3> mantissaBits = GetScatteringMantissaBits(VolumetricMemory::GetIntegratedFormat(storage));
+		for (UINT channel = 0; channel < 3; channel++)
+		{
+			const int bits = mantissaBits[channel];
+			const double relativeBound = ldexp(1.0, -(bits + 1));
+			const double denormalBound = ldexp(1.0, -14 - bits - 1);
+
+			std::mt19937 generator(3 + channel);
+			LogUniform magnitude(-24.0, 60000.0);
+
+			double maxRelativeError = 0.0;
+			for (UINT i = 0; i < s_SampleCount; i++)
+			{
+				const double value = magnitude(generator);
+				const double error = fabs(QuantizeSmallFloat(value, bits) - value);
+				if (value < ldexp(1.0, -14))
+				{
+					ASSERT_LE(error, denormalBound) << "channel " << channel << ", " << value;
+				}
+				else
+				{
+					ASSERT_LE(error, relativeBound * value) << "channel " << channel << ", " << value;
+					maxRelativeError = max(maxRelativeError, error / value);
+				}
+			}
+			EXPECT_GT(maxRelativeError, 0.95 * relativeBound) << "channel " << channel;
+		}
+	}
+
+	// The documented R11G11B10F bounds
+	EXPECT_EQ(ldexp(1.0, -(6 + 1)), 1.0 / 128.0);
+	EXPECT_EQ(ldexp(1.0, -(5 + 1)), 1.0 / 64.0);
+}
+
+// Separate transmittance is within half a UNORM step, 1/131070 for R16 and 1/510 for R8
+TEST(VolumetricMemory, IntegratedTransmittanceStaysWithinItsBound)
+{
+	EXPECT_EQ(VolumetricMemory::GetIntegratedTransmittanceFormat(VOLUME_INTEGRATED_STORAGE_RGBA16F), DXGI_FORMAT_UNKNOWN);
+
+	const std::pair<UINT, double> storages[] = {
+		{ VOLUME_INTEGRATED_STORAGE_R11G11B10_R16, 1.0 / 131070.0 },
+		{ VOLUME_INTEGRATED_STORAGE_R11G11B10_R8, 1.0 / 510.0 }
+	};
+	for (const auto& [storage, bound] : storages)
+	{
+		SCOPED_TRACE(VolumetricMemory::GetIntegratedStorageName(storage));
+		const int bits = GetTransmittanceBits(VolumetricMemory::GetIntegratedTransmittanceFormat(storage));
+
+		std::mt19937 generator(5);
+		std::uniform_real_distribution<double> transmittance(0.0, 1.0);
+
+		double maxError = 0.0;
+		for (UINT i = 0; i < s_SampleCount; i++)
+		{
+			const double value = transmittance(generator);
+			maxError = max(maxError, fabs(QuantizeUnorm(value, bits) - value));
+		}
+		EXPECT_LE(maxError, bound * (1.0 + 1e-9));
+		EXPECT_GT(maxError, 0.95 * bound);
+
+		EXPECT_EQ(QuantizeUnorm(0.0, bits), 0.0);
+		EXPECT_EQ(QuantizeUnorm(1.0, bits), 1.0);
+	}
+}
+
+// Every configuration adds up its volumes, aliasing saves the smaller of VBufferA and the integrated volume,
+// and the reduced formats use the bytes of their formats
+// The resolution is a multiple of the placement alignment in every format, so that no volume is padded
+TEST(VolumetricMemory, FootprintAddsUp)
+{
+	constexpr XMUINT3 resolution = { 128, 64, 64 };
+	const UINT64 texelCount = static_cast<UINT64>(resolution.x) * resolution.y * resolution.z;
+
+	for (UINT vbufferB = 0; vbufferB < VOLUME_VBUFFERB_STORAGE_COUNT; vbufferB++)
+	{
+		for (UINT integrated = 0; integrated < VOLUME_INTEGRATED_STORAGE_COUNT; integrated++)
+		{
+			SCOPED_TRACE(testing::Message() << VolumetricMemory::GetVBufferBStorageName(vbufferB) << ", " << VolumetricMemory::GetIntegratedStorageName(integrated));
+
+			VolumetricMemoryConfig config = { .VBufferBStorage = vbufferB, .IntegratedStorage = integrated };
+			const VolumetricMemoryFootprint separate = VolumetricMemory::CalculateFootprint(config, resolution);
+			config.AliasVBufferAWithIntegrated = true;
+			const VolumetricMemoryFootprint aliased = VolumetricMemory::CalculateFootprint(config, resolution);
+
+			EXPECT_EQ(separate.AliasedBytes, 0u);
+			EXPECT_EQ(separate.Total, separate.VBufferA + separate.VBufferB + separate.LightScatteringVolumes + separate.IntegratedVolume);
+			EXPECT_EQ(aliased.AliasedBytes, min(aliased.VBufferA, aliased.IntegratedVolume));
+			EXPECT_EQ(aliased.Total, separate.Total - aliased.AliasedBytes);
+
+			EXPECT_EQ(separate.VBufferA, texelCount * 8);
+			EXPECT_EQ(separate.LightScatteringVolumes, 2 * texelCount * 8);
+			EXPECT_EQ(separate.VBufferB, texelCount * (vbufferB == VOLUME_VBUFFERB_STORAGE_FULL ? 8 : vbufferB == VOLUME_VBUFFERB_STORAGE_PACKED ? 4 : 0));
+			EXPECT_EQ(separate.IntegratedVolume, texelCount * (integrated == VOLUME_INTEGRATED_STORAGE_RGBA16F ? 8 : integrated == VOLUME_INTEGRATED_STORAGE_R11G11B10_R16 ? 6 : 5));
+		}
+	}
+}
@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "Renderer/Lighting/VolumetricResolutionController.h"
+
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <random>
+
+
+namespace
+{
+	// The tiers of VolumetricRendering
+	const std::vector<XMUINT3> s_Tiers = {
+		{ 512, 288, 128 },
+		{ 384, 216, 128 },
+		{ 320, 176, 96 },
+		{ 256, 144, 64 },
+		{ 160, 88, 64 }
+	};
+
+	// Timings are read back as many frames later as there are back buffers, as VolumetricRendering reads them
+	constexpr UINT s_FramesInFlight = 3;
+
+	float GetFroxelCount(UINT tier)
+	{
+		return static_cast<float>(s_Tiers[tier].x) * static_cast<float>(s_Tiers[tier].y) * static_cast<float>(s_Tiers[tier].z);
+	}
+
+	// The tier of each frame of a replayed trace
+	struct TraceResult
+	{
+		std::vector<UINT> Tiers;
+
+		UINT GetChangeCount() const
+		{
+			UINT changes = 0;
+			for (size_t i = 1; i < Tiers.size(); i++)
+				changes += Tiers[i] != Tiers[i - 1];
+			return changes;
+		}
+
+		// The first frame from which the tier no longer changes
+		size_t GetSettledFrame() const
+		{
+			size_t frame = 0;
+			for (size_t i = 1; i < Tiers.size(); i++)
+			{
+				if (Tiers[i] != Tiers[i - 1])
+					frame = i;
+			}
+			return frame;
+		}
+	};
+
+	// Replays a synthetic GPU-time trace against a controller
+	// load(frame) is the budget pressure that the frame would have at tier 0: every stage takes that fraction of its budget,
+	// scaled by the froxel count of the tier that the frame was rendered at, and by multiplicative noise of up to noise either way
+	TraceResult ReplayTrace(VolumetricResolutionController& controller, UINT frameCount, const std::function<float(UINT)>& load, float noise = 0.0f, UINT seed = 1)
+	{
+		std::mt19937 generator(seed);
+		std::uniform_real_distribution<float> noiseDistribution(1.0f - noise, 1.0f + noise);
+
+		const VolumetricResolutionController::StageTimes& budgets = controller.GetSettings().StageBudgets;
+
+		std::array<UINT, s_FramesInFlight> frameTiers;
+		std::array<VolumetricResolutionController::StageTimes, s_FramesInFlight> frameTimes;
+		frameTiers.fill(controller.GetTier());
+
+		TraceResult result;
+		result.Tiers.reserve(frameCount);
+		for (UINT frame = 0; frame < frameCount; frame++)
+		{
+			const UINT slot = frame % s_FramesInFlight;
+			if (frame >= s_FramesInFlight)
+				controller.Update(frameTimes[slot], frameTiers[slot]);
+
+			// Render the frame at the current tier
+			const UINT tier = controller.GetTier();
+			const float scale = load(frame) * GetFroxelCount(tier) / GetFroxelCount(0);
+			for (UINT stage = 0; stage < VolumetricResolutionController::StageCount; stage++)
+				frameTimes[slot][stage] = budgets[stage] * scale * (noise > 0.0f ? noiseDistribution(generator) : 1.0f);
+			frameTiers[slot] = tier;
+
+			result.Tiers.push_back(tier);
+		}
+		return result;
+	}
+
+	// The highest tier that would be within budget at a tier 0 pressure
+	UINT GetFittingTier(float load)
+	{
+		UINT tier = 0;
+		while (tier + 1 < s_Tiers.size() && load * GetFroxelCount(tier) / GetFroxelCount(0) > 1.0f)
+			tier++;
+		return tier;
+	}
+}
+
+
+TEST(VolumetricResolutionController, StaysAtTheTopTierWithinBudget)
+{
+	VolumetricResolutionController controller(s_Tiers);
+	const TraceResult result = ReplayTrace(controller, 2000, [](UINT) { return 0.9f; }, 0.05f);
+
+	EXPECT_EQ(result.GetChangeCount(), 0u);
+	EXPECT_EQ(controller.GetTier(), 0u);
+}
+
+// A sustained overload drops straight to the first tier that fits, after DowngradeFrames frames over budget
+TEST(VolumetricResolutionController, DropsToTheFittingTier)
+{
+	for (float load : { 1.5f, 3.0f, 12.0f })
+	{
+		SCOPED_TRACE(testing::Message() << "load " << load);
+
+		VolumetricResolutionController controller(s_Tiers);
+		const VolumetricResolutionController::Settings& settings = controller.GetSettings();
+		const TraceResult result = ReplayTrace(controller, 1000, [load](UINT) { return load; });
+
+		EXPECT_EQ(result.GetChangeCount(), 1u);
+		EXPECT_EQ(controller.GetTier(), GetFittingTier(load));
+
+		// The timings of the first frame arrive after the frames in flight, and each later frame brings another
+		const size_t changeFrame = result.GetSettledFrame();
+		EXPECT_EQ(changeFrame, s_FramesInFlight + settings.DowngradeFrames - 1);
+	}
+}
+
+// Hitches that last a frame are absorbed by the smoothing
+// The first frame is not a hitch, as the first measurement is taken as it is
+TEST(VolumetricResolutionController, IgnoresSingleFrameHitches)
+{
+	VolumetricResolutionController controller(s_Tiers);
+	const TraceResult result = ReplayTrace(controller, 3000, [](UINT frame) { return frame % 20 == 10 ? 3.0f : 0.7f; });
+
+	EXPECT_EQ(result.GetChangeCount(), 0u);
+}
+
+// A load that fits one tier but not the next, measured with noise, settles on that tier rather than oscillating around it
+TEST(VolumetricResolutionController, SettlesUnderNoisyLoad)
+{
+	const UINT seeds[] = { 1, 2, 3, 4 };
+	for (UINT seed : seeds)
+	{
+		SCOPED_TRACE(testing::Message() << "seed " << seed);
+
+		VolumetricResolutionController controller(s_Tiers);
+
+		// 0.85 of the budget at tier 1, so that tier 0 is over budget and tier 1 is too close to the budget to upgrade from
+		const float load = 0.85f * GetFroxelCount(0) / GetFroxelCount(1);
+		const TraceResult result = ReplayTrace(controller, 10000, [load](UINT) { return load; }, 0.25f, seed);
+
+		EXPECT_EQ(result.GetChangeCount(), 1u);
+		EXPECT_EQ(controller.GetTier(), 1u);
+	}
+}
+
+// Once the load drops, the tier climbs back one step at a time, each after UpgradeFrames frames with headroom and a cooldown
+TEST(VolumetricResolutionController, ClimbsBackWhenTheLoadDrops)
+{
+	VolumetricResolutionController controller(s_Tiers);
+	const VolumetricResolutionController::Settings& settings = controller.GetSettings();
+
+	constexpr UINT overloadFrames = 200;
+	const TraceResult result = ReplayTrace(controller, 2000, [](UINT frame) { return frame < overloadFrames ? 12.0f : 0.5f; });
+
+	const UINT lowestTier = GetFittingTier(12.0f);
+	ASSERT_EQ(result.Tiers[overloadFrames], lowestTier);
+	EXPECT_EQ(controller.GetTier(), 0u);
+	EXPECT_EQ(result.GetChangeCount(), 1 + lowestTier);
+
+	// Every upgrade is a single tier, at least the cooldown and the upgrade frames after the previous change
+	size_t previousChange = 0;
+	for (size_t i = 1; i < result.Tiers.size(); i++)
+	{
+		if (result.Tiers[i] == result.Tiers[i - 1])
+			continue;
+
+		if (result.Tiers[i] < result.Tiers[i - 1])
+		{
+			EXPECT_EQ(result.Tiers[i - 1] - result.Tiers[i], 1u);
+			EXPECT_GE(i - previousChange, settings.CooldownFrames + settings.UpgradeFrames);
+		}
+		previousChange = i;
+	}
+}
+
+// SetTier restarts the measurements, so the frames in flight from the old tier cannot trigger a change during the cooldown
+TEST(VolumetricResolutionController, SetTierStartsACooldown)
+{
+	VolumetricResolutionController controller(s_Tiers);
+	controller.SetTier(2);
+
+	const TraceResult result = ReplayTrace(controller, controller.GetSettings().CooldownFrames + s_FramesInFlight, [](UINT) { return 12.0f; });
+	EXPECT_EQ(result.GetChangeCount(), 0u);
+	EXPECT_EQ(controller.GetTier(), 2u);
+}
@@ -0,0 +1,300 @@
+#include "pch.h"
+#include "Renderer/Lighting/FogClipmapPlanner.h"
+#include "Renderer/Lighting/FogNoiseBaker.h"
+#include "Renderer/Lighting/VolumetricsReference.h"
+#include "Framework/ThreadPool.h"
+#include "Common/FogScene.h"
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+	// The box that holds the global fog of a scene, outside of which the ground truth need not march
+	VolumetricsReference::GroundTruthDesc GetFogGroundTruthDesc(const VolumetricsReference::FrameInputs& inputs)
+	{
+		const GlobalFogConstantBuffer& fog = inputs.GlobalFog;
+		const float radius = fog.Radius + fog.RadiusSmoothing;
+
+		VolumetricsReference::GroundTruthDesc desc;
+		desc.StepLength = 0.05f;
+		desc.BoundsMin = { -radius, 0.0f, -radius };
+		desc.BoundsMax = { radius, fog.MaxHeight + fog.HeightSmoothing, radius };
+		return desc;
+	}
+
+	// Largest difference between the extinctions of two V-Buffers
+	float MaxExtinctionDifference(const VolumetricsReference::Volume& a, const VolumetricsReference::Volume& b)
+	{
+		float difference = 0.0f;
+		for (size_t i = 0; i < a.Texels.size(); i++)
+			difference = max(difference, fabsf(a.Texels[i].w - b.Texels[i].w));
+		return difference;
+	}
+
+	// Largest difference between two volumes, relative to the larger of the value and floor in each channel
+	float MaxRelativeDifference(const VolumetricsReference::Volume& a, const VolumetricsReference::Volume& b, float floor)
+	{
+		float difference = 0.0f;
+		for (size_t i = 0; i < a.Texels.size(); i++)
+		{
+			const float channelsA[4] = { a.Texels[i].x, a.Texels[i].y, a.Texels[i].z, a.Texels[i].w };
+			const float channelsB[4] = { b.Texels[i].x, b.Texels[i].y, b.Texels[i].z, b.Texels[i].w };
+			for (UINT channel = 0; channel < 4; channel++)
+				difference = max(difference, fabsf(channelsA[channel] - channelsB[channel]) / max(fabsf(channelsB[channel]), floor));
+		}
+		return difference;
+	}
+
+	// Renders a frame with the serial and the scan integration, and compares their integrated volumes and output images
+	// The scan combines the same slices in a different order, so the two only differ by rounding
+	void ExpectScanMatchesSerial(const VolumetricsReference::FrameInputs& inputs)
+	{
+		ThreadPool threadPool(0);
+
+		VolumetricsReference serial(threadPool);
+		serial.RenderFrame(inputs);
+
+		VolumetricsReference::FrameInputs scanInputs = inputs;
+		scanInputs.VolumeIntegrationMode = VOLUME_INTEGRATION_SCAN;
+		VolumetricsReference scan(threadPool);
+		scan.RenderFrame(scanInputs);
+
+		ASSERT_EQ(scan.GetIntegratedVolume().Texels.size(), serial.GetIntegratedVolume().Texels.size());
+		EXPECT_LT(MaxRelativeDifference(scan.GetIntegratedVolume(), serial.GetIntegratedVolume(), 1e-3f), 1e-5f);
+		EXPECT_LT(MaxRelativeDifference(scan.GetOutputImage(), serial.GetOutputImage(), 1e-3f), 1e-5f);
+
+		// The fog must reach far enough for the transmittance to fall across the volume
+		const float lastTransmittance = serial.GetIntegratedVolume().At(0, 0, inputs.Volume.VolumeResolution.z - 1).w;
+		EXPECT_LT(lastTransmittance, 0.9f);
+	}
+}
+
+
+// Where no cascade covers a point, density estimation and the ground truth evaluate the global fog directly
+TEST(VolumetricsReference, FogClipmapFallsBackOutsideEveryCascade)
+{
+	ThreadPool threadPool(0);
+	VolumetricsReference::FrameInputs inputs = CreateFogScene();
+
+	VolumetricsReference direct(threadPool);
+	direct.RenderFrame(inputs);
+	VolumetricsReference::Volume directGroundTruth;
+	direct.RenderGroundTruth(inputs, GetFogGroundTruthDesc(inputs), directGroundTruth);
+
+	FogClipmapPlanner planner(32, 0.25f);
+	planner.Update({ 1000.0f, 0.0f, 1000.0f });
+	inputs.FogClipmap = planner.GetConstants();
+
+	VolumetricsReference clipmap(threadPool);
+	clipmap.RenderFrame(inputs);
+	VolumetricsReference::Volume clipmapGroundTruth;
+	clipmap.RenderGroundTruth(inputs, GetFogGroundTruthDesc(inputs), clipmapGroundTruth);
+
+	EXPECT_EQ(VolumetricsReference::MaxAbsoluteDifference(clipmap.GetVBufferA(), direct.GetVBufferA()), 0.0f);
+	EXPECT_EQ(VolumetricsReference::MaxAbsoluteDifference(clipmapGroundTruth, directGroundTruth), 0.0f);
+}
+
+// Filtering the clipmap reproduces fog that is constant across the voxels around each froxel
+TEST(VolumetricsReference, FogClipmapMatchesConstantFog)
+{
+	ThreadPool threadPool(0);
+	VolumetricsReference::FrameInputs inputs = CreateFogScene();
+
+	// The froxels stay between heights of 20 and 30 metres, well inside the fog
+	inputs.GlobalFog.Radius = 200.0f;
+	inputs.GlobalFog.MaxHeight = 200.0f;
+	const XMFLOAT3 eye = { 0.0f, 30.0f, 0.0f };
+	PlaceFogSceneCamera(inputs, eye);
+
+	VolumetricsReference direct(threadPool);
+	direct.RenderFrame(inputs);
+
+	FogClipmapPlanner planner(32, 0.25f);
+	planner.Update(eye);
+	inputs.FogClipmap = planner.GetConstants();
+
+	VolumetricsReference clipmap(threadPool);
+	clipmap.RenderFrame(inputs);
+
+	EXPECT_LT(VolumetricsReference::MaxAbsoluteDifference(clipmap.GetVBufferA(), direct.GetVBufferA()), 1e-6f);
+}
+
+// Where the fog fades at its edges, the clipmap differs from the direct evaluation by its filtering,
+// which grows with the voxel size
+// The finest cascade is large enough to hold every froxel, so that the voxel size is the same across the volume
+TEST(VolumetricsReference, FogClipmapErrorShrinksWithVoxelSize)
+{
+	ThreadPool threadPool(0);
+	const VolumetricsReference::FrameInputs directInputs = CreateFogScene();
+	const XMFLOAT3 eye = directInputs.Pass.WorldEyePos;
+
+	VolumetricsReference direct(threadPool);
+	direct.RenderFrame(directInputs);
+
+	float previousError = FLT_MAX;
+	for (float voxelSize : { 1.0f, 0.25f, 0.0625f })
+	{
+		FogClipmapPlanner planner(1024, voxelSize);
+		planner.Update(eye);
+
+		VolumetricsReference::FrameInputs inputs = directInputs;
+		inputs.FogClipmap = planner.GetConstants();
+
+		VolumetricsReference clipmap(threadPool);
+		clipmap.RenderFrame(inputs);
+
+		const float error = MaxExtinctionDifference(clipmap.GetVBufferA(), direct.GetVBufferA());
+		EXPECT_GT(error, 0.0f) << "voxel size " << voxelSize;
+		EXPECT_LT(error, previousError) << "voxel size " << voxelSize;
+		previousError = error;
+	}
+
+	// A smoothstep over a metre is within a few percent of its linear interpolation between 16th-metre voxels
+	EXPECT_LT(previousError, 0.01f * directInputs.GlobalFog.Extinction);
+}
+
+// Wrapped addressing blends the texels at opposite edges across the seam, and repeats with a period of 1
+TEST(VolumetricsReference, SampleTrilinearWrapRepeats)
+{
+	VolumetricsReference::Volume volume;
+	volume.Resize({ 4, 4, 4 });
+	for (size_t i = 0; i < volume.Texels.size(); i++)
+		volume.Texels[i] = XMFLOAT4(static_cast<float>(i % 4), static_cast<float>(i / 4 % 4), static_cast<float>(i / 16), 1.0f);
+
+	// u = 0 lies halfway between the centres of the last and first texels
+	const XMFLOAT4 seam = volume.SampleTrilinearWrap({ 0.0f, 0.125f, 0.125f });
+	EXPECT_FLOAT_EQ(seam.x, 1.5f);
+	EXPECT_FLOAT_EQ(seam.y, 0.0f);
+	EXPECT_FLOAT_EQ(seam.w, 1.0f);
+
+	for (const XMFLOAT3& uvw : { XMFLOAT3(0.3f, 0.7f, 0.1f), XMFLOAT3(0.95f, 0.02f, 0.5f) })
+	{
+		const XMFLOAT4 a = volume.SampleTrilinearWrap(uvw);
+		const XMFLOAT4 b = volume.SampleTrilinearWrap({ uvw.x + 1.0f, uvw.y - 2.0f, uvw.z + 3.0f });
+		EXPECT_NEAR(a.x, b.x, 1e-5f);
+		EXPECT_NEAR(a.y, b.y, 1e-5f);
+		EXPECT_NEAR(a.z, b.z, 1e-5f);
+	}
+}
+
+// Noise of a constant density scales the global fog as a lower extinction would, in the froxels and the ground truth
+TEST(VolumetricsReference, FogNoiseOfConstantDensityScalesTheGlobalFog)
+{
+	ThreadPool threadPool(0);
+	VolumetricsReference::FrameInputs inputs = CreateFogScene();
+	inputs.Pass.TotalTime = 3.0f;
+
+	// The gradient channel is 0.25 and the Worley channel 0.75, blended halfway to 0.5
+	inputs.FogNoiseTexture.Resize({ 4, 4, 4 });
+	for (XMFLOAT4& texel : inputs.FogNoiseTexture.Texels)
+		texel = XMFLOAT4(0.25f, 0.75f, 0.0f, 0.0f);
+	inputs.FogNoise = {
+		.WindVelocity = XMFLOAT3(1.0f, 0.0f, 2.0f),
+		.Frequency = 0.3f,
+		.Strength = 0.8f,
+		.WorleyWeight = 0.5f,
+		.Enabled = 1
+	};
+	const float factor = 1.0f - 0.8f * (1.0f - 0.5f);
+
+	VolumetricsReference noise(threadPool);
+	noise.RenderFrame(inputs);
+	VolumetricsReference::Volume noiseGroundTruth;
+	noise.RenderGroundTruth(inputs, GetFogGroundTruthDesc(inputs), noiseGroundTruth);
+
+	VolumetricsReference::FrameInputs scaledInputs = inputs;
+	scaledInputs.FogNoise.Enabled = 0;
+	scaledInputs.GlobalFog.Extinction *= factor;
+
+	VolumetricsReference scaled(threadPool);
+	scaled.RenderFrame(scaledInputs);
+	VolumetricsReference::Volume scaledGroundTruth;
+	scaled.RenderGroundTruth(scaledInputs, GetFogGroundTruthDesc(scaledInputs), scaledGroundTruth);
+
+	EXPECT_LT(VolumetricsReference::MaxAbsoluteDifference(noise.GetVBufferA(), scaled.GetVBufferA()), 1e-6f);
+	EXPECT_LT(VolumetricsReference::MaxAbsoluteDifference(noise.GetVBufferB(), scaled.GetVBufferB()), 1e-6f);
+	EXPECT_LT(VolumetricsReference::MaxAbsoluteDifference(noiseGroundTruth, scaledGroundTruth), 1e-5f);
+}
+
+// Baked noise only removes fog, by at most its strength, and scrolls with the wind
+TEST(VolumetricsReference, FogNoiseStaysWithinItsStrength)
+{
+	ThreadPool threadPool(0);
+	VolumetricsReference::FrameInputs inputs = CreateFogScene();
+
+	VolumetricsReference direct(threadPool);
+	direct.RenderFrame(inputs);
+
+	FogNoiseBaker baker(threadPool);
+	FogNoiseBaker::Desc desc;
+	desc.Resolution = 16;
+	desc.Frequency = 2;
+	desc.Octaves = 2;
+	baker.Bake(desc);
+	VolumetricsReference::LoadFogNoiseTexture(baker, inputs.FogNoiseTexture);
+
+	constexpr float strength = 0.6f;
+	inputs.FogNoise = {
+		.WindVelocity = XMFLOAT3(0.5f, 0.0f, 0.0f),
+		.Frequency = 0.25f,
+		.Strength = strength,
+		.WorleyWeight = 0.3f,
+		.Enabled = 1
+	};
+
+	VolumetricsReference noise(threadPool);
+	noise.RenderFrame(inputs);
+
+	float minRatio = 1.0f;
+	float maxRatio = 0.0f;
+	for (size_t i = 0; i < direct.GetVBufferA().Texels.size(); i++)
+	{
+		const float directExtinction = direct.GetVBufferA().Texels[i].w;
+		if (directExtinction < 1e-3f)
+			continue;
+
+		const float ratio = noise.GetVBufferA().Texels[i].w / directExtinction;
+		minRatio = min(minRatio, ratio);
+		maxRatio = max(maxRatio, ratio);
+	}
+	EXPECT_GE(minRatio, 1.0f - strength - 1e-5f);
+	EXPECT_LE(maxRatio, 1.0f + 1e-5f);
+	EXPECT_GT(maxRatio - minRatio, 0.05f);
+
+	inputs.Pass.TotalTime = 1.0f;
+	VolumetricsReference scrolled(threadPool);
+	scrolled.RenderFrame(inputs);
+	EXPECT_GT(MaxExtinctionDifference(scrolled.GetVBufferA(), noise.GetVBufferA()), 0.0f);
+}
+
+// Volume depths of one slice per scan thread, of partial chunks that leave the last threads idle, and the most the scan supports
+TEST(VolumetricsReference, ScanIntegrationMatchesSerial)
+{
+	for (UINT depth : { 32u, 40u, 104u, static_cast<UINT>(VOLUME_SCAN_MAX_SLICES) })
+	{
+		for (UINT distribution = 0; distribution < VOLUME_DEPTH_DISTRIBUTION_COUNT; distribution++)
+		{
+			SCOPED_TRACE(testing::Message() << depth << " slices, distribution " << distribution);
+			ExpectScanMatchesSerial(CreateFogScene({ 32, 16, depth }, distribution));
+		}
+	}
+}
+
+// Inactive bricks carry the accumulated values through in both integrations
+TEST(VolumetricsReference, ScanIntegrationMatchesSerialOverInactiveBricks)
+{
+	VolumetricsReference::FrameInputs inputs = CreateFogScene({ 32, 16, 64 });
+
+	// Every third brick is inactive
+	const XMUINT3 bricks = { 32 / VOLUME_BRICK_SIZE, 16 / VOLUME_BRICK_SIZE, 64 / VOLUME_BRICK_SIZE };
+	const UINT brickCount = bricks.x * bricks.y * bricks.z;
+	inputs.BrickOccupancy.assign((brickCount + 31) / 32, 0);
+	for (UINT brick = 0; brick < brickCount; brick++)
+	{
+		if (brick % 3 != 0)
+			inputs.BrickOccupancy[brick / 32] |= 1u << (brick % 32);
+	}
+
+	ExpectScanMatchesSerial(inputs);
+}